@@ -15,6 +15,8 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #include "context.h"
 #include "provisioning-session.h"
 #include "utilities.h"
+#include "json-format.h"
+#include "json-writer.h"
 
 #include "openapi/model/msaf_api_content_hosting_configuration.h"
 
@@ -32,104 +34,80 @@ static ogs_sbi_client_t *msaf_m3_client_init(const char *hostname, int port);
 static int
 m3_client_as_state_requests(msaf_application_server_state_node_t *as_state, purge_resource_id_node_t *purge_node,const char *type, const char *data, const char *method, const char *component);
 static int client_notify_cb(int status, ogs_sbi_response_t *response, void *data);
+static int _state_queue_on_post(msaf_provisioning_session_t *provisioning_session, bool send);
+static void _state_queue_update(msaf_provisioning_session_t *provisioning_session, bool send);
+static void _state_queue_update_as(msaf_application_server_state_node_t *as_state, msaf_provisioning_session_t *provisioning_session,
+                                   bool send);
+static void _queue_content_hosting_configuration(msaf_application_server_state_node_t *as_state, const char *provisioning_session_id);
+static bool _resource_id_queued(ogs_list_t *list, const char *id);
 static void msaf_application_server_remove(msaf_application_server_node_t *msaf_as);
+static bool _write_content_hosting_configuration(msaf_json_writer_t *writer, const void *content_hosting_configuration);
 
 /***** Public functions *****/
 
 int
 msaf_application_server_state_set_on_post( msaf_provisioning_session_t *provisioning_session)
 {
-    msaf_application_server_node_t *msaf_as;
-    msaf_application_server_state_node_t *as_state;
-    resource_id_node_t *chc;
-    assigned_provisioning_sessions_node_t *assigned_provisioning_sessions;
-    ogs_list_t *certs;
-    ogs_lnode_t *node, *next_node;
+    return _state_queue_on_post(provisioning_session, true);
+}
 
-    msaf_as = ogs_list_first(&msaf_self()->config.applicationServers_list);
-    ogs_assert(msaf_as);
-    ogs_list_for_each(&msaf_self()->application_server_states, as_state){
-        if (as_state->application_server == msaf_as) {
-            msaf_application_server_state_ref_node_t *as_state_ref;
+void
+msaf_application_server_state_update( msaf_provisioning_session_t *provisioning_session)
+{
+    _state_queue_update(provisioning_session, true);
+}
 
-            certs = msaf_retrieve_certificates_from_map(provisioning_session);
-            if (certs) {
-                ogs_list_for_each_safe(certs, next_node, node) {
-                    ogs_list_remove(certs, node);
-                    ogs_list_add(&as_state->upload_certificates, node);
-                }
-                ogs_free(certs);
-            } else {
-                return 0;
-            }
+void
+msaf_application_server_state_update_changes(msaf_provisioning_session_t *provisioning_session,
+                                             const msaf_content_hosting_configuration_diff_t *diff)
+{
+    msaf_application_server_state_ref_node_t *as_state_ref;
 
-            chc = ogs_calloc(1, sizeof(resource_id_node_t));
-            ogs_assert(chc);
-            chc->state = msaf_strdup(provisioning_session->provisioningSessionId);
-            ogs_list_add(&as_state->upload_content_hosting_configurations, chc);
+    ogs_assert(provisioning_session);
+    ogs_assert(diff);
 
-            assigned_provisioning_sessions = ogs_calloc(1, sizeof(assigned_provisioning_sessions_node_t));
-            ogs_assert(assigned_provisioning_sessions);
-            assigned_provisioning_sessions->assigned_provisioning_session = provisioning_session;
-            ogs_list_add(&as_state->assigned_provisioning_sessions, assigned_provisioning_sessions);
+    ogs_list_for_each(&provisioning_session->application_server_states, as_state_ref) {
+        msaf_application_server_state_node_t *as_state = as_state_ref->as_state;
+        bool missing = !as_state->current_content_hosting_configurations ||
+                !_resource_id_queued(as_state->current_content_hosting_configurations, provisioning_session->provisioningSessionId);
 
-            ogs_list_init(&provisioning_session->application_server_states);
-            as_state_ref = ogs_calloc(1, sizeof(msaf_application_server_state_ref_node_t));
-            ogs_assert(as_state_ref);
-            as_state_ref->as_state = as_state;
-            ogs_list_add(&provisioning_session->application_server_states, as_state_ref);
+        /* An unchanged configuration is still sent to an Application Server that doesn't have it yet, so that repeating
+         * the PUT recovers an Application Server that missed or failed an earlier upload. */
+        if (!diff->changed && !missing) continue;
 
-            next_action_for_application_server(as_state);
+        /* New certificates need checking against the ones already on the Application Server. So does a configuration the
+         * Application Server does not have yet, as its certificates may not have been available when it was last sent. */
+        if (diff->certificates_added || missing) {
+            _state_queue_update_as(as_state, provisioning_session, true);
+            continue;
         }
+
+        /* the certificates are already there, only the configuration needs sending again */
+        _queue_content_hosting_configuration(as_state, provisioning_session->provisioningSessionId);
+        next_action_for_application_server(as_state);
     }
-    return 1;
 }
 
-void
-msaf_application_server_state_update( msaf_provisioning_session_t *provisioning_session)
+int
+msaf_application_server_state_queue(msaf_provisioning_session_t *provisioning_session)
 {
-    msaf_application_server_state_ref_node_t *as_state_ref;
+    ogs_assert(provisioning_session);
 
-    ogs_list_for_each(&provisioning_session->application_server_states, as_state_ref){
-        resource_id_node_t *chc;
-        msaf_application_server_state_node_t *as_state = as_state_ref->as_state;
-        ogs_list_t *certs = msaf_retrieve_certificates_from_map(provisioning_session);
-        if (certs) {
-            resource_id_node_t *next_node, *node;
-            ogs_list_for_each_safe(certs, next_node, node) {
-                int upload_cert = 1;
-                resource_id_node_t *cur_cert;
-                /* Check if the certificate is already uploaded */
-                ogs_list_for_each(as_state->current_certificates, cur_cert) {
-                    if (!strcmp(node->state, cur_cert->state)) {
-                        upload_cert = 0;
-                        break;
-                    }
+    if (ogs_list_first(&provisioning_session->application_server_states) == NULL)
+        return _state_queue_on_post(provisioning_session, false);
 
-                }
-                /* If there is a new certificate for this AS, upload it */
-                if (upload_cert) {
-                    ogs_list_remove(certs, node);
-                    ogs_list_add(&as_state->upload_certificates, node);
-                }
-            }
-            /* free any cert map nodes left in the list (didn't need update) */
-            ogs_list_for_each_safe(certs, next_node, node) {
-                ogs_list_remove(certs, node);
-                if (node->state) ogs_free(node->state);
-                ogs_free(node);
-            }
-            ogs_free(certs);
-        } else {
-            continue;
-        }
+    _state_queue_update(provisioning_session, false);
+    return 1;
+}
 
-        chc = ogs_calloc(1, sizeof(resource_id_node_t));
-        ogs_assert(chc);
-        chc->state = msaf_strdup(provisioning_session->provisioningSessionId);
-        ogs_list_add(&as_state->upload_content_hosting_configurations, chc);
+void
+msaf_application_server_state_flush(void)
+{
+    msaf_application_server_state_node_t *as_state;
 
-        next_action_for_application_server(as_state);
+    ogs_list_for_each(&msaf_self()->application_server_states, as_state) {
+        if (ogs_list_first(&as_state->upload_certificates) || ogs_list_first(&as_state->upload_content_hosting_configurations))
+            next_action_for_application_server(as_state);
     }
 }
 
@@ -244,7 +222,6 @@ void next_action_for_application_server(msaf_application_server_state_node_t *as
         char *data;
         char *component;
         resource_id_node_t *chc_id_node;
-        cJSON *json;
 
         resource_id_node_t *upload_chc = ogs_list_first(&as_state->upload_content_hosting_configurations);
         ogs_list_for_each(as_state->current_content_hosting_configurations, chc_id_node) {
@@ -257,8 +234,7 @@ void next_action_for_application_server(msaf_application_server_state_node_t *as
 
         chc_with_af_unique_cert_id = msaf_content_hosting_configuration_with_af_unique_cert_id(provisioning_session);
 
-        json = msaf_api_content_hosting_configuration_convertResponseToJSON(chc_with_af_unique_cert_id);
-        data = cJSON_Print(json);
+        data = msaf_json_write(_write_content_hosting_configuration, chc_with_af_unique_cert_id, 0, NULL);
 
         component = ogs_msprintf("content-hosting-configurations/%s", upload_chc->state);
 
@@ -271,8 +247,7 @@ void next_action_for_application_server(msaf_application_server_state_node_t *as
         }
         if (chc_with_af_unique_cert_id) msaf_api_content_hosting_configuration_free(chc_with_af_unique_cert_id);
         ogs_free(component);
-        cJSON_Delete(json);
-        cJSON_free(data);
+        if (data) ogs_free(data);
 
     }   else if (ogs_list_first(&as_state->delete_content_hosting_configurations) !=  NULL) {
         char *component;
@@ -327,6 +302,125 @@ void msaf_application_server_print_all()
 
 /***** Private functions *****/
 
+static int _state_queue_on_post(msaf_provisioning_session_t *provisioning_session, bool send)
+{
+    msaf_application_server_node_t *msaf_as;
+    msaf_application_server_state_node_t *as_state;
+    assigned_provisioning_sessions_node_t *assigned_provisioning_sessions;
+    ogs_list_t *certs;
+    ogs_lnode_t *node, *next_node;
+
+    msaf_as = ogs_list_first(&msaf_self()->config.applicationServers_list);
+    ogs_assert(msaf_as);
+    ogs_list_for_each(&msaf_self()->application_server_states, as_state){
+        if (as_state->application_server == msaf_as) {
+            msaf_application_server_state_ref_node_t *as_state_ref;
+
+            certs = msaf_retrieve_certificates_from_map(provisioning_session);
+            if (certs) {
+                ogs_list_for_each_safe(certs, next_node, node) {
+                    ogs_list_remove(certs, node);
+                    ogs_list_add(&as_state->upload_certificates, node);
+                }
+                ogs_free(certs);
+            } else {
+                return 0;
+            }
+
+            _queue_content_hosting_configuration(as_state, provisioning_session->provisioningSessionId);
+
+            assigned_provisioning_sessions = ogs_calloc(1, sizeof(assigned_provisioning_sessions_node_t));
+            ogs_assert(assigned_provisioning_sessions);
+            assigned_provisioning_sessions->assigned_provisioning_session = provisioning_session;
+            ogs_list_add(&as_state->assigned_provisioning_sessions, assigned_provisioning_sessions);
+
+            ogs_list_init(&provisioning_session->application_server_states);
+            as_state_ref = ogs_calloc(1, sizeof(msaf_application_server_state_ref_node_t));
+            ogs_assert(as_state_ref);
+            as_state_ref->as_state = as_state;
+            ogs_list_add(&provisioning_session->application_server_states, as_state_ref);
+
+            if (send) next_action_for_application_server(as_state);
+        }
+    }
+    return 1;
+}
+
+static void _state_queue_update(msaf_provisioning_session_t *provisioning_session, bool send)
+{
+    msaf_application_server_state_ref_node_t *as_state_ref;
+
+    ogs_list_for_each(&provisioning_session->application_server_states, as_state_ref){
+        _state_queue_update_as(as_state_ref->as_state, provisioning_session, send);
+    }
+}
+
+static void _state_queue_update_as(msaf_application_server_state_node_t *as_state, msaf_provisioning_session_t *provisioning_session,
+                                   bool send)
+{
+    ogs_list_t *certs = msaf_retrieve_certificates_from_map(provisioning_session);
+
+    if (certs) {
+        resource_id_node_t *next_node, *node;
+        ogs_list_for_each_safe(certs, next_node, node) {
+            int upload_cert = 1;
+            resource_id_node_t *cur_cert;
+            /* Check if the certificate is already uploaded */
+            ogs_list_for_each(as_state->current_certificates, cur_cert) {
+                if (!strcmp(node->state, cur_cert->state)) {
+                    upload_cert = 0;
+                    break;
+                }
+
+            }
+            /* or already waiting to be uploaded */
+            if (upload_cert && _resource_id_queued(&as_state->upload_certificates, node->state)) upload_cert = 0;
+            /* If there is a new certificate for this AS, upload it */
+            if (upload_cert) {
+                ogs_list_remove(certs, node);
+                ogs_list_add(&as_state->upload_certificates, node);
+            }
+        }
+        /* free any cert map nodes left in the list (didn't need update) */
+        ogs_list_for_each_safe(certs, next_node, node) {
+            ogs_list_remove(certs, node);
+            if (node->state) ogs_free(node->state);
+            ogs_free(node);
+        }
+        ogs_free(certs);
+    } else {
+        return;
+    }
+
+    _queue_content_hosting_configuration(as_state, provisioning_session->provisioningSessionId);
+
+    if (send) next_action_for_application_server(as_state);
+}
+
+/* The upload reads the configuration when it is sent, so one queued upload per provisioning session is enough */
+static void _queue_content_hosting_configuration(msaf_application_server_state_node_t *as_state, const char *provisioning_session_id)
+{
+    resource_id_node_t *chc;
+
+    if (_resource_id_queued(&as_state->upload_content_hosting_configurations, provisioning_session_id)) return;
+
+    chc = ogs_calloc(1, sizeof(resource_id_node_t));
+    ogs_assert(chc);
+    chc->state = msaf_strdup(provisioning_session_id);
+    ogs_list_add(&as_state->upload_content_hosting_configurations, chc);
+}
+
+static bool _resource_id_queued(ogs_list_t *list, const char *id)
+{
+    resource_id_node_t *node;
+
+    ogs_list_for_each(list, node) {
+        if (!strcmp(node->state, id)) return true;
+    }
+
+    return false;
+}
+
 static void application_server_state_init(msaf_application_server_node_t *msaf_as)
 {
     msaf_application_server_state_node_t *as_state = NULL;
@@ -343,6 +437,12 @@ static void application_server_state_init(msaf_application_server_node_t *msaf_a
     ogs_list_add(&msaf_self()->application_server_states, as_state);
 }
 
+static bool _write_content_hosting_configuration(msaf_json_writer_t *writer, const void *content_hosting_configuration)
+{
+    return msaf_api_content_hosting_configuration_writeResponseJSON(writer,
+                                            (const msaf_api_content_hosting_configuration_t*)content_hosting_configuration);
+}
+
 static void msaf_application_server_remove(msaf_application_server_node_t *msaf_as)
 {
     ogs_assert(msaf_as);
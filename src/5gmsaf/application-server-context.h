@@ -79,6 +79,17 @@ extern void msaf_application_server_print_all(void);
 extern void next_action_for_application_server(msaf_application_server_state_node_t *as_state);
 extern int msaf_application_server_state_set_on_post( msaf_provisioning_session_t *provisioning_session);
 extern void msaf_application_server_state_update( msaf_provisioning_session_t *provisioning_session);
+/* As msaf_application_server_state_update() for a Content Hosting Configuration change, but only sends what diff says has
+ * changed. If the configuration is unchanged it is only sent to Application Servers that don't have it yet, and the
+ * certificates are only checked if new ones are used or the Application Server doesn't have the configuration. */
+extern void msaf_application_server_state_update_changes(msaf_provisioning_session_t *provisioning_session,
+                                                         const msaf_content_hosting_configuration_diff_t *diff);
+
+/* Queue the certificate and content hosting configuration uploads for a provisioning session, as
+ * msaf_application_server_state_set_on_post() or msaf_application_server_state_update() would, without starting the M3
+ * requests. Call msaf_application_server_state_flush() once everything is queued. */
+extern int msaf_application_server_state_queue(msaf_provisioning_session_t *provisioning_session);
+extern void msaf_application_server_state_flush(void);
 
 
 #ifdef __cplusplus
@@ -0,0 +1,579 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#include "application-server-context.h"
+#include "certmgr.h"
+#include "consumption-report-configuration.h"
+#include "context.h"
+#include "metrics-reporting-configuration.h"
+#include "policy-template.h"
+#include "provisioning-session.h"
+#include "provisioning-session-journal.h"
+#include "utilities.h"
+
+#include "openapi/model/msaf_api_consumption_reporting_configuration.h"
+#include "openapi/model/msaf_api_content_hosting_configuration.h"
+#include "openapi/model/msaf_api_metrics_reporting_configuration.h"
+#include "openapi/model/msaf_api_policy_template.h"
+#include "openapi/model/msaf_api_provisioning_session_type.h"
+
+#include "bulk-provisioning.h"
+
+/* One provisioning session definition from the request */
+typedef struct bulk_item_s {
+    cJSON *definition;                      /* [no-transfer] */
+    msaf_provisioning_session_t *session;   /* existing session, or the new one once created */
+    bool created;
+    const char *provisioning_session_type;  /* [no-transfer] new sessions only */
+    const char *app_id;                     /* [no-transfer] new sessions only */
+    const char *asp_id;                     /* [no-transfer] new sessions only */
+    cJSON *certificates;                    /* [no-transfer] serverCertificates placeholders */
+    char **certificate_ids;                 /* new certificate ids, in placeholder order */
+    msaf_api_content_hosting_configuration_t *content_hosting_configuration; /* placeholders replaced when applied */
+    msaf_api_consumption_reporting_configuration_t *consumption_reporting_configuration;
+    msaf_api_policy_template_t **policy_templates;
+    int num_policy_templates;
+    msaf_api_metrics_reporting_configuration_t **metrics_reporting_configurations;
+    int num_metrics_reporting_configurations;
+    cJSON *result;
+} bulk_item_t;
+
+static bool _item_parse(bulk_item_t *item, bulk_item_t *items, int index);
+static bool _item_parse_certificates(bulk_item_t *item);
+static bool _item_parse_content_hosting_configuration(bulk_item_t *item);
+static bool _item_parse_consumption_reporting_configuration(bulk_item_t *item);
+static bool _item_parse_policy_templates(bulk_item_t *item);
+static bool _item_parse_metrics_reporting_configurations(bulk_item_t *item);
+static bool _item_create(bulk_item_t *item);
+static void _item_rollback(bulk_item_t *item);
+static void _item_commit(bulk_item_t *item);
+static void _item_clear(bulk_item_t *item);
+static void _item_fail(bulk_item_t *item, int status, const char *fmt, ...);
+static void _items_abandon(bulk_item_t *items, int num_items, int failed_status);
+static const char *_certificate_placeholder_id(const bulk_item_t *item, const char *placeholder);
+static cJSON *_get_optional(cJSON *definition, const char *field, int type, bulk_item_t *item);
+
+/***** Public functions *****/
+
+cJSON *msaf_bulk_provisioning_apply(cJSON *definitions, int *status_out)
+{
+    bulk_item_t *items;
+    cJSON *definition;
+    cJSON *results;
+    int num_items;
+    int i;
+    bool valid = true;
+
+    ogs_assert(definitions);
+    ogs_assert(status_out);
+
+    num_items = cJSON_GetArraySize(definitions);
+    items = ogs_calloc(num_items?num_items:1, sizeof(*items));
+    ogs_assert(items);
+
+    /* validate everything first, so that nothing is changed if any definition is bad */
+    i = 0;
+    cJSON_ArrayForEach(definition, definitions) {
+        items[i].definition = definition;
+        items[i].result = cJSON_CreateObject();
+        if (!_item_parse(&items[i], items, i)) valid = false;
+        i++;
+    }
+
+    if (!valid) {
+        _items_abandon(items, num_items, OGS_SBI_HTTP_STATUS_BAD_REQUEST);
+        *status_out = OGS_SBI_HTTP_STATUS_BAD_REQUEST;
+    } else {
+        /* create the new sessions and certificates, the only steps that can fail once validated */
+        for (i = 0; i < num_items; i++) {
+            if (!_item_create(&items[i])) {
+                valid = false;
+                break;
+            }
+        }
+
+        if (!valid) {
+            for (i = 0; i < num_items; i++) _item_rollback(&items[i]);
+            _items_abandon(items, num_items, OGS_SBI_HTTP_STATUS_INTERNAL_SERVER_ERROR);
+            *status_out = OGS_SBI_HTTP_STATUS_INTERNAL_SERVER_ERROR;
+        } else {
+            /* everything from the request was checked when it was parsed, so the rest cannot be refused */
+            for (i = 0; i < num_items; i++) _item_commit(&items[i]);
+            *status_out = OGS_SBI_HTTP_STATUS_OK;
+            /* one round of M3 uploads for the whole request */
+            msaf_application_server_state_flush();
+        }
+    }
+
+    results = cJSON_CreateArray();
+    ogs_assert(results);
+    for (i = 0; i < num_items; i++) {
+        cJSON_AddItemToArray(results, items[i].result);
+        items[i].result = NULL;
+        _item_clear(&items[i]);
+    }
+    ogs_free(items);
+
+    ogs_info("Bulk provisioning of %i Provisioning Sessions %s", num_items,
+             (*status_out == OGS_SBI_HTTP_STATUS_OK)?"applied":"rejected");
+
+    return results;
+}
+
+/***** Private functions *****/
+
+static bool _item_parse(bulk_item_t *item, bulk_item_t *items, int index)
+{
+    cJSON *field;
+    int i;
+
+    if (!cJSON_IsObject(item->definition)) {
+        _item_fail(item, OGS_SBI_HTTP_STATUS_BAD_REQUEST, "Provisioning session definition must be an object");
+        return false;
+    }
+
+    field = _get_optional(item->definition, "provisioningSessionId", cJSON_String, item);
+    if (!field && cJSON_GetObjectItemCaseSensitive(item->definition, "provisioningSessionId")) return false;
+    if (field) {
+        cJSON_AddStringToObject(item->result, "provisioningSessionId", field->valuestring);
+        item->session = msaf_provisioning_session_find_by_provisioningSessionId(field->valuestring);
+        if (!item->session || item->session->marked_for_deletion) {
+            item->session = NULL;
+            _item_fail(item, OGS_SBI_HTTP_STATUS_NOT_FOUND, "Provisioning Session [%s] does not exist", field->valuestring);
+            return false;
+        }
+        for (i = 0; i < index; i++) {
+            if (items[i].session == item->session) {
+                _item_fail(item, OGS_SBI_HTTP_STATUS_BAD_REQUEST, "Provisioning Session [%s] is already defined by entry %i",
+                           field->valuestring, i);
+                return false;
+            }
+        }
+    } else {
+        field = cJSON_GetObjectItemCaseSensitive(item->definition, "provisioningSessionType");
+        if (!cJSON_IsString(field) ||
+                msaf_api_provisioning_session_type_FromString(field->valuestring) == msaf_api_provisioning_session_type_NULL) {
+            _item_fail(item, OGS_SBI_HTTP_STATUS_BAD_REQUEST, "\"provisioningSessionType\" must be a provisioning session type");
+            return false;
+        }
+        item->provisioning_session_type = field->valuestring;
+
+        field = cJSON_GetObjectItemCaseSensitive(item->definition, "appId");
+        if (!cJSON_IsString(field)) {
+            _item_fail(item, OGS_SBI_HTTP_STATUS_BAD_REQUEST, "\"appId\" must be a string");
+            return false;
+        }
+        item->app_id = field->valuestring;
+
+        field = _get_optional(item->definition, "aspId", cJSON_String, item);
+        if (!field && cJSON_GetObjectItemCaseSensitive(item->definition, "aspId")) return false;
+        if (field) item->asp_id = field->valuestring;
+    }
+
+    if (!_item_parse_certificates(item)) return false;
+    if (!_item_parse_content_hosting_configuration(item)) return false;
+    if (!_item_parse_consumption_reporting_configuration(item)) return false;
+    if (!_item_parse_policy_templates(item)) return false;
+    if (!_item_parse_metrics_reporting_configurations(item)) return false;
+
+    return true;
+}
+
+static bool _item_parse_certificates(bulk_item_t *item)
+{
+    cJSON *placeholder;
+    cJSON *other;
+
+    item->certificates = _get_optional(item->definition, "serverCertificates", cJSON_Array, item);
+    if (!item->certificates) return !cJSON_GetObjectItemCaseSensitive(item->definition, "serverCertificates");
+
+    cJSON_ArrayForEach(placeholder, item->certificates) {
+        if (!cJSON_IsString(placeholder) || !placeholder->valuestring[0]) {
+            _item_fail(item, OGS_SBI_HTTP_STATUS_BAD_REQUEST, "\"serverCertificates\" entries must be non-empty strings");
+            return false;
+        }
+        for (other = item->certificates->child; other != placeholder; other = other->next) {
+            if (!strcmp(other->valuestring, placeholder->valuestring)) {
+                _item_fail(item, OGS_SBI_HTTP_STATUS_BAD_REQUEST, "Server certificate [%s] appears more than once",
+                           placeholder->valuestring);
+                return false;
+            }
+        }
+    }
+
+    item->certificate_ids = ogs_calloc(cJSON_GetArraySize(item->certificates) + 1, sizeof(char*));
+    ogs_assert(item->certificate_ids);
+
+    return true;
+}
+
+static bool _item_parse_content_hosting_configuration(bulk_item_t *item)
+{
+    cJSON *json;
+    msaf_api_content_hosting_configuration_t *chc;
+    OpenAPI_lnode_t *node;
+    const char *reason = NULL;
+
+    json = _get_optional(item->definition, "contentHostingConfiguration", cJSON_Object, item);
+    if (!json) return !cJSON_GetObjectItemCaseSensitive(item->definition, "contentHostingConfiguration");
+
+    chc = msaf_content_hosting_configuration_parse(json, &reason);
+    if (!chc) {
+        _item_fail(item, OGS_SBI_HTTP_STATUS_BAD_REQUEST, "Bad ContentHostingConfiguration: %s", reason?reason:"invalid");
+        return false;
+    }
+
+    /* each certificateId must be a new certificate from this definition or already belong to the session */
+    OpenAPI_list_for_each(chc->distribution_configurations, node) {
+        msaf_api_distribution_configuration_t *dist_config = node->data;
+
+        if (!dist_config->certificate_id) continue;
+        if (_certificate_placeholder_id(item, dist_config->certificate_id)) continue;
+        if (item->session && ogs_hash_get(item->session->certificate_map, dist_config->certificate_id, OGS_HASH_KEY_STRING))
+            continue;
+
+        _item_fail(item, OGS_SBI_HTTP_STATUS_BAD_REQUEST, "ContentHostingConfiguration uses unknown certificate [%s]",
+                   dist_config->certificate_id);
+        msaf_api_content_hosting_configuration_free(chc);
+        return false;
+    }
+
+    /* kept as parsed, so applying it cannot find anything wrong with it */
+    item->content_hosting_configuration = chc;
+
+    return true;
+}
+
+static bool _item_parse_consumption_reporting_configuration(bulk_item_t *item)
+{
+    cJSON *json;
+    const char *reason = NULL;
+
+    json = _get_optional(item->definition, "consumptionReportingConfiguration", cJSON_Object, item);
+    if (!json) return !cJSON_GetObjectItemCaseSensitive(item->definition, "consumptionReportingConfiguration");
+
+    item->consumption_reporting_configuration = msaf_consumption_report_configuration_parseJSON(json, &reason);
+    if (!item->consumption_reporting_configuration) {
+        _item_fail(item, OGS_SBI_HTTP_STATUS_BAD_REQUEST, "Bad ConsumptionReportingConfiguration: %s", reason?reason:"invalid");
+        return false;
+    }
+
+    return true;
+}
+
+static bool _item_parse_policy_templates(bulk_item_t *item)
+{
+    cJSON *array;
+    cJSON *json;
+
+    array = _get_optional(item->definition, "policyTemplates", cJSON_Array, item);
+    if (!array) return !cJSON_GetObjectItemCaseSensitive(item->definition, "policyTemplates");
+    if (!cJSON_GetArraySize(array)) return true;
+
+    if (!msaf_self()->config.open5gsIntegration_flag) {
+        _item_fail(item, OGS_SBI_HTTP_STATUS_BAD_REQUEST,
+                   "Policy Templates are not available on this instance of the 5GMS Application Function");
+        return false;
+    }
+
+    item->policy_templates = ogs_calloc(cJSON_GetArraySize(array), sizeof(*item->policy_templates));
+    ogs_assert(item->policy_templates);
+
+    cJSON_ArrayForEach(json, array) {
+        msaf_api_policy_template_t *policy_template;
+        const char *reason = NULL;
+
+        policy_template = cJSON_IsObject(json)?msaf_policy_template_parseFromJSON(json, &reason):NULL;
+        msaf_policy_template_extra_validation(&policy_template, &reason);
+        if (!policy_template) {
+            _item_fail(item, OGS_SBI_HTTP_STATUS_BAD_REQUEST, "Bad PolicyTemplate: %s", reason?reason:"invalid");
+            return false;
+        }
+        msaf_policy_template_remove_read_only(policy_template);
+        item->policy_templates[item->num_policy_templates++] = policy_template;
+    }
+
+    return true;
+}
+
+static bool _item_parse_metrics_reporting_configurations(bulk_item_t *item)
+{
+    cJSON *array;
+    cJSON *json;
+
+    array = _get_optional(item->definition, "metricsReportingConfigurations", cJSON_Array, item);
+    if (!array) return !cJSON_GetObjectItemCaseSensitive(item->definition, "metricsReportingConfigurations");
+    if (!cJSON_GetArraySize(array)) return true;
+
+    item->metrics_reporting_configurations = ogs_calloc(cJSON_GetArraySize(array), sizeof(*item->metrics_reporting_configurations));
+    ogs_assert(item->metrics_reporting_configurations);
+
+    cJSON_ArrayForEach(json, array) {
+        msaf_api_metrics_reporting_configuration_t *config;
+        const char *reason = NULL;
+
+        config = cJSON_IsObject(json)?msaf_metrics_reporting_configuration_parseJSON(json, &reason):NULL;
+        if (!config) {
+            _item_fail(item, OGS_SBI_HTTP_STATUS_BAD_REQUEST, "Bad MetricsReportingConfiguration: %s", reason?reason:"invalid");
+            return false;
+        }
+        item->metrics_reporting_configurations[item->num_metrics_reporting_configurations++] = config;
+    }
+
+    return true;
+}
+
+static bool _item_create(bulk_item_t *item)
+{
+    msaf_application_server_node_t *msaf_as;
+    cJSON *placeholder;
+    int i = 0;
+
+    if (!item->session) {
+        item->session = msaf_provisioning_session_create(item->provisioning_session_type, item->asp_id, item->app_id);
+        ogs_assert(item->session);
+        item->created = true;
+    }
+
+    if (!item->certificates) return true;
+
+    msaf_as = ogs_list_first(&msaf_self()->config.applicationServers_list);
+    ogs_assert(msaf_as);
+
+    cJSON_ArrayForEach(placeholder, item->certificates) {
+        msaf_certificate_t *cert;
+
+        cert = server_cert_new("newcert", msaf_as->canonicalHostname, NULL);
+        if (!cert || cert->return_code != 0) {
+            _item_fail(item, OGS_SBI_HTTP_STATUS_INTERNAL_SERVER_ERROR, "Unable to create server certificate [%s]",
+                       placeholder->valuestring);
+            if (cert) msaf_certificate_free(cert);
+            return false;
+        }
+        item->certificate_ids[i++] = msaf_strdup(cert->id);
+        msaf_certificate_free(cert);
+    }
+
+    return true;
+}
+
+static void _item_rollback(bulk_item_t *item)
+{
+    int i;
+
+    if (item->certificate_ids) {
+        for (i = 0; item->certificate_ids[i]; i++) {
+            server_cert_delete(item->certificate_ids[i]);
+            ogs_free(item->certificate_ids[i]);
+            item->certificate_ids[i] = NULL;
+        }
+    }
+
+    if (item->created) {
+        msaf_provisioning_session_hash_remove(item->session->provisioningSessionId);
+        msaf_provisioning_session_free(item->session);
+        item->created = false;
+    }
+    item->session = NULL;
+}
+
+/* Apply the validated definition, the session and certificates already exist */
+static void _item_commit(bulk_item_t *item)
+{
+    msaf_provisioning_session_t *session = item->session;
+    cJSON *placeholder;
+    int i;
+
+    if (item->created) msaf_provisioning_session_journal_provisioning_session(session->provisioningSessionId);
+    cJSON_DeleteItemFromObjectCaseSensitive(item->result, "provisioningSessionId");
+    cJSON_AddStringToObject(item->result, "provisioningSessionId", session->provisioningSessionId);
+
+    if (item->certificates) {
+        cJSON *ids = cJSON_AddObjectToObject(item->result, "serverCertificates");
+
+        i = 0;
+        cJSON_ArrayForEach(placeholder, item->certificates) {
+            const char *id = item->certificate_ids[i++];
+
+            msaf_provisioning_session_certificate_add(session, id);
+            msaf_provisioning_session_changed(session);
+            msaf_provisioning_session_journal_certificate(session, id);
+            cJSON_AddStringToObject(ids, placeholder->valuestring, id);
+        }
+    }
+
+    if (item->content_hosting_configuration) {
+        OpenAPI_lnode_t *node;
+
+        OpenAPI_list_for_each(item->content_hosting_configuration->distribution_configurations, node) {
+            msaf_api_distribution_configuration_t *dist_config = node->data;
+            const char *id;
+
+            if (!dist_config->certificate_id) continue;
+            id = _certificate_placeholder_id(item, dist_config->certificate_id);
+            if (id) {
+                char *certificate_id = msaf_strdup(id);
+                ogs_free(dist_config->certificate_id);
+                dist_config->certificate_id = certificate_id;
+            }
+        }
+
+        /* msaf_distribution_create_from_model() takes the model */
+        msaf_distribution_create_from_model(item->content_hosting_configuration, session);
+        item->content_hosting_configuration = NULL;
+        msaf_provisioning_session_journal_content_hosting_configuration(session);
+
+        /* the certificates were all checked to be in the session when the definition was validated */
+        if (!msaf_application_server_state_queue(session)) {
+            ogs_error("Unable to queue the ContentHostingConfiguration of Provisioning Session [%s] for the Application Servers",
+                      session->provisioningSessionId);
+        }
+    }
+
+    if (item->consumption_reporting_configuration) {
+        if (session->consumptionReportingConfiguration) {
+            msaf_consumption_report_configuration_update(session, item->consumption_reporting_configuration);
+        } else {
+            msaf_consumption_report_configuration_register(session, item->consumption_reporting_configuration);
+        }
+        item->consumption_reporting_configuration = NULL;
+        msaf_provisioning_session_journal_consumption_reporting_configuration(session);
+    }
+
+    if (item->num_policy_templates) {
+        cJSON *ids = cJSON_AddArrayToObject(item->result, "policyTemplateIds");
+
+        for (i = 0; i < item->num_policy_templates; i++) {
+            msaf_api_policy_template_t *policy_template = item->policy_templates[i];
+
+            item->policy_templates[i] = NULL;
+            /* this only fails to queue the move to PENDING, the policy template has still been added */
+            if (!msaf_provisioning_session_add_policy_template(session, policy_template, time(NULL))) {
+                ogs_error("Unable to start processing Policy Template [%s] of Provisioning Session [%s]",
+                          policy_template->policy_template_id, session->provisioningSessionId);
+            }
+            msaf_provisioning_session_journal_policy_template(session, policy_template->policy_template_id);
+            cJSON_AddItemToArray(ids, cJSON_CreateString(policy_template->policy_template_id));
+        }
+    }
+
+    if (item->num_metrics_reporting_configurations) {
+        cJSON *ids = cJSON_AddArrayToObject(item->result, "metricsReportingConfigurationIds");
+
+        for (i = 0; i < item->num_metrics_reporting_configurations; i++) {
+            msaf_metrics_reporting_configuration_node_t *node;
+
+            node = msaf_metrics_reporting_configuration_register(session, item->metrics_reporting_configurations[i]);
+            item->metrics_reporting_configurations[i] = NULL;
+            msaf_provisioning_session_journal_metrics_reporting_configuration(session, node->config->metrics_reporting_configuration_id);
+            cJSON_AddItemToArray(ids, cJSON_CreateString(node->config->metrics_reporting_configuration_id));
+        }
+    }
+
+    cJSON_AddNumberToObject(item->result, "status", item->created?OGS_SBI_HTTP_STATUS_CREATED:OGS_SBI_HTTP_STATUS_OK);
+}
+
+static void _item_clear(bulk_item_t *item)
+{
+    int i;
+
+    if (item->certificate_ids) {
+        for (i = 0; item->certificate_ids[i]; i++) ogs_free(item->certificate_ids[i]);
+        ogs_free(item->certificate_ids);
+    }
+    if (item->content_hosting_configuration)
+        msaf_api_content_hosting_configuration_free(item->content_hosting_configuration);
+    if (item->consumption_reporting_configuration)
+        msaf_api_consumption_reporting_configuration_free(item->consumption_reporting_configuration);
+    if (item->policy_templates) {
+        for (i = 0; i < item->num_policy_templates; i++) {
+            if (item->policy_templates[i]) msaf_api_policy_template_free(item->policy_templates[i]);
+        }
+        ogs_free(item->policy_templates);
+    }
+    if (item->metrics_reporting_configurations) {
+        for (i = 0; i < item->num_metrics_reporting_configurations; i++) {
+            if (item->metrics_reporting_configurations[i])
+                msaf_api_metrics_reporting_configuration_free(item->metrics_reporting_configurations[i]);
+        }
+        ogs_free(item->metrics_reporting_configurations);
+    }
+    if (item->result) cJSON_Delete(item->result);
+    memset(item, 0, sizeof(*item));
+}
+
+static void _item_fail(bulk_item_t *item, int status, const char *fmt, ...)
+{
+    va_list ap;
+    char detail[512];
+
+    va_start(ap, fmt);
+    ogs_vsnprintf(detail, sizeof(detail), fmt, ap);
+    va_end(ap);
+
+    ogs_error("Bulk provisioning: %s", detail);
+    cJSON_AddNumberToObject(item->result, "status", status);
+    cJSON_AddStringToObject(item->result, "detail", detail);
+}
+
+/* Mark the entries that did not fail themselves as not applied because of the entries that did */
+static void _items_abandon(bulk_item_t *items, int num_items, int failed_status)
+{
+    int i;
+
+    for (i = 0; i < num_items; i++) {
+        if (cJSON_GetObjectItemCaseSensitive(items[i].result, "status")) continue;
+        cJSON_AddNumberToObject(items[i].result, "status", 424 /* Failed Dependency */);
+        cJSON_AddStringToObject(items[i].result, "detail",
+                                (failed_status == OGS_SBI_HTTP_STATUS_BAD_REQUEST)?
+                                    "Not applied because another entry is invalid":
+                                    "Not applied because another entry could not be applied");
+    }
+}
+
+static const char *_certificate_placeholder_id(const bulk_item_t *item, const char *placeholder)
+{
+    cJSON *entry;
+    int i = 0;
+
+    cJSON_ArrayForEach(entry, item->certificates) {
+        if (!strcmp(entry->valuestring, placeholder)) {
+            /* NULL ids while validating still show the placeholder exists */
+            return item->certificate_ids[i]?item->certificate_ids[i]:entry->valuestring;
+        }
+        i++;
+    }
+
+    return NULL;
+}
+
+/* Returns the field if present and of the right type, NULL if absent or, with the item failed, of the wrong type */
+static cJSON *_get_optional(cJSON *definition, const char *field, int type, bulk_item_t *item)
+{
+    cJSON *value = cJSON_GetObjectItemCaseSensitive(definition, field);
+
+    if (!value) return NULL;
+    if ((value->type & 0xff) != type) {
+        _item_fail(item, OGS_SBI_HTTP_STATUS_BAD_REQUEST, "\"%s\" has the wrong type", field);
+        return NULL;
+    }
+
+    return value;
+}
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,59 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#ifndef MSAF_BULK_PROVISIONING_H
+#define MSAF_BULK_PROVISIONING_H
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bulk provisioning, for POST /5gmag-rt-management/v1/provisioning-sessions
+ *
+ * The request is an array of provisioning session definitions:
+ *
+ *     {
+ *         "provisioningSessionId": "...",                   existing session to update, if omitted a new session is created
+ *         "provisioningSessionType": "DOWNLINK",            new sessions only
+ *         "appId": "...",                                   new sessions only
+ *         "aspId": "...",                                   new sessions only, optional
+ *         "serverCertificates": ["placeholder", ...],       new certificates to create, optional
+ *         "contentHostingConfiguration": {...},             optional, replaces any existing configuration
+ *         "consumptionReportingConfiguration": {...},       optional, replaces any existing configuration
+ *         "policyTemplates": [{...}, ...],                  optional, added to the session
+ *         "metricsReportingConfigurations": [{...}, ...]    optional, added to the session
+ *     }
+ *
+ * A certificateId in the contentHostingConfiguration may name one of the serverCertificates placeholders, which is replaced
+ * by the id of the new certificate, or an existing certificate of the provisioning session.
+ *
+ * Every definition is validated before anything is changed, including parsing the configurations it holds and checking the
+ * certificates it uses, and the new sessions and certificates are all created before any configuration is applied, so either
+ * all of the definitions are applied or none are. The certificate and content
+ * hosting configuration uploads to the Application Servers are queued for all the sessions and then started once.
+ *
+ * The result is an array with an entry for each definition, in the same order, giving its "status" (201 created, 200
+ * updated, or the failure status with a "detail"), the "provisioningSessionId" and the ids of the resources created.
+ */
+
+/* Apply the definitions, *status_out is set to 200 if they were all applied or an error status if none were */
+extern cJSON *msaf_bulk_provisioning_apply(cJSON *definitions /* [no-transfer, not-null] */, int *status_out /* [out, not-null] */);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
+
+#endif /* MSAF_BULK_PROVISIONING_H */
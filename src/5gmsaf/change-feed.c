@@ -0,0 +1,328 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+
+#include "ogs-core.h"
+#include "ogs-app.h"
+#include "ogs-sbi.h"
+
+#include "json-format.h"
+#include "server.h"
+#include "timer.h"
+#include "utilities.h"
+
+#include "change-feed.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Number of changes kept for clients to catch up with */
+#define CHANGE_FEED_LENGTH 1024
+
+typedef struct change_feed_entry_s {
+    uint64_t sequence;                /* 0 if unused */
+    time_t time;
+    const char *resource_type;
+    char *provisioning_session_id;
+    char *resource_id;
+    bool deleted;
+} change_feed_entry_t;
+
+struct msaf_change_feed_waiter_s {
+    ogs_lnode_t node;
+    ogs_sbi_stream_t *stream;         /* NULL once answered or closed by the client */
+    uint64_t after;
+    char *provisioning_session_id;
+    ogs_timer_t *timer;               /* the waiter is only freed by the event from this timer */
+    const nf_server_interface_metadata_t *api;
+    const nf_server_app_metadata_t *app_meta;
+};
+
+/* Only used from the event loop */
+static struct {
+    char feed_id[OGS_UUID_FORMATTED_LENGTH + 1];  /* "" until first used */
+    uint64_t last_sequence;
+    change_feed_entry_t entries[CHANGE_FEED_LENGTH];  /* indexed by sequence % CHANGE_FEED_LENGTH */
+    ogs_list_t waiters;
+    ogs_hash_t *waiters_by_stream;    /* unanswered waiters, keyed by the stream pointer */
+} change_feed;
+
+static const char *_feed_id(void);
+static change_feed_entry_t *_entry(uint64_t sequence);
+static void _entry_clear(change_feed_entry_t *entry);
+static bool _entry_matches(const change_feed_entry_t *entry, const char *provisioning_session_id);
+static cJSON *_entry_json(const change_feed_entry_t *entry);
+static bool _has_changes(uint64_t after, const char *provisioning_session_id);
+static void _send_changes(ogs_sbi_stream_t *stream, uint64_t after, const char *provisioning_session_id,
+                          const nf_server_interface_metadata_t *api, const nf_server_app_metadata_t *app_meta);
+static void _send_gone(ogs_sbi_stream_t *stream, const char *detail, const nf_server_interface_metadata_t *api,
+                       const nf_server_app_metadata_t *app_meta);
+static void _stream_closed(ogs_sbi_stream_t *stream);
+static void _waiter_answered(msaf_change_feed_waiter_t *waiter);
+static void _waiter_free(msaf_change_feed_waiter_t *waiter);
+
+/*****************************************************
+ ***** Public functions
+ *****************************************************/
+
+void msaf_change_feed_init(void)
+{
+    change_feed.waiters_by_stream = ogs_hash_make();
+    ogs_assert(change_feed.waiters_by_stream);
+
+    ogs_sbi_server_set_stream_closed_callback(_stream_closed);
+}
+
+void msaf_change_feed_final(void)
+{
+    msaf_change_feed_waiter_t *waiter, *next;
+    size_t i;
+
+    ogs_sbi_server_set_stream_closed_callback(NULL);
+
+    /* the server streams are already gone, so just free the waiters */
+    ogs_list_for_each_safe(&change_feed.waiters, next, waiter) {
+        _waiter_free(waiter);
+    }
+
+    if (change_feed.waiters_by_stream) {
+        ogs_hash_destroy(change_feed.waiters_by_stream);
+        change_feed.waiters_by_stream = NULL;
+    }
+
+    for (i = 0; i < CHANGE_FEED_LENGTH; i++) {
+        _entry_clear(&change_feed.entries[i]);
+    }
+}
+
+void msaf_change_feed_add(const char *resource_type, const char *provisioning_session_id, const char *resource_id, bool deleted)
+{
+    change_feed_entry_t *entry;
+    msaf_change_feed_waiter_t *waiter;
+
+    ogs_assert(resource_type);
+    ogs_assert(provisioning_session_id);
+
+    change_feed.last_sequence++;
+    entry = _entry(change_feed.last_sequence);
+    _entry_clear(entry);
+    entry->sequence = change_feed.last_sequence;
+    entry->time = time(NULL);
+    entry->resource_type = resource_type;
+    entry->provisioning_session_id = msaf_strdup(provisioning_session_id);
+    if (resource_id) entry->resource_id = msaf_strdup(resource_id);
+    entry->deleted = deleted;
+
+    ogs_list_for_each(&change_feed.waiters, waiter) {
+        if (!waiter->stream || !_entry_matches(entry, waiter->provisioning_session_id)) continue;
+        _send_changes(waiter->stream, waiter->after, waiter->provisioning_session_id, waiter->api, waiter->app_meta);
+        _waiter_answered(waiter);
+    }
+}
+
+void msaf_change_feed_watch(ogs_sbi_stream_t *stream, const char *feed_id, const uint64_t *after,
+                            const char *provisioning_session_id, int wait, const nf_server_interface_metadata_t *api,
+                            const nf_server_app_metadata_t *app_meta)
+{
+    msaf_change_feed_waiter_t *waiter;
+    uint64_t from;
+
+    ogs_assert(stream);
+
+    if (feed_id && strcmp(feed_id, _feed_id())) {
+        char *err = ogs_msprintf("The change feed [%s] is no longer available, the Application Function has restarted",
+                                 feed_id);
+        _send_gone(stream, err, api, app_meta);
+        ogs_free(err);
+        return;
+    }
+
+    from = after?*after:change_feed.last_sequence;
+    if (from > change_feed.last_sequence ||
+            (change_feed.last_sequence > CHANGE_FEED_LENGTH && from < change_feed.last_sequence - CHANGE_FEED_LENGTH)) {
+        char *err = ogs_msprintf("The changes after sequence %" PRIu64 " are not available", from);
+        _send_gone(stream, err, api, app_meta);
+        ogs_free(err);
+        return;
+    }
+
+    if (wait <= 0 || _has_changes(from, provisioning_session_id)) {
+        _send_changes(stream, from, provisioning_session_id, api, app_meta);
+        return;
+    }
+
+    if (wait > MSAF_CHANGE_FEED_MAX_WAIT) wait = MSAF_CHANGE_FEED_MAX_WAIT;
+
+    waiter = ogs_calloc(1, sizeof(*waiter));
+    ogs_assert(waiter);
+    waiter->stream = stream;
+    waiter->after = from;
+    if (provisioning_session_id) waiter->provisioning_session_id = msaf_strdup(provisioning_session_id);
+    waiter->api = api;
+    waiter->app_meta = app_meta;
+    waiter->timer = ogs_timer_add(ogs_app()->timer_mgr, msaf_timer_change_feed_wait, waiter);
+    ogs_assert(waiter->timer);
+    ogs_timer_start(waiter->timer, ogs_time_from_sec(wait));
+
+    ogs_list_add(&change_feed.waiters, waiter);
+    ogs_hash_set(change_feed.waiters_by_stream, &waiter->stream, sizeof(waiter->stream), waiter);
+}
+
+void msaf_change_feed_wait_expired(msaf_change_feed_waiter_t *waiter)
+{
+    ogs_assert(waiter);
+
+    /* nothing has changed, tell the client where it is up to */
+    if (waiter->stream) {
+        _send_changes(waiter->stream, waiter->after, waiter->provisioning_session_id, waiter->api, waiter->app_meta);
+    }
+
+    _waiter_free(waiter);
+}
+
+/*****************************************************
+ ***** Private functions
+ *****************************************************/
+
+static const char *_feed_id(void)
+{
+    if (!change_feed.feed_id[0]) {
+        ogs_uuid_t uuid;
+
+        ogs_uuid_get(&uuid);
+        ogs_uuid_format(change_feed.feed_id, &uuid);
+    }
+
+    return change_feed.feed_id;
+}
+
+static change_feed_entry_t *_entry(uint64_t sequence)
+{
+    return &change_feed.entries[sequence % CHANGE_FEED_LENGTH];
+}
+
+static void _entry_clear(change_feed_entry_t *entry)
+{
+    if (entry->provisioning_session_id) ogs_free(entry->provisioning_session_id);
+    if (entry->resource_id) ogs_free(entry->resource_id);
+    memset(entry, 0, sizeof(*entry));
+}
+
+static bool _entry_matches(const change_feed_entry_t *entry, const char *provisioning_session_id)
+{
+    return !provisioning_session_id || !strcmp(entry->provisioning_session_id, provisioning_session_id);
+}
+
+static cJSON *_entry_json(const change_feed_entry_t *entry)
+{
+    cJSON *json;
+    struct tm tm;
+    char timestamp[32];
+
+    gmtime_r(&entry->time, &tm);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &tm);
+
+    json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "sequence", (double)entry->sequence);
+    cJSON_AddStringToObject(json, "time", timestamp);
+    cJSON_AddStringToObject(json, "resourceType", entry->resource_type);
+    cJSON_AddStringToObject(json, "provisioningSessionId", entry->provisioning_session_id);
+    if (entry->resource_id) cJSON_AddStringToObject(json, "resourceId", entry->resource_id);
+    cJSON_AddStringToObject(json, "change", entry->deleted?"deleted":"updated");
+
+    return json;
+}
+
+static bool _has_changes(uint64_t after, const char *provisioning_session_id)
+{
+    uint64_t sequence;
+
+    for (sequence = after + 1; sequence <= change_feed.last_sequence; sequence++) {
+        if (_entry_matches(_entry(sequence), provisioning_session_id)) return true;
+    }
+
+    return false;
+}
+
+static void _send_changes(ogs_sbi_stream_t *stream, uint64_t after, const char *provisioning_session_id,
+                          const nf_server_interface_metadata_t *api, const nf_server_app_metadata_t *app_meta)
+{
+    cJSON *json;
+    cJSON *changes;
+    uint64_t sequence;
+    char *body;
+    ogs_sbi_response_t *response;
+
+    json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "feedId", _feed_id());
+    cJSON_AddNumberToObject(json, "lastSequence", (double)change_feed.last_sequence);
+    changes = cJSON_AddArrayToObject(json, "changes");
+    for (sequence = after + 1; sequence <= change_feed.last_sequence; sequence++) {
+        const change_feed_entry_t *entry = _entry(sequence);
+        if (_entry_matches(entry, provisioning_session_id)) cJSON_AddItemToArray(changes, _entry_json(entry));
+    }
+
+    body = msaf_json_print(json);
+    cJSON_Delete(json);
+
+    response = nf_server_new_response(NULL, "application/json", 0, NULL, 0, NULL, api, app_meta);
+    ogs_assert(response);
+    nf_server_populate_response(response, strlen(body), body, 200);
+    ogs_assert(true == ogs_sbi_server_send_response(stream, response));
+}
+
+static void _send_gone(ogs_sbi_stream_t *stream, const char *detail, const nf_server_interface_metadata_t *api,
+                       const nf_server_app_metadata_t *app_meta)
+{
+    ogs_error("%s", detail);
+    ogs_assert(true == nf_server_send_error(stream, 410, 0, NULL, "Changes not available.", detail, NULL, api, app_meta));
+}
+
+/* Called by the server just before it frees a stream, so that a waiter never answers through a stream the client has closed */
+static void _stream_closed(ogs_sbi_stream_t *stream)
+{
+    msaf_change_feed_waiter_t *waiter;
+
+    waiter = ogs_hash_get(change_feed.waiters_by_stream, &stream, sizeof(stream));
+    if (!waiter) return;
+
+    ogs_debug("Change feed client went away while waiting for changes after sequence %" PRIu64, waiter->after);
+    _waiter_answered(waiter);
+}
+
+static void _waiter_answered(msaf_change_feed_waiter_t *waiter)
+{
+    ogs_hash_set(change_feed.waiters_by_stream, &waiter->stream, sizeof(waiter->stream), NULL);
+    waiter->stream = NULL;
+    /* have the timer go off now to free the waiter, unless its event is already queued */
+    if (waiter->timer->running) ogs_timer_start(waiter->timer, 0);
+}
+
+static void _waiter_free(msaf_change_feed_waiter_t *waiter)
+{
+    ogs_list_remove(&change_feed.waiters, waiter);
+    if (waiter->stream) {
+        ogs_hash_set(change_feed.waiters_by_stream, &waiter->stream, sizeof(waiter->stream), NULL);
+    }
+    ogs_timer_delete(waiter->timer);
+    if (waiter->provisioning_session_id) ogs_free(waiter->provisioning_session_id);
+    ogs_free(waiter);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,85 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#ifndef MSAF_CHANGE_FEED_H
+#define MSAF_CHANGE_FEED_H
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Change feed, for GET /5gmag-rt-management/v1/changes
+ *
+ * Every change to a provisioning session, or to a resource configured on one, is given the next number in a sequence and
+ * kept in a fixed length log, so that tools can follow the changes instead of polling M1. A request names the last
+ * sequence number it has seen and is answered as soon as there are later changes, or with no changes once the wait time is
+ * up (a long-poll):
+ *
+ *     ?after=<sequence>            last change seen, if omitted only changes from now on are returned
+ *     &feedId=<feedId>             feedId from the last response, a different feedId means the AF has restarted
+ *     &provisioningSessionId=<id>  only return changes to this provisioning session, optional
+ *     &wait=<seconds>              how long to wait for a change, 0 to return at once, defaults to 30, at most 300
+ *
+ * The response is:
+ *
+ *     {
+ *         "feedId": "...",
+ *         "lastSequence": 42,          use as ?after= for the next request
+ *         "changes": [{
+ *             "sequence": 42,
+ *             "time": "2024-10-01T10:00:00Z",
+ *             "resourceType": "content-hosting-configuration",
+ *             "provisioningSessionId": "...",
+ *             "resourceId": "...",     for certificates, policy templates and metrics reporting configurations
+ *             "change": "updated"      or "deleted"
+ *         }, ...]
+ *     }
+ *
+ * If the changes since ?after= are no longer all in the log, or the feedId does not match, the response is 410 Gone and the
+ * client should fetch the resources it follows again and carry on from the lastSequence of a ?wait=0 request.
+ */
+
+typedef struct nf_server_interface_metadata_s nf_server_interface_metadata_t;
+typedef struct nf_server_app_metadata_s nf_server_app_metadata_t;
+typedef struct msaf_change_feed_waiter_s msaf_change_feed_waiter_t;
+
+#define MSAF_CHANGE_FEED_DEFAULT_WAIT 30
+#define MSAF_CHANGE_FEED_MAX_WAIT 300
+
+/* Start following the closing of server streams, for requests that are waiting for changes */
+extern void msaf_change_feed_init(void);
+/* Free the change log and any waiting requests */
+extern void msaf_change_feed_final(void);
+
+/* Add a change, a resource which still exists has been created or updated. Any waiting requests for it are answered. */
+extern void msaf_change_feed_add(const char *resource_type /* [static, not-null] */,
+                                 const char *provisioning_session_id /* [not-null] */,
+                                 const char *resource_id /* [nullable] */, bool deleted);
+
+/* Answer a request for the changes after the *after* sequence number, or keep it until there is a change or *wait* runs out */
+extern void msaf_change_feed_watch(ogs_sbi_stream_t *stream /* [not-null] */, const char *feed_id /* [nullable] */,
+                                   const uint64_t *after /* [nullable] */, const char *provisioning_session_id /* [nullable] */,
+                                   int wait /* seconds */, const nf_server_interface_metadata_t *api,
+                                   const nf_server_app_metadata_t *app_meta);
+
+/* Called from the event loop when the wait time of a request has run out */
+extern void msaf_change_feed_wait_expired(msaf_change_feed_waiter_t *waiter /* [transfer, not-null] */);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
+
+#endif /* MSAF_CHANGE_FEED_H */
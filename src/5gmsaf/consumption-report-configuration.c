@@ -13,13 +13,15 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #include "openapi/model/msaf_api_consumption_reporting_configuration.h"
 #include "provisioning-session.h"
 #include "hash.h"
+#include "json-format.h"
+#include "service-access-information.h"
 
 #include "consumption-report-configuration.h"
 
 bool msaf_consumption_report_configuration_register(msaf_provisioning_session_t *session /* [no-transfer, not-null] */,
                                                   msaf_api_consumption_reporting_configuration_t *config /* [transfer, not-null] */)
 {
-    char *body;
+    cJSON *json;
 
     ogs_assert(session);
     ogs_assert(config);
@@ -28,13 +30,13 @@ bool msaf_consumption_report_configuration_register(msaf_provisioning_session_t
 
     session->consumptionReportingConfiguration = config;
 
-    body = msaf_consumption_report_configuration_body(session);
-    session->httpMetadata.consumptionReportingConfiguration.hash = calculate_hash(body);
-    ogs_free(body);
+    json = msaf_consumption_report_configuration_json(session);
+    session->httpMetadata.consumptionReportingConfiguration.hash = msaf_json_hash(json);
+    cJSON_Delete(json);
 
     time(&session->httpMetadata.consumptionReportingConfiguration.received);
 
-    msaf_sai_cache_clear(session->sai_cache);
+    msaf_context_service_access_information_invalidate(session);
 
     return true;
 }
@@ -42,7 +44,7 @@ bool msaf_consumption_report_configuration_register(msaf_provisioning_session_t
 bool msaf_consumption_report_configuration_update(msaf_provisioning_session_t *session /* [no-transfer, not-null] */,
                                                 msaf_api_consumption_reporting_configuration_t *config /* [transfer, not-null] */)
 {
-    char *body;
+    cJSON *json;
 
     ogs_assert(session);
     ogs_assert(config);
@@ -57,13 +59,13 @@ bool msaf_consumption_report_configuration_update(msaf_provisioning_session_t *s
 
     session->consumptionReportingConfiguration = config;
 
-    body = msaf_consumption_report_configuration_body(session);
-    session->httpMetadata.consumptionReportingConfiguration.hash = calculate_hash(body);
-    ogs_free(body);
+    json = msaf_consumption_report_configuration_json(session);
+    session->httpMetadata.consumptionReportingConfiguration.hash = msaf_json_hash(json);
+    cJSON_Delete(json);
 
     time(&session->httpMetadata.consumptionReportingConfiguration.received);
 
-    msaf_sai_cache_clear(session->sai_cache);
+    msaf_context_service_access_information_invalidate(session);
 
     return true;
 }
@@ -81,10 +83,11 @@ bool msaf_consumption_report_configuration_deregister(msaf_provisioning_session_
         ogs_free(session->httpMetadata.consumptionReportingConfiguration.hash);
         session->httpMetadata.consumptionReportingConfiguration.hash = NULL;
     }
-    
+    msaf_content_variant_clear(&session->httpMetadata.consumptionReportingConfiguration.identity);
+
     session->httpMetadata.consumptionReportingConfiguration.received = 0;
 
-    msaf_sai_cache_clear(session->sai_cache);
+    msaf_context_service_access_information_invalidate(session);
 
     return true;
 }
@@ -124,21 +127,28 @@ cJSON *msaf_consumption_report_configuration_json(msaf_provisioning_session_t *s
 
 char *msaf_consumption_report_configuration_body(msaf_provisioning_session_t *session /* [no-transfer, not-null] */)
 {
-    cJSON *json;
-    char *body;
-    
+    msaf_http_metadata_t *metadata;
+
     ogs_assert(session);
 
     if (!session->consumptionReportingConfiguration) return NULL;
 
-    json = msaf_consumption_report_configuration_json(session);
-    if (!json) return NULL;
+    metadata = &session->httpMetadata.consumptionReportingConfiguration;
+    if (!msaf_content_variant_is_current(&metadata->identity, metadata->hash)) {
+        cJSON *json;
+        char *body;
 
-    body = cJSON_Print(json);
+        json = msaf_consumption_report_configuration_json(session);
+        if (!json) return NULL;
 
-    cJSON_Delete(json);
+        body = msaf_json_print(json);
+        cJSON_Delete(json);
+
+        msaf_content_variant_set(&metadata->identity, body, strlen(body), metadata->hash);
+        cJSON_free(body);
+    }
 
-    return body;
+    return msaf_content_variant_copy(&metadata->identity);
 }
 
 time_t msaf_consumption_report_configuration_last_modified(msaf_provisioning_session_t *session /* [no-transfer, not-null] */)
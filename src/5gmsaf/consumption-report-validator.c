@@ -0,0 +1,197 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#include <string.h>
+
+#include "ogs-core.h"
+
+#include "json-reader.h"
+
+#include "consumption-report-validator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Fields seen, used to detect missing and repeated fields */
+#define REPORT_MEDIA_PLAYER_ENTRY           0x01
+#define REPORT_REPORTING_CLIENT_ID          0x02
+#define REPORT_CONSUMPTION_REPORTING_UNITS  0x04
+#define REPORT_REQUIRED                     0x07
+
+#define UNIT_MEDIA_CONSUMED                 0x01
+#define UNIT_START_TIME                     0x02
+#define UNIT_DURATION                       0x04
+#define UNIT_MEDIA_ENDPOINT_ADDRESS         0x08
+#define UNIT_REQUIRED                       0x07
+
+#define ADDRESS_DOMAIN_NAME                 0x01
+#define ADDRESS_IPV4_ADDR                   0x02
+#define ADDRESS_IPV6_ADDR                   0x04
+#define ADDRESS_PORT_NUMBERS                0x08
+#define ADDRESS_REQUIRED                    0x08
+
+static bool _field_once(unsigned int *seen, unsigned int field);
+static bool _scan_unit(msaf_json_reader_t *reader, msaf_json_token_t token, int64_t *duration);
+static bool _scan_endpoint_address(msaf_json_reader_t *reader, msaf_json_token_t token);
+static bool _scan_integer(msaf_json_reader_t *reader, msaf_json_token_t token, int64_t min, int64_t max, int64_t *value);
+
+bool msaf_consumption_report_validate(const char *body, size_t length, msaf_consumption_report_summary_t *summary)
+{
+    msaf_json_reader_t reader;
+    msaf_json_token_t token;
+    unsigned int seen = 0;
+
+    ogs_assert(body);
+    ogs_assert(summary);
+
+    memset(summary, 0, sizeof(*summary));
+
+    msaf_json_reader_init(&reader, body, length);
+
+    if (msaf_json_reader_next(&reader) != MSAF_JSON_TOKEN_OBJECT_START) goto fallback;
+
+    while ((token = msaf_json_reader_next(&reader)) == MSAF_JSON_TOKEN_KEY) {
+        if (msaf_json_reader_token_equals(&reader, "mediaPlayerEntry")) {
+            if (!_field_once(&seen, REPORT_MEDIA_PLAYER_ENTRY)) goto fallback;
+            if (msaf_json_reader_next(&reader) != MSAF_JSON_TOKEN_STRING) goto fallback;
+            summary->media_player_entry = msaf_json_reader_strdup(&reader);
+        } else if (msaf_json_reader_token_equals(&reader, "reportingClientId")) {
+            if (!_field_once(&seen, REPORT_REPORTING_CLIENT_ID)) goto fallback;
+            if (msaf_json_reader_next(&reader) != MSAF_JSON_TOKEN_STRING) goto fallback;
+            summary->reporting_client_id = msaf_json_reader_strdup(&reader);
+        } else if (msaf_json_reader_token_equals(&reader, "consumptionReportingUnits")) {
+            if (!_field_once(&seen, REPORT_CONSUMPTION_REPORTING_UNITS)) goto fallback;
+            if (msaf_json_reader_next(&reader) != MSAF_JSON_TOKEN_ARRAY_START) goto fallback;
+            while ((token = msaf_json_reader_next(&reader)) != MSAF_JSON_TOKEN_ARRAY_END) {
+                if (!_scan_unit(&reader, token, &summary->duration)) goto fallback;
+                summary->units++;
+            }
+            if (!summary->units) goto fallback;
+        } else {
+            /* not checked here */
+            goto fallback;
+        }
+    }
+
+    /* the rest of the body must be empty for the report to be valid JSON */
+    if (token != MSAF_JSON_TOKEN_OBJECT_END || msaf_json_reader_next(&reader) != MSAF_JSON_TOKEN_END) goto fallback;
+    if ((seen & REPORT_REQUIRED) != REPORT_REQUIRED) goto fallback;
+
+    return true;
+
+fallback:
+    msaf_consumption_report_summary_clear(summary);
+    return false;
+}
+
+void msaf_consumption_report_summary_clear(msaf_consumption_report_summary_t *summary)
+{
+    ogs_assert(summary);
+
+    if (summary->reporting_client_id) ogs_free(summary->reporting_client_id);
+    if (summary->media_player_entry) ogs_free(summary->media_player_entry);
+    memset(summary, 0, sizeof(*summary));
+}
+
+/*****************************************************
+ ***** Private functions
+ *****************************************************/
+
+static bool _field_once(unsigned int *seen, unsigned int field)
+{
+    if (*seen & field) return false;
+    *seen |= field;
+    return true;
+}
+
+/* ConsumptionReportingUnit */
+static bool _scan_unit(msaf_json_reader_t *reader, msaf_json_token_t token, int64_t *duration)
+{
+    unsigned int seen = 0;
+    int64_t value;
+
+    if (token != MSAF_JSON_TOKEN_OBJECT_START) return false;
+
+    while ((token = msaf_json_reader_next(reader)) == MSAF_JSON_TOKEN_KEY) {
+        if (msaf_json_reader_token_equals(reader, "mediaConsumed")) {
+            if (!_field_once(&seen, UNIT_MEDIA_CONSUMED)) return false;
+            if (msaf_json_reader_next(reader) != MSAF_JSON_TOKEN_STRING) return false;
+        } else if (msaf_json_reader_token_equals(reader, "startTime")) {
+            if (!_field_once(&seen, UNIT_START_TIME)) return false;
+            if (msaf_json_reader_next(reader) != MSAF_JSON_TOKEN_STRING) return false;
+        } else if (msaf_json_reader_token_equals(reader, "duration")) {
+            if (!_field_once(&seen, UNIT_DURATION)) return false;
+            if (!_scan_integer(reader, msaf_json_reader_next(reader), 0, INT32_MAX, &value)) return false;
+            *duration += value;
+        } else if (msaf_json_reader_token_equals(reader, "mediaEndpointAddress")) {
+            if (!_field_once(&seen, UNIT_MEDIA_ENDPOINT_ADDRESS)) return false;
+            if (!_scan_endpoint_address(reader, msaf_json_reader_next(reader))) return false;
+        } else {
+            return false;
+        }
+    }
+
+    return token == MSAF_JSON_TOKEN_OBJECT_END && (seen & UNIT_REQUIRED) == UNIT_REQUIRED;
+}
+
+/* EndpointAddress */
+static bool _scan_endpoint_address(msaf_json_reader_t *reader, msaf_json_token_t token)
+{
+    unsigned int seen = 0;
+
+    if (token != MSAF_JSON_TOKEN_OBJECT_START) return false;
+
+    while ((token = msaf_json_reader_next(reader)) == MSAF_JSON_TOKEN_KEY) {
+        if (msaf_json_reader_token_equals(reader, "domainName")) {
+            if (!_field_once(&seen, ADDRESS_DOMAIN_NAME)) return false;
+            if (msaf_json_reader_next(reader) != MSAF_JSON_TOKEN_STRING) return false;
+        } else if (msaf_json_reader_token_equals(reader, "ipv4Addr")) {
+            if (!_field_once(&seen, ADDRESS_IPV4_ADDR)) return false;
+            if (msaf_json_reader_next(reader) != MSAF_JSON_TOKEN_STRING) return false;
+        } else if (msaf_json_reader_token_equals(reader, "ipv6Addr")) {
+            if (!_field_once(&seen, ADDRESS_IPV6_ADDR)) return false;
+            if (msaf_json_reader_next(reader) != MSAF_JSON_TOKEN_STRING) return false;
+        } else if (msaf_json_reader_token_equals(reader, "portNumbers")) {
+            size_t ports = 0;
+
+            if (!_field_once(&seen, ADDRESS_PORT_NUMBERS)) return false;
+            if (msaf_json_reader_next(reader) != MSAF_JSON_TOKEN_ARRAY_START) return false;
+            while ((token = msaf_json_reader_next(reader)) != MSAF_JSON_TOKEN_ARRAY_END) {
+                if (!_scan_integer(reader, token, 0, 65535, NULL)) return false;
+                ports++;
+            }
+            if (!ports) return false;
+        } else {
+            return false;
+        }
+    }
+
+    return token == MSAF_JSON_TOKEN_OBJECT_END && (seen & ADDRESS_REQUIRED) == ADDRESS_REQUIRED;
+}
+
+static bool _scan_integer(msaf_json_reader_t *reader, msaf_json_token_t token, int64_t min, int64_t max, int64_t *value_out)
+{
+    int64_t value;
+
+    if (token != MSAF_JSON_TOKEN_NUMBER) return false;
+    if (!msaf_json_reader_int64(reader, &value)) return false;
+    if (value < min || value > max) return false;
+    if (value_out) *value_out = value;
+
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
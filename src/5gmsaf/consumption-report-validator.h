@@ -0,0 +1,56 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#ifndef MSAF_CONSUMPTION_REPORT_VALIDATOR_H
+#define MSAF_CONSUMPTION_REPORT_VALIDATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Fields of a ConsumptionReport used for routing and aggregation */
+typedef struct msaf_consumption_report_summary_s {
+    char *reporting_client_id;
+    char *media_player_entry;
+    size_t units;                     /* number of consumptionReportingUnits */
+    int64_t duration;                 /* total duration of the units in seconds */
+} msaf_consumption_report_summary_t;
+
+/* Check a ConsumptionReport request body in a single pass over the buffer,
+ * without building a cJSON tree or the OpenAPI model.
+ *
+ * Only the common shape of a report is recognised: the required fields plus
+ * mediaEndpointAddress in the reporting units. Anything else, including
+ * invalid reports, returns false and the caller should fall back to the full
+ * parse, which gives the detailed error message. A report that is accepted
+ * here is always one that msaf_api_consumption_report_parseRequestFromJSON()
+ * would accept.
+ *
+ * On success the summary is filled in and should be released with
+ * msaf_consumption_report_summary_clear().
+ */
+extern bool msaf_consumption_report_validate(const char *body /* [no-transfer, not-null] */, size_t length,
+                                             msaf_consumption_report_summary_t *summary /* [out, not-null] */);
+
+/* Free the strings held by a summary */
+extern void msaf_consumption_report_summary_clear(msaf_consumption_report_summary_t *summary /* [not-null] */);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
+
+#endif /* MSAF_CONSUMPTION_REPORT_VALIDATOR_H */
@@ -0,0 +1,314 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#include <math.h>
+#include <string.h>
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#include "consumption-statistics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTHER_ENTRY_POINTS MSAF_CONSUMPTION_STATISTICS_MAX_ENTRY_POINTS
+
+typedef struct bucket_s {
+    int64_t index;            /* bucket number since the monotonic clock started, -1 if never used */
+    uint32_t reports;
+    uint32_t units;
+    uint64_t duration;
+    uint32_t entry_points[MSAF_CONSUMPTION_STATISTICS_MAX_ENTRY_POINTS + 1];  /* last one is for other entry points */
+    uint8_t clients[MSAF_CONSUMPTION_STATISTICS_SKETCH_REGISTERS];
+    uint8_t sessions[MSAF_CONSUMPTION_STATISTICS_SKETCH_REGISTERS];
+} bucket_t;
+
+struct msaf_consumption_statistics_s {
+    char *entry_points[MSAF_CONSUMPTION_STATISTICS_MAX_ENTRY_POINTS];
+    bucket_t buckets[MSAF_CONSUMPTION_STATISTICS_BUCKETS];
+};
+
+static int64_t _bucket_index(ogs_time_t now);
+static bool _bucket_live(const bucket_t *bucket, int64_t current, int number_of_buckets);
+static int _entry_point_slot(msaf_consumption_statistics_t *statistics, const char *media_player_entry, int64_t current);
+static uint64_t _hash_update(uint64_t hash, const char *str);
+static uint64_t _hash_final(uint64_t hash);
+static void _sketch_add(uint8_t *registers, uint64_t hash);
+static uint64_t _sketch_estimate(const uint8_t *registers);
+
+msaf_consumption_statistics_t *msaf_consumption_statistics_new(void)
+{
+    msaf_consumption_statistics_t *statistics;
+    int i;
+
+    statistics = ogs_calloc(1, sizeof(*statistics));
+    ogs_assert(statistics);
+
+    for (i = 0; i < MSAF_CONSUMPTION_STATISTICS_BUCKETS; i++) {
+        statistics->buckets[i].index = -1;
+    }
+
+    return statistics;
+}
+
+void msaf_consumption_statistics_free(msaf_consumption_statistics_t *statistics)
+{
+    int i;
+
+    if (!statistics) return;
+
+    for (i = 0; i < MSAF_CONSUMPTION_STATISTICS_MAX_ENTRY_POINTS; i++) {
+        if (statistics->entry_points[i]) ogs_free(statistics->entry_points[i]);
+    }
+
+    ogs_free(statistics);
+}
+
+void msaf_consumption_statistics_add(msaf_consumption_statistics_t *statistics, const msaf_consumption_report_summary_t *report,
+                                     ogs_time_t now)
+{
+    int64_t current = _bucket_index(now);
+    bucket_t *bucket;
+    uint64_t client_hash;
+
+    ogs_assert(statistics);
+    ogs_assert(report);
+
+    bucket = &statistics->buckets[current % MSAF_CONSUMPTION_STATISTICS_BUCKETS];
+    if (bucket->index != current) {
+        /* this bucket last held reports from a previous pass through the window */
+        memset(bucket, 0, sizeof(*bucket));
+        bucket->index = current;
+    }
+
+    bucket->reports++;
+    bucket->units += report->units;
+    if (report->duration > 0) bucket->duration += report->duration;
+    bucket->entry_points[_entry_point_slot(statistics, report->media_player_entry, current)]++;
+
+    client_hash = _hash_update(14695981039346656037ULL, report->reporting_client_id);
+    _sketch_add(bucket->clients, _hash_final(client_hash));
+    /* the session hash continues from the client hash, with a separator so that the pair is unambiguous */
+    _sketch_add(bucket->sessions, _hash_final(_hash_update((client_hash ^ 0xff) * 1099511628211ULL, report->media_player_entry)));
+}
+
+void msaf_consumption_statistics_query(msaf_consumption_statistics_t *statistics, ogs_time_t now, int window,
+                                       msaf_consumption_statistics_result_t *result)
+{
+    uint8_t clients[MSAF_CONSUMPTION_STATISTICS_SKETCH_REGISTERS];
+    uint8_t sessions[MSAF_CONSUMPTION_STATISTICS_SKETCH_REGISTERS];
+    uint64_t entry_points[MSAF_CONSUMPTION_STATISTICS_MAX_ENTRY_POINTS + 1];
+    int number_of_buckets;
+    int64_t current;
+    int i, j;
+
+    ogs_assert(result);
+
+    memset(result, 0, sizeof(*result));
+
+    number_of_buckets = (window + MSAF_CONSUMPTION_STATISTICS_BUCKET_SECONDS - 1) / MSAF_CONSUMPTION_STATISTICS_BUCKET_SECONDS;
+    if (number_of_buckets <= 0 || number_of_buckets > MSAF_CONSUMPTION_STATISTICS_BUCKETS)
+        number_of_buckets = MSAF_CONSUMPTION_STATISTICS_BUCKETS;
+    result->window = number_of_buckets * MSAF_CONSUMPTION_STATISTICS_BUCKET_SECONDS;
+
+    if (!statistics) return;
+
+    memset(clients, 0, sizeof(clients));
+    memset(sessions, 0, sizeof(sessions));
+    memset(entry_points, 0, sizeof(entry_points));
+    current = _bucket_index(now);
+
+    for (i = 0; i < MSAF_CONSUMPTION_STATISTICS_BUCKETS; i++) {
+        const bucket_t *bucket = &statistics->buckets[i];
+
+        if (!_bucket_live(bucket, current, number_of_buckets)) continue;
+
+        result->reports += bucket->reports;
+        result->units += bucket->units;
+        result->duration += bucket->duration;
+        for (j = 0; j <= MSAF_CONSUMPTION_STATISTICS_MAX_ENTRY_POINTS; j++) {
+            entry_points[j] += bucket->entry_points[j];
+        }
+        for (j = 0; j < MSAF_CONSUMPTION_STATISTICS_SKETCH_REGISTERS; j++) {
+            if (bucket->clients[j] > clients[j]) clients[j] = bucket->clients[j];
+            if (bucket->sessions[j] > sessions[j]) sessions[j] = bucket->sessions[j];
+        }
+    }
+
+    if (!result->reports) return;
+
+    result->clients = _sketch_estimate(clients);
+    result->sessions = _sketch_estimate(sessions);
+
+    for (j = 0; j < MSAF_CONSUMPTION_STATISTICS_MAX_ENTRY_POINTS; j++) {
+        if (!entry_points[j] || !statistics->entry_points[j]) continue;
+        result->entry_points[result->number_of_entry_points].media_player_entry = statistics->entry_points[j];
+        result->entry_points[result->number_of_entry_points].reports = entry_points[j];
+        result->number_of_entry_points++;
+    }
+    result->other_entry_points = entry_points[OTHER_ENTRY_POINTS];
+}
+
+cJSON *msaf_consumption_statistics_json(msaf_consumption_statistics_t *statistics, ogs_time_t now, int window)
+{
+    msaf_consumption_statistics_result_t result;
+    cJSON *json;
+    cJSON *entry_points;
+    size_t i;
+
+    msaf_consumption_statistics_query(statistics, now, window, &result);
+
+    json = cJSON_CreateObject();
+    ogs_assert(json);
+
+    cJSON_AddNumberToObject(json, "windowSeconds", result.window);
+    cJSON_AddNumberToObject(json, "reports", result.reports);
+    cJSON_AddNumberToObject(json, "consumptionReportingUnits", result.units);
+    cJSON_AddNumberToObject(json, "mediaConsumedDuration", result.duration);
+    cJSON_AddNumberToObject(json, "uniqueClients", result.clients);
+    cJSON_AddNumberToObject(json, "uniqueSessions", result.sessions);
+
+    entry_points = cJSON_AddArrayToObject(json, "mediaPlayerEntries");
+    ogs_assert(entry_points);
+    for (i = 0; i < result.number_of_entry_points; i++) {
+        cJSON *entry_point = cJSON_CreateObject();
+        ogs_assert(entry_point);
+        cJSON_AddStringToObject(entry_point, "mediaPlayerEntry", result.entry_points[i].media_player_entry);
+        cJSON_AddNumberToObject(entry_point, "reports", result.entry_points[i].reports);
+        cJSON_AddItemToArray(entry_points, entry_point);
+    }
+    cJSON_AddNumberToObject(json, "otherMediaPlayerEntriesReports", result.other_entry_points);
+
+    return json;
+}
+
+/*****************************************************
+ ***** Private functions
+ *****************************************************/
+
+static int64_t _bucket_index(ogs_time_t now)
+{
+    return now / ogs_time_from_sec(MSAF_CONSUMPTION_STATISTICS_BUCKET_SECONDS);
+}
+
+static bool _bucket_live(const bucket_t *bucket, int64_t current, int number_of_buckets)
+{
+    return bucket->index >= 0 && bucket->index <= current && bucket->index > current - number_of_buckets;
+}
+
+/* Find or allocate the counter for an entry point, returns OTHER_ENTRY_POINTS if all counters are in use */
+static int _entry_point_slot(msaf_consumption_statistics_t *statistics, const char *media_player_entry, int64_t current)
+{
+    int free_slot = -1;
+    int i, j;
+
+    if (!media_player_entry) return OTHER_ENTRY_POINTS;
+
+    for (i = 0; i < MSAF_CONSUMPTION_STATISTICS_MAX_ENTRY_POINTS; i++) {
+        if (statistics->entry_points[i]) {
+            if (!strcmp(statistics->entry_points[i], media_player_entry)) return i;
+        } else if (free_slot < 0) {
+            free_slot = i;
+        }
+    }
+
+    if (free_slot < 0) {
+        /* reuse a counter for an entry point with no reports left in the window */
+        for (i = 0; i < MSAF_CONSUMPTION_STATISTICS_MAX_ENTRY_POINTS && free_slot < 0; i++) {
+            for (j = 0; j < MSAF_CONSUMPTION_STATISTICS_BUCKETS; j++) {
+                if (_bucket_live(&statistics->buckets[j], current, MSAF_CONSUMPTION_STATISTICS_BUCKETS) &&
+                    statistics->buckets[j].entry_points[i]) break;
+            }
+            if (j == MSAF_CONSUMPTION_STATISTICS_BUCKETS) free_slot = i;
+        }
+        if (free_slot < 0) return OTHER_ENTRY_POINTS;
+
+        ogs_free(statistics->entry_points[free_slot]);
+        for (j = 0; j < MSAF_CONSUMPTION_STATISTICS_BUCKETS; j++) {
+            statistics->buckets[j].entry_points[free_slot] = 0;
+        }
+    }
+
+    statistics->entry_points[free_slot] = ogs_strdup(media_player_entry);
+    ogs_assert(statistics->entry_points[free_slot]);
+
+    return free_slot;
+}
+
+/* FNV-1a */
+static uint64_t _hash_update(uint64_t hash, const char *str)
+{
+    if (!str) return hash;
+
+    for (; *str; str++) {
+        hash ^= (unsigned char)*str;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+/* Spread the FNV hash over all bits, the sketch uses both the top and the bottom of the hash */
+static uint64_t _hash_final(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+/* HyperLogLog */
+static void _sketch_add(uint8_t *registers, uint64_t hash)
+{
+    unsigned int reg = hash >> (64 - MSAF_CONSUMPTION_STATISTICS_SKETCH_BITS);
+    uint64_t rest = hash << MSAF_CONSUMPTION_STATISTICS_SKETCH_BITS;
+    uint8_t rank = 1;
+
+    while (rank <= 64 - MSAF_CONSUMPTION_STATISTICS_SKETCH_BITS && !(rest & 0x8000000000000000ULL)) {
+        rank++;
+        rest <<= 1;
+    }
+
+    if (rank > registers[reg]) registers[reg] = rank;
+}
+
+static uint64_t _sketch_estimate(const uint8_t *registers)
+{
+    const double m = MSAF_CONSUMPTION_STATISTICS_SKETCH_REGISTERS;
+    double sum = 0;
+    double estimate;
+    int zeros = 0;
+    int i;
+
+    for (i = 0; i < MSAF_CONSUMPTION_STATISTICS_SKETCH_REGISTERS; i++) {
+        sum += ldexp(1.0, -registers[i]);
+        if (!registers[i]) zeros++;
+    }
+
+    estimate = (0.7213 / (1.0 + 1.079 / m)) * m * m / sum;
+    if (estimate <= 2.5 * m && zeros) {
+        /* small cardinalities are better estimated by linear counting */
+        estimate = m * log(m / zeros);
+    }
+
+    return (uint64_t)(estimate + 0.5);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,84 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#ifndef MSAF_CONSUMPTION_STATISTICS_H
+#define MSAF_CONSUMPTION_STATISTICS_H
+
+#include <stdint.h>
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#include "consumption-report-validator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Rolling window aggregation of the Consumption Reports for a Provisioning Session
+ *
+ * Reports are added to fixed size time buckets which are reused as the window
+ * moves on, so the memory used does not depend on the report rate. Unique
+ * clients and sessions are counted with HyperLogLog sketches, which can be
+ * merged across buckets, so they are estimates with a standard error of about
+ * 9%. A session is a distinct reporting client and media player entry pair.
+ * Only the first MSAF_CONSUMPTION_STATISTICS_MAX_ENTRY_POINTS media player
+ * entries active in the window are counted separately, the rest are counted
+ * together.
+ */
+
+#define MSAF_CONSUMPTION_STATISTICS_BUCKET_SECONDS 10
+#define MSAF_CONSUMPTION_STATISTICS_BUCKETS 30           /* 5 minute window */
+#define MSAF_CONSUMPTION_STATISTICS_WINDOW_SECONDS (MSAF_CONSUMPTION_STATISTICS_BUCKET_SECONDS * MSAF_CONSUMPTION_STATISTICS_BUCKETS)
+#define MSAF_CONSUMPTION_STATISTICS_SKETCH_BITS 7        /* 128 registers, about 9% standard error */
+#define MSAF_CONSUMPTION_STATISTICS_SKETCH_REGISTERS (1 << MSAF_CONSUMPTION_STATISTICS_SKETCH_BITS)
+#define MSAF_CONSUMPTION_STATISTICS_MAX_ENTRY_POINTS 16
+
+typedef struct msaf_consumption_statistics_s msaf_consumption_statistics_t;
+
+typedef struct msaf_consumption_statistics_entry_point_s {
+    const char *media_player_entry;   /* owned by the statistics */
+    uint64_t reports;
+} msaf_consumption_statistics_entry_point_t;
+
+typedef struct msaf_consumption_statistics_result_s {
+    int window;                       /* seconds covered */
+    uint64_t reports;
+    uint64_t units;                   /* consumption reporting units */
+    uint64_t duration;                /* total media consumption duration in seconds */
+    uint64_t clients;                 /* estimated unique reporting clients */
+    uint64_t sessions;                /* estimated unique client and media player entry pairs */
+    size_t number_of_entry_points;
+    msaf_consumption_statistics_entry_point_t entry_points[MSAF_CONSUMPTION_STATISTICS_MAX_ENTRY_POINTS];
+    uint64_t other_entry_points;      /* reports for media player entries not counted separately */
+} msaf_consumption_statistics_result_t;
+
+extern msaf_consumption_statistics_t *msaf_consumption_statistics_new(void);
+extern void msaf_consumption_statistics_free(msaf_consumption_statistics_t *statistics);
+
+/* Add a report received at time now (monotonic) */
+extern void msaf_consumption_statistics_add(msaf_consumption_statistics_t *statistics /* [not-null] */,
+                                            const msaf_consumption_report_summary_t *report /* [not-null] */, ogs_time_t now);
+
+/* Totals for the last window seconds at time now, window is rounded up to whole buckets and limited to the full window.
+ * The entry point names in the result are valid until the next call to msaf_consumption_statistics_add().
+ */
+extern void msaf_consumption_statistics_query(msaf_consumption_statistics_t *statistics /* [null] */, ogs_time_t now, int window,
+                                              msaf_consumption_statistics_result_t *result /* [out, not-null] */);
+extern cJSON *msaf_consumption_statistics_json(msaf_consumption_statistics_t *statistics /* [null] */, ogs_time_t now, int window);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
+
+#endif /* MSAF_CONSUMPTION_STATISTICS_H */
@@ -0,0 +1,226 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#include <stdlib.h>
+#include <strings.h>
+#include <zlib.h>
+
+#include "ogs-core.h"
+
+#include "content-encoding.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static double _coding_qvalue(const char *params, size_t params_len);
+static char *_gzip(const char *in, size_t in_len, size_t *out_len);
+
+msaf_content_encoding_t msaf_content_encoding_select(const char *accept_encoding)
+{
+    double gzip_q = -1.0;
+    double identity_q = -1.0;
+    double any_q = -1.0;
+    const char *p;
+
+    if (!accept_encoding) return MSAF_CONTENT_ENCODING_IDENTITY;
+
+    p = accept_encoding;
+    while (*p) {
+        const char *coding, *params, *end;
+        size_t coding_len;
+        double q;
+
+        p += strspn(p, " \t,");
+        if (!*p) break;
+
+        coding = p;
+        end = p + strcspn(p, ",");
+        coding_len = strcspn(coding, " \t;,");
+        params = coding + coding_len;
+        q = _coding_qvalue(params, end - params);
+
+        if ((coding_len == 4 && !strncasecmp(coding, "gzip", 4)) ||
+            (coding_len == 6 && !strncasecmp(coding, "x-gzip", 6))) {
+            gzip_q = q;
+        } else if (coding_len == 8 && !strncasecmp(coding, "identity", 8)) {
+            identity_q = q;
+        } else if (coding_len == 1 && *coding == '*') {
+            any_q = q;
+        }
+
+        p = end;
+    }
+
+    if (gzip_q < 0) gzip_q = any_q;
+    if (identity_q < 0) identity_q = (any_q < 0)?1.0:any_q;
+
+    /* prefer the smaller body when the client has no preference */
+    if (gzip_q > 0 && gzip_q >= identity_q) return MSAF_CONTENT_ENCODING_GZIP;
+
+    return MSAF_CONTENT_ENCODING_IDENTITY;
+}
+
+const char *msaf_content_encoding_name(msaf_content_encoding_t encoding)
+{
+    switch (encoding) {
+    case MSAF_CONTENT_ENCODING_GZIP:
+        return "gzip";
+    case MSAF_CONTENT_ENCODING_IDENTITY:
+        return "identity";
+    default:
+        break;
+    }
+    return NULL;
+}
+
+bool msaf_content_variant_gzip(msaf_content_variant_t *variant, const char *body, size_t length, const char *etag)
+{
+    ogs_assert(variant);
+
+    if (variant->source_etag && etag && !strcmp(variant->source_etag, etag)) return variant->body != NULL;
+
+    msaf_content_variant_clear(variant);
+
+    if (!body) return false;
+
+    if (etag) variant->source_etag = ogs_strdup(etag);
+
+    if (length < MSAF_CONTENT_ENCODING_MIN_LENGTH) return false;
+
+    variant->body = _gzip(body, length, &variant->length);
+    if (!variant->body) return false;
+
+    if (variant->length >= length) {
+        /* no smaller than the original */
+        ogs_free(variant->body);
+        variant->body = NULL;
+        variant->length = 0;
+        return false;
+    }
+
+    if (etag) variant->etag = ogs_msprintf("%s-gzip", etag);
+
+    return true;
+}
+
+void msaf_content_variant_set(msaf_content_variant_t *variant, const char *body, size_t length, const char *etag)
+{
+    ogs_assert(variant);
+    ogs_assert(body);
+
+    msaf_content_variant_clear(variant);
+
+    variant->body = ogs_memdup(body, length + 1);
+    ogs_assert(variant->body);
+    variant->body[length] = '\0';
+    variant->length = length;
+    if (etag) {
+        variant->etag = ogs_strdup(etag);
+        variant->source_etag = ogs_strdup(etag);
+    }
+}
+
+bool msaf_content_variant_is_current(const msaf_content_variant_t *variant, const char *etag)
+{
+    ogs_assert(variant);
+
+    return variant->body && variant->source_etag && etag && !strcmp(variant->source_etag, etag);
+}
+
+char *msaf_content_variant_copy(const msaf_content_variant_t *variant)
+{
+    char *body;
+
+    ogs_assert(variant);
+
+    if (!variant->body) return NULL;
+
+    body = ogs_memdup(variant->body, variant->length + 1);
+    ogs_assert(body);
+
+    return body;
+}
+
+void msaf_content_variant_clear(msaf_content_variant_t *variant)
+{
+    if (!variant) return;
+
+    if (variant->body) ogs_free(variant->body);
+    if (variant->etag) ogs_free(variant->etag);
+    if (variant->source_etag) ogs_free(variant->source_etag);
+
+    memset(variant, 0, sizeof(*variant));
+}
+
+/***** Private functions *****/
+
+/* q value from the parameters following a content-coding, 1 if there is no q parameter */
+static double _coding_qvalue(const char *params, size_t params_len)
+{
+    const char *p = params;
+    const char *end = params + params_len;
+
+    while (p < end) {
+        p = memchr(p, ';', end - p);
+        if (!p) break;
+        p++;
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+        if (end - p > 2 && (*p == 'q' || *p == 'Q') && p[1] == '=') {
+            return strtod(p + 2, NULL);
+        }
+    }
+
+    return 1.0;
+}
+
+static char *_gzip(const char *in, size_t in_len, size_t *out_len)
+{
+    z_stream strm;
+    char *out;
+    uLong bound;
+
+    memset(&strm, 0, sizeof(strm));
+    /* 15 bit window with gzip header and trailer */
+    if (deflateInit2(&strm, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        ogs_error("Unable to initialise gzip compression");
+        return NULL;
+    }
+
+    bound = deflateBound(&strm, in_len);
+    /* room for a terminating nul so that the body can be copied like the identity body */
+    out = ogs_malloc(bound + 1);
+    ogs_assert(out);
+
+    strm.next_in = (Bytef*)in;
+    strm.avail_in = in_len;
+    strm.next_out = (Bytef*)out;
+    strm.avail_out = bound;
+
+    if (deflate(&strm, Z_FINISH) != Z_STREAM_END) {
+        ogs_error("gzip compression failed");
+        deflateEnd(&strm);
+        ogs_free(out);
+        return NULL;
+    }
+
+    *out_len = strm.total_out;
+    out[*out_len] = '\0';
+    deflateEnd(&strm);
+
+    return out;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
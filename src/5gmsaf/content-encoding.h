@@ -0,0 +1,65 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#ifndef MSAF_CONTENT_ENCODING_H
+#define MSAF_CONTENT_ENCODING_H
+
+#include "ogs-core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum msaf_content_encoding_e {
+    MSAF_CONTENT_ENCODING_IDENTITY = 0,
+    MSAF_CONTENT_ENCODING_GZIP
+} msaf_content_encoding_t;
+
+/* An encoded copy of a response body. source_etag is the ETag of the identity
+ * body it was made from, so that it is only regenerated when that changes.
+ * body is NULL if encoding the source was not worthwhile.
+ */
+typedef struct msaf_content_variant_s {
+    char *body;
+    size_t length;
+    char *etag;
+    char *source_etag;
+} msaf_content_variant_t;
+
+/* Bodies shorter than this are not worth compressing */
+#define MSAF_CONTENT_ENCODING_MIN_LENGTH 256
+
+/* Preferred encoding allowed by an Accept-Encoding header value (NULL if there was no header) */
+extern msaf_content_encoding_t msaf_content_encoding_select(const char *accept_encoding);
+extern const char *msaf_content_encoding_name(msaf_content_encoding_t encoding);
+
+/* Make variant the gzip encoding of body, reusing the existing variant if it
+ * was made from the same etag. Returns true if a gzip body is available.
+ */
+extern bool msaf_content_variant_gzip(msaf_content_variant_t *variant, const char *body, size_t length, const char *etag);
+
+/* Make variant a copy of body, the unencoded response body rendered for etag.
+ * This lets a response body be rendered once for each version of a resource.
+ */
+extern void msaf_content_variant_set(msaf_content_variant_t *variant, const char *body, size_t length, const char *etag);
+/* True if variant holds a body made from etag */
+extern bool msaf_content_variant_is_current(const msaf_content_variant_t *variant, const char *etag);
+/* Copy of the body held by variant, for passing to nf_server_populate_response() */
+extern char *msaf_content_variant_copy(const msaf_content_variant_t *variant);
+extern void msaf_content_variant_clear(msaf_content_variant_t *variant);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MSAF_CONTENT_ENCODING_H */
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,340 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#include <string.h>
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#include "json-writer.h"
+
+#include "openapi/model/msaf_api_content_hosting_configuration.h"
+#include "openapi/model/msaf_api_distribution_configuration.h"
+#include "openapi/model/msaf_api_path_rewrite_rule.h"
+
+#include "content-hosting-configuration-diff.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct distribution_s {
+    const msaf_api_distribution_configuration_t *distribution_configuration;
+    char *canonical;                  /* compact JSON of the distribution configuration, NULL if it could not be written */
+    bool matched;                     /* already paired with an identical distribution configuration */
+} distribution_t;
+
+static char *_canonical(msaf_json_write_fn write_fn, const void *data);
+static bool _write_content_hosting_configuration(msaf_json_writer_t *writer, const void *content_hosting_configuration);
+static bool _write_distribution_configuration(msaf_json_writer_t *writer, const void *distribution_configuration);
+static distribution_t *_distributions_new(const msaf_api_content_hosting_configuration_t *chc, size_t *count);
+static void _distributions_free(distribution_t *distributions, size_t count);
+static bool _canonical_equal(const char *a, const char *b);
+static bool _str_equal(const char *a, const char *b);
+static bool _string_lists_equal(const OpenAPI_list_t *a, const OpenAPI_list_t *b);
+static OpenAPI_lnode_t *_entry_point_node(OpenAPI_lnode_t *node);
+static bool _entry_points_equal(const msaf_api_content_hosting_configuration_t *old_chc,
+                                const msaf_api_content_hosting_configuration_t *new_chc);
+static bool _path_rewrite_rule_lists_equal(const OpenAPI_list_t *a, const OpenAPI_list_t *b);
+static bool _path_rewrite_rules_equal(const msaf_api_content_hosting_configuration_t *old_chc,
+                                      const msaf_api_content_hosting_configuration_t *new_chc);
+static bool _certificate_ids_missing(const msaf_api_content_hosting_configuration_t *chc,
+                                     const msaf_api_content_hosting_configuration_t *other);
+static bool _certificate_id_used(const msaf_api_content_hosting_configuration_t *chc, const char *certificate_id);
+
+#define DISTRIBUTIONS(chc) ((chc)?(chc)->distribution_configurations:NULL)
+#define FIRST_NODE(list) ((list)?(list)->first:NULL)
+
+/***** Public functions *****/
+
+void msaf_content_hosting_configuration_diff(msaf_content_hosting_configuration_diff_t *diff,
+                                        const msaf_api_content_hosting_configuration_t *old_chc,
+                                        const msaf_api_content_hosting_configuration_t *new_chc)
+{
+    char *old_canonical;
+    char *new_canonical;
+    distribution_t *old_distributions;
+    distribution_t *new_distributions;
+    size_t old_count, new_count;
+    size_t i, j;
+
+    ogs_assert(diff);
+
+    memset(diff, 0, sizeof(*diff));
+
+    if (!old_chc && !new_chc) return;
+
+    /* a PUT of the same configuration is common, so check the whole thing first */
+    old_canonical = _canonical(_write_content_hosting_configuration, old_chc);
+    new_canonical = _canonical(_write_content_hosting_configuration, new_chc);
+    diff->changed = !_canonical_equal(old_canonical, new_canonical);
+    if (old_canonical) ogs_free(old_canonical);
+    if (new_canonical) ogs_free(new_canonical);
+
+    if (!diff->changed) return;
+
+    old_distributions = _distributions_new(old_chc, &old_count);
+    new_distributions = _distributions_new(new_chc, &new_count);
+
+    diff->distributions_changed = (old_count != new_count);
+
+    for (i = 0; i < new_count; i++) {
+        if (i < old_count && !_canonical_equal(old_distributions[i].canonical, new_distributions[i].canonical))
+            diff->distributions_changed = true;
+
+        /* pair with an identical old distribution configuration, wherever it was in the list */
+        for (j = 0; j < old_count; j++) {
+            if (!old_distributions[j].matched &&
+                _canonical_equal(old_distributions[j].canonical, new_distributions[i].canonical)) {
+                old_distributions[j].matched = true;
+                new_distributions[i].matched = true;
+                break;
+            }
+        }
+
+        if (new_distributions[i].matched) {
+            diff->distributions_unchanged++;
+        } else {
+            diff->distributions_added++;
+        }
+    }
+    diff->distributions_removed = old_count - diff->distributions_unchanged;
+
+    _distributions_free(old_distributions, old_count);
+    _distributions_free(new_distributions, new_count);
+
+    diff->entry_points_changed = !_entry_points_equal(old_chc, new_chc);
+    diff->path_rewrite_rules_changed = !_path_rewrite_rules_equal(old_chc, new_chc);
+    diff->certificates_added = _certificate_ids_missing(new_chc, old_chc);
+    diff->certificates_removed = _certificate_ids_missing(old_chc, new_chc);
+}
+
+void msaf_content_hosting_configuration_diff_log(const msaf_content_hosting_configuration_diff_t *diff,
+                                        const char *provisioning_session_id)
+{
+    ogs_assert(diff);
+    ogs_assert(provisioning_session_id);
+
+    if (!diff->changed) {
+        ogs_debug("Content Hosting Configuration for Provisioning Session [%s]: unchanged", provisioning_session_id);
+        return;
+    }
+
+    ogs_debug("Content Hosting Configuration for Provisioning Session [%s]: %u distributions added, %u removed, %u unchanged%s%s%s%s%s",
+              provisioning_session_id, diff->distributions_added, diff->distributions_removed, diff->distributions_unchanged,
+              diff->distributions_changed?"":", distributions unchanged",
+              diff->entry_points_changed?", entry points changed":"",
+              diff->certificates_added?", certificates added":"",
+              diff->certificates_removed?", certificates removed":"",
+              diff->path_rewrite_rules_changed?", path rewrite rules changed":"");
+}
+
+/***** Private functions *****/
+
+static char *_canonical(msaf_json_write_fn write_fn, const void *data)
+{
+    msaf_json_writer_t writer;
+
+    if (!data) return NULL;
+
+    msaf_json_writer_init(&writer, MSAF_JSON_FORMAT_COMPACT, 0);
+    if (!write_fn(&writer, data)) {
+        msaf_json_writer_clear(&writer);
+        return NULL;
+    }
+
+    return msaf_json_writer_finish(&writer, NULL);
+}
+
+static bool _write_content_hosting_configuration(msaf_json_writer_t *writer, const void *content_hosting_configuration)
+{
+    return msaf_api_content_hosting_configuration_writeResponseJSON(writer,
+                                            (const msaf_api_content_hosting_configuration_t*)content_hosting_configuration);
+}
+
+static bool _write_distribution_configuration(msaf_json_writer_t *writer, const void *distribution_configuration)
+{
+    return msaf_api_distribution_configuration_writeResponseJSON(writer,
+                                            (const msaf_api_distribution_configuration_t*)distribution_configuration);
+}
+
+static distribution_t *_distributions_new(const msaf_api_content_hosting_configuration_t *chc, size_t *count)
+{
+    distribution_t *distributions;
+    OpenAPI_lnode_t *node;
+    size_t i = 0;
+
+    *count = DISTRIBUTIONS(chc)?DISTRIBUTIONS(chc)->count:0;
+    if (!*count) return NULL;
+
+    distributions = ogs_calloc(*count, sizeof(*distributions));
+    ogs_assert(distributions);
+
+    OpenAPI_list_for_each(DISTRIBUTIONS(chc), node) {
+        distributions[i].distribution_configuration = node->data;
+        distributions[i].canonical = _canonical(_write_distribution_configuration, node->data);
+        i++;
+    }
+
+    return distributions;
+}
+
+static void _distributions_free(distribution_t *distributions, size_t count)
+{
+    size_t i;
+
+    if (!distributions) return;
+
+    for (i = 0; i < count; i++) {
+        if (distributions[i].canonical) ogs_free(distributions[i].canonical);
+    }
+    ogs_free(distributions);
+}
+
+/* a model which could not be written is never equal to anything */
+static bool _canonical_equal(const char *a, const char *b)
+{
+    return a && b && !strcmp(a, b);
+}
+
+static bool _str_equal(const char *a, const char *b)
+{
+    if (!a || !b) return a == b;
+    return !strcmp(a, b);
+}
+
+static bool _string_lists_equal(const OpenAPI_list_t *a, const OpenAPI_list_t *b)
+{
+    OpenAPI_lnode_t *a_node = FIRST_NODE(a);
+    OpenAPI_lnode_t *b_node = FIRST_NODE(b);
+
+    while (a_node && b_node) {
+        if (!_str_equal(a_node->data, b_node->data)) return false;
+        a_node = a_node->next;
+        b_node = b_node->next;
+    }
+
+    return !a_node && !b_node;
+}
+
+/* The first distribution configuration from node on which gives an entry point in the Service Access Information */
+static OpenAPI_lnode_t *_entry_point_node(OpenAPI_lnode_t *node)
+{
+    for (; node; node = node->next) {
+        const msaf_api_distribution_configuration_t *dist_conf = node->data;
+        if (dist_conf->entry_point && dist_conf->base_url) break;
+    }
+
+    return node;
+}
+
+/* Compares what msaf_context_service_access_information_create() puts in streamingAccess.entryPoints */
+static bool _entry_points_equal(const msaf_api_content_hosting_configuration_t *old_chc,
+                                const msaf_api_content_hosting_configuration_t *new_chc)
+{
+    OpenAPI_lnode_t *old_node = _entry_point_node(FIRST_NODE(DISTRIBUTIONS(old_chc)));
+    OpenAPI_lnode_t *new_node = _entry_point_node(FIRST_NODE(DISTRIBUTIONS(new_chc)));
+
+    while (old_node && new_node) {
+        const msaf_api_distribution_configuration_t *old_dist = old_node->data;
+        const msaf_api_distribution_configuration_t *new_dist = new_node->data;
+
+        if (!_str_equal(old_dist->base_url, new_dist->base_url) ||
+            !_str_equal(old_dist->entry_point->relative_path, new_dist->entry_point->relative_path) ||
+            !_str_equal(old_dist->entry_point->content_type, new_dist->entry_point->content_type) ||
+            !_string_lists_equal(old_dist->entry_point->profiles, new_dist->entry_point->profiles))
+            return false;
+
+        old_node = _entry_point_node(old_node->next);
+        new_node = _entry_point_node(new_node->next);
+    }
+
+    return !old_node && !new_node;
+}
+
+/* NULL and empty lists are the same, there are no rules in either */
+static bool _path_rewrite_rule_lists_equal(const OpenAPI_list_t *a, const OpenAPI_list_t *b)
+{
+    OpenAPI_lnode_t *a_node = FIRST_NODE(a);
+    OpenAPI_lnode_t *b_node = FIRST_NODE(b);
+
+    while (a_node && b_node) {
+        const msaf_api_path_rewrite_rule_t *a_rule = a_node->data;
+        const msaf_api_path_rewrite_rule_t *b_rule = b_node->data;
+
+        if (!_str_equal(a_rule->request_path_pattern, b_rule->request_path_pattern) ||
+            !_str_equal(a_rule->mapped_path, b_rule->mapped_path))
+            return false;
+
+        a_node = a_node->next;
+        b_node = b_node->next;
+    }
+
+    return !a_node && !b_node;
+}
+
+/* Rules are compared distribution configuration by distribution configuration, in order */
+static bool _path_rewrite_rules_equal(const msaf_api_content_hosting_configuration_t *old_chc,
+                                      const msaf_api_content_hosting_configuration_t *new_chc)
+{
+    OpenAPI_lnode_t *old_node = FIRST_NODE(DISTRIBUTIONS(old_chc));
+    OpenAPI_lnode_t *new_node = FIRST_NODE(DISTRIBUTIONS(new_chc));
+
+    while (old_node || new_node) {
+        const msaf_api_distribution_configuration_t *old_dist = old_node?old_node->data:NULL;
+        const msaf_api_distribution_configuration_t *new_dist = new_node?new_node->data:NULL;
+
+        if (!_path_rewrite_rule_lists_equal(old_dist?old_dist->path_rewrite_rules:NULL,
+                                            new_dist?new_dist->path_rewrite_rules:NULL))
+            return false;
+
+        if (old_node) old_node = old_node->next;
+        if (new_node) new_node = new_node->next;
+    }
+
+    return true;
+}
+
+/* true if chc uses a certificate id which other does not */
+static bool _certificate_ids_missing(const msaf_api_content_hosting_configuration_t *chc,
+                                     const msaf_api_content_hosting_configuration_t *other)
+{
+    OpenAPI_lnode_t *node;
+
+    if (!DISTRIBUTIONS(chc)) return false;
+
+    OpenAPI_list_for_each(DISTRIBUTIONS(chc), node) {
+        const msaf_api_distribution_configuration_t *dist_conf = node->data;
+        if (dist_conf->certificate_id && !_certificate_id_used(other, dist_conf->certificate_id)) return true;
+    }
+
+    return false;
+}
+
+static bool _certificate_id_used(const msaf_api_content_hosting_configuration_t *chc, const char *certificate_id)
+{
+    OpenAPI_lnode_t *node;
+
+    if (!DISTRIBUTIONS(chc)) return false;
+
+    OpenAPI_list_for_each(DISTRIBUTIONS(chc), node) {
+        const msaf_api_distribution_configuration_t *dist_conf = node->data;
+        if (dist_conf->certificate_id && !strcmp(dist_conf->certificate_id, certificate_id)) return true;
+    }
+
+    return false;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,71 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#ifndef MSAF_CONTENT_HOSTING_CONFIGURATION_DIFF_H
+#define MSAF_CONTENT_HOSTING_CONFIGURATION_DIFF_H
+
+#include <stdbool.h>
+
+#include "ogs-core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct msaf_api_content_hosting_configuration_s msaf_api_content_hosting_configuration_t;
+
+/* What changed between two ContentHostingConfigurations
+ *
+ * A ContentHostingConfiguration PUT replaces the whole configuration, but
+ * usually only part of it has changed, or nothing has at all. The diff says
+ * which parts changed so that only those are passed on:
+ * - changed is false when the new configuration has the same representation
+ *   as the old one, the update can be skipped entirely.
+ * - entry_points_changed is true when the streaming entry points, which are
+ *   the only part of the configuration in the Service Access Information,
+ *   are different.
+ * - certificates_added is true when a distribution uses a certificate that no
+ *   distribution used before, which will need uploading to the Application
+ *   Servers.
+ *
+ * Both configurations are compared with their generated fields (baseURL and
+ * canonicalDomainName) filled in, as they are served on M1 and sent on M3.
+ */
+typedef struct msaf_content_hosting_configuration_diff_s {
+    bool changed;                          /* the representation of the configuration is different */
+    bool distributions_changed;            /* any distribution configuration added, removed, modified or moved */
+    unsigned int distributions_added;      /* new distribution configurations without an identical old one */
+    unsigned int distributions_removed;    /* old distribution configurations without an identical new one */
+    unsigned int distributions_unchanged;  /* new distribution configurations with an identical old one */
+    bool entry_points_changed;             /* the streaming entry points or their base URLs are different */
+    bool certificates_added;               /* a certificate id is used which was not used before */
+    bool certificates_removed;             /* a certificate id is no longer used */
+    bool path_rewrite_rules_changed;       /* the path rewrite rules of the distributions are different */
+} msaf_content_hosting_configuration_diff_t;
+
+/* Compare old_chc with new_chc and fill in diff. A NULL configuration is treated as having no distribution
+ * configurations, so diffing against a NULL old_chc reports everything in new_chc as added. */
+extern void msaf_content_hosting_configuration_diff(msaf_content_hosting_configuration_diff_t *diff /* [out, not-null] */,
+                                        const msaf_api_content_hosting_configuration_t *old_chc /* [null] */,
+                                        const msaf_api_content_hosting_configuration_t *new_chc /* [null] */);
+
+/* Log the diff at debug level, e.g. "Content Hosting Configuration for Provisioning Session [...]: 1 distributions
+ * added, 1 removed, 2 unchanged, entry points changed" */
+extern void msaf_content_hosting_configuration_diff_log(const msaf_content_hosting_configuration_diff_t *diff /* [not-null] */,
+                                        const char *provisioning_session_id /* [not-null] */);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MSAF_CONTENT_HOSTING_CONFIGURATION_DIFF_H */
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
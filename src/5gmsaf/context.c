@@ -18,6 +18,9 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #include "policy-template.h"
 #include "dynamic-policy.h"
 #include "pcf-session.h"
+#include "change-feed.h"
+#include "provisioning-session-journal.h"
+#include "provisioning-session-list.h"
 #include "context.h"
 #include "utilities.h"
 
@@ -65,17 +68,29 @@ void msaf_context_init(void)
 
     self->pcf_cache = msaf_pcf_cache_new();
 
+    self->config.sai_cache.max_entries_per_session = MSAF_SAI_CACHE_DEFAULT_MAX_ENTRIES_PER_SESSION;
+    self->config.sai_cache.max_bytes = MSAF_SAI_CACHE_DEFAULT_MAX_BYTES;
+    self->config.json_format = MSAF_JSON_FORMAT_PRETTY;
+    msaf_data_collection_config_init(&self->config.data_collection);
+    msaf_rate_limit_config_init(&self->config.m5_rate_limit);
+    msaf_state_journal_config_init(&self->config.state_journal);
+
     msaf_server_response_cache_control_set();
     msaf_network_assistance_delivery_boost_set();
 
     self->dynamic_policies = msaf_dynamic_policy_new();
 
+    msaf_change_feed_init();
 }
 
 void msaf_context_final(void)
 {
     ogs_assert(self);
 
+    /* snapshot the provisioning sessions before they are freed */
+    msaf_provisioning_session_journal_final();
+    msaf_change_feed_final();
+
     if (self->provisioningSessions_map) {
         free_ogs_hash_context_t fohc = {
             (free_ogs_hash_context_free_value_fn)msaf_context_provisioning_session_free,
@@ -84,6 +99,7 @@ void msaf_context_final(void)
         ogs_hash_do(free_ogs_hash_entry, &fohc, self->provisioningSessions_map);
         ogs_hash_destroy(self->provisioningSessions_map);
     }
+    msaf_provisioning_session_list_final();
 
     if (self->content_hosting_configuration_file_map) {
         free_ogs_hash_context_t fohc = {
@@ -127,8 +143,13 @@ void msaf_context_final(void)
     
     msaf_pcf_cache_free(self->pcf_cache);
  
+    msaf_data_collection_final();
+    msaf_rate_limit_final();
+
     if (self->config.data_collection_dir)
         ogs_free(self->config.data_collection_dir);
+    msaf_state_journal_config_clear(&self->config.state_journal);
+    msaf_rate_limit_config_clear(&self->config.m5_rate_limit);
 
     msaf_application_server_remove_all();
 
@@ -527,8 +548,192 @@ int msaf_context_parse_config(void)
                     /* handle config in sbi library */
                 } else if (!strcmp(msaf_key, "discovery")) {
                     /* handle config in sbi library */
+                } else if (!strcmp(msaf_key, "serviceAccessInformationCache")) {
+                    ogs_yaml_iter_t sc_iter;
+                    ogs_yaml_iter_recurse(&msaf_iter, &sc_iter);
+                    if (ogs_yaml_iter_type(&sc_iter) != YAML_MAPPING_NODE) {
+                        ogs_error("msaf.serviceAccessInformationCache must be a mapping");
+                        return OGS_ERROR;
+                    }
+                    while (ogs_yaml_iter_next(&sc_iter)) {
+                        const char *sc_key = ogs_yaml_iter_key(&sc_iter);
+                        long int value;
+                        ogs_assert(sc_key);
+                        if (!strcmp(sc_key, "maxEntriesPerSession")) {
+                            value = ascii_to_long(ogs_yaml_iter_value(&sc_iter));
+                            if (value < 0) {
+                                ogs_error("msaf.serviceAccessInformationCache.maxEntriesPerSession cannot be negative");
+                                return OGS_ERROR;
+                            }
+                            self->config.sai_cache.max_entries_per_session = value;
+                        } else if (!strcmp(sc_key, "maxMemory")) {
+                            value = ascii_to_long(ogs_yaml_iter_value(&sc_iter));
+                            if (value < 0) {
+                                ogs_error("msaf.serviceAccessInformationCache.maxMemory cannot be negative");
+                                return OGS_ERROR;
+                            }
+                            self->config.sai_cache.max_bytes = value;
+                        } else {
+                            ogs_warn("unknown key `%s` in msaf.serviceAccessInformationCache", sc_key);
+                        }
+                    }
+                } else if (!strcmp(msaf_key, "jsonOutputFormat")) {
+                    const char *format = ogs_yaml_iter_value(&msaf_iter);
+                    if (!msaf_json_format_from_name(format, &self->config.json_format)) {
+                        ogs_error("msaf.jsonOutputFormat must be \"compact\" or \"pretty\", not \"%s\"", format?format:"");
+                        return OGS_ERROR;
+                    }
                 } else if (!strcmp(msaf_key, "dataCollectionDir")) {
                     self->config.data_collection_dir = msaf_strdup(ogs_yaml_iter_value(&msaf_iter));
+                } else if (!strcmp(msaf_key, "dataCollectionStorage")) {
+                    ogs_yaml_iter_t dcs_iter;
+                    ogs_yaml_iter_recurse(&msaf_iter, &dcs_iter);
+                    if (ogs_yaml_iter_type(&dcs_iter) != YAML_MAPPING_NODE) {
+                        ogs_error("msaf.dataCollectionStorage must be a mapping");
+                        return OGS_ERROR;
+                    }
+                    while (ogs_yaml_iter_next(&dcs_iter)) {
+                        const char *dcs_key = ogs_yaml_iter_key(&dcs_iter);
+                        const char *dcs_value = ogs_yaml_iter_value(&dcs_iter);
+                        long int value;
+                        ogs_assert(dcs_key);
+                        if (!strcmp(dcs_key, "type")) {
+                            if (!msaf_data_collection_storage_from_name(dcs_value, &self->config.data_collection.storage)) {
+                                ogs_error("msaf.dataCollectionStorage.type must be \"files\" or \"segmented\", not \"%s\"", dcs_value?dcs_value:"");
+                                return OGS_ERROR;
+                            }
+                        } else if (!strcmp(dcs_key, "segmentMaxSize")) {
+                            value = ascii_to_long(dcs_value);
+                            if (value < 0) {
+                                ogs_error("msaf.dataCollectionStorage.segmentMaxSize cannot be negative");
+                                return OGS_ERROR;
+                            }
+                            self->config.data_collection.log.segment_max_size = value;
+                        } else if (!strcmp(dcs_key, "segmentMaxAge")) {
+                            value = ascii_to_long(dcs_value);
+                            if (value < 0) {
+                                ogs_error("msaf.dataCollectionStorage.segmentMaxAge cannot be negative");
+                                return OGS_ERROR;
+                            }
+                            self->config.data_collection.log.segment_max_age = ogs_time_from_sec(value);
+                        } else if (!strcmp(dcs_key, "writerQueueLength")) {
+                            value = ascii_to_long(dcs_value);
+                            if (value < 0) {
+                                ogs_error("msaf.dataCollectionStorage.writerQueueLength cannot be negative");
+                                return OGS_ERROR;
+                            }
+                            self->config.data_collection.writer_queue_length = value;
+                        } else if (!strcmp(dcs_key, "retryAfter")) {
+                            value = ascii_to_long(dcs_value);
+                            if (value < 1) {
+                                ogs_error("msaf.dataCollectionStorage.retryAfter must be at least 1 second");
+                                return OGS_ERROR;
+                            }
+                            self->config.data_collection.retry_after = value;
+                        } else if (!strcmp(dcs_key, "fsync")) {
+                            if (!msaf_data_collection_log_fsync_from_name(dcs_value, &self->config.data_collection.log.fsync)) {
+                                ogs_error("msaf.dataCollectionStorage.fsync must be \"none\", \"rotate\" or \"always\", not \"%s\"", dcs_value?dcs_value:"");
+                                return OGS_ERROR;
+                            }
+                        } else {
+                            ogs_warn("unknown key `%s` in msaf.dataCollectionStorage", dcs_key);
+                        }
+                    }
+                } else if (!strcmp(msaf_key, "m5RateLimit")) {
+                    ogs_yaml_iter_t rl_iter;
+                    ogs_yaml_iter_recurse(&msaf_iter, &rl_iter);
+                    if (ogs_yaml_iter_type(&rl_iter) != YAML_MAPPING_NODE) {
+                        ogs_error("msaf.m5RateLimit must be a mapping");
+                        return OGS_ERROR;
+                    }
+                    while (ogs_yaml_iter_next(&rl_iter)) {
+                        const char *rl_key = ogs_yaml_iter_key(&rl_iter);
+                        const char *rl_value = ogs_yaml_iter_value(&rl_iter);
+                        ogs_assert(rl_key);
+                        if (!strcmp(rl_key, "clientRate") || !strcmp(rl_key, "sessionRate")) {
+                            char *end = NULL;
+                            double rate = rl_value?strtod(rl_value, &end):-1.0;
+                            if (!rl_value || end == rl_value || *end != '\0' || !(rate >= 0.0)) {
+                                ogs_error("msaf.m5RateLimit.%s must be a number of requests per second, 0 for no limit", rl_key);
+                                return OGS_ERROR;
+                            }
+                            if (rl_key[0] == 'c') {
+                                self->config.m5_rate_limit.client_rate = rate;
+                            } else {
+                                self->config.m5_rate_limit.session_rate = rate;
+                            }
+                        } else if (!strcmp(rl_key, "clientBurst") || !strcmp(rl_key, "sessionBurst")) {
+                            long int value = ascii_to_long(rl_value);
+                            if (value < 1) {
+                                ogs_error("msaf.m5RateLimit.%s must be at least 1", rl_key);
+                                return OGS_ERROR;
+                            }
+                            if (rl_key[0] == 'c') {
+                                self->config.m5_rate_limit.client_burst = value;
+                            } else {
+                                self->config.m5_rate_limit.session_burst = value;
+                            }
+                        } else if (!strcmp(rl_key, "maxBuckets")) {
+                            long int value = ascii_to_long(rl_value);
+                            if (value < 0) {
+                                ogs_error("msaf.m5RateLimit.maxBuckets cannot be negative");
+                                return OGS_ERROR;
+                            }
+                            self->config.m5_rate_limit.max_buckets = value;
+                        } else if (!strcmp(rl_key, "trustedProxies")) {
+                            ogs_yaml_iter_t proxy_iter;
+                            ogs_yaml_iter_recurse(&rl_iter, &proxy_iter);
+                            if (ogs_yaml_iter_type(&proxy_iter) == YAML_MAPPING_NODE) {
+                                ogs_error("msaf.m5RateLimit.trustedProxies must be a list of addresses or networks");
+                                return OGS_ERROR;
+                            }
+
+                            do {
+                                const char *proxy;
+
+                                if (ogs_yaml_iter_type(&proxy_iter) == YAML_SEQUENCE_NODE) {
+                                    if (!ogs_yaml_iter_next(&proxy_iter))
+                                        break;
+                                }
+
+                                proxy = ogs_yaml_iter_value(&proxy_iter);
+                                if (!proxy) continue;
+                                if (!msaf_rate_limit_config_add_trusted_proxy(&self->config.m5_rate_limit, proxy)) {
+                                    ogs_error("msaf.m5RateLimit.trustedProxies entry `%s` is not an address or network", proxy);
+                                    return OGS_ERROR;
+                                }
+                            } while (ogs_yaml_iter_type(&proxy_iter) == YAML_SEQUENCE_NODE);
+                        } else {
+                            ogs_warn("unknown key `%s` in msaf.m5RateLimit", rl_key);
+                        }
+                    }
+                } else if (!strcmp(msaf_key, "stateJournal")) {
+                    ogs_yaml_iter_t sj_iter;
+                    ogs_yaml_iter_recurse(&msaf_iter, &sj_iter);
+                    if (ogs_yaml_iter_type(&sj_iter) != YAML_MAPPING_NODE) {
+                        ogs_error("msaf.stateJournal must be a mapping");
+                        return OGS_ERROR;
+                    }
+                    while (ogs_yaml_iter_next(&sj_iter)) {
+                        const char *sj_key = ogs_yaml_iter_key(&sj_iter);
+                        const char *sj_value = ogs_yaml_iter_value(&sj_iter);
+                        ogs_assert(sj_key);
+                        if (!strcmp(sj_key, "directory")) {
+                            if (self->config.state_journal.directory) ogs_free(self->config.state_journal.directory);
+                            self->config.state_journal.directory = (sj_value && *sj_value)?msaf_strdup(sj_value):NULL;
+                        } else if (!strcmp(sj_key, "snapshotAfter")) {
+                            long int value = ascii_to_long(sj_value);
+                            if (value < 0) {
+                                ogs_error("msaf.stateJournal.snapshotAfter cannot be negative");
+                                return OGS_ERROR;
+                            }
+                            self->config.state_journal.snapshot_after = value;
+                        } else if (!strcmp(sj_key, "fsync")) {
+                            self->config.state_journal.fsync = ogs_yaml_iter_bool(&sj_iter);
+                        } else {
+                            ogs_warn("unknown key `%s` in msaf.stateJournal", sj_key);
+                        }
+                    }
                 } else if (!strcmp(msaf_key, "offerNetworkAssistance")) {
                     self->config.offerNetworkAssistance = ogs_yaml_iter_bool(&msaf_iter);
 		    msaf_context_network_assistance_session_init();
@@ -601,6 +806,10 @@ int msaf_context_parse_config(void)
         }
     }
 
+    msaf_sai_cache_set_limits(self->config.sai_cache.max_entries_per_session, self->config.sai_cache.max_bytes);
+    msaf_json_format_set(self->config.json_format);
+    msaf_rate_limit_init(&self->config.m5_rate_limit);
+
     rv = check_for_network_assistance_support();
     if (rv != OGS_OK) {
         ogs_debug("check_for_network_assistance_support() failed");
@@ -32,6 +32,10 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #include "response-cache-control.h"
 #include "network-assistance-delivery-boost.h"
 #include "pcf-cache.h"
+#include "json-format.h"
+#include "data-collection.h"
+#include "rate-limit.h"
+#include "state-journal.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -68,7 +72,15 @@ typedef struct msaf_configuration_s {
     int  number_of_application_servers;
 
     char *data_collection_dir;
+    msaf_data_collection_config_t data_collection;
+    msaf_rate_limit_config_t m5_rate_limit;
+    msaf_state_journal_config_t state_journal;
     bool offerNetworkAssistance;
+    struct {
+        size_t max_entries_per_session;
+        size_t max_bytes;
+    } sai_cache;
+    msaf_json_format_t json_format;
 } msaf_configuration_t;
 
 typedef struct msaf_context_s {
@@ -0,0 +1,571 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ogs-core.h"
+
+#include "data-collection-log.h"
+
+/*****************************************************
+ ***** Local declarations
+ *****************************************************/
+
+struct msaf_data_collection_log_s {
+    char *root_dir;
+    msaf_data_collection_log_config_t config;
+    ogs_hash_t *streams;              /* key: "<provisioning session id>/<report class>", value: msaf_data_collection_log_stream_t* */
+    bool batch;                       /* buffer records until msaf_data_collection_log_batch_end() */
+    unsigned int batch_failed;        /* buffered records that could not be written */
+};
+
+/* Reports for one provisioning session and report class */
+typedef struct msaf_data_collection_log_stream_s {
+    char *key;
+    char *directory;
+    int fd;                           /* -1 if no segment is open */
+    char *segment_path;
+    size_t segment_size;
+    ogs_time_t segment_opened;
+    unsigned int segment_seq;
+    char *pending;                    /* records buffered in a batch, not yet written */
+    size_t pending_len;
+    size_t pending_size;
+    unsigned int pending_records;
+} msaf_data_collection_log_stream_t;
+
+struct msaf_data_collection_log_reader_s {
+    FILE *fp;
+    char *buffer;
+    size_t buffer_size;
+};
+
+/* longest header line: magic and five lengths */
+#define RECORD_HEADER_MAX (sizeof(MSAF_DATA_COLLECTION_LOG_RECORD_MAGIC) + 5*21 + 1)
+
+static msaf_data_collection_log_stream_t *_stream_get(msaf_data_collection_log_t *log, const char *provisioning_session_id,
+                                                      const char *report_class);
+static void _stream_free(msaf_data_collection_log_t *log, msaf_data_collection_log_stream_t *stream);
+static bool _segment_open(msaf_data_collection_log_t *log, msaf_data_collection_log_stream_t *stream);
+static void _segment_close(msaf_data_collection_log_t *log, msaf_data_collection_log_stream_t *stream);
+static bool _segment_full(msaf_data_collection_log_t *log, msaf_data_collection_log_stream_t *stream, size_t record_size);
+static void _stream_buffer(msaf_data_collection_log_stream_t *stream, const struct iovec *iov, int iovcnt, size_t record_size);
+static bool _stream_flush(msaf_data_collection_log_t *log, msaf_data_collection_log_stream_t *stream);
+static bool _write_all(int fd, struct iovec *iov, int iovcnt);
+
+/*****************************************************
+ ***** Public functions
+ *****************************************************/
+
+const char *msaf_data_collection_log_fsync_name(msaf_data_collection_log_fsync_t fsync)
+{
+    switch (fsync) {
+    case MSAF_DATA_COLLECTION_LOG_FSYNC_NONE:
+        return "none";
+    case MSAF_DATA_COLLECTION_LOG_FSYNC_ROTATE:
+        return "rotate";
+    case MSAF_DATA_COLLECTION_LOG_FSYNC_ALWAYS:
+        return "always";
+    default:
+        break;
+    }
+    return NULL;
+}
+
+bool msaf_data_collection_log_fsync_from_name(const char *name, msaf_data_collection_log_fsync_t *fsync)
+{
+    if (!name || !fsync) return false;
+
+    if (!strcmp(name, "none")) {
+        *fsync = MSAF_DATA_COLLECTION_LOG_FSYNC_NONE;
+    } else if (!strcmp(name, "rotate")) {
+        *fsync = MSAF_DATA_COLLECTION_LOG_FSYNC_ROTATE;
+    } else if (!strcmp(name, "always")) {
+        *fsync = MSAF_DATA_COLLECTION_LOG_FSYNC_ALWAYS;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+msaf_data_collection_log_t *msaf_data_collection_log_new(const char *root_dir, const msaf_data_collection_log_config_t *config)
+{
+    msaf_data_collection_log_t *log;
+
+    ogs_assert(root_dir);
+    ogs_assert(config);
+
+    log = ogs_calloc(1, sizeof(*log));
+    ogs_assert(log);
+
+    log->root_dir = ogs_strdup(root_dir);
+    log->config = *config;
+    log->streams = ogs_hash_make();
+
+    return log;
+}
+
+void msaf_data_collection_log_free(msaf_data_collection_log_t *log)
+{
+    ogs_hash_index_t *hi;
+
+    if (!log) return;
+
+    while ((hi = ogs_hash_first(log->streams)) != NULL) {
+        _stream_free(log, (msaf_data_collection_log_stream_t*)ogs_hash_this_val(hi));
+    }
+    ogs_hash_destroy(log->streams);
+
+    ogs_free(log->root_dir);
+    ogs_free(log);
+}
+
+bool msaf_data_collection_log_append(msaf_data_collection_log_t *log, const char *provisioning_session_id,
+                                     const char *report_class, const char *client_id, const char *session_id,
+                                     const char *report_time, const char *format, const char *body, size_t body_len)
+{
+    msaf_data_collection_log_stream_t *stream;
+    char header[RECORD_HEADER_MAX];
+    struct iovec iov[11];
+    size_t client_id_len, session_id_len, report_time_len, format_len;
+    size_t record_size;
+    int header_len;
+    int i;
+
+    ogs_assert(log);
+    ogs_assert(provisioning_session_id);
+    ogs_assert(report_class);
+    ogs_assert(client_id);
+    ogs_assert(report_time);
+    ogs_assert(format);
+    ogs_assert(body);
+
+    if (!session_id) session_id = "";
+
+    client_id_len = strlen(client_id);
+    session_id_len = strlen(session_id);
+    report_time_len = strlen(report_time);
+    format_len = strlen(format);
+
+    header_len = snprintf(header, sizeof(header), "%s %zu %zu %zu %zu %zu\n", MSAF_DATA_COLLECTION_LOG_RECORD_MAGIC,
+                          client_id_len, session_id_len, report_time_len, format_len, body_len);
+    ogs_assert(header_len > 0 && header_len < sizeof(header));
+
+    iov[0].iov_base = header;
+    iov[0].iov_len = header_len;
+    iov[1].iov_base = (void*)client_id;
+    iov[1].iov_len = client_id_len;
+    iov[3].iov_base = (void*)session_id;
+    iov[3].iov_len = session_id_len;
+    iov[5].iov_base = (void*)report_time;
+    iov[5].iov_len = report_time_len;
+    iov[7].iov_base = (void*)format;
+    iov[7].iov_len = format_len;
+    iov[9].iov_base = (void*)body;
+    iov[9].iov_len = body_len;
+    for (i = 2; i <= 10; i += 2) {
+        iov[i].iov_base = "\n";
+        iov[i].iov_len = 1;
+    }
+
+    record_size = 0;
+    for (i = 0; i < 11; i++) record_size += iov[i].iov_len;
+
+    stream = _stream_get(log, provisioning_session_id, report_class);
+
+    if (stream->fd >= 0 && _segment_full(log, stream, record_size)) {
+        _segment_close(log, stream);
+    }
+
+    if (stream->fd < 0 && !_segment_open(log, stream)) return false;
+
+    if (log->batch) {
+        _stream_buffer(stream, iov, 11, record_size);
+        stream->segment_size += record_size;
+        if (stream->pending_len >= MSAF_DATA_COLLECTION_LOG_BATCH_MAX_BYTES && !_stream_flush(log, stream)) {
+            _segment_close(log, stream);
+        }
+        return true;
+    }
+
+    /* one writev per record so that concurrent readers rarely see a partial record */
+    if (!_write_all(stream->fd, iov, 11)) {
+        ogs_error("Failed to append %s report to %s: %s", report_class, stream->segment_path, strerror(errno));
+        /* start a new segment next time rather than appending after a partial record */
+        _segment_close(log, stream);
+        return false;
+    }
+
+    stream->segment_size += record_size;
+
+    if (log->config.fsync == MSAF_DATA_COLLECTION_LOG_FSYNC_ALWAYS && fdatasync(stream->fd) < 0) {
+        ogs_error("Failed to sync %s: %s", stream->segment_path, strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+void msaf_data_collection_log_batch_begin(msaf_data_collection_log_t *log)
+{
+    ogs_assert(log);
+
+    log->batch = true;
+    log->batch_failed = 0;
+}
+
+unsigned int msaf_data_collection_log_batch_end(msaf_data_collection_log_t *log)
+{
+    ogs_hash_index_t *hi;
+    unsigned int failed;
+
+    ogs_assert(log);
+
+    for (hi = ogs_hash_first(log->streams); hi; hi = ogs_hash_next(hi)) {
+        msaf_data_collection_log_stream_t *stream = (msaf_data_collection_log_stream_t*)ogs_hash_this_val(hi);
+        if (stream->pending_records && !_stream_flush(log, stream)) {
+            _segment_close(log, stream);
+        }
+    }
+
+    failed = log->batch_failed;
+    log->batch = false;
+    log->batch_failed = 0;
+
+    return failed;
+}
+
+void msaf_data_collection_log_close_provisioning_session(msaf_data_collection_log_t *log, const char *provisioning_session_id)
+{
+    ogs_hash_index_t *hi;
+    size_t id_len;
+
+    if (!log || !provisioning_session_id) return;
+
+    id_len = strlen(provisioning_session_id);
+
+    hi = ogs_hash_first(log->streams);
+    while (hi) {
+        msaf_data_collection_log_stream_t *stream = (msaf_data_collection_log_stream_t*)ogs_hash_this_val(hi);
+        hi = ogs_hash_next(hi);
+        if (!strncmp(stream->key, provisioning_session_id, id_len) && stream->key[id_len] == '/') {
+            _stream_free(log, stream);
+        }
+    }
+}
+
+bool msaf_data_collection_ensure_directory(const char *path)
+{
+    struct stat statbuf;
+    bool ret = false;
+
+    if ((path[0] == '/' || path[0] == '.') && path[1] == '\0') return true;
+
+    if (!stat(path, &statbuf)) {
+        if ((statbuf.st_mode & S_IFMT) == S_IFDIR) {
+            ret = true;
+        }
+    } else {
+        /* path doesn't exist so ensure parent directory is present and try to create wanted directory */
+        char *path_copy = ogs_strdup(path);
+        if (msaf_data_collection_ensure_directory(dirname(path_copy)) && (!mkdir(path, 0755) || errno == EEXIST)) {
+            ret = true;
+        }
+        ogs_free(path_copy);
+    }
+
+    return ret;
+}
+
+msaf_data_collection_log_reader_t *msaf_data_collection_log_reader_open(const char *segment_path)
+{
+    msaf_data_collection_log_reader_t *reader;
+    FILE *fp;
+
+    ogs_assert(segment_path);
+
+    fp = fopen(segment_path, "rb");
+    if (!fp) {
+        ogs_error("Unable to open report log segment %s: %s", segment_path, strerror(errno));
+        return NULL;
+    }
+
+    reader = ogs_calloc(1, sizeof(*reader));
+    ogs_assert(reader);
+    reader->fp = fp;
+
+    return reader;
+}
+
+int msaf_data_collection_log_reader_next(msaf_data_collection_log_reader_t *reader, msaf_data_collection_log_record_t *record)
+{
+    char header[RECORD_HEADER_MAX];
+    char magic[sizeof(MSAF_DATA_COLLECTION_LOG_RECORD_MAGIC)];
+    size_t lens[5];
+    size_t offsets[5];
+    size_t total;
+    int i;
+
+    ogs_assert(reader);
+    ogs_assert(record);
+
+    if (!fgets(header, sizeof(header), reader->fp)) {
+        return feof(reader->fp)?OGS_DONE:OGS_ERROR;
+    }
+
+    if (sscanf(header, "%8s %zu %zu %zu %zu %zu\n", magic, &lens[0], &lens[1], &lens[2], &lens[3], &lens[4]) != 6 ||
+        strcmp(magic, MSAF_DATA_COLLECTION_LOG_RECORD_MAGIC) != 0 || header[strlen(header)-1] != '\n') {
+        ogs_error("Bad report log record header");
+        return OGS_ERROR;
+    }
+
+    total = 0;
+    for (i = 0; i < 5; i++) {
+        if (lens[i] > SIZE_MAX - total - 1) return OGS_ERROR;
+        offsets[i] = total;
+        total += lens[i] + 1;
+    }
+
+    if (total > reader->buffer_size) {
+        char *buffer = ogs_realloc(reader->buffer, total);
+        if (!buffer) return OGS_ERROR;
+        reader->buffer = buffer;
+        reader->buffer_size = total;
+    }
+
+    if (fread(reader->buffer, 1, total, reader->fp) != total) {
+        ogs_error("Truncated report log record");
+        return OGS_ERROR;
+    }
+
+    /* terminate each field in place of its newline */
+    for (i = 0; i < 5; i++) {
+        if (reader->buffer[offsets[i] + lens[i]] != '\n') {
+            ogs_error("Corrupt report log record");
+            return OGS_ERROR;
+        }
+        reader->buffer[offsets[i] + lens[i]] = '\0';
+    }
+
+    record->client_id = reader->buffer + offsets[0];
+    record->session_id = lens[1]?(reader->buffer + offsets[1]):NULL;
+    record->report_time = reader->buffer + offsets[2];
+    record->format = reader->buffer + offsets[3];
+    record->body = reader->buffer + offsets[4];
+    record->body_len = lens[4];
+
+    return OGS_OK;
+}
+
+void msaf_data_collection_log_reader_close(msaf_data_collection_log_reader_t *reader)
+{
+    if (!reader) return;
+
+    fclose(reader->fp);
+    if (reader->buffer) ogs_free(reader->buffer);
+    ogs_free(reader);
+}
+
+/*****************************************************
+ ***** Private functions
+ *****************************************************/
+
+static msaf_data_collection_log_stream_t *_stream_get(msaf_data_collection_log_t *log, const char *provisioning_session_id,
+                                                      const char *report_class)
+{
+    msaf_data_collection_log_stream_t *stream;
+    char *key;
+
+    key = ogs_msprintf("%s/%s", provisioning_session_id, report_class);
+    stream = ogs_hash_get(log->streams, key, OGS_HASH_KEY_STRING);
+    if (stream) {
+        ogs_free(key);
+        return stream;
+    }
+
+    stream = ogs_calloc(1, sizeof(*stream));
+    ogs_assert(stream);
+    stream->key = key;
+    stream->directory = ogs_msprintf("%s/%s", log->root_dir, key);
+    stream->fd = -1;
+
+    ogs_hash_set(log->streams, stream->key, OGS_HASH_KEY_STRING, stream);
+
+    return stream;
+}
+
+static void _stream_free(msaf_data_collection_log_t *log, msaf_data_collection_log_stream_t *stream)
+{
+    _segment_close(log, stream);
+    ogs_hash_set(log->streams, stream->key, OGS_HASH_KEY_STRING, NULL);
+    ogs_free(stream->key);
+    ogs_free(stream->directory);
+    if (stream->pending) ogs_free(stream->pending);
+    ogs_free(stream);
+}
+
+static bool _segment_open(msaf_data_collection_log_t *log, msaf_data_collection_log_stream_t *stream)
+{
+    struct timespec ts;
+    struct tm tm;
+    char opened[32];
+    int attempts;
+
+    /* the directory is only checked when a segment is opened, not for every report */
+    if (!msaf_data_collection_ensure_directory(stream->directory)) {
+        ogs_error("Unable to create report directory %s", stream->directory);
+        return false;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    gmtime_r(&ts.tv_sec, &tm);
+    strftime(opened, sizeof(opened), "%Y%m%dT%H%M%S", &tm);
+
+    /* the sequence number disambiguates segments opened in the same microsecond, e.g. after a restart */
+    for (attempts = 0; attempts < 100; attempts++) {
+        stream->segment_path = ogs_msprintf("%s/%s.%06ldZ_%u%s", stream->directory, opened, (long)(ts.tv_nsec/1000),
+                                            stream->segment_seq++, MSAF_DATA_COLLECTION_LOG_SEGMENT_SUFFIX);
+        stream->fd = open(stream->segment_path, O_CREAT|O_WRONLY|O_EXCL|O_APPEND|O_CLOEXEC, 0664);
+        if (stream->fd >= 0) break;
+        if (errno != EEXIST) {
+            ogs_error("Unable to create %s for writing: %s", stream->segment_path, strerror(errno));
+            attempts = 100;
+        }
+        ogs_free(stream->segment_path);
+        stream->segment_path = NULL;
+    }
+
+    if (stream->fd < 0) return false;
+
+    ogs_debug("Opened report log segment %s", stream->segment_path);
+
+    stream->segment_size = 0;
+    stream->segment_opened = ogs_time_now();
+
+    return true;
+}
+
+static void _segment_close(msaf_data_collection_log_t *log, msaf_data_collection_log_stream_t *stream)
+{
+    if (stream->fd < 0) return;
+
+    /* on failure the buffered records are counted as failed and dropped */
+    _stream_flush(log, stream);
+
+    if (log->config.fsync == MSAF_DATA_COLLECTION_LOG_FSYNC_ROTATE && fdatasync(stream->fd) < 0) {
+        ogs_error("Failed to sync %s: %s", stream->segment_path, strerror(errno));
+    }
+
+    if (close(stream->fd) < 0) {
+        ogs_error("Failed to close %s: %s", stream->segment_path, strerror(errno));
+    }
+
+    ogs_debug("Closed report log segment %s (%zu bytes)", stream->segment_path, stream->segment_size);
+
+    stream->fd = -1;
+    ogs_free(stream->segment_path);
+    stream->segment_path = NULL;
+}
+
+static bool _segment_full(msaf_data_collection_log_t *log, msaf_data_collection_log_stream_t *stream, size_t record_size)
+{
+    /* an empty segment always takes the record, even if it is bigger than the size limit */
+    if (log->config.segment_max_size && stream->segment_size > 0 &&
+        stream->segment_size + record_size > log->config.segment_max_size) return true;
+
+    if (log->config.segment_max_age && ogs_time_now() - stream->segment_opened >= log->config.segment_max_age) return true;
+
+    return false;
+}
+
+static void _stream_buffer(msaf_data_collection_log_stream_t *stream, const struct iovec *iov, int iovcnt, size_t record_size)
+{
+    int i;
+
+    if (stream->pending_len + record_size > stream->pending_size) {
+        size_t size = stream->pending_size?stream->pending_size:4096;
+        while (size < stream->pending_len + record_size) size *= 2;
+        stream->pending = ogs_realloc(stream->pending, size);
+        ogs_assert(stream->pending);
+        stream->pending_size = size;
+    }
+
+    for (i = 0; i < iovcnt; i++) {
+        memcpy(stream->pending + stream->pending_len, iov[i].iov_base, iov[i].iov_len);
+        stream->pending_len += iov[i].iov_len;
+    }
+    stream->pending_records++;
+}
+
+/* Write the records buffered for a segment, the caller should close the segment if this fails */
+static bool _stream_flush(msaf_data_collection_log_t *log, msaf_data_collection_log_stream_t *stream)
+{
+    struct iovec iov;
+    bool ok = true;
+
+    if (!stream->pending_records) return true;
+
+    iov.iov_base = stream->pending;
+    iov.iov_len = stream->pending_len;
+
+    if (!_write_all(stream->fd, &iov, 1)) {
+        ogs_error("Failed to append %u reports to %s: %s", stream->pending_records, stream->segment_path, strerror(errno));
+        log->batch_failed += stream->pending_records;
+        ok = false;
+    } else if (log->config.fsync == MSAF_DATA_COLLECTION_LOG_FSYNC_ALWAYS && fdatasync(stream->fd) < 0) {
+        ogs_error("Failed to sync %s: %s", stream->segment_path, strerror(errno));
+        log->batch_failed += stream->pending_records;
+        ok = false;
+    }
+
+    stream->pending_len = 0;
+    stream->pending_records = 0;
+
+    return ok;
+}
+
+static bool _write_all(int fd, struct iovec *iov, int iovcnt)
+{
+    while (iovcnt > 0) {
+        ssize_t written = writev(fd, iov, iovcnt);
+
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        /* skip what was written, a short write leaves us part way through an iovec */
+        while (iovcnt > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+
+    return true;
+}
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,113 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+ */
+
+#ifndef DATA_COLLECTION_LOG_H
+#define DATA_COLLECTION_LOG_H
+
+#include <stdbool.h>
+
+#include "ogs-core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Segmented report log
+ *
+ * Reports are appended to the current segment file for their provisioning
+ * session and report class, in <root>/<provisioning session id>/<report class>/.
+ * Segments are named <UTC open time>_<sequence>.log, so that they sort in the
+ * order they were written, and are rotated when they reach the size or age
+ * limit. The age limit is checked when a report is appended.
+ *
+ * Each record is a header line followed by the fields and body, each of which
+ * is terminated by a newline that is not counted in its length:
+ *
+ *     MSAFREC1 <client id len> <session id len> <report time len> <format len> <body len>\n
+ *     <client id>\n
+ *     <session id>\n
+ *     <report time>\n
+ *     <format>\n
+ *     <body>\n
+ */
+
+#define MSAF_DATA_COLLECTION_LOG_RECORD_MAGIC "MSAFREC1"
+#define MSAF_DATA_COLLECTION_LOG_SEGMENT_SUFFIX ".log"
+
+/* Most bytes buffered for one segment in a batch before they are written */
+#define MSAF_DATA_COLLECTION_LOG_BATCH_MAX_BYTES (256*1024)
+
+/* Defaults, 0 means unlimited */
+#define MSAF_DATA_COLLECTION_LOG_DEFAULT_SEGMENT_MAX_SIZE (64*1024*1024)
+#define MSAF_DATA_COLLECTION_LOG_DEFAULT_SEGMENT_MAX_AGE ogs_time_from_sec(3600)
+
+typedef enum msaf_data_collection_log_fsync_e {
+    MSAF_DATA_COLLECTION_LOG_FSYNC_NONE = 0,  /* leave it to the OS */
+    MSAF_DATA_COLLECTION_LOG_FSYNC_ROTATE,    /* when a segment is closed */
+    MSAF_DATA_COLLECTION_LOG_FSYNC_ALWAYS     /* after every record */
+} msaf_data_collection_log_fsync_t;
+
+typedef struct msaf_data_collection_log_config_s {
+    size_t segment_max_size;
+    ogs_time_t segment_max_age;
+    msaf_data_collection_log_fsync_t fsync;
+} msaf_data_collection_log_config_t;
+
+typedef struct msaf_data_collection_log_s msaf_data_collection_log_t;
+
+typedef struct msaf_data_collection_log_record_s {
+    const char *client_id;
+    const char *session_id;    /* NULL if the report had no session id */
+    const char *report_time;
+    const char *format;
+    const char *body;
+    size_t body_len;
+} msaf_data_collection_log_record_t;
+
+typedef struct msaf_data_collection_log_reader_s msaf_data_collection_log_reader_t;
+
+extern const char *msaf_data_collection_log_fsync_name(msaf_data_collection_log_fsync_t fsync);
+extern bool msaf_data_collection_log_fsync_from_name(const char *name, msaf_data_collection_log_fsync_t *fsync);
+
+extern msaf_data_collection_log_t *msaf_data_collection_log_new(const char *root_dir, const msaf_data_collection_log_config_t *config);
+/* Closes all open segments */
+extern void msaf_data_collection_log_free(msaf_data_collection_log_t *log);
+
+extern bool msaf_data_collection_log_append(msaf_data_collection_log_t *log, const char *provisioning_session_id,
+                                            const char *report_class, const char *client_id, const char *session_id,
+                                            const char *report_time, const char *format, const char *body, size_t body_len);
+/* Between batch_begin and batch_end appended records are buffered for each segment, so that they are written with a single
+ * write and, with fsync "always", synced once per segment. Records are also written when the buffer reaches
+ * MSAF_DATA_COLLECTION_LOG_BATCH_MAX_BYTES or the segment is closed. batch_end returns the number of records appended in the
+ * batch that could not be written. */
+extern void msaf_data_collection_log_batch_begin(msaf_data_collection_log_t *log);
+extern unsigned int msaf_data_collection_log_batch_end(msaf_data_collection_log_t *log);
+/* Close the open segments of a provisioning session, the next report starts a new segment */
+extern void msaf_data_collection_log_close_provisioning_session(msaf_data_collection_log_t *log,
+                                                                const char *provisioning_session_id);
+
+/* Create path and any missing parent directories, returns true if path is now a directory */
+extern bool msaf_data_collection_ensure_directory(const char *path);
+
+/* Read the records of one segment in the order they were written. msaf_data_collection_log_reader_next() returns OGS_OK and
+ * fills in record, which remains valid until the next call, OGS_DONE at the end of the segment or OGS_ERROR if the rest of
+ * the segment is truncated or corrupt. */
+extern msaf_data_collection_log_reader_t *msaf_data_collection_log_reader_open(const char *segment_path);
+extern int msaf_data_collection_log_reader_next(msaf_data_collection_log_reader_t *reader, msaf_data_collection_log_record_t *record);
+extern void msaf_data_collection_log_reader_close(msaf_data_collection_log_reader_t *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
+
+#endif /* ifndef DATA_COLLECTION_LOG_H */
@@ -10,10 +10,8 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 
 #include <errno.h>
 #include <fcntl.h>
-#include <libgen.h>
 #include <stdbool.h>
 #include <string.h>
-#include <sys/stat.h>
 #include <unistd.h>
 
 #include "ogs-core.h"
@@ -26,60 +24,266 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
  ***** Local declarations
  *****************************************************/
 
-static bool ensure_directory(const char *path);
+typedef enum data_collection_job_type_e {
+    DATA_COLLECTION_JOB_STORE,
+    DATA_COLLECTION_JOB_CLOSE_PROVISIONING_SESSION,
+    DATA_COLLECTION_JOB_STOP
+} data_collection_job_type_t;
+
+/* Work for the writer thread. The strings are copied into the same allocation as the job. */
+typedef struct data_collection_job_s {
+    data_collection_job_type_t type;
+    ogs_time_t queued;
+    bool segmented;                   /* always use segmented storage */
+    const char *provisioning_session_id;
+    const char *report_class;
+    const char *client_id;
+    const char *session_id;
+    const char *report_time;
+    const char *format;
+    const char *report_body;
+    size_t report_body_len;
+} data_collection_job_t;
+
+/* Counters for a batch of writer thread jobs, added to the stats together */
+typedef struct data_collection_batch_s {
+    unsigned int jobs;
+    unsigned int stored;
+    unsigned int failed;
+    ogs_time_t queue_time_total;
+    ogs_time_t queue_time_max;
+} data_collection_batch_t;
+
+/* Most jobs taken from the writer queue before the reports written so far are flushed */
+#define DATA_COLLECTION_WRITE_BATCH 64
+
+/* Only used by the writer thread when it is running, otherwise only used by the event loop */
+static msaf_data_collection_log_t *report_log = NULL;
+
+static ogs_queue_t *writer_queue = NULL;
+static ogs_thread_t *writer_thread = NULL;
+
+static bool initialised = false;
+static ogs_thread_mutex_t stats_mutex;
+static msaf_data_collection_stats_t stats;
+
+static msaf_data_collection_result_t store(bool segmented, const char *provisioning_session_id, const char *report_class,
+                                           const char *client_id, const char *session_id, const char *report_time,
+                                           const char *format, const char *report_body);
+static msaf_data_collection_log_t *get_report_log(void);
+static bool store_report(bool segmented, const char *provisioning_session_id, const char *report_class, const char *client_id,
+                         const char *session_id, const char *report_time, const char *format, const char *report_body,
+                         size_t report_body_len);
 static int open_data_store_file(const char *provisioning_session_id, const char *report_class, const char *client_id,
                                 const char *session_id, const char *report_time, const char *format);
+static data_collection_job_t *job_new(data_collection_job_type_t type, const char *provisioning_session_id,
+                                      const char *report_class, const char *client_id, const char *session_id,
+                                      const char *report_time, const char *format, const char *report_body);
+static void queue_job_wait(data_collection_job_t *job);
+static void record_write(bool stored, ogs_time_t queue_time, ogs_time_t write_time);
+static bool writer_run_job(data_collection_job_t *job, data_collection_batch_t *batch);
+static void record_batch(const data_collection_batch_t *batch, unsigned int failed_writes, ogs_time_t write_time);
+static void writer_main(void *data);
 
 /*****************************************************
  ***** Public functions
  *****************************************************/
 
-bool msaf_data_collection_store(const char *provisioning_session_id, const char *report_class, const char *client_id,
-                                const char *session_id, const char *report_time, const char *format, const char *report_body)
+void msaf_data_collection_config_init(msaf_data_collection_config_t *config)
 {
-    int fd;
-    size_t body_len;
+    ogs_assert(config);
 
-    fd = open_data_store_file(provisioning_session_id, report_class, client_id, session_id, report_time, format);
-    
-    if (fd < 0) {
-        return false;
-    }
+    config->storage = MSAF_DATA_COLLECTION_STORAGE_FILES;
+    config->log.segment_max_size = MSAF_DATA_COLLECTION_LOG_DEFAULT_SEGMENT_MAX_SIZE;
+    config->log.segment_max_age = MSAF_DATA_COLLECTION_LOG_DEFAULT_SEGMENT_MAX_AGE;
+    config->log.fsync = MSAF_DATA_COLLECTION_LOG_FSYNC_ROTATE;
+    config->writer_queue_length = MSAF_DATA_COLLECTION_DEFAULT_WRITER_QUEUE_LENGTH;
+    config->retry_after = MSAF_DATA_COLLECTION_DEFAULT_RETRY_AFTER;
+}
 
-    body_len = strlen(report_body);
+bool msaf_data_collection_storage_from_name(const char *name, msaf_data_collection_storage_t *storage)
+{
+    if (!name || !storage) return false;
 
-    if (write(fd, report_body, body_len) != body_len) {
-        ogs_error("Failed to write %s data report: %s", report_class, strerror(errno));
+    if (!strcmp(name, "files")) {
+        *storage = MSAF_DATA_COLLECTION_STORAGE_FILES;
+    } else if (!strcmp(name, "segmented")) {
+        *storage = MSAF_DATA_COLLECTION_STORAGE_SEGMENTED;
+    } else {
         return false;
     }
 
     return true;
 }
 
+msaf_data_collection_result_t msaf_data_collection_store(const char *provisioning_session_id, const char *report_class,
+                                                         const char *client_id, const char *session_id, const char *report_time,
+                                                         const char *format, const char *report_body)
+{
+    return store(false, provisioning_session_id, report_class, client_id, session_id, report_time, format, report_body);
+}
+
+msaf_data_collection_result_t msaf_data_collection_append(const char *provisioning_session_id, const char *report_class,
+                                                          const char *client_id, const char *session_id, const char *report_time,
+                                                          const char *format, const char *report_body)
+{
+    return store(true, provisioning_session_id, report_class, client_id, session_id, report_time, format, report_body);
+}
+
+int msaf_data_collection_init(void)
+{
+    size_t queue_length = msaf_self()->config.data_collection.writer_queue_length;
+
+    ogs_thread_mutex_init(&stats_mutex);
+    memset(&stats, 0, sizeof(stats));
+    initialised = true;
+
+    if (!queue_length || !msaf_self()->config.data_collection_dir) return OGS_OK;
+
+    writer_queue = ogs_queue_create(queue_length);
+    if (!writer_queue) {
+        ogs_error("Unable to create the data collection writer queue");
+        return OGS_ERROR;
+    }
+
+    writer_thread = ogs_thread_create(writer_main, NULL);
+    if (!writer_thread) {
+        ogs_error("Unable to start the data collection writer thread");
+        ogs_queue_destroy(writer_queue);
+        writer_queue = NULL;
+        return OGS_ERROR;
+    }
+
+    stats.queue_length = queue_length;
+
+    return OGS_OK;
+}
+
+void msaf_data_collection_get_stats(msaf_data_collection_stats_t *stats_out)
+{
+    ogs_assert(stats_out);
+
+    ogs_thread_mutex_lock(&stats_mutex);
+    *stats_out = stats;
+    ogs_thread_mutex_unlock(&stats_mutex);
+}
+
+void msaf_data_collection_provisioning_session_closed(const char *provisioning_session_id)
+{
+    if (writer_queue) {
+        /* the writer thread owns the open segments, so it has to close them */
+        queue_job_wait(job_new(DATA_COLLECTION_JOB_CLOSE_PROVISIONING_SESSION, provisioning_session_id, NULL, NULL, NULL, NULL,
+                               NULL, NULL));
+        return;
+    }
+
+    msaf_data_collection_log_close_provisioning_session(report_log, provisioning_session_id);
+}
+
+void msaf_data_collection_final(void)
+{
+    if (writer_queue) {
+        /* the stop job is queued behind any waiting reports, so they are all written before the thread exits */
+        queue_job_wait(job_new(DATA_COLLECTION_JOB_STOP, NULL, NULL, NULL, NULL, NULL, NULL, NULL));
+        ogs_thread_destroy(writer_thread);
+        writer_thread = NULL;
+        ogs_queue_destroy(writer_queue);
+        writer_queue = NULL;
+    }
+
+    msaf_data_collection_log_free(report_log);
+    report_log = NULL;
+
+    if (initialised) {
+        ogs_thread_mutex_destroy(&stats_mutex);
+        initialised = false;
+    }
+}
+
 /*****************************************************
  ***** Private functions
  *****************************************************/
 
-static bool ensure_directory(const char *path)
+static msaf_data_collection_result_t store(bool segmented, const char *provisioning_session_id, const char *report_class,
+                                           const char *client_id, const char *session_id, const char *report_time,
+                                           const char *format, const char *report_body)
 {
-    struct stat statbuf;
-    bool ret = false;
+    data_collection_job_t *job;
+    int rv;
 
-    if ((path[0] == '/' || path[0] == '.') && path[1] == '\0') return true;
+    if (!writer_queue) {
+        ogs_time_t start = ogs_get_monotonic_time();
+        bool stored = store_report(segmented, provisioning_session_id, report_class, client_id, session_id, report_time, format,
+                                   report_body, strlen(report_body));
+        record_write(stored, 0, ogs_get_monotonic_time() - start);
+        return stored?MSAF_DATA_COLLECTION_STORED:MSAF_DATA_COLLECTION_FAILED;
+    }
 
-    if (!stat(path, &statbuf)) {
-        if ((statbuf.st_mode & S_IFMT) == S_IFDIR) {
-            ret = true;
-        }
-    } else {
-        /* path doesn't exist so ensure parent directory is present and try to create wanted directory */
-        char *path_copy = ogs_strdup(path); 
-        if (ensure_directory(dirname(path_copy)) && !mkdir(path, 0755)) {
-            ret = true;
+    job = job_new(DATA_COLLECTION_JOB_STORE, provisioning_session_id, report_class, client_id, session_id, report_time, format,
+                  report_body);
+    job->segmented = segmented;
+
+    /* count the job before it is visible to the writer thread so the depth never goes negative */
+    ogs_thread_mutex_lock(&stats_mutex);
+    stats.queue_depth++;
+    if (stats.queue_depth > stats.queue_depth_max) stats.queue_depth_max = stats.queue_depth;
+    ogs_thread_mutex_unlock(&stats_mutex);
+
+    rv = ogs_queue_trypush(writer_queue, job);
+    if (rv != OGS_OK) {
+        ogs_thread_mutex_lock(&stats_mutex);
+        stats.queue_depth--;
+        if (rv == OGS_RETRY) stats.rejected++;
+        ogs_thread_mutex_unlock(&stats_mutex);
+        ogs_free(job);
+        if (rv == OGS_RETRY) {
+            ogs_warn("Data collection writer queue full, refusing %s report for provisioning session [%s]", report_class,
+                     provisioning_session_id);
+            return MSAF_DATA_COLLECTION_BUSY;
         }
-        ogs_free(path_copy);
+        ogs_error("Unable to queue %s report for provisioning session [%s]", report_class, provisioning_session_id);
+        return MSAF_DATA_COLLECTION_FAILED;
+    }
+
+    return MSAF_DATA_COLLECTION_STORED;
+}
+
+static msaf_data_collection_log_t *get_report_log(void)
+{
+    if (!report_log && msaf_self()->config.data_collection_dir) {
+        report_log = msaf_data_collection_log_new(msaf_self()->config.data_collection_dir,
+                                                  &msaf_self()->config.data_collection.log);
     }
 
+    return report_log;
+}
+
+static bool store_report(bool segmented, const char *provisioning_session_id, const char *report_class, const char *client_id,
+                         const char *session_id, const char *report_time, const char *format, const char *report_body,
+                         size_t report_body_len)
+{
+    int fd;
+    bool ret = true;
+
+    if (segmented || msaf_self()->config.data_collection.storage == MSAF_DATA_COLLECTION_STORAGE_SEGMENTED) {
+        if (!get_report_log()) return false;
+        return msaf_data_collection_log_append(report_log, provisioning_session_id, report_class, client_id, session_id,
+                                               report_time, format, report_body, report_body_len);
+    }
+
+    fd = open_data_store_file(provisioning_session_id, report_class, client_id, session_id, report_time, format);
+    
+    if (fd < 0) {
+        return false;
+    }
+
+    if (write(fd, report_body, report_body_len) != report_body_len) {
+        ogs_error("Failed to write %s data report: %s", report_class, strerror(errno));
+        ret = false;
+    }
+
+    close(fd);
+
     return ret;
 }
 
@@ -96,7 +300,7 @@ static int open_data_store_file(const char *provisioning_session_id, const char
 
     reportdir = ogs_msprintf("%s/%s/%s", report_root, provisioning_session_id, report_class);
 
-    if (!ensure_directory(reportdir)) {
+    if (!msaf_data_collection_ensure_directory(reportdir)) {
         ogs_error("Unable to create report directory %s", reportdir);
         ogs_free(reportdir);
         return -1;
@@ -116,5 +320,186 @@ static int open_data_store_file(const char *provisioning_session_id, const char
     return fd;
 }
 
+static data_collection_job_t *job_new(data_collection_job_type_t type, const char *provisioning_session_id,
+                                      const char *report_class, const char *client_id, const char *session_id,
+                                      const char *report_time, const char *format, const char *report_body)
+{
+    const char *strings[7];
+    const char **fields[7];
+    size_t lens[7];
+    size_t size;
+    data_collection_job_t *job;
+    char *p;
+    int i;
+
+    strings[0] = provisioning_session_id;
+    strings[1] = report_class;
+    strings[2] = client_id;
+    strings[3] = session_id;
+    strings[4] = report_time;
+    strings[5] = format;
+    strings[6] = report_body;
+
+    size = sizeof(*job);
+    for (i = 0; i < 7; i++) {
+        lens[i] = strings[i]?strlen(strings[i]):0;
+        if (strings[i]) size += lens[i] + 1;
+    }
+
+    job = ogs_malloc(size);
+    ogs_assert(job);
+    memset(job, 0, sizeof(*job));
+
+    job->type = type;
+    job->queued = ogs_get_monotonic_time();
+
+    fields[0] = &job->provisioning_session_id;
+    fields[1] = &job->report_class;
+    fields[2] = &job->client_id;
+    fields[3] = &job->session_id;
+    fields[4] = &job->report_time;
+    fields[5] = &job->format;
+    fields[6] = &job->report_body;
+
+    p = (char*)(job + 1);
+    for (i = 0; i < 7; i++) {
+        if (!strings[i]) continue;
+        memcpy(p, strings[i], lens[i] + 1);
+        *fields[i] = p;
+        p += lens[i] + 1;
+    }
+    job->report_body_len = lens[6];
+
+    return job;
+}
+
+/* Queue a control job, waiting for space if the queue is full */
+static void queue_job_wait(data_collection_job_t *job)
+{
+    int rv;
+
+    ogs_thread_mutex_lock(&stats_mutex);
+    stats.queue_depth++;
+    ogs_thread_mutex_unlock(&stats_mutex);
+
+    rv = ogs_queue_push(writer_queue, job);
+    if (rv != OGS_OK) {
+        ogs_error("Unable to queue data collection writer job [%d]", rv);
+        ogs_thread_mutex_lock(&stats_mutex);
+        stats.queue_depth--;
+        ogs_thread_mutex_unlock(&stats_mutex);
+        ogs_free(job);
+    }
+}
+
+static void record_write(bool stored, ogs_time_t queue_time, ogs_time_t write_time)
+{
+    ogs_thread_mutex_lock(&stats_mutex);
+    if (stored) {
+        stats.stored++;
+    } else {
+        stats.failed++;
+    }
+    stats.queue_time_total += queue_time;
+    if (queue_time > stats.queue_time_max) stats.queue_time_max = queue_time;
+    stats.write_time_total += write_time;
+    if (write_time > stats.write_time_max) stats.write_time_max = write_time;
+    ogs_thread_mutex_unlock(&stats_mutex);
+}
+
+static bool writer_run_job(data_collection_job_t *job, data_collection_batch_t *batch)
+{
+    batch->jobs++;
+
+    switch (job->type) {
+    case DATA_COLLECTION_JOB_STORE:
+        {
+            ogs_time_t queue_time = ogs_get_monotonic_time() - job->queued;
+            bool stored = store_report(job->segmented, job->provisioning_session_id, job->report_class, job->client_id,
+                                       job->session_id, job->report_time, job->format, job->report_body, job->report_body_len);
+            if (stored) {
+                batch->stored++;
+            } else {
+                batch->failed++;
+                ogs_error("Failed to store %s report for provisioning session [%s]", job->report_class,
+                          job->provisioning_session_id);
+            }
+            batch->queue_time_total += queue_time;
+            if (queue_time > batch->queue_time_max) batch->queue_time_max = queue_time;
+        }
+        break;
+    case DATA_COLLECTION_JOB_CLOSE_PROVISIONING_SESSION:
+        msaf_data_collection_log_close_provisioning_session(report_log, job->provisioning_session_id);
+        break;
+    case DATA_COLLECTION_JOB_STOP:
+    default:
+        return false;
+    }
+
+    return true;
+}
+
+/* failed_writes are reports counted as stored in the batch that were buffered but could not be written */
+static void record_batch(const data_collection_batch_t *batch, unsigned int failed_writes, ogs_time_t write_time)
+{
+    unsigned int reports = batch->stored + batch->failed;
+
+    if (failed_writes > batch->stored) failed_writes = batch->stored;
+
+    ogs_thread_mutex_lock(&stats_mutex);
+    stats.queue_depth -= batch->jobs;
+    stats.stored += batch->stored - failed_writes;
+    stats.failed += batch->failed + failed_writes;
+    if (reports) {
+        /* the reports in a batch share its write time */
+        stats.queue_time_total += batch->queue_time_total;
+        if (batch->queue_time_max > stats.queue_time_max) stats.queue_time_max = batch->queue_time_max;
+        stats.write_time_total += write_time;
+        if (write_time / reports > stats.write_time_max) stats.write_time_max = write_time / reports;
+    }
+    ogs_thread_mutex_unlock(&stats_mutex);
+}
+
+/* The writer thread owns the report files, reports are written in the order they were queued. Jobs already waiting are
+ * taken together, so that the reports for each segment are written, and synced, once per batch rather than per report. */
+static void writer_main(void *data)
+{
+    bool running = true;
+
+    while (running) {
+        data_collection_job_t *job = NULL;
+        data_collection_batch_t batch;
+        msaf_data_collection_log_t *log;
+        unsigned int failed_writes = 0;
+        ogs_time_t start;
+        int rv;
+
+        rv = ogs_queue_pop(writer_queue, (void**)&job);
+        if (rv == OGS_DONE) break;
+        if (rv != OGS_OK || !job) continue;
+
+        memset(&batch, 0, sizeof(batch));
+        start = ogs_get_monotonic_time();
+
+        log = get_report_log();
+        if (log) msaf_data_collection_log_batch_begin(log);
+
+        do {
+            running = writer_run_job(job, &batch);
+            ogs_free(job);
+            job = NULL;
+        } while (running && batch.jobs < DATA_COLLECTION_WRITE_BATCH &&
+                 ogs_queue_trypop(writer_queue, (void**)&job) == OGS_OK && job);
+
+        if (log) failed_writes = msaf_data_collection_log_batch_end(log);
+
+        record_batch(&batch, failed_writes, ogs_get_monotonic_time() - start);
+    }
+
+    /* close segments from this thread, they may be waiting for a final fsync */
+    msaf_data_collection_log_free(report_log);
+    report_log = NULL;
+}
+
 /* vim:ts=8:sts=4:sw=4:expandtab:
  */
@@ -12,11 +12,68 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #define DATA_COLLECTION_H
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#include "ogs-core.h"
+
+#include "data-collection-log.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+typedef enum msaf_data_collection_storage_e {
+    MSAF_DATA_COLLECTION_STORAGE_FILES = 0,   /* one file per report */
+    MSAF_DATA_COLLECTION_STORAGE_SEGMENTED    /* reports appended to rotating segment files */
+} msaf_data_collection_storage_t;
+
+typedef struct msaf_data_collection_config_s {
+    msaf_data_collection_storage_t storage;
+    msaf_data_collection_log_config_t log;    /* segmented storage settings */
+    size_t writer_queue_length;               /* reports waiting for the writer thread, 0 to write on the event loop */
+    int retry_after;                          /* Retry-After seconds for reports refused when the queue is full */
+} msaf_data_collection_config_t;
+
+/* Default number of reports that can be waiting for the writer thread */
+#define MSAF_DATA_COLLECTION_DEFAULT_WRITER_QUEUE_LENGTH 1024
+#define MSAF_DATA_COLLECTION_DEFAULT_RETRY_AFTER 1
+
+typedef enum msaf_data_collection_result_e {
+    MSAF_DATA_COLLECTION_STORED = 0,          /* stored, or queued for the writer thread */
+    MSAF_DATA_COLLECTION_BUSY,                /* the writer queue is full, the client should retry later */
+    MSAF_DATA_COLLECTION_FAILED               /* the report could not be stored */
+} msaf_data_collection_result_t;
+
+typedef struct msaf_data_collection_stats_s {
+    uint64_t stored;                  /* reports written */
+    uint64_t failed;                  /* reports that could not be written */
+    uint64_t rejected;                /* reports refused because the writer queue was full */
+    size_t queue_length;              /* writer queue capacity, 0 if reports are written on the event loop */
+    size_t queue_depth;               /* reports currently waiting for the writer thread */
+    size_t queue_depth_max;           /* most reports seen waiting for the writer thread */
+    ogs_time_t queue_time_total;      /* total time reports waited for the writer thread */
+    ogs_time_t queue_time_max;
+    ogs_time_t write_time_total;      /* total time spent writing reports */
+    ogs_time_t write_time_max;
+} msaf_data_collection_stats_t;
+
+/**
+ * Set the default data collection storage configuration
+ *
+ * @param[out] config The configuration to initialise.
+ */
+void msaf_data_collection_config_init(msaf_data_collection_config_t *config);
+
+/**
+ * Find the storage type for a configuration name
+ *
+ * @param[in] name The storage name, "files" or "segmented".
+ * @param[out] storage Set to the storage type if @a name is recognised.
+ *
+ * @return @c true if the name was recognised or @c false if it was not.
+ */
+bool msaf_data_collection_storage_from_name(const char *name, msaf_data_collection_storage_t *storage);
+
 /**
  * Store a Data Collection report
  *
@@ -28,11 +85,50 @@ extern "C" {
  * @param[in] format The file format for the body (i.e. the file extension "json" or "xml").
  * @param[in] report_body The body of the report to store.
  *
- * @return @c true is the report was successfully stored or \c false if storage failed.
+ * @return @c MSAF_DATA_COLLECTION_STORED if the report was stored or queued for the writer thread,
+ *         @c MSAF_DATA_COLLECTION_BUSY if the writer queue is full or @c MSAF_DATA_COLLECTION_FAILED if storage failed.
  */
-bool msaf_data_collection_store(const char *provisioning_session_id, const char *report_class, const char *client_id,
+msaf_data_collection_result_t msaf_data_collection_store(const char *provisioning_session_id, const char *report_class, const char *client_id,
                                 const char *session_id, const char *report_time, const char *format, const char *report_body);
 
+/**
+ * Store a Data Collection report in segmented storage
+ *
+ * As msaf_data_collection_store() but the report is always appended to a segment file, whatever storage type is configured.
+ * This is for report classes that arrive at rates where creating a file for each report would be too costly.
+ *
+ * @return @c MSAF_DATA_COLLECTION_STORED if the report was stored or queued for the writer thread,
+ *         @c MSAF_DATA_COLLECTION_BUSY if the writer queue is full or @c MSAF_DATA_COLLECTION_FAILED if storage failed.
+ */
+msaf_data_collection_result_t msaf_data_collection_append(const char *provisioning_session_id, const char *report_class, const char *client_id,
+                                const char *session_id, const char *report_time, const char *format, const char *report_body);
+
+/**
+ * Start the writer thread, if configured
+ *
+ * @return @c OGS_OK on success or @c OGS_ERROR if the writer thread could not be started.
+ */
+int msaf_data_collection_init(void);
+
+/**
+ * Get a snapshot of the data collection counters
+ *
+ * @param[out] stats The structure to fill in.
+ */
+void msaf_data_collection_get_stats(msaf_data_collection_stats_t *stats);
+
+/**
+ * Close any open report storage for a provisioning session
+ *
+ * @param[in] provisioning_session_id The provisioning session id that is being removed.
+ */
+void msaf_data_collection_provisioning_session_closed(const char *provisioning_session_id);
+
+/**
+ * Write any queued reports, stop the writer thread and close all open report storage
+ */
+void msaf_data_collection_final(void);
+
 #ifdef __cplusplus
 }
 #endif
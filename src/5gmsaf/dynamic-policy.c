@@ -12,6 +12,7 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #include "dynamic-policy.h"
 #include "pcf-session.h"
 #include "hash.h"
+#include "json-format.h"
 
 typedef struct retrieve_pcf_binding_cb_data_s {
     ue_network_identifier_t *ue_connection;
@@ -315,20 +316,17 @@ static msaf_dynamic_policy_t *msaf_dynamic_policy_init(void){
 static void update_dynamic_policy_context(msaf_dynamic_policy_t *msaf_dynamic_policy, msaf_api_dynamic_policy_t *dynamic_policy) {
   
     cJSON *dynamic_policy_json;	
-    char *dynamic_policy_to_hash;
     
     dynamic_policy_json = msaf_api_dynamic_policy_convertResponseToJSON(dynamic_policy);
     if(dynamic_policy_json) {
-        dynamic_policy_to_hash = cJSON_Print(dynamic_policy_json);
         if(msaf_dynamic_policy->hash) ogs_free(msaf_dynamic_policy->hash);
-        msaf_dynamic_policy->hash = calculate_hash(dynamic_policy_to_hash);
+        msaf_dynamic_policy->hash = msaf_json_hash(dynamic_policy_json);
         msaf_dynamic_policy->dynamic_policy_created = time(NULL);
         if(msaf_dynamic_policy->DynamicPolicy)
             msaf_api_dynamic_policy_free(msaf_dynamic_policy->DynamicPolicy);
         msaf_dynamic_policy->DynamicPolicy = dynamic_policy;
 
         cJSON_Delete(dynamic_policy_json);
-        cJSON_free(dynamic_policy_to_hash);
 
     } else {
         ogs_error("Error converting the Dynamic Policy to JSON"); 	     
@@ -761,7 +759,6 @@ static bool create_msaf_dynamic_policy_and_send_response(msaf_dynamic_policy_t *
     ogs_uuid_get(&uuid);
     ogs_uuid_format(id, &uuid);
     char *location;
-    char *dynamic_policy_to_hash;
 
 
     if (dyn_policy->DynamicPolicy->dynamic_policy_id) {
@@ -776,8 +773,7 @@ static bool create_msaf_dynamic_policy_and_send_response(msaf_dynamic_policy_t *
 
     dynamic_policy = msaf_api_dynamic_policy_convertResponseToJSON(dyn_policy->DynamicPolicy);
     if(dynamic_policy) {
-        dynamic_policy_to_hash = cJSON_Print(dynamic_policy);
-        dyn_policy->hash = calculate_hash(dynamic_policy_to_hash);
+        dyn_policy->hash = msaf_json_hash(dynamic_policy);
     } else {
         ogs_error("Error converting Dynamic Policy to JSON");
 	ogs_free(dyn_policy->DynamicPolicy->dynamic_policy_id);
@@ -794,7 +790,7 @@ static bool create_msaf_dynamic_policy_and_send_response(msaf_dynamic_policy_t *
     ogs_assert(response);
 
   //  dynamic_policy = msaf_api_dynamic_policy_convertResponseToJSON(dyn_policy->DynamicPolicy);
-    response_body= cJSON_Print(dynamic_policy);
+    response_body= msaf_json_print(dynamic_policy);
     nf_server_populate_response(response, response_body?strlen(response_body):0, msaf_strdup(response_body), response_code);
     ogs_assert(true == ogs_sbi_server_send_response(dyn_policy->metadata->create_event->h.sbi.data, response));
 
@@ -806,7 +802,6 @@ static bool create_msaf_dynamic_policy_and_send_response(msaf_dynamic_policy_t *
     }
 
     cJSON_Delete(dynamic_policy);
-    cJSON_free(dynamic_policy_to_hash);
     cJSON_free(response_body);
     ogs_sbi_header_free(&response->h);
     ogs_free(location);
@@ -48,6 +48,9 @@ typedef enum {
 typedef enum {
 
     MSAF_LOCAL_EVENT_POLICY_TEMPLATE_STATE_CHANGE,
+    MSAF_LOCAL_EVENT_SAI_REGENERATE,
+    MSAF_LOCAL_EVENT_CHANGE_FEED_WAIT_EXPIRED,
+    MSAF_LOCAL_EVENT_STATE_SNAPSHOT_WRITTEN,
 
 } msaf_local_event_e;
 
@@ -32,3 +32,51 @@ char *calculate_hash(const char *buf) {
     ogs_free(result);
     return hash;
 }
+
+gnutls_hash_hd_t calculate_hash_init(void)
+{
+    gnutls_hash_hd_t handle = NULL;
+
+    ogs_assert(gnutls_hash_init(&handle, GNUTLS_DIG_SHA256) == 0);
+
+    return handle;
+}
+
+void calculate_hash_update(gnutls_hash_hd_t handle, const void *buf, size_t len)
+{
+    ogs_assert(handle);
+    if (len) gnutls_hash(handle, buf, len);
+}
+
+gnutls_hash_hd_t calculate_hash_copy(gnutls_hash_hd_t handle)
+{
+    ogs_assert(handle);
+    return gnutls_hash_copy(handle);
+}
+
+char *calculate_hash_final(gnutls_hash_hd_t handle)
+{
+    unsigned char result[64];
+    size_t result_len;
+    char *hash;
+    size_t i;
+
+    ogs_assert(handle);
+
+    result_len = gnutls_hash_get_len(GNUTLS_DIG_SHA256);
+    ogs_assert(result_len <= sizeof(result));
+    gnutls_hash_deinit(handle, result);
+
+    hash = ogs_calloc(1, result_len*2 + 1);
+    ogs_assert(hash);
+    for (i = 0; i < result_len; i++)
+    {
+        sprintf(hash+i*2, "%02x", result[i]);
+    }
+    return hash;
+}
+
+void calculate_hash_free(gnutls_hash_hd_t handle)
+{
+    if (handle) gnutls_hash_deinit(handle, NULL);
+}
@@ -22,6 +22,17 @@ extern "C" {
 
 extern char *calculate_hash(const char *buf);
 
+/* Incremental hashing, for bodies assembled from pieces. calculate_hash_final()
+ * releases the handle and returns the same string calculate_hash() would give
+ * for the concatenated pieces. calculate_hash_copy() returns NULL if the
+ * crypto library cannot clone the hash state.
+ */
+extern gnutls_hash_hd_t calculate_hash_init(void);
+extern void calculate_hash_update(gnutls_hash_hd_t handle, const void *buf, size_t len);
+extern gnutls_hash_hd_t calculate_hash_copy(gnutls_hash_hd_t handle);
+extern char *calculate_hash_final(gnutls_hash_hd_t handle);
+extern void calculate_hash_free(gnutls_hash_hd_t handle);
+
 #ifdef __cplusplus
 }
 #endif
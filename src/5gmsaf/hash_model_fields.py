@@ -0,0 +1,130 @@
+#!/usr/bin/python3
+#
+# 5G-MAG Reference Tools: 5GMS Application Function model field hashing
+# =====================================================================
+#
+# License: 5G-MAG Public License (v1.0)
+# Author: David Waring
+# Copyright: (C) 2024 British Broadcasting Corporation
+#
+# For full license terms please see the LICENSE file distributed with this
+# program. If this file is missing then the license can be retrieved from
+# https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+#
+# This is part of the 5G-MAG Reference Tools 5GMS AF. This script adds perfect
+# hash tables to the field name tables in the generated OpenAPI model source.
+#
+'''Hash model fields
+
+This script will take a pointer to a directory of generated model .c files and
+will find the field name tables generated by model-body.mustache, e.g.
+
+  static const char * const msaf_api_example_field_names[] = {
+      "id",
+      "name",
+      NULL
+  };
+  static const msaf_json_field_table_t msaf_api_example_fields = MSAF_JSON_FIELD_TABLE(msaf_api_example_field_names);
+
+...and will replace the field table with one that includes a perfect hash of
+the names...
+
+  static const uint8_t msaf_api_example_field_slots[4] = {
+      0, 2, 1, 0
+  };
+  static const msaf_json_field_table_t msaf_api_example_fields = MSAF_JSON_FIELD_TABLE_HASHED(msaf_api_example_field_names, msaf_api_example_field_slots, 0x00000003u, 3);
+
+The hash function must match msaf_json_field_hash() in json-reader.c. Tables
+that are not hashed still work, the names are then searched in order.
+'''
+
+import glob
+import logging
+import os
+import os.path
+import re
+import sys
+
+log = logging.getLogger('hash-model-fields')
+
+MAX_SEEDS = 100000
+
+names_re = re.compile(r'static const char \* const (?P<table>\w+)_field_names\[\] = \{(?P<names>.*?)\};\n'
+                      r'static const msaf_json_field_table_t (?P=table)_fields = MSAF_JSON_FIELD_TABLE\((?P=table)_field_names\);\n',
+                      re.DOTALL)
+string_re = re.compile(r'"((?:[^"\\]|\\.)*)"')
+
+def field_hash(name, seed):
+    '''FNV-1a with a seed, must match msaf_json_field_hash()'''
+    h = (2166136261 ^ seed) & 0xffffffff
+    for b in name:
+        h ^= b
+        h = (h * 16777619) & 0xffffffff
+    return h ^ (h >> 16)
+
+def perfect_hash(names):
+    '''Find a seed and mask that gives each name its own slot'''
+    size = 1
+    while size < 2 * len(names):
+        size *= 2
+    while True:
+        mask = size - 1
+        for seed in range(MAX_SEEDS):
+            slots = set(field_hash(name, seed) & mask for name in names)
+            if len(slots) == len(names):
+                return seed, mask
+        size *= 2
+
+def hashed_table(match):
+    table = match.group('table')
+    names = [bytes(s, 'utf-8').decode('unicode_escape').encode('utf-8') for s in string_re.findall(match.group('names'))]
+    if len(names) == 0 or len(names) > 255:
+        return match.group(0)
+
+    seed, mask = perfect_hash(names)
+    slots = [0] * (mask + 1)
+    for field, name in enumerate(names, start=1):
+        slots[field_hash(name, seed) & mask] = field
+
+    lines = ['    ' + ', '.join(str(v) for v in slots[i:i+16]) for i in range(0, len(slots), 16)]
+    return ('static const char * const %s_field_names[] = {%s};\n'
+            'static const uint8_t %s_field_slots[%i] = {\n%s\n};\n'
+            'static const msaf_json_field_table_t %s_fields = '
+            'MSAF_JSON_FIELD_TABLE_HASHED(%s_field_names, %s_field_slots, 0x%08xu, %i);\n') % (
+                table, match.group('names'), table, mask + 1, ',\n'.join(lines), table, table, table, seed, mask)
+
+def hash_model_file(filename):
+    changed = False
+    with open(filename, 'r') as infile:
+        try:
+            source = infile.read()
+            hashed, count = names_re.subn(hashed_table, source)
+            if count > 0 and hashed != source:
+                log.info("Hashing %i field tables in %s...", count, filename)
+                changed = True
+                with open(filename+'.tmp', 'w') as outfile:
+                    outfile.write(hashed)
+                os.replace(filename+'.tmp', filename)
+        except Exception as e:
+            log.warning('Failed to update %s: %s', filename, str(e))
+    return changed
+
+def main():
+    if len(sys.argv) != 2:
+        log.error('Incorrect command line arguments')
+        sys.stderr.write('Syntax: %s <model-directory>\n'%os.path.basename(sys.argv[0]))
+        return 1
+
+    model_dir = sys.argv[1]
+
+    hashed_files = 0
+    for filename in glob.glob(os.path.join(model_dir,'*.c')):
+        if hash_model_file(filename):
+            hashed_files += 1
+
+    log.info('Hashed field tables in %i files',hashed_files)
+
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -11,6 +11,7 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #include "bsf-service-consumer.h"
 
 #include "context.h"
+#include "data-collection.h"
 #include "sbi-path.h"
 #include "msaf-sm.h"
 
@@ -71,6 +72,12 @@ int msaf_initialize()
         return rv;
     }
 
+    rv = msaf_data_collection_init();
+    if (rv != OGS_OK) {
+        ogs_debug("msaf_data_collection_init() failed");
+        return rv;
+    }
+
     rv = msaf_sbi_open();
     if (rv != 0) {
         ogs_debug("msaf_sbi_open() failed");
@@ -0,0 +1,114 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#include "hash.h"
+
+#include "json-format.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static msaf_json_format_t json_format = MSAF_JSON_FORMAT_PRETTY;
+
+void msaf_json_format_set(msaf_json_format_t format)
+{
+    json_format = format;
+}
+
+msaf_json_format_t msaf_json_format_get(void)
+{
+    return json_format;
+}
+
+const char *msaf_json_format_name(msaf_json_format_t format)
+{
+    switch (format) {
+    case MSAF_JSON_FORMAT_COMPACT:
+        return "compact";
+    case MSAF_JSON_FORMAT_PRETTY:
+        return "pretty";
+    default:
+        break;
+    }
+    return NULL;
+}
+
+bool msaf_json_format_from_name(const char *name, msaf_json_format_t *format)
+{
+    if (!name || !format) return false;
+
+    if (!strcmp(name, "compact")) {
+        *format = MSAF_JSON_FORMAT_COMPACT;
+    } else if (!strcmp(name, "pretty")) {
+        *format = MSAF_JSON_FORMAT_PRETTY;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+char *msaf_json_print(const cJSON *json)
+{
+    if (!json) return NULL;
+
+    if (json_format == MSAF_JSON_FORMAT_COMPACT) return cJSON_PrintUnformatted(json);
+
+    return cJSON_Print(json);
+}
+
+char *msaf_json_hash(const cJSON *json)
+{
+    char *canonical;
+    char *hash;
+
+    if (!json) return NULL;
+
+    canonical = cJSON_PrintUnformatted(json);
+    ogs_assert(canonical);
+    hash = calculate_hash(canonical);
+    cJSON_free(canonical);
+
+    return hash;
+}
+
+char *msaf_json_print_with_hash(const cJSON *json, size_t *length, char **hash)
+{
+    char *body;
+
+    if (!json) return NULL;
+
+    body = msaf_json_print(json);
+    ogs_assert(body);
+
+    if (length) *length = strlen(body);
+
+    if (hash) {
+        if (json_format == MSAF_JSON_FORMAT_COMPACT) {
+            /* output is already the canonical form */
+            *hash = calculate_hash(body);
+        } else {
+            *hash = msaf_json_hash(json);
+        }
+    }
+
+    return body;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
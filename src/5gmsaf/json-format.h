@@ -0,0 +1,53 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#ifndef MSAF_JSON_FORMAT_H
+#define MSAF_JSON_FORMAT_H
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum msaf_json_format_e {
+    MSAF_JSON_FORMAT_PRETTY = 0,
+    MSAF_JSON_FORMAT_COMPACT
+} msaf_json_format_t;
+
+/* Output format used for all JSON response and request bodies, pretty by default */
+extern void msaf_json_format_set(msaf_json_format_t format);
+extern msaf_json_format_t msaf_json_format_get(void);
+extern const char *msaf_json_format_name(msaf_json_format_t format);
+/* Returns false if name is not "compact" or "pretty" */
+extern bool msaf_json_format_from_name(const char *name, msaf_json_format_t *format);
+
+/* Serialise json in the configured format, free the result with cJSON_free() */
+extern char *msaf_json_print(const cJSON *json);
+
+/* ETag for json. This is always calculated over the canonical (compact) form so
+ * that entity tags do not depend on the configured output format.
+ */
+extern char *msaf_json_hash(const cJSON *json);
+
+/* Serialise json in the configured format and calculate its ETag. The canonical
+ * form is only generated separately when the output format is pretty.
+ */
+extern char *msaf_json_print_with_hash(const cJSON *json, size_t *length, char **hash);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MSAF_JSON_FORMAT_H */
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,657 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#include "model-arena.h"
+
+#include "json-reader.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    EXPECT_VALUE = 0,
+    EXPECT_VALUE_OR_END,      /* after '[' */
+    EXPECT_KEY_OR_END,        /* after '{' */
+    EXPECT_KEY,               /* after ',' in an object */
+    EXPECT_COMMA_OR_END,      /* after a value in a container */
+    EXPECT_DONE,              /* after the top level value */
+    EXPECT_NOTHING            /* after an error */
+};
+
+static msaf_json_token_t _next(msaf_json_reader_t *reader);
+static msaf_json_token_t _error(msaf_json_reader_t *reader, const char *reason);
+static void _skip_whitespace(msaf_json_reader_t *reader);
+static msaf_json_token_t _after_value(msaf_json_reader_t *reader, msaf_json_token_t token);
+static msaf_json_token_t _close(msaf_json_reader_t *reader);
+static msaf_json_token_t _read_value(msaf_json_reader_t *reader);
+static bool _read_string(msaf_json_reader_t *reader);
+static bool _read_number(msaf_json_reader_t *reader);
+static bool _read_literal(msaf_json_reader_t *reader, const char *literal);
+static void _copy_token(const msaf_json_reader_t *reader, char *out);
+static int _hex_value(const char *p);
+static char *_utf8_encode(char *out, unsigned long code);
+static int _field_index(const msaf_json_field_table_t *table, const char *name, size_t length);
+static cJSON *_cjson_value(msaf_json_reader_t *reader, msaf_json_token_t token);
+
+void msaf_json_reader_init(msaf_json_reader_t *reader, const char *buffer, size_t length)
+{
+    ogs_assert(reader);
+
+    memset(reader, 0, sizeof(*reader));
+    reader->pos = buffer;
+    reader->end = buffer?(buffer + length):buffer;
+    reader->expect = EXPECT_VALUE;
+    reader->current = MSAF_JSON_TOKEN_END;
+}
+
+msaf_json_token_t msaf_json_reader_next(msaf_json_reader_t *reader)
+{
+    ogs_assert(reader);
+
+    reader->current = _next(reader);
+
+    return reader->current;
+}
+
+bool msaf_json_reader_skip(msaf_json_reader_t *reader, msaf_json_token_t token)
+{
+    int depth;
+
+    ogs_assert(reader);
+
+    switch (token) {
+    case MSAF_JSON_TOKEN_KEY:
+        return msaf_json_reader_skip(reader, msaf_json_reader_next(reader));
+    case MSAF_JSON_TOKEN_OBJECT_START:
+    case MSAF_JSON_TOKEN_ARRAY_START:
+        depth = reader->depth - 1;
+        while (reader->depth > depth) {
+            token = msaf_json_reader_next(reader);
+            if (token == MSAF_JSON_TOKEN_ERROR || token == MSAF_JSON_TOKEN_END) return false;
+        }
+        return true;
+    case MSAF_JSON_TOKEN_STRING:
+    case MSAF_JSON_TOKEN_NUMBER:
+    case MSAF_JSON_TOKEN_TRUE:
+    case MSAF_JSON_TOKEN_FALSE:
+    case MSAF_JSON_TOKEN_NULL:
+        return true;
+    default:
+        break;
+    }
+
+    return false;
+}
+
+bool msaf_json_reader_token_equals(const msaf_json_reader_t *reader, const char *str)
+{
+    bool ret;
+    char *value;
+
+    ogs_assert(reader);
+    ogs_assert(str);
+
+    if (!reader->token) return false;
+
+    if (!reader->token_escaped)
+        return strlen(str) == reader->token_length && !memcmp(reader->token, str, reader->token_length);
+
+    value = msaf_json_reader_strdup(reader);
+    ret = !strcmp(value, str);
+    ogs_free(value);
+
+    return ret;
+}
+
+char *msaf_json_reader_strdup(const msaf_json_reader_t *reader)
+{
+    char *ret;
+
+    ogs_assert(reader);
+
+    if (!reader->token) return NULL;
+
+    /* the unescaped string is never longer than the escaped one */
+    ret = ogs_malloc(reader->token_length + 1);
+    ogs_assert(ret);
+
+    _copy_token(reader, ret);
+
+    return ret;
+}
+
+char *msaf_json_reader_model_strdup(const msaf_json_reader_t *reader)
+{
+    char *ret;
+
+    ogs_assert(reader);
+
+    if (!reader->token) return NULL;
+
+    ret = msaf_model_malloc(reader->token_length + 1);
+
+    _copy_token(reader, ret);
+
+    return ret;
+}
+
+bool msaf_json_reader_int64(const msaf_json_reader_t *reader, int64_t *value)
+{
+    const char *p;
+    const char *end;
+    bool negative = false;
+    uint64_t result = 0;
+    uint64_t limit;
+
+    ogs_assert(reader);
+    ogs_assert(value);
+
+    if (!reader->token || !reader->token_length) return false;
+
+    p = reader->token;
+    end = p + reader->token_length;
+    if (*p == '-') {
+        negative = true;
+        p++;
+    }
+    limit = negative?((uint64_t)INT64_MAX + 1):(uint64_t)INT64_MAX;
+
+    for (; p < end; p++) {
+        if (*p < '0' || *p > '9') return false;
+        if (result > (limit - (*p - '0')) / 10) return false;
+        result = result * 10 + (*p - '0');
+    }
+
+    *value = negative?(int64_t)(0 - result):(int64_t)result;
+
+    return true;
+}
+
+double msaf_json_reader_double(const msaf_json_reader_t *reader)
+{
+    char buf[64];
+    char *str;
+    double ret;
+
+    ogs_assert(reader);
+
+    if (!reader->token) return 0;
+
+    if (reader->token_length < sizeof(buf)) {
+        memcpy(buf, reader->token, reader->token_length);
+        buf[reader->token_length] = '\0';
+        return strtod(buf, NULL);
+    }
+
+    str = ogs_strndup(reader->token, reader->token_length);
+    ret = strtod(str, NULL);
+    ogs_free(str);
+
+    return ret;
+}
+
+cJSON *msaf_json_reader_cjson(msaf_json_reader_t *reader)
+{
+    ogs_assert(reader);
+
+    return _cjson_value(reader, reader->current);
+}
+
+uint32_t msaf_json_field_hash(const char *name, size_t length, uint32_t seed)
+{
+    uint32_t hash = 2166136261u ^ seed;
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+
+    return hash ^ (hash >> 16);
+}
+
+int msaf_json_reader_field(const msaf_json_reader_t *reader, const msaf_json_field_table_t *table)
+{
+    char *name;
+    int field;
+
+    ogs_assert(reader);
+    ogs_assert(table);
+
+    if (!reader->token) return 0;
+
+    if (!reader->token_escaped) return _field_index(table, reader->token, reader->token_length);
+
+    name = msaf_json_reader_strdup(reader);
+    field = _field_index(table, name, strlen(name));
+    ogs_free(name);
+
+    return field;
+}
+
+/*****************************************************
+ ***** Private functions
+ *****************************************************/
+
+static msaf_json_token_t _next(msaf_json_reader_t *reader)
+{
+    char c;
+
+    if (reader->expect == EXPECT_NOTHING) return MSAF_JSON_TOKEN_ERROR;
+
+    reader->token = NULL;
+    reader->token_length = 0;
+    reader->token_escaped = false;
+
+    _skip_whitespace(reader);
+
+    if (reader->expect == EXPECT_DONE) {
+        if (reader->pos < reader->end) return _error(reader, "Unexpected characters after the JSON value");
+        return MSAF_JSON_TOKEN_END;
+    }
+
+    if (reader->pos >= reader->end) return _error(reader, "Unexpected end of JSON");
+
+    c = *reader->pos;
+
+    if (reader->expect == EXPECT_COMMA_OR_END) {
+        if (c == ',') {
+            reader->pos++;
+            _skip_whitespace(reader);
+            if (reader->pos >= reader->end) return _error(reader, "Unexpected end of JSON");
+            reader->expect = (reader->stack[reader->depth-1] == '{')?EXPECT_KEY:EXPECT_VALUE;
+            c = *reader->pos;
+        } else if (c == (reader->stack[reader->depth-1] == '{'?'}':']')) {
+            reader->pos++;
+            return _close(reader);
+        } else {
+            return _error(reader, "Expected ',' or the end of the object or array");
+        }
+    }
+
+    if (reader->expect == EXPECT_KEY_OR_END || reader->expect == EXPECT_KEY) {
+        if (c == '}' && reader->expect == EXPECT_KEY_OR_END) {
+            reader->pos++;
+            return _close(reader);
+        }
+        if (c != '"') return _error(reader, "Expected an object member name");
+        if (!_read_string(reader)) return MSAF_JSON_TOKEN_ERROR;
+        _skip_whitespace(reader);
+        if (reader->pos >= reader->end || *reader->pos != ':') return _error(reader, "Expected ':' after the object member name");
+        reader->pos++;
+        reader->expect = EXPECT_VALUE;
+        return MSAF_JSON_TOKEN_KEY;
+    }
+
+    if (reader->expect == EXPECT_VALUE_OR_END && c == ']') {
+        reader->pos++;
+        return _close(reader);
+    }
+
+    return _read_value(reader);
+}
+
+static msaf_json_token_t _error(msaf_json_reader_t *reader, const char *reason)
+{
+    reader->error = reason;
+    reader->expect = EXPECT_NOTHING;
+    reader->token = NULL;
+    reader->token_length = 0;
+    return MSAF_JSON_TOKEN_ERROR;
+}
+
+static void _skip_whitespace(msaf_json_reader_t *reader)
+{
+    while (reader->pos < reader->end &&
+           (*reader->pos == ' ' || *reader->pos == '\t' || *reader->pos == '\n' || *reader->pos == '\r'))
+        reader->pos++;
+}
+
+static msaf_json_token_t _after_value(msaf_json_reader_t *reader, msaf_json_token_t token)
+{
+    reader->expect = reader->depth?EXPECT_COMMA_OR_END:EXPECT_DONE;
+    return token;
+}
+
+static msaf_json_token_t _close(msaf_json_reader_t *reader)
+{
+    char container = reader->stack[--reader->depth];
+
+    return _after_value(reader, container == '{'?MSAF_JSON_TOKEN_OBJECT_END:MSAF_JSON_TOKEN_ARRAY_END);
+}
+
+static msaf_json_token_t _read_value(msaf_json_reader_t *reader)
+{
+    char c = *reader->pos;
+
+    switch (c) {
+    case '{':
+    case '[':
+        if (reader->depth >= MSAF_JSON_READER_MAX_DEPTH) return _error(reader, "JSON nested too deeply");
+        reader->stack[reader->depth++] = c;
+        reader->pos++;
+        reader->expect = (c == '{')?EXPECT_KEY_OR_END:EXPECT_VALUE_OR_END;
+        return (c == '{')?MSAF_JSON_TOKEN_OBJECT_START:MSAF_JSON_TOKEN_ARRAY_START;
+    case '"':
+        if (!_read_string(reader)) return MSAF_JSON_TOKEN_ERROR;
+        return _after_value(reader, MSAF_JSON_TOKEN_STRING);
+    case 't':
+        if (!_read_literal(reader, "true")) return MSAF_JSON_TOKEN_ERROR;
+        return _after_value(reader, MSAF_JSON_TOKEN_TRUE);
+    case 'f':
+        if (!_read_literal(reader, "false")) return MSAF_JSON_TOKEN_ERROR;
+        return _after_value(reader, MSAF_JSON_TOKEN_FALSE);
+    case 'n':
+        if (!_read_literal(reader, "null")) return MSAF_JSON_TOKEN_ERROR;
+        return _after_value(reader, MSAF_JSON_TOKEN_NULL);
+    default:
+        if (c == '-' || (c >= '0' && c <= '9')) {
+            if (!_read_number(reader)) return MSAF_JSON_TOKEN_ERROR;
+            return _after_value(reader, MSAF_JSON_TOKEN_NUMBER);
+        }
+        break;
+    }
+
+    return _error(reader, "Unexpected character, expected a JSON value");
+}
+
+/* reader->pos is at the opening quote */
+static bool _read_string(msaf_json_reader_t *reader)
+{
+    const char *start = ++reader->pos;
+    bool escaped = false;
+
+    while (reader->pos < reader->end) {
+        unsigned char c = *reader->pos;
+
+        if (c == '"') {
+            reader->token = start;
+            reader->token_length = reader->pos - start;
+            reader->token_escaped = escaped;
+            reader->pos++;
+            return true;
+        }
+        if (c < 0x20) {
+            _error(reader, "Control character in JSON string");
+            return false;
+        }
+        if (c == '\\') {
+            escaped = true;
+            reader->pos++;
+            if (reader->pos >= reader->end) break;
+            switch (*reader->pos) {
+            case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+                break;
+            case 'u':
+                if (reader->end - reader->pos < 5 || _hex_value(reader->pos + 1) < 0) {
+                    _error(reader, "Bad unicode escape in JSON string");
+                    return false;
+                }
+                reader->pos += 4;
+                break;
+            default:
+                _error(reader, "Bad escape sequence in JSON string");
+                return false;
+            }
+        }
+        reader->pos++;
+    }
+
+    _error(reader, "Unterminated JSON string");
+    return false;
+}
+
+#define _IS_DIGIT(r) ((r)->pos < (r)->end && *(r)->pos >= '0' && *(r)->pos <= '9')
+
+static bool _read_number(msaf_json_reader_t *reader)
+{
+    const char *start = reader->pos;
+
+    if (*reader->pos == '-') reader->pos++;
+
+    if (reader->pos < reader->end && *reader->pos == '0') {
+        reader->pos++;
+    } else if (_IS_DIGIT(reader)) {
+        while (_IS_DIGIT(reader)) reader->pos++;
+    } else {
+        _error(reader, "Bad JSON number");
+        return false;
+    }
+
+    if (reader->pos < reader->end && *reader->pos == '.') {
+        reader->pos++;
+        if (!_IS_DIGIT(reader)) {
+            _error(reader, "Bad JSON number");
+            return false;
+        }
+        while (_IS_DIGIT(reader)) reader->pos++;
+    }
+
+    if (reader->pos < reader->end && (*reader->pos == 'e' || *reader->pos == 'E')) {
+        reader->pos++;
+        if (reader->pos < reader->end && (*reader->pos == '+' || *reader->pos == '-')) reader->pos++;
+        if (!_IS_DIGIT(reader)) {
+            _error(reader, "Bad JSON number");
+            return false;
+        }
+        while (_IS_DIGIT(reader)) reader->pos++;
+    }
+
+    reader->token = start;
+    reader->token_length = reader->pos - start;
+
+    return true;
+}
+
+#undef _IS_DIGIT
+
+static bool _read_literal(msaf_json_reader_t *reader, const char *literal)
+{
+    size_t len = strlen(literal);
+
+    if ((size_t)(reader->end - reader->pos) < len || memcmp(reader->pos, literal, len)) {
+        _error(reader, "Unexpected character, expected a JSON value");
+        return false;
+    }
+    reader->pos += len;
+
+    return true;
+}
+
+/* Value of 4 hex digits at p or -1 if they are not all hex digits */
+static void _copy_token(const msaf_json_reader_t *reader, char *out)
+{
+    const char *p;
+    const char *end;
+
+    if (!reader->token_escaped) {
+        memcpy(out, reader->token, reader->token_length);
+        out[reader->token_length] = '\0';
+        return;
+    }
+
+    p = reader->token;
+    end = reader->token + reader->token_length;
+    while (p < end) {
+        if (*p != '\\') {
+            *out++ = *p++;
+            continue;
+        }
+        p++;
+        switch (*p++) {
+        case 'b': *out++ = '\b'; break;
+        case 'f': *out++ = '\f'; break;
+        case 'n': *out++ = '\n'; break;
+        case 'r': *out++ = '\r'; break;
+        case 't': *out++ = '\t'; break;
+        case 'u':
+            {
+                unsigned long code = _hex_value(p);
+                p += 4;
+                if (code >= 0xd800 && code < 0xdc00) {
+                    /* high surrogate, combine with the following low surrogate */
+                    if (end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                        unsigned long low = _hex_value(p + 2);
+                        if (low >= 0xdc00 && low < 0xe000) {
+                            code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                            p += 6;
+                        } else {
+                            code = 0xfffd;
+                        }
+                    } else {
+                        code = 0xfffd;
+                    }
+                } else if (code >= 0xdc00 && code < 0xe000) {
+                    code = 0xfffd;
+                }
+                out = _utf8_encode(out, code);
+            }
+            break;
+        default:
+            /* '"', '\\' and '/' */
+            *out++ = p[-1];
+            break;
+        }
+    }
+    *out = '\0';
+}
+
+static int _hex_value(const char *p)
+{
+    int value = 0;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        char c = p[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') {
+            value |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            value |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            value |= c - 'A' + 10;
+        } else {
+            return -1;
+        }
+    }
+
+    return value;
+}
+
+static char *_utf8_encode(char *out, unsigned long code)
+{
+    if (code < 0x80) {
+        *out++ = code;
+    } else if (code < 0x800) {
+        *out++ = 0xc0 | (code >> 6);
+        *out++ = 0x80 | (code & 0x3f);
+    } else if (code < 0x10000) {
+        *out++ = 0xe0 | (code >> 12);
+        *out++ = 0x80 | ((code >> 6) & 0x3f);
+        *out++ = 0x80 | (code & 0x3f);
+    } else {
+        *out++ = 0xf0 | (code >> 18);
+        *out++ = 0x80 | ((code >> 12) & 0x3f);
+        *out++ = 0x80 | ((code >> 6) & 0x3f);
+        *out++ = 0x80 | (code & 0x3f);
+    }
+
+    return out;
+}
+
+static int _field_index(const msaf_json_field_table_t *table, const char *name, size_t length)
+{
+    const char * const *names;
+
+    if (table->slots) {
+        int field = table->slots[msaf_json_field_hash(name, length, table->seed) & table->mask];
+        const char *field_name;
+
+        if (!field) return 0;
+        field_name = table->names[field - 1];
+        return (strlen(field_name) == length && !memcmp(field_name, name, length))?field:0;
+    }
+
+    for (names = table->names; *names; names++) {
+        if (strlen(*names) == length && !memcmp(*names, name, length)) return (names - table->names) + 1;
+    }
+
+    return 0;
+}
+
+static cJSON *_cjson_value(msaf_json_reader_t *reader, msaf_json_token_t token)
+{
+    cJSON *json;
+    cJSON *child;
+    char *str;
+
+    switch (token) {
+    case MSAF_JSON_TOKEN_OBJECT_START:
+        json = cJSON_CreateObject();
+        while ((token = msaf_json_reader_next(reader)) == MSAF_JSON_TOKEN_KEY) {
+            str = msaf_json_reader_strdup(reader);
+            child = _cjson_value(reader, msaf_json_reader_next(reader));
+            if (!child) {
+                ogs_free(str);
+                cJSON_Delete(json);
+                return NULL;
+            }
+            cJSON_AddItemToObject(json, str, child);
+            ogs_free(str);
+        }
+        if (token != MSAF_JSON_TOKEN_OBJECT_END) {
+            cJSON_Delete(json);
+            return NULL;
+        }
+        return json;
+    case MSAF_JSON_TOKEN_ARRAY_START:
+        json = cJSON_CreateArray();
+        while ((token = msaf_json_reader_next(reader)) != MSAF_JSON_TOKEN_ARRAY_END) {
+            child = _cjson_value(reader, token);
+            if (!child) {
+                cJSON_Delete(json);
+                return NULL;
+            }
+            cJSON_AddItemToArray(json, child);
+        }
+        return json;
+    case MSAF_JSON_TOKEN_STRING:
+        str = msaf_json_reader_strdup(reader);
+        json = cJSON_CreateString(str);
+        ogs_free(str);
+        return json;
+    case MSAF_JSON_TOKEN_NUMBER:
+        return cJSON_CreateNumber(msaf_json_reader_double(reader));
+    case MSAF_JSON_TOKEN_TRUE:
+        return cJSON_CreateTrue();
+    case MSAF_JSON_TOKEN_FALSE:
+        return cJSON_CreateFalse();
+    case MSAF_JSON_TOKEN_NULL:
+        return cJSON_CreateNull();
+    default:
+        break;
+    }
+
+    return NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,116 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#ifndef MSAF_JSON_READER_H
+#define MSAF_JSON_READER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Pull parser for JSON
+ *
+ * Reads a JSON document directly from a buffer one token at a time without
+ * building a cJSON tree. The whole of the document is checked for syntax as it
+ * is read, so a document that reaches MSAF_JSON_TOKEN_END is well formed.
+ * String and number tokens point into the original buffer and are only copied
+ * (and unescaped) when asked for.
+ *
+ * The generated OpenAPI models have a *_parseFromJSONReader() function for
+ * each model which reads the model straight from a reader. Object member names
+ * are matched to model fields using a msaf_json_field_table_t.
+ */
+
+#define MSAF_JSON_READER_MAX_DEPTH 64
+
+typedef enum msaf_json_token_e {
+    MSAF_JSON_TOKEN_ERROR = -1,
+    MSAF_JSON_TOKEN_END = 0,          /* end of the document */
+    MSAF_JSON_TOKEN_OBJECT_START,
+    MSAF_JSON_TOKEN_OBJECT_END,
+    MSAF_JSON_TOKEN_ARRAY_START,
+    MSAF_JSON_TOKEN_ARRAY_END,
+    MSAF_JSON_TOKEN_KEY,              /* object member name, always followed by its value */
+    MSAF_JSON_TOKEN_STRING,
+    MSAF_JSON_TOKEN_NUMBER,
+    MSAF_JSON_TOKEN_TRUE,
+    MSAF_JSON_TOKEN_FALSE,
+    MSAF_JSON_TOKEN_NULL
+} msaf_json_token_t;
+
+typedef struct msaf_json_reader_s {
+    const char *pos;
+    const char *end;
+    const char *token;                /* KEY and STRING: contents without quotes, NUMBER: the number text */
+    size_t token_length;
+    bool token_escaped;               /* KEY or STRING contains escape sequences */
+    const char *error;                /* reason for MSAF_JSON_TOKEN_ERROR */
+    msaf_json_token_t current;        /* token last returned by msaf_json_reader_next() */
+    int expect;
+    int depth;
+    char stack[MSAF_JSON_READER_MAX_DEPTH];
+} msaf_json_reader_t;
+
+extern void msaf_json_reader_init(msaf_json_reader_t *reader, const char *buffer, size_t length);
+extern msaf_json_token_t msaf_json_reader_next(msaf_json_reader_t *reader);
+
+/* Skip the value whose first token was just read, returns false on a syntax error */
+extern bool msaf_json_reader_skip(msaf_json_reader_t *reader, msaf_json_token_t token);
+
+/* Compare the current KEY or STRING with a nul terminated string */
+extern bool msaf_json_reader_token_equals(const msaf_json_reader_t *reader, const char *str);
+/* Unescaped copy of the current KEY or STRING, free with ogs_free() */
+extern char *msaf_json_reader_strdup(const msaf_json_reader_t *reader);
+/* As msaf_json_reader_strdup() but allocated with msaf_model_malloc(), for strings kept in a model */
+extern char *msaf_json_reader_model_strdup(const msaf_json_reader_t *reader);
+/* Current NUMBER as an integer, returns false if it is not an integer or out of range */
+extern bool msaf_json_reader_int64(const msaf_json_reader_t *reader, int64_t *value);
+/* Current NUMBER as a double */
+extern double msaf_json_reader_double(const msaf_json_reader_t *reader);
+/* Build a cJSON tree for the value whose first token was just read, for free form objects which have no model.
+ * Returns NULL on a syntax error. */
+extern cJSON *msaf_json_reader_cjson(msaf_json_reader_t *reader);
+
+/* Object member names of a model
+ *
+ * names is the NULL terminated list of member names. generator-5gmsaf adds a perfect hash of the names to the
+ * tables in the generated models, slots[msaf_json_field_hash(name, seed) & mask] holds the field number for every
+ * name and any other name either lands in an empty (0) slot or fails the compare with the name in its slot. A table
+ * without slots is searched in order instead.
+ */
+typedef struct msaf_json_field_table_s {
+    const char * const *names;
+    const uint8_t *slots;
+    uint32_t seed;
+    uint32_t mask;
+} msaf_json_field_table_t;
+
+#define MSAF_JSON_FIELD_TABLE(names) {(names), NULL, 0, 0}
+#define MSAF_JSON_FIELD_TABLE_HASHED(names, slots, seed, mask) {(names), (slots), (seed), (mask)}
+
+/* FNV-1a, seeded, with the high bits folded in. hash_model_fields.py implements the same function. */
+extern uint32_t msaf_json_field_hash(const char *name, size_t length, uint32_t seed);
+/* Field number (1 based position in table->names) of the current KEY, or 0 if it is not one of the names */
+extern int msaf_json_reader_field(const msaf_json_reader_t *reader, const msaf_json_field_table_t *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MSAF_JSON_READER_H */
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
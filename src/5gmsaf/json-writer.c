@@ -0,0 +1,400 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#include "hash.h"
+
+#include "json-writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JSON_WRITER_DEFAULT_SIZE 1024
+
+static void _reserve(msaf_json_writer_t *writer, size_t length);
+static void _append(msaf_json_writer_t *writer, const char *str, size_t length);
+static void _append_char(msaf_json_writer_t *writer, char c);
+static void _indent(msaf_json_writer_t *writer, int depth);
+static void _value_start(msaf_json_writer_t *writer);
+static void _quoted(msaf_json_writer_t *writer, const char *str);
+
+void msaf_json_writer_init(msaf_json_writer_t *writer, msaf_json_format_t format, size_t size_hint)
+{
+    ogs_assert(writer);
+
+    memset(writer, 0, sizeof(*writer));
+    writer->pretty = (format != MSAF_JSON_FORMAT_COMPACT);
+    _reserve(writer, size_hint?size_hint:JSON_WRITER_DEFAULT_SIZE);
+}
+
+char *msaf_json_writer_finish(msaf_json_writer_t *writer, size_t *length)
+{
+    char *data;
+
+    ogs_assert(writer);
+    ogs_assert(writer->depth == 0);
+
+    _reserve(writer, 0);
+    writer->data[writer->length] = '\0';
+    if (length) *length = writer->length;
+
+    data = writer->data;
+    memset(writer, 0, sizeof(*writer));
+
+    return data;
+}
+
+void msaf_json_writer_clear(msaf_json_writer_t *writer)
+{
+    ogs_assert(writer);
+
+    if (writer->data) ogs_free(writer->data);
+    memset(writer, 0, sizeof(*writer));
+}
+
+/* The formatting follows cJSON: in pretty output each object member goes on its own line indented by one tab per
+ * enclosing object or array, with a tab after the colon, and arrays stay on one line with ", " between the values. */
+
+void msaf_json_writer_object_start(msaf_json_writer_t *writer)
+{
+    _value_start(writer);
+    _append_char(writer, '{');
+    if (writer->pretty) _append_char(writer, '\n');
+    writer->depth++;
+    writer->first = true;
+}
+
+void msaf_json_writer_object_end(msaf_json_writer_t *writer)
+{
+    ogs_assert(writer->depth > 0);
+    ogs_assert(!writer->after_key);
+
+    if (writer->pretty) {
+        if (!writer->first) _append_char(writer, '\n');
+        _indent(writer, writer->depth - 1);
+    }
+    _append_char(writer, '}');
+    writer->depth--;
+    writer->first = false;
+}
+
+void msaf_json_writer_array_start(msaf_json_writer_t *writer)
+{
+    _value_start(writer);
+    _append_char(writer, '[');
+    writer->depth++;
+    writer->first = true;
+}
+
+void msaf_json_writer_array_end(msaf_json_writer_t *writer)
+{
+    ogs_assert(writer->depth > 0);
+
+    _append_char(writer, ']');
+    writer->depth--;
+    writer->first = false;
+}
+
+void msaf_json_writer_key(msaf_json_writer_t *writer, const char *key)
+{
+    ogs_assert(key);
+    ogs_assert(writer->depth > 0);
+    ogs_assert(!writer->after_key);
+
+    if (!writer->first) {
+        _append_char(writer, ',');
+        if (writer->pretty) _append_char(writer, '\n');
+    }
+    if (writer->pretty) _indent(writer, writer->depth);
+    _quoted(writer, key);
+    writer->first = false;
+    writer->after_key = true;
+}
+
+void msaf_json_writer_string(msaf_json_writer_t *writer, const char *str)
+{
+    if (!str) {
+        msaf_json_writer_null(writer);
+        return;
+    }
+
+    _value_start(writer);
+    _quoted(writer, str);
+}
+
+void msaf_json_writer_number(msaf_json_writer_t *writer, double value)
+{
+    char number[32];
+    int length;
+    int int_value;
+
+    _value_start(writer);
+
+    /* same as cJSON: whole numbers in int range as integers, otherwise the shortest of 15 or 17 significant digits that
+     * reads back as the same value */
+    int_value = (value >= INT_MAX)?INT_MAX:(value <= (double)INT_MIN)?INT_MIN:(int)value;
+    if (isnan(value) || isinf(value)) {
+        length = sprintf(number, "null");
+    } else if (value == (double)int_value) {
+        length = sprintf(number, "%d", int_value);
+    } else {
+        double test = 0.0;
+
+        length = sprintf(number, "%1.15g", value);
+        if (sscanf(number, "%lg", &test) != 1 || fabs(test - value) > fmax(fabs(test), fabs(value)) * DBL_EPSILON) {
+            length = sprintf(number, "%1.17g", value);
+        }
+    }
+
+    _append(writer, number, length);
+}
+
+void msaf_json_writer_bool(msaf_json_writer_t *writer, bool value)
+{
+    _value_start(writer);
+    if (value) {
+        _append(writer, "true", 4);
+    } else {
+        _append(writer, "false", 5);
+    }
+}
+
+void msaf_json_writer_null(msaf_json_writer_t *writer)
+{
+    _value_start(writer);
+    _append(writer, "null", 4);
+}
+
+void msaf_json_writer_cjson(msaf_json_writer_t *writer, const cJSON *json)
+{
+    const cJSON *child;
+
+    ogs_assert(json);
+
+    switch (json->type & 0xff) {
+    case cJSON_False:
+        msaf_json_writer_bool(writer, false);
+        break;
+    case cJSON_True:
+        msaf_json_writer_bool(writer, true);
+        break;
+    case cJSON_Number:
+        msaf_json_writer_number(writer, json->valuedouble);
+        break;
+    case cJSON_String:
+        msaf_json_writer_string(writer, json->valuestring);
+        break;
+    case cJSON_Raw:
+        _value_start(writer);
+        if (json->valuestring) _append(writer, json->valuestring, strlen(json->valuestring));
+        break;
+    case cJSON_Array:
+        msaf_json_writer_array_start(writer);
+        for (child = json->child; child; child = child->next) {
+            msaf_json_writer_cjson(writer, child);
+        }
+        msaf_json_writer_array_end(writer);
+        break;
+    case cJSON_Object:
+        msaf_json_writer_object_start(writer);
+        for (child = json->child; child; child = child->next) {
+            msaf_json_writer_key(writer, child->string?child->string:"");
+            msaf_json_writer_cjson(writer, child);
+        }
+        msaf_json_writer_object_end(writer);
+        break;
+    default:
+        msaf_json_writer_null(writer);
+        break;
+    }
+}
+
+char *msaf_json_write(msaf_json_write_fn write_fn, const void *data, size_t size_hint, size_t *length)
+{
+    msaf_json_writer_t writer;
+
+    ogs_assert(write_fn);
+
+    msaf_json_writer_init(&writer, msaf_json_format_get(), size_hint);
+    if (!write_fn(&writer, data)) {
+        msaf_json_writer_clear(&writer);
+        return NULL;
+    }
+
+    return msaf_json_writer_finish(&writer, length);
+}
+
+char *msaf_json_write_with_hash(msaf_json_write_fn write_fn, const void *data, size_t size_hint, size_t *length, char **hash)
+{
+    char *body;
+    size_t body_length;
+
+    ogs_assert(hash);
+
+    body = msaf_json_write(write_fn, data, size_hint, &body_length);
+    if (!body) return NULL;
+
+    if (msaf_json_format_get() == MSAF_JSON_FORMAT_COMPACT) {
+        /* output is already the canonical form */
+        *hash = calculate_hash(body);
+    } else {
+        /* the canonical form is never longer than the pretty one */
+        *hash = msaf_json_write_hash(write_fn, data, body_length);
+        ogs_assert(*hash);
+    }
+
+    if (length) *length = body_length;
+
+    return body;
+}
+
+char *msaf_json_write_hash(msaf_json_write_fn write_fn, const void *data, size_t size_hint)
+{
+    msaf_json_writer_t writer;
+    char *canonical;
+    char *hash;
+
+    ogs_assert(write_fn);
+
+    msaf_json_writer_init(&writer, MSAF_JSON_FORMAT_COMPACT, size_hint);
+    if (!write_fn(&writer, data)) {
+        msaf_json_writer_clear(&writer);
+        return NULL;
+    }
+    canonical = msaf_json_writer_finish(&writer, NULL);
+    hash = calculate_hash(canonical);
+    ogs_free(canonical);
+
+    return hash;
+}
+
+/*****************************************************
+ ***** Private functions
+ *****************************************************/
+
+/* Make room for length more characters and a nul terminator */
+static void _reserve(msaf_json_writer_t *writer, size_t length)
+{
+    size_t size;
+
+    if (writer->length + length + 1 <= writer->size) return;
+
+    size = writer->size?writer->size:JSON_WRITER_DEFAULT_SIZE;
+    while (writer->length + length + 1 > size) size *= 2;
+
+    writer->data = ogs_realloc(writer->data, size);
+    ogs_assert(writer->data);
+    writer->size = size;
+}
+
+static void _append(msaf_json_writer_t *writer, const char *str, size_t length)
+{
+    _reserve(writer, length);
+    memcpy(writer->data + writer->length, str, length);
+    writer->length += length;
+}
+
+static void _append_char(msaf_json_writer_t *writer, char c)
+{
+    _reserve(writer, 1);
+    writer->data[writer->length++] = c;
+}
+
+static void _indent(msaf_json_writer_t *writer, int depth)
+{
+    if (depth <= 0) return;
+
+    _reserve(writer, depth);
+    memset(writer->data + writer->length, '\t', depth);
+    writer->length += depth;
+}
+
+/* Separator before a value: after a key in an object, or between the values in an array */
+static void _value_start(msaf_json_writer_t *writer)
+{
+    ogs_assert(writer);
+
+    if (writer->after_key) {
+        _append_char(writer, ':');
+        if (writer->pretty) _append_char(writer, '\t');
+        writer->after_key = false;
+    } else if (writer->depth > 0) {
+        if (!writer->first) {
+            _append_char(writer, ',');
+            if (writer->pretty) _append_char(writer, ' ');
+        }
+        writer->first = false;
+    }
+}
+
+static void _quoted(msaf_json_writer_t *writer, const char *str)
+{
+    const unsigned char *run = (const unsigned char*)str;
+    const unsigned char *p;
+
+    _append_char(writer, '"');
+
+    /* copy runs of characters that need no escaping in one go */
+    for (p = run; *p; p++) {
+        if (*p >= 32 && *p != '"' && *p != '\\') continue;
+
+        if (p > run) _append(writer, (const char*)run, p - run);
+        run = p + 1;
+
+        switch (*p) {
+        case '"':
+            _append(writer, "\\\"", 2);
+            break;
+        case '\\':
+            _append(writer, "\\\\", 2);
+            break;
+        case '\b':
+            _append(writer, "\\b", 2);
+            break;
+        case '\f':
+            _append(writer, "\\f", 2);
+            break;
+        case '\n':
+            _append(writer, "\\n", 2);
+            break;
+        case '\r':
+            _append(writer, "\\r", 2);
+            break;
+        case '\t':
+            _append(writer, "\\t", 2);
+            break;
+        default:
+            {
+                char escape[8];
+                _append(writer, escape, sprintf(escape, "\\u%04x", *p));
+            }
+            break;
+        }
+    }
+    if (p > run) _append(writer, (const char*)run, p - run);
+
+    _append_char(writer, '"');
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,90 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#ifndef MSAF_JSON_WRITER_H
+#define MSAF_JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#include "json-format.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Streaming JSON writer
+ *
+ * Writes a JSON document straight into a growing buffer without building a
+ * cJSON tree. The output is byte for byte the same as cJSON_Print() (pretty)
+ * or cJSON_PrintUnformatted() (compact) of the same document, so bodies and
+ * ETags do not depend on which way a document was serialised.
+ *
+ * The generated OpenAPI models have a *_writeJSON() function for each model
+ * which uses this writer. Object members are written as a key followed by its
+ * value, the writer adds the separators and indentation.
+ */
+
+typedef struct msaf_json_writer_s {
+    char *data;
+    size_t length;
+    size_t size;
+    bool pretty;
+    int depth;
+    bool first;                       /* no members written yet in the current object or array */
+    bool after_key;                   /* an object key has been written and its value is next */
+} msaf_json_writer_t;
+
+/* size_hint is the expected length of the document, 0 for a default */
+extern void msaf_json_writer_init(msaf_json_writer_t *writer, msaf_json_format_t format, size_t size_hint);
+/* Returns the nul terminated document, free with ogs_free(). The writer can be used again after msaf_json_writer_init(). */
+extern char *msaf_json_writer_finish(msaf_json_writer_t *writer, size_t *length /* [out, null] */);
+/* Discard the document, e.g. when a model failed to write */
+extern void msaf_json_writer_clear(msaf_json_writer_t *writer);
+
+extern void msaf_json_writer_object_start(msaf_json_writer_t *writer);
+extern void msaf_json_writer_object_end(msaf_json_writer_t *writer);
+extern void msaf_json_writer_array_start(msaf_json_writer_t *writer);
+extern void msaf_json_writer_array_end(msaf_json_writer_t *writer);
+extern void msaf_json_writer_key(msaf_json_writer_t *writer, const char *key /* [not-null] */);
+/* A NULL str is written as null */
+extern void msaf_json_writer_string(msaf_json_writer_t *writer, const char *str /* [null] */);
+extern void msaf_json_writer_number(msaf_json_writer_t *writer, double value);
+extern void msaf_json_writer_bool(msaf_json_writer_t *writer, bool value);
+extern void msaf_json_writer_null(msaf_json_writer_t *writer);
+/* Write a cJSON tree as a value, for free form objects which have no model */
+extern void msaf_json_writer_cjson(msaf_json_writer_t *writer, const cJSON *json /* [not-null] */);
+
+/* Writes a whole document, e.g. a wrapper around a generated *_writeResponseJSON() */
+typedef bool (*msaf_json_write_fn)(msaf_json_writer_t *writer, const void *data);
+
+/* Write a document in the configured output format. Returns an ogs_malloc'd string, or NULL if write_fn failed. */
+extern char *msaf_json_write(msaf_json_write_fn write_fn, const void *data, size_t size_hint, size_t *length /* [out, null] */);
+
+/* As msaf_json_write() and also calculate the ETag, which is always over the canonical (compact) form. The canonical
+ * form is only written separately when the output format is pretty. */
+extern char *msaf_json_write_with_hash(msaf_json_write_fn write_fn, const void *data, size_t size_hint,
+                                       size_t *length /* [out, null] */, char **hash /* [out, not-null] */);
+
+/* Calculate the ETag of the canonical (compact) form of a document without keeping the document. Returns an
+ * ogs_malloc'd hash string, or NULL if write_fn failed. */
+extern char *msaf_json_write_hash(msaf_json_write_fn write_fn, const void *data, size_t size_hint);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MSAF_JSON_WRITER_H */
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -11,9 +11,12 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #include "ogs-proto.h"
 #include "ogs-sbi.h"
 
+#include "change-feed.h"
 #include "context.h"
 #include "local.h"
 #include "policy-template.h"
+#include "provisioning-session-journal.h"
+#include "service-access-information.h"
 #include "utilities.h"
 
 #ifdef __cplusplus
@@ -51,6 +54,8 @@ bool local_process_event(msaf_event_t *e)
 	           if(msaf_policy_template && (msaf_policy_template_node == msaf_policy_template)) {
 			   
 		       if(msaf_policy_template_set_state(msaf_policy_template->policy_template, msaf_policy_template_change_state_event_data->new_state, provisioning_sess)) {
+                           /* copied as the callback may free the policy template */
+                           char *journal_policy_template_id = msaf_strdup(policy_template_id);
 			   ogs_info("msaf_policy_template->policy_template->state: %d", msaf_policy_template->policy_template->state);    
 		           msaf_policy_template->last_modified = time(NULL);
 			   if(msaf_policy_template->hash) ogs_free(msaf_policy_template->hash);
@@ -67,6 +72,9 @@ bool local_process_event(msaf_event_t *e)
 	      
 			   }
 
+                           msaf_provisioning_session_journal_policy_template(provisioning_sess, journal_policy_template_id);
+                           ogs_free(journal_policy_template_id);
+
 		       }	 
 
 		   } else {
@@ -84,6 +92,22 @@ bool local_process_event(msaf_event_t *e)
 	       return true;
 
 	   }
+
+           if (e->local_id == MSAF_LOCAL_EVENT_SAI_REGENERATE) {
+               msaf_context_service_access_information_regenerate((const char*)e->data);
+               ogs_free(e->data);
+               return true;
+           }
+
+           if (e->local_id == MSAF_LOCAL_EVENT_CHANGE_FEED_WAIT_EXPIRED) {
+               msaf_change_feed_wait_expired((msaf_change_feed_waiter_t*)e->data);
+               return true;
+           }
+
+           if (e->local_id == MSAF_LOCAL_EVENT_STATE_SNAPSHOT_WRITTEN) {
+               msaf_provisioning_session_journal_snapshot_written();
+               return true;
+           }
            	   
            //break;
             //DEFAULT
@@ -0,0 +1,119 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#include <string.h>
+
+#include "ogs-core.h"
+
+#include "metrics-report.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Only updated from the event loop */
+static msaf_metrics_report_stats_t stats = {0, 0};
+
+static char *_attribute_value(const char *body, size_t length, const char *name);
+static bool _is_xml_space(char c);
+
+bool msaf_metrics_report_identify(const char *body, size_t length, char **client_id_out, char **session_id_out)
+{
+    ogs_assert(body);
+    ogs_assert(client_id_out);
+    ogs_assert(session_id_out);
+
+    *session_id_out = NULL;
+
+    *client_id_out = _attribute_value(body, length, "clientID");
+    if (!*client_id_out) return false;
+
+    *session_id_out = _attribute_value(body, length, "recordingSessionId");
+
+    return true;
+}
+
+void msaf_metrics_report_count(msaf_metrics_reporting_configuration_node_t *node, bool accepted)
+{
+    if (accepted) {
+        stats.accepted++;
+        if (node) node->reports_accepted++;
+    } else {
+        stats.rejected++;
+        if (node) node->reports_rejected++;
+    }
+}
+
+void msaf_metrics_report_get_stats(msaf_metrics_report_stats_t *stats_out)
+{
+    ogs_assert(stats_out);
+
+    *stats_out = stats;
+}
+
+/*****************************************************
+ ***** Private functions
+ *****************************************************/
+
+/* First non-empty value of attribute name, inside a tag, without entity expansion */
+static char *_attribute_value(const char *body, size_t length, const char *name)
+{
+    size_t name_len = strlen(name);
+    const char *end = body + length;
+    const char *p = body;
+    bool in_tag = false;
+
+    while (p < end) {
+        if (*p == '<') {
+            in_tag = true;
+        } else if (*p == '>') {
+            in_tag = false;
+        } else if (in_tag && _is_xml_space(p[-1]) && (size_t)(end - p) > name_len && !memcmp(p, name, name_len)) {
+            const char *q = p + name_len;
+            char quote;
+            const char *value;
+
+            while (q < end && _is_xml_space(*q)) q++;
+            if (q >= end || *q != '=') {
+                p++;
+                continue;
+            }
+            q++;
+            while (q < end && _is_xml_space(*q)) q++;
+            if (q >= end || (*q != '"' && *q != '\'')) return NULL;
+            quote = *q++;
+            value = q;
+            while (q < end && *q != quote && *q != '<' && *q != '&') q++;
+            if (q >= end || *q != quote) return NULL;
+            if (q == value || (size_t)(q - value) > MSAF_METRICS_REPORT_MAX_ID_LENGTH) return NULL;
+            return ogs_strndup(value, q - value);
+        } else if (in_tag && (*p == '"' || *p == '\'')) {
+            /* skip other attribute values */
+            char quote = *p++;
+            while (p < end && *p != quote) p++;
+            if (p >= end) return NULL;
+        }
+        p++;
+    }
+
+    return NULL;
+}
+
+static bool _is_xml_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
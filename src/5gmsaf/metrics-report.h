@@ -0,0 +1,51 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#ifndef MSAF_METRICS_REPORT_H
+#define MSAF_METRICS_REPORT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ogs-core.h"
+
+#include "metrics-reporting-configuration.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* M5 metrics reports are XML documents (TS 26.247 clause 10.6). They are stored as received, so only the attributes
+ * used to file the report are extracted from the body, without building a document tree. */
+
+#define MSAF_METRICS_REPORT_MAX_ID_LENGTH 256
+
+typedef struct msaf_metrics_report_stats_s {
+    uint64_t accepted;                /* reports stored or queued for storage */
+    uint64_t rejected;                /* reports refused for any reason */
+} msaf_metrics_report_stats_t;
+
+/* Find the clientID and, if present, the recordingSessionId attribute values in a metrics report. Returns false if there is
+ * no usable clientID. The values are allocated with ogs_malloc(), *session_id_out is NULL if there is no session id. */
+extern bool msaf_metrics_report_identify(const char *body /* [not-null] */, size_t length,
+                                         char **client_id_out /* [out, not-null] */, char **session_id_out /* [out, not-null] */);
+
+/* Count a report received for a metrics reporting configuration, or for an unknown configuration if node is NULL */
+extern void msaf_metrics_report_count(msaf_metrics_reporting_configuration_node_t *node /* [null] */, bool accepted);
+extern void msaf_metrics_report_get_stats(msaf_metrics_report_stats_t *stats /* [out, not-null] */);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
+
+#endif /* MSAF_METRICS_REPORT_H */
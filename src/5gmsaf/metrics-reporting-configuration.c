@@ -0,0 +1,267 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#include "ogs-core.h"
+
+#include "openapi/model/msaf_api_metrics_reporting_configuration.h"
+#include "provisioning-session.h"
+#include "hash.h"
+#include "json-format.h"
+#include "service-access-information.h"
+#include "utilities.h"
+
+#include "metrics-reporting-configuration.h"
+
+static void _node_set_config(msaf_metrics_reporting_configuration_node_t *node,
+                             msaf_api_metrics_reporting_configuration_t *config /* [transfer] */);
+static void _node_free(msaf_metrics_reporting_configuration_node_t *node);
+
+/*****************************************************
+ ***** Public functions
+ *****************************************************/
+
+ogs_hash_t *msaf_metrics_reporting_configurations_new(void)
+{
+    ogs_hash_t *configurations = ogs_hash_make();
+    ogs_assert(configurations);
+    return configurations;
+}
+
+void msaf_metrics_reporting_configurations_free(ogs_hash_t *configurations /* [null] */)
+{
+    ogs_hash_index_t *hi;
+
+    if (!configurations) return;
+
+    while ((hi = ogs_hash_first(configurations)) != NULL) {
+        msaf_metrics_reporting_configuration_node_t *node = ogs_hash_this_val(hi);
+        ogs_hash_set(configurations, ogs_hash_this_key(hi), OGS_HASH_KEY_STRING, NULL);
+        _node_free(node);
+    }
+
+    ogs_hash_destroy(configurations);
+}
+
+msaf_metrics_reporting_configuration_node_t *msaf_metrics_reporting_configuration_register(
+                                        msaf_provisioning_session_t *session /* [no-transfer, not-null] */,
+                                        msaf_api_metrics_reporting_configuration_t *config /* [transfer, not-null] */)
+{
+    msaf_metrics_reporting_configuration_node_t *node;
+    ogs_uuid_t uuid;
+    char id[OGS_UUID_FORMATTED_LENGTH + 1];
+
+    ogs_assert(session);
+    ogs_assert(session->metrics_reporting_configurations);
+    ogs_assert(config);
+
+    ogs_uuid_get(&uuid);
+    ogs_uuid_format(id, &uuid);
+
+    if (config->metrics_reporting_configuration_id) ogs_free(config->metrics_reporting_configuration_id);
+    config->metrics_reporting_configuration_id = msaf_strdup(id);
+
+    node = ogs_calloc(1, sizeof(*node));
+    ogs_assert(node);
+
+    _node_set_config(node, config);
+
+    ogs_hash_set(session->metrics_reporting_configurations, node->config->metrics_reporting_configuration_id,
+                 OGS_HASH_KEY_STRING, node);
+    msaf_provisioning_session_changed(session);
+
+    msaf_context_service_access_information_invalidate(session);
+
+    return node;
+}
+
+bool msaf_metrics_reporting_configuration_update(msaf_provisioning_session_t *session /* [no-transfer, not-null] */,
+                                        msaf_metrics_reporting_configuration_node_t *node /* [no-transfer, not-null] */,
+                                        msaf_api_metrics_reporting_configuration_t *config /* [transfer, not-null] */)
+{
+    ogs_assert(session);
+    ogs_assert(node);
+    ogs_assert(config);
+
+    /* the hash key is the id string, so move it to the new configuration rather than copying it */
+    if (config->metrics_reporting_configuration_id) ogs_free(config->metrics_reporting_configuration_id);
+    config->metrics_reporting_configuration_id = node->config->metrics_reporting_configuration_id;
+    node->config->metrics_reporting_configuration_id = NULL;
+
+    msaf_api_metrics_reporting_configuration_free(node->config);
+    node->config = NULL;
+    if (node->hash) ogs_free(node->hash);
+    node->hash = NULL;
+
+    _node_set_config(node, config);
+
+    msaf_context_service_access_information_invalidate(session);
+
+    return true;
+}
+
+msaf_metrics_reporting_configuration_node_t *msaf_metrics_reporting_configuration_restore(
+                                        msaf_provisioning_session_t *session /* [no-transfer, not-null] */,
+                                        msaf_api_metrics_reporting_configuration_t *config /* [transfer, not-null] */)
+{
+    msaf_metrics_reporting_configuration_node_t *node;
+
+    ogs_assert(session);
+    ogs_assert(session->metrics_reporting_configurations);
+    ogs_assert(config);
+
+    if (!config->metrics_reporting_configuration_id) {
+        msaf_api_metrics_reporting_configuration_free(config);
+        return NULL;
+    }
+
+    node = msaf_metrics_reporting_configuration_find(session, config->metrics_reporting_configuration_id);
+    if (node) {
+        msaf_metrics_reporting_configuration_update(session, node, config);
+        return node;
+    }
+
+    node = ogs_calloc(1, sizeof(*node));
+    ogs_assert(node);
+
+    _node_set_config(node, config);
+
+    ogs_hash_set(session->metrics_reporting_configurations, node->config->metrics_reporting_configuration_id,
+                 OGS_HASH_KEY_STRING, node);
+
+    msaf_context_service_access_information_invalidate(session);
+
+    return node;
+}
+
+bool msaf_metrics_reporting_configuration_deregister(msaf_provisioning_session_t *session /* [no-transfer, not-null] */,
+                                        const char *metrics_reporting_configuration_id /* [no-transfer, not-null] */)
+{
+    msaf_metrics_reporting_configuration_node_t *node;
+
+    node = msaf_metrics_reporting_configuration_find(session, metrics_reporting_configuration_id);
+    if (!node) return false;
+
+    ogs_hash_set(session->metrics_reporting_configurations, node->config->metrics_reporting_configuration_id,
+                 OGS_HASH_KEY_STRING, NULL);
+    _node_free(node);
+    msaf_provisioning_session_changed(session);
+
+    msaf_context_service_access_information_invalidate(session);
+
+    return true;
+}
+
+msaf_metrics_reporting_configuration_node_t *msaf_metrics_reporting_configuration_find(
+                                        msaf_provisioning_session_t *session /* [no-transfer, not-null] */,
+                                        const char *metrics_reporting_configuration_id /* [no-transfer, not-null] */)
+{
+    ogs_assert(session);
+    ogs_assert(metrics_reporting_configuration_id);
+
+    if (!session->metrics_reporting_configurations) return NULL;
+
+    return ogs_hash_get(session->metrics_reporting_configurations, metrics_reporting_configuration_id, OGS_HASH_KEY_STRING);
+}
+
+msaf_api_metrics_reporting_configuration_t *msaf_metrics_reporting_configuration_parseJSON(
+                                        cJSON *json /* [no-transfer, not-null] */, const char **err_out /* [out, not-null] */)
+{
+    msaf_api_metrics_reporting_configuration_t *config;
+
+    *err_out = NULL;
+
+    config = msaf_api_metrics_reporting_configuration_parseRequestFromJSON(json, err_out);
+    if (!config) {
+        /* err_out set by parser */
+        return NULL;
+    }
+
+    if (!config->scheme || !*config->scheme) {
+        *err_out = "MetricsReportingConfiguration.scheme must not be empty";
+    } else if (config->sampling_period <= 0) {
+        *err_out = "MetricsReportingConfiguration.samplingPeriod must be greater than 0";
+    } else if (config->is_reporting_interval && config->reporting_interval <= 0) {
+        *err_out = "MetricsReportingConfiguration.reportingInterval must be greater than 0";
+    } else if (config->is_sample_percentage && (config->sample_percentage < 0.0 || config->sample_percentage > 100.0)) {
+        *err_out = "MetricsReportingConfiguration.samplePercentage must be between 0 and 100";
+    }
+
+    if (*err_out) {
+        msaf_api_metrics_reporting_configuration_free(config);
+        return NULL;
+    }
+
+    return config;
+}
+
+cJSON *msaf_metrics_reporting_configuration_json(const msaf_metrics_reporting_configuration_node_t *node /* [no-transfer, not-null] */)
+{
+    cJSON *json;
+
+    ogs_assert(node);
+
+    json = msaf_api_metrics_reporting_configuration_convertResponseToJSON(node->config);
+
+    if (!json) {
+        ogs_error("Failed to convert MetricsReportingConfiguration to JSON");
+    }
+
+    return json;
+}
+
+char *msaf_metrics_reporting_configuration_body(msaf_metrics_reporting_configuration_node_t *node /* [no-transfer, not-null] */)
+{
+    ogs_assert(node);
+
+    if (!msaf_content_variant_is_current(&node->identity, node->hash)) {
+        cJSON *json;
+        char *body;
+
+        json = msaf_metrics_reporting_configuration_json(node);
+        if (!json) return NULL;
+
+        body = msaf_json_print(json);
+        cJSON_Delete(json);
+
+        msaf_content_variant_set(&node->identity, body, strlen(body), node->hash);
+        cJSON_free(body);
+    }
+
+    return msaf_content_variant_copy(&node->identity);
+}
+
+/*****************************************************
+ ***** Private functions
+ *****************************************************/
+
+static void _node_set_config(msaf_metrics_reporting_configuration_node_t *node,
+                             msaf_api_metrics_reporting_configuration_t *config /* [transfer] */)
+{
+    cJSON *json;
+
+    node->config = config;
+
+    json = msaf_metrics_reporting_configuration_json(node);
+    node->hash = msaf_json_hash(json);
+    cJSON_Delete(json);
+
+    time(&node->received);
+}
+
+static void _node_free(msaf_metrics_reporting_configuration_node_t *node)
+{
+    msaf_api_metrics_reporting_configuration_free(node->config);
+    if (node->hash) ogs_free(node->hash);
+    msaf_content_variant_clear(&node->identity);
+    ogs_free(node);
+}
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
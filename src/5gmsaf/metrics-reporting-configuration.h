@@ -0,0 +1,77 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#ifndef MSAF_METRICS_REPORTING_CONFIGURATION_H
+#define MSAF_METRICS_REPORTING_CONFIGURATION_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#include "content-encoding.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct msaf_api_metrics_reporting_configuration_s msaf_api_metrics_reporting_configuration_t;
+typedef struct msaf_provisioning_session_s msaf_provisioning_session_t;
+
+typedef struct msaf_metrics_reporting_configuration_node_s {
+    msaf_api_metrics_reporting_configuration_t *config;
+    char *hash;
+    time_t received;
+    msaf_content_variant_t identity;  /* rendered body, made on first request, replaced when hash changes */
+    uint64_t reports_accepted;        /* M5 metrics reports stored or queued for storage */
+    uint64_t reports_rejected;        /* M5 metrics reports refused */
+} msaf_metrics_reporting_configuration_node_t;
+
+/* Provisioning Session metrics reporting configurations, key: metrics reporting configuration id,
+ * value: msaf_metrics_reporting_configuration_node_t */
+extern ogs_hash_t *msaf_metrics_reporting_configurations_new(void);
+extern void msaf_metrics_reporting_configurations_free(ogs_hash_t *configurations /* [null] */);
+
+/* Add a new configuration with a newly allocated id */
+extern msaf_metrics_reporting_configuration_node_t *msaf_metrics_reporting_configuration_register(
+                                        msaf_provisioning_session_t *session /* [no-transfer, not-null] */,
+                                        msaf_api_metrics_reporting_configuration_t *config /* [transfer, not-null] */);
+/* Replace a configuration, keeping its id and report counters */
+extern bool msaf_metrics_reporting_configuration_update(msaf_provisioning_session_t *session /* [no-transfer, not-null] */,
+                                        msaf_metrics_reporting_configuration_node_t *node /* [no-transfer, not-null] */,
+                                        msaf_api_metrics_reporting_configuration_t *config /* [transfer, not-null] */);
+/* Add or replace a configuration, keeping the id it already has */
+extern msaf_metrics_reporting_configuration_node_t *msaf_metrics_reporting_configuration_restore(
+                                        msaf_provisioning_session_t *session /* [no-transfer, not-null] */,
+                                        msaf_api_metrics_reporting_configuration_t *config /* [transfer, not-null] */);
+extern bool msaf_metrics_reporting_configuration_deregister(msaf_provisioning_session_t *session /* [no-transfer, not-null] */,
+                                        const char *metrics_reporting_configuration_id /* [no-transfer, not-null] */);
+extern msaf_metrics_reporting_configuration_node_t *msaf_metrics_reporting_configuration_find(
+                                        msaf_provisioning_session_t *session /* [no-transfer, not-null] */,
+                                        const char *metrics_reporting_configuration_id /* [no-transfer, not-null] */);
+
+/* Parse and validate a MetricsReportingConfiguration request body, any metricsReportingConfigurationId is left for the
+ * caller to check */
+extern msaf_api_metrics_reporting_configuration_t *msaf_metrics_reporting_configuration_parseJSON(
+                                        cJSON *json /* [no-transfer, not-null] */, const char **err_out /* [out, not-null] */);
+extern cJSON *msaf_metrics_reporting_configuration_json(
+                                        const msaf_metrics_reporting_configuration_node_t *node /* [no-transfer, not-null] */);
+extern char *msaf_metrics_reporting_configuration_body(
+                                        msaf_metrics_reporting_configuration_node_t *node /* [no-transfer, not-null] */);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
+
+#endif /* MSAF_METRICS_REPORTING_CONFIGURATION_H */
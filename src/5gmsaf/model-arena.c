@@ -0,0 +1,408 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#include "model-arena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* All arena allocations are aligned to this, enough for any of the model types */
+#define ARENA_ALIGN 16
+#define ARENA_ROUND_UP(n) (((n) + (ARENA_ALIGN - 1)) & ~((size_t)(ARENA_ALIGN - 1)))
+
+/* Chunks are allocated with their header in front of the memory handed out */
+typedef struct arena_chunk_s {
+    struct arena_chunk_s *next;
+    size_t size;                      /* usable bytes after the header */
+    size_t used;
+} arena_chunk_t;
+
+#define ARENA_CHUNK_HEADER ARENA_ROUND_UP(sizeof(arena_chunk_t))
+#define ARENA_CHUNK_DATA(chunk) (((char*)(chunk)) + ARENA_CHUNK_HEADER)
+
+typedef struct arena_cleanup_s {
+    struct arena_cleanup_s *next;
+    msaf_model_free_fn free_fn;
+    void *ptr;
+} arena_cleanup_t;
+
+struct msaf_model_arena_s {
+    msaf_model_arena_t *next_live;    /* list of arenas not yet freed, for msaf_model_arena_owns() */
+    msaf_model_arena_t *prev_live;
+    msaf_model_arena_t *outer;        /* arena that was current before this one was entered */
+    bool entered;
+    size_t chunk_size;
+    arena_chunk_t *chunks;            /* chunk being bump allocated from is first */
+    arena_cleanup_t *cleanups;        /* most recently added first */
+    size_t used;
+};
+
+static msaf_model_arena_t *live_arenas = NULL;
+static msaf_model_arena_t *current_arena = NULL;
+static msaf_model_alloc_stats_t alloc_stats = {0};
+
+static arena_chunk_t *_chunk_new(size_t size);
+static bool _chunk_contains(const arena_chunk_t *chunk, const void *ptr);
+static void _free_with_ogs_free(void *ptr);
+
+/***** Public functions *****/
+
+msaf_model_arena_t *msaf_model_arena_new(size_t chunk_size)
+{
+    msaf_model_arena_t *arena;
+
+    arena = ogs_calloc(1, sizeof(*arena));
+    ogs_assert(arena);
+
+    arena->chunk_size = ARENA_ROUND_UP(chunk_size?chunk_size:MSAF_MODEL_ARENA_DEFAULT_CHUNK_SIZE);
+
+    arena->next_live = live_arenas;
+    if (live_arenas) live_arenas->prev_live = arena;
+    live_arenas = arena;
+
+    alloc_stats.arenas++;
+
+    return arena;
+}
+
+void msaf_model_arena_free(msaf_model_arena_t *arena)
+{
+    if (!arena) return;
+
+    ogs_assert(!arena->entered);
+
+    /* cleanups first, the adopted objects may still refer to arena memory */
+    while (arena->cleanups) {
+        arena_cleanup_t *cleanup = arena->cleanups;
+        arena->cleanups = cleanup->next;
+        cleanup->free_fn(cleanup->ptr);
+    }
+
+    while (arena->chunks) {
+        arena_chunk_t *chunk = arena->chunks;
+        arena->chunks = chunk->next;
+        ogs_free(chunk);
+    }
+
+    if (arena->prev_live) {
+        arena->prev_live->next_live = arena->next_live;
+    } else {
+        live_arenas = arena->next_live;
+    }
+    if (arena->next_live) arena->next_live->prev_live = arena->prev_live;
+
+    ogs_free(arena);
+}
+
+void msaf_model_arena_enter(msaf_model_arena_t *arena)
+{
+    ogs_assert(arena);
+    ogs_assert(!arena->entered);
+
+    arena->outer = current_arena;
+    arena->entered = true;
+    current_arena = arena;
+}
+
+void msaf_model_arena_leave(msaf_model_arena_t *arena)
+{
+    ogs_assert(arena);
+    ogs_assert(arena == current_arena);
+
+    current_arena = arena->outer;
+    arena->outer = NULL;
+    arena->entered = false;
+}
+
+msaf_model_arena_t *msaf_model_arena_current(void)
+{
+    return current_arena;
+}
+
+void *msaf_model_arena_alloc(msaf_model_arena_t *arena, size_t size)
+{
+    arena_chunk_t *chunk;
+    void *ret;
+
+    ogs_assert(arena);
+
+    size = ARENA_ROUND_UP(size?size:1);
+
+    chunk = arena->chunks;
+    if (!chunk || chunk->size - chunk->used < size) {
+        if (size > arena->chunk_size / 4) {
+            /* large allocation, give it a chunk of its own and keep bump allocating from the current chunk */
+            chunk = _chunk_new(size);
+            if (arena->chunks) {
+                chunk->next = arena->chunks->next;
+                arena->chunks->next = chunk;
+            } else {
+                arena->chunks = chunk;
+            }
+        } else {
+            chunk = _chunk_new(arena->chunk_size);
+            chunk->next = arena->chunks;
+            arena->chunks = chunk;
+        }
+    }
+
+    ret = ARENA_CHUNK_DATA(chunk) + chunk->used;
+    chunk->used += size;
+    arena->used += size;
+
+    alloc_stats.arena_allocations++;
+    alloc_stats.arena_bytes += size;
+
+    return ret;
+}
+
+bool msaf_model_arena_owns(const void *ptr)
+{
+    const msaf_model_arena_t *arena;
+
+    if (!ptr) return false;
+
+    for (arena = live_arenas; arena; arena = arena->next_live) {
+        const arena_chunk_t *chunk;
+        for (chunk = arena->chunks; chunk; chunk = chunk->next) {
+            if (_chunk_contains(chunk, ptr)) return true;
+        }
+    }
+
+    return false;
+}
+
+void msaf_model_arena_add_cleanup(msaf_model_arena_t *arena, msaf_model_free_fn free_fn, void *ptr)
+{
+    arena_cleanup_t *cleanup;
+
+    ogs_assert(arena);
+    ogs_assert(free_fn);
+
+    cleanup = msaf_model_arena_alloc(arena, sizeof(*cleanup));
+    cleanup->free_fn = free_fn;
+    cleanup->ptr = ptr;
+    cleanup->next = arena->cleanups;
+    arena->cleanups = cleanup;
+}
+
+size_t msaf_model_arena_used(const msaf_model_arena_t *arena)
+{
+    ogs_assert(arena);
+    return arena->used;
+}
+
+void *msaf_model_malloc(size_t size)
+{
+    void *ret;
+
+    if (current_arena) return msaf_model_arena_alloc(current_arena, size);
+
+    ret = ogs_malloc(size);
+    ogs_assert(ret);
+    alloc_stats.heap_allocations++;
+
+    return ret;
+}
+
+void *msaf_model_calloc(size_t nmemb, size_t size)
+{
+    void *ret;
+
+    ogs_assert(size == 0 || nmemb <= SIZE_MAX / size);
+
+    ret = msaf_model_malloc(nmemb * size);
+    memset(ret, 0, nmemb * size);
+
+    return ret;
+}
+
+char *msaf_model_strdup(const char *str)
+{
+    if (!str) return NULL;
+    return msaf_model_strndup(str, strlen(str));
+}
+
+char *msaf_model_strndup(const char *str, size_t length)
+{
+    char *ret;
+    const char *nul;
+
+    if (!str) return NULL;
+
+    nul = memchr(str, '\0', length);
+    if (nul) length = nul - str;
+
+    ret = msaf_model_malloc(length + 1);
+    memcpy(ret, str, length);
+    ret[length] = '\0';
+
+    return ret;
+}
+
+char *msaf_model_msprintf(const char *format, ...)
+{
+    va_list ap;
+    va_list ap_copy;
+    int length;
+    char *ret;
+
+    va_start(ap, format);
+    va_copy(ap_copy, ap);
+    length = vsnprintf(NULL, 0, format, ap_copy);
+    va_end(ap_copy);
+    ogs_assert(length >= 0);
+
+    ret = msaf_model_malloc(length + 1);
+    vsnprintf(ret, length + 1, format, ap);
+    va_end(ap);
+
+    return ret;
+}
+
+void msaf_model_free(void *ptr)
+{
+    if (!ptr) return;
+    if (msaf_model_arena_owns(ptr)) return;
+    ogs_free(ptr);
+}
+
+void *msaf_model_adopt(void *ptr, msaf_model_free_fn free_fn)
+{
+    if (ptr && current_arena) {
+        msaf_model_arena_add_cleanup(current_arena, free_fn?free_fn:_free_with_ogs_free, ptr);
+    }
+
+    return ptr;
+}
+
+OpenAPI_list_t *msaf_model_list_create(void)
+{
+    if (!current_arena) {
+        alloc_stats.heap_allocations++;
+        return OpenAPI_list_create();
+    }
+
+    return msaf_model_calloc(1, sizeof(OpenAPI_list_t));
+}
+
+void msaf_model_list_add(OpenAPI_list_t *list, void *data)
+{
+    OpenAPI_lnode_t *node;
+
+    ogs_assert(list);
+
+    if (!current_arena) {
+        alloc_stats.heap_allocations++;
+        OpenAPI_list_add(list, data);
+        return;
+    }
+
+    /* same as OpenAPI_list_add() but with the node in the arena */
+    node = msaf_model_arena_alloc(current_arena, sizeof(*node));
+    node->data = data;
+    node->next = NULL;
+    node->prev = list->last;
+    if (list->last) {
+        list->last->next = node;
+    } else {
+        list->first = node;
+    }
+    list->last = node;
+    list->count++;
+}
+
+void msaf_model_list_free(OpenAPI_list_t *list)
+{
+    if (!list) return;
+    if (msaf_model_arena_owns(list)) return;
+    OpenAPI_list_free(list);
+}
+
+OpenAPI_map_t *msaf_model_map_create(char *key, void *value)
+{
+    OpenAPI_map_t *map;
+
+    if (!current_arena) {
+        alloc_stats.heap_allocations++;
+        return OpenAPI_map_create(key, value);
+    }
+
+    map = msaf_model_arena_alloc(current_arena, sizeof(*map));
+    map->key = key;
+    map->value = value;
+
+    return map;
+}
+
+void msaf_model_map_free(OpenAPI_map_t *map)
+{
+    if (!map) return;
+    if (msaf_model_arena_owns(map)) return;
+    OpenAPI_map_free(map);
+}
+
+void msaf_model_alloc_stats_get(msaf_model_alloc_stats_t *stats)
+{
+    ogs_assert(stats);
+    *stats = alloc_stats;
+}
+
+void msaf_model_alloc_stats_reset(void)
+{
+    memset(&alloc_stats, 0, sizeof(alloc_stats));
+}
+
+/***** Private functions *****/
+
+static arena_chunk_t *_chunk_new(size_t size)
+{
+    arena_chunk_t *chunk;
+
+    chunk = ogs_malloc(ARENA_CHUNK_HEADER + size);
+    ogs_assert(chunk);
+
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+
+    alloc_stats.arena_chunks++;
+
+    return chunk;
+}
+
+static bool _chunk_contains(const arena_chunk_t *chunk, const void *ptr)
+{
+    const char *p = ptr;
+    const char *data = ARENA_CHUNK_DATA(chunk);
+
+    return p >= data && p < data + chunk->size;
+}
+
+static void _free_with_ogs_free(void *ptr)
+{
+    ogs_free(ptr);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,125 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#ifndef MSAF_MODEL_ARENA_H
+#define MSAF_MODEL_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Arena allocation for OpenAPI model trees
+ *
+ * Building or parsing a model tree makes an allocation for every model, list
+ * node, map entry and string, and freeing the tree walks it again to free each
+ * one. A request that only builds a tree to render or inspect it and then
+ * throws it away can instead do so inside an arena:
+ *
+ *   arena = msaf_model_arena_new(0);
+ *   msaf_model_arena_enter(arena);
+ *   model = msaf_api_example_parseRequestFromJSONReader(&reader, &reason);
+ *   ...
+ *   msaf_model_arena_leave(arena);
+ *   msaf_model_arena_free(arena);
+ *
+ * While an arena is entered, the generated *_create() and *_parseFrom*()
+ * functions, and the msaf_model_*() functions below, bump allocate from it.
+ * Everything is released by msaf_model_arena_free() in one go. The generated
+ * *_free() functions do nothing for a model in an arena, so existing cleanup
+ * code can stay as it is.
+ *
+ * A model tree must be either wholly in one arena or wholly on the heap:
+ * - Do not keep a model from an arena past msaf_model_arena_free(), use
+ *   *_copy() outside of the arena to keep it.
+ * - Do not modify a model tree in an arena with ogs_free() or
+ *   OpenAPI_list_remove(), and do not add heap allocations to it unless they
+ *   are passed to msaf_model_adopt().
+ *
+ * The arena stack is not thread safe, arenas are only used from the main
+ * event loop.
+ */
+
+typedef struct msaf_model_arena_s msaf_model_arena_t;
+
+typedef void (*msaf_model_free_fn)(void *ptr);
+
+/* Allocation counts, for comparing a code path with and without an arena */
+typedef struct msaf_model_alloc_stats_s {
+    uint64_t heap_allocations;        /* msaf_model_*() allocations made on the heap */
+    uint64_t arena_allocations;       /* msaf_model_*() allocations made from an arena */
+    uint64_t arena_chunks;            /* heap allocations made by arenas for their chunks */
+    uint64_t arena_bytes;             /* bytes handed out from arenas */
+    uint64_t arenas;                  /* arenas created */
+} msaf_model_alloc_stats_t;
+
+/* Default size for each arena chunk */
+#define MSAF_MODEL_ARENA_DEFAULT_CHUNK_SIZE 4096
+
+/* chunk_size of 0 uses MSAF_MODEL_ARENA_DEFAULT_CHUNK_SIZE. Chunks are only allocated when they are needed. */
+extern msaf_model_arena_t *msaf_model_arena_new(size_t chunk_size);
+/* Release everything allocated from the arena and run msaf_model_adopt() cleanups. The arena must not be entered. */
+extern void msaf_model_arena_free(msaf_model_arena_t *arena);
+
+/* Make arena the current arena for msaf_model_*() allocations until the matching msaf_model_arena_leave(). Arenas
+ * can be nested, the most recently entered is the current one. */
+extern void msaf_model_arena_enter(msaf_model_arena_t *arena);
+extern void msaf_model_arena_leave(msaf_model_arena_t *arena);
+/* The current arena, or NULL if model allocations are going to the heap */
+extern msaf_model_arena_t *msaf_model_arena_current(void);
+
+/* Allocate size bytes, aligned for any type, from the arena. Never returns NULL. */
+extern void *msaf_model_arena_alloc(msaf_model_arena_t *arena, size_t size);
+/* True if ptr was allocated from any arena that has not been freed yet */
+extern bool msaf_model_arena_owns(const void *ptr);
+/* Call free_fn(ptr) when the arena is freed, used for heap memory that is part of a model tree in the arena */
+extern void msaf_model_arena_add_cleanup(msaf_model_arena_t *arena, msaf_model_free_fn free_fn, void *ptr);
+/* Bytes handed out by the arena so far */
+extern size_t msaf_model_arena_used(const msaf_model_arena_t *arena);
+
+/* Model allocations: from the current arena if there is one, otherwise from the heap with ogs_malloc() */
+extern void *msaf_model_malloc(size_t size);
+extern void *msaf_model_calloc(size_t nmemb, size_t size);
+extern char *msaf_model_strdup(const char *str /* [null] */);
+extern char *msaf_model_strndup(const char *str /* [null] */, size_t length);
+extern char *msaf_model_msprintf(const char *format, ...) OGS_GNUC_PRINTF(1, 2);
+/* Free a model allocation, does nothing for arena memory */
+extern void msaf_model_free(void *ptr /* [null] */);
+
+/* Take ownership of a heap allocation made by something outside of the model code, e.g. OpenAPI_object_parseFromJSON().
+ * If there is a current arena free_fn(ptr) is called when the arena is freed (free_fn of NULL means ogs_free()),
+ * otherwise the pointer stays with the caller. Returns ptr. */
+extern void *msaf_model_adopt(void *ptr /* [null] */, msaf_model_free_fn free_fn /* [null] */);
+
+/* OpenAPI_list_t and OpenAPI_map_t allocated as model allocations. The lists and maps are the standard Open5GS types,
+ * so can be walked with OpenAPI_list_for_each() as normal. */
+extern OpenAPI_list_t *msaf_model_list_create(void);
+extern void msaf_model_list_add(OpenAPI_list_t *list, void *data);
+extern void msaf_model_list_free(OpenAPI_list_t *list /* [null] */);
+extern OpenAPI_map_t *msaf_model_map_create(char *key, void *value);
+extern void msaf_model_map_free(OpenAPI_map_t *map /* [null] */);
+
+extern void msaf_model_alloc_stats_get(msaf_model_alloc_stats_t *stats);
+extern void msaf_model_alloc_stats_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MSAF_MODEL_ARENA_H */
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -8,7 +8,6 @@
  * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
  */
 
-#include <math.h>
 #include <string.h>
 
 #include "ogs-sbi.h"
@@ -18,17 +17,29 @@
 #include "certmgr.h"
 #include "server.h"
 #include "sai-cache.h"
+#include "consumption-statistics.h"
+#include "content-encoding.h"
+#include "request-headers.h"
+#include "statistics.h"
 #include "response-cache-control.h"
 #include "msaf-version.h"
 #include "msaf-sm.h"
 #include "utilities.h"
+#include "json-format.h"
+#include "bulk-provisioning.h"
+#include "change-feed.h"
 #include "consumption-report-configuration.h"
+#include "metrics-reporting-configuration.h"
 #include "provisioning-session.h"
+#include "provisioning-session-journal.h"
+#include "provisioning-session-list.h"
+#include "policy-template.h"
 #include "ContentProtocolsDiscovery_body.h"
 #include "openapi/api/TS26512_M1_ProvisioningSessionsAPI-info.h"
 #include "openapi/api/TS26512_M1_ServerCertificatesProvisioningAPI-info.h"
 #include "openapi/api/TS26512_M1_ContentHostingProvisioningAPI-info.h"
 #include "openapi/api/TS26512_M1_ConsumptionReportingProvisioningAPI-info.h"
+#include "openapi/api/TS26512_M1_MetricsReportingProvisioningAPI-info.h"
 #include "openapi/api/M3_ServerCertificatesProvisioningAPI-info.h"
 #include "openapi/api/M3_ContentHostingProvisioningAPI-info.h"
 #include "openapi/api/TS26512_M1_ContentProtocolsDiscoveryAPI-info.h"
@@ -36,6 +47,7 @@
 #include "openapi/api/Maf_ManagementAPI-info.h"
 #include "openapi/model/msaf_api_content_hosting_configuration.h"
 #include "openapi/model/msaf_api_consumption_reporting_configuration.h"
+#include "openapi/model/msaf_api_metrics_reporting_configuration.h"
 
 #include "msaf-m1-sm.h"
 
@@ -69,6 +81,12 @@ m1_consumptionreportingprovisioning_api_metadata = {
     M1_CONSUMPTIONREPORTINGPROVISIONING_API_VERSION
 };
 
+static const nf_server_interface_metadata_t
+m1_metricsreportingprovisioning_api_metadata = {
+    M1_METRICSREPORTINGPROVISIONING_API_NAME,
+    M1_METRICSREPORTINGPROVISIONING_API_VERSION
+};
+
 static const nf_server_interface_metadata_t
 m3_contenthostingprovisioning_api_metatdata = {
     M3_CONTENTHOSTINGPROVISIONING_API_NAME,
@@ -87,8 +105,17 @@ maf_management_api_metadata = {
     MAF_MANAGEMENT_API_VERSION
 };
 
-static void _policy_template_extra_validation(msaf_api_policy_template_t **policy_template, const char **parse_err);
-static void _policy_template_remove_read_only(msaf_api_policy_template_t *policy_template);
+/* gzip variant of CONTENT_PROTOCOLS_DISCOVERY_JSON, made on first request */
+static msaf_content_variant_t content_protocols_discovery_gzip = {NULL, 0, NULL, NULL};
+
+static msaf_api_metrics_reporting_configuration_t *_metrics_reporting_configuration_from_request(ogs_sbi_request_t *request,
+                                                                                               const msaf_request_headers_t *headers,
+                                                                                               const char **parse_err);
+
+static bool _request_conditions_handled(ogs_sbi_stream_t *stream, ogs_sbi_message_t *message,
+                                       const msaf_request_headers_t *headers, const char *etag, const char *response_etag,
+                                       time_t last_modified, int max_age, const nf_server_interface_metadata_t *api,
+                                       const nf_server_app_metadata_t *app_meta);
 
 void msaf_m1_state_initial(ogs_fsm_t *s, msaf_event_t *e)
 {
@@ -104,6 +131,8 @@ void msaf_m1_state_final(ogs_fsm_t *s, msaf_event_t *e)
     msaf_sm_debug(e);
 
     ogs_assert(s);
+
+    msaf_content_variant_clear(&content_protocols_discovery_gzip);
 }
 
 void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
@@ -112,6 +141,7 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
     ogs_sbi_request_t *request = NULL;
     ogs_sbi_response_t *response = NULL;
     ogs_sbi_message_t *message = NULL;
+    msaf_request_headers_t headers;
 
     msaf_sm_debug(e);
 
@@ -120,6 +150,7 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
     static const nf_server_interface_metadata_t *m1_contentprotocolsdiscovery_api = &m1_contentprotocolsdiscovery_api_metadata;
     static const nf_server_interface_metadata_t *m1_servercertificatesprovisioning_api = &m1_servercertificatesprovisioning_api_metadata;
     static const nf_server_interface_metadata_t *m1_consumptionreportingprovisioning_api = &m1_consumptionreportingprovisioning_api_metadata;
+    static const nf_server_interface_metadata_t *m1_metricsreportingprovisioning_api = &m1_metricsreportingprovisioning_api_metadata;
     static const nf_server_interface_metadata_t *m3_contenthostingprovisioning_api = &m3_contenthostingprovisioning_api_metatdata;
     static const nf_server_interface_metadata_t *m1_policytemplatesprovisioning_api = &m1_policytemplatesprovisioning_api_metadata;
     static const nf_server_interface_metadata_t *maf_management_api = &maf_management_api_metadata;
@@ -142,6 +173,7 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
             stream = e->h.sbi.data;
             ogs_assert(stream);
             message = e->message;
+            msaf_request_headers_index(&headers, request->http.headers);
 
             SWITCH(message->h.service.name)  
             CASE("3gpp-m1")
@@ -169,25 +201,18 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                             msaf_provisioning_session_t *msaf_provisioning_session;
 
                             if (!strcmp(message->h.resource.component[2],"content-hosting-configuration") && !strcmp(message->h.resource.component[3],"purge")) {
-                                ogs_hash_index_t *hi;
-                                for (hi = ogs_hash_first(request->http.headers);
-                                        hi; hi = ogs_hash_next(hi)) {
-                                    if (!ogs_strcasecmp(ogs_hash_this_key(hi), OGS_SBI_CONTENT_TYPE)) {
-                                        if (ogs_strcasecmp(ogs_hash_this_val(hi), "application/x-www-form-urlencoded")) {
-                                            char *err = NULL;
-                                            const char *type;
-                                            type = (const char *)ogs_hash_this_val(hi);
-                                            err = ogs_msprintf( "Unsupported Media Type: received type: %s, should have been application/x-www-form-urlencoded", type);
-                                            ogs_error("%s", err);
+                                const char *type = msaf_request_headers_get(&headers, MSAF_REQUEST_HEADER_CONTENT_TYPE);
+                                if (type && !msaf_request_headers_content_type_is(&headers, "application/x-www-form-urlencoded")) {
+                                    char *err = NULL;
+                                    err = ogs_msprintf( "Unsupported Media Type: received type: %s, should have been application/x-www-form-urlencoded", type);
+                                    ogs_error("%s", err);
 
-                                            ogs_assert(true == nf_server_send_error(stream, 415, 3, message, "Unsupported Media Type.", err, NULL, m1_contenthostingprovisioning_api, app_meta));
-                                            ogs_free(err);
-                                            ogs_sbi_message_free(message);
-                                            ogs_free(message);
-                                            return;
+                                    ogs_assert(true == nf_server_send_error(stream, 415, 3, message, "Unsupported Media Type.", err, NULL, m1_contenthostingprovisioning_api, app_meta));
+                                    ogs_free(err);
+                                    ogs_sbi_message_free(message);
+                                    ogs_free(message);
+                                    return;
 
-                                        }
-                                    }
                                 }
                                 msaf_provisioning_session = msaf_provisioning_session_find_by_provisioningSessionId(message->h.resource.component[1]);
                                 if(msaf_provisioning_session) {
@@ -275,6 +300,9 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                             CASE("policy-templates")
                                 api = m1_policytemplatesprovisioning_api;
                                 break;
+                            CASE("metrics-reporting-configurations")
+                                api = m1_metricsreportingprovisioning_api;
+                                break;
                             DEFAULT
                             END
 
@@ -294,51 +322,50 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                             } else if (api == m1_contenthostingprovisioning_api) {
                                 // process the POST body
                                 int rv;
-                                cJSON *chc;
-                                cJSON *content_hosting_config;
+                                const char *reason = NULL;
+                                bool syntax_error = false;
+                                msaf_api_content_hosting_configuration_t *content_hosting_config;
+
+                                if (_request_conditions_handled(stream, message, &headers,
+                                            msaf_provisioning_session->contentHostingConfiguration?msaf_provisioning_session->httpMetadata.contentHostingConfiguration.hash:NULL,
+                                            NULL, msaf_provisioning_session->httpMetadata.contentHostingConfiguration.received, 0,
+                                            api, app_meta)) break;
 
                                 ogs_debug("Request body: %s", request->http.content);
 
-                                content_hosting_config = cJSON_Parse(request->http.content);
-                                {
-                                    char *txt = cJSON_Print(content_hosting_config);
-                                    ogs_debug("Parsed JSON: %s", txt);
-                                    cJSON_free(txt);
-                                }
+                                content_hosting_config = request->http.content?
+                                        msaf_content_hosting_configuration_parse_body(request->http.content,
+                                                                                      request->http.content_length,
+                                                                                      &syntax_error, &reason):NULL;
 
-                                if (!content_hosting_config) {
+                                if (!content_hosting_config && (syntax_error || !request->http.content)) {
                                     char *err = NULL;
                                     err = ogs_msprintf("Unable to parse Content Hosting Configuration as JSON for the Provisioning Session [%s].", message->h.resource.component[1]);
                                     ogs_error("%s", err);
                                     ogs_assert(true == nf_server_send_error(stream, 400, 2, message, "Bad Content Hosting Configuration.", err, NULL, m1_contenthostingprovisioning_api, app_meta));
                                     ogs_free(err);
                                 } else {
-                                    const char *reason;
-
-                                    rv = msaf_distribution_create(content_hosting_config, msaf_provisioning_session, &reason);
+                                    rv = content_hosting_config?msaf_distribution_create_from_model(content_hosting_config, msaf_provisioning_session):0;
                                     content_hosting_config = NULL;
     
                                     if (rv) {
     
                                         ogs_debug("Content Hosting Configuration created successfully");
+                                        msaf_provisioning_session_journal_content_hosting_configuration(msaf_provisioning_session);
                                         if (msaf_application_server_state_set_on_post(msaf_provisioning_session)) {
-                                            chc = msaf_get_content_hosting_configuration_by_provisioning_session_id(
-                                                    message->h.resource.component[1]);
-                                            if (chc != NULL) {
-                                                char *text;
-                                                msaf_provisioning_session = msaf_provisioning_session_find_by_provisioningSessionId(
-                                                            message->h.resource.component[1]);
+                                            char *text;
+
+                                            text = msaf_content_hosting_configuration_body(msaf_provisioning_session);
+                                            if (text != NULL) {
                                                 response = nf_server_new_response(request->h.uri, "application/json",
                                                             msaf_provisioning_session->httpMetadata.contentHostingConfiguration.received,
                                                             msaf_provisioning_session->httpMetadata.contentHostingConfiguration.hash,
                                                             msaf_self()->config.server_response_cache_control->m1_content_hosting_configurations_response_max_age,
                                                             NULL, m1_contenthostingprovisioning_api, app_meta);
                                                 ogs_assert(response);
-                                                text = cJSON_Print(chc);
                                                 nf_server_populate_response(response, strlen(text), text, 201);
                                                 ogs_assert(true == ogs_sbi_server_send_response(stream, response));
                                                 response = NULL;
-                                                cJSON_Delete(chc);
                                             } else {
                                                 char *err = NULL;
                                                 err = ogs_msprintf("Unable to retrieve the Content Hosting Configuration for the Provisioning Session [%s].", message->h.resource.component[1]);
@@ -361,7 +388,6 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                         ogs_free(err);
                                     }
 
-                                    if (content_hosting_config) cJSON_Delete(content_hosting_config);
                                 }
 
                             } else if (api == m1_servercertificatesprovisioning_api) {
@@ -435,7 +461,9 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                         ogs_free(node);
                                     }
 
-                                    ogs_hash_set(msaf_provisioning_session->certificate_map, msaf_strdup(csr_cert->id), OGS_HASH_KEY_STRING, msaf_strdup(csr_cert->id));
+                                    msaf_provisioning_session_certificate_add(msaf_provisioning_session, csr_cert->id);
+                                    msaf_provisioning_session_changed(msaf_provisioning_session);
+                                    msaf_provisioning_session_journal_certificate(msaf_provisioning_session, csr_cert->id);
                                     ogs_sbi_response_t *response;
                                     location = ogs_msprintf("%s/%s", request->h.uri, csr_cert->id);
                                     if(csr_cert->cache_control_max_age){
@@ -460,7 +488,9 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                     ogs_sbi_response_t *response;
                                     char *location;
 
-                                    ogs_hash_set(msaf_provisioning_session->certificate_map, msaf_strdup(cert), OGS_HASH_KEY_STRING, cert);
+                                    msaf_provisioning_session_certificate_add(msaf_provisioning_session, cert);
+                                    msaf_provisioning_session_changed(msaf_provisioning_session);
+                                    msaf_provisioning_session_journal_certificate(msaf_provisioning_session, cert);
                                         
                                     location = ogs_msprintf("%s/%s", request->h.uri, cert);
                                     response = nf_server_new_response(location, NULL,  0, NULL, 0, NULL, m1_servercertificatesprovisioning_api, app_meta);
@@ -468,13 +498,16 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                     ogs_assert(response);
                                     ogs_assert(true == ogs_sbi_server_send_response(stream, response));
                                     ogs_free(location);
+                                    ogs_free(cert);
                                 } else {
                                     msaf_certificate_t *new_cert;
                                     int m1_server_certificates_response_max_age;
                                     ogs_sbi_response_t *response;
                                     char *location;
                                     new_cert = server_cert_new("newcert", canonical_domain_name, NULL);
-                                    ogs_hash_set(msaf_provisioning_session->certificate_map, msaf_strdup(new_cert->id), OGS_HASH_KEY_STRING, msaf_strdup(new_cert->id));
+                                    msaf_provisioning_session_certificate_add(msaf_provisioning_session, new_cert->id);
+                                    msaf_provisioning_session_changed(msaf_provisioning_session);
+                                    msaf_provisioning_session_journal_certificate(msaf_provisioning_session, new_cert->id);
                                      
                                     location = ogs_msprintf("%s/%s", request->h.uri, new_cert->id);
                                     if(new_cert->cache_control_max_age){
@@ -523,7 +556,8 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                         msaf_api_consumption_reporting_configuration_free(report_config);
                                     } else {
                                         ogs_sbi_response_t *response;
-    
+
+                                        msaf_provisioning_session_journal_consumption_reporting_configuration(msaf_provisioning_session);
                                         response = nf_server_new_response(NULL, NULL,  0, NULL, 0, NULL, api, app_meta);
                                         ogs_assert(response);
                                         nf_server_populate_response(response, 0, NULL, 204);
@@ -548,15 +582,16 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                 pol_temp = cJSON_Print(policy_template);
                                 ogs_debug("Requested Policy Template: %s", pol_temp);
                                 policy_temp = msaf_policy_template_parseFromJSON(policy_template, &parse_err);
-                                _policy_template_extra_validation(&policy_temp, &parse_err);
+                                msaf_policy_template_extra_validation(&policy_temp, &parse_err);
                                 if (policy_temp) {
-                                    _policy_template_remove_read_only(policy_temp);
+                                    msaf_policy_template_remove_read_only(policy_temp);
                                     /* add policy template */
                                     if (msaf_provisioning_session_add_policy_template(msaf_provisioning_session, policy_temp, time(NULL))) {
                                         char *location;
                                         msaf_policy_template_node_t *msaf_policy_template;
 
                                         msaf_policy_template = msaf_provisioning_session_find_policy_template_by_id(msaf_provisioning_session, policy_temp->policy_template_id);
+                                        msaf_provisioning_session_journal_policy_template(msaf_provisioning_session, policy_temp->policy_template_id);
                                         location = ogs_msprintf("%s/%s", request->h.uri, msaf_policy_template->policy_template->policy_template_id);
 
 
@@ -586,6 +621,38 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                 }
 				if (policy_template) cJSON_Delete(policy_template);
                                 if (pol_temp) cJSON_free(pol_temp);
+                            } else if (api == m1_metricsreportingprovisioning_api) {
+                                msaf_api_metrics_reporting_configuration_t *config;
+                                const char *parse_err = NULL;
+
+                                config = _metrics_reporting_configuration_from_request(request, &headers, &parse_err);
+                                if (!config) {
+                                    char *err;
+                                    err = ogs_msprintf("Bad MetricsReportingConfiguration for provisioning session [%s]: %s", message->h.resource.component[1], parse_err);
+                                    ogs_error("%s", err);
+                                    ogs_assert(true == nf_server_send_error(stream, 400, 2, message, "Bad request.", err, NULL, api, app_meta));
+                                    ogs_free(err);
+                                } else {
+                                    msaf_metrics_reporting_configuration_node_t *node;
+                                    ogs_sbi_response_t *response;
+                                    char *location;
+                                    char *body;
+
+                                    node = msaf_metrics_reporting_configuration_register(msaf_provisioning_session, config);
+                                    msaf_provisioning_session_journal_metrics_reporting_configuration(msaf_provisioning_session,
+                                                                            node->config->metrics_reporting_configuration_id);
+                                    body = msaf_metrics_reporting_configuration_body(node);
+                                    ogs_assert(body);
+                                    location = ogs_msprintf("%s/%s", request->h.uri, node->config->metrics_reporting_configuration_id);
+
+                                    response = nf_server_new_response(location, "application/json", node->received, node->hash,
+                                                                      msaf_self()->config.server_response_cache_control->m1_provisioning_session_response_max_age,
+                                                                      NULL, api, app_meta);
+                                    ogs_assert(response);
+                                    nf_server_populate_response(response, strlen(body), body, 201);
+                                    ogs_assert(true == ogs_sbi_server_send_response(stream, response));
+                                    ogs_free(location);
+                                }
                             }
 
                         } else if (message->h.resource.component[1] && !message->h.resource.component[2]){
@@ -609,7 +676,7 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                         } else {
                             cJSON *entry;
                             cJSON *prov_sess;
-                            cJSON *provisioning_session;
+                            char *text;
                             char *provisioning_session_type = NULL, *external_app_id = NULL, *asp_id = NULL;
                             msaf_provisioning_session_t *msaf_provisioning_session;
 
@@ -664,12 +731,11 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                             }
                             
                             msaf_provisioning_session = msaf_provisioning_session_create(provisioning_session_type, asp_id, external_app_id);
-                            provisioning_session = msaf_provisioning_session_get_json(msaf_provisioning_session->provisioningSessionId);
-                            if (provisioning_session != NULL) {
+                            msaf_provisioning_session_journal_provisioning_session(msaf_provisioning_session->provisioningSessionId);
+                            text = msaf_provisioning_session_body(msaf_provisioning_session);
+                            if (text != NULL) {
                                 ogs_sbi_response_t *response;
-                                char *text;
                                 char *location;
-                                text = cJSON_Print(provisioning_session);
                                 if (request->h.uri[strlen(request->h.uri)-1] != '/') {
                                     location = ogs_msprintf("%s/%s", request->h.uri,msaf_provisioning_session->provisioningSessionId);
                                 } else {
@@ -681,7 +747,6 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                 ogs_assert(response);
                                 ogs_assert(true == ogs_sbi_server_send_response(stream, response));
                                 ogs_free(location);
-                                cJSON_Delete(provisioning_session);
                             } else {
                                 const char *err = "Creation of the Provisioning session failed.";
                                 ogs_error("%s", err);
@@ -702,6 +767,9 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                             CASE("policy-templates")
                                 api = m1_policytemplatesprovisioning_api;
                                 break;
+                            CASE("metrics-reporting-configurations")
+                                api = m1_metricsreportingprovisioning_api;
+                                break;
                             CASE("certificates")
                                 api = m1_servercertificatesprovisioning_api;
                                 break;
@@ -728,18 +796,19 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                     msaf_policy_template_node_t *msaf_policy_template;
                                     msaf_policy_template = msaf_provisioning_session_find_policy_template_by_id(msaf_provisioning_session, message->h.resource.component[3]);
                                     if(msaf_policy_template) {
-                                        cJSON *policy_template;
                                         char *policy_template_body;
-    
-                                        policy_template = msaf_policy_template_convertToJSON(msaf_policy_template->policy_template);
-                                        policy_template_body = cJSON_Print(policy_template);
+
+                                        if (_request_conditions_handled(stream, message, &headers, msaf_policy_template->hash, NULL,
+                                                    msaf_policy_template->last_modified,
+                                                    msaf_self()->config.server_response_cache_control->m1_provisioning_session_response_max_age,
+                                                    m1_policytemplatesprovisioning_api, app_meta)) break;
+
+                                        policy_template_body = msaf_policy_template_body(msaf_policy_template);
 
                                         response = nf_server_new_response(NULL, "application/json", msaf_policy_template->last_modified, msaf_policy_template->hash, msaf_self()->config.server_response_cache_control->m1_provisioning_session_response_max_age, NULL, m1_policytemplatesprovisioning_api, app_meta);
                                         nf_server_populate_response(response, strlen(policy_template_body), policy_template_body, 200);
                                         ogs_assert(true == ogs_sbi_server_send_response(stream, response));
                                         response = NULL;
-                  
-                                        cJSON_Delete(policy_template);
 
                                     } else {
 					char *err = NULL;
@@ -784,6 +853,12 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                         } else {
                                             m1_server_certificates_response_max_age = msaf_self()->config.server_response_cache_control->m1_server_certificates_response_max_age;
                                         }
+                                        if (_request_conditions_handled(stream, message, &headers, cert->server_certificate_hash, NULL,
+                                                    cert->last_modified, m1_server_certificates_response_max_age,
+                                                    m1_servercertificatesprovisioning_api, app_meta)) {
+                                            msaf_certificate_free(cert);
+                                            break;
+                                        }
                                         response = nf_server_new_response(NULL, "application/x-pem-file",  cert->last_modified, cert->server_certificate_hash, m1_server_certificates_response_max_age, NULL, m1_servercertificatesprovisioning_api, app_meta);
                                         nf_server_populate_response(response, strlen(cert->certificate), msaf_strdup(cert->certificate), 200);
                                         ogs_assert(response);
@@ -816,6 +891,33 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                     ogs_assert(true == nf_server_send_error(stream, 404, 3, message, "Provisioning session does not exists.", err, NULL, m1_servercertificatesprovisioning_api, app_meta));
                                     ogs_free(err);
                                 }
+                            } else if (api == m1_metricsreportingprovisioning_api) {
+                                msaf_metrics_reporting_configuration_node_t *node;
+
+                                node = msaf_metrics_reporting_configuration_find(msaf_provisioning_session, message->h.resource.component[3]);
+                                if (node && _request_conditions_handled(stream, message, &headers, node->hash, NULL, node->received,
+                                                    msaf_self()->config.server_response_cache_control->m1_provisioning_session_response_max_age,
+                                                    api, app_meta)) {
+                                    /* 304 Not Modified sent */
+                                } else if (node) {
+                                    ogs_sbi_response_t *response;
+                                    char *body;
+
+                                    body = msaf_metrics_reporting_configuration_body(node);
+                                    ogs_assert(body);
+                                    response = nf_server_new_response(NULL, "application/json", node->received, node->hash,
+                                                                      msaf_self()->config.server_response_cache_control->m1_provisioning_session_response_max_age,
+                                                                      NULL, api, app_meta);
+                                    ogs_assert(response);
+                                    nf_server_populate_response(response, strlen(body), body, 200);
+                                    ogs_assert(true == ogs_sbi_server_send_response(stream, response));
+                                } else {
+                                    char *err = NULL;
+                                    err = ogs_msprintf("Provisioning session [%s] has no metrics reporting configuration [%s].", message->h.resource.component[1], message->h.resource.component[3]);
+                                    ogs_error("%s", err);
+                                    ogs_assert(true == nf_server_send_error(stream, 404, 3, message, "Metrics reporting configuration does not exist.", err, NULL, api, app_meta));
+                                    ogs_free(err);
+                                }
                             }
                         } else if (message->h.resource.component[1] && message->h.resource.component[2] && !message->h.resource.component[3]) {
                             msaf_provisioning_session_t *msaf_provisioning_session;
@@ -848,19 +950,39 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                 ogs_assert(true == nf_server_send_error(stream, 404, 2, message, "Unknown provisioning session sub-resource.", err, NULL, m1_provisioningsession_api, app_meta));
                                 ogs_free(err);
                             } else if (api == m1_contenthostingprovisioning_api) {
-                                cJSON *chc;
-                                chc = msaf_get_content_hosting_configuration_by_provisioning_session_id(message->h.resource.component[1]);
-                                if (chc != NULL) {
+                                msaf_http_metadata_t *chc_meta = &msaf_provisioning_session->httpMetadata.contentHostingConfiguration;
+                                bool accept_gzip;
+                                char *text = NULL;
+
+                                accept_gzip = msaf_content_encoding_select(msaf_request_headers_get(&headers, MSAF_REQUEST_HEADER_ACCEPT_ENCODING)) == MSAF_CONTENT_ENCODING_GZIP;
+                                if (msaf_provisioning_session->contentHostingConfiguration &&
+                                        _request_conditions_handled(stream, message, &headers, chc_meta->hash,
+                                                    (accept_gzip && msaf_content_variant_is_current(&chc_meta->gzip, chc_meta->hash))?chc_meta->gzip.etag:NULL,
+                                                    chc_meta->received,
+                                                    msaf_self()->config.server_response_cache_control->m1_content_hosting_configurations_response_max_age,
+                                                    api, app_meta)) break;
+
+                                text = msaf_content_hosting_configuration_body(msaf_provisioning_session);
+                                if (text != NULL) {
                                     ogs_sbi_response_t *response;
-                                    char *text;
-                                    text = cJSON_Print(chc);
+                                    bool gzip;
+                                    size_t length;
+                                    length = strlen(text);
+
+                                    /* the gzip variant is only recompressed when the configuration hash changes */
+                                    gzip = accept_gzip && msaf_content_variant_gzip(&chc_meta->gzip, text, length, chc_meta->hash);
 
-                                    response = nf_server_new_response(request->h.uri, "application/json",  msaf_provisioning_session->httpMetadata.contentHostingConfiguration.received, msaf_provisioning_session->httpMetadata.contentHostingConfiguration.hash, msaf_self()->config.server_response_cache_control->m1_content_hosting_configurations_response_max_age, NULL, m1_contenthostingprovisioning_api, app_meta);
+                                    response = nf_server_new_response(request->h.uri, "application/json",  chc_meta->received, gzip?chc_meta->gzip.etag:chc_meta->hash, msaf_self()->config.server_response_cache_control->m1_content_hosting_configurations_response_max_age, NULL, m1_contenthostingprovisioning_api, app_meta);
                                     ogs_assert(response);
-                                    nf_server_populate_response(response, strlen(text), text, 200);
+                                    if (gzip) {
+                                        ogs_free(text);
+                                        nf_server_set_content_encoding(response, msaf_content_encoding_name(MSAF_CONTENT_ENCODING_GZIP));
+                                        nf_server_populate_response(response, chc_meta->gzip.length, ogs_memdup(chc_meta->gzip.body, chc_meta->gzip.length+1), 200);
+                                    } else {
+                                        nf_server_set_content_encoding(response, NULL);
+                                        nf_server_populate_response(response, length, text, 200);
+                                    }
                                     ogs_assert(true == ogs_sbi_server_send_response(stream, response));
-
-                                    cJSON_Delete(chc);
                                 } else {
                                     char *err = NULL;
                                     err = ogs_msprintf("Provisioning Session [%s]: Unable to retrieve the Content Hosting Configuration", message->h.resource.component[1]);
@@ -871,10 +993,27 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
 
                             } else if (api == m1_contentprotocolsdiscovery_api) {
                                 ogs_sbi_response_t *response;
+                                bool accept_gzip;
+                                bool gzip;
+
+                                accept_gzip = msaf_content_encoding_select(msaf_request_headers_get(&headers, MSAF_REQUEST_HEADER_ACCEPT_ENCODING)) == MSAF_CONTENT_ENCODING_GZIP;
+                                if (_request_conditions_handled(stream, message, &headers, CONTENT_PROTOCOLS_DISCOVERY_JSON_HASH,
+                                                    (accept_gzip && content_protocols_discovery_gzip.body)?content_protocols_discovery_gzip.etag:NULL,
+                                                    CONTENT_PROTOCOLS_DISCOVERY_JSON_TIME,
+                                                    msaf_self()->config.server_response_cache_control->m1_content_protocols_response_max_age,
+                                                    api, app_meta)) break;
+
                                 ogs_info("CONTENT_PROTOCOLS_DISCOVERY_JSON: %s", CONTENT_PROTOCOLS_DISCOVERY_JSON);
-                                response = nf_server_new_response(NULL, "application/json",  CONTENT_PROTOCOLS_DISCOVERY_JSON_TIME, CONTENT_PROTOCOLS_DISCOVERY_JSON_HASH, msaf_self()->config.server_response_cache_control->m1_content_protocols_response_max_age, NULL, m1_contentprotocolsdiscovery_api, app_meta);
+                                gzip = accept_gzip && msaf_content_variant_gzip(&content_protocols_discovery_gzip, CONTENT_PROTOCOLS_DISCOVERY_JSON, strlen(CONTENT_PROTOCOLS_DISCOVERY_JSON), CONTENT_PROTOCOLS_DISCOVERY_JSON_HASH);
+                                response = nf_server_new_response(NULL, "application/json",  CONTENT_PROTOCOLS_DISCOVERY_JSON_TIME, gzip?content_protocols_discovery_gzip.etag:CONTENT_PROTOCOLS_DISCOVERY_JSON_HASH, msaf_self()->config.server_response_cache_control->m1_content_protocols_response_max_age, NULL, m1_contentprotocolsdiscovery_api, app_meta);
                                 ogs_assert(response);
-                                nf_server_populate_response(response, strlen(CONTENT_PROTOCOLS_DISCOVERY_JSON), msaf_strdup(CONTENT_PROTOCOLS_DISCOVERY_JSON), 200);
+                                if (gzip) {
+                                    nf_server_set_content_encoding(response, msaf_content_encoding_name(MSAF_CONTENT_ENCODING_GZIP));
+                                    nf_server_populate_response(response, content_protocols_discovery_gzip.length, ogs_memdup(content_protocols_discovery_gzip.body, content_protocols_discovery_gzip.length+1), 200);
+                                } else {
+                                    nf_server_set_content_encoding(response, NULL);
+                                    nf_server_populate_response(response, strlen(CONTENT_PROTOCOLS_DISCOVERY_JSON), msaf_strdup(CONTENT_PROTOCOLS_DISCOVERY_JSON), 200);
+                                }
                                 ogs_assert(true == ogs_sbi_server_send_response(stream, response));
                             } else if (api == m1_consumptionreportingprovisioning_api) {
                                 ogs_sbi_response_t *response;
@@ -882,6 +1021,13 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
 
                                 ogs_debug("GET ConsumptionReportingConfiguration");
 
+                                if (msaf_consumption_report_configuration_etag(msaf_provisioning_session) &&
+                                        _request_conditions_handled(stream, message, &headers,
+                                                    msaf_consumption_report_configuration_etag(msaf_provisioning_session), NULL,
+                                                    msaf_consumption_report_configuration_last_modified(msaf_provisioning_session),
+                                                    msaf_self()->config.server_response_cache_control->m1_consumption_reporting_response_max_age,
+                                                    api, app_meta)) break;
+
                                 body = msaf_consumption_report_configuration_body(msaf_provisioning_session);
                                 if (!body) {
                                     char *err = NULL;
@@ -902,16 +1048,23 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                             }
                         } else if (message->h.resource.component[1] && !message->h.resource.component[2]) {
                             msaf_provisioning_session_t *msaf_provisioning_session = NULL;
-                            cJSON *provisioning_session = NULL;
+                            char *text = NULL;
 
                             msaf_provisioning_session = msaf_provisioning_session_find_by_provisioningSessionId(message->h.resource.component[1]);
 
-                            provisioning_session = msaf_provisioning_session_get_json(message->h.resource.component[1]);
+                            /* the rendered body is kept with the session and only rebuilt after the session changes */
+                            if (msaf_provisioning_session && !msaf_provisioning_session->marked_for_deletion &&
+                                    msaf_provisioning_session_etag(msaf_provisioning_session)) {
+                                if (_request_conditions_handled(stream, message, &headers,
+                                            msaf_provisioning_session->httpMetadata.provisioningSession.hash, NULL,
+                                            msaf_provisioning_session->httpMetadata.provisioningSession.received,
+                                            msaf_self()->config.server_response_cache_control->m1_provisioning_session_response_max_age,
+                                            m1_provisioningsession_api, app_meta)) break;
+                                text = msaf_provisioning_session_body(msaf_provisioning_session);
+                            }
 
-                            if (provisioning_session && msaf_provisioning_session && !msaf_provisioning_session->marked_for_deletion) {
+                            if (text) {
                                 ogs_sbi_response_t *response;
-                                char *text;
-                                text = cJSON_Print(provisioning_session);
 
                                 response = nf_server_new_response(NULL, "application/json",  msaf_provisioning_session->httpMetadata.provisioningSession.received, msaf_provisioning_session->httpMetadata.provisioningSession.hash, msaf_self()->config.server_response_cache_control->m1_provisioning_session_response_max_age, NULL, m1_provisioningsession_api, app_meta);
 
@@ -926,7 +1079,6 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                 ogs_assert(true == nf_server_send_error(stream, 404, 1, message, "Provisioning session does not exists.", err, NULL, m1_provisioningsession_api, app_meta));
                                 ogs_free(err);
                             }
-                            if (provisioning_session) cJSON_Delete(provisioning_session);
                         }
                         break;
 
@@ -950,6 +1102,9 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                             CASE("policy-templates")
                                 api = m1_policytemplatesprovisioning_api;
                                 break;
+                            CASE("metrics-reporting-configurations")
+                                api = m1_metricsreportingprovisioning_api;
+                                break;
                             DEFAULT
                             END
 
@@ -974,9 +1129,20 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                     // process the PUT body
                                     int rv;
                                     const char *reason = NULL;
-                                    cJSON *content_hosting_config = cJSON_Parse(request->http.content);
-
-                                    if (!content_hosting_config) {
+                                    bool syntax_error = false;
+                                    msaf_api_content_hosting_configuration_t *content_hosting_config;
+                                    msaf_content_hosting_configuration_diff_t chc_diff;
+
+                                    if (_request_conditions_handled(stream, message, &headers,
+                                                msaf_provisioning_session->contentHostingConfiguration?msaf_provisioning_session->httpMetadata.contentHostingConfiguration.hash:NULL,
+                                                NULL, msaf_provisioning_session->httpMetadata.contentHostingConfiguration.received, 0,
+                                                api, app_meta)) break;
+
+                                    content_hosting_config = request->http.content?
+                                            msaf_content_hosting_configuration_parse_body(request->http.content,
+                                                                                          request->http.content_length,
+                                                                                          &syntax_error, &reason):NULL;
+                                    if (!content_hosting_config && (syntax_error || !request->http.content)) {
                                         char *err = NULL;
                                         err = ogs_msprintf("While updating the Content Hosting Configuration for the Provisioning Session [%s], Failure parsing ContentHostingConfiguration JSON.",message->h.resource.component[1]);
                                         ogs_error("%s", err);
@@ -985,24 +1151,18 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                         break;
                                     }
 
-                                    {
-                                        char *txt = cJSON_Print(content_hosting_config);
-                                        ogs_debug("Parsed JSON: %s", txt);
-                                        cJSON_free(txt);
-                                    }
-
-                                    if(msaf_provisioning_session->contentHostingConfiguration) {
-                                        msaf_api_content_hosting_configuration_free(msaf_provisioning_session->contentHostingConfiguration);
-                                        msaf_provisioning_session->contentHostingConfiguration = NULL;
-                                        msaf_sai_cache_clear(msaf_provisioning_session->sai_cache);
-                                    }
-
-                                    rv = msaf_distribution_create(content_hosting_config, msaf_provisioning_session, &reason);
+                                    /* the current configuration is replaced by the update, and only what changed is passed on */
+                                    rv = content_hosting_config?msaf_distribution_update_from_model(content_hosting_config, msaf_provisioning_session, &chc_diff):0;
                                     content_hosting_config = NULL;
                                     if (rv){
-                                        msaf_application_server_state_update(msaf_provisioning_session);
-
-                                        ogs_debug("Content Hosting Configuration updated successfully");
+                                        if (chc_diff.changed) {
+                                            msaf_provisioning_session_journal_content_hosting_configuration(msaf_provisioning_session);
+                                            ogs_debug("Content Hosting Configuration updated successfully");
+                                        } else {
+                                            ogs_debug("Content Hosting Configuration unchanged");
+                                        }
+                                        /* even when unchanged, any Application Server without the configuration gets it */
+                                        msaf_application_server_state_update_changes(msaf_provisioning_session, &chc_diff);
 
                                         ogs_sbi_response_t *response;
                                         response = ogs_sbi_response_new();
@@ -1040,25 +1200,18 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                     msaf_provisioning_session_t *msaf_provisioning_session;
 
                                     {
-                                        ogs_hash_index_t *hi;
-                                        for (hi = ogs_hash_first(request->http.headers);
-                                                hi; hi = ogs_hash_next(hi)) {
-                                            if (!ogs_strcasecmp(ogs_hash_this_key(hi), OGS_SBI_CONTENT_TYPE)) {
-                                                if (ogs_strcasecmp(ogs_hash_this_val(hi), "application/x-pem-file")) {
-                                                    char *err = NULL;
-                                                    const char *type;
-                                                    type = ogs_hash_this_val(hi);
-                                                    err = ogs_msprintf( "Unsupported Media Type: received type: %s, should have been application/x-pem-file", type);
-                                                    ogs_error("%s", err);
+                                        const char *type = msaf_request_headers_get(&headers, MSAF_REQUEST_HEADER_CONTENT_TYPE);
+                                        if (type && !msaf_request_headers_content_type_is(&headers, "application/x-pem-file")) {
+                                            char *err = NULL;
+                                            err = ogs_msprintf( "Unsupported Media Type: received type: %s, should have been application/x-pem-file", type);
+                                            ogs_error("%s", err);
 
-                                                    ogs_assert(true == nf_server_send_error(stream, 415, 3, message, "Unsupported Media Type.", err, NULL, m1_servercertificatesprovisioning_api, app_meta));
-                                                    ogs_free(err);
-                                                    ogs_sbi_message_free(message);
-                                                    ogs_free(message);
-                                                    return;
+                                            ogs_assert(true == nf_server_send_error(stream, 415, 3, message, "Unsupported Media Type.", err, NULL, m1_servercertificatesprovisioning_api, app_meta));
+                                            ogs_free(err);
+                                            ogs_sbi_message_free(message);
+                                            ogs_free(message);
+                                            return;
 
-                                                }
-                                            }
                                         }
                                     }
 
@@ -1068,6 +1221,21 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                         const char *provisioning_session_cert;
                                         provisioning_session_cert = ogs_hash_get(msaf_provisioning_session->certificate_map, message->h.resource.component[3], OGS_HASH_KEY_STRING);
                                         cert_id = message->h.resource.component[3];
+
+                                        /* only ask the certificate manager for the current certificate if there are conditions */
+                                        if (provisioning_session_cert && msaf_request_headers_has_conditions(&headers)) {
+                                            msaf_certificate_t *current;
+                                            bool handled;
+
+                                            current = server_cert_retrieve(cert_id);
+                                            handled = _request_conditions_handled(stream, message, &headers,
+                                                            (current && !current->return_code)?current->server_certificate_hash:NULL, NULL,
+                                                            (current && !current->return_code)?current->last_modified:0, 0,
+                                                            m1_servercertificatesprovisioning_api, app_meta);
+                                            if (current) msaf_certificate_free(current);
+                                            if (handled) break;
+                                        }
+
                                         cert = msaf_strdup(request->http.content);
                                         rv = server_cert_set(cert_id, cert);
                                         // response = ogs_sbi_response_new();
@@ -1125,6 +1293,11 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
 
                                 ogs_debug("PUT ConsumptionReportingConfiguration");
 
+                                if (_request_conditions_handled(stream, message, &headers,
+                                            msaf_consumption_report_configuration_etag(msaf_provisioning_session), NULL,
+                                            msaf_consumption_report_configuration_last_modified(msaf_provisioning_session), 0,
+                                            api, app_meta)) break;
+
                                 json = cJSON_Parse(request->http.content);
                                 if (!json) {
                                     char *err = NULL;
@@ -1152,6 +1325,7 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                             ogs_free(err);
                                         } else {
                                             ogs_sbi_response_t *response;
+                                            msaf_provisioning_session_journal_consumption_reporting_configuration(msaf_provisioning_session);
                                             response = nf_server_new_response(NULL, NULL, 0, NULL, 0, NULL, api, app_meta);
                                             ogs_assert(response);
                                             nf_server_populate_response(response, 0, NULL, 204);
@@ -1160,12 +1334,54 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                     }
                                     cJSON_Delete(json);
                                 }
+                            } else if (api == m1_metricsreportingprovisioning_api) {
+                                msaf_metrics_reporting_configuration_node_t *node = NULL;
+                                msaf_api_metrics_reporting_configuration_t *config;
+                                const char *parse_err = NULL;
+
+                                if (message->h.resource.component[3] && !message->h.resource.component[4]) {
+                                    node = msaf_metrics_reporting_configuration_find(msaf_provisioning_session, message->h.resource.component[3]);
+                                }
+                                if (!node) {
+                                    char *err = NULL;
+                                    err = ogs_msprintf("Provisioning session [%s] has no metrics reporting configuration [%s].", message->h.resource.component[1], message->h.resource.component[3]?message->h.resource.component[3]:"");
+                                    ogs_error("%s", err);
+                                    ogs_assert(true == nf_server_send_error(stream, 404, 3, message, "Metrics reporting configuration does not exist.", err, NULL, api, app_meta));
+                                    ogs_free(err);
+                                } else if (_request_conditions_handled(stream, message, &headers, node->hash, NULL, node->received, 0, api,
+                                                                       app_meta)) {
+                                    /* 412 Precondition Failed sent */
+                                } else if (!(config = _metrics_reporting_configuration_from_request(request, &headers, &parse_err))) {
+                                    char *err = NULL;
+                                    err = ogs_msprintf("Bad MetricsReportingConfiguration [%s] for provisioning session [%s]: %s", message->h.resource.component[3], message->h.resource.component[1], parse_err);
+                                    ogs_error("%s", err);
+                                    ogs_assert(true == nf_server_send_error(stream, 400, 3, message, "Bad request.", err, NULL, api, app_meta));
+                                    ogs_free(err);
+                                } else if (config->metrics_reporting_configuration_id && strcmp(config->metrics_reporting_configuration_id, message->h.resource.component[3])) {
+                                    char *err = NULL;
+                                    err = ogs_msprintf("MetricsReportingConfiguration id [%s] does not match the resource [%s].", config->metrics_reporting_configuration_id, message->h.resource.component[3]);
+                                    ogs_error("%s", err);
+                                    ogs_assert(true == nf_server_send_error(stream, 400, 3, message, "Bad request.", err, NULL, api, app_meta));
+                                    ogs_free(err);
+                                    msaf_api_metrics_reporting_configuration_free(config);
+                                } else {
+                                    ogs_sbi_response_t *response;
+
+                                    msaf_metrics_reporting_configuration_update(msaf_provisioning_session, node, config);
+                                    msaf_provisioning_session_journal_metrics_reporting_configuration(msaf_provisioning_session,
+                                                                            node->config->metrics_reporting_configuration_id);
+
+                                    response = nf_server_new_response(NULL, NULL, 0, NULL, 0, NULL, api, app_meta);
+                                    ogs_assert(response);
+                                    nf_server_populate_response(response, 0, NULL, 204);
+                                    ogs_assert(true == ogs_sbi_server_send_response(stream, response));
+                                }
                             } else if (api == m1_policytemplatesprovisioning_api) {
 			        ogs_sbi_response_t *response;
                                 msaf_provisioning_session_t *msaf_provisioning_session;
 				msaf_api_policy_template_t *policy_template;
 
-				if(!check_http_content_type(request->http,"application/json")){
+				if(!msaf_request_headers_content_type_is(&headers, "application/json")){
                                     ogs_assert(true == nf_server_send_error(stream, 415, 3, message, "Unsupported Media Type.", "Expected content type: application/json", NULL, m1_policytemplatesprovisioning_api, app_meta));
                                     ogs_sbi_message_free(message);
                                     ogs_free(message);
@@ -1188,13 +1404,17 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                     if(msaf_policy_template) {
 			                cJSON *policy_template_received;
                                         const char *parse_err;
+
+                                        if (_request_conditions_handled(stream, message, &headers, msaf_policy_template->hash, NULL,
+                                                    msaf_policy_template->last_modified, 0, m1_policytemplatesprovisioning_api,
+                                                    app_meta)) break;
 					
 					policy_template_received = cJSON_Parse(request->http.content); 	
 				    	     	    
 					policy_template = msaf_policy_template_parseFromJSON(policy_template_received, &parse_err);
 					cJSON_Delete(policy_template_received);
 
-                                        _policy_template_extra_validation(&policy_template, &parse_err);
+                                        msaf_policy_template_extra_validation(&policy_template, &parse_err);
 
                                         if (!policy_template) {
                                             char *err = ogs_msprintf("Updating policy template: Could not parse request body as JSON: %s", parse_err);
@@ -1206,11 +1426,12 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                         }
 
                                         /* validation passed, remove read-only fields if present */
-                                        _policy_template_remove_read_only(policy_template);
+                                        msaf_policy_template_remove_read_only(policy_template);
 
                                         /* update policy template */
 					if(msaf_provisioning_session_update_policy_template(msaf_provisioning_session, msaf_policy_template, policy_template)) {
-					        
+                                            msaf_provisioning_session_journal_policy_template(msaf_provisioning_session, policy_template->policy_template_id);
+
 				            response = nf_server_new_response(NULL, NULL, 0, NULL, 0, NULL, m1_policytemplatesprovisioning_api, app_meta);
                                             nf_server_populate_response(response, 0, NULL, 204);
                                             ogs_assert(response);
@@ -1268,6 +1489,9 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                             CASE("policy-templates")
                                 api = m1_policytemplatesprovisioning_api;
                                 break;
+                            CASE("metrics-reporting-configurations")
+                                api = m1_metricsreportingprovisioning_api;
+                                break;
                             DEFAULT
                             END
 
@@ -1291,10 +1515,17 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                 if (!message->h.resource.component[3]) {
                                     /* Delete the ContentHostingConfiguration */
                                     ogs_sbi_response_t *response;
-                                    if(provisioning_session && provisioning_session->contentHostingConfiguration) {
+                                    if (provisioning_session->contentHostingConfiguration &&
+                                            _request_conditions_handled(stream, message, &headers,
+                                                    provisioning_session->httpMetadata.contentHostingConfiguration.hash, NULL,
+                                                    provisioning_session->httpMetadata.contentHostingConfiguration.received, 0,
+                                                    api, app_meta)) {
+                                        /* 412 Precondition Failed sent */
+                                    } else if(provisioning_session && provisioning_session->contentHostingConfiguration) {
                                         msaf_delete_content_hosting_configuration(message->h.resource.component[1]);
                                         msaf_api_content_hosting_configuration_free(provisioning_session->contentHostingConfiguration);
                                         provisioning_session->contentHostingConfiguration = NULL;
+                                        msaf_provisioning_session_journal_content_hosting_configuration(provisioning_session);
                                         response = nf_server_new_response(NULL, NULL,  0, NULL, 0, NULL, m1_contenthostingprovisioning_api, app_meta);
                                         ogs_assert(response);
                                         nf_server_populate_response(response, 0, NULL, 204);
@@ -1329,6 +1560,20 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                         /* Delete one certificate by id */
                                         ogs_sbi_response_t *response;
                                         int rv;
+
+                                        if (msaf_request_headers_has_conditions(&headers)) {
+                                            msaf_certificate_t *current;
+                                            bool handled;
+
+                                            current = server_cert_retrieve(message->h.resource.component[3]);
+                                            handled = _request_conditions_handled(stream, message, &headers,
+                                                            (current && !current->return_code)?current->server_certificate_hash:NULL, NULL,
+                                                            (current && !current->return_code)?current->last_modified:0, 0,
+                                                            api, app_meta);
+                                            if (current) msaf_certificate_free(current);
+                                            if (handled) break;
+                                        }
+
                                         rv = server_cert_delete(message->h.resource.component[3]);
                                         if ((rv == 0) || (rv == 8)){
                                             response = nf_server_new_response(NULL, NULL,  0, NULL, 0, NULL, m1_servercertificatesprovisioning_api, app_meta);
@@ -1336,6 +1581,7 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                             ogs_assert(response);
                                             ogs_assert(true == ogs_sbi_server_send_response(stream, response));
                                             msaf_provisioning_session_certificate_hash_remove(message->h.resource.component[1], message->h.resource.component[3]);
+                                            msaf_provisioning_session_journal_certificate(provisioning_session, message->h.resource.component[3]);
                                         } else if (rv == 4 ) {
                                             char *err = NULL;
                                             err = ogs_msprintf("Certificate [%s] does not exist.", message->h.resource.component[3]);
@@ -1365,7 +1611,17 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                         msaf_provisioning_session_t *provisioning_session = NULL;
                                         provisioning_session = msaf_provisioning_session_find_by_provisioningSessionId(message->h.resource.component[1]);
                                         if (provisioning_session) {
-                                            if (msaf_provisioning_session_delete_policy_template_by_id(provisioning_session, message->h.resource.component[3])) {
+                                            msaf_policy_template_node_t *msaf_policy_template;
+
+                                            msaf_policy_template = msaf_provisioning_session_find_policy_template_by_id(provisioning_session, message->h.resource.component[3]);
+                                            if (msaf_policy_template &&
+                                                    _request_conditions_handled(stream, message, &headers, msaf_policy_template->hash, NULL,
+                                                                msaf_policy_template->last_modified, 0,
+                                                                m1_policytemplatesprovisioning_api, app_meta)) {
+                                                /* 412 Precondition Failed sent */
+                                            } else if (msaf_provisioning_session_delete_policy_template_by_id(provisioning_session, message->h.resource.component[3])) {
+                                                msaf_provisioning_session_journal_policy_template(provisioning_session,
+                                                                                        message->h.resource.component[3]);
                                                 response = nf_server_new_response(NULL, NULL,  0, NULL, 0, NULL, m1_policytemplatesprovisioning_api, app_meta);
                                                 nf_server_populate_response(response, 0, NULL, 204);
                                                 ogs_assert(response);
@@ -1385,9 +1641,16 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
 			    } else if (api == m1_consumptionreportingprovisioning_api) {
                                 if (!message->h.resource.component[3]) {
                                     /* Delete consumption reporting configuration */
-                                    if (msaf_consumption_report_configuration_deregister(provisioning_session)) {
+                                    if (msaf_consumption_report_configuration_etag(provisioning_session) &&
+                                            _request_conditions_handled(stream, message, &headers,
+                                                    msaf_consumption_report_configuration_etag(provisioning_session), NULL,
+                                                    msaf_consumption_report_configuration_last_modified(provisioning_session), 0,
+                                                    api, app_meta)) {
+                                        /* 412 Precondition Failed sent */
+                                    } else if (msaf_consumption_report_configuration_deregister(provisioning_session)) {
                                         /* Deleted consumption reporting configuration successfully */
                                         ogs_sbi_response_t *response;
+                                        msaf_provisioning_session_journal_consumption_reporting_configuration(provisioning_session);
                                         response = nf_server_new_response(NULL, NULL,  0, NULL, 0, NULL, api, app_meta);
                                         nf_server_populate_response(response, 0, NULL, 204);
                                         ogs_assert(response);
@@ -1408,6 +1671,30 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                     ogs_assert(true == nf_server_send_error(stream, 400, 2, message, "Bad request", err, NULL, api, app_meta));
                                     ogs_free(err);
                                 }
+                            } else if (api == m1_metricsreportingprovisioning_api) {
+                                msaf_metrics_reporting_configuration_node_t *node = NULL;
+
+                                if (message->h.resource.component[3] && !message->h.resource.component[4]) {
+                                    node = msaf_metrics_reporting_configuration_find(provisioning_session, message->h.resource.component[3]);
+                                }
+                                if (node && _request_conditions_handled(stream, message, &headers, node->hash, NULL, node->received, 0,
+                                                                        api, app_meta)) {
+                                    /* 412 Precondition Failed sent */
+                                } else if (node && msaf_metrics_reporting_configuration_deregister(provisioning_session, message->h.resource.component[3])) {
+                                    ogs_sbi_response_t *response;
+                                    msaf_provisioning_session_journal_metrics_reporting_configuration(provisioning_session,
+                                                                            message->h.resource.component[3]);
+                                    response = nf_server_new_response(NULL, NULL,  0, NULL, 0, NULL, api, app_meta);
+                                    ogs_assert(response);
+                                    nf_server_populate_response(response, 0, NULL, 204);
+                                    ogs_assert(true == ogs_sbi_server_send_response(stream, response));
+                                } else {
+                                    char *err = NULL;
+                                    err = ogs_msprintf("Provisioning session [%s] has no metrics reporting configuration [%s].", message->h.resource.component[1], message->h.resource.component[3]?message->h.resource.component[3]:"");
+                                    ogs_error("%s", err);
+                                    ogs_assert(true == nf_server_send_error(stream, 404, 3, message, "Metrics reporting configuration does not exist.", err, NULL, api, app_meta));
+                                    ogs_free(err);
+                                }
                             }
                         } else if (message->h.resource.component[1] && !message->h.resource.component[2]) {
                             msaf_provisioning_session_t *provisioning_session;
@@ -1422,6 +1709,12 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
 
                                 ogs_assert(true == nf_server_send_error(stream, 404, 2, message, "Provisioning session does not exists.", err, NULL, m1_provisioningsession_api, app_meta));
                                 ogs_free(err);
+                            } else if (msaf_request_headers_has_conditions(&headers) &&
+                                       _request_conditions_handled(stream, message, &headers,
+                                                    msaf_provisioning_session_etag(provisioning_session), NULL,
+                                                    provisioning_session->httpMetadata.provisioningSession.received, 0,
+                                                    m1_provisioningsession_api, app_meta)) {
+                                /* 412 Precondition Failed sent */
                             } else {
                                 /* Delete provisioning session */
                                 ogs_sbi_response_t *response;
@@ -1436,6 +1729,7 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                 msaf_context_provisioning_session_free(provisioning_session);
                                 msaf_consumption_report_configuration_deregister(provisioning_session);
                                 msaf_provisioning_session_hash_remove(message->h.resource.component[1]);
+                                msaf_provisioning_session_journal_provisioning_session(message->h.resource.component[1]);
                             }
                         } else {
                             char *err = NULL;
@@ -1529,6 +1823,26 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                             nf_server_populate_response(response, 0, NULL, 204);
                                             ogs_assert(response);
                                             ogs_assert(true == ogs_sbi_server_send_response(stream, response));
+                                        } else if (!strcmp(message->h.resource.component[2],"metrics-reporting-configurations")) {
+                                            if (message->h.resource.component[3]) {
+                                                if (!msaf_metrics_reporting_configuration_find(provisioning_session, message->h.resource.component[3])) {
+                                                    char *err = NULL;
+                                                    err = ogs_msprintf("Metrics reporting configuration [%s] does not exist", message->h.resource.component[3]);
+                                                    ogs_error("%s", err);
+                                                    ogs_assert(true == nf_server_send_error(stream, 404, 3, message, "Metrics reporting configuration does not exist.", err, NULL, m1_metricsreportingprovisioning_api, app_meta));
+                                                    ogs_free(err);
+                                                    break;
+                                                }
+                                                methods = ogs_msprintf("%s, %s, %s, %s", OGS_SBI_HTTP_METHOD_GET, OGS_SBI_HTTP_METHOD_PUT,
+                                                                       OGS_SBI_HTTP_METHOD_DELETE, OGS_SBI_HTTP_METHOD_OPTIONS);
+                                            } else {
+                                                methods = ogs_msprintf("%s, %s", OGS_SBI_HTTP_METHOD_POST, OGS_SBI_HTTP_METHOD_OPTIONS);
+                                            }
+                                            response = nf_server_new_response(request->h.uri, NULL,  0, NULL, 0, methods,
+                                                                              m1_metricsreportingprovisioning_api, app_meta);
+                                            nf_server_populate_response(response, 0, NULL, 204);
+                                            ogs_assert(response);
+                                            ogs_assert(true == ogs_sbi_server_send_response(stream, response));
                                         } else if (!strcmp(message->h.resource.component[2],"protocols")) {
                                             methods = ogs_msprintf("%s, %s", OGS_SBI_HTTP_METHOD_GET, OGS_SBI_HTTP_METHOD_OPTIONS);
                                             response = nf_server_new_response(request->h.uri, NULL,  0, NULL, 0, methods, m1_contentprotocolsdiscovery_api, app_meta);
@@ -1642,28 +1956,214 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                 SWITCH(message->h.resource.component[0])
 
                     CASE("provisioning-sessions")
+                        if (message->h.resource.component[1]) {
+                            msaf_provisioning_session_t *provisioning_session;
+                            ogs_hash_index_t *hi;
+                            long int window = 0;
+                            cJSON *statistics;
+                            char *body;
+                            ogs_sbi_response_t *response;
+
+                            if (!message->h.resource.component[2] || strcmp(message->h.resource.component[2], "consumption-statistics") || message->h.resource.component[3]) {
+                                char *err;
+                                err = ogs_msprintf("Invalid resource for Provisioning Session [%s]", message->h.resource.component[1]);
+                                ogs_error("%s", err);
+                                ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_NOT_FOUND, 2, message, "Not Found", err, NULL, maf_management_api, app_meta));
+                                ogs_free(err);
+                                break;
+                            }
+
+                            if (strcmp(message->h.method, OGS_SBI_HTTP_METHOD_GET)) {
+                                ogs_error("Invalid HTTP method [%s]", message->h.method);
+                                ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_FORBIDDEN, 3, message, "Invalid HTTP method.", message->h.method, NULL, maf_management_api, app_meta));
+                                break;
+                            }
+
+                            provisioning_session = msaf_provisioning_session_find_by_provisioningSessionId(message->h.resource.component[1]);
+                            if (!provisioning_session) {
+                                char *err;
+                                err = ogs_msprintf("Provisioning Session [%s] does not exist.", message->h.resource.component[1]);
+                                ogs_error("%s", err);
+                                ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_NOT_FOUND, 2, message, "Provisioning session does not exist.", err, NULL, maf_management_api, app_meta));
+                                ogs_free(err);
+                                break;
+                            }
+
+                            /* optional ?window=<seconds>, defaults to the whole aggregation window */
+                            for (hi = ogs_hash_first(request->http.params); hi; hi = ogs_hash_next(hi)) {
+                                if (!strcmp(ogs_hash_this_key(hi), "window")) {
+                                    window = ascii_to_long(ogs_hash_this_val(hi));
+                                    break;
+                                }
+                            }
+                            if (hi && window <= 0) {
+                                const char *err = "The window parameter must be a positive number of seconds";
+                                ogs_error("%s", err);
+                                ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_BAD_REQUEST, 3, message, "Bad window parameter", err, NULL, maf_management_api, app_meta));
+                                break;
+                            }
+
+                            statistics = msaf_consumption_statistics_json(provisioning_session->consumption_statistics, ogs_get_monotonic_time(), window);
+                            body = msaf_json_print(statistics);
+                            cJSON_Delete(statistics);
+
+                            response = nf_server_new_response(NULL, "application/json", 0, NULL, 0, NULL, maf_management_api, app_meta);
+                            ogs_assert(response);
+                            nf_server_populate_response(response, strlen(body), body, 200);
+                            ogs_assert(true == ogs_sbi_server_send_response(stream, response));
+                            break;
+                        }
                         SWITCH(message->h.method)
                             CASE(OGS_SBI_HTTP_METHOD_GET)                               
                                 char *provisioning_sessions = NULL;
                                 ogs_sbi_response_t *response;
-                                provisioning_sessions = enumerate_provisioning_sessions();
-                                if(provisioning_sessions) {
-                                    response = nf_server_new_response(NULL, "application/json", 0, NULL, msaf_self()->config.server_response_cache_control->m1_provisioning_session_response_max_age, NULL, maf_management_api, app_meta);
-        
-                                    nf_server_populate_response(response, strlen(provisioning_sessions), provisioning_sessions, 200);
-                                    ogs_assert(response);
-                                    ogs_assert(true == ogs_sbi_server_send_response(stream, response));
+                                msaf_provisioning_session_list_filter_t filter = {NULL, NULL, NULL};
+                                ogs_hash_index_t *hi;
+                                uint64_t cursor = 0, next_cursor = 0;
+                                long int limit = 0;
+                                size_t length;
+                                const char *bad_param = NULL;
+
+                                /* optional ?limit=<n>&cursor=<cursor>&aspId=<aspId>&appId=<appId>&certificateId=<certificateId> */
+                                for (hi = ogs_hash_first(request->http.params); hi; hi = ogs_hash_next(hi)) {
+                                    const char *param = ogs_hash_this_key(hi);
+                                    const char *value = ogs_hash_this_val(hi);
+
+                                    if (!strcmp(param, "limit")) {
+                                        limit = ascii_to_long(value);
+                                        if (limit <= 0) bad_param = "The limit parameter must be a positive number";
+                                    } else if (!strcmp(param, "cursor")) {
+                                        if (!msaf_provisioning_session_list_cursor_parse(value, &cursor)) bad_param = "The cursor parameter is not valid";
+                                    } else if (!strcmp(param, "aspId")) {
+                                        filter.asp_id = value;
+                                    } else if (!strcmp(param, "appId")) {
+                                        filter.app_id = value;
+                                    } else if (!strcmp(param, "certificateId")) {
+                                        filter.certificate_id = value;
+                                    }
+                                }
+                                if (bad_param) {
+                                    ogs_error("%s", bad_param);
+                                    ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_BAD_REQUEST, 1, message, "Bad query parameter", bad_param, NULL, maf_management_api, app_meta));
                                     break;
-                                } else {
-                                    ogs_error("Internal Server Error.");                                          
-                                    ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_INTERNAL_SERVER_ERROR, 0, message, "Internal Server Error.", message->h.method, NULL, maf_management_api, app_meta)); 
                                 }
+
+                                provisioning_sessions = msaf_provisioning_session_list_render(&filter, cursor, limit, &length, &next_cursor);
+                                response = nf_server_new_response(NULL, "application/json", 0, NULL, msaf_self()->config.server_response_cache_control->m1_provisioning_session_response_max_age, NULL, maf_management_api, app_meta);
+                                ogs_assert(response);
+                                if (next_cursor) {
+                                    char *link = msaf_provisioning_session_list_next_link(&filter, limit, next_cursor);
+                                    ogs_sbi_header_set(response->http.headers, "Link", link);
+                                    ogs_free(link);
+                                }
+                                nf_server_populate_response(response, length, provisioning_sessions, 200);
+                                ogs_assert(true == ogs_sbi_server_send_response(stream, response));
+                                break;
+                            CASE(OGS_SBI_HTTP_METHOD_POST)
+                                cJSON *definitions;
+                                cJSON *results;
+                                char *body;
+                                ogs_sbi_response_t *response;
+                                int status = 0;
+
+                                if (!msaf_request_headers_content_type_is(&headers, "application/json")) {
+                                    const char *err = "Expected content type: application/json";
+                                    ogs_error("%s", err);
+                                    ogs_assert(true == nf_server_send_error(stream, 415, 1, message, "Unsupported Media Type.", err, NULL, maf_management_api, app_meta));
+                                    break;
+                                }
+
+                                definitions = request->http.content?cJSON_Parse(request->http.content):NULL;
+                                if (!cJSON_IsArray(definitions)) {
+                                    const char *err = "Request body must be an array of provisioning session definitions";
+                                    ogs_error("%s", err);
+                                    ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_BAD_REQUEST, 1, message, "Bad Request", err, NULL, maf_management_api, app_meta));
+                                    if (definitions) cJSON_Delete(definitions);
+                                    break;
+                                }
+
+                                results = msaf_bulk_provisioning_apply(definitions, &status);
+                                cJSON_Delete(definitions);
+                                body = msaf_json_print(results);
+                                cJSON_Delete(results);
+
+                                response = nf_server_new_response(NULL, "application/json", 0, NULL, 0, NULL, maf_management_api, app_meta);
+                                ogs_assert(response);
+                                nf_server_populate_response(response, strlen(body), body, status);
+                                ogs_assert(true == ogs_sbi_server_send_response(stream, response));
+                                break;
                             DEFAULT
                                 ogs_error("Invalid HTTP method [%s]", message->h.method);                                          
                                 ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_FORBIDDEN, 0, message, "Invalid HTTP method.", message->h.method, NULL, maf_management_api, app_meta));
                         END
                         break;
 
+                    CASE("changes")
+                        SWITCH(message->h.method)
+                            CASE(OGS_SBI_HTTP_METHOD_GET)
+                                ogs_hash_index_t *hi;
+                                const char *feed_id = NULL;
+                                const char *provisioning_session_id = NULL;
+                                uint64_t after = 0;
+                                bool have_after = false;
+                                long int wait = MSAF_CHANGE_FEED_DEFAULT_WAIT;
+                                const char *bad_param = NULL;
+
+                                /* optional ?after=<sequence>&feedId=<feedId>&provisioningSessionId=<id>&wait=<seconds> */
+                                for (hi = ogs_hash_first(request->http.params); hi; hi = ogs_hash_next(hi)) {
+                                    const char *param = ogs_hash_this_key(hi);
+                                    const char *value = ogs_hash_this_val(hi);
+
+                                    if (!strcmp(param, "after")) {
+                                        char *end = NULL;
+                                        after = strtoull(value, &end, 10);
+                                        if (!*value || *end || *value == '-') bad_param = "The after parameter must be a change sequence number";
+                                        have_after = true;
+                                    } else if (!strcmp(param, "feedId")) {
+                                        feed_id = value;
+                                    } else if (!strcmp(param, "provisioningSessionId")) {
+                                        provisioning_session_id = value;
+                                    } else if (!strcmp(param, "wait")) {
+                                        wait = ascii_to_long(value);
+                                        if (wait < 0 || wait > MSAF_CHANGE_FEED_MAX_WAIT) bad_param = "The wait parameter must be a number of seconds from 0 to 300";
+                                    }
+                                }
+                                if (bad_param) {
+                                    ogs_error("%s", bad_param);
+                                    ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_BAD_REQUEST, 1, message, "Bad query parameter", bad_param, NULL, maf_management_api, app_meta));
+                                    break;
+                                }
+
+                                msaf_change_feed_watch(stream, feed_id, have_after?&after:NULL, provisioning_session_id, (int)wait, maf_management_api, app_meta);
+                                break;
+                            DEFAULT
+                                ogs_error("Invalid HTTP method [%s]", message->h.method);
+                                ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_FORBIDDEN, 0, message, "Invalid HTTP method.", message->h.method, NULL, maf_management_api, app_meta));
+                        END
+                        break;
+
+                    CASE("statistics")
+                        SWITCH(message->h.method)
+                            CASE(OGS_SBI_HTTP_METHOD_GET)
+                                cJSON *statistics;
+                                char *body;
+                                ogs_sbi_response_t *response;
+
+                                statistics = msaf_statistics_json();
+                                body = msaf_json_print(statistics);
+                                cJSON_Delete(statistics);
+
+                                response = nf_server_new_response(NULL, "application/json", 0, NULL, 0, NULL, maf_management_api, app_meta);
+                                ogs_assert(response);
+                                nf_server_populate_response(response, strlen(body), body, 200);
+                                ogs_assert(true == ogs_sbi_server_send_response(stream, response));
+                                break;
+                            DEFAULT
+                                ogs_error("Invalid HTTP method [%s]", message->h.method);
+                                ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_FORBIDDEN, 0, message, "Invalid HTTP method.", message->h.method, NULL, maf_management_api, app_meta));
+                        END
+                        break;
+
                     DEFAULT
                         char *err = NULL;
                         err = ogs_msprintf("Invalid resource name [%s]", message->h.resource.component[0]);
@@ -2358,100 +2858,78 @@ void msaf_m1_state_functional(ogs_fsm_t *s, msaf_event_t *e)
     }
 }
 
-static void _policy_template_extra_validation(msaf_api_policy_template_t **policy_temp_ptr, const char **parse_err)
+static msaf_api_metrics_reporting_configuration_t *_metrics_reporting_configuration_from_request(ogs_sbi_request_t *request,
+                                                                                               const msaf_request_headers_t *headers,
+                                                                                               const char **parse_err)
 {
-    msaf_api_policy_template_t *policy_template = *policy_temp_ptr;
-
-    /* extra validation checks */
-    if (policy_template && policy_template->qo_s_specification &&
-            policy_template->qo_s_specification->max_auth_btr_dl) {
-        double bitrate;
-        bitrate = str_to_bitrate(policy_template->qo_s_specification->max_auth_btr_dl, parse_err);
-        if (isnan(bitrate)) {
-            msaf_api_policy_template_free(policy_template);
-            policy_template = NULL;
-            *policy_temp_ptr = NULL;
-        }
-    }
-    if (policy_template && policy_template->qo_s_specification &&
-            policy_template->qo_s_specification->max_auth_btr_ul) {
-        double bitrate;
-        bitrate = str_to_bitrate(policy_template->qo_s_specification->max_auth_btr_ul, parse_err);
-        if (isnan(bitrate)) {
-            msaf_api_policy_template_free(policy_template);
-            policy_template = NULL;
-            *policy_temp_ptr = NULL;
-        }
+    msaf_api_metrics_reporting_configuration_t *config;
+    cJSON *json;
+
+    if (!msaf_request_headers_content_type_is(headers, "application/json")) {
+        *parse_err = "Expected content type: application/json";
+        return NULL;
     }
-    if (policy_template && policy_template->application_session_context &&
-            policy_template->application_session_context->slice_info &&
-            policy_template->application_session_context->slice_info->sd &&
-            (strlen(policy_template->application_session_context->slice_info->sd) != 6 ||
-             strspn(policy_template->application_session_context->slice_info->sd,
-                 "0123456789ABCDEFabcdef") != 6
-            )) {
-        *parse_err = "S-NSSAI SD value must be 6 hexadecimal digits";
-        msaf_api_policy_template_free(policy_template);
-        policy_template = NULL;
-        *policy_temp_ptr = NULL;
+
+    if (!request->http.content) {
+        *parse_err = "Request has no content";
+        return NULL;
     }
-    if (policy_template && policy_template->charging_specification &&
-            policy_template->charging_specification->gpsi) {
-        OpenAPI_lnode_t *node = NULL;
-        OpenAPI_list_for_each(policy_template->charging_specification->gpsi, node) {
-            const char *s = (const char*)node->data;
-            if (!strncmp(s, "msisdn-", 7) && (strlen(s) < 12 || strlen(s) > 22 ||
-                        strspn(s+7, "0123456789") != strlen(s+7))) {
-                *parse_err = "GPSI MSISDN must have between 5 and 15 decimal digits";
-                msaf_api_policy_template_free(policy_template);
-                policy_template = NULL;
-                *policy_temp_ptr = NULL;
-                break;
-            }
-            if (!strncmp(s, "extid-", 6)) {
-                char *at = strchr(s+6, '@');
-                if (!at || at == s+6 || at[1] == '\0' || strchr(at+1, '@') != NULL) {
-                    *parse_err = "GPSI EXTID must be of the form <a>@<b>, where <a> & <b> may not contain the @ symbol";
-                    msaf_api_policy_template_free(policy_template);
-                    policy_template = NULL;
-                    *policy_temp_ptr = NULL;
-                    break;
-                }
-            }
-            if (strlen(s) == 0) {
-                *parse_err = "GPSI cannot be an empty string";
-                msaf_api_policy_template_free(policy_template);
-                policy_template = NULL;
-                *policy_temp_ptr = NULL;
-                break;
-            }
-        }
+
+    json = cJSON_Parse(request->http.content);
+    if (!json) {
+        *parse_err = "Request body is not valid JSON";
+        return NULL;
     }
+
+    config = msaf_metrics_reporting_configuration_parseJSON(json, parse_err);
+    cJSON_Delete(json);
+
+    return config;
 }
 
-static void _policy_template_remove_read_only(msaf_api_policy_template_t *policy_temp)
+/* Evaluate the conditional request headers against the current etag and last_modified of the target resource (etag is
+ * NULL if the resource does not exist) and send the 304 or 412 response if the request should go no further. response_etag
+ * is the ETag for a 304 response if it differs from etag, e.g. for a gzip variant. Returns true if a response was sent.
+ */
+static bool _request_conditions_handled(ogs_sbi_stream_t *stream, ogs_sbi_message_t *message,
+                                       const msaf_request_headers_t *headers, const char *etag, const char *response_etag,
+                                       time_t last_modified, int max_age, const nf_server_interface_metadata_t *api,
+                                       const nf_server_app_metadata_t *app_meta)
 {
-    if (!policy_temp) return;
-    /* validation passed, remove read-only fields if present */
-    if (policy_temp->policy_template_id) {
-        ogs_free(policy_temp->policy_template_id);
-        policy_temp->policy_template_id = NULL;
-    }
-    if (policy_temp->state != msaf_api_policy_template_STATE_NULL) {
-        policy_temp->state = msaf_api_policy_template_STATE_NULL;
-    }
-    if (policy_temp->state_reason) {
-        msaf_api_problem_details_free(policy_temp->state_reason);
-        policy_temp->state_reason = NULL;
-    }
-    if (policy_temp->qo_s_specification && policy_temp->qo_s_specification->max_btr_dl) {
-        ogs_free(policy_temp->qo_s_specification->max_btr_dl);
-        policy_temp->qo_s_specification->max_btr_dl = NULL;
+    msaf_request_condition_t condition;
+    bool safe;
+
+    safe = !strcmp(message->h.method, OGS_SBI_HTTP_METHOD_GET);
+    condition = msaf_request_headers_conditions(headers, safe, etag, last_modified);
+
+    if (condition == MSAF_REQUEST_CONDITION_NOT_MODIFIED) {
+        ogs_sbi_response_t *response;
+
+        response = nf_server_new_response(NULL, NULL, last_modified, (char*)(response_etag?response_etag:etag), max_age, NULL,
+                                          api, app_meta);
+        ogs_assert(response);
+        nf_server_populate_response(response, 0, NULL, 304);
+        ogs_assert(true == ogs_sbi_server_send_response(stream, response));
+        return true;
     }
-    if (policy_temp->qo_s_specification && policy_temp->qo_s_specification->max_btr_ul) {
-        ogs_free(policy_temp->qo_s_specification->max_btr_ul);
-        policy_temp->qo_s_specification->max_btr_ul = NULL;
+
+    if (condition == MSAF_REQUEST_CONDITION_FAILED) {
+        int number_of_components = 0;
+        char *err;
+
+        while (number_of_components < OGS_SBI_MAX_NUM_OF_RESOURCE_COMPONENT - 1 &&
+               message->h.resource.component[number_of_components + 1]) number_of_components++;
+
+        err = ogs_msprintf("The %s request is not applicable to the current state of the resource [%s].", message->h.method,
+                           etag?etag:"none");
+        ogs_error("%s", err);
+        ogs_assert(true == nf_server_send_error(stream, 412, number_of_components, message, "Precondition Failed.", err, NULL,
+                                                api, app_meta));
+        ogs_free(err);
+        return true;
     }
+
+    return false;
 }
 
 /* vim:ts=8:sts=4:sw=4:expandtab:
@@ -15,6 +15,12 @@
 #include "data-collection.h"
 #include "server.h"
 #include "sai-cache.h"
+#include "content-encoding.h"
+#include "consumption-report-validator.h"
+#include "consumption-statistics.h"
+#include "metrics-report.h"
+#include "rate-limit.h"
+#include "request-headers.h"
 #include "response-cache-control.h"
 #include "msaf-version.h"
 #include "msaf-sm.h"
@@ -23,9 +29,13 @@
 #include "dynamic-policy.h"
 #include "utilities.h"
 #include "hash.h"
+#include "json-format.h"
+#include "json-reader.h"
+#include "model-arena.h"
 #include "timer.h"
 #include "openapi/api/TS26512_M5_ServiceAccessInformationAPI-info.h"
 #include "openapi/api/TS26512_M5_ConsumptionReportingAPI-info.h"
+#include "openapi/api/TS26512_M5_MetricsReportingAPI-info.h"
 #include "openapi/api/TS26512_M5_NetworkAssistanceAPI-info.h"
 #include "openapi/model/msaf_api_consumption_report.h"
 #include "openapi/api/TS26512_M5_DynamicPoliciesAPI-info.h"
@@ -45,6 +55,12 @@ m5_consumptionreporting_api_metadata = {
     M5_CONSUMPTIONREPORTING_API_VERSION
 };
 
+static const nf_server_interface_metadata_t
+m5_metricsreporting_api_metadata = {
+    M5_METRICSREPORTING_API_NAME,
+    M5_METRICSREPORTING_API_VERSION
+};
+
 static const nf_server_interface_metadata_t
 m5_networkassistance_api_metadata = {
     M5_NETWORKASSISTANCE_API_NAME,
@@ -58,8 +74,19 @@ m5_dynamicpolicy_api_metadata = {
 };
 
 
+/* SAI Cache-Control and Server header values, rendered on first use */
+static nf_server_prerendered_headers_t *sai_response_headers = NULL;
+
+static void consumption_report_summary_from_model(msaf_consumption_report_summary_t *summary,
+                                                  const msaf_api_consumption_report_t *consumption_report);
+
+static const char *_rate_limit_session_id(const char *provisioning_session_id);
+static bool _rate_limit_admit(const msaf_request_headers_t *headers, ogs_sbi_stream_t *stream, ogs_sbi_message_t *message,
+                              const nf_server_app_metadata_t *app_meta);
+
 static bool 
-is_dynamic_policy_create_request_valid(ogs_sbi_request_t *request, ogs_sbi_stream_t *stream, ogs_sbi_message_t *message,
+is_dynamic_policy_create_request_valid(ogs_sbi_request_t *request, const msaf_request_headers_t *headers,
+                                       ogs_sbi_stream_t *stream, ogs_sbi_message_t *message,
                                        const nf_server_interface_metadata_t *m5_dynamicpolicy_api,
                                        const nf_server_app_metadata_t *app_meta);
 
@@ -77,6 +104,9 @@ void msaf_m5_state_final(ogs_fsm_t *s, msaf_event_t *e)
     msaf_sm_debug(e);
 
     ogs_assert(s);
+
+    nf_server_prerendered_headers_free(sai_response_headers);
+    sai_response_headers = NULL;
 }
 
 void msaf_m5_state_functional(ogs_fsm_t *s, msaf_event_t *e)
@@ -84,6 +114,7 @@ void msaf_m5_state_functional(ogs_fsm_t *s, msaf_event_t *e)
     ogs_sbi_stream_t *stream = NULL;
     ogs_sbi_request_t *request = NULL;
     ogs_sbi_message_t *message = NULL;
+    msaf_request_headers_t headers;
     msaf_event_t *nw_assist_event = NULL;
     msaf_event_t *dynamic_policy_event = NULL;
 
@@ -91,6 +122,7 @@ void msaf_m5_state_functional(ogs_fsm_t *s, msaf_event_t *e)
 
     static const nf_server_interface_metadata_t *m5_serviceaccessinformation_api = &m5_serviceaccessinformation_api_metadata;
     static const nf_server_interface_metadata_t *m5_consumptionreporting_api = &m5_consumptionreporting_api_metadata;
+    static const nf_server_interface_metadata_t *m5_metricsreporting_api = &m5_metricsreporting_api_metadata;
     static const nf_server_interface_metadata_t *m5_networkassistance_api = &m5_networkassistance_api_metadata;
     static const nf_server_interface_metadata_t *m5_dynamicpolicy_api = &m5_dynamicpolicy_api_metadata;
     const nf_server_app_metadata_t *app_meta = msaf_app_metadata();
@@ -132,6 +164,7 @@ void msaf_m5_state_functional(ogs_fsm_t *s, msaf_event_t *e)
             stream = e->h.sbi.data;
             ogs_assert(stream);
             message = e->message;
+            msaf_request_headers_index(&headers, request->http.headers);
 
             SWITCH(message->h.service.name)         
             CASE("3gpp-m5")
@@ -143,6 +176,11 @@ void msaf_m5_state_functional(ogs_fsm_t *s, msaf_event_t *e)
 
                     break;
                 }
+                /* refuse requests from busy clients before any body parsing */
+                if (!strcmp(message->h.method, OGS_SBI_HTTP_METHOD_POST) &&
+                        !_rate_limit_admit(&headers, stream, message, app_meta)) {
+                    break;
+                }
                 SWITCH(message->h.resource.component[0])
 		CASE("dynamic-policies")
                     SWITCH(message->h.method)
@@ -193,8 +231,7 @@ void msaf_m5_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                 return;
 			    }
 
-			    body = cJSON_Print(dynamic_policy);
-                            hash= calculate_hash(body);
+                            body = msaf_json_print_with_hash(dynamic_policy, NULL, &hash);
 			    msaf_dynamic_policy = msaf_dynamic_policy_find_by_dynamicPolicyId((const char *)message->h.resource.component[1]);
 
                             response = nf_server_new_response(request->h.uri, "application/json",
@@ -217,7 +254,7 @@ void msaf_m5_state_functional(ogs_fsm_t *s, msaf_event_t *e)
 		        {
                             cJSON *dynamic_policy;
 
-                            if (!is_dynamic_policy_create_request_valid (request, stream, message, m5_dynamicpolicy_api, app_meta)) return;
+                            if (!is_dynamic_policy_create_request_valid(request, &headers, stream, message, m5_dynamicpolicy_api, app_meta)) return;
 
                             ogs_debug("Request body: %s", request->http.content);
 
@@ -245,7 +282,7 @@ void msaf_m5_state_functional(ogs_fsm_t *s, msaf_event_t *e)
 			    cJSON *dynamic_policy_received;
 			    const char *reason;
 
-                            if(!check_http_content_type(request->http,"application/json")){
+                            if(!msaf_request_headers_content_type_is(&headers, "application/json")){
                                 ogs_assert(true == nf_server_send_error(stream, 415, 1, message, "Unsupported Media Type.", "Expected content type: application/json", NULL, m5_dynamicpolicy_api, app_meta));
                                 ogs_sbi_message_free(message);
                                 ogs_free(message);
@@ -310,8 +347,7 @@ void msaf_m5_state_functional(ogs_fsm_t *s, msaf_event_t *e)
 
 				dyn_policy = msaf_api_dynamic_policy_convertResponseToJSON((const msaf_api_dynamic_policy_t *)msaf_dynamic_policy->DynamicPolicy);
 
-                                body = cJSON_Print(dyn_policy);
-                                hash= calculate_hash(body);
+                                body = msaf_json_print_with_hash(dyn_policy, NULL, &hash);
 
                                 response = nf_server_new_response(request->h.uri, "application/json",
                                                             msaf_dynamic_policy->dynamic_policy_created, hash,
@@ -418,8 +454,7 @@ void msaf_m5_state_functional(ogs_fsm_t *s, msaf_event_t *e)
 		                char *body;
 				char *hash;
 
-				body = cJSON_Print(network_assistance_sess);
-			       	hash= calculate_hash(body);
+			       	body = msaf_json_print_with_hash(network_assistance_sess, NULL, &hash);
 
 				na_sess = msaf_network_assistance_session_retrieve((const char *)message->h.resource.component[1]);
 
@@ -461,7 +496,7 @@ void msaf_m5_state_functional(ogs_fsm_t *s, msaf_event_t *e)
 			    cJSON *network_assistance_sess;
 			    msaf_api_network_assistance_session_t *nas;
 
-                            if(!check_http_content_type(request->http,"application/json")){
+                            if(!msaf_request_headers_content_type_is(&headers, "application/json")){
                                 ogs_assert(true == nf_server_send_error(stream, 415, 3, message, "Unsupported Media Type.", "Expected content type: application/json", NULL, m5_networkassistance_api, app_meta));
                                 ogs_sbi_message_free(message);
                                 ogs_free(message);
@@ -509,8 +544,7 @@ void msaf_m5_state_functional(ogs_fsm_t *s, msaf_event_t *e)
 
 				nw_assist_session = msaf_api_network_assistance_session_convertResponseToJSON((const msaf_api_network_assistance_session_t *)na_sess->NetworkAssistanceSession);
 
-                                body = cJSON_Print(nw_assist_session);
-                                hash = calculate_hash(body);
+                                body = msaf_json_print_with_hash(nw_assist_session, NULL, &hash);
 
                                 response = nf_server_new_response(request->h.uri, "application/json",
                                                             na_sess->na_sess_created, hash,
@@ -558,7 +592,7 @@ void msaf_m5_state_functional(ogs_fsm_t *s, msaf_event_t *e)
 				
 				operation_success_response = msaf_api_operation_success_response_create(reason, 0);
 				op_success_response = msaf_api_operation_success_response_convertResponseToJSON(operation_success_response);
-				success_response = cJSON_Print(op_success_response);
+				success_response = msaf_json_print(op_success_response);
 
 				response = nf_server_new_response(NULL, "application/json", 0, NULL, 0, NULL, m5_networkassistance_api, app_meta);
                                 ogs_assert(response);
@@ -584,7 +618,7 @@ void msaf_m5_state_functional(ogs_fsm_t *s, msaf_event_t *e)
 			    cJSON *requested_qos = NULL;
 			    cJSON *provisioning_session_id = NULL;
 
-	        	    if(!check_http_content_type(request->http,"application/json")){
+	        	    if(!msaf_request_headers_content_type_is(&headers, "application/json")){
 			        ogs_assert(true == nf_server_send_error(stream, 415, 3, message, "Unsupported Media Type.", "Expected content type: application/json", NULL, m5_networkassistance_api, app_meta));
                                 ogs_sbi_message_free(message);
                                 ogs_free(message);
@@ -674,12 +708,19 @@ void msaf_m5_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                     SWITCH(message->h.method)
                     CASE(OGS_SBI_HTTP_METHOD_GET)
                         const msaf_sai_cache_entry_t *sai_entry;
+                        msaf_sai_retrieve_result_t sai_result;
 
                         sai_entry = msaf_context_retrieve_service_access_information(message->h.resource.component[1],
                                             strncmp(request->h.uri,"https:",6)==0,
-                                            ogs_hash_get(request->http.headers, "Host", OGS_HASH_KEY_STRING));
+                                            msaf_request_headers_host(&headers), &sai_result);
 
-                        if (!sai_entry) {
+                        if (sai_result == MSAF_SAI_RETRIEVE_BAD_AUTHORITY) {
+                            char *err = NULL;
+                            err = ogs_msprintf("Invalid Host header in request for Provisioning Session [%s].", message->h.resource.component[1]);
+                            ogs_error("%s", err);
+                            ogs_assert(true == nf_server_send_error(stream, 400, 1, message, "Invalid Host header.", err, NULL, m5_serviceaccessinformation_api, app_meta));
+                            ogs_free(err);
+                        } else if (!sai_entry) {
                             char *err = NULL;
                             err = ogs_msprintf("Provisioning Session [%s] not found.", message->h.resource.component[1]);
                             ogs_error("%s", err);
@@ -689,26 +730,38 @@ void msaf_m5_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                             const char *if_none_match;
                             const char *if_modified_since;
                             int response_code = 200;
-                            const char *response_body = sai_entry->sai_body;
+                            msaf_sai_cache_entry_t *entry = msaf_sai_cache_entry_ref(sai_entry);
+                            const char *response_body = entry->sai_body;
+                            size_t response_body_len = entry->sai_body_len;
+                            const char *etag = entry->hash;
+                            const char *content_encoding = NULL;
+
+                            /* the gzip variant was compressed when the entry was cached */
+                            if (entry->gzip.body && msaf_content_encoding_select(msaf_request_headers_get(&headers, MSAF_REQUEST_HEADER_ACCEPT_ENCODING)) == MSAF_CONTENT_ENCODING_GZIP) {
+                                response_body = entry->gzip.body;
+                                response_body_len = entry->gzip.length;
+                                etag = entry->gzip.etag;
+                                content_encoding = msaf_content_encoding_name(MSAF_CONTENT_ENCODING_GZIP);
+                            }
 
-                            if_none_match = ogs_hash_get(request->http.headers, "If-None-Match", OGS_HASH_KEY_STRING);
+                            if_none_match = msaf_request_headers_get(&headers, MSAF_REQUEST_HEADER_IF_NONE_MATCH);
                             if (if_none_match) {
-                                if (strcmp(sai_entry->hash, if_none_match)==0) {
+                                if (strcmp(etag, if_none_match)==0) {
                                     /* ETag hasn't changed */
                                     response_code = 304;
                                     response_body = NULL;
                                 }
                             }
 
-                            if_modified_since = ogs_hash_get(request->http.headers, "If-Modified-Since", OGS_HASH_KEY_STRING);
+                            if_modified_since = msaf_request_headers_get(&headers, MSAF_REQUEST_HEADER_IF_MODIFIED_SINCE);
                             if (if_modified_since) {
                                 struct tm tm = {0};
                                 ogs_time_t modified_since;
                                 ogs_strptime(if_modified_since, "%a, %d %b %Y %H:%M:%S GMT", &tm);
                                 ogs_debug("IMS: sec=%i, min=%i, hour=%i, mday=%i, mon=%i, year=%i, gmtoff=%li", tm.tm_sec, tm.tm_min, tm.tm_hour, tm.tm_mday, tm.tm_mon, tm.tm_year, tm.tm_gmtoff);
                                 ogs_time_from_gmt(&modified_since, &tm, 0);
-                                ogs_debug("If-Modified-Since: %li < %li?", modified_since, sai_entry->generated);
-                                if (modified_since >= sai_entry->generated) {
+                                ogs_debug("If-Modified-Since: %li < %li?", modified_since, entry->generated);
+                                if (modified_since >= entry->generated) {
                                     /* Not modified since the time given */
                                     response_code = 304;
                                     response_body = NULL;
@@ -716,10 +769,16 @@ void msaf_m5_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                             }
 
                             ogs_sbi_response_t *response;
-                            response = nf_server_new_response(NULL, "application/json", ogs_time_sec(sai_entry->generated)+1, sai_entry->hash, msaf_self()->config.server_response_cache_control->m5_service_access_information_response_max_age, NULL, m5_serviceaccessinformation_api, app_meta);
+                            if (!sai_response_headers) {
+                                sai_response_headers = nf_server_prerendered_headers_new(msaf_self()->config.server_response_cache_control->m5_service_access_information_response_max_age, m5_serviceaccessinformation_api, app_meta);
+                            }
+                            response = nf_server_new_prerendered_response(sai_response_headers, "application/json", entry->last_modified, etag);
                             ogs_assert(response);
-                            nf_server_populate_response(response, response_body?strlen(response_body):0, ogs_strdup(response_body), response_code);
+                            nf_server_set_content_encoding(response, content_encoding);
+                            /* the SBI server takes ownership of the body, so this is the only copy made */
+                            nf_server_populate_response(response, response_body?response_body_len:0, response_body?ogs_memdup(response_body, response_body_len+1):NULL, response_code);
                             ogs_assert(true == ogs_sbi_server_send_response(stream, response));
+                            msaf_sai_cache_entry_free(entry);
                         }
                         break;
                     CASE(OGS_SBI_HTTP_METHOD_OPTIONS)
@@ -754,77 +813,104 @@ void msaf_m5_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                                     ogs_error("%s", err);
                                     ogs_assert(true==nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_NOT_FOUND, 1, message, "Not found", err, NULL, m5_consumptionreporting_api, app_meta));
                                     ogs_free(err);
-                                } else {
-                                    const char *content_type = "application/octet-stream";
-                                    ogs_hash_index_t *hi;
-
-                                    /* Find Content-Type header value */
-                                    for (hi = ogs_hash_first(request->http.headers); hi; hi = ogs_hash_next(hi)) {
-                                        if (!ogs_strcasecmp(ogs_hash_this_key(hi), OGS_SBI_CONTENT_TYPE)) {
-                                            content_type = ogs_hash_this_val(hi);
-                                            break;
+                                } else if (msaf_request_headers_content_type_is(&headers, "application/json")) {
+                                    const char *reason = NULL;
+                                    msaf_consumption_report_summary_t summary;
+                                    bool valid;
+                                    bool well_formed = false;
+
+                                    /* Check the common report shape directly from the request body, only parsing
+                                     * the full model when that fails so that we can report the reason.
+                                     */
+                                    memset(&summary, 0, sizeof(summary));
+                                    valid = request->http.content &&
+                                            msaf_consumption_report_validate(request->http.content, request->http.content_length,
+                                                                             &summary);
+                                    if (!valid && request->http.content) {
+                                        msaf_api_consumption_report_t *consumption_report;
+                                        msaf_json_reader_t reader;
+                                        msaf_model_arena_t *arena;
+
+                                        /* the report is only needed until the summary has been filled in */
+                                        arena = msaf_model_arena_new(0);
+                                        msaf_model_arena_enter(arena);
+                                        msaf_json_reader_init(&reader, request->http.content, request->http.content_length);
+                                        msaf_json_reader_next(&reader);
+                                        consumption_report = msaf_api_consumption_report_parseRequestFromJSONReader(&reader, &reason);
+                                        msaf_model_arena_leave(arena);
+                                        if (consumption_report && msaf_json_reader_next(&reader) != MSAF_JSON_TOKEN_END) {
+                                            consumption_report = NULL;
+                                            reason = "Unexpected data after the ConsumptionReport";
                                         }
+                                        well_formed = !reader.error;
+                                        if (consumption_report) {
+                                            consumption_report_summary_from_model(&summary, consumption_report);
+                                            valid = true;
+                                        }
+                                        msaf_model_arena_free(arena);
                                     }
-                                    SWITCH(content_type)
-                                    CASE("application/json")
-                                        cJSON *json;
-
-                                        json = cJSON_Parse(request->http.content);
-                                        if (json) {
-                                            msaf_api_consumption_report_t *consumption_report;
-                                            const char *reason;
-
-                                            consumption_report = msaf_api_consumption_report_parseRequestFromJSON(json, &reason);
-                                            if (consumption_report) {
-                                                struct timespec ts;
-                                                char buf[32];
-                                                char *filetime = NULL;
-                                                clock_gettime(CLOCK_REALTIME, &ts);
-                                                strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", gmtime(&ts.tv_sec));
-                                                filetime = ogs_msprintf("%s.%.6iZ", buf, (int)(ts.tv_nsec/1000));
-                                                if (msaf_data_collection_store(message->h.resource.component[1], "consumption_reports",
-                                                                    consumption_report->reporting_client_id, NULL, filetime,
-                                                                    "json", request->http.content)) {
-                                                    ogs_sbi_response_t *response;
-                                                    response = nf_server_new_response(request->h.uri, NULL,  0, NULL, 0, NULL, m5_consumptionreporting_api, app_meta);
-                                                    ogs_assert(response);
-                                                    nf_server_populate_response(response, 0, NULL, 204);
-                                                    ogs_assert(true == ogs_sbi_server_send_response(stream, response));
-                                                } else {
-                                                    char *err;
-
-                                                    err = ogs_msprintf("Failed to store Consumption Report for provisioning session [%s]", message->h.resource.component[1]);
-                                                    ogs_error("%s", err);
-                                                    ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_INTERNAL_SERVER_ERROR, 1, message, "Data storage error", err, NULL, m5_consumptionreporting_api, app_meta));
-                                                    ogs_free(err);
-                                                }
-                                                ogs_free(filetime);
-                                                msaf_api_consumption_report_free(consumption_report);
-                                            } else {
-                                                char *err;
-
-                                                err = ogs_msprintf("Badly formed ConsumptionReport posted for provisioning session [%s]: %s", message->h.resource.component[1], reason);
-                                                ogs_error("%s", err);
-                                                ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_BAD_REQUEST, 1, message, "Malformed request body", err, NULL, m5_consumptionreporting_api, app_meta));
-                                                ogs_free(err);
-                                            }
-                                            cJSON_Delete(json);
+
+                                    if (valid) {
+                                        struct timespec ts;
+                                        char buf[32];
+                                        char *filetime = NULL;
+                                        msaf_data_collection_result_t stored;
+
+                                        clock_gettime(CLOCK_REALTIME, &ts);
+                                        strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", gmtime(&ts.tv_sec));
+                                        filetime = ogs_msprintf("%s.%.6iZ", buf, (int)(ts.tv_nsec/1000));
+                                        stored = msaf_data_collection_store(message->h.resource.component[1], "consumption_reports",
+                                                            summary.reporting_client_id, NULL, filetime,
+                                                            "json", request->http.content);
+                                        if (stored == MSAF_DATA_COLLECTION_STORED) {
+                                            ogs_sbi_response_t *response;
+
+                                            if (!provisioning_session->consumption_statistics)
+                                                provisioning_session->consumption_statistics = msaf_consumption_statistics_new();
+                                            msaf_consumption_statistics_add(provisioning_session->consumption_statistics, &summary,
+                                                                            ogs_get_monotonic_time());
+
+                                            response = nf_server_new_response(request->h.uri, NULL,  0, NULL, 0, NULL, m5_consumptionreporting_api, app_meta);
+                                            ogs_assert(response);
+                                            nf_server_populate_response(response, 0, NULL, 204);
+                                            ogs_assert(true == ogs_sbi_server_send_response(stream, response));
+                                        } else if (stored == MSAF_DATA_COLLECTION_BUSY) {
+                                            char *err;
+
+                                            err = ogs_msprintf("Too many Consumption Reports waiting to be stored, retry the report for provisioning session [%s] later", message->h.resource.component[1]);
+                                            ogs_assert(true == nf_server_send_error_retry_after(stream, OGS_SBI_HTTP_STATUS_SERVICE_UNAVAILABLE, msaf_self()->config.data_collection.retry_after, 1, message, "Data storage busy", err, NULL, m5_consumptionreporting_api, app_meta));
+                                            ogs_free(err);
                                         } else {
                                             char *err;
 
-                                            err = ogs_msprintf("Badly formed request body when posting a consumption report for provisioning session [%s]", message->h.resource.component[1]);
+                                            err = ogs_msprintf("Failed to store Consumption Report for provisioning session [%s]", message->h.resource.component[1]);
                                             ogs_error("%s", err);
-                                            ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_BAD_REQUEST, 1, message, "Malformed request body", err, NULL, m5_consumptionreporting_api, app_meta));
+                                            ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_INTERNAL_SERVER_ERROR, 1, message, "Data storage error", err, NULL, m5_consumptionreporting_api, app_meta));
                                             ogs_free(err);
                                         }
-                                        break;
-                                    DEFAULT
+                                        ogs_free(filetime);
+                                        msaf_consumption_report_summary_clear(&summary);
+                                    } else if (well_formed) {
                                         char *err;
-                                        err = ogs_msprintf("Unrecognised content type for Consumption Report for Provisioning Session [%s]", message->h.resource.component[1]);
+
+                                        err = ogs_msprintf("Badly formed ConsumptionReport posted for provisioning session [%s]: %s", message->h.resource.component[1], reason);
+                                        ogs_error("%s", err);
+                                        ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_BAD_REQUEST, 1, message, "Malformed request body", err, NULL, m5_consumptionreporting_api, app_meta));
+                                        ogs_free(err);
+                                    } else {
+                                        char *err;
+
+                                        err = ogs_msprintf("Badly formed request body when posting a consumption report for provisioning session [%s]", message->h.resource.component[1]);
                                         ogs_error("%s", err);
-                                        ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_UNSUPPORTED_MEDIA_TYPE, 1, message, "Malformed request body", err, NULL, m5_consumptionreporting_api, app_meta));
+                                        ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_BAD_REQUEST, 1, message, "Malformed request body", err, NULL, m5_consumptionreporting_api, app_meta));
                                         ogs_free(err);
-                                    END
+                                    }
+                                } else {
+                                    char *err;
+                                    err = ogs_msprintf("Unrecognised content type for Consumption Report for Provisioning Session [%s]", message->h.resource.component[1]);
+                                    ogs_error("%s", err);
+                                    ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_UNSUPPORTED_MEDIA_TYPE, 1, message, "Malformed request body", err, NULL, m5_consumptionreporting_api, app_meta));
+                                    ogs_free(err);
                                 }
                             } else {
                                 char *err;
@@ -867,6 +953,122 @@ void msaf_m5_state_functional(ogs_fsm_t *s, msaf_event_t *e)
                         ogs_free(err);
                     END
                     break;
+                CASE("metrics-reporting")
+                    SWITCH(message->h.method)
+                    CASE(OGS_SBI_HTTP_METHOD_POST)
+                        if (message->h.resource.component[1] && message->h.resource.component[2] &&
+                                !message->h.resource.component[3]) {
+                            msaf_provisioning_session_t *provisioning_session;
+                            msaf_metrics_reporting_configuration_node_t *config_node = NULL;
+                            char *client_id = NULL;
+                            char *session_id = NULL;
+
+                            provisioning_session = msaf_provisioning_session_find_by_provisioningSessionId(message->h.resource.component[1]);
+                            if (provisioning_session) {
+                                config_node = msaf_metrics_reporting_configuration_find(provisioning_session,
+                                                                                        message->h.resource.component[2]);
+                            }
+
+                            if (!config_node) {
+                                char *err;
+
+                                err = ogs_msprintf("No MetricsReportingConfiguration [%s] for Provisioning Session [%s], cannot accept reports", message->h.resource.component[2], message->h.resource.component[1]);
+                                ogs_error("%s", err);
+                                ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_NOT_FOUND, 2, message, "Not Found", err, NULL, m5_metricsreporting_api, app_meta));
+                                ogs_free(err);
+                                msaf_metrics_report_count(NULL, false);
+                            } else if (!msaf_request_headers_content_type_is(&headers, "application/xml")) {
+                                char *err;
+
+                                err = ogs_msprintf("Unrecognised content type for Metrics Report for Provisioning Session [%s]", message->h.resource.component[1]);
+                                ogs_error("%s", err);
+                                ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_UNSUPPORTED_MEDIA_TYPE, 2, message, "Unsupported Media Type", err, NULL, m5_metricsreporting_api, app_meta));
+                                ogs_free(err);
+                                msaf_metrics_report_count(config_node, false);
+                            } else if (!request->http.content ||
+                                       !msaf_metrics_report_identify(request->http.content, request->http.content_length,
+                                                                     &client_id, &session_id)) {
+                                char *err;
+
+                                err = ogs_msprintf("Badly formed Metrics Report posted for provisioning session [%s]: no clientID", message->h.resource.component[1]);
+                                ogs_error("%s", err);
+                                ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_BAD_REQUEST, 2, message, "Malformed request body", err, NULL, m5_metricsreporting_api, app_meta));
+                                ogs_free(err);
+                                msaf_metrics_report_count(config_node, false);
+                            } else {
+                                struct timespec ts;
+                                char buf[32];
+                                char *filetime;
+                                char *report_class;
+                                msaf_data_collection_result_t stored;
+
+                                clock_gettime(CLOCK_REALTIME, &ts);
+                                strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", gmtime(&ts.tv_sec));
+                                filetime = ogs_msprintf("%s.%.6iZ", buf, (int)(ts.tv_nsec/1000));
+                                report_class = ogs_msprintf("metrics_report_%s", message->h.resource.component[2]);
+
+                                /* metrics reports can arrive much more often than consumption reports, always append them to
+                                 * segments rather than creating a file per report */
+                                stored = msaf_data_collection_append(message->h.resource.component[1], report_class, client_id,
+                                                                     session_id, filetime, "xml", request->http.content);
+                                if (stored == MSAF_DATA_COLLECTION_STORED) {
+                                    ogs_sbi_response_t *response;
+
+                                    response = nf_server_new_response(request->h.uri, NULL,  0, NULL, 0, NULL, m5_metricsreporting_api, app_meta);
+                                    ogs_assert(response);
+                                    nf_server_populate_response(response, 0, NULL, 204);
+                                    ogs_assert(true == ogs_sbi_server_send_response(stream, response));
+                                } else if (stored == MSAF_DATA_COLLECTION_BUSY) {
+                                    char *err;
+
+                                    err = ogs_msprintf("Too many Metrics Reports waiting to be stored, retry the report for provisioning session [%s] later", message->h.resource.component[1]);
+                                    ogs_assert(true == nf_server_send_error_retry_after(stream, OGS_SBI_HTTP_STATUS_SERVICE_UNAVAILABLE, msaf_self()->config.data_collection.retry_after, 2, message, "Data storage busy", err, NULL, m5_metricsreporting_api, app_meta));
+                                    ogs_free(err);
+                                } else {
+                                    char *err;
+
+                                    err = ogs_msprintf("Failed to store Metrics Report for provisioning session [%s]", message->h.resource.component[1]);
+                                    ogs_error("%s", err);
+                                    ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_INTERNAL_SERVER_ERROR, 2, message, "Data storage error", err, NULL, m5_metricsreporting_api, app_meta));
+                                    ogs_free(err);
+                                }
+                                msaf_metrics_report_count(config_node, stored == MSAF_DATA_COLLECTION_STORED);
+                                ogs_free(report_class);
+                                ogs_free(filetime);
+                            }
+                            if (client_id) ogs_free(client_id);
+                            if (session_id) ogs_free(session_id);
+                        } else {
+                            ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_NOT_FOUND, 0, message, "Not Found",
+                                                                    NULL, NULL, m5_metricsreporting_api, app_meta));
+                        }
+                        break;
+                    CASE(OGS_SBI_HTTP_METHOD_OPTIONS)
+                        if (message->h.resource.component[1] && message->h.resource.component[2] &&
+                                !message->h.resource.component[3]) {
+                            ogs_sbi_response_t *response;
+                            response = nf_server_new_response(request->h.uri, NULL,  0, NULL, 0,
+                                                              OGS_SBI_HTTP_METHOD_POST ", " OGS_SBI_HTTP_METHOD_OPTIONS,
+                                                              m5_metricsreporting_api, app_meta);
+                            ogs_assert(response);
+                            nf_server_populate_response(response, 0, NULL, 204);
+                            ogs_assert(true == ogs_sbi_server_send_response(stream, response));
+                        } else {
+                            ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_NOT_FOUND, 2, message, "Not Found",
+                                                                    message->h.method, NULL, m5_metricsreporting_api, app_meta)
+                                      );
+                        }
+                        break;
+                    DEFAULT
+                        char *err;
+                        err = ogs_msprintf("Method [%s] not implemented for M5 Metrics Reporting API", message->h.method);
+                        ogs_error("%s", err);
+                        ogs_assert(true == nf_server_send_error(stream, OGS_SBI_HTTP_STATUS_MEHTOD_NOT_ALLOWED, 2, message,
+                                                                "Method Not Allowed", err, NULL, m5_metricsreporting_api,
+                                                                app_meta));
+                        ogs_free(err);
+                    END
+                    break;
                 DEFAULT
                     ogs_error("Invalid resource name [%s]",
                             message->h.resource.component[0]);
@@ -893,8 +1095,8 @@ void msaf_m5_state_functional(ogs_fsm_t *s, msaf_event_t *e)
     }
 }
 
-static bool is_dynamic_policy_create_request_valid(ogs_sbi_request_t *request, ogs_sbi_stream_t *stream,
-                                                   ogs_sbi_message_t *message,
+static bool is_dynamic_policy_create_request_valid(ogs_sbi_request_t *request, const msaf_request_headers_t *headers,
+                                                   ogs_sbi_stream_t *stream, ogs_sbi_message_t *message,
                                                    const nf_server_interface_metadata_t *m5_dynamicpolicy_api,
                                                    const nf_server_app_metadata_t *app_meta)
 {
@@ -904,7 +1106,7 @@ static bool is_dynamic_policy_create_request_valid(ogs_sbi_request_t *request, o
     cJSON *policy_template_id = NULL;
     cJSON *provisioning_session_id = NULL;
 
-    if(!check_http_content_type(request->http,"application/json")){
+    if(!msaf_request_headers_content_type_is(headers, "application/json")){
         ogs_assert(true == nf_server_send_error(stream, 415, 3, message, "Unsupported Media Type.",
                                                 "Expected content type: application/json", NULL, m5_dynamicpolicy_api, app_meta));
         ogs_sbi_message_free(message);
@@ -980,5 +1182,92 @@ static bool is_dynamic_policy_create_request_valid(ogs_sbi_request_t *request, o
     return 1;
 }
 
+/* Fill in the summary used for consumption statistics from a report that needed the full parse */
+static void consumption_report_summary_from_model(msaf_consumption_report_summary_t *summary,
+                                                  const msaf_api_consumption_report_t *consumption_report)
+{
+    OpenAPI_lnode_t *node;
+
+    memset(summary, 0, sizeof(*summary));
+    summary->reporting_client_id = msaf_strdup(consumption_report->reporting_client_id);
+    summary->media_player_entry = msaf_strdup(consumption_report->media_player_entry);
+    OpenAPI_list_for_each(consumption_report->consumption_reporting_units, node) {
+        msaf_api_consumption_reporting_unit_t *unit = node->data;
+        summary->units++;
+        if (unit && unit->duration > 0) summary->duration += unit->duration;
+    }
+}
+
+static const char *_rate_limit_session_id(const char *provisioning_session_id)
+{
+    msaf_provisioning_session_t *provisioning_session;
+
+    if (!provisioning_session_id) return NULL;
+
+    provisioning_session = msaf_provisioning_session_find_by_provisioningSessionId(provisioning_session_id);
+    if (!provisioning_session || provisioning_session->marked_for_deletion) return NULL;
+
+    return provisioning_session->provisioningSessionId;
+}
+
+/* Apply the M5 token bucket limits, sending 429 Too Many Requests and returning false if the request is refused.
+ * Clients are told apart by the peer address of the connection, or by the last X-Forwarded-For address when the peer is
+ * one of the configured trusted proxies. If neither gives an address only the provisioning session limit applies.
+ *
+ * Only provisioning sessions that exist get a bucket, otherwise requests for made up ids would fill the session buckets
+ * and push out those of real sessions. Dynamic policy and network assistance requests don't name a provisioning session
+ * in their path, so they only have the client limit.
+ */
+static bool _rate_limit_admit(const msaf_request_headers_t *headers, ogs_sbi_stream_t *stream, ogs_sbi_message_t *message,
+                              const nf_server_app_metadata_t *app_meta)
+{
+    char addr_buf[OGS_ADDRSTRLEN];
+    char peer_buf[OGS_ADDRSTRLEN];
+    const char *client_address;
+    const char *provisioning_session_id = NULL;
+    const nf_server_interface_metadata_t *api = NULL;
+    msaf_rate_limit_result_t result;
+    int retry_after;
+    char *err;
+
+    client_address = msaf_rate_limit_client_address(&msaf_self()->config.m5_rate_limit,
+                                                    ogs_sbi_server_stream_peer_address(stream, peer_buf),
+                                                    msaf_request_headers_get(headers, MSAF_REQUEST_HEADER_X_FORWARDED_FOR),
+                                                    addr_buf, sizeof(addr_buf));
+
+    SWITCH(message->h.resource.component[0])
+    CASE("consumption-reporting")
+        provisioning_session_id = _rate_limit_session_id(message->h.resource.component[1]);
+        api = &m5_consumptionreporting_api_metadata;
+        break;
+    CASE("metrics-reporting")
+        provisioning_session_id = _rate_limit_session_id(message->h.resource.component[1]);
+        api = &m5_metricsreporting_api_metadata;
+        break;
+    CASE("dynamic-policies")
+        api = &m5_dynamicpolicy_api_metadata;
+        break;
+    CASE("network-assistance")
+        api = &m5_networkassistance_api_metadata;
+        break;
+    DEFAULT
+    END
+
+    result = msaf_rate_limit_check(client_address, provisioning_session_id, &retry_after);
+    if (result == MSAF_RATE_LIMIT_ALLOWED) return true;
+
+    if (result == MSAF_RATE_LIMIT_CLIENT) {
+        err = ogs_msprintf("Too many requests from client [%s]", client_address);
+    } else {
+        err = ogs_msprintf("Too many requests for provisioning session [%s]", provisioning_session_id);
+    }
+    ogs_debug("%s", err);
+    ogs_assert(true == nf_server_send_error_retry_after(stream, 429, retry_after, 1, message, "Too Many Requests", err, NULL,
+                                                        api, app_meta));
+    ogs_free(err);
+
+    return false;
+}
+
 /* vim:ts=8:sts=4:sw=4:expandtab:
 */
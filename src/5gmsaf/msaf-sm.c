@@ -19,6 +19,7 @@
 #include "certmgr.h"
 #include "server.h"
 #include "local.h"
+#include "provisioning-session-journal.h"
 #include "response-cache-control.h"
 #include "msaf-version.h"
 #include "msaf-sm.h"
@@ -69,6 +70,7 @@ void msaf_state_functional(ogs_fsm_t *s, msaf_event_t *e)
     switch (e->h.id) {
         case OGS_FSM_ENTRY_SIG:
             msaf_fsm_init();
+            msaf_provisioning_session_journal_restore();
             ogs_info("[%s] MSAF Running", ogs_sbi_self()->nf_instance->id);
             break;
 
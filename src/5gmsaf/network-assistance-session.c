@@ -9,6 +9,7 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 */
 
 #include "utilities.h"
+#include "json-format.h"
 #include "network-assistance-session.h"
 #include "pcf-session.h"
 #include "timer.h"
@@ -677,7 +678,7 @@ static void activate_delivery_boost_and_send_response(msaf_network_assistance_se
 
     operation_success_response = msaf_api_operation_success_response_create(reason, 1);
     op_success_response = msaf_api_operation_success_response_convertResponseToJSON(operation_success_response);
-    success_response = cJSON_Print(op_success_response);
+    success_response = msaf_json_print(op_success_response);
 
     cache_control_max_age = (msaf_self()->config.network_assistance_delivery_boost->delivery_boost_period);
 
@@ -720,7 +721,7 @@ static void delivery_boost_send_response(msaf_network_assistance_session_t *na_s
 
     operation_success_response = msaf_api_operation_success_response_create(reason, 0);
     op_success_response = msaf_api_operation_success_response_convertResponseToJSON(operation_success_response);
-    success_response = cJSON_Print(op_success_response);
+    success_response = msaf_json_print(op_success_response);
 
     response = nf_server_new_response(NULL, "application/json", 0, NULL, 0, NULL, na_sess->metadata->delivery_boost->nf_server_interface_metadata, na_sess->metadata->delivery_boost->app_meta);
     ogs_assert(response);
@@ -759,7 +760,7 @@ static bool create_msaf_na_sess_and_send_response(msaf_network_assistance_sessio
     ogs_assert(response);
 
     nas_json = msaf_api_network_assistance_session_convertResponseToJSON(na_sess->NetworkAssistanceSession);
-    response_body= cJSON_Print(nas_json);
+    response_body= msaf_json_print(nas_json);
     nf_server_populate_response(response, response_body?strlen(response_body):0, msaf_strdup(response_body), response_code);
     ogs_assert(true == ogs_sbi_server_send_response(na_sess->metadata->create_event->h.sbi.data, response));
 
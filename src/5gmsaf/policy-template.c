@@ -7,13 +7,18 @@ program. If this file is missing then the license can be retrieved from
 https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 */
 
+#include <math.h>
+
 #include "context.h"
 #include "policy-template.h"
 #include "utilities.h"
 #include "hash.h"
+#include "json-format.h"
+#include "json-writer.h"
 #include "sai-cache.h"
 
 static void msaf_policy_template_set_state_reason(msaf_api_policy_template_t *policy_template, char *cause, char *detail, char *instance, char *nrf_id, char *supported_features, char *title, char *type);
+static bool _write_policy_template(msaf_json_writer_t *writer, const void *policy_template);
 
 /***** Public functions *****/
 
@@ -32,13 +37,10 @@ void msaf_policy_template_set_id(msaf_api_policy_template_t *policy_template, co
 char *calculate_policy_template_hash(msaf_api_policy_template_t *policy_template)
 {
     cJSON *policy_template_json = NULL;
-    char *policy_template_to_hash;
     char *policy_template_hashed = NULL;
     policy_template_json = msaf_policy_template_convert_to_json(policy_template);
-    policy_template_to_hash = cJSON_Print(policy_template_json);
+    policy_template_hashed = msaf_json_hash(policy_template_json);
     cJSON_Delete(policy_template_json);
-    policy_template_hashed = calculate_hash(policy_template_to_hash);
-    cJSON_free(policy_template_to_hash);
     return policy_template_hashed;
 }
 
@@ -89,8 +91,7 @@ bool msaf_policy_template_set_state(msaf_api_policy_template_t *policy_template,
        if(new_state == msaf_api_policy_template_STATE_PENDING) return false;
 
        if(new_state == msaf_api_policy_template_STATE_READY) {
-	   if(provisioning_session->sai_cache)    
-               msaf_sai_cache_clear(provisioning_session->sai_cache);
+	   msaf_context_service_access_information_invalidate(provisioning_session);
 	   policy_template->state = msaf_api_policy_template_STATE_READY;
            msaf_policy_template_set_state_reason(policy_template, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
 
@@ -116,16 +117,14 @@ bool msaf_policy_template_set_state(msaf_api_policy_template_t *policy_template,
    if(policy_template->state == msaf_api_policy_template_STATE_READY) {
 
        if(new_state == msaf_api_policy_template_STATE_NULL) {
-	   if (provisioning_session->sai_cache)    
-               msaf_sai_cache_clear(provisioning_session->sai_cache);
+	   msaf_context_service_access_information_invalidate(provisioning_session);
            policy_template->state = msaf_api_policy_template_STATE_NULL;
            msaf_policy_template_set_state_reason(policy_template, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
            return true;
        }	
 
        if(new_state == msaf_api_policy_template_STATE_PENDING) {
-	   if(provisioning_session->sai_cache)    
-               msaf_sai_cache_clear(provisioning_session->sai_cache);
+	   msaf_context_service_access_information_invalidate(provisioning_session);
            policy_template->state = msaf_api_policy_template_STATE_PENDING;
            msaf_policy_template_set_state_reason(policy_template, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
            return true;
@@ -141,8 +140,7 @@ bool msaf_policy_template_set_state(msaf_api_policy_template_t *policy_template,
        if(new_state ==  msaf_api_policy_template_STATE_SUSPENDED) {
 	   char *detail = "Policy template state transitioned from READY to SUSPENDED.";
 	   char *title = "Operator Decision.";
-           if (provisioning_session->sai_cache)    
-	       msaf_sai_cache_clear(provisioning_session->sai_cache);
+           msaf_context_service_access_information_invalidate(provisioning_session);
            policy_template->state = msaf_api_policy_template_STATE_SUSPENDED;
 	   msaf_policy_template_set_state_reason(policy_template, NULL, msaf_strdup(detail), NULL, NULL, NULL, msaf_strdup(title), NULL);
            return true;
@@ -260,18 +258,138 @@ bool msaf_policy_template_clear(ogs_hash_t *policy_templates)
     return true;
 }
 
+void msaf_policy_template_extra_validation(msaf_api_policy_template_t **policy_temp_ptr, const char **parse_err)
+{
+    msaf_api_policy_template_t *policy_template = *policy_temp_ptr;
+
+    /* extra validation checks */
+    if (policy_template && policy_template->qo_s_specification &&
+            policy_template->qo_s_specification->max_auth_btr_dl) {
+        double bitrate;
+        bitrate = str_to_bitrate(policy_template->qo_s_specification->max_auth_btr_dl, parse_err);
+        if (isnan(bitrate)) {
+            msaf_api_policy_template_free(policy_template);
+            policy_template = NULL;
+            *policy_temp_ptr = NULL;
+        }
+    }
+    if (policy_template && policy_template->qo_s_specification &&
+            policy_template->qo_s_specification->max_auth_btr_ul) {
+        double bitrate;
+        bitrate = str_to_bitrate(policy_template->qo_s_specification->max_auth_btr_ul, parse_err);
+        if (isnan(bitrate)) {
+            msaf_api_policy_template_free(policy_template);
+            policy_template = NULL;
+            *policy_temp_ptr = NULL;
+        }
+    }
+    if (policy_template && policy_template->application_session_context &&
+            policy_template->application_session_context->slice_info &&
+            policy_template->application_session_context->slice_info->sd &&
+            (strlen(policy_template->application_session_context->slice_info->sd) != 6 ||
+             strspn(policy_template->application_session_context->slice_info->sd,
+                 "0123456789ABCDEFabcdef") != 6
+            )) {
+        *parse_err = "S-NSSAI SD value must be 6 hexadecimal digits";
+        msaf_api_policy_template_free(policy_template);
+        policy_template = NULL;
+        *policy_temp_ptr = NULL;
+    }
+    if (policy_template && policy_template->charging_specification &&
+            policy_template->charging_specification->gpsi) {
+        OpenAPI_lnode_t *node = NULL;
+        OpenAPI_list_for_each(policy_template->charging_specification->gpsi, node) {
+            const char *s = (const char*)node->data;
+            if (!strncmp(s, "msisdn-", 7) && (strlen(s) < 12 || strlen(s) > 22 ||
+                        strspn(s+7, "0123456789") != strlen(s+7))) {
+                *parse_err = "GPSI MSISDN must have between 5 and 15 decimal digits";
+                msaf_api_policy_template_free(policy_template);
+                policy_template = NULL;
+                *policy_temp_ptr = NULL;
+                break;
+            }
+            if (!strncmp(s, "extid-", 6)) {
+                char *at = strchr(s+6, '@');
+                if (!at || at == s+6 || at[1] == '\0' || strchr(at+1, '@') != NULL) {
+                    *parse_err = "GPSI EXTID must be of the form <a>@<b>, where <a> & <b> may not contain the @ symbol";
+                    msaf_api_policy_template_free(policy_template);
+                    policy_template = NULL;
+                    *policy_temp_ptr = NULL;
+                    break;
+                }
+            }
+            if (strlen(s) == 0) {
+                *parse_err = "GPSI cannot be an empty string";
+                msaf_api_policy_template_free(policy_template);
+                policy_template = NULL;
+                *policy_temp_ptr = NULL;
+                break;
+            }
+        }
+    }
+}
+
+void msaf_policy_template_remove_read_only(msaf_api_policy_template_t *policy_temp)
+{
+    if (!policy_temp) return;
+    /* validation passed, remove read-only fields if present */
+    if (policy_temp->policy_template_id) {
+        ogs_free(policy_temp->policy_template_id);
+        policy_temp->policy_template_id = NULL;
+    }
+    if (policy_temp->state != msaf_api_policy_template_STATE_NULL) {
+        policy_temp->state = msaf_api_policy_template_STATE_NULL;
+    }
+    if (policy_temp->state_reason) {
+        msaf_api_problem_details_free(policy_temp->state_reason);
+        policy_temp->state_reason = NULL;
+    }
+    if (policy_temp->qo_s_specification && policy_temp->qo_s_specification->max_btr_dl) {
+        ogs_free(policy_temp->qo_s_specification->max_btr_dl);
+        policy_temp->qo_s_specification->max_btr_dl = NULL;
+    }
+    if (policy_temp->qo_s_specification && policy_temp->qo_s_specification->max_btr_ul) {
+        ogs_free(policy_temp->qo_s_specification->max_btr_ul);
+        policy_temp->qo_s_specification->max_btr_ul = NULL;
+    }
+}
+
+char *msaf_policy_template_body(msaf_policy_template_node_t *node)
+{
+    ogs_assert(node);
+
+    if (!msaf_content_variant_is_current(&node->identity, node->hash)) {
+        char *body;
+        size_t length;
+
+        body = msaf_json_write(_write_policy_template, node->policy_template, node->identity.length, &length);
+        if (!body) return NULL;
+
+        msaf_content_variant_set(&node->identity, body, length, node->hash);
+        ogs_free(body);
+    }
+
+    return msaf_content_variant_copy(&node->identity);
+}
+
 void msaf_policy_template_node_free(msaf_policy_template_node_t *node)
 {
     if (!node) return;
 
     if (node->policy_template) msaf_policy_template_free(node->policy_template);
     if (node->hash) ogs_free(node->hash);
+    msaf_content_variant_clear(&node->identity);
 
     ogs_free(node);
 }
 
 /***** Private functions *****/
 
+static bool _write_policy_template(msaf_json_writer_t *writer, const void *policy_template)
+{
+    return msaf_api_policy_template_writeResponseJSON(writer, (const msaf_api_policy_template_t*)policy_template);
+}
+
 static void msaf_policy_template_set_state_reason(msaf_api_policy_template_t *policy_template, char *cause, char *detail, char *instance, char *nrf_id, char *supported_features, char *title, char *type)
 {
 
@@ -29,6 +29,12 @@ extern msaf_api_policy_template_t *msaf_policy_template_create(cJSON *policy_tem
 
 extern msaf_api_policy_template_t *msaf_policy_template_parseFromJSON(cJSON *policy_templateJSON, const char **reason);
 
+/* Checks beyond the OpenAPI model, frees *policy_template and sets it to NULL if they fail */
+extern void msaf_policy_template_extra_validation(msaf_api_policy_template_t **policy_template, const char **parse_err);
+
+/* Clear the read-only fields from a validated request */
+extern void msaf_policy_template_remove_read_only(msaf_api_policy_template_t *policy_template);
+
 extern cJSON *msaf_policy_template_convertToJSON(msaf_api_policy_template_t *policy_template);
 
 extern char *calculate_policy_template_hash(msaf_api_policy_template_t *policy_template);
@@ -41,6 +47,9 @@ extern OpenAPI_list_t *get_external_reference_of_policy_templates_in_ready_state
 
 extern bool msaf_policy_template_clear(ogs_hash_t *policy_templates);
 
+/* PolicyTemplate response body, rendered once for each version of the policy template */
+extern char *msaf_policy_template_body(msaf_policy_template_node_t *node);
+
 extern void msaf_policy_template_node_free(msaf_policy_template_node_t *node);
 
 cJSON *msaf_policy_template_convert_to_json(msaf_api_policy_template_t *policy_template);
@@ -0,0 +1,1031 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ogs-core.h"
+
+#include "application-server-context.h"
+#include "change-feed.h"
+#include "consumption-report-configuration.h"
+#include "context.h"
+#include "event.h"
+#include "metrics-reporting-configuration.h"
+#include "policy-template.h"
+#include "provisioning-session.h"
+#include "state-journal.h"
+#include "utilities.h"
+
+#include "openapi/model/msaf_api_consumption_reporting_configuration.h"
+#include "openapi/model/msaf_api_content_hosting_configuration.h"
+#include "openapi/model/msaf_api_metrics_reporting_configuration.h"
+#include "openapi/model/msaf_api_policy_template.h"
+#include "openapi/model/msaf_api_provisioning_session_type.h"
+
+#include "provisioning-session-journal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Record types */
+#define RECORD_PROVISIONING_SESSION "provisioning-session"
+#define RECORD_PROVISIONING_SESSION_DELETED "provisioning-session-deleted"
+#define RECORD_CONTENT_HOSTING_CONFIGURATION "content-hosting-configuration"
+#define RECORD_CONTENT_HOSTING_CONFIGURATION_DELETED "content-hosting-configuration-deleted"
+#define RECORD_CERTIFICATE "certificate"
+#define RECORD_CERTIFICATE_DELETED "certificate-deleted"
+#define RECORD_CONSUMPTION_REPORTING_CONFIGURATION "consumption-reporting-configuration"
+#define RECORD_CONSUMPTION_REPORTING_CONFIGURATION_DELETED "consumption-reporting-configuration-deleted"
+#define RECORD_POLICY_TEMPLATE "policy-template"
+#define RECORD_POLICY_TEMPLATE_DELETED "policy-template-deleted"
+#define RECORD_METRICS_REPORTING_CONFIGURATION "metrics-reporting-configuration"
+#define RECORD_METRICS_REPORTING_CONFIGURATION_DELETED "metrics-reporting-configuration-deleted"
+
+/* msaf_state_journal_append() or msaf_state_journal_snapshot_add() */
+typedef bool (*record_write_fn)(msaf_state_journal_t *journal, const char *type, const char *payload, size_t payload_len);
+
+typedef struct record_handler_s {
+    const char *type;
+    bool (*apply)(cJSON *record);
+} record_handler_t;
+
+/* A snapshot collected on the event loop for the writer thread to write out */
+typedef struct snapshot_job_s {
+    msaf_state_journal_snapshot_job_t *job; /* NULL to stop the writer thread */
+    ogs_time_t started;
+    bool done;                        /* set by the writer thread, with written, under snapshot_mutex */
+    bool written;
+} snapshot_job_t;
+
+/* Only used from the event loop */
+static struct {
+    msaf_state_journal_t *journal;    /* NULL if state is not being kept */
+    bool restoring;                   /* don't journal the changes made while replaying */
+    snapshot_job_t *snapshot;         /* snapshot being written, NULL if none */
+    bool snapshot_again;              /* a change could not be journaled while the snapshot was being written */
+} journal_state = {NULL, false, NULL, false};
+
+/* Jobs for the writer thread, NULL if snapshots are written on the event loop */
+static ogs_queue_t *snapshot_queue = NULL;
+static ogs_thread_t *snapshot_thread = NULL;
+static ogs_thread_mutex_t snapshot_mutex;
+
+/* a snapshot job and the stop job */
+#define SNAPSHOT_QUEUE_LENGTH 4
+
+static bool _journaling(void);
+static void _change(const char *resource_type, const char *provisioning_session_id, const char *resource_id, bool deleted);
+static void _journal_record(const char *type, cJSON *record /* [transfer] */);
+static void _snapshot(void);
+static bool _snapshot_finish(void);
+static bool _snapshot_collect(msaf_state_journal_t *journal, void *data);
+static void _snapshot_writer_start(void);
+static void _snapshot_writer_stop(void);
+static void _snapshot_writer_main(void *data);
+static int _compare_list_seq(const void *a, const void *b);
+static bool _write_record(msaf_state_journal_t *journal, record_write_fn write_fn, const char *type, cJSON *record /* [transfer] */);
+static bool _write_provisioning_session(msaf_state_journal_t *journal, record_write_fn write_fn, msaf_provisioning_session_t *session);
+static void _resume(void);
+
+static cJSON *_provisioning_session_record(const msaf_provisioning_session_t *session);
+static cJSON *_content_hosting_configuration_record(const msaf_provisioning_session_t *session);
+static cJSON *_certificate_record(const msaf_provisioning_session_t *session, const char *certificate_id);
+static cJSON *_consumption_reporting_configuration_record(const msaf_provisioning_session_t *session);
+static cJSON *_policy_template_record(const msaf_provisioning_session_t *session, const msaf_policy_template_node_t *node);
+static cJSON *_metrics_reporting_configuration_record(const msaf_provisioning_session_t *session,
+                                                      const msaf_metrics_reporting_configuration_node_t *node);
+static cJSON *_deleted_record(const char *provisioning_session_id, const char *id_name, const char *id);
+
+static bool _record_apply(const char *type, const char *payload, size_t payload_len, void *data);
+static bool _apply_provisioning_session(cJSON *record);
+static bool _apply_provisioning_session_deleted(cJSON *record);
+static bool _apply_content_hosting_configuration(cJSON *record);
+static bool _apply_content_hosting_configuration_deleted(cJSON *record);
+static bool _apply_certificate(cJSON *record);
+static bool _apply_certificate_deleted(cJSON *record);
+static bool _apply_consumption_reporting_configuration(cJSON *record);
+static bool _apply_consumption_reporting_configuration_deleted(cJSON *record);
+static bool _apply_policy_template(cJSON *record);
+static bool _apply_policy_template_deleted(cJSON *record);
+static bool _apply_metrics_reporting_configuration(cJSON *record);
+static bool _apply_metrics_reporting_configuration_deleted(cJSON *record);
+
+static const char *_record_string(const cJSON *record, const char *name);
+static void _record_time(const cJSON *record, const char *name, time_t *value);
+static msaf_provisioning_session_t *_record_provisioning_session(const cJSON *record);
+
+static const record_handler_t record_handlers[] = {
+    {RECORD_PROVISIONING_SESSION, _apply_provisioning_session},
+    {RECORD_PROVISIONING_SESSION_DELETED, _apply_provisioning_session_deleted},
+    {RECORD_CONTENT_HOSTING_CONFIGURATION, _apply_content_hosting_configuration},
+    {RECORD_CONTENT_HOSTING_CONFIGURATION_DELETED, _apply_content_hosting_configuration_deleted},
+    {RECORD_CERTIFICATE, _apply_certificate},
+    {RECORD_CERTIFICATE_DELETED, _apply_certificate_deleted},
+    {RECORD_CONSUMPTION_REPORTING_CONFIGURATION, _apply_consumption_reporting_configuration},
+    {RECORD_CONSUMPTION_REPORTING_CONFIGURATION_DELETED, _apply_consumption_reporting_configuration_deleted},
+    {RECORD_POLICY_TEMPLATE, _apply_policy_template},
+    {RECORD_POLICY_TEMPLATE_DELETED, _apply_policy_template_deleted},
+    {RECORD_METRICS_REPORTING_CONFIGURATION, _apply_metrics_reporting_configuration},
+    {RECORD_METRICS_REPORTING_CONFIGURATION_DELETED, _apply_metrics_reporting_configuration_deleted}
+};
+
+/*****************************************************
+ ***** Public functions
+ *****************************************************/
+
+void msaf_provisioning_session_journal_restore(void)
+{
+    const msaf_state_journal_config_t *config = &msaf_self()->config.state_journal;
+    ogs_time_t start;
+    bool loaded;
+
+    if (!config->directory) return;
+
+    ogs_assert(!journal_state.journal);
+
+    start = ogs_get_monotonic_time();
+
+    journal_state.journal = msaf_state_journal_open(config);
+    journal_state.restoring = true;
+    loaded = msaf_state_journal_load(journal_state.journal, _record_apply, NULL);
+    journal_state.restoring = false;
+
+    if (!loaded) {
+        /* leave the files alone so that they can be looked at or recovered, but carry on without them */
+        ogs_error("Unable to restore provisioning sessions from %s, state will not be saved", config->directory);
+        msaf_state_journal_close(journal_state.journal);
+        journal_state.journal = NULL;
+    } else {
+        ogs_info("Restored %u provisioning sessions from %s in %lld us", ogs_hash_count(msaf_self()->provisioningSessions_map),
+                 config->directory, (long long)(ogs_get_monotonic_time() - start));
+    }
+
+    _resume();
+
+    if (!journal_state.journal) return;
+
+    _snapshot_writer_start();
+
+    /* start from a compact snapshot so the next restart only replays the changes from this run */
+    _snapshot();
+}
+
+void msaf_provisioning_session_journal_final(void)
+{
+    if (!journal_state.journal) return;
+
+    /* every change is already in the journal, so there is no need for a snapshot, only to finish the one being written */
+    _snapshot_writer_stop();
+    if (journal_state.snapshot) _snapshot_finish();
+
+    msaf_state_journal_close(journal_state.journal);
+    journal_state.journal = NULL;
+}
+
+void msaf_provisioning_session_journal_snapshot_written(void)
+{
+    bool done;
+
+    if (!journal_state.snapshot) return;
+
+    ogs_thread_mutex_lock(&snapshot_mutex);
+    done = journal_state.snapshot->done;
+    ogs_thread_mutex_unlock(&snapshot_mutex);
+
+    if (!done) return;
+
+    /* changes journaled while it was being written may have made another snapshot due */
+    if (_snapshot_finish() &&
+            (journal_state.snapshot_again || msaf_state_journal_snapshot_due(journal_state.journal))) {
+        _snapshot();
+    }
+    journal_state.snapshot_again = false;
+}
+
+void msaf_provisioning_session_journal_provisioning_session(const char *provisioning_session_id)
+{
+    msaf_provisioning_session_t *session;
+
+    ogs_assert(provisioning_session_id);
+
+    session = msaf_provisioning_session_find_by_provisioningSessionId(provisioning_session_id);
+    _change(RECORD_PROVISIONING_SESSION, provisioning_session_id, NULL, !session);
+
+    if (!_journaling()) return;
+
+    if (session) {
+        _journal_record(RECORD_PROVISIONING_SESSION, _provisioning_session_record(session));
+    } else {
+        _journal_record(RECORD_PROVISIONING_SESSION_DELETED, _deleted_record(provisioning_session_id, NULL, NULL));
+    }
+}
+
+void msaf_provisioning_session_journal_content_hosting_configuration(msaf_provisioning_session_t *session)
+{
+    ogs_assert(session);
+
+    _change(RECORD_CONTENT_HOSTING_CONFIGURATION, session->provisioningSessionId, NULL, !session->contentHostingConfiguration);
+
+    if (!_journaling()) return;
+
+    if (session->contentHostingConfiguration) {
+        _journal_record(RECORD_CONTENT_HOSTING_CONFIGURATION, _content_hosting_configuration_record(session));
+    } else {
+        _journal_record(RECORD_CONTENT_HOSTING_CONFIGURATION_DELETED,
+                        _deleted_record(session->provisioningSessionId, NULL, NULL));
+    }
+}
+
+void msaf_provisioning_session_journal_certificate(msaf_provisioning_session_t *session, const char *certificate_id)
+{
+    bool exists;
+
+    ogs_assert(session);
+    ogs_assert(certificate_id);
+
+    exists = session->certificate_map && ogs_hash_get(session->certificate_map, certificate_id, OGS_HASH_KEY_STRING);
+    _change(RECORD_CERTIFICATE, session->provisioningSessionId, certificate_id, !exists);
+
+    if (!_journaling()) return;
+
+    if (exists) {
+        _journal_record(RECORD_CERTIFICATE, _certificate_record(session, certificate_id));
+    } else {
+        _journal_record(RECORD_CERTIFICATE_DELETED,
+                        _deleted_record(session->provisioningSessionId, "certificateId", certificate_id));
+    }
+}
+
+void msaf_provisioning_session_journal_consumption_reporting_configuration(msaf_provisioning_session_t *session)
+{
+    ogs_assert(session);
+
+    _change(RECORD_CONSUMPTION_REPORTING_CONFIGURATION, session->provisioningSessionId, NULL,
+            !session->consumptionReportingConfiguration);
+
+    if (!_journaling()) return;
+
+    if (session->consumptionReportingConfiguration) {
+        _journal_record(RECORD_CONSUMPTION_REPORTING_CONFIGURATION, _consumption_reporting_configuration_record(session));
+    } else {
+        _journal_record(RECORD_CONSUMPTION_REPORTING_CONFIGURATION_DELETED,
+                        _deleted_record(session->provisioningSessionId, NULL, NULL));
+    }
+}
+
+void msaf_provisioning_session_journal_policy_template(msaf_provisioning_session_t *session, const char *policy_template_id)
+{
+    msaf_policy_template_node_t *node;
+
+    ogs_assert(session);
+    ogs_assert(policy_template_id);
+
+    node = msaf_provisioning_session_find_policy_template_by_id(session, policy_template_id);
+    _change(RECORD_POLICY_TEMPLATE, session->provisioningSessionId, policy_template_id, !node);
+
+    if (!_journaling()) return;
+
+    if (node) {
+        _journal_record(RECORD_POLICY_TEMPLATE, _policy_template_record(session, node));
+    } else {
+        _journal_record(RECORD_POLICY_TEMPLATE_DELETED,
+                        _deleted_record(session->provisioningSessionId, "policyTemplateId", policy_template_id));
+    }
+}
+
+void msaf_provisioning_session_journal_metrics_reporting_configuration(msaf_provisioning_session_t *session,
+                                                                      const char *metrics_reporting_configuration_id)
+{
+    msaf_metrics_reporting_configuration_node_t *node;
+
+    ogs_assert(session);
+    ogs_assert(metrics_reporting_configuration_id);
+
+    node = msaf_metrics_reporting_configuration_find(session, metrics_reporting_configuration_id);
+    _change(RECORD_METRICS_REPORTING_CONFIGURATION, session->provisioningSessionId, metrics_reporting_configuration_id, !node);
+
+    if (!_journaling()) return;
+
+    if (node) {
+        _journal_record(RECORD_METRICS_REPORTING_CONFIGURATION, _metrics_reporting_configuration_record(session, node));
+    } else {
+        _journal_record(RECORD_METRICS_REPORTING_CONFIGURATION_DELETED,
+                        _deleted_record(session->provisioningSessionId, "metricsReportingConfigurationId",
+                                        metrics_reporting_configuration_id));
+    }
+}
+
+/*****************************************************
+ ***** Private functions
+ *****************************************************/
+
+static bool _journaling(void)
+{
+    return journal_state.journal && !journal_state.restoring;
+}
+
+static void _change(const char *resource_type, const char *provisioning_session_id, const char *resource_id, bool deleted)
+{
+    /* restored resources are not changes */
+    if (journal_state.restoring) return;
+
+    msaf_change_feed_add(resource_type, provisioning_session_id, resource_id, deleted);
+}
+
+static void _journal_record(const char *type, cJSON *record)
+{
+    if (!_write_record(journal_state.journal, msaf_state_journal_append, type, record)) {
+        ogs_error("Failed to journal %s change, it will be lost if the AF is restarted before the next snapshot", type);
+        /* a snapshot will include the change */
+        _snapshot();
+        return;
+    }
+
+    if (msaf_state_journal_snapshot_due(journal_state.journal)) _snapshot();
+}
+
+static void _snapshot(void)
+{
+    ogs_time_t start = ogs_get_monotonic_time();
+    msaf_state_journal_snapshot_job_t *job;
+    snapshot_job_t *snapshot;
+    int rv;
+
+    if (journal_state.snapshot) {
+        /* the snapshot being written may not include the change, so take another once it is done */
+        journal_state.snapshot_again = true;
+        return;
+    }
+
+    if (!snapshot_queue) {
+        if (!msaf_state_journal_snapshot(journal_state.journal, _snapshot_collect, NULL)) {
+            ogs_error("Failed to write a provisioning session state snapshot");
+            return;
+        }
+        ogs_info("Provisioning session state snapshot written in %lld us", (long long)(ogs_get_monotonic_time() - start));
+        return;
+    }
+
+    job = msaf_state_journal_snapshot_begin(journal_state.journal, _snapshot_collect, NULL);
+    if (!job) {
+        ogs_error("Failed to collect a provisioning session state snapshot");
+        return;
+    }
+    ogs_debug("Provisioning session state collected for a snapshot in %lld us",
+              (long long)(ogs_get_monotonic_time() - start));
+
+    snapshot = ogs_calloc(1, sizeof(*snapshot));
+    ogs_assert(snapshot);
+    snapshot->job = job;
+    snapshot->started = start;
+
+    rv = ogs_queue_push(snapshot_queue, snapshot);
+    if (rv != OGS_OK) {
+        ogs_error("Unable to queue provisioning session state snapshot [%d]", rv);
+        msaf_state_journal_snapshot_end(journal_state.journal, job, false);
+        ogs_free(snapshot);
+        return;
+    }
+
+    journal_state.snapshot = snapshot;
+}
+
+/* End the snapshot the writer thread has finished with, returns true if it was written */
+static bool _snapshot_finish(void)
+{
+    snapshot_job_t *snapshot = journal_state.snapshot;
+    bool written = snapshot->written;
+
+    journal_state.snapshot = NULL;
+
+    msaf_state_journal_snapshot_end(journal_state.journal, snapshot->job, written);
+
+    if (written) {
+        ogs_info("Provisioning session state snapshot written in %lld us",
+                 (long long)(ogs_get_monotonic_time() - snapshot->started));
+    } else {
+        ogs_error("Failed to write a provisioning session state snapshot");
+    }
+
+    ogs_free(snapshot);
+
+    return written;
+}
+
+static bool _snapshot_collect(msaf_state_journal_t *journal, void *data)
+{
+    ogs_hash_t *sessions_map = msaf_self()->provisioningSessions_map;
+    msaf_provisioning_session_t **sessions;
+    ogs_hash_index_t *hi;
+    unsigned int count, i;
+    bool ok = true;
+
+    count = ogs_hash_count(sessions_map);
+    if (!count) return true;
+
+    /* in creation order, so that the management listing keeps its order across a restart */
+    sessions = ogs_calloc(count, sizeof(*sessions));
+    ogs_assert(sessions);
+    i = 0;
+    for (hi = ogs_hash_first(sessions_map); hi && i < count; hi = ogs_hash_next(hi)) {
+        sessions[i++] = (msaf_provisioning_session_t*)ogs_hash_this_val(hi);
+    }
+    count = i;
+    qsort(sessions, count, sizeof(*sessions), _compare_list_seq);
+
+    for (i = 0; ok && i < count; i++) {
+        ok = _write_provisioning_session(journal, msaf_state_journal_snapshot_add, sessions[i]);
+    }
+
+    ogs_free(sessions);
+
+    return ok;
+}
+
+/* If the writer thread cannot be started snapshots are written on the event loop instead */
+static void _snapshot_writer_start(void)
+{
+    snapshot_queue = ogs_queue_create(SNAPSHOT_QUEUE_LENGTH);
+    if (!snapshot_queue) {
+        ogs_error("Unable to create the state snapshot queue, snapshots will hold up the event loop");
+        return;
+    }
+
+    ogs_thread_mutex_init(&snapshot_mutex);
+
+    snapshot_thread = ogs_thread_create(_snapshot_writer_main, NULL);
+    if (!snapshot_thread) {
+        ogs_error("Unable to start the state snapshot writer thread, snapshots will hold up the event loop");
+        ogs_thread_mutex_destroy(&snapshot_mutex);
+        ogs_queue_destroy(snapshot_queue);
+        snapshot_queue = NULL;
+    }
+}
+
+static void _snapshot_writer_stop(void)
+{
+    snapshot_job_t *stop;
+    int rv;
+
+    if (!snapshot_queue) return;
+
+    /* the stop job is queued behind any snapshot, so that is written before the thread exits */
+    stop = ogs_calloc(1, sizeof(*stop));
+    ogs_assert(stop);
+    rv = ogs_queue_push(snapshot_queue, stop);
+    if (rv != OGS_OK) {
+        ogs_error("Unable to queue the state snapshot writer stop [%d]", rv);
+        ogs_free(stop);
+        ogs_queue_term(snapshot_queue);
+    }
+
+    ogs_thread_destroy(snapshot_thread);
+    snapshot_thread = NULL;
+    ogs_queue_destroy(snapshot_queue);
+    snapshot_queue = NULL;
+    ogs_thread_mutex_destroy(&snapshot_mutex);
+}
+
+/* Writes the snapshots collected by the event loop, which is told through a local event when each one is done */
+static void _snapshot_writer_main(void *data)
+{
+    for (;;) {
+        snapshot_job_t *snapshot = NULL;
+        msaf_event_t *event;
+        bool written;
+        int rv;
+
+        rv = ogs_queue_pop(snapshot_queue, (void**)&snapshot);
+        if (rv == OGS_DONE) break;
+        if (rv != OGS_OK || !snapshot) continue;
+
+        if (!snapshot->job) {
+            ogs_free(snapshot);
+            break;
+        }
+
+        written = msaf_state_journal_snapshot_write(snapshot->job);
+
+        ogs_thread_mutex_lock(&snapshot_mutex);
+        snapshot->written = written;
+        snapshot->done = true;
+        ogs_thread_mutex_unlock(&snapshot_mutex);
+
+        event = (msaf_event_t*)ogs_event_new(MSAF_EVENT_SBI_LOCAL);
+        event->local_id = MSAF_LOCAL_EVENT_STATE_SNAPSHOT_WRITTEN;
+
+        rv = ogs_queue_push(ogs_app()->queue, event);
+        if (rv != OGS_OK) {
+            /* the event loop has stopped, the snapshot is ended when the journal is closed */
+            ogs_event_free(event);
+            continue;
+        }
+        ogs_pollset_notify(ogs_app()->pollset);
+    }
+}
+
+static int _compare_list_seq(const void *a, const void *b)
+{
+    const msaf_provisioning_session_t *session_a = *(msaf_provisioning_session_t * const *)a;
+    const msaf_provisioning_session_t *session_b = *(msaf_provisioning_session_t * const *)b;
+
+    if (session_a->list_seq < session_b->list_seq) return -1;
+    if (session_a->list_seq > session_b->list_seq) return 1;
+    return 0;
+}
+
+static bool _write_record(msaf_state_journal_t *journal, record_write_fn write_fn, const char *type, cJSON *record)
+{
+    char *payload;
+    bool ok;
+
+    if (!record) return false;
+
+    payload = cJSON_PrintUnformatted(record);
+    cJSON_Delete(record);
+    if (!payload) return false;
+
+    ok = write_fn(journal, type, payload, strlen(payload));
+    cJSON_free(payload);
+
+    return ok;
+}
+
+static bool _write_provisioning_session(msaf_state_journal_t *journal, record_write_fn write_fn,
+                                        msaf_provisioning_session_t *session)
+{
+    ogs_hash_index_t *hi;
+
+    if (session->marked_for_deletion) return true;
+
+    if (!_write_record(journal, write_fn, RECORD_PROVISIONING_SESSION, _provisioning_session_record(session))) return false;
+
+    if (session->contentHostingConfiguration &&
+            !_write_record(journal, write_fn, RECORD_CONTENT_HOSTING_CONFIGURATION,
+                           _content_hosting_configuration_record(session))) {
+        return false;
+    }
+
+    if (session->certificate_map) {
+        for (hi = ogs_hash_first(session->certificate_map); hi; hi = ogs_hash_next(hi)) {
+            if (!_write_record(journal, write_fn, RECORD_CERTIFICATE,
+                               _certificate_record(session, (const char*)ogs_hash_this_key(hi)))) {
+                return false;
+            }
+        }
+    }
+
+    if (session->consumptionReportingConfiguration &&
+            !_write_record(journal, write_fn, RECORD_CONSUMPTION_REPORTING_CONFIGURATION,
+                           _consumption_reporting_configuration_record(session))) {
+        return false;
+    }
+
+    if (session->policy_templates) {
+        for (hi = ogs_hash_first(session->policy_templates); hi; hi = ogs_hash_next(hi)) {
+            if (!_write_record(journal, write_fn, RECORD_POLICY_TEMPLATE,
+                               _policy_template_record(session, (const msaf_policy_template_node_t*)ogs_hash_this_val(hi)))) {
+                return false;
+            }
+        }
+    }
+
+    if (session->metrics_reporting_configurations) {
+        for (hi = ogs_hash_first(session->metrics_reporting_configurations); hi; hi = ogs_hash_next(hi)) {
+            if (!_write_record(journal, write_fn, RECORD_METRICS_REPORTING_CONFIGURATION,
+                               _metrics_reporting_configuration_record(session,
+                                        (const msaf_metrics_reporting_configuration_node_t*)ogs_hash_this_val(hi)))) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/* Pick up where the restored provisioning sessions left off */
+static void _resume(void)
+{
+    ogs_hash_index_t *hi, *pt_hi;
+
+    for (hi = ogs_hash_first(msaf_self()->provisioningSessions_map); hi; hi = ogs_hash_next(hi)) {
+        msaf_provisioning_session_t *session = (msaf_provisioning_session_t*)ogs_hash_this_val(hi);
+
+        /* the Application Server is given the configuration as though it had just been provisioned */
+        if (session->contentHostingConfiguration && !msaf_application_server_state_set_on_post(session)) {
+            ogs_warn("Restored Content Hosting Configuration for Provisioning Session [%s] refers to a missing certificate",
+                     session->provisioningSessionId);
+        }
+
+        /* state changes that were in progress are made again */
+        for (pt_hi = ogs_hash_first(session->policy_templates); pt_hi; pt_hi = ogs_hash_next(pt_hi)) {
+            msaf_policy_template_node_t *node = (msaf_policy_template_node_t*)ogs_hash_this_val(pt_hi);
+
+            if (node->policy_template->state == msaf_api_policy_template_STATE_NULL) {
+                msaf_provisioning_session_send_policy_template_state_change_event(session, node,
+                                                            msaf_api_policy_template_STATE_PENDING, NULL, NULL);
+            } else if (node->policy_template->state == msaf_api_policy_template_STATE_PENDING) {
+                /* MVP: going straight to READY state from PENDING */
+                msaf_provisioning_session_send_policy_template_state_change_event(session, node,
+                                                            msaf_api_policy_template_STATE_READY, NULL, NULL);
+            }
+        }
+    }
+}
+
+static cJSON *_provisioning_session_record(const msaf_provisioning_session_t *session)
+{
+    cJSON *record = cJSON_CreateObject();
+
+    cJSON_AddStringToObject(record, "provisioningSessionId", session->provisioningSessionId);
+    cJSON_AddStringToObject(record, "provisioningSessionType",
+                            msaf_api_provisioning_session_type_ToString(session->provisioningSessionType));
+    if (session->aspId) cJSON_AddStringToObject(record, "aspId", session->aspId);
+    cJSON_AddStringToObject(record, "appId", session->appId);
+    cJSON_AddNumberToObject(record, "received", (double)session->httpMetadata.provisioningSession.received);
+
+    return record;
+}
+
+static cJSON *_content_hosting_configuration_record(const msaf_provisioning_session_t *session)
+{
+    cJSON *record;
+    cJSON *chc;
+
+    /* as a request, msaf_distribution_create() fills in the generated fields again when it is restored */
+    chc = msaf_api_content_hosting_configuration_convertRequestToJSON(session->contentHostingConfiguration);
+    if (!chc) {
+        ogs_error("Unable to convert Content Hosting Configuration for Provisioning Session [%s] to JSON",
+                  session->provisioningSessionId);
+        return NULL;
+    }
+
+    record = cJSON_CreateObject();
+    cJSON_AddStringToObject(record, "provisioningSessionId", session->provisioningSessionId);
+    cJSON_AddNumberToObject(record, "received", (double)session->httpMetadata.contentHostingConfiguration.received);
+    if (session->httpMetadata.contentHostingConfiguration.hash) {
+        cJSON_AddStringToObject(record, "hash", session->httpMetadata.contentHostingConfiguration.hash);
+    }
+    cJSON_AddItemToObject(record, "contentHostingConfiguration", chc);
+
+    return record;
+}
+
+static cJSON *_certificate_record(const msaf_provisioning_session_t *session, const char *certificate_id)
+{
+    cJSON *record = cJSON_CreateObject();
+
+    cJSON_AddStringToObject(record, "provisioningSessionId", session->provisioningSessionId);
+    cJSON_AddStringToObject(record, "certificateId", certificate_id);
+
+    return record;
+}
+
+static cJSON *_consumption_reporting_configuration_record(const msaf_provisioning_session_t *session)
+{
+    cJSON *record;
+    cJSON *crc;
+
+    crc = msaf_api_consumption_reporting_configuration_convertResponseToJSON(session->consumptionReportingConfiguration);
+    if (!crc) {
+        ogs_error("Unable to convert Consumption Reporting Configuration for Provisioning Session [%s] to JSON",
+                  session->provisioningSessionId);
+        return NULL;
+    }
+
+    record = cJSON_CreateObject();
+    cJSON_AddStringToObject(record, "provisioningSessionId", session->provisioningSessionId);
+    cJSON_AddNumberToObject(record, "received", (double)session->httpMetadata.consumptionReportingConfiguration.received);
+    cJSON_AddItemToObject(record, "consumptionReportingConfiguration", crc);
+
+    return record;
+}
+
+static cJSON *_policy_template_record(const msaf_provisioning_session_t *session, const msaf_policy_template_node_t *node)
+{
+    cJSON *record;
+    cJSON *policy_template;
+
+    policy_template = msaf_policy_template_convertToJSON(node->policy_template);
+    if (!policy_template) {
+        ogs_error("Unable to convert Policy Template [%s] for Provisioning Session [%s] to JSON",
+                  node->policy_template->policy_template_id, session->provisioningSessionId);
+        return NULL;
+    }
+
+    record = cJSON_CreateObject();
+    cJSON_AddStringToObject(record, "provisioningSessionId", session->provisioningSessionId);
+    cJSON_AddNumberToObject(record, "lastModified", (double)node->last_modified);
+    cJSON_AddItemToObject(record, "policyTemplate", policy_template);
+
+    return record;
+}
+
+static cJSON *_metrics_reporting_configuration_record(const msaf_provisioning_session_t *session,
+                                                      const msaf_metrics_reporting_configuration_node_t *node)
+{
+    cJSON *record;
+    cJSON *mrc;
+
+    mrc = msaf_metrics_reporting_configuration_json(node);
+    if (!mrc) return NULL;
+
+    record = cJSON_CreateObject();
+    cJSON_AddStringToObject(record, "provisioningSessionId", session->provisioningSessionId);
+    cJSON_AddNumberToObject(record, "received", (double)node->received);
+    cJSON_AddItemToObject(record, "metricsReportingConfiguration", mrc);
+
+    return record;
+}
+
+static cJSON *_deleted_record(const char *provisioning_session_id, const char *id_name, const char *id)
+{
+    cJSON *record = cJSON_CreateObject();
+
+    cJSON_AddStringToObject(record, "provisioningSessionId", provisioning_session_id);
+    if (id_name) cJSON_AddStringToObject(record, id_name, id);
+
+    return record;
+}
+
+static bool _record_apply(const char *type, const char *payload, size_t payload_len, void *data)
+{
+    cJSON *record;
+    bool ok;
+    int i;
+
+    for (i = 0; i < sizeof(record_handlers)/sizeof(record_handlers[0]); i++) {
+        if (!strcmp(type, record_handlers[i].type)) break;
+    }
+    if (i == sizeof(record_handlers)/sizeof(record_handlers[0])) {
+        ogs_error("Unknown provisioning session state record type \"%s\"", type);
+        return false;
+    }
+
+    record = cJSON_Parse(payload);
+    if (!record) {
+        ogs_error("Bad JSON in %s state record", type);
+        return false;
+    }
+
+    ok = record_handlers[i].apply(record);
+    cJSON_Delete(record);
+
+    return ok;
+}
+
+static bool _apply_provisioning_session(cJSON *record)
+{
+    const char *provisioning_session_id = _record_string(record, "provisioningSessionId");
+    const char *provisioning_session_type = _record_string(record, "provisioningSessionType");
+    const char *app_id = _record_string(record, "appId");
+    msaf_provisioning_session_t *session;
+
+    if (!provisioning_session_id || !provisioning_session_type || !app_id) return false;
+
+    /* provisioning sessions don't change once created */
+    if (msaf_provisioning_session_find_by_provisioningSessionId(provisioning_session_id)) return true;
+
+    session = msaf_provisioning_session_create_with_id(provisioning_session_id, provisioning_session_type,
+                                                       _record_string(record, "aspId"), app_id);
+    if (!session) return false;
+
+    _record_time(record, "received", &session->httpMetadata.provisioningSession.received);
+
+    return true;
+}
+
+static bool _apply_provisioning_session_deleted(cJSON *record)
+{
+    msaf_provisioning_session_t *session = _record_provisioning_session(record);
+
+    if (!session) return true;
+
+    msaf_provisioning_session_hash_remove(session->provisioningSessionId);
+    msaf_provisioning_session_free(session);
+
+    return true;
+}
+
+static bool _apply_content_hosting_configuration(cJSON *record)
+{
+    msaf_provisioning_session_t *session = _record_provisioning_session(record);
+    const char *hash = _record_string(record, "hash");
+    const char *reason = NULL;
+    cJSON *chc;
+
+    if (!session) return false;
+
+    chc = cJSON_DetachItemFromObjectCaseSensitive(record, "contentHostingConfiguration");
+    if (!chc) return false;
+
+    if (!msaf_distribution_create(chc, session, &reason)) return false;
+
+    /* keep the Last-Modified and ETag the M1 client has already seen */
+    _record_time(record, "received", &session->httpMetadata.contentHostingConfiguration.received);
+    if (hash) {
+        if (session->httpMetadata.contentHostingConfiguration.hash) {
+            ogs_free(session->httpMetadata.contentHostingConfiguration.hash);
+        }
+        session->httpMetadata.contentHostingConfiguration.hash = msaf_strdup(hash);
+    }
+
+    return true;
+}
+
+static bool _apply_content_hosting_configuration_deleted(cJSON *record)
+{
+    msaf_provisioning_session_t *session = _record_provisioning_session(record);
+
+    if (!session) return false;
+
+    if (session->contentHostingConfiguration) {
+        msaf_api_content_hosting_configuration_free(session->contentHostingConfiguration);
+        session->contentHostingConfiguration = NULL;
+    }
+
+    return true;
+}
+
+static bool _apply_certificate(cJSON *record)
+{
+    msaf_provisioning_session_t *session = _record_provisioning_session(record);
+    const char *certificate_id = _record_string(record, "certificateId");
+
+    if (!session || !certificate_id) return false;
+
+    msaf_provisioning_session_certificate_add(session, certificate_id);
+
+    return true;
+}
+
+static bool _apply_certificate_deleted(cJSON *record)
+{
+    msaf_provisioning_session_t *session = _record_provisioning_session(record);
+    const char *certificate_id = _record_string(record, "certificateId");
+
+    if (!session || !certificate_id) return false;
+
+    msaf_provisioning_session_certificate_hash_remove(session->provisioningSessionId, certificate_id);
+
+    return true;
+}
+
+static bool _apply_consumption_reporting_configuration(cJSON *record)
+{
+    msaf_provisioning_session_t *session = _record_provisioning_session(record);
+    msaf_api_consumption_reporting_configuration_t *config;
+    const char *reason = NULL;
+    cJSON *json;
+
+    if (!session) return false;
+
+    json = cJSON_GetObjectItemCaseSensitive(record, "consumptionReportingConfiguration");
+    if (!json) return false;
+
+    config = msaf_api_consumption_reporting_configuration_parseResponseFromJSON(json, &reason);
+    if (!config) {
+        ogs_error("Bad Consumption Reporting Configuration for Provisioning Session [%s]: %s", session->provisioningSessionId,
+                  reason?reason:"unknown error");
+        return false;
+    }
+
+    if (session->consumptionReportingConfiguration) {
+        msaf_consumption_report_configuration_update(session, config);
+    } else {
+        msaf_consumption_report_configuration_register(session, config);
+    }
+
+    _record_time(record, "received", &session->httpMetadata.consumptionReportingConfiguration.received);
+
+    return true;
+}
+
+static bool _apply_consumption_reporting_configuration_deleted(cJSON *record)
+{
+    msaf_provisioning_session_t *session = _record_provisioning_session(record);
+
+    if (!session) return false;
+
+    msaf_consumption_report_configuration_deregister(session);
+
+    return true;
+}
+
+static bool _apply_policy_template(cJSON *record)
+{
+    msaf_provisioning_session_t *session = _record_provisioning_session(record);
+    msaf_api_policy_template_t *policy_template;
+    const char *reason = NULL;
+    time_t last_modified = 0;
+    cJSON *json;
+
+    if (!session) return false;
+
+    json = cJSON_GetObjectItemCaseSensitive(record, "policyTemplate");
+    if (!json) return false;
+
+    /* as a response so that the id and state are read */
+    policy_template = msaf_api_policy_template_parseResponseFromJSON(json, &reason);
+    if (!policy_template) {
+        ogs_error("Bad Policy Template for Provisioning Session [%s]: %s", session->provisioningSessionId,
+                  reason?reason:"unknown error");
+        return false;
+    }
+
+    _record_time(record, "lastModified", &last_modified);
+
+    return msaf_provisioning_session_restore_policy_template(session, policy_template, last_modified);
+}
+
+static bool _apply_policy_template_deleted(cJSON *record)
+{
+    msaf_provisioning_session_t *session = _record_provisioning_session(record);
+    const char *policy_template_id = _record_string(record, "policyTemplateId");
+
+    if (!session || !policy_template_id) return false;
+
+    msaf_provisioning_session_discard_policy_template(session, policy_template_id);
+
+    return true;
+}
+
+static bool _apply_metrics_reporting_configuration(cJSON *record)
+{
+    msaf_provisioning_session_t *session = _record_provisioning_session(record);
+    msaf_api_metrics_reporting_configuration_t *config;
+    msaf_metrics_reporting_configuration_node_t *node;
+    const char *reason = NULL;
+    cJSON *json;
+
+    if (!session) return false;
+
+    json = cJSON_GetObjectItemCaseSensitive(record, "metricsReportingConfiguration");
+    if (!json) return false;
+
+    config = msaf_api_metrics_reporting_configuration_parseResponseFromJSON(json, &reason);
+    if (!config) {
+        ogs_error("Bad Metrics Reporting Configuration for Provisioning Session [%s]: %s", session->provisioningSessionId,
+                  reason?reason:"unknown error");
+        return false;
+    }
+
+    node = msaf_metrics_reporting_configuration_restore(session, config);
+    if (!node) return false;
+
+    _record_time(record, "received", &node->received);
+
+    return true;
+}
+
+static bool _apply_metrics_reporting_configuration_deleted(cJSON *record)
+{
+    msaf_provisioning_session_t *session = _record_provisioning_session(record);
+    const char *metrics_reporting_configuration_id = _record_string(record, "metricsReportingConfigurationId");
+
+    if (!session || !metrics_reporting_configuration_id) return false;
+
+    msaf_metrics_reporting_configuration_deregister(session, metrics_reporting_configuration_id);
+
+    return true;
+}
+
+static const char *_record_string(const cJSON *record, const char *name)
+{
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(record, name);
+
+    return cJSON_IsString(item)?item->valuestring:NULL;
+}
+
+static void _record_time(const cJSON *record, const char *name, time_t *value)
+{
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(record, name);
+
+    if (cJSON_IsNumber(item)) *value = (time_t)item->valuedouble;
+}
+
+static msaf_provisioning_session_t *_record_provisioning_session(const cJSON *record)
+{
+    const char *provisioning_session_id = _record_string(record, "provisioningSessionId");
+
+    if (!provisioning_session_id) return NULL;
+
+    return msaf_provisioning_session_find_by_provisioningSessionId(provisioning_session_id);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,63 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#ifndef MSAF_PROVISIONING_SESSION_JOURNAL_H
+#define MSAF_PROVISIONING_SESSION_JOURNAL_H
+
+#include "ogs-core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Keeps the provisioning sessions, and the resources configured on them through M1, in a state journal (see state-journal.h)
+ * when msaf.stateJournal.directory is configured, so that they survive a restart of the AF.
+ *
+ * Each record is a compact JSON object holding the whole of one resource as it is after a change, or the id of a resource
+ * that has been deleted, so replaying a record is the same whether or not the resource already exists. A snapshot holds the
+ * records for every resource.
+ *
+ * Certificates are kept by the certificate manager, only the ids of the certificates belonging to each provisioning session
+ * are journaled.
+ */
+
+typedef struct msaf_provisioning_session_s msaf_provisioning_session_t;
+
+/* Restore the saved provisioning sessions, called once the event loop is running. Restored content hosting configurations are
+ * sent to the Application Server again and policy templates that had not reached a settled state are moved on. */
+extern void msaf_provisioning_session_journal_restore(void);
+/* Wait for any snapshot being written and close the journal, called before the provisioning sessions are freed at exit */
+extern void msaf_provisioning_session_journal_final(void);
+/* Called on the event loop when the snapshot writer thread has written a snapshot */
+extern void msaf_provisioning_session_journal_snapshot_written(void);
+
+/* Journal the current state of a resource after it has been created, changed or deleted through M1. These also add the
+ * change to the change feed (see change-feed.h), which is kept whether or not the journal is in use. */
+extern void msaf_provisioning_session_journal_provisioning_session(const char *provisioning_session_id /* [not-null] */);
+extern void msaf_provisioning_session_journal_content_hosting_configuration(
+                                        msaf_provisioning_session_t *session /* [no-transfer, not-null] */);
+extern void msaf_provisioning_session_journal_certificate(msaf_provisioning_session_t *session /* [no-transfer, not-null] */,
+                                        const char *certificate_id /* [not-null] */);
+extern void msaf_provisioning_session_journal_consumption_reporting_configuration(
+                                        msaf_provisioning_session_t *session /* [no-transfer, not-null] */);
+extern void msaf_provisioning_session_journal_policy_template(msaf_provisioning_session_t *session /* [no-transfer, not-null] */,
+                                        const char *policy_template_id /* [not-null] */);
+extern void msaf_provisioning_session_journal_metrics_reporting_configuration(
+                                        msaf_provisioning_session_t *session /* [no-transfer, not-null] */,
+                                        const char *metrics_reporting_configuration_id /* [not-null] */);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
+
+#endif /* ifndef MSAF_PROVISIONING_SESSION_JOURNAL_H */
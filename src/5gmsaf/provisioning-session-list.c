@@ -0,0 +1,502 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ogs-core.h"
+
+#include "provisioning-session.h"
+
+#include "provisioning-session-list.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct msaf_provisioning_session_list_entry_s {
+    uint64_t seq;
+    msaf_provisioning_session_t *session;
+} msaf_provisioning_session_list_entry_t;
+
+/* A run of entries in seq order, the whole list or the sessions with one aspId or appId */
+typedef struct msaf_provisioning_session_list_entries_s {
+    char *key;                                        /* index key, NULL for the whole list */
+    msaf_provisioning_session_list_entry_t *entries;
+    size_t count;
+    size_t capacity;
+} msaf_provisioning_session_list_entries_t;
+
+/* Value in the certificate index, holds the key so that it can be freed on removal */
+typedef struct msaf_provisioning_session_list_certificate_s {
+    char *certificate_id;
+    msaf_provisioning_session_t *session;
+} msaf_provisioning_session_list_certificate_t;
+
+typedef struct msaf_provisioning_session_list_buffer_s {
+    char *data;
+    size_t length;
+    size_t size;
+} msaf_provisioning_session_list_buffer_t;
+
+/* Only used from the event loop */
+static struct {
+    msaf_provisioning_session_list_entries_t all;
+    ogs_hash_t *by_asp_id;                            /* aspId -> msaf_provisioning_session_list_entries_t */
+    ogs_hash_t *by_app_id;                            /* appId -> msaf_provisioning_session_list_entries_t */
+    ogs_hash_t *by_certificate_id;                    /* certificate id -> msaf_provisioning_session_list_certificate_t */
+    uint64_t last_seq;
+    char *body;                                       /* cached unfiltered listing, NULL if not rendered yet */
+    size_t body_length;
+} session_list = {{NULL, NULL, 0, 0}, NULL, NULL, NULL, 0, NULL, 0};
+
+static void _invalidate(void);
+static void _entries_append(msaf_provisioning_session_list_entries_t *entries, msaf_provisioning_session_t *session);
+static void _entries_remove(msaf_provisioning_session_list_entries_t *entries, const msaf_provisioning_session_t *session);
+static size_t _first_after(const msaf_provisioning_session_list_entries_t *entries, uint64_t cursor);
+static void _index_add(ogs_hash_t **index, const char *key, msaf_provisioning_session_t *session);
+static void _index_remove(ogs_hash_t *index, const char *key, const msaf_provisioning_session_t *session);
+static const msaf_provisioning_session_list_entries_t *_index_get(ogs_hash_t *index, const char *key);
+static void _index_free(ogs_hash_t **index);
+static const msaf_provisioning_session_list_entries_t *_filter_entries(const msaf_provisioning_session_list_filter_t *filter,
+                                                                      msaf_provisioning_session_list_entries_t *single);
+static bool _matches(const msaf_provisioning_session_t *session, const msaf_provisioning_session_list_filter_t *filter);
+static void _buffer_append(msaf_provisioning_session_list_buffer_t *buffer, const char *str, size_t length);
+static void _buffer_append_query_value(msaf_provisioning_session_list_buffer_t *buffer, const char *value);
+
+/*****************************************************
+ ***** Public functions
+ *****************************************************/
+
+void msaf_provisioning_session_list_add(msaf_provisioning_session_t *session)
+{
+    ogs_assert(session);
+    ogs_assert(session->provisioningSessionId);
+
+    session->list_seq = ++session_list.last_seq;
+    _entries_append(&session_list.all, session);
+    /* aspId and appId are fixed when the provisioning session is created */
+    if (session->aspId) _index_add(&session_list.by_asp_id, session->aspId, session);
+    if (session->appId) _index_add(&session_list.by_app_id, session->appId, session);
+
+    _invalidate();
+}
+
+void msaf_provisioning_session_list_remove(msaf_provisioning_session_t *session)
+{
+    ogs_assert(session);
+
+    if (!session->list_seq) return;
+
+    _entries_remove(&session_list.all, session);
+    if (session->aspId) _index_remove(session_list.by_asp_id, session->aspId, session);
+    if (session->appId) _index_remove(session_list.by_app_id, session->appId, session);
+
+    if (session->certificate_map && session_list.by_certificate_id) {
+        ogs_hash_index_t *hi;
+
+        for (hi = ogs_hash_first(session->certificate_map); hi; hi = ogs_hash_next(hi)) {
+            msaf_provisioning_session_list_certificate_remove((const char*)ogs_hash_this_key(hi));
+        }
+    }
+
+    _invalidate();
+
+    session->list_seq = 0;
+}
+
+size_t msaf_provisioning_session_list_count(void)
+{
+    return session_list.all.count;
+}
+
+void msaf_provisioning_session_list_final(void)
+{
+    _invalidate();
+    if (session_list.all.entries) ogs_free(session_list.all.entries);
+    session_list.all.entries = NULL;
+    session_list.all.count = 0;
+    session_list.all.capacity = 0;
+    _index_free(&session_list.by_asp_id);
+    _index_free(&session_list.by_app_id);
+    if (session_list.by_certificate_id) {
+        ogs_hash_index_t *hi;
+
+        for (hi = ogs_hash_first(session_list.by_certificate_id); hi; hi = ogs_hash_next(hi)) {
+            msaf_provisioning_session_list_certificate_t *certificate = ogs_hash_this_val(hi);
+            ogs_free(certificate->certificate_id);
+            ogs_free(certificate);
+        }
+        ogs_hash_destroy(session_list.by_certificate_id);
+        session_list.by_certificate_id = NULL;
+    }
+}
+
+void msaf_provisioning_session_list_certificate_add(msaf_provisioning_session_t *session, const char *certificate_id)
+{
+    msaf_provisioning_session_list_certificate_t *certificate;
+
+    ogs_assert(session);
+    ogs_assert(certificate_id);
+
+    if (!session_list.by_certificate_id) {
+        session_list.by_certificate_id = ogs_hash_make();
+        ogs_assert(session_list.by_certificate_id);
+    }
+
+    certificate = ogs_hash_get(session_list.by_certificate_id, certificate_id, OGS_HASH_KEY_STRING);
+    if (!certificate) {
+        certificate = ogs_calloc(1, sizeof(*certificate));
+        ogs_assert(certificate);
+        certificate->certificate_id = ogs_strdup(certificate_id);
+        ogs_assert(certificate->certificate_id);
+        ogs_hash_set(session_list.by_certificate_id, certificate->certificate_id, OGS_HASH_KEY_STRING, certificate);
+    }
+    certificate->session = session;
+}
+
+void msaf_provisioning_session_list_certificate_remove(const char *certificate_id)
+{
+    msaf_provisioning_session_list_certificate_t *certificate;
+
+    ogs_assert(certificate_id);
+
+    if (!session_list.by_certificate_id) return;
+
+    certificate = ogs_hash_get(session_list.by_certificate_id, certificate_id, OGS_HASH_KEY_STRING);
+    if (!certificate) return;
+
+    ogs_hash_set(session_list.by_certificate_id, certificate->certificate_id, OGS_HASH_KEY_STRING, NULL);
+    ogs_free(certificate->certificate_id);
+    ogs_free(certificate);
+}
+
+msaf_provisioning_session_t *msaf_provisioning_session_list_find_by_certificate_id(const char *certificate_id)
+{
+    msaf_provisioning_session_list_certificate_t *certificate;
+
+    ogs_assert(certificate_id);
+
+    if (!session_list.by_certificate_id) return NULL;
+
+    certificate = ogs_hash_get(session_list.by_certificate_id, certificate_id, OGS_HASH_KEY_STRING);
+
+    return certificate?certificate->session:NULL;
+}
+
+char *msaf_provisioning_session_list_render(const msaf_provisioning_session_list_filter_t *filter, uint64_t cursor,
+                                            size_t limit, size_t *length, uint64_t *next_cursor)
+{
+    msaf_provisioning_session_list_buffer_t buffer = {NULL, 0, 0};
+    msaf_provisioning_session_list_entry_t single_entry;
+    msaf_provisioning_session_list_entries_t single = {NULL, &single_entry, 0, 1};
+    const msaf_provisioning_session_list_entries_t *entries;
+    bool cacheable;
+    size_t i, listed = 0;
+    uint64_t last_listed = 0;
+    char *body;
+
+    if (next_cursor) *next_cursor = 0;
+
+    if (filter && !filter->asp_id && !filter->app_id && !filter->certificate_id) filter = NULL;
+    if (limit > MSAF_PROVISIONING_SESSION_LIST_MAX_LIMIT) limit = MSAF_PROVISIONING_SESSION_LIST_MAX_LIMIT;
+
+    cacheable = !filter && !cursor && (!limit || limit >= session_list.all.count);
+
+    if (!cacheable || !session_list.body) {
+        /* only the sessions in the smallest matching index are looked at */
+        entries = _filter_entries(filter, &single);
+
+        /* one pass, each id is copied once into a buffer that grows geometrically */
+        _buffer_append(&buffer, "[", 1);
+        for (i = _first_after(entries, cursor); i < entries->count; i++) {
+            const msaf_provisioning_session_t *session = entries->entries[i].session;
+
+            if (!_matches(session, filter)) continue;
+
+            if (limit && listed == limit) {
+                /* there is at least one more to list */
+                if (next_cursor) *next_cursor = last_listed;
+                break;
+            }
+
+            if (listed) _buffer_append(&buffer, ", ", 2);
+            _buffer_append(&buffer, "\"", 1);
+            _buffer_append(&buffer, session->provisioningSessionId, strlen(session->provisioningSessionId));
+            _buffer_append(&buffer, "\"", 1);
+            last_listed = entries->entries[i].seq;
+            listed++;
+        }
+        _buffer_append(&buffer, "]", 1);
+
+        if (!cacheable) {
+            if (length) *length = buffer.length;
+            return buffer.data;
+        }
+
+        session_list.body = buffer.data;
+        session_list.body_length = buffer.length;
+    }
+
+    body = ogs_malloc(session_list.body_length + 1);
+    ogs_assert(body);
+    memcpy(body, session_list.body, session_list.body_length + 1);
+    if (length) *length = session_list.body_length;
+
+    return body;
+}
+
+bool msaf_provisioning_session_list_cursor_parse(const char *str, uint64_t *cursor)
+{
+    unsigned long long value;
+    char *end = NULL;
+
+    ogs_assert(str);
+    ogs_assert(cursor);
+
+    if (*str < '0' || *str > '9') return false;
+
+    errno = 0;
+    value = strtoull(str, &end, 10);
+    if (errno || !end || *end) return false;
+
+    *cursor = value;
+
+    return true;
+}
+
+char *msaf_provisioning_session_list_next_link(const msaf_provisioning_session_list_filter_t *filter, size_t limit,
+                                               uint64_t next_cursor)
+{
+    msaf_provisioning_session_list_buffer_t buffer = {NULL, 0, 0};
+    char *params;
+
+    params = ogs_msprintf("<?limit=%zu&cursor=%llu", limit, (unsigned long long)next_cursor);
+    ogs_assert(params);
+    _buffer_append(&buffer, params, strlen(params));
+    ogs_free(params);
+
+    if (filter && filter->asp_id) {
+        _buffer_append(&buffer, "&aspId=", 7);
+        _buffer_append_query_value(&buffer, filter->asp_id);
+    }
+    if (filter && filter->app_id) {
+        _buffer_append(&buffer, "&appId=", 7);
+        _buffer_append_query_value(&buffer, filter->app_id);
+    }
+    if (filter && filter->certificate_id) {
+        _buffer_append(&buffer, "&certificateId=", 15);
+        _buffer_append_query_value(&buffer, filter->certificate_id);
+    }
+
+    _buffer_append(&buffer, ">; rel=\"next\"", 13);
+
+    return buffer.data;
+}
+
+/*****************************************************
+ ***** Private functions
+ *****************************************************/
+
+static void _invalidate(void)
+{
+    if (session_list.body) ogs_free(session_list.body);
+    session_list.body = NULL;
+    session_list.body_length = 0;
+}
+
+static void _entries_append(msaf_provisioning_session_list_entries_t *entries, msaf_provisioning_session_t *session)
+{
+    /* sessions are added in seq order, so appending keeps the entries sorted */
+    if (entries->count == entries->capacity) {
+        size_t capacity = entries->capacity?entries->capacity*2:(entries->key?4:64);
+        entries->entries = ogs_realloc(entries->entries, capacity * sizeof(*entries->entries));
+        ogs_assert(entries->entries);
+        entries->capacity = capacity;
+    }
+
+    entries->entries[entries->count].seq = session->list_seq;
+    entries->entries[entries->count].session = session;
+    entries->count++;
+}
+
+static void _entries_remove(msaf_provisioning_session_list_entries_t *entries, const msaf_provisioning_session_t *session)
+{
+    size_t i = _first_after(entries, session->list_seq - 1);
+
+    if (i < entries->count && entries->entries[i].session == session) {
+        memmove(&entries->entries[i], &entries->entries[i+1], (entries->count - i - 1) * sizeof(*entries->entries));
+        entries->count--;
+    }
+}
+
+/* Index of the first entry with a seq greater than cursor */
+static size_t _first_after(const msaf_provisioning_session_list_entries_t *entries, uint64_t cursor)
+{
+    size_t low = 0, high = entries->count;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (entries->entries[mid].seq <= cursor) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+static void _index_add(ogs_hash_t **index, const char *key, msaf_provisioning_session_t *session)
+{
+    msaf_provisioning_session_list_entries_t *entries;
+
+    if (!*index) {
+        *index = ogs_hash_make();
+        ogs_assert(*index);
+    }
+
+    entries = ogs_hash_get(*index, key, OGS_HASH_KEY_STRING);
+    if (!entries) {
+        entries = ogs_calloc(1, sizeof(*entries));
+        ogs_assert(entries);
+        entries->key = ogs_strdup(key);
+        ogs_assert(entries->key);
+        ogs_hash_set(*index, entries->key, OGS_HASH_KEY_STRING, entries);
+    }
+
+    _entries_append(entries, session);
+}
+
+static void _index_remove(ogs_hash_t *index, const char *key, const msaf_provisioning_session_t *session)
+{
+    msaf_provisioning_session_list_entries_t *entries;
+
+    if (!index) return;
+
+    entries = ogs_hash_get(index, key, OGS_HASH_KEY_STRING);
+    if (!entries) return;
+
+    _entries_remove(entries, session);
+
+    if (!entries->count) {
+        ogs_hash_set(index, entries->key, OGS_HASH_KEY_STRING, NULL);
+        ogs_free(entries->key);
+        if (entries->entries) ogs_free(entries->entries);
+        ogs_free(entries);
+    }
+}
+
+static const msaf_provisioning_session_list_entries_t *_index_get(ogs_hash_t *index, const char *key)
+{
+    if (!index) return NULL;
+
+    return ogs_hash_get(index, key, OGS_HASH_KEY_STRING);
+}
+
+static void _index_free(ogs_hash_t **index)
+{
+    ogs_hash_index_t *hi;
+
+    if (!*index) return;
+
+    for (hi = ogs_hash_first(*index); hi; hi = ogs_hash_next(hi)) {
+        msaf_provisioning_session_list_entries_t *entries = ogs_hash_this_val(hi);
+        ogs_free(entries->key);
+        if (entries->entries) ogs_free(entries->entries);
+        ogs_free(entries);
+    }
+    ogs_hash_destroy(*index);
+    *index = NULL;
+}
+
+/* The entries to look through for a filter, single provides the storage for a one entry result */
+static const msaf_provisioning_session_list_entries_t *_filter_entries(const msaf_provisioning_session_list_filter_t *filter,
+                                                                      msaf_provisioning_session_list_entries_t *single)
+{
+    static const msaf_provisioning_session_list_entries_t no_entries = {NULL, NULL, 0, 0};
+    const msaf_provisioning_session_list_entries_t *asp_entries = NULL, *app_entries = NULL;
+
+    if (!filter) return &session_list.all;
+
+    if (filter->certificate_id) {
+        msaf_provisioning_session_t *session = msaf_provisioning_session_list_find_by_certificate_id(filter->certificate_id);
+
+        if (!session) return &no_entries;
+        single->entries[0].seq = session->list_seq;
+        single->entries[0].session = session;
+        single->count = 1;
+        return single;
+    }
+
+    if (filter->asp_id) {
+        asp_entries = _index_get(session_list.by_asp_id, filter->asp_id);
+        if (!asp_entries) return &no_entries;
+    }
+    if (filter->app_id) {
+        app_entries = _index_get(session_list.by_app_id, filter->app_id);
+        if (!app_entries) return &no_entries;
+    }
+
+    if (asp_entries && app_entries) return (asp_entries->count <= app_entries->count)?asp_entries:app_entries;
+
+    return asp_entries?asp_entries:app_entries;
+}
+
+static bool _matches(const msaf_provisioning_session_t *session, const msaf_provisioning_session_list_filter_t *filter)
+{
+    if (!filter) return true;
+
+    if (filter->asp_id && (!session->aspId || strcmp(session->aspId, filter->asp_id))) return false;
+    if (filter->app_id && (!session->appId || strcmp(session->appId, filter->app_id))) return false;
+    if (filter->certificate_id && (!session->certificate_map ||
+                !ogs_hash_get(session->certificate_map, filter->certificate_id, OGS_HASH_KEY_STRING))) return false;
+
+    return true;
+}
+
+static void _buffer_append(msaf_provisioning_session_list_buffer_t *buffer, const char *str, size_t length)
+{
+    if (buffer->length + length + 1 > buffer->size) {
+        size_t size = buffer->size?buffer->size:256;
+        while (buffer->length + length + 1 > size) size *= 2;
+        buffer->data = ogs_realloc(buffer->data, size);
+        ogs_assert(buffer->data);
+        buffer->size = size;
+    }
+
+    memcpy(buffer->data + buffer->length, str, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+}
+
+static void _buffer_append_query_value(msaf_provisioning_session_list_buffer_t *buffer, const char *value)
+{
+    static const char hex[] = "0123456789ABCDEF";
+
+    for (; *value; value++) {
+        unsigned char c = (unsigned char)*value;
+
+        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || strchr("-._~", c)) {
+            _buffer_append(buffer, value, 1);
+        } else {
+            char escaped[3] = {'%', hex[c >> 4], hex[c & 0xf]};
+            _buffer_append(buffer, escaped, 3);
+        }
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,75 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#ifndef MSAF_PROVISIONING_SESSION_LIST_H
+#define MSAF_PROVISIONING_SESSION_LIST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ogs-core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The provisioning sessions in creation order, for the management interface listing. Each provisioning session is given a
+ * sequence number when it is added, which is used as the pagination cursor so that a cursor stays valid when provisioning
+ * sessions are deleted. The unfiltered listing is rendered once and kept until a provisioning session is added or removed.
+ *
+ * The provisioning sessions are also indexed by aspId, appId and certificate id, so that finding them, or listing them with
+ * a filter, only looks at the provisioning sessions that can match.
+ */
+
+typedef struct msaf_provisioning_session_s msaf_provisioning_session_t;
+
+typedef struct msaf_provisioning_session_list_filter_s {
+    const char *asp_id;           /* only list provisioning sessions with this aspId, NULL for any */
+    const char *app_id;           /* only list provisioning sessions with this appId, NULL for any */
+    const char *certificate_id;   /* only list the provisioning session with this certificate, NULL for any */
+} msaf_provisioning_session_list_filter_t;
+
+/* Largest page that will be returned, larger limits are reduced to this */
+#define MSAF_PROVISIONING_SESSION_LIST_MAX_LIMIT 10000
+
+extern void msaf_provisioning_session_list_add(msaf_provisioning_session_t *session /* [no-transfer, not-null] */);
+extern void msaf_provisioning_session_list_remove(msaf_provisioning_session_t *session /* [no-transfer, not-null] */);
+extern size_t msaf_provisioning_session_list_count(void);
+extern void msaf_provisioning_session_list_final(void);
+
+/* Keep the certificate index up to date as certificates are added to and removed from provisioning sessions */
+extern void msaf_provisioning_session_list_certificate_add(msaf_provisioning_session_t *session /* [no-transfer, not-null] */,
+                                                           const char *certificate_id /* [not-null] */);
+extern void msaf_provisioning_session_list_certificate_remove(const char *certificate_id /* [not-null] */);
+/* The provisioning session that has the certificate, or NULL */
+extern msaf_provisioning_session_t *msaf_provisioning_session_list_find_by_certificate_id(const char *certificate_id /* [not-null] */);
+
+/* Render the JSON array of provisioning session ids that match filter, starting after the cursor position (0 for the
+ * start) and with at most limit entries (0 for no limit). *next_cursor is set to the cursor for the following page, or 0
+ * if this is the last page. Returns an ogs_malloc'd string. */
+extern char *msaf_provisioning_session_list_render(const msaf_provisioning_session_list_filter_t *filter /* [null] */,
+                                                   uint64_t cursor, size_t limit, size_t *length /* [out, null] */,
+                                                   uint64_t *next_cursor /* [out, null] */);
+
+/* Parse a cursor query parameter value, returns false if it is not a cursor */
+extern bool msaf_provisioning_session_list_cursor_parse(const char *str /* [not-null] */, uint64_t *cursor /* [out, not-null] */);
+
+/* Link header value for the next page, for a listing with the same filter and limit. Returns an ogs_malloc'd string. */
+extern char *msaf_provisioning_session_list_next_link(const msaf_provisioning_session_list_filter_t *filter /* [null] */,
+                                                      size_t limit, uint64_t next_cursor);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
+
+#endif /* MSAF_PROVISIONING_SESSION_LIST_H */
@@ -13,8 +13,14 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #include "certmgr.h"
 #include "consumption-report-configuration.h"
 #include "context.h"
+#include "data-collection.h"
 #include "utilities.h"
 #include "hash.h"
+#include "json-format.h"
+#include "json-reader.h"
+#include "json-writer.h"
+#include "model-arena.h"
+#include "provisioning-session-list.h"
 #include "sai-cache.h"
 
 #include "openapi/model/msaf_api_consumption_reporting_configuration.h"
@@ -53,9 +59,14 @@ static int free_ogs_hash_provisioning_session(void *rec, const void *key, int kl
 static int free_ogs_hash_provisioning_session_certificate(void *rec, const void *key, int klen, const void *value);
 static char* url_path_create(const char* macro, const char* session_id, const msaf_application_server_node_t *msaf_as);
 static void tidy_relative_path_re(void);
-static char *calculate_provisioning_session_hash(msaf_api_provisioning_session_t *provisioning_session);
 static ogs_hash_t *msaf_certificate_map();
+static bool _as_certificate_id_is_for_session(const char *as_certificate_id, const char *provisioning_session_id, size_t provisioning_session_id_len);
 static ogs_hash_t *msaf_policy_templates_new(void);
+static msaf_api_provisioning_session_t *_api_provisioning_session_new(msaf_provisioning_session_t *msaf_provisioning_session,
+                                                                       msaf_model_arena_t **arena_out);
+static bool _write_provisioning_session(msaf_json_writer_t *writer, const void *provisioning_session);
+static bool _write_content_hosting_configuration(msaf_json_writer_t *writer, const void *content_hosting_configuration);
+static bool _content_hosting_configuration_check(msaf_api_content_hosting_configuration_t *content_hosting_configuration, const char **reason_ret);
 
 static msaf_policy_template_change_state_event_data_t *msaf_policy_template_change_state_event_data_populate(msaf_provisioning_session_t *provisioning_session,  msaf_policy_template_node_t *policy_template, msaf_api_policy_template_state_e new_state, msaf_policy_template_state_change_callback callback, void *user_data);
 
@@ -94,16 +105,26 @@ msaf_content_hosting_configuration_with_af_unique_cert_id(msaf_provisioning_sess
 msaf_provisioning_session_t *
 msaf_provisioning_session_create(const char *provisioning_session_type, const char *asp_id, const char *external_app_id)
 {
-    msaf_provisioning_session_t *msaf_provisioning_session;
     ogs_uuid_t uuid;
     char id[OGS_UUID_FORMATTED_LENGTH + 1];
+
+    ogs_uuid_get(&uuid);
+    ogs_uuid_format(id, &uuid);
+
+    return msaf_provisioning_session_create_with_id(id, provisioning_session_type, asp_id, external_app_id);
+}
+
+msaf_provisioning_session_t *
+msaf_provisioning_session_create_with_id(const char *provisioning_session_id, const char *provisioning_session_type, const char *asp_id, const char *external_app_id)
+{
+    msaf_provisioning_session_t *msaf_provisioning_session;
     msaf_api_provisioning_session_t *provisioning_session;
     char *prov_sess_type;
 
+    ogs_assert(provisioning_session_id);
+
     prov_sess_type = msaf_strdup(provisioning_session_type);
-    ogs_uuid_get(&uuid);
-    ogs_uuid_format(id, &uuid);
-    provisioning_session = msaf_api_provisioning_session_create(msaf_strdup(id), msaf_api_provisioning_session_type_FromString(prov_sess_type), msaf_strdup(asp_id), msaf_strdup(external_app_id), NULL, NULL, NULL, NULL, NULL, NULL);
+    provisioning_session = msaf_api_provisioning_session_create(msaf_strdup(provisioning_session_id), msaf_api_provisioning_session_type_FromString(prov_sess_type), msaf_strdup(asp_id), msaf_strdup(external_app_id), NULL, NULL, NULL, NULL, NULL, NULL);
     ogs_free(prov_sess_type);
 
     msaf_provisioning_session = ogs_calloc(1, sizeof(msaf_provisioning_session_t));
@@ -113,11 +134,13 @@ msaf_provisioning_session_create(const char *provisioning_session_type, const ch
     msaf_provisioning_session->aspId = msaf_strdup(provisioning_session->asp_id);
     msaf_provisioning_session->appId = msaf_strdup(provisioning_session->app_id);
     msaf_provisioning_session->httpMetadata.provisioningSession.received = time(NULL);
-    msaf_provisioning_session->httpMetadata.provisioningSession.hash = calculate_provisioning_session_hash(provisioning_session);
+    /* httpMetadata.provisioningSession.hash is set when the body is first rendered */
 
     msaf_provisioning_session->certificate_map = msaf_certificate_map();
     msaf_provisioning_session->policy_templates = msaf_policy_templates_new();
+    msaf_provisioning_session->metrics_reporting_configurations = msaf_metrics_reporting_configurations_new();
     ogs_hash_set(msaf_self()->provisioningSessions_map, msaf_strdup(msaf_provisioning_session->provisioningSessionId), OGS_HASH_KEY_STRING, msaf_provisioning_session);
+    msaf_provisioning_session_list_add(msaf_provisioning_session);
 
     msaf_api_provisioning_session_free(provisioning_session);
 
@@ -132,6 +155,8 @@ void msaf_provisioning_session_free(msaf_provisioning_session_t *provisioning_se
 
     ogs_debug("msaf_provisioning_session_free(%p) [%s]", provisioning_session, provisioning_session->provisioningSessionId);
 
+    msaf_provisioning_session_list_remove(provisioning_session);
+
     if (provisioning_session->certificate_map) {
         free_ogs_hash_context_t fohc = {
             safe_ogs_free,
@@ -140,15 +165,20 @@ void msaf_provisioning_session_free(msaf_provisioning_session_t *provisioning_se
         ogs_hash_do(free_ogs_hash_entry, &fohc, provisioning_session->certificate_map);
         ogs_hash_destroy(provisioning_session->certificate_map);
     }
+    msaf_data_collection_provisioning_session_closed(provisioning_session->provisioningSessionId);
     safe_ogs_free(provisioning_session->provisioningSessionId);
     safe_ogs_free(provisioning_session->aspId);
     safe_ogs_free(provisioning_session->appId);
     safe_ogs_free(provisioning_session->httpMetadata.provisioningSession.hash);
+    msaf_content_variant_clear(&provisioning_session->httpMetadata.provisioningSession.identity);
     if (provisioning_session->contentHostingConfiguration) {
         msaf_api_content_hosting_configuration_free(provisioning_session->contentHostingConfiguration);
     }
     safe_ogs_free(provisioning_session->httpMetadata.contentHostingConfiguration.hash);
+    msaf_content_variant_clear(&provisioning_session->httpMetadata.contentHostingConfiguration.identity);
+    msaf_content_variant_clear(&provisioning_session->httpMetadata.contentHostingConfiguration.gzip);
     msaf_consumption_report_configuration_deregister(provisioning_session);
+    msaf_consumption_statistics_free(provisioning_session->consumption_statistics);
 
     if(provisioning_session->sai_cache)
         msaf_sai_cache_free(provisioning_session->sai_cache);
@@ -156,6 +186,8 @@ void msaf_provisioning_session_free(msaf_provisioning_session_t *provisioning_se
     if(provisioning_session->policy_templates) 
         msaf_provisioning_session_policy_template_free(provisioning_session->policy_templates);
 
+    msaf_metrics_reporting_configurations_free(provisioning_session->metrics_reporting_configurations);
+
     ogs_list_for_each_safe(&provisioning_session->application_server_states, next_as_state_ref, as_state_ref) {
         ogs_list_remove(&provisioning_session->application_server_states, as_state_ref);
         ogs_free(as_state_ref);
@@ -175,40 +207,61 @@ msaf_provisioning_session_get_json(const char *provisioning_session_id)
 
     if (msaf_provisioning_session) {
         msaf_api_provisioning_session_t *provisioning_session;
-        ogs_hash_index_t *cert_node;
+        msaf_model_arena_t *arena;
 
-        provisioning_session = ogs_calloc(1,sizeof(*provisioning_session));
-        ogs_assert(provisioning_session);
+        provisioning_session = _api_provisioning_session_new(msaf_provisioning_session, &arena);
+        provisioning_session_json = msaf_api_provisioning_session_convertResponseToJSON(provisioning_session);
+        msaf_model_arena_free(arena);
+    } else {
+        ogs_error("Unable to retrieve Provisioning Session [%s]", provisioning_session_id);
+    }
+    return provisioning_session_json;
+}
 
-        provisioning_session->provisioning_session_id = msaf_provisioning_session->provisioningSessionId;
-        provisioning_session->provisioning_session_type = msaf_provisioning_session->provisioningSessionType;
-        provisioning_session->asp_id = msaf_provisioning_session->aspId;
-        provisioning_session->app_id = msaf_provisioning_session->appId;
+void msaf_provisioning_session_changed(msaf_provisioning_session_t *provisioning_session)
+{
+    ogs_assert(provisioning_session);
 
-        provisioning_session->server_certificate_ids = (OpenAPI_set_t*)OpenAPI_list_create();
-        for (cert_node=ogs_hash_first(msaf_provisioning_session->certificate_map); cert_node; cert_node=ogs_hash_next(cert_node)) {
-            ogs_debug("msaf_provisioning_session_get_json: Add cert %s", (const char *)ogs_hash_this_key(cert_node));
-            OpenAPI_list_add(provisioning_session->server_certificate_ids, (void*)ogs_hash_this_key(cert_node));
-        }
+    provisioning_session->httpMetadata.provisioningSession.received = time(NULL);
+    safe_ogs_free(provisioning_session->httpMetadata.provisioningSession.hash);
+    provisioning_session->httpMetadata.provisioningSession.hash = NULL;
+    msaf_content_variant_clear(&provisioning_session->httpMetadata.provisioningSession.identity);
+}
 
-        if (msaf_provisioning_session->policy_templates && ogs_hash_first(msaf_provisioning_session->policy_templates) != NULL) {
-            ogs_hash_index_t *pol_node;
-            provisioning_session->policy_template_ids = (OpenAPI_set_t*)OpenAPI_list_create();
-            for (pol_node=ogs_hash_first(msaf_provisioning_session->policy_templates); pol_node; pol_node=ogs_hash_next(pol_node)) {
-                ogs_debug("msaf_provisioning_session_get_json: Add policy template %s", (const char *)ogs_hash_this_key(pol_node));
-                OpenAPI_list_add(provisioning_session->policy_template_ids, (void*)ogs_hash_this_key(pol_node));
-            }
-        }
+const char *msaf_provisioning_session_etag(msaf_provisioning_session_t *provisioning_session)
+{
+    msaf_http_metadata_t *metadata;
 
-        provisioning_session_json = msaf_api_provisioning_session_convertResponseToJSON(provisioning_session);
+    ogs_assert(provisioning_session);
 
-        OpenAPI_list_free(provisioning_session->server_certificate_ids);
-        OpenAPI_list_free(provisioning_session->policy_template_ids);
-        ogs_free(provisioning_session);
-    } else {
-        ogs_error("Unable to retrieve Provisioning Session [%s]", provisioning_session_id);
+    metadata = &provisioning_session->httpMetadata.provisioningSession;
+    if (!metadata->hash || !msaf_content_variant_is_current(&metadata->identity, metadata->hash)) {
+        msaf_api_provisioning_session_t *api_provisioning_session;
+        msaf_model_arena_t *arena;
+        char *body;
+        size_t length;
+
+        safe_ogs_free(metadata->hash);
+        metadata->hash = NULL;
+
+        api_provisioning_session = _api_provisioning_session_new(provisioning_session, &arena);
+        body = msaf_json_write_with_hash(_write_provisioning_session, api_provisioning_session, metadata->identity.length,
+                                         &length, &metadata->hash);
+        msaf_model_arena_free(arena);
+        if (!body) return NULL;
+
+        msaf_content_variant_set(&metadata->identity, body, length, metadata->hash);
+        ogs_free(body);
     }
-    return provisioning_session_json;
+
+    return metadata->hash;
+}
+
+char *msaf_provisioning_session_body(msaf_provisioning_session_t *provisioning_session)
+{
+    if (!msaf_provisioning_session_etag(provisioning_session)) return NULL;
+
+    return msaf_content_variant_copy(&provisioning_session->httpMetadata.provisioningSession.identity);
 }
 
 int
@@ -247,6 +300,7 @@ void
 msaf_delete_certificates(const char *provisioning_session_id)
 {
     msaf_application_server_state_node_t *as_state;
+    size_t provisioning_session_id_len = strlen(provisioning_session_id);
 
     ogs_list_for_each(&msaf_self()->application_server_states, as_state) {
         resource_id_node_t *upload_certificate, *next_node;
@@ -256,13 +310,7 @@ msaf_delete_certificates(const char *provisioning_session_id)
             resource_id_node_t *certificate, *next;
 
             ogs_list_for_each_safe(as_state->current_certificates, next, certificate){
-                char *cert_id;
-                char *provisioning_session;
-                char *current_cert_id = msaf_strdup(certificate->state);
-
-                provisioning_session = strtok_r(current_cert_id,":",&cert_id);
-
-                if(!strcmp(provisioning_session, provisioning_session_id)) {
+                if (_as_certificate_id_is_for_session(certificate->state, provisioning_session_id, provisioning_session_id_len)) {
                     /* provisioning session matches */
                     resource_id_node_t *delete_cert;
                     delete_cert = ogs_calloc(1, sizeof(resource_id_node_t));
@@ -270,24 +318,15 @@ msaf_delete_certificates(const char *provisioning_session_id)
                     delete_cert->state = msaf_strdup(certificate->state);
                     ogs_list_add(&as_state->delete_certificates, delete_cert);
                 }
-
-                if(current_cert_id)
-                    ogs_free(current_cert_id);
             }
         }
 
         /* remove entries from upload queue and try to delete just to be safe */
         ogs_list_for_each_safe(&as_state->upload_certificates, next_node, upload_certificate) {
-            char *cert_id;
-            char *upload_cert_id = msaf_strdup(upload_certificate->state);
-            char *provisioning_session = strtok_r(upload_cert_id,":",&cert_id);
-
-            if (!strcmp(provisioning_session, provisioning_session_id)) {
+            if (_as_certificate_id_is_for_session(upload_certificate->state, provisioning_session_id, provisioning_session_id_len)) {
                 ogs_list_remove(&as_state->upload_certificates, upload_certificate);
                 ogs_list_add(&as_state->delete_certificates, upload_certificate);
             }
-            if (upload_cert_id)
-                ogs_free(upload_cert_id);
         }
     }
 }
@@ -345,6 +384,12 @@ msaf_provisioning_session_find_by_provisioningSessionId(const char *provisioning
     return (msaf_provisioning_session_t*) ogs_hash_get(msaf_self()->provisioningSessions_map, provisioningSessionId, OGS_HASH_KEY_STRING);
 }
 
+msaf_provisioning_session_t *
+msaf_provisioning_session_find_by_certificate_id(const char *certificate_id)
+{
+    return msaf_provisioning_session_list_find_by_certificate_id(certificate_id);
+}
+
 msaf_policy_template_node_t *
 msaf_provisioning_session_find_policy_template_by_id(msaf_provisioning_session_t *provisioning_session, const char *policy_template_id)
 {
@@ -416,8 +461,97 @@ msaf_retrieve_certificates_from_map(msaf_provisioning_session_t *provisioning_se
     return certs;
 }
 
+msaf_api_content_hosting_configuration_t *
+msaf_content_hosting_configuration_parse(cJSON *content_hosting_config, const char **reason_ret)
+{
+    msaf_api_content_hosting_configuration_t *content_hosting_configuration;
+
+    content_hosting_configuration = msaf_api_content_hosting_configuration_parseRequestFromJSON(content_hosting_config, reason_ret);
+
+    if (!content_hosting_configuration) {
+        if (reason_ret) {
+            ogs_error("JSON validation of ContentHostingConfiguration failed: %s", *reason_ret);
+        } else {
+            ogs_error("JSON validation of ContentHostingConfiguration failed");
+        }
+        return NULL;
+    }
+
+    if (!_content_hosting_configuration_check(content_hosting_configuration, reason_ret)) {
+        msaf_api_content_hosting_configuration_free(content_hosting_configuration);
+        return NULL;
+    }
+
+    return content_hosting_configuration;
+}
+
+msaf_api_content_hosting_configuration_t *
+msaf_content_hosting_configuration_parse_body(const char *body, size_t length, bool *syntax_error, const char **reason_ret)
+{
+    msaf_json_reader_t reader;
+    msaf_api_content_hosting_configuration_t *content_hosting_configuration;
+    const char *reason = NULL;
+
+    ogs_assert(body);
+
+    if (syntax_error) *syntax_error = false;
+
+    msaf_json_reader_init(&reader, body, length);
+    msaf_json_reader_next(&reader);
+    content_hosting_configuration = msaf_api_content_hosting_configuration_parseRequestFromJSONReader(&reader, &reason);
+
+    /* nothing but whitespace may follow the ContentHostingConfiguration */
+    if (content_hosting_configuration && msaf_json_reader_next(&reader) != MSAF_JSON_TOKEN_END) {
+        msaf_api_content_hosting_configuration_free(content_hosting_configuration);
+        content_hosting_configuration = NULL;
+    }
+
+    if (!content_hosting_configuration) {
+        if (reader.error) {
+            reason = reader.error;
+            if (syntax_error) *syntax_error = true;
+            ogs_error("ContentHostingConfiguration is not valid JSON: %s", reason);
+        } else {
+            ogs_error("JSON validation of ContentHostingConfiguration failed: %s", reason);
+        }
+        if (reason_ret) *reason_ret = reason;
+        return NULL;
+    }
+
+    if (!_content_hosting_configuration_check(content_hosting_configuration, reason_ret)) {
+        msaf_api_content_hosting_configuration_free(content_hosting_configuration);
+        return NULL;
+    }
+
+    return content_hosting_configuration;
+}
+
 int
 msaf_distribution_create(cJSON *content_hosting_config, msaf_provisioning_session_t *provisioning_session, const char **reason_ret)
+{
+    msaf_api_content_hosting_configuration_t *content_hosting_configuration
+        = msaf_content_hosting_configuration_parse(content_hosting_config, reason_ret);
+
+    cJSON_Delete(content_hosting_config);
+
+    if (!content_hosting_configuration) return 0;
+
+    return msaf_distribution_create_from_model(content_hosting_configuration, provisioning_session);
+}
+
+int
+msaf_distribution_create_from_model(msaf_api_content_hosting_configuration_t *content_hosting_configuration,
+                                    msaf_provisioning_session_t *provisioning_session)
+{
+    msaf_content_hosting_configuration_diff_t diff;
+
+    return msaf_distribution_update_from_model(content_hosting_configuration, provisioning_session, &diff);
+}
+
+int
+msaf_distribution_update_from_model(msaf_api_content_hosting_configuration_t *content_hosting_configuration,
+                                    msaf_provisioning_session_t *provisioning_session,
+                                    msaf_content_hosting_configuration_diff_t *diff)
 {
     OpenAPI_lnode_t *dist_config_node = NULL;
     msaf_api_distribution_configuration_t *dist_config = NULL;
@@ -425,50 +559,19 @@ msaf_distribution_create(cJSON *content_hosting_config, msaf_provisioning_sessio
     char *domain_name;
     static const char macro[] = "{provisioningSessionId}";
     msaf_application_server_node_t *msaf_as = NULL;
-    char *content_hosting_config_to_hash = NULL;
+
+    ogs_assert(content_hosting_configuration);
 
     msaf_as = ogs_list_first(&msaf_self()->config.applicationServers_list);
 
     url_path = url_path_create(macro, provisioning_session->provisioningSessionId, msaf_as);
 
-    msaf_api_content_hosting_configuration_t *content_hosting_configuration
-        = msaf_api_content_hosting_configuration_parseRequestFromJSON(content_hosting_config, reason_ret);
-
-    if (!content_hosting_configuration) {
-        if (reason_ret) {
-            ogs_error("JSON validation of ContentHostingConfiguration failed: %s", *reason_ret);
-        } else {
-            ogs_error("JSON validation of ContentHostingConfiguration failed");
-        }
-        cJSON_Delete(content_hosting_config);
-        ogs_free(url_path);
-        return 0;
-    }
-
     if (content_hosting_configuration->distribution_configurations) {
         OpenAPI_list_for_each(content_hosting_configuration->distribution_configurations, dist_config_node) {
             char *protocol = "http";
 
             dist_config = (msaf_api_distribution_configuration_t*)dist_config_node->data;
 
-            if(dist_config->entry_point && !uri_relative_check(dist_config->entry_point->relative_path)) {
-                if (reason_ret) *reason_ret = "distributionConfiguration.entryPoint.relativePath malformed";
-                ogs_error("distributionConfiguration.entryPoint.relativePath malformed for Provisioning Session [%s]", provisioning_session->provisioningSessionId);
-                cJSON_Delete(content_hosting_config);
-                ogs_free(url_path);
-                if (content_hosting_configuration) msaf_api_content_hosting_configuration_free(content_hosting_configuration);
-                return 0;
-            }
-
-            if (dist_config->entry_point && dist_config->entry_point->profiles && dist_config->entry_point->profiles->first == NULL) {
-                if (reason_ret) *reason_ret = "distributionConfiguration.entryPoint.profiles present but empty";
-                ogs_error("distributionConfiguration.entryPoint.profiles present but empty for Provisioning Session [%s]", provisioning_session->provisioningSessionId);
-                cJSON_Delete(content_hosting_config);
-                ogs_free(url_path);
-                if (content_hosting_configuration) msaf_api_content_hosting_configuration_free(content_hosting_configuration);
-                return 0;
-            }
-
             if (dist_config->canonical_domain_name) ogs_free(dist_config->canonical_domain_name);
 
             dist_config->canonical_domain_name = msaf_strdup(msaf_as->canonicalHostname);
@@ -491,28 +594,62 @@ msaf_distribution_create(cJSON *content_hosting_config, msaf_provisioning_sessio
         ogs_error("The Content Hosting Configuration has no distributionConfigurations for Provisioning Session [%s]", provisioning_session->provisioningSessionId);
     }
 
-    /* reset Service Access Information cache */
-    msaf_sai_cache_clear(provisioning_session->sai_cache);
+    ogs_free(url_path);
+
+    /* compare with the generated fields filled in, as the configuration is served and sent to the Application Servers */
+    msaf_content_hosting_configuration_diff(diff, provisioning_session->contentHostingConfiguration, content_hosting_configuration);
+    msaf_content_hosting_configuration_diff_log(diff, provisioning_session->provisioningSessionId);
+
+    /* same configuration again, keep the current one along with its ETag and Last-Modified */
+    if (!diff->changed) {
+        msaf_api_content_hosting_configuration_free(content_hosting_configuration);
+        return 1;
+    }
+
+    /* the entry points are the only part of the configuration in the Service Access Information, new generation once the
+     * new configuration is in place */
+    if (diff->entry_points_changed)
+        msaf_context_service_access_information_invalidate(provisioning_session);
 
     if (provisioning_session->contentHostingConfiguration)
         msaf_api_content_hosting_configuration_free(provisioning_session->contentHostingConfiguration);
     provisioning_session->contentHostingConfiguration = content_hosting_configuration;
-    if (provisioning_session->contentHostingConfiguration)
-    {
-        content_hosting_config_to_hash = cJSON_Print(content_hosting_config);
-        provisioning_session->httpMetadata.contentHostingConfiguration.received = time(NULL);
 
-        if (provisioning_session->httpMetadata.contentHostingConfiguration.hash)
-            ogs_free(provisioning_session->httpMetadata.contentHostingConfiguration.hash);
-        provisioning_session->httpMetadata.contentHostingConfiguration.hash = calculate_hash(content_hosting_config_to_hash);
-        cJSON_free(content_hosting_config_to_hash);
-    }
-    ogs_free(url_path);
-    cJSON_Delete(content_hosting_config);
+    provisioning_session->httpMetadata.contentHostingConfiguration.received = time(NULL);
+
+    /* the ETag is over the representation served on M1, which includes the generated fields */
+    if (provisioning_session->httpMetadata.contentHostingConfiguration.hash)
+        ogs_free(provisioning_session->httpMetadata.contentHostingConfiguration.hash);
+    provisioning_session->httpMetadata.contentHostingConfiguration.hash =
+                    msaf_json_write_hash(_write_content_hosting_configuration, content_hosting_configuration, 0);
 
     return 1;
 }
 
+char *msaf_content_hosting_configuration_body(msaf_provisioning_session_t *provisioning_session)
+{
+    msaf_http_metadata_t *metadata;
+
+    ogs_assert(provisioning_session);
+
+    if (!provisioning_session->contentHostingConfiguration) return NULL;
+
+    metadata = &provisioning_session->httpMetadata.contentHostingConfiguration;
+    if (!msaf_content_variant_is_current(&metadata->identity, metadata->hash)) {
+        char *body;
+        size_t length;
+
+        body = msaf_json_write(_write_content_hosting_configuration, provisioning_session->contentHostingConfiguration,
+                               metadata->identity.length, &length);
+        if (!body) return NULL;
+
+        msaf_content_variant_set(&metadata->identity, body, length, metadata->hash);
+        ogs_free(body);
+    }
+
+    return msaf_content_variant_copy(&metadata->identity);
+}
+
 cJSON *msaf_get_content_hosting_configuration_by_provisioning_session_id(const char *provisioning_session_id) {
     msaf_provisioning_session_t *msaf_provisioning_session;
     cJSON *content_hosting_configuration_json = NULL;
@@ -538,6 +675,18 @@ msaf_provisioning_session_hash_remove(const char *provisioning_session_id)
     ogs_hash_do(free_ogs_hash_provisioning_session, &fohps, msaf_self()->provisioningSessions_map);
 }
 
+void
+msaf_provisioning_session_certificate_add(msaf_provisioning_session_t *provisioning_session, const char *certificate_id)
+{
+    ogs_assert(provisioning_session);
+    ogs_assert(certificate_id);
+
+    if (!ogs_hash_get(provisioning_session->certificate_map, certificate_id, OGS_HASH_KEY_STRING)) {
+        ogs_hash_set(provisioning_session->certificate_map, msaf_strdup(certificate_id), OGS_HASH_KEY_STRING, msaf_strdup(certificate_id));
+    }
+    msaf_provisioning_session_list_certificate_add(provisioning_session, certificate_id);
+}
+
 void
 msaf_provisioning_session_certificate_hash_remove(const char *provisioning_session_id, const char *certificate_id)
 {
@@ -549,6 +698,8 @@ msaf_provisioning_session_certificate_hash_remove(const char *provisioning_sessi
         provisioning_session->certificate_map
     };
     ogs_hash_do(free_ogs_hash_provisioning_session_certificate, &fohpsc, provisioning_session->certificate_map);
+    msaf_provisioning_session_list_certificate_remove(certificate_id);
+    msaf_provisioning_session_changed(provisioning_session);
 }
 
 int uri_relative_check(const char *entry_point_path)
@@ -593,35 +744,6 @@ int uri_relative_check(const char *entry_point_path)
     }
 }
 
-char *enumerate_provisioning_sessions(void)
-{
-    ogs_hash_index_t *hi;
-    char *provisioning_sessions = "[]";
-    int number_of_provisioning_sessions = ogs_hash_count(msaf_self()->provisioningSessions_map);
-    if (number_of_provisioning_sessions)
-    {
-        provisioning_sessions = ogs_calloc(1, (4 + (sizeof(char)*(OGS_UUID_FORMATTED_LENGTH + 1) *number_of_provisioning_sessions) +1));
-        provisioning_sessions[0] = '[';
-
-        for (hi = ogs_hash_first(msaf_self()->provisioningSessions_map); hi; hi = ogs_hash_next(hi)) {
-            const char *key = NULL;
-            const char *val = NULL;
-            char *provisioning_session = NULL;
-            key = ogs_hash_this_key(hi);
-            ogs_assert(key);
-            val = ogs_hash_this_val(hi);
-            ogs_assert(val);
-            provisioning_session = ogs_msprintf("\"%s\", ", key);
-            strcat(provisioning_sessions, provisioning_session);
-            ogs_free(provisioning_session);
-        }
-        provisioning_sessions[strlen(provisioning_sessions) - 2] = ']';
-        provisioning_sessions[strlen(provisioning_sessions) - 1] = '\0';
-    }
-    return provisioning_sessions;
-
-}
-
 bool msaf_provisioning_session_add_policy_template(msaf_provisioning_session_t *provisioning_session, msaf_api_policy_template_t *policy_template, time_t creation_time) {
     
     ogs_uuid_t uuid;
@@ -637,6 +759,7 @@ bool msaf_provisioning_session_add_policy_template(msaf_provisioning_session_t *
     if(!msaf_policy_template) return false;
 
     ogs_hash_set(provisioning_session->policy_templates, msaf_strdup(id), OGS_HASH_KEY_STRING, msaf_policy_template);
+    msaf_provisioning_session_changed(provisioning_session);
 
     if(!msaf_provisioning_session_send_policy_template_state_change_event(provisioning_session, msaf_policy_template, msaf_api_policy_template_STATE_PENDING, NULL, NULL))
         return false;
@@ -645,6 +768,50 @@ bool msaf_provisioning_session_add_policy_template(msaf_provisioning_session_t *
 
 }
 
+bool msaf_provisioning_session_restore_policy_template(msaf_provisioning_session_t *provisioning_session, msaf_api_policy_template_t *policy_template, time_t last_modified)
+{
+    msaf_policy_template_node_t *msaf_policy_template;
+    msaf_policy_template_node_t *existing;
+
+    ogs_assert(provisioning_session);
+    ogs_assert(policy_template);
+
+    if (!policy_template->policy_template_id) {
+        msaf_policy_template_free(policy_template);
+        return false;
+    }
+
+    msaf_policy_template = msaf_policy_template_populate(policy_template, last_modified);
+    if (!msaf_policy_template) return false;
+
+    existing = msaf_provisioning_session_find_policy_template_by_id(provisioning_session, policy_template->policy_template_id);
+    if (existing) {
+        /* the existing key is kept when the value is replaced */
+        ogs_hash_set(provisioning_session->policy_templates, policy_template->policy_template_id, OGS_HASH_KEY_STRING, msaf_policy_template);
+        msaf_policy_template_node_free(existing);
+    } else {
+        ogs_hash_set(provisioning_session->policy_templates, msaf_strdup(policy_template->policy_template_id), OGS_HASH_KEY_STRING, msaf_policy_template);
+    }
+
+    return true;
+}
+
+bool msaf_provisioning_session_discard_policy_template(msaf_provisioning_session_t *provisioning_session, const char *policy_template_id)
+{
+    msaf_provisioning_session_policy_template_delete_data_t delete_data;
+
+    ogs_assert(provisioning_session);
+    ogs_assert(policy_template_id);
+
+    delete_data.provisioning_session = provisioning_session;
+    delete_data.policy_template = msaf_provisioning_session_find_policy_template_by_id(provisioning_session, policy_template_id);
+    if (!delete_data.policy_template) return false;
+
+    ogs_hash_do(free_ogs_hash_provisioning_session_policy_template, &delete_data, provisioning_session->policy_templates);
+
+    return true;
+}
+
 bool msaf_provisioning_session_update_policy_template(msaf_provisioning_session_t *provisioning_session, msaf_policy_template_node_t *msaf_policy_template, msaf_api_policy_template_t *policy_template) {
     
     char *policy_template_id;	
@@ -657,6 +824,9 @@ bool msaf_provisioning_session_update_policy_template(msaf_provisioning_session_
     msaf_policy_template_free(msaf_policy_template->policy_template);
     msaf_policy_template->policy_template = policy_template;
     msaf_policy_template->policy_template->policy_template_id = policy_template_id;
+    msaf_policy_template->last_modified = time(NULL);
+    if (msaf_policy_template->hash) ogs_free(msaf_policy_template->hash);
+    msaf_policy_template->hash = calculate_policy_template_hash(msaf_policy_template->policy_template);
     if(!msaf_provisioning_session_send_policy_template_state_change_event(provisioning_session, msaf_policy_template, msaf_api_policy_template_STATE_PENDING, NULL, NULL))
         return false;
 
@@ -735,6 +905,91 @@ OpenAPI_list_t *msaf_provisioning_session_get_external_reference_of_policy_templ
  * Private functions
  **********************************************************/
 
+/* ProvisioningSession resource for a provisioning session, the strings are borrowed from msaf_provisioning_session. The
+ * resource is built in a new arena returned in arena_out, free the arena when finished with the resource. */
+static msaf_api_provisioning_session_t *_api_provisioning_session_new(msaf_provisioning_session_t *msaf_provisioning_session,
+                                                                       msaf_model_arena_t **arena_out)
+{
+    msaf_api_provisioning_session_t *provisioning_session;
+    ogs_hash_index_t *cert_node;
+    msaf_model_arena_t *arena;
+
+    arena = msaf_model_arena_new(0);
+    msaf_model_arena_enter(arena);
+
+    provisioning_session = msaf_model_calloc(1,sizeof(*provisioning_session));
+
+    provisioning_session->provisioning_session_id = msaf_provisioning_session->provisioningSessionId;
+    provisioning_session->provisioning_session_type = msaf_provisioning_session->provisioningSessionType;
+    provisioning_session->asp_id = msaf_provisioning_session->aspId;
+    provisioning_session->app_id = msaf_provisioning_session->appId;
+
+    provisioning_session->server_certificate_ids = (OpenAPI_set_t*)msaf_model_list_create();
+    for (cert_node=ogs_hash_first(msaf_provisioning_session->certificate_map); cert_node; cert_node=ogs_hash_next(cert_node)) {
+        ogs_debug("msaf_provisioning_session_get_json: Add cert %s", (const char *)ogs_hash_this_key(cert_node));
+        msaf_model_list_add(provisioning_session->server_certificate_ids, (void*)ogs_hash_this_key(cert_node));
+    }
+
+    if (msaf_provisioning_session->policy_templates && ogs_hash_first(msaf_provisioning_session->policy_templates) != NULL) {
+        ogs_hash_index_t *pol_node;
+        provisioning_session->policy_template_ids = (OpenAPI_set_t*)msaf_model_list_create();
+        for (pol_node=ogs_hash_first(msaf_provisioning_session->policy_templates); pol_node; pol_node=ogs_hash_next(pol_node)) {
+            ogs_debug("msaf_provisioning_session_get_json: Add policy template %s", (const char *)ogs_hash_this_key(pol_node));
+            msaf_model_list_add(provisioning_session->policy_template_ids, (void*)ogs_hash_this_key(pol_node));
+        }
+    }
+
+    if (msaf_provisioning_session->metrics_reporting_configurations &&
+        ogs_hash_first(msaf_provisioning_session->metrics_reporting_configurations) != NULL) {
+        ogs_hash_index_t *mrc_node;
+        provisioning_session->metrics_reporting_configuration_ids = (OpenAPI_set_t*)msaf_model_list_create();
+        for (mrc_node=ogs_hash_first(msaf_provisioning_session->metrics_reporting_configurations); mrc_node; mrc_node=ogs_hash_next(mrc_node)) {
+            msaf_model_list_add(provisioning_session->metrics_reporting_configuration_ids, (void*)ogs_hash_this_key(mrc_node));
+        }
+    }
+
+    msaf_model_arena_leave(arena);
+
+    *arena_out = arena;
+    return provisioning_session;
+}
+
+static bool _write_provisioning_session(msaf_json_writer_t *writer, const void *provisioning_session)
+{
+    return msaf_api_provisioning_session_writeResponseJSON(writer, (const msaf_api_provisioning_session_t*)provisioning_session);
+}
+
+static bool _write_content_hosting_configuration(msaf_json_writer_t *writer, const void *content_hosting_configuration)
+{
+    return msaf_api_content_hosting_configuration_writeResponseJSON(writer,
+                                            (const msaf_api_content_hosting_configuration_t*)content_hosting_configuration);
+}
+
+static bool _content_hosting_configuration_check(msaf_api_content_hosting_configuration_t *content_hosting_configuration, const char **reason_ret)
+{
+    OpenAPI_lnode_t *dist_config_node = NULL;
+
+    if (!content_hosting_configuration->distribution_configurations) return true;
+
+    OpenAPI_list_for_each(content_hosting_configuration->distribution_configurations, dist_config_node) {
+        msaf_api_distribution_configuration_t *dist_config = (msaf_api_distribution_configuration_t*)dist_config_node->data;
+
+        if(dist_config->entry_point && !uri_relative_check(dist_config->entry_point->relative_path)) {
+            if (reason_ret) *reason_ret = "distributionConfiguration.entryPoint.relativePath malformed";
+            ogs_error("distributionConfiguration.entryPoint.relativePath malformed");
+            return false;
+        }
+
+        if (dist_config->entry_point && dist_config->entry_point->profiles && dist_config->entry_point->profiles->first == NULL) {
+            if (reason_ret) *reason_ret = "distributionConfiguration.entryPoint.profiles present but empty";
+            ogs_error("distributionConfiguration.entryPoint.profiles present but empty");
+            return false;
+        }
+    }
+
+    return true;
+}
+
 static ogs_hash_t *msaf_policy_templates_new(void)
 {
     ogs_hash_t *policy_templates = ogs_hash_make();
@@ -781,6 +1036,7 @@ free_ogs_hash_provisioning_session_policy_template(void *rec, const void *key, i
         msaf_policy_template_node_free(msaf_policy_template);
         ogs_hash_set(provisioning_session->policy_templates, key, klen, NULL);
         ogs_free((void*)key);
+        msaf_provisioning_session_changed(provisioning_session);
         return 0; /* finish search when the first key matches */
     }
 
@@ -793,6 +1049,14 @@ static void safe_ogs_free(void *ptr)
     ogs_free(ptr);
 }
 
+/* Application Server certificate ids are "<provisioningSessionId>:<certificateId>" */
+static bool
+_as_certificate_id_is_for_session(const char *as_certificate_id, const char *provisioning_session_id, size_t provisioning_session_id_len)
+{
+    return !strncmp(as_certificate_id, provisioning_session_id, provisioning_session_id_len) &&
+           as_certificate_id[provisioning_session_id_len] == ':';
+}
+
 static ogs_hash_t *
 msaf_certificate_map(void)
 {
@@ -800,19 +1064,6 @@ msaf_certificate_map(void)
     return certificate_map;
 }
 
-static char *calculate_provisioning_session_hash(msaf_api_provisioning_session_t *provisioning_session)
-{
-    cJSON *provisioning_sess = NULL;
-    char *provisioning_session_to_hash;
-    char *provisioning_session_hashed = NULL;
-    provisioning_sess = msaf_api_provisioning_session_convertResponseToJSON(provisioning_session);
-    provisioning_session_to_hash = cJSON_Print(provisioning_sess);
-    cJSON_Delete(provisioning_sess);
-    provisioning_session_hashed = calculate_hash(provisioning_session_to_hash);
-    cJSON_free(provisioning_session_to_hash);
-    return provisioning_session_hashed;
-}
-
 static int
 ogs_hash_do_cert_check(void *rec, const void *key, int klen, const void *value)
 {
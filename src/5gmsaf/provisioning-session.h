@@ -13,6 +13,10 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 
 #include <regex.h>
 
+#include "consumption-statistics.h"
+#include "content-encoding.h"
+#include "content-hosting-configuration-diff.h"
+#include "metrics-reporting-configuration.h"
 #include "sai-cache.h"
 
 #include "openapi/model/msaf_api_provisioning_session_type.h"
@@ -28,12 +32,15 @@ typedef struct msaf_api_content_hosting_configuration_s msaf_api_content_hosting
 typedef struct msaf_http_metadata_s {
     time_t received;
     char *hash;
+    msaf_content_variant_t identity; /* rendered body, made on first request, replaced when hash changes */
+    msaf_content_variant_t gzip; /* made on first request, replaced when hash changes */
 } msaf_http_metadata_t;
 
 typedef struct msaf_policy_template_node_s {
     msaf_api_policy_template_t *policy_template;
     char *hash;
     time_t last_modified;
+    msaf_content_variant_t identity; /* rendered body, made on first request, replaced when hash changes */
 } msaf_policy_template_node_t;
 
 typedef struct msaf_provisioning_session_s {
@@ -44,6 +51,8 @@ typedef struct msaf_provisioning_session_s {
     msaf_api_consumption_reporting_configuration_t *consumptionReportingConfiguration;
     msaf_api_content_hosting_configuration_t *contentHostingConfiguration;
     msaf_sai_cache_t *sai_cache;
+    bool sai_regeneration_scheduled;
+    msaf_consumption_statistics_t *consumption_statistics; /* created when the first report is received */
     struct {
         msaf_http_metadata_t provisioningSession;
         msaf_http_metadata_t consumptionReportingConfiguration;
@@ -51,8 +60,10 @@ typedef struct msaf_provisioning_session_s {
     } httpMetadata;
     ogs_hash_t *certificate_map;          //Type: char* => n/a (just used as a set - external tool manages data)
     ogs_hash_t *policy_templates; /* key: policy template id, value: msaf_policy_template_node_t */
+    ogs_hash_t *metrics_reporting_configurations; /* key: metrics reporting configuration id, value: msaf_metrics_reporting_configuration_node_t */
     ogs_list_t application_server_states; //Type: msaf_application_server_state_ref_node_t*
     int marked_for_deletion;
+    uint64_t list_seq;                    /* position in the management listing, see provisioning-session-list.h */
 } msaf_provisioning_session_t;
 
 typedef struct msaf_application_server_state_node_s msaf_application_server_state_node_t;
@@ -73,10 +84,22 @@ typedef struct msaf_policy_template_change_state_event_data_s {
 } msaf_policy_template_change_state_event_data_t;
 
 extern msaf_provisioning_session_t *msaf_provisioning_session_create(const char *provisioning_session_type, const char *asp_id, const char *external_app_id);
+extern msaf_provisioning_session_t *msaf_provisioning_session_create_with_id(const char *provisioning_session_id, const char *provisioning_session_type, const char *asp_id, const char *external_app_id);
 extern void msaf_provisioning_session_free(msaf_provisioning_session_t *provisioning_session);
 extern msaf_provisioning_session_t *msaf_provisioning_session_find_by_provisioningSessionId(const char *provisioningSessionId);
+extern msaf_provisioning_session_t *msaf_provisioning_session_find_by_certificate_id(const char *certificate_id);
 extern cJSON *msaf_provisioning_session_get_json(const char *provisioning_session_id);
 
+/* Call when the certificates, policy templates or metrics reporting configurations of a provisioning session change, so
+ * that its ETag, Last-Modified and rendered body are renewed */
+extern void msaf_provisioning_session_changed(msaf_provisioning_session_t *provisioning_session);
+
+/* Response bodies, rendered once for each version of the resource and copied for each response. The provisioning session
+ * hash is only valid after msaf_provisioning_session_etag() or msaf_provisioning_session_body() has been called. */
+extern const char *msaf_provisioning_session_etag(msaf_provisioning_session_t *provisioning_session);
+extern char *msaf_provisioning_session_body(msaf_provisioning_session_t *provisioning_session);
+extern char *msaf_content_hosting_configuration_body(msaf_provisioning_session_t *provisioning_session);
+
 extern msaf_api_content_hosting_configuration_t *msaf_content_hosting_configuration_create(msaf_provisioning_session_t *provisioning_session);
 
 extern int msaf_content_hosting_configuration_certificate_check(msaf_provisioning_session_t *provisioning_session);
@@ -93,16 +116,27 @@ extern void msaf_delete_certificates(const char *provisioning_session_id);
 
 extern void msaf_provisioning_session_hash_remove(const char *provisioning_session_id);
 
+extern void msaf_provisioning_session_certificate_add(msaf_provisioning_session_t *provisioning_session, const char *certificate_id);
 extern void msaf_provisioning_session_certificate_hash_remove(const char *provisioning_session_id, const char *certificate_id);
 
 extern int uri_relative_check(const char *entry_point_path);
 
+/* Parse and check a ContentHostingConfiguration request body without applying it */
+extern msaf_api_content_hosting_configuration_t *msaf_content_hosting_configuration_parse(cJSON *content_hosting_config, const char **reason_ret);
+
+/* As msaf_content_hosting_configuration_parse() but reads the request body directly. *syntax_error is set when the body
+ * is not well formed JSON, as opposed to not being a valid ContentHostingConfiguration. */
+extern msaf_api_content_hosting_configuration_t *msaf_content_hosting_configuration_parse_body(const char *body, size_t length, bool *syntax_error, const char **reason_ret);
+
 extern int msaf_distribution_create(cJSON *content_hosting_config, msaf_provisioning_session_t *provisioning_session, const char **reason_ret);
+/* Apply an already parsed ContentHostingConfiguration, takes ownership of content_hosting_configuration */
+extern int msaf_distribution_create_from_model(msaf_api_content_hosting_configuration_t *content_hosting_configuration, msaf_provisioning_session_t *provisioning_session);
+/* As msaf_distribution_create_from_model() and fill in diff with what changed from the configuration being replaced. If
+ * nothing changed the provisioning session is left as it was and content_hosting_configuration is freed. */
+extern int msaf_distribution_update_from_model(msaf_api_content_hosting_configuration_t *content_hosting_configuration, msaf_provisioning_session_t *provisioning_session, msaf_content_hosting_configuration_diff_t *diff /* [out, not-null] */);
 
 extern cJSON *msaf_get_content_hosting_configuration_by_provisioning_session_id(const char *provisioning_session_id);
 
-extern char *enumerate_provisioning_sessions(void);
-
 extern bool msaf_provisioning_session_add_policy_template(msaf_provisioning_session_t *provisioning_session, msaf_api_policy_template_t *policy_template, time_t creation_time);
 
 extern bool msaf_provisioning_session_delete_policy_template(msaf_provisioning_session_t *provisioning_session, msaf_policy_template_node_t *policy_template);
@@ -115,6 +149,12 @@ extern msaf_policy_template_node_t *msaf_provisioning_session_get_policy_templat
 
 extern bool msaf_provisioning_session_send_policy_template_state_change_event(msaf_provisioning_session_t *provisioning_session,  msaf_policy_template_node_t *policy_template, msaf_api_policy_template_state_e new_state, msaf_policy_template_state_change_callback callback, void *user_data);
 
+/* Put back a policy template, as saved with its id and state, without any state change events */
+extern bool msaf_provisioning_session_restore_policy_template(msaf_provisioning_session_t *provisioning_session, msaf_api_policy_template_t *policy_template, time_t last_modified);
+
+/* Remove a policy template immediately, without any state change events */
+extern bool msaf_provisioning_session_discard_policy_template(msaf_provisioning_session_t *provisioning_session, const char *policy_template_id);
+
 extern bool msaf_provisioning_session_update_policy_template(msaf_provisioning_session_t *provisioning_session, msaf_policy_template_node_t *msaf_policy_template, msaf_api_policy_template_t *policy_template);
 
 extern void msaf_provisioning_session_policy_template_free(ogs_hash_t *policy_templates);
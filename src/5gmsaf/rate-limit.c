@@ -0,0 +1,413 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#include <arpa/inet.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "ogs-core.h"
+
+#include "rate-limit.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Buckets idle long enough to refill are dropped from the least recently used end, a few per take so that each take
+ * stays O(1) */
+#define MSAF_RATE_LIMIT_EXPIRE_PER_TAKE 2
+
+typedef struct msaf_rate_limit_bucket_s {
+    ogs_lnode_t node;         /* limiter->lru */
+    char *key;
+    double tokens;
+    ogs_time_t updated;
+} msaf_rate_limit_bucket_t;
+
+struct msaf_rate_limiter_s {
+    double rate;              /* tokens per second */
+    double burst;
+    size_t max_buckets;
+    ogs_time_t refill_time;   /* time for an empty bucket to fill */
+    ogs_hash_t *buckets;      /* key => msaf_rate_limit_bucket_t */
+    ogs_list_t lru;           /* msaf_rate_limit_bucket_t, most recently used first */
+    size_t count;
+    uint64_t evictions;
+};
+
+/* M5 buckets, only used from the event loop */
+static struct {
+    msaf_rate_limiter_t *clients;
+    msaf_rate_limiter_t *sessions;
+    uint64_t allowed;
+    uint64_t client_rejected;
+    uint64_t session_rejected;
+} rate_limit = {NULL, NULL, 0, 0, 0};
+
+static void _bucket_remove(msaf_rate_limiter_t *limiter, msaf_rate_limit_bucket_t *bucket);
+static void _expire(msaf_rate_limiter_t *limiter, ogs_time_t now);
+static int _retry_after_seconds(ogs_time_t retry_in);
+static bool _address_parse(const char *text, msaf_rate_limit_network_t *address);
+static bool _network_contains(const msaf_rate_limit_network_t *network, const msaf_rate_limit_network_t *address);
+
+/*****************************************************
+ ***** Public functions
+ *****************************************************/
+
+msaf_rate_limiter_t *msaf_rate_limiter_new(double rate, unsigned int burst, size_t max_buckets)
+{
+    msaf_rate_limiter_t *limiter;
+
+    ogs_assert(rate > 0);
+
+    limiter = ogs_calloc(1, sizeof(*limiter));
+    ogs_assert(limiter);
+
+    limiter->rate = rate;
+    /* default to one second's worth of requests */
+    limiter->burst = burst?burst:ceil(rate);
+    limiter->max_buckets = max_buckets;
+    limiter->refill_time = (ogs_time_t)ceil(limiter->burst * 1000000.0 / rate);
+    limiter->buckets = ogs_hash_make();
+    ogs_assert(limiter->buckets);
+    ogs_list_init(&limiter->lru);
+
+    return limiter;
+}
+
+void msaf_rate_limiter_free(msaf_rate_limiter_t *limiter)
+{
+    msaf_rate_limit_bucket_t *bucket;
+
+    if (!limiter) return;
+
+    while ((bucket = ogs_list_first(&limiter->lru)) != NULL) {
+        _bucket_remove(limiter, bucket);
+    }
+
+    ogs_hash_destroy(limiter->buckets);
+    ogs_free(limiter);
+}
+
+bool msaf_rate_limiter_take(msaf_rate_limiter_t *limiter, const char *key, ogs_time_t now, ogs_time_t *retry_in)
+{
+    msaf_rate_limit_bucket_t *bucket;
+
+    ogs_assert(limiter);
+    ogs_assert(key);
+
+    _expire(limiter, now);
+
+    bucket = ogs_hash_get(limiter->buckets, key, OGS_HASH_KEY_STRING);
+    if (bucket) {
+        if (now > bucket->updated) {
+            bucket->tokens += (double)(now - bucket->updated) * limiter->rate / 1000000.0;
+            if (bucket->tokens > limiter->burst) bucket->tokens = limiter->burst;
+            bucket->updated = now;
+        }
+        if (ogs_list_first(&limiter->lru) != bucket) {
+            ogs_list_remove(&limiter->lru, bucket);
+            ogs_list_prepend(&limiter->lru, bucket);
+        }
+    } else {
+        if (limiter->max_buckets && limiter->count >= limiter->max_buckets) {
+            /* the least recently used bucket has not refilled yet, dropping it lets that key start afresh */
+            _bucket_remove(limiter, ogs_list_last(&limiter->lru));
+            limiter->evictions++;
+        }
+        bucket = ogs_calloc(1, sizeof(*bucket));
+        ogs_assert(bucket);
+        bucket->key = ogs_strdup(key);
+        ogs_assert(bucket->key);
+        bucket->tokens = limiter->burst;
+        bucket->updated = now;
+        ogs_hash_set(limiter->buckets, bucket->key, OGS_HASH_KEY_STRING, bucket);
+        ogs_list_prepend(&limiter->lru, bucket);
+        limiter->count++;
+    }
+
+    if (bucket->tokens < 1.0) {
+        if (retry_in) *retry_in = (ogs_time_t)ceil((1.0 - bucket->tokens) * 1000000.0 / limiter->rate);
+        return false;
+    }
+
+    bucket->tokens -= 1.0;
+
+    return true;
+}
+
+size_t msaf_rate_limiter_count(const msaf_rate_limiter_t *limiter)
+{
+    ogs_assert(limiter);
+    return limiter->count;
+}
+
+uint64_t msaf_rate_limiter_evictions(const msaf_rate_limiter_t *limiter)
+{
+    ogs_assert(limiter);
+    return limiter->evictions;
+}
+
+void msaf_rate_limit_config_init(msaf_rate_limit_config_t *config)
+{
+    ogs_assert(config);
+
+    memset(config, 0, sizeof(*config));
+    config->max_buckets = MSAF_RATE_LIMIT_DEFAULT_MAX_BUCKETS;
+}
+
+void msaf_rate_limit_config_clear(msaf_rate_limit_config_t *config)
+{
+    ogs_assert(config);
+
+    if (config->trusted_proxies) ogs_free(config->trusted_proxies);
+    msaf_rate_limit_config_init(config);
+}
+
+bool msaf_rate_limit_config_add_trusted_proxy(msaf_rate_limit_config_t *config, const char *network)
+{
+    msaf_rate_limit_network_t proxy;
+    char address[OGS_ADDRSTRLEN];
+    const char *slash;
+    size_t length;
+
+    ogs_assert(config);
+    ogs_assert(network);
+
+    slash = strchr(network, '/');
+    length = slash?(size_t)(slash - network):strlen(network);
+    if (!length || length >= sizeof(address)) return false;
+    memcpy(address, network, length);
+    address[length] = '\0';
+
+    if (!_address_parse(address, &proxy)) return false;
+
+    if (slash) {
+        char *end = NULL;
+        long prefix_length = strtol(slash + 1, &end, 10);
+
+        if (end == slash + 1 || *end != '\0' || prefix_length < 0 ||
+                (unsigned long)prefix_length > proxy.prefix_length) {
+            return false;
+        }
+        proxy.prefix_length = prefix_length;
+    }
+
+    config->trusted_proxies = ogs_realloc(config->trusted_proxies,
+                                          (config->num_trusted_proxies + 1) * sizeof(*config->trusted_proxies));
+    ogs_assert(config->trusted_proxies);
+    config->trusted_proxies[config->num_trusted_proxies++] = proxy;
+
+    return true;
+}
+
+void msaf_rate_limit_init(const msaf_rate_limit_config_t *config)
+{
+    ogs_assert(config);
+
+    msaf_rate_limit_final();
+
+    if (config->client_rate > 0) {
+        rate_limit.clients = msaf_rate_limiter_new(config->client_rate, config->client_burst, config->max_buckets);
+    }
+    if (config->session_rate > 0) {
+        rate_limit.sessions = msaf_rate_limiter_new(config->session_rate, config->session_burst, config->max_buckets);
+    }
+}
+
+void msaf_rate_limit_final(void)
+{
+    msaf_rate_limiter_free(rate_limit.clients);
+    rate_limit.clients = NULL;
+    msaf_rate_limiter_free(rate_limit.sessions);
+    rate_limit.sessions = NULL;
+}
+
+msaf_rate_limit_result_t msaf_rate_limit_check(const char *client_address, const char *provisioning_session_id,
+                                               int *retry_after)
+{
+    ogs_time_t now;
+    ogs_time_t retry_in = 0;
+
+    ogs_assert(retry_after);
+
+    *retry_after = 0;
+
+    if (!rate_limit.clients && !rate_limit.sessions) {
+        rate_limit.allowed++;
+        return MSAF_RATE_LIMIT_ALLOWED;
+    }
+
+    now = ogs_get_monotonic_time();
+
+    /* check the client first so that one client over its limit does not use up the provisioning session tokens */
+    if (rate_limit.clients && client_address && !msaf_rate_limiter_take(rate_limit.clients, client_address, now, &retry_in)) {
+        rate_limit.client_rejected++;
+        *retry_after = _retry_after_seconds(retry_in);
+        return MSAF_RATE_LIMIT_CLIENT;
+    }
+
+    if (rate_limit.sessions && provisioning_session_id &&
+            !msaf_rate_limiter_take(rate_limit.sessions, provisioning_session_id, now, &retry_in)) {
+        rate_limit.session_rejected++;
+        *retry_after = _retry_after_seconds(retry_in);
+        return MSAF_RATE_LIMIT_SESSION;
+    }
+
+    rate_limit.allowed++;
+
+    return MSAF_RATE_LIMIT_ALLOWED;
+}
+
+void msaf_rate_limit_get_stats(msaf_rate_limit_stats_t *stats)
+{
+    ogs_assert(stats);
+
+    memset(stats, 0, sizeof(*stats));
+    stats->allowed = rate_limit.allowed;
+    stats->client_rejected = rate_limit.client_rejected;
+    stats->session_rejected = rate_limit.session_rejected;
+    if (rate_limit.clients) {
+        stats->evictions += msaf_rate_limiter_evictions(rate_limit.clients);
+        stats->clients = msaf_rate_limiter_count(rate_limit.clients);
+    }
+    if (rate_limit.sessions) {
+        stats->evictions += msaf_rate_limiter_evictions(rate_limit.sessions);
+        stats->sessions = msaf_rate_limiter_count(rate_limit.sessions);
+    }
+}
+
+const char *msaf_rate_limit_forwarded_address(const char *x_forwarded_for, char *buf, size_t buf_size)
+{
+    const char *start, *end;
+
+    if (!x_forwarded_for) return NULL;
+
+    /* the last entry is the one added by the proxy in front of us, earlier entries are as the client sent them */
+    start = strrchr(x_forwarded_for, ',');
+    start = start?start+1:x_forwarded_for;
+    while (*start == ' ' || *start == '\t') start++;
+    end = start + strlen(start);
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t')) end--;
+
+    if (end == start || (size_t)(end - start) >= buf_size) return NULL;
+    if (strspn(start, "0123456789abcdefABCDEF.:[]") < (size_t)(end - start)) return NULL;
+
+    memcpy(buf, start, end - start);
+    buf[end - start] = '\0';
+
+    return buf;
+}
+
+const char *msaf_rate_limit_client_address(const msaf_rate_limit_config_t *config, const char *peer_address,
+                                           const char *x_forwarded_for, char *buf, size_t buf_size)
+{
+    msaf_rate_limit_network_t peer;
+    size_t i;
+
+    ogs_assert(config);
+
+    if (!peer_address || !_address_parse(peer_address, &peer)) return NULL;
+
+    /* anyone can send an X-Forwarded-For header, only believe the proxies in front of the AF */
+    for (i = 0; i < config->num_trusted_proxies; i++) {
+        if (_network_contains(&config->trusted_proxies[i], &peer))
+            return msaf_rate_limit_forwarded_address(x_forwarded_for, buf, buf_size);
+    }
+
+    if (strlen(peer_address) >= buf_size) return NULL;
+    strcpy(buf, peer_address);
+
+    return buf;
+}
+
+/*****************************************************
+ ***** Private functions
+ *****************************************************/
+
+/* Parse an IPv4 or IPv6 address as a network of just that address. IPv4-mapped IPv6 addresses, as seen on dual stack
+ * sockets, are taken as the IPv4 address. */
+static bool _address_parse(const char *text, msaf_rate_limit_network_t *address)
+{
+    static const uint8_t v4_mapped[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+
+    memset(address, 0, sizeof(*address));
+
+    if (inet_pton(AF_INET, text, address->address) == 1) {
+        address->family = AF_INET;
+        address->prefix_length = 32;
+        return true;
+    }
+
+    if (inet_pton(AF_INET6, text, address->address) != 1) return false;
+
+    if (!memcmp(address->address, v4_mapped, sizeof(v4_mapped))) {
+        memmove(address->address, address->address + sizeof(v4_mapped), 4);
+        memset(address->address + 4, 0, sizeof(address->address) - 4);
+        address->family = AF_INET;
+        address->prefix_length = 32;
+        return true;
+    }
+
+    address->family = AF_INET6;
+    address->prefix_length = 128;
+
+    return true;
+}
+
+static bool _network_contains(const msaf_rate_limit_network_t *network, const msaf_rate_limit_network_t *address)
+{
+    unsigned int whole_bytes = network->prefix_length / 8;
+    unsigned int bits = network->prefix_length % 8;
+
+    if (network->family != address->family) return false;
+    if (memcmp(network->address, address->address, whole_bytes)) return false;
+    if (bits) {
+        uint8_t mask = (uint8_t)(0xff << (8 - bits));
+        if ((network->address[whole_bytes] & mask) != (address->address[whole_bytes] & mask)) return false;
+    }
+
+    return true;
+}
+
+static void _bucket_remove(msaf_rate_limiter_t *limiter, msaf_rate_limit_bucket_t *bucket)
+{
+    ogs_hash_set(limiter->buckets, bucket->key, OGS_HASH_KEY_STRING, NULL);
+    ogs_list_remove(&limiter->lru, bucket);
+    limiter->count--;
+    ogs_free(bucket->key);
+    ogs_free(bucket);
+}
+
+static void _expire(msaf_rate_limiter_t *limiter, ogs_time_t now)
+{
+    int i;
+
+    for (i = 0; i < MSAF_RATE_LIMIT_EXPIRE_PER_TAKE; i++) {
+        msaf_rate_limit_bucket_t *bucket = ogs_list_last(&limiter->lru);
+        if (!bucket || now - bucket->updated < limiter->refill_time) break;
+        _bucket_remove(limiter, bucket);
+    }
+}
+
+static int _retry_after_seconds(ogs_time_t retry_in)
+{
+    int seconds = (int)((retry_in + 999999) / 1000000);
+    return seconds < 1 ? 1 : seconds;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
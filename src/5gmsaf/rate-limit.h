@@ -0,0 +1,110 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#ifndef MSAF_RATE_LIMIT_H
+#define MSAF_RATE_LIMIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ogs-core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Token bucket admission control for M5 requests that create work for the AF (reports, dynamic policies and network
+ * assistance). Each client address and each provisioning session has its own bucket. A bucket that has been idle long
+ * enough to refill is the same as a new bucket, so idle buckets are dropped and the number of buckets kept is bounded.
+ */
+
+/* An address, or a network in CIDR form */
+typedef struct msaf_rate_limit_network_s {
+    int family;                       /* AF_INET or AF_INET6 */
+    uint8_t address[16];              /* network order, the first 4 bytes for AF_INET */
+    unsigned int prefix_length;
+} msaf_rate_limit_network_t;
+
+typedef struct msaf_rate_limit_config_s {
+    double client_rate;               /* requests per second for each client address, 0 for no limit */
+    unsigned int client_burst;        /* requests a client address can make at once, 0 for the rate rounded up */
+    double session_rate;              /* requests per second for each provisioning session, 0 for no limit */
+    unsigned int session_burst;       /* requests a provisioning session can receive at once, 0 for the rate rounded up */
+    size_t max_buckets;               /* client address and provisioning session buckets kept, each */
+    msaf_rate_limit_network_t *trusted_proxies; /* peers whose X-Forwarded-For gives the client address */
+    size_t num_trusted_proxies;
+} msaf_rate_limit_config_t;
+
+#define MSAF_RATE_LIMIT_DEFAULT_MAX_BUCKETS 65536
+
+typedef enum msaf_rate_limit_result_e {
+    MSAF_RATE_LIMIT_ALLOWED = 0,
+    MSAF_RATE_LIMIT_CLIENT,           /* refused, the client address is over its limit */
+    MSAF_RATE_LIMIT_SESSION           /* refused, the provisioning session is over its limit */
+} msaf_rate_limit_result_t;
+
+typedef struct msaf_rate_limit_stats_s {
+    uint64_t allowed;
+    uint64_t client_rejected;
+    uint64_t session_rejected;
+    uint64_t evictions;               /* buckets dropped to stay within max_buckets before they had refilled */
+    size_t clients;                   /* client address buckets currently held */
+    size_t sessions;                  /* provisioning session buckets currently held */
+} msaf_rate_limit_stats_t;
+
+typedef struct msaf_rate_limiter_s msaf_rate_limiter_t;
+
+/* A set of buckets keyed by string */
+extern msaf_rate_limiter_t *msaf_rate_limiter_new(double rate, unsigned int burst, size_t max_buckets);
+extern void msaf_rate_limiter_free(msaf_rate_limiter_t *limiter /* [null] */);
+/* Take a token from the bucket for key. Returns false, and the time until a token is available in *retry_in, if the
+ * bucket is empty. */
+extern bool msaf_rate_limiter_take(msaf_rate_limiter_t *limiter /* [not-null] */, const char *key /* [not-null] */,
+                                   ogs_time_t now, ogs_time_t *retry_in /* [out, null] */);
+extern size_t msaf_rate_limiter_count(const msaf_rate_limiter_t *limiter /* [not-null] */);
+extern uint64_t msaf_rate_limiter_evictions(const msaf_rate_limiter_t *limiter /* [not-null] */);
+
+extern void msaf_rate_limit_config_init(msaf_rate_limit_config_t *config /* [out, not-null] */);
+extern void msaf_rate_limit_config_clear(msaf_rate_limit_config_t *config /* [not-null] */);
+/* Add an address or CIDR network, e.g. "192.0.2.1" or "2001:db8::/32", to the trusted proxies. Returns false if network is
+ * not an address or network. */
+extern bool msaf_rate_limit_config_add_trusted_proxy(msaf_rate_limit_config_t *config /* [not-null] */,
+                                                     const char *network /* [not-null] */);
+
+/* Set up the M5 buckets from the configuration, on the event loop only */
+extern void msaf_rate_limit_init(const msaf_rate_limit_config_t *config /* [not-null] */);
+extern void msaf_rate_limit_final(void);
+
+/* Check a request from client_address for provisioning_session_id, either may be NULL if not known. On refusal
+ * *retry_after is set to the whole seconds before the request can succeed. */
+extern msaf_rate_limit_result_t msaf_rate_limit_check(const char *client_address /* [null] */,
+                                                      const char *provisioning_session_id /* [null] */,
+                                                      int *retry_after /* [out, not-null] */);
+extern void msaf_rate_limit_get_stats(msaf_rate_limit_stats_t *stats /* [out, not-null] */);
+
+/* The client address added by the nearest proxy, the last entry of an X-Forwarded-For header value. Returns NULL if there
+ * is no usable address. buf must hold at least OGS_ADDRSTRLEN chars. */
+extern const char *msaf_rate_limit_forwarded_address(const char *x_forwarded_for /* [null] */, char *buf, size_t buf_size);
+
+/* The address to limit a request by. This is peer_address, the address the request came from, unless that is one of the
+ * configured trusted proxies, in which case it is the address the proxy added to X-Forwarded-For. Returns NULL if there is
+ * no usable address, e.g. a trusted proxy did not add one. buf must hold at least OGS_ADDRSTRLEN chars. */
+extern const char *msaf_rate_limit_client_address(const msaf_rate_limit_config_t *config /* [not-null] */,
+                                                  const char *peer_address /* [null] */,
+                                                  const char *x_forwarded_for /* [null] */, char *buf, size_t buf_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
+
+#endif /* MSAF_RATE_LIMIT_H */
@@ -0,0 +1,293 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#include <string.h>
+#include <strings.h>
+
+#include "ogs-core.h"
+
+#include "request-headers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct msaf_request_header_name_s {
+    const char *name;
+    size_t length;
+} msaf_request_header_name_t;
+
+#define HEADER_NAME(n) {n, sizeof(n) - 1}
+
+/* indexed by msaf_request_header_t */
+static const msaf_request_header_name_t header_names[MSAF_REQUEST_HEADER_COUNT] = {
+    HEADER_NAME("accept-encoding"),
+    HEADER_NAME(":authority"),
+    HEADER_NAME("content-type"),
+    HEADER_NAME("host"),
+    HEADER_NAME("if-match"),
+    HEADER_NAME("if-modified-since"),
+    HEADER_NAME("if-none-match"),
+    HEADER_NAME("if-unmodified-since"),
+    HEADER_NAME("x-forwarded-for")
+};
+
+#undef HEADER_NAME
+
+/* Perfect hash of the names above: (length * 5 + lower case last character) mod 16 gives a different slot for each name, so
+ * a lookup is one slot read and at most one case-insensitive compare. Check the slots if a name is added (the unit tests
+ * do). */
+#define HEADER_SLOTS 16
+#define HEADER_SLOT(len, last) ((((len) * 5) + (last)) & (HEADER_SLOTS - 1))
+
+static const msaf_request_header_t header_slots[HEADER_SLOTS] = {
+    MSAF_REQUEST_HEADER_IF_MATCH,               /* 0 */
+    MSAF_REQUEST_HEADER_CONTENT_TYPE,           /* 1 */
+    MSAF_REQUEST_HEADER_ACCEPT_ENCODING,        /* 2 */
+    MSAF_REQUEST_HEADER_UNKNOWN,                /* 3 */
+    MSAF_REQUEST_HEADER_IF_UNMODIFIED_SINCE,    /* 4 */
+    MSAF_REQUEST_HEADER_UNKNOWN,                /* 5 */
+    MSAF_REQUEST_HEADER_UNKNOWN,                /* 6 */
+    MSAF_REQUEST_HEADER_UNKNOWN,                /* 7 */
+    MSAF_REQUEST_HEADER_HOST,                   /* 8 */
+    MSAF_REQUEST_HEADER_IF_NONE_MATCH,          /* 9 */
+    MSAF_REQUEST_HEADER_IF_MODIFIED_SINCE,      /* 10 */
+    MSAF_REQUEST_HEADER_AUTHORITY,              /* 11 */
+    MSAF_REQUEST_HEADER_UNKNOWN,                /* 12 */
+    MSAF_REQUEST_HEADER_X_FORWARDED_FOR,        /* 13 */
+    MSAF_REQUEST_HEADER_UNKNOWN,                /* 14 */
+    MSAF_REQUEST_HEADER_UNKNOWN                 /* 15 */
+};
+
+static const char *_next_etag(const char *list, const char **tag, size_t *tag_len, bool *is_weak);
+static bool _etag_equal(const char *tag, size_t tag_len, const char *etag);
+static bool _parse_http_date(const char *value, time_t *date);
+
+/*****************************************************
+ ***** Public functions
+ *****************************************************/
+
+void msaf_request_headers_index(msaf_request_headers_t *headers, ogs_hash_t *http_headers)
+{
+    ogs_hash_index_t *hi;
+
+    ogs_assert(headers);
+
+    memset(headers, 0, sizeof(*headers));
+
+    if (!http_headers) return;
+
+    for (hi = ogs_hash_first(http_headers); hi; hi = ogs_hash_next(hi)) {
+        const char *name = ogs_hash_this_key(hi);
+        msaf_request_header_t header = msaf_request_header_lookup(name, strlen(name));
+
+        /* names differing only in case are the same header, keep the first one seen */
+        if (header != MSAF_REQUEST_HEADER_UNKNOWN && !headers->values[header]) {
+            headers->values[header] = ogs_hash_this_val(hi);
+        }
+    }
+}
+
+const char *msaf_request_headers_get(const msaf_request_headers_t *headers, msaf_request_header_t header)
+{
+    ogs_assert(headers);
+
+    if ((int)header < 0 || header >= MSAF_REQUEST_HEADER_COUNT) return NULL;
+
+    return headers->values[header];
+}
+
+const char *msaf_request_headers_host(const msaf_request_headers_t *headers)
+{
+    ogs_assert(headers);
+
+    if (headers->values[MSAF_REQUEST_HEADER_HOST]) return headers->values[MSAF_REQUEST_HEADER_HOST];
+
+    return headers->values[MSAF_REQUEST_HEADER_AUTHORITY];
+}
+
+bool msaf_request_headers_content_type_is(const msaf_request_headers_t *headers, const char *content_type)
+{
+    const char *type;
+    size_t type_len;
+
+    ogs_assert(headers);
+    ogs_assert(content_type);
+
+    type = headers->values[MSAF_REQUEST_HEADER_CONTENT_TYPE];
+    if (!type) return false;
+
+    /* only the media type is compared, parameters such as "; charset=utf-8" are ignored */
+    while (*type == ' ' || *type == '\t') type++;
+    type_len = strcspn(type, ";");
+    while (type_len > 0 && (type[type_len-1] == ' ' || type[type_len-1] == '\t')) type_len--;
+
+    if (type_len != strlen(content_type) || strncasecmp(type, content_type, type_len)) {
+        ogs_error("Unsupported Media Type: received type: %s, should have been %s", type, content_type);
+        return false;
+    }
+
+    return true;
+}
+
+bool msaf_request_headers_has_conditions(const msaf_request_headers_t *headers)
+{
+    ogs_assert(headers);
+
+    return headers->values[MSAF_REQUEST_HEADER_IF_MATCH] || headers->values[MSAF_REQUEST_HEADER_IF_NONE_MATCH] ||
+           headers->values[MSAF_REQUEST_HEADER_IF_MODIFIED_SINCE] || headers->values[MSAF_REQUEST_HEADER_IF_UNMODIFIED_SINCE];
+}
+
+msaf_request_condition_t msaf_request_headers_conditions(const msaf_request_headers_t *headers, bool safe, const char *etag,
+                                                         time_t last_modified)
+{
+    const char *value;
+    time_t date;
+
+    ogs_assert(headers);
+
+    value = headers->values[MSAF_REQUEST_HEADER_IF_MATCH];
+    if (value) {
+        if (!msaf_request_headers_etag_list_matches(value, etag, false)) return MSAF_REQUEST_CONDITION_FAILED;
+    } else {
+        value = headers->values[MSAF_REQUEST_HEADER_IF_UNMODIFIED_SINCE];
+        if (value && etag && last_modified && _parse_http_date(value, &date) && last_modified > date) {
+            return MSAF_REQUEST_CONDITION_FAILED;
+        }
+    }
+
+    value = headers->values[MSAF_REQUEST_HEADER_IF_NONE_MATCH];
+    if (value) {
+        if (msaf_request_headers_etag_list_matches(value, etag, true)) {
+            return safe?MSAF_REQUEST_CONDITION_NOT_MODIFIED:MSAF_REQUEST_CONDITION_FAILED;
+        }
+    } else if (safe) {
+        value = headers->values[MSAF_REQUEST_HEADER_IF_MODIFIED_SINCE];
+        if (value && etag && last_modified && _parse_http_date(value, &date) && last_modified <= date) {
+            return MSAF_REQUEST_CONDITION_NOT_MODIFIED;
+        }
+    }
+
+    return MSAF_REQUEST_CONDITION_NONE;
+}
+
+bool msaf_request_headers_etag_list_matches(const char *list, const char *etag, bool weak)
+{
+    const char *tag;
+    size_t tag_len;
+    bool is_weak;
+
+    ogs_assert(list);
+
+    if (!etag) return false;
+
+    while ((list = _next_etag(list, &tag, &tag_len, &is_weak)) != NULL) {
+        if (tag_len == 1 && *tag == '*') return true;
+        if ((weak || !is_weak) && _etag_equal(tag, tag_len, etag)) return true;
+    }
+
+    return false;
+}
+
+msaf_request_header_t msaf_request_header_lookup(const char *name, size_t name_len)
+{
+    unsigned char last;
+    msaf_request_header_t header;
+
+    ogs_assert(name);
+
+    if (name_len == 0) return MSAF_REQUEST_HEADER_UNKNOWN;
+
+    last = (unsigned char)name[name_len - 1];
+    if (last >= 'A' && last <= 'Z') last += 'a' - 'A';
+
+    header = header_slots[HEADER_SLOT(name_len, last)];
+    if (header == MSAF_REQUEST_HEADER_UNKNOWN || header_names[header].length != name_len ||
+            strncasecmp(name, header_names[header].name, name_len)) {
+        return MSAF_REQUEST_HEADER_UNKNOWN;
+    }
+
+    return header;
+}
+
+const char *msaf_request_header_name(msaf_request_header_t header)
+{
+    if ((int)header < 0 || header >= MSAF_REQUEST_HEADER_COUNT) return NULL;
+
+    return header_names[header].name;
+}
+
+/*****************************************************
+ ***** Private functions
+ *****************************************************/
+
+/* Find the next entity-tag in an If-Match/If-None-Match list, returns where to carry on from or NULL at the end */
+static const char *_next_etag(const char *list, const char **tag, size_t *tag_len, bool *is_weak)
+{
+    const char *end;
+
+    while (*list == ' ' || *list == '\t' || *list == ',') list++;
+    if (!*list) return NULL;
+
+    *is_weak = false;
+    if (list[0] == 'W' && list[1] == '/') {
+        *is_weak = true;
+        list += 2;
+    }
+
+    if (*list == '"') {
+        list++;
+        for (end = list; *end && *end != '"'; end++);
+        *tag = list;
+        *tag_len = end - list;
+        if (*end) end++;
+    } else {
+        /* be lenient with unquoted tags, the ETags we send are not quoted */
+        for (end = list; *end && *end != ',' && *end != ' ' && *end != '\t'; end++);
+        *tag = list;
+        *tag_len = end - list;
+    }
+
+    return end;
+}
+
+static bool _etag_equal(const char *tag, size_t tag_len, const char *etag)
+{
+    size_t etag_len;
+
+    if (*etag == '"') etag++;
+    etag_len = strlen(etag);
+    if (etag_len > 0 && etag[etag_len - 1] == '"') etag_len--;
+
+    if (tag_len == etag_len) return !strncmp(tag, etag, etag_len);
+
+    /* an ETag for a content encoded variant of the resource (see msaf_content_variant_gzip()) */
+    return tag_len == etag_len + 5 && !strncmp(tag, etag, etag_len) && !strncmp(tag + etag_len, "-gzip", 5);
+}
+
+static bool _parse_http_date(const char *value, time_t *date)
+{
+    struct tm tm = {0};
+    ogs_time_t t;
+
+    if (!ogs_strptime(value, "%a, %d %b %Y %H:%M:%S GMT", &tm)) return false;
+    if (ogs_time_from_gmt(&t, &tm, 0) != OGS_OK) return false;
+
+    *date = (time_t)ogs_time_sec(t);
+
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,99 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#ifndef MSAF_REQUEST_HEADERS_H
+#define MSAF_REQUEST_HEADERS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "ogs-core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The request headers the AF handlers look at. HTTP/1.1 clients can send header names in any letter case while HTTP/2
+ * names are always lower case, so these are found case-insensitively in a single pass over the request headers.
+ */
+typedef enum msaf_request_header_e {
+    MSAF_REQUEST_HEADER_ACCEPT_ENCODING = 0,
+    MSAF_REQUEST_HEADER_AUTHORITY,            /* HTTP/2 :authority pseudo-header */
+    MSAF_REQUEST_HEADER_CONTENT_TYPE,
+    MSAF_REQUEST_HEADER_HOST,
+    MSAF_REQUEST_HEADER_IF_MATCH,
+    MSAF_REQUEST_HEADER_IF_MODIFIED_SINCE,
+    MSAF_REQUEST_HEADER_IF_NONE_MATCH,
+    MSAF_REQUEST_HEADER_IF_UNMODIFIED_SINCE,
+    MSAF_REQUEST_HEADER_X_FORWARDED_FOR,
+    MSAF_REQUEST_HEADER_COUNT,
+    MSAF_REQUEST_HEADER_UNKNOWN = MSAF_REQUEST_HEADER_COUNT
+} msaf_request_header_t;
+
+typedef struct msaf_request_headers_s {
+    const char *values[MSAF_REQUEST_HEADER_COUNT];  /* point into the request headers, NULL if not present */
+} msaf_request_headers_t;
+
+/* Index the well-known headers in http_headers (an ogs_sbi_http_message_t headers hash). The index is only valid while the
+ * request is. */
+extern void msaf_request_headers_index(msaf_request_headers_t *headers /* [out, not-null] */,
+                                       ogs_hash_t *http_headers /* [null] */);
+
+/* Value of a well-known header, or NULL if the request did not have it */
+extern const char *msaf_request_headers_get(const msaf_request_headers_t *headers /* [not-null] */,
+                                            msaf_request_header_t header);
+
+/* The request authority, from the Host header or the HTTP/2 :authority pseudo-header */
+extern const char *msaf_request_headers_host(const msaf_request_headers_t *headers /* [not-null] */);
+
+/* true if the media type of the request Content-Type is content_type, ignoring any parameters. Logs an error if a
+ * different type was given */
+extern bool msaf_request_headers_content_type_is(const msaf_request_headers_t *headers /* [not-null] */,
+                                                 const char *content_type /* [not-null] */);
+
+/* Outcome of evaluating the conditional request headers against the current state of the target resource */
+typedef enum msaf_request_condition_e {
+    MSAF_REQUEST_CONDITION_NONE = 0,          /* no conditions or they all passed, carry on with the request */
+    MSAF_REQUEST_CONDITION_NOT_MODIFIED,      /* respond 304 Not Modified, only for GET and HEAD */
+    MSAF_REQUEST_CONDITION_FAILED             /* respond 412 Precondition Failed */
+} msaf_request_condition_t;
+
+/* true if the request has any of the conditional headers, for when finding the current state of the resource is costly */
+extern bool msaf_request_headers_has_conditions(const msaf_request_headers_t *headers /* [not-null] */);
+
+/* Evaluate If-Match, If-Unmodified-Since, If-None-Match and If-Modified-Since in the order given by RFC 9110 section 13.2.2.
+ *
+ * etag is the current entity-tag of the target resource, or NULL if the resource does not exist. last_modified is 0 if not
+ * known, in which case the date conditions are ignored. safe is true for GET and HEAD requests, which get NOT_MODIFIED
+ * where other methods get FAILED.
+ */
+extern msaf_request_condition_t msaf_request_headers_conditions(const msaf_request_headers_t *headers /* [not-null] */,
+                                                                bool safe, const char *etag /* [null] */,
+                                                                time_t last_modified);
+
+/* true if the If-Match or If-None-Match field value list (a "*" or comma separated entity-tags) includes etag. Quotes are
+ * optional on both. weak allows W/ entity-tags to match (the weak comparison used by If-None-Match). The ETag of a
+ * content encoded variant (etag followed by "-gzip") matches etag as well. */
+extern bool msaf_request_headers_etag_list_matches(const char *list /* [not-null] */, const char *etag /* [null] */,
+                                                   bool weak);
+
+/* Identify a header field name, case-insensitively. Returns MSAF_REQUEST_HEADER_UNKNOWN if it is not a well-known header. */
+extern msaf_request_header_t msaf_request_header_lookup(const char *name /* [not-null] */, size_t name_len);
+extern const char *msaf_request_header_name(msaf_request_header_t header);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
+
+#endif /* MSAF_REQUEST_HEADERS_H */
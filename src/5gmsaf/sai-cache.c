@@ -12,10 +12,16 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #define _GNU_SOURCE
 #endif
 
+#include <inttypes.h>
+#include <time.h>
+
 #include "ogs-core.h"
 
 #include "openapi/model/msaf_api_service_access_information_resource.h"
+#include "content-encoding.h"
 #include "hash.h"
+#include "json-format.h"
+#include "json-writer.h"
 
 #include "sai-cache.h"
 
@@ -23,25 +29,134 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 extern "C" {
 #endif
 
-typedef struct msaf_sai_cache_key_s {
+/* Cache keys are a TLS flag byte followed by the canonical authority bytes
+ * (no NUL). The stored copy of the key lives in the node alongside the entry
+ * pointer so that an insert is a single allocation and a lookup needs no
+ * allocation.
+ */
+#define SAI_CACHE_KEY_MAX (MSAF_SAI_CACHE_MAX_AUTHORITY_LEN + 1)
+
+/* The text replaced in a template and its length, the opening quote and
+ * trailing '/' are included when searching so that only whole server URLs
+ * match, but are not part of the splice.
+ */
+#define SAI_TEMPLATE_URL_PREFIX "http://" MSAF_SAI_CACHE_TEMPLATE_AUTHORITY
+#define SAI_TEMPLATE_URL_PREFIX_LEN (sizeof(SAI_TEMPLATE_URL_PREFIX) - 1)
+
+/* A rendered SAI with the offsets of the placeholder server URLs */
+typedef struct msaf_sai_cache_rendering_s {
+    char *body;
+    size_t body_len;
+    size_t num_splices;
+    size_t *splice_offsets;
+} msaf_sai_cache_rendering_t;
+
+/* The template is rendered in the configured output format and, if that is
+ * not compact, also in the canonical form that ETags are calculated over. The
+ * hash state for the canonical text before the first splice is kept so that
+ * the ETag of a variant only needs the remainder of the body hashing.
+ */
+typedef struct msaf_sai_cache_template_s {
+    msaf_sai_cache_rendering_t output;
+    msaf_sai_cache_rendering_t canonical; /* body is NULL if output is canonical */
+    gnutls_hash_hd_t prefix_hash;         /* NULL if the hash state cannot be copied */
+} msaf_sai_cache_template_t;
+
+struct msaf_sai_cache_s {
+    ogs_hash_t *entries;
+    ogs_list_t lru;          /* msaf_sai_cache_node_t, most recently used first */
+    msaf_sai_cache_template_t *sai_template; /* only ever for the current generation */
+    uint64_t generation;
+};
+
+typedef struct msaf_sai_cache_node_s msaf_sai_cache_node_t;
+
+typedef struct msaf_sai_cache_global_lru_node_s {
+    ogs_lnode_t node;
+    msaf_sai_cache_node_t *owner;
+} msaf_sai_cache_global_lru_node_t;
+
+struct msaf_sai_cache_node_s {
+    ogs_lnode_t node;                            /* cache->lru */
+    msaf_sai_cache_global_lru_node_t global_lru; /* sai_cache_globals.lru */
+    msaf_sai_cache_t *cache;
+    msaf_sai_cache_entry_t *entry;
+    uint64_t generation;                         /* cache->generation when entry was made */
+    size_t size;
     size_t key_len;
-    bool use_tls;
-    char authority[0]; /* actual length is dynamic */
-} msaf_sai_cache_key_t;
+    char key[0]; /* actual length is key_len */
+};
+
+static struct {
+    size_t max_entries;
+    size_t max_bytes;
+    ogs_list_t lru;          /* msaf_sai_cache_global_lru_node_t, most recently used first */
+    msaf_sai_cache_stats_t stats;
+} sai_cache_globals = {
+    MSAF_SAI_CACHE_DEFAULT_MAX_ENTRIES_PER_SESSION,
+    MSAF_SAI_CACHE_DEFAULT_MAX_BYTES
+};
+
+static size_t _msaf_sai_cache_make_key(char *buf, bool tls, const char *authority);
+static const msaf_sai_cache_entry_t *_msaf_sai_cache_insert(msaf_sai_cache_t *cache, const char *key, size_t key_len, msaf_sai_cache_entry_t *entry);
+static msaf_sai_cache_entry_t *_msaf_sai_cache_entry_new(char *body, size_t body_len, char *hash);
+static bool _msaf_sai_write(msaf_json_writer_t *writer, const void *sai);
+static msaf_sai_cache_template_t *_msaf_sai_cache_template_new(const msaf_api_service_access_information_resource_t *sai);
+static msaf_sai_cache_entry_t *_msaf_sai_cache_template_splice(const msaf_sai_cache_template_t *sai_template, bool tls, const char *authority, size_t authority_len);
+static void _msaf_sai_cache_template_free(msaf_sai_cache_template_t *sai_template);
+static void _msaf_sai_cache_rendering_init(msaf_sai_cache_rendering_t *rendering, char *body);
+static size_t _msaf_sai_cache_rendering_spliced_len(const msaf_sai_cache_rendering_t *rendering, size_t scheme_len, size_t authority_len);
+static void _msaf_sai_cache_rendering_splice(const msaf_sai_cache_rendering_t *rendering, const char *scheme, size_t scheme_len,
+                                             const char *authority, size_t authority_len, char *out, gnutls_hash_hd_t hash, bool hash_prefix);
+static void _debug_key(const char *key, size_t key_len, const char *prefix);
+static msaf_sai_cache_node_t *_msaf_sai_cache_find(msaf_sai_cache_t *cache, const char *key, size_t key_len);
+static void _msaf_sai_cache_node_set_entry(msaf_sai_cache_node_t *node, msaf_sai_cache_entry_t *entry);
+static void _msaf_sai_cache_node_touch(msaf_sai_cache_node_t *node);
+static void _msaf_sai_cache_node_remove(msaf_sai_cache_node_t *node);
+static void _msaf_sai_cache_evict(const msaf_sai_cache_node_t *keep);
+
+void msaf_sai_cache_set_limits(size_t max_entries, size_t max_bytes)
+{
+    ogs_debug("msaf_sai_cache_set_limits(max_entries=%zu, max_bytes=%zu)", max_entries, max_bytes);
+
+    sai_cache_globals.max_entries = max_entries;
+    sai_cache_globals.max_bytes = max_bytes;
+}
 
-static void _debug_key(const msaf_sai_cache_key_t *key, const char *prefix);
-static msaf_sai_cache_key_t *_msaf_sai_cache_make_key(bool tls, const char *authority);
-static msaf_sai_cache_entry_t *_msaf_sai_cache_find(msaf_sai_cache_t *cache, const msaf_sai_cache_key_t *key);
+void msaf_sai_cache_get_stats(msaf_sai_cache_stats_t *stats)
+{
+    ogs_assert(stats);
+    *stats = sai_cache_globals.stats;
+}
+
+const char *msaf_sai_cache_canonical_authority(char *buf, bool tls, const char *authority)
+{
+    size_t len;
+
+    len = _msaf_sai_cache_make_key(buf, tls, authority);
+    if (!len) return NULL;
+
+    /* drop the TLS flag byte and NUL terminate */
+    memmove(buf, buf+1, len-1);
+    buf[len-1] = '\0';
+
+    return buf;
+}
 
 msaf_sai_cache_t *msaf_sai_cache_new(void)
 {
-    ogs_hash_t *ret;
+    msaf_sai_cache_t *ret;
+
+    ret = ogs_calloc(1, sizeof(*ret));
+    ogs_assert(ret);
 
-    ret = ogs_hash_make();
+    ret->entries = ogs_hash_make();
+    ogs_assert(ret->entries);
+    ogs_list_init(&ret->lru);
 
     ogs_debug("msaf_sai_cache_new() = %p", ret);
 
-    return (msaf_sai_cache_t*)ret;
+    return ret;
 }
 
 void msaf_sai_cache_free(msaf_sai_cache_t *cache)
@@ -49,85 +164,126 @@ void msaf_sai_cache_free(msaf_sai_cache_t *cache)
     if (!cache) return;
     ogs_debug("msaf_sai_cache_free(%p)", cache);
     msaf_sai_cache_clear(cache);
-    ogs_hash_destroy(cache);
+    ogs_hash_destroy(cache->entries);
+    ogs_free(cache);
 }
 
-bool msaf_sai_cache_add(msaf_sai_cache_t *cache, bool tls, const char *authority, const msaf_api_service_access_information_resource_t *sai)
+const msaf_sai_cache_entry_t *msaf_sai_cache_add(msaf_sai_cache_t *cache, bool tls, const char *authority, const msaf_api_service_access_information_resource_t *sai)
 {
-    msaf_sai_cache_entry_t *entry;
-    msaf_sai_cache_key_t *key;
+    char key[SAI_CACHE_KEY_MAX];
+    size_t key_len;
 
     ogs_assert(cache);
 
     ogs_debug("msaf_sai_cache_add(%p, %s, \"%s\", %p)", cache, tls?"true":"false", authority, sai);
 
-    key = _msaf_sai_cache_make_key(tls, authority);
-    entry = _msaf_sai_cache_find(cache, key);
-    if (entry) {
-        /* replacing existing entry, free old one */
-        msaf_sai_cache_entry_free(entry);
+    key_len = _msaf_sai_cache_make_key(key, tls, authority);
+    if (!key_len) {
+        ogs_error("Authority \"%s\" cannot be used as an SAI cache key", authority);
+        return NULL;
     }
 
-    ogs_hash_set(cache, key, key->key_len, msaf_sai_cache_entry_new(sai));
+    return _msaf_sai_cache_insert(cache, key, key_len, msaf_sai_cache_entry_new(sai));
+}
+
+bool msaf_sai_cache_set_template(msaf_sai_cache_t *cache, const msaf_api_service_access_information_resource_t *template_sai)
+{
+    if (!cache || !template_sai) return false;
+
+    ogs_debug("msaf_sai_cache_set_template(%p, %p)", cache, template_sai);
+
+    _msaf_sai_cache_template_free(cache->sai_template);
+    cache->sai_template = _msaf_sai_cache_template_new(template_sai);
+
     return true;
 }
 
+bool msaf_sai_cache_has_template(msaf_sai_cache_t *cache)
+{
+    return cache && cache->sai_template;
+}
+
+const msaf_sai_cache_entry_t *msaf_sai_cache_add_from_template(msaf_sai_cache_t *cache, bool tls, const char *authority)
+{
+    char key[SAI_CACHE_KEY_MAX];
+    size_t key_len;
+
+    if (!cache || !cache->sai_template) return NULL;
+
+    ogs_debug("msaf_sai_cache_add_from_template(%p, %s, \"%s\")", cache, tls?"true":"false", authority);
+
+    key_len = _msaf_sai_cache_make_key(key, tls, authority);
+    if (!key_len) {
+        ogs_error("Authority \"%s\" cannot be used as an SAI cache key", authority);
+        return NULL;
+    }
+
+    sai_cache_globals.stats.template_splices++;
+
+    /* the canonical authority is the key without its TLS flag byte */
+    return _msaf_sai_cache_insert(cache, key, key_len,
+                                  _msaf_sai_cache_template_splice(cache->sai_template, tls, key + 1, key_len - 1));
+}
+
 bool msaf_sai_cache_del(msaf_sai_cache_t *cache, bool tls, const char *authority)
 {
-    msaf_sai_cache_entry_t *entry;
-    msaf_sai_cache_key_t *key;
+    msaf_sai_cache_node_t *node;
+    char key[SAI_CACHE_KEY_MAX];
+    size_t key_len;
 
     if (!cache) return false;
 
     ogs_debug("msaf_sai_cache_del(%p, %s, \"%s\")", cache, tls?"true":"false", authority);
 
-    key = _msaf_sai_cache_make_key(tls, authority);
+    key_len = _msaf_sai_cache_make_key(key, tls, authority);
+    if (!key_len) return false;
 
-    entry = _msaf_sai_cache_find(cache, key);
+    node = _msaf_sai_cache_find(cache, key, key_len);
+    if (!node) return false;
 
-    if (entry) {
-        msaf_sai_cache_entry_free(entry);
-        ogs_hash_set(cache, key, key->key_len, NULL);
-        ogs_free(key);
-        return true;
-    }
+    _msaf_sai_cache_node_remove(node);
 
-    ogs_free(key);
-    return false;
+    return true;
 }
 
 const msaf_sai_cache_entry_t *msaf_sai_cache_find(msaf_sai_cache_t *cache, bool tls, const char *authority)
 {
-    msaf_sai_cache_key_t *key;
-    const msaf_sai_cache_entry_t *entry;
+    msaf_sai_cache_node_t *node = NULL;
+    char key[SAI_CACHE_KEY_MAX];
+    size_t key_len;
 
-    //ogs_debug("msaf_sai_cache_find(cache=%p, tls=%s, authority=\"%s\")", cache, tls?"true":"false", authority);
-    key = _msaf_sai_cache_make_key(tls, authority);
-    entry = (const msaf_sai_cache_entry_t*)_msaf_sai_cache_find(cache, key);
-    ogs_free(key);
-    return entry;
+    if (!cache) return NULL;
+
+    key_len = _msaf_sai_cache_make_key(key, tls, authority);
+    if (key_len) node = _msaf_sai_cache_find(cache, key, key_len);
+
+    if (!node) {
+        sai_cache_globals.stats.misses++;
+        return NULL;
+    }
+
+    sai_cache_globals.stats.hits++;
+    _msaf_sai_cache_node_touch(node);
+
+    return node->entry;
 }
 
 bool msaf_sai_cache_clear(msaf_sai_cache_t *cache)
 {
-    ogs_hash_index_t *it;
+    msaf_sai_cache_node_t *node, *next;
 
     if (!cache) return false;
 
-    ogs_debug("msaf_sai_cache_clear(%p) [%i entries]", cache, ogs_hash_count(cache));
-    for (it = ogs_hash_first(cache); it; it = ogs_hash_next(it)) {
-        const msaf_sai_cache_key_t *key;
-        int key_len;
-        msaf_sai_cache_entry_t *entry;
-
-        ogs_hash_this(it, (const void **)&key, &key_len, (void**)(&entry));
-        _debug_key(key, "=");
-        ogs_debug("clear %p[%i]: %p", key, key_len, entry);
-        ogs_hash_set(cache, key, key_len, NULL);
-        ogs_free((msaf_sai_cache_key_t*)key);
-        msaf_sai_cache_entry_free(entry);
+    ogs_debug("msaf_sai_cache_clear(%p) [%i entries]", cache, ogs_hash_count(cache->entries));
+    ogs_list_for_each_safe(&cache->lru, next, node) {
+        _debug_key(node->key, node->key_len, "=");
+        _msaf_sai_cache_node_remove(node);
     }
-    ogs_debug("Entries after clear = %i", ogs_hash_count(cache));
+    ogs_debug("Entries after clear = %i", ogs_hash_count(cache->entries));
+
+    /* the template belongs to the configuration that is being cleared */
+    _msaf_sai_cache_template_free(cache->sai_template);
+    cache->sai_template = NULL;
 
     return true;
 }
@@ -137,75 +293,447 @@ bool msaf_sai_cache_clear_authority(msaf_sai_cache_t *cache, bool tls, const cha
     return msaf_sai_cache_del(cache, tls, authority);
 }
 
-msaf_sai_cache_entry_t *msaf_sai_cache_entry_new(const msaf_api_service_access_information_resource_t *sai)
+unsigned int msaf_sai_cache_count(msaf_sai_cache_t *cache)
 {
-    msaf_sai_cache_entry_t *entry;
-    cJSON *sai_json;
+    if (!cache) return 0;
+    return ogs_hash_count(cache->entries);
+}
 
-    entry = ogs_calloc(1, sizeof(*entry));
-    ogs_assert(entry);
+uint64_t msaf_sai_cache_invalidate(msaf_sai_cache_t *cache)
+{
+    ogs_assert(cache);
 
-    sai_json = msaf_api_service_access_information_resource_convertResponseToJSON((msaf_api_service_access_information_resource_t*)sai);
-    ogs_assert(sai_json);
+    _msaf_sai_cache_template_free(cache->sai_template);
+    cache->sai_template = NULL;
+    cache->generation++;
 
-    entry->sai_body = cJSON_Print(sai_json);
-    cJSON_Delete(sai_json);
+    ogs_debug("msaf_sai_cache_invalidate(%p) = %" PRIu64, cache, cache->generation);
 
-    entry->hash = calculate_hash(entry->sai_body);
+    return cache->generation;
+}
 
-    entry->generated = ogs_time_now();
+uint64_t msaf_sai_cache_generation(msaf_sai_cache_t *cache)
+{
+    if (!cache) return 0;
+    return cache->generation;
+}
 
-    return entry;
+unsigned int msaf_sai_cache_refresh(msaf_sai_cache_t *cache)
+{
+    msaf_sai_cache_node_t *node;
+    unsigned int count = 0;
+
+    if (!cache || !cache->sai_template) return 0;
+
+    /* most recently used first, entries are swapped in place so the LRU order is unchanged */
+    ogs_list_for_each(&cache->lru, node) {
+        if (node->generation == cache->generation) continue;
+
+        _msaf_sai_cache_node_set_entry(node, _msaf_sai_cache_template_splice(cache->sai_template, node->key[0] == 's',
+                                                                              node->key + 1, node->key_len - 1));
+        node->generation = cache->generation;
+        count++;
+    }
+    sai_cache_globals.stats.regenerations += count;
+
+    ogs_debug("msaf_sai_cache_refresh(%p) regenerated %u entries for generation %" PRIu64, cache, count, cache->generation);
+
+    /* regenerated entries may be larger than the ones they replaced */
+    if (count) _msaf_sai_cache_evict(NULL);
+
+    return count;
+}
+
+msaf_sai_cache_entry_t *msaf_sai_cache_entry_new(const msaf_api_service_access_information_resource_t *sai)
+{
+    char *body;
+    char *hash;
+    size_t body_len;
+
+    body = msaf_json_write_with_hash(_msaf_sai_write, sai, 0, &body_len, &hash);
+    ogs_assert(body);
+
+    return _msaf_sai_cache_entry_new(body, body_len, hash);
+}
+
+msaf_sai_cache_entry_t *msaf_sai_cache_entry_ref(const msaf_sai_cache_entry_t *entry)
+{
+    msaf_sai_cache_entry_t *ret = (msaf_sai_cache_entry_t*)entry;
+
+    ogs_assert(ret);
+    ret->refs++;
+
+    return ret;
 }
 
 void msaf_sai_cache_entry_free(msaf_sai_cache_entry_t *entry)
 {
     if (!entry) return;
 
-    if (entry->sai_body) cJSON_free(entry->sai_body);
+    ogs_assert(entry->refs > 0);
+    if (--entry->refs > 0) return;
+
+    if (entry->sai_body) ogs_free(entry->sai_body);
     if (entry->hash) ogs_free(entry->hash);
+    msaf_content_variant_clear(&entry->gzip);
 
     ogs_free(entry);
 }
 
 /**** Static functions ****/
 
-static msaf_sai_cache_key_t *_msaf_sai_cache_make_key(bool tls, const char *authority)
+/* Build the key for (tls, authority) in buf, which must be at least
+ * SAI_CACHE_KEY_MAX bytes. The authority is canonicalised so that equivalent
+ * Host header values share a cache entry: the host is lower-cased, a trailing
+ * '.' on the host is removed and the default port for the scheme is dropped.
+ * Returns the key length or 0 if the authority is too long or contains
+ * characters that cannot appear in an authority.
+ */
+static size_t _msaf_sai_cache_make_key(char *buf, bool tls, const char *authority)
 {
-    msaf_sai_cache_key_t *key;
-    size_t key_len;
+    const char *default_port = tls?"443":"80";
+    size_t len = 1;
+    size_t host_end = 0;
+    bool in_ip_literal = false;
+    const char *p;
+
+    buf[0] = tls?'s':'p';
+
+    if (!authority) return len;
+
+    for (p = authority; *p; p++) {
+        char c = *p;
+
+        if (len > MSAF_SAI_CACHE_MAX_AUTHORITY_LEN) return 0;
+
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        } else if (c == '[') {
+            if (len != 1) return 0;
+            in_ip_literal = true;
+        } else if (c == ']') {
+            if (!in_ip_literal) return 0;
+            in_ip_literal = false;
+        } else if (c == ':' && !in_ip_literal) {
+            if (host_end) return 0;
+            host_end = len;
+        } else if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' || c == '.' || c == '_' || c == ':')) {
+            return 0;
+        }
+
+        buf[len++] = c;
+    }
+    if (in_ip_literal) return 0;
+
+    if (host_end) {
+        /* port must be numeric, the default port is removed */
+        size_t port_len = len - host_end - 1;
+        if (strspn(buf + host_end + 1, "0123456789") < port_len) return 0;
+        if (port_len == 0 || (port_len == strlen(default_port) && !memcmp(buf + host_end + 1, default_port, port_len))) {
+            len = host_end;
+            host_end = 0;
+        }
+    }
+
+    /* remove trailing '.' from a fully qualified host name */
+    if (host_end) {
+        if (host_end > 2 && buf[host_end-1] == '.') {
+            memmove(buf + host_end - 1, buf + host_end, len - host_end);
+            len--;
+        }
+    } else if (len > 2 && buf[len-1] == '.') {
+        len--;
+    }
+
+    return len;
+}
+
+/* Takes ownership of body and hash */
+static msaf_sai_cache_entry_t *_msaf_sai_cache_entry_new(char *body, size_t body_len, char *hash)
+{
+    msaf_sai_cache_entry_t *entry;
+    struct tm tm;
+    time_t last_modified;
+
+    entry = ogs_calloc(1, sizeof(*entry));
+    ogs_assert(entry);
+
+    entry->sai_body = body;
+    entry->sai_body_len = body_len;
+    entry->hash = hash;
+    entry->generated = ogs_time_now();
+
+    /* compress once here so that responses never pay for it */
+    msaf_content_variant_gzip(&entry->gzip, body, body_len, hash);
+
+    /* Last-Modified is rounded up to the next second so If-Modified-Since comparisons work */
+    last_modified = ogs_time_sec(entry->generated) + 1;
+    gmtime_r(&last_modified, &tm);
+    strftime(entry->last_modified, sizeof(entry->last_modified), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+
+    entry->refs = 1;
+
+    return entry;
+}
+
+static msaf_sai_cache_template_t *_msaf_sai_cache_template_new(const msaf_api_service_access_information_resource_t *sai)
+{
+    msaf_sai_cache_template_t *sai_template;
+    const msaf_sai_cache_rendering_t *canonical;
+    msaf_json_writer_t writer;
+
+    sai_template = ogs_calloc(1, sizeof(*sai_template));
+    ogs_assert(sai_template);
+
+    /* written straight from the model, no cJSON tree */
+    msaf_json_writer_init(&writer, msaf_json_format_get(), 0);
+    ogs_assert(_msaf_sai_write(&writer, sai));
+    _msaf_sai_cache_rendering_init(&sai_template->output, msaf_json_writer_finish(&writer, NULL));
+    if (msaf_json_format_get() != MSAF_JSON_FORMAT_COMPACT) {
+        msaf_json_writer_init(&writer, MSAF_JSON_FORMAT_COMPACT, sai_template->output.body_len);
+        ogs_assert(_msaf_sai_write(&writer, sai));
+        _msaf_sai_cache_rendering_init(&sai_template->canonical, msaf_json_writer_finish(&writer, NULL));
+        /* same document, so the same server URLs */
+        ogs_assert(sai_template->canonical.num_splices == sai_template->output.num_splices);
+    }
+
+    /* hash the fixed text before the first splice once */
+    canonical = sai_template->canonical.body?&sai_template->canonical:&sai_template->output;
+    sai_template->prefix_hash = calculate_hash_init();
+    calculate_hash_update(sai_template->prefix_hash, canonical->body,
+                          canonical->num_splices?canonical->splice_offsets[0]:canonical->body_len);
+
+    ogs_debug("SAI template of %zu bytes with %zu splice points", sai_template->output.body_len, sai_template->output.num_splices);
+
+    return sai_template;
+}
+
+/* Build a cache entry from the template by replacing each placeholder with
+ * the scheme and canonical authority. The ETag is continued from the saved
+ * prefix hash state, or hashed from the start if that could not be copied.
+ */
+static msaf_sai_cache_entry_t *_msaf_sai_cache_template_splice(const msaf_sai_cache_template_t *sai_template, bool tls, const char *authority, size_t authority_len)
+{
+    const char *scheme = tls?"https://":"http://";
+    size_t scheme_len = tls?8:7;
+    bool hash_prefix = false;
+    gnutls_hash_hd_t hash;
+    char *body;
+    size_t body_len;
+
+    body_len = _msaf_sai_cache_rendering_spliced_len(&sai_template->output, scheme_len, authority_len);
+    body = ogs_malloc(body_len + 1);
+    ogs_assert(body);
+
+    hash = calculate_hash_copy(sai_template->prefix_hash);
+    if (!hash) {
+        hash = calculate_hash_init();
+        hash_prefix = true;
+    }
+
+    if (sai_template->canonical.body) {
+        _msaf_sai_cache_rendering_splice(&sai_template->output, scheme, scheme_len, authority, authority_len, body, NULL, false);
+        _msaf_sai_cache_rendering_splice(&sai_template->canonical, scheme, scheme_len, authority, authority_len, NULL, hash, hash_prefix);
+    } else {
+        _msaf_sai_cache_rendering_splice(&sai_template->output, scheme, scheme_len, authority, authority_len, body, hash, hash_prefix);
+    }
+
+    return _msaf_sai_cache_entry_new(body, body_len, calculate_hash_final(hash));
+}
+
+static bool _msaf_sai_write(msaf_json_writer_t *writer, const void *sai)
+{
+    return msaf_api_service_access_information_resource_writeResponseJSON(writer, (const msaf_api_service_access_information_resource_t*)sai);
+}
+
+static void _msaf_sai_cache_template_free(msaf_sai_cache_template_t *sai_template)
+{
+    if (!sai_template) return;
+
+    if (sai_template->output.body) ogs_free(sai_template->output.body);
+    if (sai_template->output.splice_offsets) ogs_free(sai_template->output.splice_offsets);
+    if (sai_template->canonical.body) ogs_free(sai_template->canonical.body);
+    if (sai_template->canonical.splice_offsets) ogs_free(sai_template->canonical.splice_offsets);
+    calculate_hash_free(sai_template->prefix_hash);
+
+    ogs_free(sai_template);
+}
+
+/* Takes ownership of body and records where each placeholder server URL starts */
+static void _msaf_sai_cache_rendering_init(msaf_sai_cache_rendering_t *rendering, char *body)
+{
+    const char *p;
+    size_t max_splices = 0;
+
+    ogs_assert(body);
+
+    rendering->body = body;
+    rendering->body_len = strlen(body);
+
+    for (p = strstr(body, SAI_TEMPLATE_URL_PREFIX); p; p = strstr(p + SAI_TEMPLATE_URL_PREFIX_LEN, SAI_TEMPLATE_URL_PREFIX)) {
+        if (p == body || p[-1] != '"' || p[SAI_TEMPLATE_URL_PREFIX_LEN] != '/') continue;
+        if (rendering->num_splices == max_splices) {
+            max_splices = max_splices?max_splices*2:4;
+            rendering->splice_offsets = ogs_realloc(rendering->splice_offsets, max_splices * sizeof(rendering->splice_offsets[0]));
+            ogs_assert(rendering->splice_offsets);
+        }
+        rendering->splice_offsets[rendering->num_splices++] = p - body;
+    }
+}
+
+static size_t _msaf_sai_cache_rendering_spliced_len(const msaf_sai_cache_rendering_t *rendering, size_t scheme_len, size_t authority_len)
+{
+    return rendering->body_len + rendering->num_splices * (scheme_len + authority_len) - rendering->num_splices * SAI_TEMPLATE_URL_PREFIX_LEN;
+}
 
-    key_len = sizeof(*key)+strlen(authority)+1;
-    key = ogs_calloc(1, key_len);
-    ogs_assert(key);
+/* Write the spliced rendering to out (if not NULL) and add it to hash (if not
+ * NULL). The text before the first splice is only hashed if hash_prefix is set.
+ */
+static void _msaf_sai_cache_rendering_splice(const msaf_sai_cache_rendering_t *rendering, const char *scheme, size_t scheme_len,
+                                             const char *authority, size_t authority_len, char *out, gnutls_hash_hd_t hash, bool hash_prefix)
+{
+    size_t from;
+    size_t i;
+
+    from = rendering->num_splices?rendering->splice_offsets[0]:rendering->body_len;
+    if (out) {
+        memcpy(out, rendering->body, from);
+        out += from;
+    }
+    if (hash && hash_prefix) calculate_hash_update(hash, rendering->body, from);
 
-    key->key_len = key_len;
-    key->use_tls = tls;
-    strcpy(key->authority, authority);
+    for (i = 0; i < rendering->num_splices; i++) {
+        size_t to = (i + 1 < rendering->num_splices)?rendering->splice_offsets[i+1]:rendering->body_len;
 
-    return key;
+        from = rendering->splice_offsets[i] + SAI_TEMPLATE_URL_PREFIX_LEN;
+        if (out) {
+            memcpy(out, scheme, scheme_len);
+            memcpy(out + scheme_len, authority, authority_len);
+            memcpy(out + scheme_len + authority_len, rendering->body + from, to - from);
+            out += scheme_len + authority_len + to - from;
+        }
+        if (hash) {
+            calculate_hash_update(hash, scheme, scheme_len);
+            calculate_hash_update(hash, authority, authority_len);
+            calculate_hash_update(hash, rendering->body + from, to - from);
+        }
+    }
+
+    if (out) *out = '\0';
 }
 
-static void _debug_key(const msaf_sai_cache_key_t *key, const char *prefix)
+static void _debug_key(const char *key, size_t key_len, const char *prefix)
 {
-    ogs_debug("%s len=%zi, tls=%s, authority=\"%s\"", prefix, key->key_len, key->use_tls?"true":"false", key->authority);
+    ogs_debug("%s len=%zu, tls=%s, authority=\"%.*s\"", prefix, key_len, key[0]=='s'?"true":"false", (int)(key_len-1), key+1);
 }
 
-static msaf_sai_cache_entry_t *_msaf_sai_cache_find(msaf_sai_cache_t *cache, const msaf_sai_cache_key_t *key)
+static msaf_sai_cache_node_t *_msaf_sai_cache_find(msaf_sai_cache_t *cache, const char *key, size_t key_len)
 {
-    {
-        ogs_hash_index_t *it;
-        _debug_key(key,"*");
-        for (it = ogs_hash_first(cache); it; it = ogs_hash_next(it)) {
-            const msaf_sai_cache_key_t *hkey;
-            int key_len;
-            msaf_sai_cache_entry_t *entry;
+    return (msaf_sai_cache_node_t*)ogs_hash_get(cache->entries, key, key_len);
+}
 
-            ogs_hash_this(it, (const void**)&hkey, &key_len, (void **)&entry);
-            _debug_key(hkey,">");
+static const msaf_sai_cache_entry_t *_msaf_sai_cache_insert(msaf_sai_cache_t *cache, const char *key, size_t key_len, msaf_sai_cache_entry_t *entry)
+{
+    msaf_sai_cache_node_t *node;
+
+    node = _msaf_sai_cache_find(cache, key, key_len);
+    if (node) {
+        /* replacing existing entry, the key is unchanged so reuse the node */
+        _msaf_sai_cache_node_set_entry(node, entry);
+        _msaf_sai_cache_node_touch(node);
+        node->generation = cache->generation;
+    } else {
+        /* make room for the new entry in this cache */
+        if (sai_cache_globals.max_entries) {
+            while (ogs_hash_count(cache->entries) >= sai_cache_globals.max_entries) {
+                _msaf_sai_cache_node_remove(ogs_list_last(&cache->lru));
+                sai_cache_globals.stats.evictions++;
+            }
         }
+
+        node = ogs_calloc(1, sizeof(*node) + key_len);
+        ogs_assert(node);
+        node->cache = cache;
+        node->global_lru.owner = node;
+        node->generation = cache->generation;
+        node->key_len = key_len;
+        memcpy(node->key, key, key_len);
+
+        ogs_hash_set(cache->entries, node->key, node->key_len, node);
+        ogs_list_prepend(&cache->lru, node);
+        ogs_list_prepend(&sai_cache_globals.lru, &node->global_lru);
+        sai_cache_globals.stats.entries++;
+
+        _msaf_sai_cache_node_set_entry(node, entry);
+    }
+    sai_cache_globals.stats.insertions++;
+
+    /* keep within the global memory budget, possibly evicting from other caches */
+    _msaf_sai_cache_evict(node);
+
+    return node->entry;
+}
+
+static void _msaf_sai_cache_node_set_entry(msaf_sai_cache_node_t *node, msaf_sai_cache_entry_t *entry)
+{
+    size_t size;
+
+    if (node->entry) msaf_sai_cache_entry_free(node->entry);
+    sai_cache_globals.stats.bytes -= node->size;
+
+    node->entry = entry;
+
+    size = sizeof(*node) + node->key_len + sizeof(*entry) + entry->sai_body_len + 1;
+    if (entry->hash) size += strlen(entry->hash) + 1;
+    if (entry->gzip.body) size += entry->gzip.length;
+    if (entry->gzip.etag) size += strlen(entry->gzip.etag) + 1;
+    if (entry->gzip.source_etag) size += strlen(entry->gzip.source_etag) + 1;
+    node->size = size;
+
+    sai_cache_globals.stats.bytes += size;
+}
+
+static void _msaf_sai_cache_node_touch(msaf_sai_cache_node_t *node)
+{
+    if (ogs_list_first(&node->cache->lru) != node) {
+        ogs_list_remove(&node->cache->lru, node);
+        ogs_list_prepend(&node->cache->lru, node);
+    }
+    if (ogs_list_first(&sai_cache_globals.lru) != &node->global_lru) {
+        ogs_list_remove(&sai_cache_globals.lru, &node->global_lru);
+        ogs_list_prepend(&sai_cache_globals.lru, &node->global_lru);
+    }
+}
+
+static void _msaf_sai_cache_node_remove(msaf_sai_cache_node_t *node)
+{
+    ogs_hash_set(node->cache->entries, node->key, node->key_len, NULL);
+    ogs_list_remove(&node->cache->lru, node);
+    ogs_list_remove(&sai_cache_globals.lru, &node->global_lru);
+
+    sai_cache_globals.stats.entries--;
+    sai_cache_globals.stats.bytes -= node->size;
+
+    msaf_sai_cache_entry_free(node->entry);
+    ogs_free(node);
+}
+
+/* Evict least recently used entries, from any cache, until the global memory
+ * budget is met. The entry just added (keep), if given, is never evicted.
+ */
+static void _msaf_sai_cache_evict(const msaf_sai_cache_node_t *keep)
+{
+    if (!sai_cache_globals.max_bytes) return;
+
+    while (sai_cache_globals.stats.bytes > sai_cache_globals.max_bytes) {
+        msaf_sai_cache_global_lru_node_t *lru = ogs_list_last(&sai_cache_globals.lru);
+
+        if (!lru || lru->owner == keep) break;
+
+        _debug_key(lru->owner->key, lru->owner->key_len, "evict");
+        _msaf_sai_cache_node_remove(lru->owner);
+        sai_cache_globals.stats.evictions++;
     }
-    return (msaf_sai_cache_entry_t*)ogs_hash_get(cache, key, key->key_len);
 }
 
 #ifdef __cplusplus
@@ -17,29 +17,91 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 
 #include "ogs-core.h"
 
+#include "content-encoding.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 typedef struct msaf_api_service_access_information_resource_s msaf_api_service_access_information_resource_t;
 
+/* A cache entry holds the pre-rendered SAI response: the body, its length,
+ * the ETag and Last-Modified header values and a gzip encoded variant of the
+ * body (gzip.body is NULL if compression did not make the body smaller).
+ * Entries are reference counted so that a response in progress can keep
+ * using an entry after the cache has replaced or evicted it.
+ */
 typedef struct msaf_sai_cache_entry_s {
     char *sai_body;
+    size_t sai_body_len;
     char *hash;
     ogs_time_t generated;
+    char last_modified[32];
+    msaf_content_variant_t gzip;
+    unsigned int refs;
 } msaf_sai_cache_entry_t;
 
-typedef ogs_hash_t msaf_sai_cache_t;
+typedef struct msaf_sai_cache_s msaf_sai_cache_t;
+
+typedef struct msaf_sai_cache_stats_s {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t insertions;
+    uint64_t evictions;
+    uint64_t template_splices;
+    uint64_t regenerations;
+    size_t entries;
+    size_t bytes;
+} msaf_sai_cache_stats_t;
+
+/* Longest authority (host[:port]) that can be cached. Lookups build the cache
+ * key on the stack so this bounds the stack buffer used by msaf_sai_cache_find().
+ */
+#define MSAF_SAI_CACHE_MAX_AUTHORITY_LEN 1023
+
+/* Server authority to use when generating the SAI passed to msaf_sai_cache_set_template().
+ * The template must be generated for a non-TLS server, every "http://<placeholder>" server
+ * URL is replaced by the scheme and authority of the request when splicing.
+ */
+#define MSAF_SAI_CACHE_TEMPLATE_AUTHORITY "msaf-sai-template.invalid"
+
+/* Default limits, 0 means unlimited */
+#define MSAF_SAI_CACHE_DEFAULT_MAX_ENTRIES_PER_SESSION 128
+#define MSAF_SAI_CACHE_DEFAULT_MAX_BYTES (64*1024*1024)
+
+/* Limits shared by all SAI caches: max_entries applies to each cache, max_bytes to all caches together */
+void msaf_sai_cache_set_limits(size_t max_entries, size_t max_bytes);
+void msaf_sai_cache_get_stats(msaf_sai_cache_stats_t *stats);
+
+/* Lower-case host, strip trailing '.' from host and remove default port. buf must hold MSAF_SAI_CACHE_MAX_AUTHORITY_LEN+1 chars.
+ * Returns buf or NULL if the authority is invalid or too long. */
+const char *msaf_sai_cache_canonical_authority(char *buf, bool tls, const char *authority);
 
 msaf_sai_cache_t *msaf_sai_cache_new(void);
 void msaf_sai_cache_free(msaf_sai_cache_t*);
-bool msaf_sai_cache_add(msaf_sai_cache_t*, bool tls, const char *authority, const msaf_api_service_access_information_resource_t *);
+const msaf_sai_cache_entry_t *msaf_sai_cache_add(msaf_sai_cache_t*, bool tls, const char *authority, const msaf_api_service_access_information_resource_t *);
 bool msaf_sai_cache_del(msaf_sai_cache_t*, bool tls, const char *authority);
 const msaf_sai_cache_entry_t *msaf_sai_cache_find(msaf_sai_cache_t*, bool tls, const char *authority);
 bool msaf_sai_cache_clear(msaf_sai_cache_t*);
 bool msaf_sai_cache_clear_authority(msaf_sai_cache_t*, bool tls, const char *authority);
+unsigned int msaf_sai_cache_count(msaf_sai_cache_t*);
+
+/* SAI template for the current provisioning session configuration, dropped by msaf_sai_cache_clear() */
+bool msaf_sai_cache_set_template(msaf_sai_cache_t*, const msaf_api_service_access_information_resource_t *template_sai);
+bool msaf_sai_cache_has_template(msaf_sai_cache_t*);
+/* Add an entry for (tls, authority) by splicing the authority into the template. Returns NULL if there is no template. */
+const msaf_sai_cache_entry_t *msaf_sai_cache_add_from_template(msaf_sai_cache_t*, bool tls, const char *authority);
+
+/* Start a new generation after a configuration change. The template is dropped but existing entries are kept, and still
+ * returned by msaf_sai_cache_find(), until msaf_sai_cache_refresh() replaces them. Returns the new generation number. */
+uint64_t msaf_sai_cache_invalidate(msaf_sai_cache_t*);
+uint64_t msaf_sai_cache_generation(msaf_sai_cache_t*);
+/* Replace every entry from an earlier generation using the current template. Returns the number of entries replaced. */
+unsigned int msaf_sai_cache_refresh(msaf_sai_cache_t*);
 
 msaf_sai_cache_entry_t *msaf_sai_cache_entry_new(const msaf_api_service_access_information_resource_t *);
+msaf_sai_cache_entry_t *msaf_sai_cache_entry_ref(const msaf_sai_cache_entry_t*);
+/* Drops a reference, the entry is freed when the last reference is dropped */
 void msaf_sai_cache_entry_free(msaf_sai_cache_entry_t*);
 
 #ifdef __cplusplus
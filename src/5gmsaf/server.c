@@ -11,9 +11,10 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #include "ogs-sbi.h"
 #include "server.h"
 #include "utilities.h"
+#include "json-format.h"
 #include "msaf-version.h"
 
-static bool nf_server_send_problem(ogs_sbi_stream_t *stream, OpenAPI_problem_details_t *problem,
+static bool nf_server_send_problem(ogs_sbi_stream_t *stream, OpenAPI_problem_details_t *problem, int retry_after,
         const nf_server_interface_metadata_t *interface, const nf_server_app_metadata_t *app);
 
 static ogs_sbi_response_t *nf_build_response(ogs_sbi_message_t *message, int status,
@@ -23,12 +24,13 @@ static bool nf_build_content(ogs_sbi_http_message_t *http, ogs_sbi_message_t *me
 
 static char *nf_build_json(ogs_sbi_message_t *message);
 
+static char *nf_build_server_header(const nf_server_interface_metadata_t *interface, const nf_server_app_metadata_t *app);
+
 ogs_sbi_response_t *nf_server_new_response(char *location, char *content_type, time_t last_modified, char *etag,
         int cache_control, char *allow_methods, const nf_server_interface_metadata_t *interface,
         const nf_server_app_metadata_t *app)
 {
     ogs_sbi_response_t *response = NULL;
-    char *server_api_info = ((char*)"");
     char *server = NULL;
 
     response = ogs_sbi_response_new();
@@ -71,13 +73,7 @@ ogs_sbi_response_t *nf_server_new_response(char *location, char *content_type, t
     }
 
 
-    if (interface) {
-        server_api_info = ogs_msprintf(" (info.title=%s; info.version=%s)", interface->api_title, interface->api_version);
-    }
-    server = ogs_msprintf("%s/%s%s %s/%s",app->server_name, FIVEG_API_RELEASE, server_api_info, app->app_name, app->app_version);
-    if (interface) {
-        ogs_free(server_api_info);
-    }
+    server = nf_build_server_header(interface, app);
     ogs_sbi_header_set(response->http.headers, "Server", server);
     ogs_free(server);
     return response;
@@ -85,6 +81,48 @@ ogs_sbi_response_t *nf_server_new_response(char *location, char *content_type, t
 
 }
 
+nf_server_prerendered_headers_t *nf_server_prerendered_headers_new(int cache_control,
+        const nf_server_interface_metadata_t *interface, const nf_server_app_metadata_t *app)
+{
+    nf_server_prerendered_headers_t *headers;
+
+    headers = ogs_calloc(1, sizeof(*headers));
+    ogs_assert(headers);
+
+    if (cache_control) headers->cache_control = ogs_msprintf("max-age=%d", cache_control);
+    headers->server = nf_build_server_header(interface, app);
+
+    return headers;
+}
+
+void nf_server_prerendered_headers_free(nf_server_prerendered_headers_t *headers)
+{
+    if (!headers) return;
+
+    if (headers->cache_control) ogs_free(headers->cache_control);
+    if (headers->server) ogs_free(headers->server);
+    ogs_free(headers);
+}
+
+ogs_sbi_response_t *nf_server_new_prerendered_response(const nf_server_prerendered_headers_t *headers,
+        const char *content_type, const char *last_modified, const char *etag)
+{
+    ogs_sbi_response_t *response;
+
+    ogs_assert(headers);
+
+    response = ogs_sbi_response_new();
+    ogs_expect(response);
+
+    if (content_type) ogs_sbi_header_set(response->http.headers, "Content-Type", content_type);
+    if (last_modified) ogs_sbi_header_set(response->http.headers, "Last-Modified", last_modified);
+    if (etag) ogs_sbi_header_set(response->http.headers, "ETag", etag);
+    if (headers->cache_control) ogs_sbi_header_set(response->http.headers, "Cache-Control", headers->cache_control);
+    ogs_sbi_header_set(response->http.headers, "Server", headers->server);
+
+    return response;
+}
+
 ogs_sbi_response_t *nf_server_populate_response(ogs_sbi_response_t *response, int content_length, char *content, int status)
 {
     response->http.content_length = content_length;
@@ -94,8 +132,16 @@ ogs_sbi_response_t *nf_server_populate_response(ogs_sbi_response_t *response, in
 
 }
 
+void nf_server_set_content_encoding(ogs_sbi_response_t *response, const char *content_encoding)
+{
+    ogs_assert(response);
+
+    ogs_sbi_header_set(response->http.headers, "Vary", "Accept-Encoding");
+    if (content_encoding) ogs_sbi_header_set(response->http.headers, "Content-Encoding", content_encoding);
+}
+
 static bool nf_server_send_problem(
-        ogs_sbi_stream_t *stream, OpenAPI_problem_details_t *problem, const nf_server_interface_metadata_t *interface, const nf_server_app_metadata_t *app)
+        ogs_sbi_stream_t *stream, OpenAPI_problem_details_t *problem, int retry_after, const nf_server_interface_metadata_t *interface, const nf_server_app_metadata_t *app)
 {
     ogs_sbi_message_t message;
     ogs_sbi_response_t *response = NULL;
@@ -111,6 +157,12 @@ static bool nf_server_send_problem(
     response = nf_build_response(&message, problem->status, interface, app);
     ogs_assert(response);
 
+    if (retry_after > 0) {
+        char value[16];
+        snprintf(value, sizeof(value), "%i", retry_after);
+        ogs_sbi_header_set(response->http.headers, "Retry-After", value);
+    }
+
     ogs_sbi_server_send_response(stream, response);
 
     return true;
@@ -120,6 +172,13 @@ static bool nf_server_send_problem(
 bool nf_server_send_error(ogs_sbi_stream_t *stream,
         int status, int number_of_components, ogs_sbi_message_t *message,
         const char *title, const char *detail, cJSON * problem_detail, const nf_server_interface_metadata_t *interface, const nf_server_app_metadata_t *app)
+{
+    return nf_server_send_error_retry_after(stream, status, 0, number_of_components, message, title, detail, problem_detail, interface, app);
+}
+
+bool nf_server_send_error_retry_after(ogs_sbi_stream_t *stream,
+        int status, int retry_after, int number_of_components, ogs_sbi_message_t *message,
+        const char *title, const char *detail, cJSON * problem_detail, const nf_server_interface_metadata_t *interface, const nf_server_app_metadata_t *app)
 {
     OpenAPI_problem_details_t problem;
     OpenAPI_problem_details_t *problem_details = NULL;
@@ -158,7 +217,7 @@ bool nf_server_send_error(ogs_sbi_stream_t *stream,
     if (title) problem.title = msaf_strdup(title);
     if (detail) problem.detail = msaf_strdup(detail);
 
-    nf_server_send_problem(stream, &problem, interface, app);
+    nf_server_send_problem(stream, &problem, retry_after, interface, app);
 
     if (problem.type)
         ogs_free(problem.type);
@@ -236,7 +295,7 @@ static char *nf_build_json(ogs_sbi_message_t *message)
         ogs_assert(item);
     }
     if (item) {
-        content = cJSON_Print(item);
+        content = msaf_json_print(item);
         ogs_assert(content);
         ogs_log_print(OGS_LOG_TRACE, "%s", content);
         cJSON_Delete(item);
@@ -245,5 +304,21 @@ static char *nf_build_json(ogs_sbi_message_t *message)
     return content;
 }
 
+static char *nf_build_server_header(const nf_server_interface_metadata_t *interface, const nf_server_app_metadata_t *app)
+{
+    char *server_api_info = ((char*)"");
+    char *server;
+
+    if (interface) {
+        server_api_info = ogs_msprintf(" (info.title=%s; info.version=%s)", interface->api_title, interface->api_version);
+    }
+    server = ogs_msprintf("%s/%s%s %s/%s",app->server_name, FIVEG_API_RELEASE, server_api_info, app->app_name, app->app_version);
+    if (interface) {
+        ogs_free(server_api_info);
+    }
+
+    return server;
+}
+
 /* vim:ts=8:sts=4:sw=4:expandtab:
 */
@@ -28,15 +28,33 @@ typedef struct nf_server_app_metadata_s {
     const char *server_name;
 } nf_server_app_metadata_t;
 
+/* Header values that are the same for every response of a resource, rendered once */
+typedef struct nf_server_prerendered_headers_s {
+    char *cache_control;
+    char *server;
+} nf_server_prerendered_headers_t;
+
 extern bool nf_server_send_error(ogs_sbi_stream_t *stream,
         int status, int number_of_components, ogs_sbi_message_t *message,
         const char *title, const char *detail, cJSON * problem_detail, const nf_server_interface_metadata_t *interface,
         const nf_server_app_metadata_t *app);
+/* As nf_server_send_error() with a Retry-After header giving the number of seconds the client should wait */
+extern bool nf_server_send_error_retry_after(ogs_sbi_stream_t *stream,
+        int status, int retry_after, int number_of_components, ogs_sbi_message_t *message,
+        const char *title, const char *detail, cJSON * problem_detail, const nf_server_interface_metadata_t *interface,
+        const nf_server_app_metadata_t *app);
 
 extern ogs_sbi_response_t *nf_server_new_response(char *location, char *content_type, time_t last_modified, char *etag,
         int cache_control, char *allow_methods, const nf_server_interface_metadata_t *interface,
         const nf_server_app_metadata_t *app);
+extern nf_server_prerendered_headers_t *nf_server_prerendered_headers_new(int cache_control,
+        const nf_server_interface_metadata_t *interface, const nf_server_app_metadata_t *app);
+extern void nf_server_prerendered_headers_free(nf_server_prerendered_headers_t *headers);
+extern ogs_sbi_response_t *nf_server_new_prerendered_response(const nf_server_prerendered_headers_t *headers,
+        const char *content_type, const char *last_modified, const char *etag);
 extern ogs_sbi_response_t *nf_server_populate_response(ogs_sbi_response_t *response, int content_length, char *content, int status);
+/* Mark a response as negotiated on Accept-Encoding, content_encoding is NULL for the identity encoding */
+extern void nf_server_set_content_encoding(ogs_sbi_response_t *response, const char *content_encoding);
 
 #ifdef __cplusplus
 }
@@ -16,12 +16,14 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #include "ogs-core.h"
 
 #include "context.h"
+#include "model-arena.h"
 #include "provisioning-session.h"
 #include "sai-cache.h"
 #include "utilities.h"
 
 #include "openapi/model/msaf_api_consumption_reporting_configuration.h"
 #include "openapi/model/msaf_api_content_hosting_configuration.h"
+#include "openapi/model/msaf_api_metrics_reporting_configuration.h"
 #include "openapi/model/msaf_api_m5_media_entry_point.h"
 #include "openapi/model/msaf_api_provisioning_session.h"
 #include "openapi/model/msaf_api_service_access_information_resource.h"
@@ -29,6 +31,13 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #include "service-access-information.h"
 
 static OpenAPI_list_t *_policy_templates_hash_to_list_of_ready_bindings(ogs_hash_t *policy_templates);
+static void _set_sai_template(msaf_provisioning_session_t *provisioning_session);
+static OpenAPI_list_t *_metrics_reporting_configurations_to_list(ogs_hash_t *metrics_reporting_configurations, bool is_tls,
+                                                                 const char *svr_hostname);
+static OpenAPI_list_t *_string_list_copy(OpenAPI_list_t *list);
+static msaf_api_service_access_information_resource_t *_service_access_information_in_arena(
+                                    msaf_provisioning_session_t *provisioning_session, bool is_tls, const char *svr_hostname,
+                                    msaf_model_arena_t **arena_out);
 
 msaf_api_service_access_information_resource_t *
 msaf_context_service_access_information_create(msaf_provisioning_session_t *provisioning_session, bool is_tls, const char *svr_hostname)
@@ -39,6 +48,7 @@ msaf_context_service_access_information_create(msaf_provisioning_session_t *prov
     msaf_api_service_access_information_resource_dynamic_policy_invocation_configuration_t *dpic = NULL;
     msaf_api_service_access_information_resource_client_consumption_reporting_configuration_t *ccrc = NULL;
     msaf_api_service_access_information_resource_network_assistance_configuration_t *nac = NULL;
+    OpenAPI_list_t *cmrc = NULL;
     OpenAPI_list_t *entry_points = NULL;
 
     /* streaming entry points */
@@ -54,17 +64,17 @@ msaf_context_service_access_information_create(msaf_provisioning_session_t *prov
 
                 if (dist_conf->entry_point->profiles) {
                     OpenAPI_lnode_t *prof_node;
-                    m5_profiles = OpenAPI_list_create();
+                    m5_profiles = msaf_model_list_create();
                     OpenAPI_list_for_each(dist_conf->entry_point->profiles, prof_node) {
-                        OpenAPI_list_add(m5_profiles, ogs_strdup(prof_node->data));
+                        msaf_model_list_add(m5_profiles, msaf_model_strdup(prof_node->data));
                     }
                 }
 
-                url = ogs_msprintf("%s%s", dist_conf->base_url, dist_conf->entry_point->relative_path);
-                m5_entry = msaf_api_m5_media_entry_point_create(url, ogs_strdup(dist_conf->entry_point->content_type), m5_profiles);
+                url = msaf_model_msprintf("%s%s", dist_conf->base_url, dist_conf->entry_point->relative_path);
+                m5_entry = msaf_api_m5_media_entry_point_create(url, msaf_model_strdup(dist_conf->entry_point->content_type), m5_profiles);
                 ogs_assert(m5_entry);
-                if (!entry_points) entry_points = OpenAPI_list_create();
-                OpenAPI_list_add(entry_points, m5_entry);
+                if (!entry_points) entry_points = msaf_model_list_create();
+                msaf_model_list_add(entry_points, m5_entry);
             }
         }
     }
@@ -84,18 +94,18 @@ msaf_context_service_access_information_create(msaf_provisioning_session_t *prov
                 ogs_debug("Adding dynamicPolicyInvocationConfiguration to ServiceAccessInformation [%s]",
                            provisioning_session->provisioningSessionId);
 
-                policy_templates_svr_list = OpenAPI_list_create();
+                policy_templates_svr_list = msaf_model_list_create();
                 ogs_assert(policy_templates_svr_list);
-                OpenAPI_list_add(policy_templates_svr_list, ogs_msprintf("http%s://%s/3gpp-m5/v2/", is_tls?"s":"", svr_hostname));
+                msaf_model_list_add(policy_templates_svr_list, msaf_model_msprintf("http%s://%s/3gpp-m5/v2/", is_tls?"s":"", svr_hostname));
 
-                sdf_methods = OpenAPI_list_create();
+                sdf_methods = msaf_model_list_create();
                 ogs_assert(sdf_methods);
-                OpenAPI_list_add(sdf_methods, (void *)sdf_method);
+                msaf_model_list_add(sdf_methods, (void *)sdf_method);
         
                 dpic = msaf_api_service_access_information_resource_dynamic_policy_invocation_configuration_create(
                             policy_templates_svr_list, policy_template_bindings, sdf_methods);
             } else {
-                OpenAPI_list_free(policy_template_bindings);
+                msaf_model_list_free(policy_template_bindings);
             }
         }
     }
@@ -108,9 +118,9 @@ msaf_context_service_access_information_create(msaf_provisioning_session_t *prov
         ogs_debug("Adding clientConsumptionReportingConfiguration to ServiceAccessInformation [%s]",
                   provisioning_session->provisioningSessionId);
 
-        ccrc_svr_list = OpenAPI_list_create();
+        ccrc_svr_list = msaf_model_list_create();
         ogs_assert(ccrc_svr_list);
-        OpenAPI_list_add(ccrc_svr_list, ogs_msprintf("http%s://%s/3gpp-m5/v2/", is_tls?"s":"", svr_hostname));
+        msaf_model_list_add(ccrc_svr_list, msaf_model_msprintf("http%s://%s/3gpp-m5/v2/", is_tls?"s":"", svr_hostname));
         ccrc = msaf_api_service_access_information_resource_client_consumption_reporting_configuration_create(
                     provisioning_session->consumptionReportingConfiguration->reporting_interval?true:false,
                     *provisioning_session->consumptionReportingConfiguration->reporting_interval,
@@ -128,25 +138,34 @@ msaf_context_service_access_information_create(msaf_provisioning_session_t *prov
         ogs_assert(ccrc);
     }
 
+    /* client metrics reporting configurations */
+    if (provisioning_session->metrics_reporting_configurations &&
+        ogs_hash_first(provisioning_session->metrics_reporting_configurations)) {
+        ogs_debug("Adding clientMetricsReportingConfigurations to ServiceAccessInformation [%s]",
+                  provisioning_session->provisioningSessionId);
+        cmrc = _metrics_reporting_configurations_to_list(provisioning_session->metrics_reporting_configurations, is_tls,
+                                                         svr_hostname);
+    }
+
     /* Network Assistance Configuration */
     if (config->offerNetworkAssistance) {
         OpenAPI_list_t *na_svr_list;
 
-        na_svr_list = OpenAPI_list_create();
+        na_svr_list = msaf_model_list_create();
         ogs_assert(na_svr_list);
-        OpenAPI_list_add(na_svr_list, ogs_msprintf("http%s://%s/3gpp-m5/v2/", is_tls?"s":"", svr_hostname));
+        msaf_model_list_add(na_svr_list, msaf_model_msprintf("http%s://%s/3gpp-m5/v2/", is_tls?"s":"", svr_hostname));
         nac = msaf_api_service_access_information_resource_network_assistance_configuration_create(na_svr_list);
         ogs_assert(nac);
     }
 
     /* Create SAI */
     service_access_information = msaf_api_service_access_information_resource_create(
-                msaf_strdup(provisioning_session->provisioningSessionId),
+                msaf_model_strdup(provisioning_session->provisioningSessionId),
                 msaf_api_provisioning_session_type_DOWNLINK,
                 streaming_access,
                 ccrc /* client_consumption_reporting_configuration */,
                 dpic /* dynamic_policy */,
-                NULL /* client_metrics_reporting */,
+                cmrc /* client_metrics_reporting_configurations */,
                 nac  /* network_assistance_configuration */,
                 NULL /* client_edge_resources */);
 
@@ -155,10 +174,13 @@ msaf_context_service_access_information_create(msaf_provisioning_session_t *prov
     return service_access_information;
 }
 
-const msaf_sai_cache_entry_t *msaf_context_retrieve_service_access_information(const char *provisioning_session_id, bool is_tls, const char *authority)
+const msaf_sai_cache_entry_t *msaf_context_retrieve_service_access_information(const char *provisioning_session_id, bool is_tls, const char *authority, msaf_sai_retrieve_result_t *result)
 {
     msaf_provisioning_session_t *provisioning_session_context;
     const msaf_sai_cache_entry_t *sai_entry = NULL;
+    char canonical_authority[MSAF_SAI_CACHE_MAX_AUTHORITY_LEN+1];
+
+    if (result) *result = MSAF_SAI_RETRIEVE_NOT_FOUND;
 
     provisioning_session_context = msaf_provisioning_session_find_by_provisioningSessionId(provisioning_session_id);
     if (provisioning_session_context == NULL){
@@ -166,6 +188,13 @@ const msaf_sai_cache_entry_t *msaf_context_retrieve_service_access_information(c
         return NULL;
     }
 
+    authority = msaf_sai_cache_canonical_authority(canonical_authority, is_tls, authority);
+    if (!authority) {
+        ogs_error("Invalid authority in request for Service Access Information for Provisioning Session [%s]", provisioning_session_id);
+        if (result) *result = MSAF_SAI_RETRIEVE_BAD_AUTHORITY;
+        return NULL;
+    }
+
     if (!provisioning_session_context->sai_cache) {
         provisioning_session_context->sai_cache = msaf_sai_cache_new();
     } else {
@@ -173,25 +202,174 @@ const msaf_sai_cache_entry_t *msaf_context_retrieve_service_access_information(c
     }
 
     if (!sai_entry) {
-        msaf_api_service_access_information_resource_t *sai;
-
         ogs_debug("Create new SAI for http%s://%s on provisioning session [%s]", is_tls?"s":"", authority, provisioning_session_id);
 
-        sai = msaf_context_service_access_information_create(provisioning_session_context, is_tls, authority);
-        msaf_sai_cache_add(provisioning_session_context->sai_cache, is_tls, authority, sai);
-        msaf_api_service_access_information_resource_free(sai);
-        sai_entry = msaf_sai_cache_find(provisioning_session_context->sai_cache, is_tls, authority);
+        /* Only the server URLs vary with the authority, so render the SAI once per configuration and splice in the authority */
+        if (!msaf_sai_cache_has_template(provisioning_session_context->sai_cache)) {
+            _set_sai_template(provisioning_session_context);
+        }
+
+        sai_entry = msaf_sai_cache_add_from_template(provisioning_session_context->sai_cache, is_tls, authority);
+        if (!sai_entry) {
+            msaf_api_service_access_information_resource_t *sai;
+            msaf_model_arena_t *arena;
+
+            sai = _service_access_information_in_arena(provisioning_session_context, is_tls, authority, &arena);
+            sai_entry = msaf_sai_cache_add(provisioning_session_context->sai_cache, is_tls, authority, sai);
+            msaf_model_arena_free(arena);
+        }
     } else {
         ogs_debug("Found existing SAI cache entry");
     }
 
     if (sai_entry == NULL){
        ogs_error("The provisioning Session [%s] does not have an associated Service Access Information", provisioning_session_id);
+    } else if (result) {
+       *result = MSAF_SAI_RETRIEVE_OK;
     }
 
     return sai_entry;
 }
 
+void msaf_context_service_access_information_invalidate(msaf_provisioning_session_t *provisioning_session)
+{
+    msaf_event_t *event;
+    int rv;
+
+    ogs_assert(provisioning_session);
+
+    if (!provisioning_session->sai_cache) return;
+
+    msaf_sai_cache_invalidate(provisioning_session->sai_cache);
+
+    /* Nothing was being served, so the next request can build the SAI */
+    if (!msaf_sai_cache_count(provisioning_session->sai_cache)) return;
+
+    /* Several M1 changes in a row only need one regeneration */
+    if (provisioning_session->sai_regeneration_scheduled) return;
+
+    event = (msaf_event_t*)ogs_event_new(MSAF_EVENT_SBI_LOCAL);
+    event->local_id = MSAF_LOCAL_EVENT_SAI_REGENERATE;
+    event->data = msaf_strdup(provisioning_session->provisioningSessionId);
+
+    rv = ogs_queue_push(ogs_app()->queue, event);
+    if (rv != OGS_OK) {
+        ogs_error("OGS Queue Push failed %d", rv);
+        ogs_free(event->data);
+        ogs_event_free(event);
+        /* no regeneration, so stop serving the old SAI */
+        msaf_sai_cache_clear(provisioning_session->sai_cache);
+        return;
+    }
+
+    provisioning_session->sai_regeneration_scheduled = true;
+}
+
+void msaf_context_service_access_information_regenerate(const char *provisioning_session_id)
+{
+    msaf_provisioning_session_t *provisioning_session;
+    unsigned int count;
+
+    provisioning_session = msaf_provisioning_session_find_by_provisioningSessionId(provisioning_session_id);
+    if (!provisioning_session) {
+        ogs_debug("Provisioning Session [%s] removed before its Service Access Information was regenerated", provisioning_session_id);
+        return;
+    }
+
+    provisioning_session->sai_regeneration_scheduled = false;
+
+    if (!provisioning_session->sai_cache) return;
+
+    if (!msaf_sai_cache_has_template(provisioning_session->sai_cache)) {
+        _set_sai_template(provisioning_session);
+    }
+
+    count = msaf_sai_cache_refresh(provisioning_session->sai_cache);
+
+    ogs_debug("Regenerated %u Service Access Information entries for Provisioning Session [%s]", count, provisioning_session_id);
+}
+
+static void _set_sai_template(msaf_provisioning_session_t *provisioning_session)
+{
+    msaf_api_service_access_information_resource_t *sai;
+    msaf_model_arena_t *arena;
+
+    sai = _service_access_information_in_arena(provisioning_session, false, MSAF_SAI_CACHE_TEMPLATE_AUTHORITY, &arena);
+    msaf_sai_cache_set_template(provisioning_session->sai_cache, sai);
+    msaf_model_arena_free(arena);
+}
+
+/* The SAI is only kept until it has been rendered, so build it in an arena which the caller frees once it is done with it */
+static msaf_api_service_access_information_resource_t *_service_access_information_in_arena(
+                                    msaf_provisioning_session_t *provisioning_session, bool is_tls, const char *svr_hostname,
+                                    msaf_model_arena_t **arena_out)
+{
+    msaf_api_service_access_information_resource_t *sai;
+    msaf_model_arena_t *arena;
+
+    arena = msaf_model_arena_new(0);
+    msaf_model_arena_enter(arena);
+    sai = msaf_context_service_access_information_create(provisioning_session, is_tls, svr_hostname);
+    msaf_model_arena_leave(arena);
+
+    *arena_out = arena;
+    return sai;
+}
+
+static OpenAPI_list_t *_metrics_reporting_configurations_to_list(ogs_hash_t *metrics_reporting_configurations, bool is_tls,
+                                                                 const char *svr_hostname)
+{
+    OpenAPI_list_t *list;
+    ogs_hash_index_t *hi;
+
+    list = msaf_model_list_create();
+    ogs_assert(list);
+
+    for (hi = ogs_hash_first(metrics_reporting_configurations); hi; hi = ogs_hash_next(hi)) {
+        const msaf_metrics_reporting_configuration_node_t *node = ogs_hash_this_val(hi);
+        const msaf_api_metrics_reporting_configuration_t *config = node->config;
+        msaf_api_service_access_information_resource_client_metrics_reporting_configurations_inner_t *cmrc;
+        OpenAPI_list_t *svr_list;
+
+        svr_list = msaf_model_list_create();
+        ogs_assert(svr_list);
+        msaf_model_list_add(svr_list, msaf_model_msprintf("http%s://%s/3gpp-m5/v2/", is_tls?"s":"", svr_hostname));
+
+        cmrc = msaf_api_service_access_information_resource_client_metrics_reporting_configurations_inner_create(
+                    msaf_model_strdup(config->metrics_reporting_configuration_id),
+                    svr_list,
+                    msaf_model_strdup(config->scheme),
+                    config->data_network_name?msaf_model_strdup(config->data_network_name):NULL,
+                    config->is_reporting_interval,
+                    config->reporting_interval,
+                    config->is_sample_percentage,
+                    config->sample_percentage,
+                    _string_list_copy(config->url_filters),
+                    config->sampling_period,
+                    _string_list_copy(config->metrics));
+        ogs_assert(cmrc);
+        msaf_model_list_add(list, cmrc);
+    }
+
+    return list;
+}
+
+static OpenAPI_list_t *_string_list_copy(OpenAPI_list_t *list)
+{
+    OpenAPI_list_t *copy;
+    OpenAPI_lnode_t *node;
+
+    if (!list) return NULL;
+
+    copy = msaf_model_list_create();
+    ogs_assert(copy);
+    OpenAPI_list_for_each(list, node) {
+        msaf_model_list_add(copy, msaf_model_strdup(node->data));
+    }
+
+    return copy;
+}
+
 static OpenAPI_list_t *_policy_templates_hash_to_list_of_ready_bindings(ogs_hash_t *policy_templates)
 {
     msaf_policy_template_node_t *policy_template_node;
@@ -199,14 +377,14 @@ static OpenAPI_list_t *_policy_templates_hash_to_list_of_ready_bindings(ogs_hash
     ogs_hash_index_t *hi;
     msaf_api_service_access_information_resource_dynamic_policy_invocation_configuration_policy_template_bindings_inner_t *policy_template_binding;
 
-    policy_template_bindings = OpenAPI_list_create();
+    policy_template_bindings = msaf_model_list_create();
 
     for (hi = ogs_hash_first(policy_templates);
             hi; hi = ogs_hash_next(hi)) {
         policy_template_node = (msaf_policy_template_node_t *)ogs_hash_this_val(hi);
         if (policy_template_node->policy_template->state == msaf_api_policy_template_STATE_READY) {
-            policy_template_binding = msaf_api_service_access_information_resource_dynamic_policy_invocation_configuration_policy_template_bindings_inner_create(msaf_strdup(policy_template_node->policy_template->external_reference), msaf_strdup(policy_template_node->policy_template->policy_template_id));
-            OpenAPI_list_add(policy_template_bindings, policy_template_binding);
+            policy_template_binding = msaf_api_service_access_information_resource_dynamic_policy_invocation_configuration_policy_template_bindings_inner_create(msaf_model_strdup(policy_template_node->policy_template->external_reference), msaf_model_strdup(policy_template_node->policy_template->policy_template_id));
+            msaf_model_list_add(policy_template_bindings, policy_template_binding);
         }
     }
     return policy_template_bindings;
@@ -22,7 +22,17 @@ typedef struct msaf_sai_cache_entry_s msaf_sai_cache_entry_t;
 typedef struct msaf_api_service_access_information_resource_s msaf_api_service_access_information_resource_t;
 
 msaf_api_service_access_information_resource_t *msaf_context_service_access_information_create(msaf_provisioning_session_t *provisioning_session, bool is_tls, const char *svr_hostname);
-const msaf_sai_cache_entry_t *msaf_context_retrieve_service_access_information(const char *provisioning_session_id, bool is_tls, const char *authority);
+typedef enum msaf_sai_retrieve_result_e {
+    MSAF_SAI_RETRIEVE_OK = 0,
+    MSAF_SAI_RETRIEVE_NOT_FOUND,        /* no such provisioning session, or it has no Service Access Information */
+    MSAF_SAI_RETRIEVE_BAD_AUTHORITY     /* the authority (Host header) is not a valid host[:port] */
+} msaf_sai_retrieve_result_t;
+
+/* Find or create the Service Access Information for the provisioning session as seen through authority. Returns NULL
+ * on failure with the reason in result, if result is not NULL. */
+const msaf_sai_cache_entry_t *msaf_context_retrieve_service_access_information(const char *provisioning_session_id, bool is_tls, const char *authority, msaf_sai_retrieve_result_t *result /* [out, null] */);
+void msaf_context_service_access_information_invalidate(msaf_provisioning_session_t *provisioning_session);
+void msaf_context_service_access_information_regenerate(const char *provisioning_session_id);
 
 #ifdef __cplusplus
 }
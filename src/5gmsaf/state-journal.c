@@ -0,0 +1,776 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+#include "ogs-core.h"
+
+#include "data-collection-log.h"
+
+#include "state-journal.h"
+
+/*****************************************************
+ ***** Local declarations
+ *****************************************************/
+
+struct msaf_state_journal_s {
+    char *directory;
+    char *journal_path;
+    char *journal_tmp_path;
+    char *snapshot_path;
+    char *snapshot_tmp_path;
+    size_t snapshot_after;
+    bool fsync;
+    int fd;                           /* journal open for appending, -1 until loaded */
+    off_t journal_size;               /* bytes of complete records in the journal */
+    uint64_t seq;
+    size_t length;
+    msaf_state_journal_snapshot_job_t *snapshot; /* begun and not yet ended, NULL if none */
+};
+
+/* The paths are copied so that the snapshot can be written without touching the journal */
+struct msaf_state_journal_snapshot_job_s {
+    char *directory;
+    char *path;
+    char *tmp_path;
+    off_t journal_size;               /* bytes, and records, of the journal included in the snapshot */
+    size_t length;
+    char *buffer;                     /* the whole snapshot, header and records */
+    size_t buffer_len;
+    size_t buffer_size;
+};
+
+typedef struct msaf_state_journal_record_s {
+    uint64_t seq;
+    char type[MSAF_STATE_JOURNAL_TYPE_MAX + 1];
+    const char *payload;
+    size_t payload_len;
+} msaf_state_journal_record_t;
+
+typedef struct msaf_state_journal_mapping_s {
+    char *data;
+    size_t size;
+} msaf_state_journal_mapping_t;
+
+/* longest record header line: magic, seq, type, length and crc */
+#define RECORD_HEADER_MAX (sizeof(MSAF_STATE_JOURNAL_RECORD_MAGIC) + 21 + MSAF_STATE_JOURNAL_TYPE_MAX + 1 + 21 + 9 + 1)
+/* longest snapshot header line: magic and seq */
+#define SNAPSHOT_HEADER_MAX (sizeof(MSAF_STATE_JOURNAL_SNAPSHOT_MAGIC) + 21 + 1)
+
+/* Initial size of the snapshot buffer, it is doubled as needed */
+#define SNAPSHOT_BUFFER_INITIAL (256*1024)
+
+/* Size of the blocks the journal is copied in when the records included in a snapshot are dropped */
+#define JOURNAL_COPY_BLOCK (64*1024)
+
+static int _map_file(const char *path, msaf_state_journal_mapping_t *mapping);
+static void _unmap_file(msaf_state_journal_mapping_t *mapping);
+static size_t _snapshot_header_parse(const msaf_state_journal_mapping_t *mapping, uint64_t *seq);
+static bool _record_parse(msaf_state_journal_mapping_t *mapping, size_t *offset, msaf_state_journal_record_t *record,
+                          bool terminate);
+static int _record_header(char *header, uint64_t seq, const char *type, const char *payload, size_t payload_len);
+static bool _replay(const msaf_state_journal_record_t *record, msaf_state_journal_record_fn record_fn, void *data);
+static void _snapshot_job_free(msaf_state_journal_snapshot_job_t *job);
+static void _journal_drop(msaf_state_journal_t *journal, off_t size, size_t length);
+static bool _journal_copy(msaf_state_journal_t *journal, off_t from, int fd);
+static void _sync_directory(const char *path);
+static bool _write_all(int fd, struct iovec *iov, int iovcnt);
+
+/*****************************************************
+ ***** Public functions
+ *****************************************************/
+
+void msaf_state_journal_config_init(msaf_state_journal_config_t *config)
+{
+    ogs_assert(config);
+
+    memset(config, 0, sizeof(*config));
+    config->snapshot_after = MSAF_STATE_JOURNAL_DEFAULT_SNAPSHOT_AFTER;
+    config->fsync = true;
+}
+
+void msaf_state_journal_config_clear(msaf_state_journal_config_t *config)
+{
+    ogs_assert(config);
+
+    if (config->directory) ogs_free(config->directory);
+    msaf_state_journal_config_init(config);
+}
+
+msaf_state_journal_t *msaf_state_journal_open(const msaf_state_journal_config_t *config)
+{
+    msaf_state_journal_t *journal;
+
+    ogs_assert(config);
+    ogs_assert(config->directory);
+
+    journal = ogs_calloc(1, sizeof(*journal));
+    ogs_assert(journal);
+
+    journal->directory = ogs_strdup(config->directory);
+    journal->journal_path = ogs_msprintf("%s/journal", config->directory);
+    journal->journal_tmp_path = ogs_msprintf("%s/journal.tmp", config->directory);
+    journal->snapshot_path = ogs_msprintf("%s/snapshot", config->directory);
+    journal->snapshot_tmp_path = ogs_msprintf("%s/snapshot.tmp", config->directory);
+    journal->snapshot_after = config->snapshot_after;
+    journal->fsync = config->fsync;
+    journal->fd = -1;
+
+    return journal;
+}
+
+void msaf_state_journal_close(msaf_state_journal_t *journal)
+{
+    if (!journal) return;
+
+    /* a snapshot job may still be in use by whoever is writing it */
+    ogs_assert(!journal->snapshot);
+
+    if (journal->fd >= 0 && close(journal->fd) < 0) {
+        ogs_error("Failed to close %s: %s", journal->journal_path, strerror(errno));
+    }
+
+    ogs_free(journal->directory);
+    ogs_free(journal->journal_path);
+    ogs_free(journal->journal_tmp_path);
+    ogs_free(journal->snapshot_path);
+    ogs_free(journal->snapshot_tmp_path);
+    ogs_free(journal);
+}
+
+bool msaf_state_journal_load(msaf_state_journal_t *journal, msaf_state_journal_record_fn record_fn, void *data)
+{
+    msaf_state_journal_mapping_t snapshot = {NULL, 0}, log = {NULL, 0};
+    msaf_state_journal_record_t record;
+    uint64_t snapshot_seq = 0;
+    size_t offset, good_end, log_size;
+    unsigned int failed = 0;
+    int rv;
+
+    ogs_assert(journal);
+    ogs_assert(record_fn);
+    ogs_assert(journal->fd < 0);
+
+    if (!msaf_data_collection_ensure_directory(journal->directory)) {
+        ogs_error("Unable to create state directory %s", journal->directory);
+        return false;
+    }
+
+    /* both files are mapped before anything is replayed, so that nothing is applied if either cannot be read */
+    rv = _map_file(journal->snapshot_path, &snapshot);
+    if (rv == OGS_ERROR) return false;
+    if (rv == OGS_OK) {
+        offset = _snapshot_header_parse(&snapshot, &snapshot_seq);
+        if (!offset) {
+            ogs_error("State snapshot %s has a bad header", journal->snapshot_path);
+            _unmap_file(&snapshot);
+            return false;
+        }
+    }
+
+    if (_map_file(journal->journal_path, &log) == OGS_ERROR) {
+        _unmap_file(&snapshot);
+        return false;
+    }
+
+    /* a snapshot was being written when the AF stopped, the previous snapshot and the journal are still complete */
+    if (unlink(journal->snapshot_tmp_path) < 0 && errno != ENOENT) {
+        ogs_warn("Unable to remove %s: %s", journal->snapshot_tmp_path, strerror(errno));
+    }
+    /* the journal was being rewritten without the records of the last snapshot, the journal itself is still complete */
+    if (unlink(journal->journal_tmp_path) < 0 && errno != ENOENT) {
+        ogs_warn("Unable to remove %s: %s", journal->journal_tmp_path, strerror(errno));
+    }
+
+    /* the snapshot was synced before it was renamed into place, so any damage is not from an interrupted write. It is
+     * checked before any of it is replayed so that a bad snapshot applies nothing. */
+    if (snapshot.data) {
+        size_t first = offset;
+
+        while (offset < snapshot.size) {
+            if (!_record_parse(&snapshot, &offset, &record, false)) {
+                ogs_error("State snapshot %s is corrupt at offset %zu", journal->snapshot_path, offset);
+                _unmap_file(&snapshot);
+                _unmap_file(&log);
+                return false;
+            }
+        }
+
+        offset = first;
+        while (offset < snapshot.size && _record_parse(&snapshot, &offset, &record, true)) {
+            if (!_replay(&record, record_fn, data)) failed++;
+        }
+    }
+    _unmap_file(&snapshot);
+
+    journal->seq = snapshot_seq;
+    journal->length = 0;
+
+    offset = good_end = 0;
+    while (offset < log.size && _record_parse(&log, &offset, &record, true)) {
+        if (record.seq > snapshot_seq) {
+            if (record.seq <= journal->seq) {
+                ogs_error("State journal %s has record %llu out of order", journal->journal_path,
+                          (unsigned long long)record.seq);
+                break;
+            }
+            if (!_replay(&record, record_fn, data)) failed++;
+            journal->seq = record.seq;
+            journal->length++;
+        }
+        good_end = offset;
+    }
+    log_size = log.size;
+    _unmap_file(&log);
+
+    if (good_end < log_size) {
+        ogs_warn("Discarding %zu bytes of incomplete records at the end of %s", log_size - good_end, journal->journal_path);
+        if (truncate(journal->journal_path, good_end) < 0) {
+            ogs_error("Unable to truncate %s: %s", journal->journal_path, strerror(errno));
+            return false;
+        }
+    }
+
+    if (failed) {
+        ogs_warn("%u state records could not be applied", failed);
+    }
+
+    journal->fd = open(journal->journal_path, O_CREAT|O_WRONLY|O_APPEND|O_CLOEXEC, 0664);
+    if (journal->fd < 0) {
+        ogs_error("Unable to open %s for writing: %s", journal->journal_path, strerror(errno));
+        return false;
+    }
+    journal->journal_size = good_end;
+
+    return true;
+}
+
+bool msaf_state_journal_append(msaf_state_journal_t *journal, const char *type, const char *payload, size_t payload_len)
+{
+    char header[RECORD_HEADER_MAX];
+    struct iovec iov[3];
+    int header_len;
+
+    ogs_assert(journal);
+    ogs_assert(type);
+    ogs_assert(payload);
+
+    if (journal->fd < 0) {
+        ogs_error("State journal %s has not been loaded", journal->journal_path);
+        return false;
+    }
+
+    header_len = _record_header(header, journal->seq + 1, type, payload, payload_len);
+
+    iov[0].iov_base = header;
+    iov[0].iov_len = header_len;
+    iov[1].iov_base = (void*)payload;
+    iov[1].iov_len = payload_len;
+    iov[2].iov_base = "\n";
+    iov[2].iov_len = 1;
+
+    if (!_write_all(journal->fd, iov, 3)) {
+        ogs_error("Failed to append %s record to %s: %s", type, journal->journal_path, strerror(errno));
+        /* remove any partial record so that later records are not lost behind it */
+        if (ftruncate(journal->fd, journal->journal_size) < 0) {
+            ogs_error("Unable to truncate %s: %s", journal->journal_path, strerror(errno));
+        }
+        return false;
+    }
+
+    journal->seq++;
+    journal->length++;
+    journal->journal_size += header_len + payload_len + 1;
+
+    if (journal->fsync && fdatasync(journal->fd) < 0) {
+        ogs_error("Failed to sync %s: %s", journal->journal_path, strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+bool msaf_state_journal_snapshot_due(const msaf_state_journal_t *journal)
+{
+    ogs_assert(journal);
+
+    return !journal->snapshot && journal->snapshot_after && journal->length >= journal->snapshot_after;
+}
+
+bool msaf_state_journal_snapshot(msaf_state_journal_t *journal, msaf_state_journal_snapshot_fn snapshot_fn, void *data)
+{
+    msaf_state_journal_snapshot_job_t *job;
+    bool written;
+
+    job = msaf_state_journal_snapshot_begin(journal, snapshot_fn, data);
+    if (!job) return false;
+
+    written = msaf_state_journal_snapshot_write(job);
+    msaf_state_journal_snapshot_end(journal, job, written);
+
+    return written;
+}
+
+msaf_state_journal_snapshot_job_t *msaf_state_journal_snapshot_begin(msaf_state_journal_t *journal,
+                                                                     msaf_state_journal_snapshot_fn snapshot_fn, void *data)
+{
+    msaf_state_journal_snapshot_job_t *job;
+    int header_len;
+
+    ogs_assert(journal);
+    ogs_assert(snapshot_fn);
+
+    if (journal->fd < 0) {
+        ogs_error("State journal %s has not been loaded", journal->journal_path);
+        return NULL;
+    }
+
+    if (journal->snapshot) {
+        ogs_error("A snapshot of %s is already being taken", journal->journal_path);
+        return NULL;
+    }
+
+    job = ogs_calloc(1, sizeof(*job));
+    ogs_assert(job);
+
+    job->directory = ogs_strdup(journal->directory);
+    job->path = ogs_strdup(journal->snapshot_path);
+    job->tmp_path = ogs_strdup(journal->snapshot_tmp_path);
+    job->journal_size = journal->journal_size;
+    job->length = journal->length;
+
+    job->buffer = ogs_malloc(SNAPSHOT_BUFFER_INITIAL);
+    ogs_assert(job->buffer);
+    job->buffer_size = SNAPSHOT_BUFFER_INITIAL;
+
+    header_len = snprintf(job->buffer, SNAPSHOT_HEADER_MAX, "%s %llu\n", MSAF_STATE_JOURNAL_SNAPSHOT_MAGIC,
+                          (unsigned long long)journal->seq);
+    ogs_assert(header_len > 0 && header_len < SNAPSHOT_HEADER_MAX);
+    job->buffer_len = header_len;
+
+    journal->snapshot = job;
+
+    if (!snapshot_fn(journal, data)) {
+        journal->snapshot = NULL;
+        _snapshot_job_free(job);
+        return NULL;
+    }
+
+    return job;
+}
+
+bool msaf_state_journal_snapshot_write(msaf_state_journal_snapshot_job_t *job)
+{
+    struct iovec iov;
+    int fd;
+
+    ogs_assert(job);
+
+    fd = open(job->tmp_path, O_CREAT|O_WRONLY|O_TRUNC|O_CLOEXEC, 0664);
+    if (fd < 0) {
+        ogs_error("Unable to create %s: %s", job->tmp_path, strerror(errno));
+        return false;
+    }
+
+    iov.iov_base = job->buffer;
+    iov.iov_len = job->buffer_len;
+    if (!_write_all(fd, &iov, 1)) {
+        ogs_error("Failed to write %s: %s", job->tmp_path, strerror(errno));
+        goto failed;
+    }
+
+    /* the snapshot must be on disk before it replaces the old one and the journal is emptied */
+    if (fsync(fd) < 0) {
+        ogs_error("Failed to sync %s: %s", job->tmp_path, strerror(errno));
+        goto failed;
+    }
+
+    if (close(fd) < 0) {
+        fd = -1;
+        ogs_error("Failed to close %s: %s", job->tmp_path, strerror(errno));
+        goto failed;
+    }
+    fd = -1;
+
+    if (rename(job->tmp_path, job->path) < 0) {
+        ogs_error("Unable to rename %s to %s: %s", job->tmp_path, job->path, strerror(errno));
+        goto failed;
+    }
+    _sync_directory(job->directory);
+
+    return true;
+
+failed:
+    if (fd >= 0) close(fd);
+    if (unlink(job->tmp_path) < 0 && errno != ENOENT) {
+        ogs_warn("Unable to remove %s: %s", job->tmp_path, strerror(errno));
+    }
+
+    return false;
+}
+
+void msaf_state_journal_snapshot_end(msaf_state_journal_t *journal, msaf_state_journal_snapshot_job_t *job, bool written)
+{
+    ogs_assert(journal);
+    ogs_assert(job);
+    ogs_assert(journal->snapshot == job);
+
+    journal->snapshot = NULL;
+
+    /* until the snapshot is in place the journal is still needed to restore the changes it includes */
+    if (written) _journal_drop(journal, job->journal_size, job->length);
+
+    _snapshot_job_free(job);
+}
+
+bool msaf_state_journal_snapshot_add(msaf_state_journal_t *journal, const char *type, const char *payload, size_t payload_len)
+{
+    msaf_state_journal_snapshot_job_t *job;
+    char header[RECORD_HEADER_MAX];
+    size_t needed;
+    int header_len;
+
+    ogs_assert(journal);
+    ogs_assert(journal->snapshot);
+    ogs_assert(type);
+    ogs_assert(payload);
+
+    job = journal->snapshot;
+
+    /* snapshot records carry the snapshot's seq */
+    header_len = _record_header(header, journal->seq, type, payload, payload_len);
+
+    needed = job->buffer_len + header_len + payload_len + 1;
+    if (needed > job->buffer_size) {
+        size_t size = job->buffer_size;
+        while (size < needed) size *= 2;
+        job->buffer = ogs_realloc(job->buffer, size);
+        ogs_assert(job->buffer);
+        job->buffer_size = size;
+    }
+
+    memcpy(job->buffer + job->buffer_len, header, header_len);
+    job->buffer_len += header_len;
+    memcpy(job->buffer + job->buffer_len, payload, payload_len);
+    job->buffer_len += payload_len;
+    job->buffer[job->buffer_len++] = '\n';
+
+    return true;
+}
+
+uint64_t msaf_state_journal_seq(const msaf_state_journal_t *journal)
+{
+    ogs_assert(journal);
+
+    return journal->seq;
+}
+
+size_t msaf_state_journal_length(const msaf_state_journal_t *journal)
+{
+    ogs_assert(journal);
+
+    return journal->length;
+}
+
+/*****************************************************
+ ***** Private functions
+ *****************************************************/
+
+/* Returns OGS_OK if mapped, OGS_DONE if the file does not exist or OGS_ERROR. An empty file is OGS_OK with no data. */
+static int _map_file(const char *path, msaf_state_journal_mapping_t *mapping)
+{
+    struct stat statbuf;
+    int fd;
+
+    mapping->data = NULL;
+    mapping->size = 0;
+
+    fd = open(path, O_RDONLY|O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) return OGS_DONE;
+        ogs_error("Unable to open %s: %s", path, strerror(errno));
+        return OGS_ERROR;
+    }
+
+    if (fstat(fd, &statbuf) < 0) {
+        ogs_error("Unable to stat %s: %s", path, strerror(errno));
+        close(fd);
+        return OGS_ERROR;
+    }
+
+    if (statbuf.st_size > 0) {
+        /* a private writable mapping lets payloads be nul terminated in place without changing the file */
+        void *data = mmap(NULL, statbuf.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            ogs_error("Unable to map %s: %s", path, strerror(errno));
+            close(fd);
+            return OGS_ERROR;
+        }
+        madvise(data, statbuf.st_size, MADV_SEQUENTIAL);
+        mapping->data = data;
+        mapping->size = statbuf.st_size;
+    }
+
+    close(fd);
+
+    return OGS_OK;
+}
+
+static void _unmap_file(msaf_state_journal_mapping_t *mapping)
+{
+    if (mapping->data) munmap(mapping->data, mapping->size);
+    mapping->data = NULL;
+    mapping->size = 0;
+}
+
+/* Returns the offset of the first record, or 0 if the header is bad */
+static size_t _snapshot_header_parse(const msaf_state_journal_mapping_t *mapping, uint64_t *seq)
+{
+    char header[SNAPSHOT_HEADER_MAX];
+    char magic[sizeof(MSAF_STATE_JOURNAL_SNAPSHOT_MAGIC)];
+    unsigned long long value;
+    const char *eol;
+    int consumed = 0;
+
+    if (!mapping->data) return 0;
+
+    eol = memchr(mapping->data, '\n', mapping->size < sizeof(header)?mapping->size:sizeof(header));
+    if (!eol) return 0;
+
+    memcpy(header, mapping->data, eol - mapping->data);
+    header[eol - mapping->data] = '\0';
+
+    if (sscanf(header, "%8s %llu%n", magic, &value, &consumed) != 2 || consumed != eol - mapping->data ||
+            strcmp(magic, MSAF_STATE_JOURNAL_SNAPSHOT_MAGIC)) {
+        return 0;
+    }
+
+    *seq = value;
+
+    return eol - mapping->data + 1;
+}
+
+/* Parse the record at *offset, on success *offset is moved past it. If terminate is true the payload's trailing newline is
+ * replaced with a nul, after which the record cannot be parsed again. */
+static bool _record_parse(msaf_state_journal_mapping_t *mapping, size_t *offset, msaf_state_journal_record_t *record,
+                          bool terminate)
+{
+    char header[RECORD_HEADER_MAX];
+    char magic[sizeof(MSAF_STATE_JOURNAL_RECORD_MAGIC)];
+    unsigned long long seq;
+    unsigned long crc;
+    size_t available, header_len, payload_len;
+    char *start, *eol, *payload;
+    int consumed = 0;
+
+    start = mapping->data + *offset;
+    available = mapping->size - *offset;
+
+    eol = memchr(start, '\n', available < sizeof(header)?available:sizeof(header));
+    if (!eol) return false;
+
+    header_len = eol - start;
+    memcpy(header, start, header_len);
+    header[header_len] = '\0';
+    header_len++;
+
+    if (sscanf(header, "%8s %llu %63s %zu %8lx%n", magic, &seq, record->type, &payload_len, &crc, &consumed) != 5 ||
+            consumed != header_len - 1 || strcmp(magic, MSAF_STATE_JOURNAL_RECORD_MAGIC)) {
+        return false;
+    }
+
+    if (payload_len >= available - header_len) return false;
+
+    payload = start + header_len;
+    if (payload[payload_len] != '\n') return false;
+    if (crc32(0L, (const Bytef*)payload, payload_len) != crc) return false;
+
+    if (terminate) payload[payload_len] = '\0';
+
+    record->seq = seq;
+    record->payload = payload;
+    record->payload_len = payload_len;
+
+    *offset += header_len + payload_len + 1;
+
+    return true;
+}
+
+static int _record_header(char *header, uint64_t seq, const char *type, const char *payload, size_t payload_len)
+{
+    int header_len;
+
+    ogs_assert(*type && strlen(type) <= MSAF_STATE_JOURNAL_TYPE_MAX && !strpbrk(type, " \t\n"));
+
+    header_len = snprintf(header, RECORD_HEADER_MAX, "%s %llu %s %zu %08lx\n", MSAF_STATE_JOURNAL_RECORD_MAGIC,
+                          (unsigned long long)seq, type, payload_len,
+                          (unsigned long)crc32(0L, (const Bytef*)payload, payload_len));
+    ogs_assert(header_len > 0 && header_len < RECORD_HEADER_MAX);
+
+    return header_len;
+}
+
+static bool _replay(const msaf_state_journal_record_t *record, msaf_state_journal_record_fn record_fn, void *data)
+{
+    if (record_fn(record->type, record->payload, record->payload_len, data)) return true;
+
+    ogs_warn("Unable to apply %s state record %llu", record->type, (unsigned long long)record->seq);
+
+    return false;
+}
+
+static void _snapshot_job_free(msaf_state_journal_snapshot_job_t *job)
+{
+    ogs_free(job->directory);
+    ogs_free(job->path);
+    ogs_free(job->tmp_path);
+    ogs_free(job->buffer);
+    ogs_free(job);
+}
+
+/* Remove the first size bytes, holding length records, from the journal as they are now in the snapshot */
+static void _journal_drop(msaf_state_journal_t *journal, off_t size, size_t length)
+{
+    int fd;
+
+    journal->length -= length;
+
+    if (journal->journal_size == size) {
+        /* if this fails the records are still skipped on loading, as the snapshot already includes them */
+        if (ftruncate(journal->fd, 0) < 0) {
+            ogs_error("Unable to empty %s: %s", journal->journal_path, strerror(errno));
+        } else {
+            journal->journal_size = 0;
+        }
+        return;
+    }
+
+    /* changes were journaled while the snapshot was being written, these are kept by copying them to a new journal */
+    fd = open(journal->journal_tmp_path, O_CREAT|O_WRONLY|O_TRUNC|O_APPEND|O_CLOEXEC, 0664);
+    if (fd < 0) {
+        ogs_error("Unable to create %s: %s", journal->journal_tmp_path, strerror(errno));
+        return;
+    }
+
+    if (!_journal_copy(journal, size, fd) || (journal->fsync && fdatasync(fd) < 0) ||
+            rename(journal->journal_tmp_path, journal->journal_path) < 0) {
+        ogs_error("Unable to replace %s, the records already in the snapshot will be skipped when it is loaded: %s",
+                  journal->journal_path, strerror(errno));
+        close(fd);
+        if (unlink(journal->journal_tmp_path) < 0 && errno != ENOENT) {
+            ogs_warn("Unable to remove %s: %s", journal->journal_tmp_path, strerror(errno));
+        }
+        return;
+    }
+    if (journal->fsync) _sync_directory(journal->directory);
+
+    if (close(journal->fd) < 0) {
+        ogs_error("Failed to close %s: %s", journal->journal_path, strerror(errno));
+    }
+    journal->fd = fd;
+    journal->journal_size -= size;
+}
+
+/* Copy the journal records after from to the end of fd */
+static bool _journal_copy(msaf_state_journal_t *journal, off_t from, int fd)
+{
+    char *block;
+    bool ok = true;
+    int in;
+
+    in = open(journal->journal_path, O_RDONLY|O_CLOEXEC);
+    if (in < 0) return false;
+
+    block = ogs_malloc(JOURNAL_COPY_BLOCK);
+    ogs_assert(block);
+
+    while (ok && from < journal->journal_size) {
+        struct iovec iov;
+        size_t wanted = journal->journal_size - from;
+        ssize_t got;
+
+        if (wanted > JOURNAL_COPY_BLOCK) wanted = JOURNAL_COPY_BLOCK;
+
+        got = pread(in, block, wanted, from);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) {
+            /* the journal is shorter than the records appended to it */
+            if (!got) errno = EIO;
+            ok = false;
+            break;
+        }
+
+        iov.iov_base = block;
+        iov.iov_len = got;
+        ok = _write_all(fd, &iov, 1);
+        from += got;
+    }
+
+    ogs_free(block);
+    close(in);
+
+    return ok;
+}
+
+/* Make a rename in the directory durable */
+static void _sync_directory(const char *path)
+{
+    int fd = open(path, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+
+    if (fd < 0) {
+        ogs_warn("Unable to open directory %s to sync it: %s", path, strerror(errno));
+        return;
+    }
+
+    if (fsync(fd) < 0) {
+        ogs_warn("Failed to sync directory %s: %s", path, strerror(errno));
+    }
+
+    close(fd);
+}
+
+static bool _write_all(int fd, struct iovec *iov, int iovcnt)
+{
+    while (iovcnt > 0) {
+        ssize_t written = writev(fd, iov, iovcnt);
+
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        /* skip what was written, a short write leaves us part way through an iovec */
+        while (iovcnt > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+
+    return true;
+}
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,115 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+ */
+
+#ifndef MSAF_STATE_JOURNAL_H
+#define MSAF_STATE_JOURNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ogs-core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Write-ahead journal with snapshots
+ *
+ * State changes are appended as records to <directory>/journal. Every so often the whole state is written, as a set of
+ * records, to <directory>/snapshot.tmp which is then synced and renamed over <directory>/snapshot, after which the records it
+ * includes are dropped from the journal. Loading replays the snapshot followed by the journal records written after it, so a restart only replays the
+ * changes made since the last snapshot.
+ *
+ * The snapshot starts with a header line giving the sequence number of the last change it includes:
+ *
+ *     MSAFSNP1 <seq>\n
+ *
+ * Records, in both files, are a header line followed by the payload and a newline that is not counted in its length:
+ *
+ *     MSAFJRN1 <seq> <type> <payload len> <payload crc32 as 8 hex digits>\n
+ *     <payload>\n
+ *
+ * Journal records with a seq no greater than the snapshot's were already included in the snapshot, which happens if the AF
+ * stopped between replacing the snapshot and emptying the journal. A journal that ends in a partial or corrupt record, from a
+ * write interrupted by a crash, is truncated at the last good record when it is loaded.
+ *
+ * Taking a snapshot is split so that the slow part can be done on another thread. msaf_state_journal_snapshot_begin() collects
+ * the state in memory, msaf_state_journal_snapshot_write() writes, syncs and renames it into place using only the job, so
+ * changes can still be appended meanwhile, and msaf_state_journal_snapshot_end() then drops the records it includes from the
+ * journal. Records appended while the snapshot was being written are kept. msaf_state_journal_snapshot() does all three.
+ */
+
+#define MSAF_STATE_JOURNAL_RECORD_MAGIC "MSAFJRN1"
+#define MSAF_STATE_JOURNAL_SNAPSHOT_MAGIC "MSAFSNP1"
+
+/* Longest record type name */
+#define MSAF_STATE_JOURNAL_TYPE_MAX 63
+
+/* Default number of journal records between snapshots */
+#define MSAF_STATE_JOURNAL_DEFAULT_SNAPSHOT_AFTER 1000
+
+typedef struct msaf_state_journal_config_s {
+    char *directory;                  /* NULL if state is not kept */
+    size_t snapshot_after;            /* journal records before a new snapshot is taken, 0 for only at start up */
+    bool fsync;                       /* sync the journal after every record, snapshots are always synced */
+} msaf_state_journal_config_t;
+
+typedef struct msaf_state_journal_s msaf_state_journal_t;
+typedef struct msaf_state_journal_snapshot_job_s msaf_state_journal_snapshot_job_t;
+
+/* Called for each record replayed by msaf_state_journal_load(). payload is nul terminated. Returns false if the record
+ * could not be applied, which is logged and counted but does not stop the replay. */
+typedef bool (*msaf_state_journal_record_fn)(const char *type, const char *payload, size_t payload_len, void *data);
+
+/* Called by msaf_state_journal_snapshot_begin() to write the state with msaf_state_journal_snapshot_add(). Returns false to abandon
+ * the snapshot. */
+typedef bool (*msaf_state_journal_snapshot_fn)(msaf_state_journal_t *journal, void *data);
+
+extern void msaf_state_journal_config_init(msaf_state_journal_config_t *config);
+extern void msaf_state_journal_config_clear(msaf_state_journal_config_t *config);
+
+extern msaf_state_journal_t *msaf_state_journal_open(const msaf_state_journal_config_t *config /* [not-null] */);
+/* Any snapshot begun must have been ended first */
+extern void msaf_state_journal_close(msaf_state_journal_t *journal /* [null] */);
+
+/* Replay the snapshot and then the journal through record_fn and open the journal for appending. Returns false, leaving the
+ * files untouched, if the snapshot is unreadable or corrupt, in which case the journal cannot be used. */
+extern bool msaf_state_journal_load(msaf_state_journal_t *journal, msaf_state_journal_record_fn record_fn, void *data);
+
+extern bool msaf_state_journal_append(msaf_state_journal_t *journal, const char *type, const char *payload, size_t payload_len);
+
+/* True once snapshot_after records have been appended since the last snapshot, and no snapshot is being taken */
+extern bool msaf_state_journal_snapshot_due(const msaf_state_journal_t *journal);
+/* Write a new snapshot of the state written by snapshot_fn and empty the journal, all on the calling thread */
+extern bool msaf_state_journal_snapshot(msaf_state_journal_t *journal, msaf_state_journal_snapshot_fn snapshot_fn, void *data);
+/* Collect the state written by snapshot_fn in memory. Returns NULL if snapshot_fn fails or a snapshot has already been begun. */
+extern msaf_state_journal_snapshot_job_t *msaf_state_journal_snapshot_begin(msaf_state_journal_t *journal,
+                                                                     msaf_state_journal_snapshot_fn snapshot_fn, void *data);
+/* Write, sync and rename the snapshot into place. Safe to call from any thread as it does not use the journal. */
+extern bool msaf_state_journal_snapshot_write(msaf_state_journal_snapshot_job_t *job);
+/* If written, drop the records included in the snapshot from the journal. Frees the job. */
+extern void msaf_state_journal_snapshot_end(msaf_state_journal_t *journal, msaf_state_journal_snapshot_job_t *job /* [transfer] */,
+                                            bool written);
+extern bool msaf_state_journal_snapshot_add(msaf_state_journal_t *journal, const char *type, const char *payload,
+                                            size_t payload_len);
+
+/* Sequence number of the last record appended or loaded */
+extern uint64_t msaf_state_journal_seq(const msaf_state_journal_t *journal);
+/* Records appended or replayed from the journal since the last snapshot */
+extern size_t msaf_state_journal_length(const msaf_state_journal_t *journal);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
+
+#endif /* ifndef MSAF_STATE_JOURNAL_H */
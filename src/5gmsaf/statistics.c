@@ -0,0 +1,130 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#include "data-collection.h"
+#include "metrics-report.h"
+#include "rate-limit.h"
+#include "sai-cache.h"
+
+#include "statistics.h"
+
+static cJSON *_sai_cache_statistics(void);
+static cJSON *_data_collection_statistics(void);
+static cJSON *_metrics_reporting_statistics(void);
+static cJSON *_m5_rate_limit_statistics(void);
+
+cJSON *msaf_statistics_json(void)
+{
+    cJSON *stats;
+
+    stats = cJSON_CreateObject();
+    ogs_assert(stats);
+
+    cJSON_AddItemToObject(stats, "serviceAccessInformationCache", _sai_cache_statistics());
+    cJSON_AddItemToObject(stats, "dataCollection", _data_collection_statistics());
+    cJSON_AddItemToObject(stats, "metricsReporting", _metrics_reporting_statistics());
+    cJSON_AddItemToObject(stats, "m5RateLimit", _m5_rate_limit_statistics());
+
+    return stats;
+}
+
+/***** Private functions *****/
+
+static cJSON *_sai_cache_statistics(void)
+{
+    msaf_sai_cache_stats_t sai_stats;
+    cJSON *json;
+
+    msaf_sai_cache_get_stats(&sai_stats);
+
+    json = cJSON_CreateObject();
+    ogs_assert(json);
+
+    cJSON_AddNumberToObject(json, "hits", sai_stats.hits);
+    cJSON_AddNumberToObject(json, "misses", sai_stats.misses);
+    cJSON_AddNumberToObject(json, "insertions", sai_stats.insertions);
+    cJSON_AddNumberToObject(json, "evictions", sai_stats.evictions);
+    cJSON_AddNumberToObject(json, "templateSplices", sai_stats.template_splices);
+    cJSON_AddNumberToObject(json, "regenerations", sai_stats.regenerations);
+    cJSON_AddNumberToObject(json, "entries", sai_stats.entries);
+    cJSON_AddNumberToObject(json, "bytes", sai_stats.bytes);
+
+    return json;
+}
+
+static cJSON *_data_collection_statistics(void)
+{
+    msaf_data_collection_stats_t dc_stats;
+    uint64_t written;
+    cJSON *json;
+
+    msaf_data_collection_get_stats(&dc_stats);
+
+    json = cJSON_CreateObject();
+    ogs_assert(json);
+
+    written = dc_stats.stored + dc_stats.failed;
+
+    cJSON_AddNumberToObject(json, "stored", dc_stats.stored);
+    cJSON_AddNumberToObject(json, "failed", dc_stats.failed);
+    cJSON_AddNumberToObject(json, "rejected", dc_stats.rejected);
+    cJSON_AddNumberToObject(json, "queueLength", dc_stats.queue_length);
+    cJSON_AddNumberToObject(json, "queueDepth", dc_stats.queue_depth);
+    cJSON_AddNumberToObject(json, "queueDepthMax", dc_stats.queue_depth_max);
+    /* times in microseconds */
+    cJSON_AddNumberToObject(json, "queueTimeAverage", written?(double)dc_stats.queue_time_total/written:0);
+    cJSON_AddNumberToObject(json, "queueTimeMax", dc_stats.queue_time_max);
+    cJSON_AddNumberToObject(json, "writeTimeAverage", written?(double)dc_stats.write_time_total/written:0);
+    cJSON_AddNumberToObject(json, "writeTimeMax", dc_stats.write_time_max);
+
+    return json;
+}
+
+static cJSON *_metrics_reporting_statistics(void)
+{
+    msaf_metrics_report_stats_t mr_stats;
+    cJSON *json;
+
+    msaf_metrics_report_get_stats(&mr_stats);
+
+    json = cJSON_CreateObject();
+    ogs_assert(json);
+
+    cJSON_AddNumberToObject(json, "accepted", mr_stats.accepted);
+    cJSON_AddNumberToObject(json, "rejected", mr_stats.rejected);
+
+    return json;
+}
+
+static cJSON *_m5_rate_limit_statistics(void)
+{
+    msaf_rate_limit_stats_t rl_stats;
+    cJSON *json;
+
+    msaf_rate_limit_get_stats(&rl_stats);
+
+    json = cJSON_CreateObject();
+    ogs_assert(json);
+
+    cJSON_AddNumberToObject(json, "allowed", rl_stats.allowed);
+    cJSON_AddNumberToObject(json, "clientRejected", rl_stats.client_rejected);
+    cJSON_AddNumberToObject(json, "sessionRejected", rl_stats.session_rejected);
+    cJSON_AddNumberToObject(json, "evictions", rl_stats.evictions);
+    cJSON_AddNumberToObject(json, "clients", rl_stats.clients);
+    cJSON_AddNumberToObject(json, "sessions", rl_stats.sessions);
+
+    return json;
+}
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
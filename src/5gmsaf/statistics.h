@@ -0,0 +1,31 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Author: David Waring
+Copyright: (C) 2024 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#ifndef MSAF_STATISTICS_H
+#define MSAF_STATISTICS_H
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Collect the AF runtime counters into a JSON object for the management interface */
+extern cJSON *msaf_statistics_json(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MSAF_STATISTICS_H */
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
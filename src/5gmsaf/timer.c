@@ -42,6 +42,8 @@ const char *msaf_timer_get_name(int timer_id)
         return OGS_TIMER_NAME_SBI_CLIENT_WAIT;
     case MSAF_TIMER_DELIVERY_BOOST:
         return "MSAF_TIMER_DELIVERY_BOOST";
+    case MSAF_TIMER_CHANGE_FEED_WAIT:
+        return "MSAF_TIMER_CHANGE_FEED_WAIT";
     default: 
        break;
     }
@@ -63,6 +65,13 @@ static void timer_send_event(int timer_id, void *data)
         e->h.timer_id = timer_id;
         e->network_assistance_session = (msaf_network_assistance_session_t *)data;
         break;
+    case MSAF_TIMER_CHANGE_FEED_WAIT:
+        e = (msaf_event_t *)ogs_event_new(MSAF_EVENT_SBI_LOCAL);
+        ogs_assert(e);
+        e->h.timer_id = timer_id;
+        e->local_id = MSAF_LOCAL_EVENT_CHANGE_FEED_WAIT_EXPIRED;
+        e->data = data;
+        break;
     default:
         ogs_fatal("Unknown timer id[%d]", timer_id);
         ogs_assert_if_reached();
@@ -81,3 +90,8 @@ void msaf_timer_delivery_boost(void *data)
 {
     timer_send_event(MSAF_TIMER_DELIVERY_BOOST, data);
 }
+
+void msaf_timer_change_feed_wait(void *data)
+{
+    timer_send_event(MSAF_TIMER_CHANGE_FEED_WAIT, data);
+}
@@ -21,6 +21,7 @@ typedef enum {
     MSAF_TIMER_BASE = OGS_MAX_NUM_OF_PROTO_TIMER,
 
     MSAF_TIMER_DELIVERY_BOOST,
+    MSAF_TIMER_CHANGE_FEED_WAIT,
 
     MAX_NUM_OF_MSAF_TIMER,
 
@@ -28,6 +29,7 @@ typedef enum {
 
 const char *msaf_timer_get_name(int timer_id);
 void msaf_timer_delivery_boost(void *data);
+void msaf_timer_change_feed_wait(void *data);
 
 #ifdef __cplusplus
 }
@@ -41,8 +41,6 @@ extern const char *get_time(time_t time_epoch);
 extern time_t str_to_time(const char *str_time);
 extern double str_to_bitrate(const char *ts29571_bitrate, const char **err);
 
-extern char *check_http_content_type(ogs_sbi_http_message_t http, char *content_type);
-
 extern char *traceable_strdup(const char *str, const char *location);
 
 #define msaf_strdup(s) traceable_strdup((s), __location__)
@@ -375,4 +375,114 @@ index 1bf1a0528..501693a45 100644
 EOF
 )
 fi
+
+# Tell the AF when a server stream is freed, so that a stream it answers later, e.g. a long-poll, is never used once the client
+# has closed it. MHD streams are the sessions.
+if ! grep -q 'ogs_sbi_server_stream_closed' "$open5gs_src/lib/sbi/server.h"; then
+    sed -i '/^static void stream_remove(ogs_sbi_stream_t \*stream)$/,/^{$/ s/^{$/{\n    ogs_sbi_server_stream_closed(stream);/' \
+        "$open5gs_src/lib/sbi/nghttp2-server.c"
+    sed -i '/^static void session_remove(ogs_sbi_session_t \*sbi_sess)$/,/^{$/ s/^{$/{\n    ogs_sbi_server_stream_closed((ogs_sbi_stream_t *)sbi_sess);/' \
+        "$open5gs_src/lib/sbi/mhd-server.c"
+    if ! grep -q 'ogs_sbi_server_stream_closed(stream);' "$open5gs_src/lib/sbi/nghttp2-server.c" || \
+       ! grep -q 'ogs_sbi_server_stream_closed((ogs_sbi_stream_t \*)sbi_sess);' "$open5gs_src/lib/sbi/mhd-server.c"; then
+        echo "Unable to add the stream close notification to the Open5GS SBI servers" >&2
+        exit 1
+    fi
+    cat >> "$open5gs_src/lib/sbi/server.c" <<EOF
+
+/* rt-5gms-application-function: stream close notification */
+static void (*stream_closed_callback)(ogs_sbi_stream_t *stream) = NULL;
+
+void ogs_sbi_server_set_stream_closed_callback(void (*callback)(ogs_sbi_stream_t *stream))
+{
+    stream_closed_callback = callback;
+}
+
+void ogs_sbi_server_stream_closed(ogs_sbi_stream_t *stream)
+{
+    if (stream_closed_callback) stream_closed_callback(stream);
+}
+EOF
+    cat >> "$open5gs_src/lib/sbi/server.h" <<EOF
+
+/* rt-5gms-application-function: the callback is called just before a server stream is freed */
+void ogs_sbi_server_set_stream_closed_callback(void (*callback)(ogs_sbi_stream_t *stream));
+void ogs_sbi_server_stream_closed(ogs_sbi_stream_t *stream);
+EOF
+fi
+
+# Let the AF see the address of the client connected to a server stream, so that it can rate limit clients without having to
+# believe an X-Forwarded-For header sent by anyone.
+if ! grep -q 'ogs_sbi_server_stream_peer_address' "$open5gs_src/lib/sbi/server.h"; then
+    cat >> "$open5gs_src/lib/sbi/nghttp2-server.c" <<EOF
+
+/* rt-5gms-application-function: stream peer address */
+const char *ogs_nghttp2_server_stream_peer_address(ogs_sbi_stream_t *stream, char *buf)
+{
+    ogs_assert(stream);
+    ogs_assert(buf);
+
+    if (!stream->session || !stream->session->addr) return NULL;
+
+    return OGS_ADDR(stream->session->addr, buf);
+}
+EOF
+    cat >> "$open5gs_src/lib/sbi/mhd-server.c" <<EOF
+
+/* rt-5gms-application-function: stream peer address */
+const char *ogs_mhd_server_stream_peer_address(ogs_sbi_stream_t *stream, char *buf)
+{
+    ogs_sbi_session_t *sbi_sess = (ogs_sbi_session_t *)stream;
+    const union MHD_ConnectionInfo *info;
+    ogs_sockaddr_t addr;
+
+    ogs_assert(sbi_sess);
+    ogs_assert(buf);
+
+    if (!sbi_sess->connection) return NULL;
+
+    info = MHD_get_connection_info(sbi_sess->connection, MHD_CONNECTION_INFO_CLIENT_ADDRESS);
+    if (!info || !info->client_addr) return NULL;
+
+    memset(&addr, 0, sizeof(addr));
+    switch (info->client_addr->sa_family) {
+    case AF_INET:
+        memcpy(&addr.sin, info->client_addr, sizeof(addr.sin));
+        break;
+    case AF_INET6:
+        memcpy(&addr.sin6, info->client_addr, sizeof(addr.sin6));
+        break;
+    default:
+        return NULL;
+    }
+
+    return OGS_ADDR(&addr, buf);
+}
+EOF
+    cat >> "$open5gs_src/lib/sbi/server.c" <<EOF
+
+/* rt-5gms-application-function: stream peer address */
+const char *ogs_nghttp2_server_stream_peer_address(ogs_sbi_stream_t *stream, char *buf);
+const char *ogs_mhd_server_stream_peer_address(ogs_sbi_stream_t *stream, char *buf);
+
+const char *ogs_sbi_server_stream_peer_address(ogs_sbi_stream_t *stream, char *buf)
+{
+    ogs_sbi_server_t *server = ogs_sbi_server_from_stream(stream);
+
+    ogs_assert(server);
+
+    if (server->actions == &ogs_mhd_server_actions)
+        return ogs_mhd_server_stream_peer_address(stream, buf);
+
+    return ogs_nghttp2_server_stream_peer_address(stream, buf);
+}
+EOF
+    cat >> "$open5gs_src/lib/sbi/server.h" <<EOF
+
+/* rt-5gms-application-function: writes the address of the client connected to the stream into buf, which must be
+ * OGS_ADDRSTRLEN long, and returns buf, or NULL if the address is not known */
+const char *ogs_sbi_server_stream_peer_address(ogs_sbi_stream_t *stream, char *buf);
+EOF
+fi
+
 exit 0
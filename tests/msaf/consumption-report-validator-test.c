@@ -0,0 +1,233 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Author: David Waring
+ * Copyright: (C) 2024 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+/* System includes */
+#include <string.h>
+#include <time.h>
+
+/* Open5GS includes */
+#include "test-common.h"
+
+/* MSAF includes */
+#include "consumption-report-validator.h"
+#include "json-reader.h"
+#include "openapi/model/msaf_api_consumption_report.h"
+
+/* Test includes */
+#include "consumption-report-validator-test.h"
+
+#define ABTS_PTR_NULL(a, b) ABTS_PTR_EQUAL(a, b, NULL)
+#define ABTS_FALSE(a, b) ABTS_TRUE(a, !(b))
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+static const char *test_report =
+    "{\n"
+    "  \"mediaPlayerEntry\": \"https://example.com/m4d/provisioning-session-1/manifest.mpd\",\n"
+    "  \"reportingClientId\": \"client-1\",\n"
+    "  \"consumptionReportingUnits\": [\n"
+    "    {\n"
+    "      \"mediaConsumed\": \"video-1\",\n"
+    "      \"mediaEndpointAddress\": {\"ipv4Addr\": \"192.0.2.1\", \"portNumbers\": [443]},\n"
+    "      \"startTime\": \"2024-06-01T12:00:00Z\",\n"
+    "      \"duration\": 30\n"
+    "    },\n"
+    "    {\"mediaConsumed\": \"audio-1\", \"startTime\": \"2024-06-01T12:00:00Z\", \"duration\": 30}\n"
+    "  ]\n"
+    "}";
+
+static bool _validate(const char *body, msaf_consumption_report_summary_t *summary)
+{
+    return msaf_consumption_report_validate(body, strlen(body), summary);
+}
+
+static void test_json_reader_tokens(abts_case *tc, void *data)
+{
+    static const char *doc = " {\"a\\tb\": [1, -2.5e3, \"x\\u00e9\\ud83d\\ude00\", true, false, null, {}], \"c\": []} ";
+    static const msaf_json_token_t expected[] = {
+        MSAF_JSON_TOKEN_OBJECT_START, MSAF_JSON_TOKEN_KEY, MSAF_JSON_TOKEN_ARRAY_START, MSAF_JSON_TOKEN_NUMBER,
+        MSAF_JSON_TOKEN_NUMBER, MSAF_JSON_TOKEN_STRING, MSAF_JSON_TOKEN_TRUE, MSAF_JSON_TOKEN_FALSE, MSAF_JSON_TOKEN_NULL,
+        MSAF_JSON_TOKEN_OBJECT_START, MSAF_JSON_TOKEN_OBJECT_END, MSAF_JSON_TOKEN_ARRAY_END, MSAF_JSON_TOKEN_KEY,
+        MSAF_JSON_TOKEN_ARRAY_START, MSAF_JSON_TOKEN_ARRAY_END, MSAF_JSON_TOKEN_OBJECT_END, MSAF_JSON_TOKEN_END
+    };
+    static const char *bad[] = {
+        "", "{", "[1,]", "{\"a\":1,}", "{\"a\" 1}", "{1:2}", "[01]", "[1.]", "[-]", "\"\\x\"", "\"\\u12\"", "\"a\nb\"",
+        "[tru]", "{} {}", "[1 2]", "{\"a\":1]"
+    };
+    msaf_json_reader_t reader;
+    msaf_json_token_t token;
+    int64_t value;
+    char *str;
+    char deep[MSAF_JSON_READER_MAX_DEPTH + 2];
+    int i;
+
+    msaf_json_reader_init(&reader, doc, strlen(doc));
+    for (i = 0; i < sizeof(expected)/sizeof(expected[0]); i++) {
+        token = msaf_json_reader_next(&reader);
+        ABTS_INT_EQUAL(tc, expected[i], token);
+        if (i == 1) {
+            ABTS_TRUE(tc, msaf_json_reader_token_equals(&reader, "a\tb"));
+            ABTS_FALSE(tc, msaf_json_reader_token_equals(&reader, "a\\tb"));
+        } else if (i == 3) {
+            ABTS_TRUE(tc, msaf_json_reader_int64(&reader, &value));
+            ABTS_INT_EQUAL(tc, 1, value);
+        } else if (i == 4) {
+            ABTS_FALSE(tc, msaf_json_reader_int64(&reader, &value));
+            ABTS_TRUE(tc, msaf_json_reader_double(&reader) == -2500.0);
+        } else if (i == 5) {
+            str = msaf_json_reader_strdup(&reader);
+            ABTS_STR_EQUAL(tc, "x\xc3\xa9\xf0\x9f\x98\x80", str);
+            ogs_free(str);
+        }
+    }
+
+    /* skipping a container leaves the reader after it */
+    msaf_json_reader_init(&reader, doc, strlen(doc));
+    ABTS_INT_EQUAL(tc, MSAF_JSON_TOKEN_OBJECT_START, msaf_json_reader_next(&reader));
+    ABTS_TRUE(tc, msaf_json_reader_skip(&reader, msaf_json_reader_next(&reader)));
+    ABTS_INT_EQUAL(tc, MSAF_JSON_TOKEN_KEY, msaf_json_reader_next(&reader));
+    ABTS_TRUE(tc, msaf_json_reader_token_equals(&reader, "c"));
+
+    for (i = 0; i < sizeof(bad)/sizeof(bad[0]); i++) {
+        msaf_json_reader_init(&reader, bad[i], strlen(bad[i]));
+        do {
+            token = msaf_json_reader_next(&reader);
+        } while (token != MSAF_JSON_TOKEN_ERROR && token != MSAF_JSON_TOKEN_END);
+        ABTS_INT_EQUAL(tc, MSAF_JSON_TOKEN_ERROR, token);
+        ABTS_PTR_NOTNULL(tc, reader.error);
+    }
+
+    memset(deep, '[', sizeof(deep) - 1);
+    deep[sizeof(deep) - 1] = '\0';
+    msaf_json_reader_init(&reader, deep, strlen(deep));
+    do {
+        token = msaf_json_reader_next(&reader);
+    } while (token == MSAF_JSON_TOKEN_ARRAY_START);
+    ABTS_INT_EQUAL(tc, MSAF_JSON_TOKEN_ERROR, token);
+}
+
+static void test_consumption_report_validate(abts_case *tc, void *data)
+{
+    static const char *fallback[] = {
+        /* invalid reports */
+        "{\"mediaPlayerEntry\":\"a\",\"consumptionReportingUnits\":[{\"mediaConsumed\":\"m\",\"startTime\":\"t\",\"duration\":1}]}",
+        "{\"mediaPlayerEntry\":\"a\",\"reportingClientId\":\"c\",\"consumptionReportingUnits\":[]}",
+        "{\"mediaPlayerEntry\":\"a\",\"reportingClientId\":1,\"consumptionReportingUnits\":[{\"mediaConsumed\":\"m\",\"startTime\":\"t\",\"duration\":1}]}",
+        "{\"mediaPlayerEntry\":\"a\",\"reportingClientId\":\"c\",\"consumptionReportingUnits\":[{\"mediaConsumed\":\"m\",\"duration\":1}]}",
+        "{\"mediaPlayerEntry\":\"a\",\"reportingClientId\":\"c\",\"consumptionReportingUnits\":[{\"mediaConsumed\":\"m\",\"startTime\":\"t\",\"duration\":\"1\"}]}",
+        "{\"mediaPlayerEntry\":\"a\",\"reportingClientId\":\"c\",\"consumptionReportingUnits\":[{\"mediaConsumed\":\"m\",\"startTime\":\"t\",\"duration\":1}]",
+        "{\"mediaPlayerEntry\":\"a\",\"reportingClientId\":\"c\",\"consumptionReportingUnits\":[{\"mediaConsumed\":\"m\",\"startTime\":\"t\",\"duration\":1}]}x",
+        "[]",
+        /* valid but not checked by the validator */
+        "{\"mediaPlayerEntry\":\"a\",\"reportingClientId\":\"c\",\"consumptionReportingUnits\":[{\"mediaConsumed\":\"m\",\"startTime\":\"t\",\"duration\":1,\"locations\":[]}]}",
+        "{\"mediaPlayerEntry\":\"a\",\"reportingClientId\":\"c\",\"consumptionReportingUnits\":[{\"mediaConsumed\":\"m\",\"startTime\":\"t\",\"duration\":1}],\"other\":true}",
+        "{\"mediaPlayerEntry\":\"a\",\"reportingClientId\":\"c\",\"reportingClientId\":\"d\",\"consumptionReportingUnits\":[{\"mediaConsumed\":\"m\",\"startTime\":\"t\",\"duration\":1}]}"
+    };
+    msaf_consumption_report_summary_t summary;
+    int i;
+
+    ABTS_TRUE(tc, _validate(test_report, &summary));
+    ABTS_STR_EQUAL(tc, "client-1", summary.reporting_client_id);
+    ABTS_STR_EQUAL(tc, "https://example.com/m4d/provisioning-session-1/manifest.mpd", summary.media_player_entry);
+    ABTS_INT_EQUAL(tc, 2, summary.units);
+    ABTS_INT_EQUAL(tc, 60, summary.duration);
+    msaf_consumption_report_summary_clear(&summary);
+    ABTS_PTR_NULL(tc, summary.reporting_client_id);
+
+    ABTS_TRUE(tc, _validate("{\"reportingClientId\":\"client\\/\\u0032\",\"consumptionReportingUnits\":[{\"duration\":0,"
+                            "\"startTime\":\"t\",\"mediaConsumed\":\"m\"}],\"mediaPlayerEntry\":\"a\"}", &summary));
+    ABTS_STR_EQUAL(tc, "client/2", summary.reporting_client_id);
+    msaf_consumption_report_summary_clear(&summary);
+
+    for (i = 0; i < sizeof(fallback)/sizeof(fallback[0]); i++) {
+        ABTS_FALSE(tc, _validate(fallback[i], &summary));
+        ABTS_PTR_NULL(tc, summary.reporting_client_id);
+        ABTS_PTR_NULL(tc, summary.media_player_entry);
+    }
+
+    /* anything the validator accepts must also be accepted by the full parse */
+    {
+        cJSON *json = cJSON_Parse(test_report);
+        msaf_api_consumption_report_t *report;
+        const char *reason = NULL;
+
+        ABTS_PTR_NOTNULL(tc, json);
+        report = msaf_api_consumption_report_parseRequestFromJSON(json, &reason);
+        ABTS_PTR_NOTNULL(tc, report);
+        if (report) msaf_api_consumption_report_free(report);
+        cJSON_Delete(json);
+    }
+}
+
+#define CONSUMPTION_REPORT_BENCH_REPORTS 10000
+
+static void test_consumption_report_validate_benchmark(abts_case *tc, void *data)
+{
+    struct timespec start, end;
+    long long validate_ns, parse_ns;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < CONSUMPTION_REPORT_BENCH_REPORTS; i++) {
+        msaf_consumption_report_summary_t summary;
+        if (!_validate(test_report, &summary)) {
+            ABTS_FAIL(tc, "Report not validated");
+            break;
+        }
+        msaf_consumption_report_summary_clear(&summary);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    validate_ns = ((end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec)) / CONSUMPTION_REPORT_BENCH_REPORTS;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < CONSUMPTION_REPORT_BENCH_REPORTS; i++) {
+        cJSON *json = cJSON_Parse(test_report);
+        msaf_api_consumption_report_t *report;
+        const char *reason;
+
+        report = msaf_api_consumption_report_parseRequestFromJSON(json, &reason);
+        if (report) msaf_api_consumption_report_free(report);
+        cJSON_Delete(json);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    parse_ns = ((end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec)) / CONSUMPTION_REPORT_BENCH_REPORTS;
+
+    ogs_info("ConsumptionReport validation: %lld ns/report, cJSON and model parse: %lld ns/report", validate_ns, parse_ns);
+}
+
+static struct {
+    void (*func)(abts_case *tc, void *data);
+} test_cases[] = {
+    {test_json_reader_tokens},
+    {test_consumption_report_validate},
+    {test_consumption_report_validate_benchmark}
+};
+
+abts_suite *test_consumption_report_validator(abts_suite *suite)
+{
+    int i;
+
+    suite = ADD_SUITE(suite)
+
+    for (i=0; i<(sizeof(test_cases)/sizeof(test_cases[0])); i++) {
+        abts_run_test(suite, test_cases[i].func, NULL);
+    }
+
+    return suite;
+}
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,182 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Author: David Waring
+ * Copyright: (C) 2024 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+/* System includes */
+#include <stdio.h>
+#include <string.h>
+
+/* Open5GS includes */
+#include "test-common.h"
+
+/* MSAF includes */
+#include "consumption-statistics.h"
+
+/* Test includes */
+#include "consumption-statistics-test.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+/* Start well away from 0 so that the window never reaches back before the clock started */
+#define TEST_START ogs_time_from_sec(1000000)
+
+static void _add_report(msaf_consumption_statistics_t *statistics, const char *client_id, const char *media_player_entry,
+                        int units, int duration, ogs_time_t now)
+{
+    msaf_consumption_report_summary_t summary;
+
+    summary.reporting_client_id = (char*)client_id;
+    summary.media_player_entry = (char*)media_player_entry;
+    summary.units = units;
+    summary.duration = duration;
+
+    msaf_consumption_statistics_add(statistics, &summary, now);
+}
+
+static void test_consumption_statistics_window(abts_case *tc, void *data)
+{
+    msaf_consumption_statistics_t *statistics;
+    msaf_consumption_statistics_result_t result;
+
+    /* no reports yet */
+    msaf_consumption_statistics_query(NULL, TEST_START, 0, &result);
+    ABTS_INT_EQUAL(tc, MSAF_CONSUMPTION_STATISTICS_WINDOW_SECONDS, result.window);
+    ABTS_INT_EQUAL(tc, 0, result.reports);
+
+    statistics = msaf_consumption_statistics_new();
+
+    _add_report(statistics, "client-1", "https://example.com/a.mpd", 2, 60, TEST_START);
+    _add_report(statistics, "client-1", "https://example.com/a.mpd", 1, 30, TEST_START + ogs_time_from_sec(1));
+    _add_report(statistics, "client-2", "https://example.com/b.mpd", 1, 10, TEST_START + ogs_time_from_sec(100));
+
+    msaf_consumption_statistics_query(statistics, TEST_START + ogs_time_from_sec(100), 0, &result);
+    ABTS_INT_EQUAL(tc, 3, result.reports);
+    ABTS_INT_EQUAL(tc, 4, result.units);
+    ABTS_INT_EQUAL(tc, 100, result.duration);
+    ABTS_INT_EQUAL(tc, 2, result.clients);
+    ABTS_INT_EQUAL(tc, 2, result.sessions);
+    ABTS_INT_EQUAL(tc, 2, result.number_of_entry_points);
+    ABTS_STR_EQUAL(tc, "https://example.com/a.mpd", result.entry_points[0].media_player_entry);
+    ABTS_INT_EQUAL(tc, 2, result.entry_points[0].reports);
+    ABTS_INT_EQUAL(tc, 1, result.entry_points[1].reports);
+    ABTS_INT_EQUAL(tc, 0, result.other_entry_points);
+
+    /* a shorter window only sees the latest report, rounded up to a whole bucket */
+    msaf_consumption_statistics_query(statistics, TEST_START + ogs_time_from_sec(100), 15, &result);
+    ABTS_INT_EQUAL(tc, 2 * MSAF_CONSUMPTION_STATISTICS_BUCKET_SECONDS, result.window);
+    ABTS_INT_EQUAL(tc, 1, result.reports);
+    ABTS_INT_EQUAL(tc, 1, result.clients);
+    ABTS_INT_EQUAL(tc, 1, result.number_of_entry_points);
+    ABTS_STR_EQUAL(tc, "https://example.com/b.mpd", result.entry_points[0].media_player_entry);
+
+    /* the first reports drop out of the window as time moves on */
+    msaf_consumption_statistics_query(statistics, TEST_START + ogs_time_from_sec(MSAF_CONSUMPTION_STATISTICS_WINDOW_SECONDS + 50),
+                                      0, &result);
+    ABTS_INT_EQUAL(tc, 1, result.reports);
+    ABTS_INT_EQUAL(tc, 10, result.duration);
+
+    /* a bucket reused on the next pass through the window starts empty */
+    _add_report(statistics, "client-3", "https://example.com/a.mpd", 1, 5,
+                TEST_START + ogs_time_from_sec(MSAF_CONSUMPTION_STATISTICS_WINDOW_SECONDS));
+    msaf_consumption_statistics_query(statistics, TEST_START + ogs_time_from_sec(MSAF_CONSUMPTION_STATISTICS_WINDOW_SECONDS),
+                                      MSAF_CONSUMPTION_STATISTICS_BUCKET_SECONDS, &result);
+    ABTS_INT_EQUAL(tc, 1, result.reports);
+    ABTS_INT_EQUAL(tc, 5, result.duration);
+
+    msaf_consumption_statistics_free(statistics);
+}
+
+static void test_consumption_statistics_entry_points(abts_case *tc, void *data)
+{
+    msaf_consumption_statistics_t *statistics;
+    msaf_consumption_statistics_result_t result;
+    char entry_point[64];
+    int i;
+
+    statistics = msaf_consumption_statistics_new();
+
+    for (i = 0; i < MSAF_CONSUMPTION_STATISTICS_MAX_ENTRY_POINTS + 4; i++) {
+        sprintf(entry_point, "https://example.com/%i.mpd", i);
+        _add_report(statistics, "client-1", entry_point, 1, 1, TEST_START);
+    }
+
+    msaf_consumption_statistics_query(statistics, TEST_START, 0, &result);
+    ABTS_INT_EQUAL(tc, MSAF_CONSUMPTION_STATISTICS_MAX_ENTRY_POINTS, result.number_of_entry_points);
+    ABTS_INT_EQUAL(tc, 4, result.other_entry_points);
+    /* small counts are nearly exact */
+    ABTS_TRUE(tc, result.sessions >= MSAF_CONSUMPTION_STATISTICS_MAX_ENTRY_POINTS + 2 &&
+                  result.sessions <= MSAF_CONSUMPTION_STATISTICS_MAX_ENTRY_POINTS + 6);
+
+    /* once the old entry points leave the window their counters are reused */
+    _add_report(statistics, "client-1", "https://example.com/new.mpd", 1, 1,
+                TEST_START + ogs_time_from_sec(MSAF_CONSUMPTION_STATISTICS_WINDOW_SECONDS));
+    msaf_consumption_statistics_query(statistics, TEST_START + ogs_time_from_sec(MSAF_CONSUMPTION_STATISTICS_WINDOW_SECONDS), 0,
+                                      &result);
+    ABTS_INT_EQUAL(tc, 1, result.number_of_entry_points);
+    ABTS_STR_EQUAL(tc, "https://example.com/new.mpd", result.entry_points[0].media_player_entry);
+    ABTS_INT_EQUAL(tc, 0, result.other_entry_points);
+
+    msaf_consumption_statistics_free(statistics);
+}
+
+static void test_consumption_statistics_unique_clients(abts_case *tc, void *data)
+{
+    msaf_consumption_statistics_t *statistics;
+    msaf_consumption_statistics_result_t result;
+    char client_id[32];
+    int i;
+
+    statistics = msaf_consumption_statistics_new();
+
+    /* 5000 clients each reporting twice, spread across the window */
+    for (i = 0; i < 10000; i++) {
+        sprintf(client_id, "client-%i", i % 5000);
+        _add_report(statistics, client_id, "https://example.com/a.mpd", 1, 1,
+                    TEST_START + ogs_time_from_sec(i % MSAF_CONSUMPTION_STATISTICS_WINDOW_SECONDS));
+    }
+
+    msaf_consumption_statistics_query(statistics, TEST_START + ogs_time_from_sec(MSAF_CONSUMPTION_STATISTICS_WINDOW_SECONDS - 1), 0,
+                                      &result);
+    ABTS_INT_EQUAL(tc, 10000, result.reports);
+    /* allow three standard errors */
+    ABTS_TRUE(tc, result.clients > 3600 && result.clients < 6400);
+    ABTS_TRUE(tc, result.sessions > 3600 && result.sessions < 6400);
+
+    msaf_consumption_statistics_free(statistics);
+}
+
+static struct {
+    void (*func)(abts_case *tc, void *data);
+} test_cases[] = {
+    {test_consumption_statistics_window},
+    {test_consumption_statistics_entry_points},
+    {test_consumption_statistics_unique_clients}
+};
+
+abts_suite *test_consumption_statistics(abts_suite *suite)
+{
+    int i;
+
+    suite = ADD_SUITE(suite)
+
+    for (i=0; i<(sizeof(test_cases)/sizeof(test_cases[0])); i++) {
+        abts_run_test(suite, test_cases[i].func, NULL);
+    }
+
+    return suite;
+}
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
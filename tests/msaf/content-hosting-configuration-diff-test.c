@@ -0,0 +1,230 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Author: David Waring
+ * Copyright: (C) 2024 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+/* System includes */
+#include <string.h>
+
+/* Open5GS includes */
+#include "test-common.h"
+
+/* MSAF includes */
+#include "content-hosting-configuration-diff.h"
+#include "json-reader.h"
+#include "openapi/model/msaf_api_content_hosting_configuration.h"
+
+/* Test includes */
+#include "content-hosting-configuration-diff-test.h"
+
+#define ABTS_PTR_NULL(a, b) ABTS_PTR_EQUAL(a, b, NULL)
+#define ABTS_FALSE(a, b) ABTS_TRUE(a, !(b))
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+#define CHC_START(name) \
+    "{\"name\": \"" name "\"," \
+    " \"ingestConfiguration\": {\"pull\": true, \"protocol\": \"urn:3gpp:5gms:content-protocol:http-pull-ingest\"," \
+    " \"baseURL\": \"https://origin.example.com/\"}," \
+    " \"distributionConfigurations\": ["
+#define CHC_END "]}"
+
+/* distribution configurations as they are with the generated fields filled in */
+#define DIST_DASH \
+    "{\"canonicalDomainName\": \"as.example.com\", \"baseURL\": \"https://as.example.com/m4d/provisioning-session-1/\"," \
+    " \"entryPoint\": {\"relativePath\": \"manifest.mpd\", \"contentType\": \"application/dash+xml\"," \
+    " \"profiles\": [\"urn:mpeg:dash:profile:isoff-live:2011\"]}, \"certificateId\": \"cert-1\"}"
+#define DIST_HLS \
+    "{\"canonicalDomainName\": \"as.example.com\", \"baseURL\": \"http://as.example.com/m4d/provisioning-session-1/\"," \
+    " \"entryPoint\": {\"relativePath\": \"index.m3u8\", \"contentType\": \"application/vnd.apple.mpegurl\"}," \
+    " \"pathRewriteRules\": [{\"requestPathPattern\": \"^/old/\", \"mappedPath\": \"/new/\"}]}"
+#define DIST_HLS_NEW_RULE \
+    "{\"canonicalDomainName\": \"as.example.com\", \"baseURL\": \"http://as.example.com/m4d/provisioning-session-1/\"," \
+    " \"entryPoint\": {\"relativePath\": \"index.m3u8\", \"contentType\": \"application/vnd.apple.mpegurl\"}," \
+    " \"pathRewriteRules\": [{\"requestPathPattern\": \"^/old/\", \"mappedPath\": \"/newer/\"}]}"
+#define DIST_HLS_NEW_ENTRY_POINT \
+    "{\"canonicalDomainName\": \"as.example.com\", \"baseURL\": \"http://as.example.com/m4d/provisioning-session-1/\"," \
+    " \"entryPoint\": {\"relativePath\": \"master.m3u8\", \"contentType\": \"application/vnd.apple.mpegurl\"}," \
+    " \"pathRewriteRules\": [{\"requestPathPattern\": \"^/old/\", \"mappedPath\": \"/new/\"}]}"
+#define DIST_NO_ENTRY_POINT \
+    "{\"canonicalDomainName\": \"as.example.com\", \"baseURL\": \"https://as.example.com/m4d/provisioning-session-1/\"," \
+    " \"certificateId\": \"cert-2\"}"
+
+static msaf_api_content_hosting_configuration_t *_parse_chc(abts_case *tc, const char *doc)
+{
+    msaf_json_reader_t reader;
+    msaf_api_content_hosting_configuration_t *chc;
+    const char *reason = NULL;
+
+    msaf_json_reader_init(&reader, doc, strlen(doc));
+    msaf_json_reader_next(&reader);
+
+    chc = msaf_api_content_hosting_configuration_parseResponseFromJSONReader(&reader, &reason);
+    ABTS_PTR_NOTNULL(tc, chc);
+
+    return chc;
+}
+
+static void _diff(abts_case *tc, msaf_content_hosting_configuration_diff_t *diff, const char *old_doc, const char *new_doc)
+{
+    msaf_api_content_hosting_configuration_t *old_chc = old_doc?_parse_chc(tc, old_doc):NULL;
+    msaf_api_content_hosting_configuration_t *new_chc = new_doc?_parse_chc(tc, new_doc):NULL;
+
+    msaf_content_hosting_configuration_diff(diff, old_chc, new_chc);
+    msaf_content_hosting_configuration_diff_log(diff, "provisioning-session-1");
+
+    if (old_chc) msaf_api_content_hosting_configuration_free(old_chc);
+    if (new_chc) msaf_api_content_hosting_configuration_free(new_chc);
+}
+
+static void test_chc_diff_unchanged(abts_case *tc, void *data)
+{
+    msaf_content_hosting_configuration_diff_t diff;
+
+    _diff(tc, &diff, CHC_START("Test") DIST_DASH "," DIST_HLS CHC_END, CHC_START("Test") DIST_DASH "," DIST_HLS CHC_END);
+    ABTS_FALSE(tc, diff.changed);
+    ABTS_FALSE(tc, diff.distributions_changed);
+    ABTS_FALSE(tc, diff.entry_points_changed);
+    ABTS_FALSE(tc, diff.certificates_added);
+    ABTS_FALSE(tc, diff.path_rewrite_rules_changed);
+
+    /* whitespace in the request makes no difference */
+    _diff(tc, &diff, CHC_START("Test") DIST_DASH CHC_END, "\n" CHC_START("Test") "  " DIST_DASH "\n" CHC_END "\n");
+    ABTS_FALSE(tc, diff.changed);
+
+    _diff(tc, &diff, NULL, NULL);
+    ABTS_FALSE(tc, diff.changed);
+}
+
+static void test_chc_diff_name(abts_case *tc, void *data)
+{
+    msaf_content_hosting_configuration_diff_t diff;
+
+    /* a change outside of the distributions still needs sending to the Application Servers, but not the SAI */
+    _diff(tc, &diff, CHC_START("Test") DIST_DASH "," DIST_HLS CHC_END, CHC_START("Renamed") DIST_DASH "," DIST_HLS CHC_END);
+    ABTS_TRUE(tc, diff.changed);
+    ABTS_FALSE(tc, diff.distributions_changed);
+    ABTS_INT_EQUAL(tc, 2, diff.distributions_unchanged);
+    ABTS_INT_EQUAL(tc, 0, diff.distributions_added);
+    ABTS_INT_EQUAL(tc, 0, diff.distributions_removed);
+    ABTS_FALSE(tc, diff.entry_points_changed);
+    ABTS_FALSE(tc, diff.certificates_added);
+    ABTS_FALSE(tc, diff.certificates_removed);
+    ABTS_FALSE(tc, diff.path_rewrite_rules_changed);
+}
+
+static void test_chc_diff_distributions(abts_case *tc, void *data)
+{
+    msaf_content_hosting_configuration_diff_t diff;
+
+    /* a distribution without an entry point is not in the SAI */
+    _diff(tc, &diff, CHC_START("Test") DIST_DASH CHC_END, CHC_START("Test") DIST_DASH "," DIST_NO_ENTRY_POINT CHC_END);
+    ABTS_TRUE(tc, diff.changed);
+    ABTS_TRUE(tc, diff.distributions_changed);
+    ABTS_INT_EQUAL(tc, 1, diff.distributions_unchanged);
+    ABTS_INT_EQUAL(tc, 1, diff.distributions_added);
+    ABTS_INT_EQUAL(tc, 0, diff.distributions_removed);
+    ABTS_FALSE(tc, diff.entry_points_changed);
+    ABTS_TRUE(tc, diff.certificates_added);
+    ABTS_FALSE(tc, diff.certificates_removed);
+    ABTS_FALSE(tc, diff.path_rewrite_rules_changed);
+
+    _diff(tc, &diff, CHC_START("Test") DIST_DASH "," DIST_NO_ENTRY_POINT CHC_END, CHC_START("Test") DIST_DASH CHC_END);
+    ABTS_TRUE(tc, diff.changed);
+    ABTS_INT_EQUAL(tc, 1, diff.distributions_unchanged);
+    ABTS_INT_EQUAL(tc, 0, diff.distributions_added);
+    ABTS_INT_EQUAL(tc, 1, diff.distributions_removed);
+    ABTS_FALSE(tc, diff.entry_points_changed);
+    ABTS_FALSE(tc, diff.certificates_added);
+    ABTS_TRUE(tc, diff.certificates_removed);
+
+    /* moved distributions are matched wherever they are, but the entry points are offered in a different order */
+    _diff(tc, &diff, CHC_START("Test") DIST_DASH "," DIST_HLS CHC_END, CHC_START("Test") DIST_HLS "," DIST_DASH CHC_END);
+    ABTS_TRUE(tc, diff.changed);
+    ABTS_TRUE(tc, diff.distributions_changed);
+    ABTS_INT_EQUAL(tc, 2, diff.distributions_unchanged);
+    ABTS_INT_EQUAL(tc, 0, diff.distributions_added);
+    ABTS_INT_EQUAL(tc, 0, diff.distributions_removed);
+    ABTS_TRUE(tc, diff.entry_points_changed);
+    ABTS_FALSE(tc, diff.certificates_added);
+    ABTS_TRUE(tc, diff.path_rewrite_rules_changed);
+
+    /* everything is new for a first configuration */
+    _diff(tc, &diff, NULL, CHC_START("Test") DIST_DASH "," DIST_HLS CHC_END);
+    ABTS_TRUE(tc, diff.changed);
+    ABTS_INT_EQUAL(tc, 2, diff.distributions_added);
+    ABTS_INT_EQUAL(tc, 0, diff.distributions_unchanged);
+    ABTS_TRUE(tc, diff.entry_points_changed);
+    ABTS_TRUE(tc, diff.certificates_added);
+    ABTS_TRUE(tc, diff.path_rewrite_rules_changed);
+}
+
+static void test_chc_diff_entry_points(abts_case *tc, void *data)
+{
+    msaf_content_hosting_configuration_diff_t diff;
+
+    _diff(tc, &diff, CHC_START("Test") DIST_DASH "," DIST_HLS CHC_END,
+                     CHC_START("Test") DIST_DASH "," DIST_HLS_NEW_ENTRY_POINT CHC_END);
+    ABTS_TRUE(tc, diff.changed);
+    ABTS_TRUE(tc, diff.distributions_changed);
+    ABTS_INT_EQUAL(tc, 1, diff.distributions_unchanged);
+    ABTS_INT_EQUAL(tc, 1, diff.distributions_added);
+    ABTS_INT_EQUAL(tc, 1, diff.distributions_removed);
+    ABTS_TRUE(tc, diff.entry_points_changed);
+    ABTS_FALSE(tc, diff.certificates_added);
+    ABTS_FALSE(tc, diff.path_rewrite_rules_changed);
+}
+
+static void test_chc_diff_path_rewrite_rules(abts_case *tc, void *data)
+{
+    msaf_content_hosting_configuration_diff_t diff;
+
+    /* only the Application Servers use the path rewrite rules */
+    _diff(tc, &diff, CHC_START("Test") DIST_DASH "," DIST_HLS CHC_END,
+                     CHC_START("Test") DIST_DASH "," DIST_HLS_NEW_RULE CHC_END);
+    ABTS_TRUE(tc, diff.changed);
+    ABTS_TRUE(tc, diff.distributions_changed);
+    ABTS_INT_EQUAL(tc, 1, diff.distributions_added);
+    ABTS_INT_EQUAL(tc, 1, diff.distributions_removed);
+    ABTS_FALSE(tc, diff.entry_points_changed);
+    ABTS_FALSE(tc, diff.certificates_added);
+    ABTS_FALSE(tc, diff.certificates_removed);
+    ABTS_TRUE(tc, diff.path_rewrite_rules_changed);
+}
+
+static struct {
+    void (*func)(abts_case *tc, void *data);
+} test_cases[] = {
+    {test_chc_diff_unchanged},
+    {test_chc_diff_name},
+    {test_chc_diff_distributions},
+    {test_chc_diff_entry_points},
+    {test_chc_diff_path_rewrite_rules}
+};
+
+abts_suite *test_content_hosting_configuration_diff(abts_suite *suite)
+{
+    int i;
+
+    suite = ADD_SUITE(suite)
+
+    for (i=0; i<(sizeof(test_cases)/sizeof(test_cases[0])); i++) {
+        abts_run_test(suite, test_cases[i].func, NULL);
+    }
+
+    return suite;
+}
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
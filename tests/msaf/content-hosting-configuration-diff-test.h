@@ -0,0 +1,30 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Author: David Waring
+ * Copyright: (C) 2024 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#ifndef _TESTS_MSAF_CONTENT_HOSTING_CONFIGURATION_DIFF_TEST_H
+#define _TESTS_MSAF_CONTENT_HOSTING_CONFIGURATION_DIFF_TEST_H
+
+/* Open5GS includes */
+#include "test-common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+abts_suite *test_content_hosting_configuration_diff(abts_suite *suite);
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+#endif /* ifndef _TESTS_MSAF_CONTENT_HOSTING_CONFIGURATION_DIFF_TEST_H */
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
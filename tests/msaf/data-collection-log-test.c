@@ -0,0 +1,386 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Author: David Waring
+ * Copyright: (C) 2024 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+/* System includes */
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Open5GS includes */
+#include "test-common.h"
+
+/* MSAF includes */
+#include "data-collection-log.h"
+
+/* Test includes */
+#include "data-collection-log-test.h"
+
+#define ABTS_PTR_NULL(a, b) ABTS_PTR_EQUAL(a, b, NULL)
+#define ABTS_FALSE(a, b) ABTS_TRUE(a, !(b))
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+static const char *test_report = "{\"reportingClientId\":\"client-1\",\"consumptionReportingUnits\":[]}";
+
+/* Temporary data collection root for a test, removed by _remove_tree() */
+static char *_make_root(void)
+{
+    char *root = ogs_strdup("/tmp/msaf-data-collection-log-XXXXXX");
+    ogs_assert(mkdtemp(root));
+    return root;
+}
+
+static void _remove_tree(const char *path)
+{
+    DIR *dir;
+    struct dirent *entry;
+
+    dir = opendir(path);
+    if (dir) {
+        while ((entry = readdir(dir)) != NULL) {
+            char *child;
+            if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) continue;
+            child = ogs_msprintf("%s/%s", path, entry->d_name);
+            _remove_tree(child);
+            ogs_free(child);
+        }
+        closedir(dir);
+        rmdir(path);
+    } else {
+        unlink(path);
+    }
+}
+
+static int _compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/* Sorted segment paths in directory, returns the number found */
+static int _list_segments(const char *directory, char **segments, int max_segments)
+{
+    DIR *dir;
+    struct dirent *entry;
+    int count = 0;
+    int i;
+
+    dir = opendir(directory);
+    if (!dir) return 0;
+    while ((entry = readdir(dir)) != NULL && count < max_segments) {
+        size_t len = strlen(entry->d_name);
+        if (len > strlen(MSAF_DATA_COLLECTION_LOG_SEGMENT_SUFFIX) &&
+            !strcmp(entry->d_name + len - strlen(MSAF_DATA_COLLECTION_LOG_SEGMENT_SUFFIX), MSAF_DATA_COLLECTION_LOG_SEGMENT_SUFFIX)) {
+            segments[count++] = ogs_strdup(entry->d_name);
+        }
+    }
+    closedir(dir);
+
+    qsort(segments, count, sizeof(segments[0]), _compare_names);
+    for (i = 0; i < count; i++) {
+        char *path = ogs_msprintf("%s/%s", directory, segments[i]);
+        ogs_free(segments[i]);
+        segments[i] = path;
+    }
+
+    return count;
+}
+
+static void _free_segments(char **segments, int count)
+{
+    int i;
+    for (i = 0; i < count; i++) ogs_free(segments[i]);
+}
+
+static void test_data_collection_log_append_read(abts_case *tc, void *data)
+{
+    /* records are read back in order with their metadata */
+    static const msaf_data_collection_log_config_t config = {0, 0, MSAF_DATA_COLLECTION_LOG_FSYNC_NONE};
+    msaf_data_collection_log_t *log;
+    msaf_data_collection_log_reader_t *reader;
+    msaf_data_collection_log_record_t record;
+    char *root, *directory;
+    char *segments[4];
+    int count;
+
+    root = _make_root();
+    log = msaf_data_collection_log_new(root, &config);
+    ABTS_PTR_NOTNULL(tc, log);
+
+    ABTS_TRUE(tc, msaf_data_collection_log_append(log, "ps-1", "consumption_reports", "client-1", NULL,
+                                                  "2024-06-01T12:00:00.000000Z", "json", test_report, strlen(test_report)));
+    /* bodies may contain newlines and the field separators */
+    ABTS_TRUE(tc, msaf_data_collection_log_append(log, "ps-1", "consumption_reports", "client 2", "session-2",
+                                                  "2024-06-01T12:00:00.000000Z", "xml", "<a>\n MSAFREC1 1 1\n</a>", 22));
+    ABTS_TRUE(tc, msaf_data_collection_log_append(log, "ps-2", "consumption_reports", "client-3", NULL,
+                                                  "2024-06-01T12:00:01.000000Z", "json", test_report, strlen(test_report)));
+    msaf_data_collection_log_free(log);
+
+    directory = ogs_msprintf("%s/ps-1/consumption_reports", root);
+    count = _list_segments(directory, segments, 4);
+    ABTS_INT_EQUAL(tc, 1, count);
+
+    reader = msaf_data_collection_log_reader_open(segments[0]);
+    ABTS_PTR_NOTNULL(tc, reader);
+    ABTS_INT_EQUAL(tc, OGS_OK, msaf_data_collection_log_reader_next(reader, &record));
+    ABTS_STR_EQUAL(tc, "client-1", record.client_id);
+    ABTS_PTR_NULL(tc, record.session_id);
+    ABTS_STR_EQUAL(tc, "2024-06-01T12:00:00.000000Z", record.report_time);
+    ABTS_STR_EQUAL(tc, "json", record.format);
+    ABTS_INT_EQUAL(tc, strlen(test_report), record.body_len);
+    ABTS_STR_EQUAL(tc, test_report, record.body);
+
+    ABTS_INT_EQUAL(tc, OGS_OK, msaf_data_collection_log_reader_next(reader, &record));
+    ABTS_STR_EQUAL(tc, "client 2", record.client_id);
+    ABTS_STR_EQUAL(tc, "session-2", record.session_id);
+    ABTS_STR_EQUAL(tc, "xml", record.format);
+    ABTS_STR_EQUAL(tc, "<a>\n MSAFREC1 1 1\n</a>", record.body);
+
+    ABTS_INT_EQUAL(tc, OGS_DONE, msaf_data_collection_log_reader_next(reader, &record));
+    msaf_data_collection_log_reader_close(reader);
+
+    _free_segments(segments, count);
+    ogs_free(directory);
+
+    /* each provisioning session has its own segments */
+    directory = ogs_msprintf("%s/ps-2/consumption_reports", root);
+    count = _list_segments(directory, segments, 4);
+    ABTS_INT_EQUAL(tc, 1, count);
+    _free_segments(segments, count);
+    ogs_free(directory);
+
+    _remove_tree(root);
+    ogs_free(root);
+}
+
+static void test_data_collection_log_rotate(abts_case *tc, void *data)
+{
+    /* segments are rotated by size and when a provisioning session is closed */
+    msaf_data_collection_log_config_t config = {0, 0, MSAF_DATA_COLLECTION_LOG_FSYNC_ROTATE};
+    msaf_data_collection_log_t *log;
+    msaf_data_collection_log_reader_t *reader;
+    msaf_data_collection_log_record_t record;
+    char *root, *directory;
+    char *segments[16];
+    char client_id[16];
+    int count, records;
+    int i;
+
+    root = _make_root();
+    /* room for two test reports in each segment */
+    config.segment_max_size = 2 * (strlen(test_report) + 100);
+    log = msaf_data_collection_log_new(root, &config);
+
+    for (i = 0; i < 6; i++) {
+        sprintf(client_id, "client-%i", i);
+        ABTS_TRUE(tc, msaf_data_collection_log_append(log, "ps-1", "consumption_reports", client_id, NULL,
+                                                      "2024-06-01T12:00:00.000000Z", "json", test_report, strlen(test_report)));
+    }
+
+    directory = ogs_msprintf("%s/ps-1/consumption_reports", root);
+    count = _list_segments(directory, segments, 16);
+    ABTS_INT_EQUAL(tc, 3, count);
+    _free_segments(segments, count);
+
+    msaf_data_collection_log_close_provisioning_session(log, "ps-1");
+    ABTS_TRUE(tc, msaf_data_collection_log_append(log, "ps-1", "consumption_reports", "client-6", NULL,
+                                                  "2024-06-01T12:00:00.000000Z", "json", test_report, strlen(test_report)));
+    msaf_data_collection_log_free(log);
+
+    /* the segments hold every report, in order */
+    count = _list_segments(directory, segments, 16);
+    ABTS_INT_EQUAL(tc, 4, count);
+    records = 0;
+    for (i = 0; i < count; i++) {
+        reader = msaf_data_collection_log_reader_open(segments[i]);
+        ABTS_PTR_NOTNULL(tc, reader);
+        while (msaf_data_collection_log_reader_next(reader, &record) == OGS_OK) {
+            sprintf(client_id, "client-%i", records++);
+            ABTS_STR_EQUAL(tc, client_id, record.client_id);
+        }
+        msaf_data_collection_log_reader_close(reader);
+    }
+    ABTS_INT_EQUAL(tc, 7, records);
+    _free_segments(segments, count);
+
+    ogs_free(directory);
+    _remove_tree(root);
+    ogs_free(root);
+}
+
+static void test_data_collection_log_truncated(abts_case *tc, void *data)
+{
+    /* a partly written record at the end of a segment is reported as an error */
+    static const msaf_data_collection_log_config_t config = {0, 0, MSAF_DATA_COLLECTION_LOG_FSYNC_NONE};
+    msaf_data_collection_log_t *log;
+    msaf_data_collection_log_reader_t *reader;
+    msaf_data_collection_log_record_t record;
+    char *root, *directory;
+    char *segments[4];
+    FILE *fp;
+    int count;
+
+    root = _make_root();
+    log = msaf_data_collection_log_new(root, &config);
+    ABTS_TRUE(tc, msaf_data_collection_log_append(log, "ps-1", "consumption_reports", "client-1", NULL,
+                                                  "2024-06-01T12:00:00.000000Z", "json", test_report, strlen(test_report)));
+    msaf_data_collection_log_free(log);
+
+    directory = ogs_msprintf("%s/ps-1/consumption_reports", root);
+    count = _list_segments(directory, segments, 4);
+    ABTS_INT_EQUAL(tc, 1, count);
+
+    fp = fopen(segments[0], "a");
+    ABTS_PTR_NOTNULL(tc, fp);
+    fprintf(fp, "%s 8 0 27 4 1000\nclient-2\n\n2024-06-01T12:00:00.000000Z\njson\n{\"partial\"", MSAF_DATA_COLLECTION_LOG_RECORD_MAGIC);
+    fclose(fp);
+
+    reader = msaf_data_collection_log_reader_open(segments[0]);
+    ABTS_INT_EQUAL(tc, OGS_OK, msaf_data_collection_log_reader_next(reader, &record));
+    ABTS_STR_EQUAL(tc, "client-1", record.client_id);
+    ABTS_INT_EQUAL(tc, OGS_ERROR, msaf_data_collection_log_reader_next(reader, &record));
+    msaf_data_collection_log_reader_close(reader);
+
+    _free_segments(segments, count);
+    ogs_free(directory);
+    _remove_tree(root);
+    ogs_free(root);
+}
+
+static void test_data_collection_log_batch(abts_case *tc, void *data)
+{
+    /* records appended in a batch are only written when the batch ends, and then read back in order */
+    static const msaf_data_collection_log_config_t config = {0, 0, MSAF_DATA_COLLECTION_LOG_FSYNC_ALWAYS};
+    msaf_data_collection_log_t *log;
+    msaf_data_collection_log_reader_t *reader;
+    msaf_data_collection_log_record_t record;
+    char *root, *directory;
+    char *segments[4];
+    char client_id[32];
+    int count, records;
+    int i;
+
+    root = _make_root();
+    log = msaf_data_collection_log_new(root, &config);
+
+    msaf_data_collection_log_batch_begin(log);
+    for (i = 0; i < 10; i++) {
+        sprintf(client_id, "client-%i", i);
+        ABTS_TRUE(tc, msaf_data_collection_log_append(log, "ps-1", "metrics_report_mrc-1", client_id, "session-1",
+                                                      "2024-06-01T12:00:00.000000Z", "xml", "<report/>", 9));
+    }
+
+    /* nothing has reached the segment yet */
+    directory = ogs_msprintf("%s/ps-1/metrics_report_mrc-1", root);
+    count = _list_segments(directory, segments, 4);
+    ABTS_INT_EQUAL(tc, 1, count);
+    reader = msaf_data_collection_log_reader_open(segments[0]);
+    ABTS_PTR_NOTNULL(tc, reader);
+    ABTS_INT_EQUAL(tc, OGS_DONE, msaf_data_collection_log_reader_next(reader, &record));
+    msaf_data_collection_log_reader_close(reader);
+
+    ABTS_INT_EQUAL(tc, 0, msaf_data_collection_log_batch_end(log));
+
+    reader = msaf_data_collection_log_reader_open(segments[0]);
+    ABTS_PTR_NOTNULL(tc, reader);
+    records = 0;
+    while (msaf_data_collection_log_reader_next(reader, &record) == OGS_OK) {
+        sprintf(client_id, "client-%i", records++);
+        ABTS_STR_EQUAL(tc, client_id, record.client_id);
+        ABTS_STR_EQUAL(tc, "session-1", record.session_id);
+        ABTS_STR_EQUAL(tc, "<report/>", record.body);
+    }
+    msaf_data_collection_log_reader_close(reader);
+    ABTS_INT_EQUAL(tc, 10, records);
+    _free_segments(segments, count);
+
+    msaf_data_collection_log_free(log);
+
+    ogs_free(directory);
+    _remove_tree(root);
+    ogs_free(root);
+}
+
+#define DATA_COLLECTION_LOG_BENCH_REPORTS 10000
+
+static void test_data_collection_log_benchmark(abts_case *tc, void *data)
+{
+    /* appending to a segment avoids creating a file for every report */
+    static const msaf_data_collection_log_config_t config = {MSAF_DATA_COLLECTION_LOG_DEFAULT_SEGMENT_MAX_SIZE, 0,
+                                                             MSAF_DATA_COLLECTION_LOG_FSYNC_ROTATE};
+    msaf_data_collection_log_t *log;
+    struct timespec start, end;
+    char *root, *directory;
+    char *segments[4];
+    char client_id[32];
+    long long ns;
+    int count;
+    int i;
+
+    root = _make_root();
+    log = msaf_data_collection_log_new(root, &config);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < DATA_COLLECTION_LOG_BENCH_REPORTS; i++) {
+        sprintf(client_id, "client-%i", i);
+        if (!msaf_data_collection_log_append(log, "ps-1", "consumption_reports", client_id, NULL,
+                                             "2024-06-01T12:00:00.000000Z", "json", test_report, strlen(test_report))) {
+            ABTS_FAIL(tc, "Failed to append report");
+            break;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    msaf_data_collection_log_free(log);
+
+    ns = ((end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec)) / DATA_COLLECTION_LOG_BENCH_REPORTS;
+    ogs_info("Report log append: %lld ns/report", ns);
+
+    directory = ogs_msprintf("%s/ps-1/consumption_reports", root);
+    count = _list_segments(directory, segments, 4);
+    ABTS_INT_EQUAL(tc, 1, count);
+    _free_segments(segments, count);
+    ogs_free(directory);
+
+    _remove_tree(root);
+    ogs_free(root);
+}
+
+static struct {
+    void (*func)(abts_case *tc, void *data);
+} test_cases[] = {
+    {test_data_collection_log_append_read},
+    {test_data_collection_log_rotate},
+    {test_data_collection_log_truncated},
+    {test_data_collection_log_batch},
+    {test_data_collection_log_benchmark}
+};
+
+abts_suite *test_data_collection_log(abts_suite *suite)
+{
+    int i;
+
+    suite = ADD_SUITE(suite)
+
+    for (i=0; i<(sizeof(test_cases)/sizeof(test_cases[0])); i++) {
+        abts_run_test(suite, test_cases[i].func, NULL);
+    }
+
+    return suite;
+}
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
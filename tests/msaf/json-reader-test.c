@@ -0,0 +1,286 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Author: David Waring
+ * Copyright: (C) 2024 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+/* System includes */
+#include <string.h>
+#include <time.h>
+
+/* Open5GS includes */
+#include "test-common.h"
+
+/* MSAF includes */
+#include "json-reader.h"
+#include "openapi/model/msaf_api_consumption_report.h"
+
+/* Test includes */
+#include "json-reader-test.h"
+
+#define ABTS_PTR_NULL(a, b) ABTS_PTR_EQUAL(a, b, NULL)
+#define ABTS_FALSE(a, b) ABTS_TRUE(a, !(b))
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+static const char *test_report =
+    "{\"mediaPlayerEntry\": \"https://example.com/m4d/provisioning-session-1/manifest.mpd\","
+    " \"reportingClientId\": \"client-1\","
+    " \"consumptionReportingUnits\": ["
+    "{\"mediaConsumed\": \"video-1\", \"mediaEndpointAddress\": {\"ipv4Addr\": \"192.0.2.1\", \"portNumbers\": [443]},"
+    " \"startTime\": \"2024-06-01T12:00:00Z\", \"duration\": 30},"
+    " {\"mediaConsumed\": \"audio-1\", \"startTime\": \"2024-06-01T12:00:00Z\", \"duration\": 30}]}";
+
+/* Documents that are well formed JSON but not valid ConsumptionReports, each with a single problem */
+static const char *invalid_reports[] = {
+    "[]",
+    "{}",
+    "{\"mediaPlayerEntry\": \"m\", \"consumptionReportingUnits\": []}",
+    "{\"mediaPlayerEntry\": 1, \"reportingClientId\": \"c\", \"consumptionReportingUnits\": []}",
+    "{\"mediaPlayerEntry\": \"m\", \"reportingClientId\": \"c\", \"consumptionReportingUnits\": {}}",
+    "{\"mediaPlayerEntry\": \"m\", \"reportingClientId\": \"c\", \"consumptionReportingUnits\": [1]}",
+    "{\"mediaPlayerEntry\": \"m\", \"reportingClientId\": \"c\", \"consumptionReportingUnits\": [{}]}",
+    "{\"mediaPlayerEntry\": \"m\", \"reportingClientId\": \"c\", \"consumptionReportingUnits\": "
+        "[{\"mediaConsumed\": \"v\", \"startTime\": \"2024-06-01T12:00:00Z\", \"duration\": \"30\"}]}",
+    "{\"mediaPlayerEntry\": \"m\", \"reportingClientId\": \"c\", \"consumptionReportingUnits\": "
+        "[{\"mediaConsumed\": \"v\", \"startTime\": 0, \"duration\": 30}]}",
+    "{\"mediaPlayerEntry\": \"m\", \"reportingClientId\": \"c\", \"consumptionReportingUnits\": "
+        "[{\"mediaConsumed\": 1, \"startTime\": \"2024-06-01T12:00:00Z\", \"duration\": 30}]}"
+};
+
+/* Table as generated by hash_model_fields.py, checks that it agrees with msaf_json_field_hash() */
+static const char * const test_field_names[] = {
+    "name",
+    "count",
+    "enabled",
+    "state",
+    "child",
+    "tags",
+    "children",
+    "labels",
+    "secret",
+    "kind",
+    "kinds",
+    "extra",
+    NULL
+};
+static const uint8_t test_field_slots[32] = {
+    0, 0, 0, 0, 0, 0, 0, 5, 11, 10, 1, 0, 0, 8, 0, 3,
+    0, 0, 0, 0, 2, 0, 0, 0, 4, 0, 9, 7, 0, 0, 6, 12
+};
+static const msaf_json_field_table_t test_fields_hashed = MSAF_JSON_FIELD_TABLE_HASHED(test_field_names, test_field_slots, 0x0000001fu, 31);
+static const msaf_json_field_table_t test_fields = MSAF_JSON_FIELD_TABLE(test_field_names);
+
+static int _field(const msaf_json_field_table_t *table, const char *doc)
+{
+    msaf_json_reader_t reader;
+
+    msaf_json_reader_init(&reader, doc, strlen(doc));
+    if (msaf_json_reader_next(&reader) != MSAF_JSON_TOKEN_OBJECT_START) return -1;
+    if (msaf_json_reader_next(&reader) != MSAF_JSON_TOKEN_KEY) return -1;
+
+    return msaf_json_reader_field(&reader, table);
+}
+
+static msaf_api_consumption_report_t *_parse_reader(const char *doc, const char **reason, bool *syntax_error)
+{
+    msaf_json_reader_t reader;
+    msaf_api_consumption_report_t *report;
+
+    msaf_json_reader_init(&reader, doc, strlen(doc));
+    msaf_json_reader_next(&reader);
+    report = msaf_api_consumption_report_parseRequestFromJSONReader(&reader, reason);
+    if (report && msaf_json_reader_next(&reader) != MSAF_JSON_TOKEN_END) {
+        msaf_api_consumption_report_free(report);
+        report = NULL;
+    }
+    *syntax_error = (reader.error != NULL);
+
+    return report;
+}
+
+static void test_json_reader_fields(abts_case *tc, void *data)
+{
+    static const msaf_json_field_table_t *tables[] = {&test_fields, &test_fields_hashed};
+    int i;
+
+    for (i = 0; i < sizeof(tables)/sizeof(tables[0]); i++) {
+        const msaf_json_field_table_t *table = tables[i];
+        int field;
+
+        for (field = 1; test_field_names[field-1]; field++) {
+            char *doc = ogs_msprintf("{\"%s\": null}", test_field_names[field-1]);
+            ABTS_INT_EQUAL(tc, field, _field(table, doc));
+            ogs_free(doc);
+        }
+
+        ABTS_INT_EQUAL(tc, 1, _field(table, "{\"na\\u006de\": 1}"));
+        ABTS_INT_EQUAL(tc, 11, _field(table, "{\"kind\\u0073\": 1}"));
+        ABTS_INT_EQUAL(tc, 0, _field(table, "{\"nam\": 1}"));
+        ABTS_INT_EQUAL(tc, 0, _field(table, "{\"names\": 1}"));
+        ABTS_INT_EQUAL(tc, 0, _field(table, "{\"Name\": 1}"));
+        ABTS_INT_EQUAL(tc, 0, _field(table, "{\"\": 1}"));
+    }
+}
+
+static void test_json_reader_cjson(abts_case *tc, void *data)
+{
+    static const char *doc = "{\"a\": [1, -2.5e3, \"x\\u00e9\", true, false, null, {}], \"b\": {\"c\": []}, \"\\u0064\": \"e\"}";
+    msaf_json_reader_t reader;
+    cJSON *expected, *json;
+
+    expected = cJSON_Parse(doc);
+    ABTS_PTR_NOTNULL(tc, expected);
+
+    msaf_json_reader_init(&reader, doc, strlen(doc));
+    msaf_json_reader_next(&reader);
+    json = msaf_json_reader_cjson(&reader);
+    ABTS_PTR_NOTNULL(tc, json);
+    ABTS_INT_EQUAL(tc, MSAF_JSON_TOKEN_END, msaf_json_reader_next(&reader));
+    ABTS_TRUE(tc, cJSON_Compare(expected, json, true));
+
+    cJSON_Delete(json);
+    cJSON_Delete(expected);
+
+    msaf_json_reader_init(&reader, "{\"a\": [1,]}", 11);
+    msaf_json_reader_next(&reader);
+    ABTS_PTR_NULL(tc, msaf_json_reader_cjson(&reader));
+    ABTS_PTR_NOTNULL(tc, reader.error);
+}
+
+static void test_json_reader_model(abts_case *tc, void *data)
+{
+    msaf_api_consumption_report_t *report, *expected;
+    const char *reason = NULL;
+    const char *expected_reason = NULL;
+    bool syntax_error;
+    cJSON *json;
+    int i;
+
+    /* a valid report gives the same model from both parsers */
+    json = cJSON_Parse(test_report);
+    expected = msaf_api_consumption_report_parseRequestFromJSON(json, &expected_reason);
+    cJSON_Delete(json);
+    ABTS_PTR_NOTNULL(tc, expected);
+
+    report = _parse_reader(test_report, &reason, &syntax_error);
+    ABTS_PTR_NOTNULL(tc, report);
+    ABTS_FALSE(tc, syntax_error);
+    ABTS_PTR_NULL(tc, reason);
+
+    if (report && expected) {
+        cJSON *expected_json = msaf_api_consumption_report_convertResponseToJSON(expected);
+        json = msaf_api_consumption_report_convertResponseToJSON(report);
+        ABTS_TRUE(tc, cJSON_Compare(expected_json, json, true));
+        cJSON_Delete(json);
+        cJSON_Delete(expected_json);
+    }
+    if (report) msaf_api_consumption_report_free(report);
+    if (expected) msaf_api_consumption_report_free(expected);
+
+    /* invalid reports give the same reason from both parsers */
+    for (i = 0; i < sizeof(invalid_reports)/sizeof(invalid_reports[0]); i++) {
+        reason = expected_reason = NULL;
+
+        json = cJSON_Parse(invalid_reports[i]);
+        ABTS_PTR_NOTNULL(tc, json);
+        expected = msaf_api_consumption_report_parseRequestFromJSON(json, &expected_reason);
+        cJSON_Delete(json);
+        ABTS_PTR_NULL(tc, expected);
+        if (expected) msaf_api_consumption_report_free(expected);
+
+        report = _parse_reader(invalid_reports[i], &reason, &syntax_error);
+        ABTS_PTR_NULL(tc, report);
+        if (report) msaf_api_consumption_report_free(report);
+        ABTS_FALSE(tc, syntax_error);
+
+        ABTS_PTR_NOTNULL(tc, reason);
+        ABTS_PTR_NOTNULL(tc, expected_reason);
+        if (reason && expected_reason) ABTS_STR_EQUAL(tc, expected_reason, reason);
+    }
+
+    /* syntax errors are reported as such, including after the report */
+    report = _parse_reader("{\"mediaPlayerEntry\": \"m\",}", &reason, &syntax_error);
+    ABTS_PTR_NULL(tc, report);
+    ABTS_TRUE(tc, syntax_error);
+
+    report = _parse_reader("{\"mediaPlayerEntry\": \"m\", \"reportingClientId\": \"c\", \"consumptionReportingUnits\": []} {}",
+                           &reason, &syntax_error);
+    ABTS_PTR_NULL(tc, report);
+    ABTS_TRUE(tc, syntax_error);
+}
+
+#define JSON_READER_BENCH_REPORTS 10000
+
+static void test_json_reader_benchmark(abts_case *tc, void *data)
+{
+    struct timespec start, end;
+    long long reader_ns, cjson_ns;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < JSON_READER_BENCH_REPORTS; i++) {
+        msaf_api_consumption_report_t *report;
+        const char *reason;
+        bool syntax_error;
+
+        report = _parse_reader(test_report, &reason, &syntax_error);
+        if (!report) {
+            ABTS_FAIL(tc, "Report not parsed");
+            break;
+        }
+        msaf_api_consumption_report_free(report);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    reader_ns = ((end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec)) / JSON_READER_BENCH_REPORTS;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < JSON_READER_BENCH_REPORTS; i++) {
+        cJSON *json = cJSON_Parse(test_report);
+        msaf_api_consumption_report_t *report;
+        const char *reason;
+
+        report = msaf_api_consumption_report_parseRequestFromJSON(json, &reason);
+        if (report) msaf_api_consumption_report_free(report);
+        cJSON_Delete(json);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    cjson_ns = ((end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec)) / JSON_READER_BENCH_REPORTS;
+
+    ogs_info("ConsumptionReport model parse: reader %lld ns/report, cJSON tree and parse %lld ns/report", reader_ns, cjson_ns);
+}
+
+static struct {
+    void (*func)(abts_case *tc, void *data);
+} test_cases[] = {
+    {test_json_reader_fields},
+    {test_json_reader_cjson},
+    {test_json_reader_model},
+    {test_json_reader_benchmark}
+};
+
+abts_suite *test_json_reader(abts_suite *suite)
+{
+    int i;
+
+    suite = ADD_SUITE(suite)
+
+    for (i=0; i<(sizeof(test_cases)/sizeof(test_cases[0])); i++) {
+        abts_run_test(suite, test_cases[i].func, NULL);
+    }
+
+    return suite;
+}
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
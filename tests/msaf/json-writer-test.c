@@ -0,0 +1,311 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Author: David Waring
+ * Copyright: (C) 2024 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+/* System includes */
+#include <string.h>
+#include <time.h>
+
+/* Open5GS includes */
+#include "test-common.h"
+
+/* MSAF includes */
+#include "json-format.h"
+#include "json-writer.h"
+#include "openapi/model/msaf_api_consumption_report.h"
+
+/* Test includes */
+#include "json-writer-test.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+static const char *test_document =
+    "{\"id\": \"session-1\", \"empty\": {}, \"none\": [], \"text\": \"quote \\\" back \\\\ tab \\t nl \\n bell \\u0007 \\u00e9\","
+    " \"numbers\": [0, -1, 2147483647, 0.5, 1e300, -2.25e-8, 3.14159265358979],"
+    " \"flags\": [true, false, null],"
+    " \"entries\": [{\"name\": \"a\", \"values\": [{}, []]}, {\"name\": \"b\", \"nested\": {\"deeper\": {\"x\": 1}}}]}";
+
+static const char *test_report =
+    "{\"mediaPlayerEntry\": \"https://example.com/m4d/provisioning-session-1/manifest.mpd\","
+    " \"reportingClientId\": \"client-1\","
+    " \"consumptionReportingUnits\": ["
+    "{\"mediaConsumed\": \"video-1\", \"mediaEndpointAddress\": {\"ipv4Addr\": \"192.0.2.1\", \"portNumbers\": [443]},"
+    " \"startTime\": \"2024-06-01T12:00:00Z\", \"duration\": 30},"
+    " {\"mediaConsumed\": \"audio-1\", \"startTime\": \"2024-06-01T12:00:00Z\", \"duration\": 30}]}";
+
+/* Hand written equivalent of test_document, excluding the numbers and text members */
+static bool _write_entries(msaf_json_writer_t *writer, const void *data)
+{
+    msaf_json_writer_object_start(writer);
+    msaf_json_writer_key(writer, "id");
+    msaf_json_writer_string(writer, (const char*)data);
+    msaf_json_writer_key(writer, "empty");
+    msaf_json_writer_object_start(writer);
+    msaf_json_writer_object_end(writer);
+    msaf_json_writer_key(writer, "none");
+    msaf_json_writer_array_start(writer);
+    msaf_json_writer_array_end(writer);
+    msaf_json_writer_key(writer, "flags");
+    msaf_json_writer_array_start(writer);
+    msaf_json_writer_bool(writer, true);
+    msaf_json_writer_bool(writer, false);
+    msaf_json_writer_string(writer, NULL);
+    msaf_json_writer_array_end(writer);
+    msaf_json_writer_key(writer, "entries");
+    msaf_json_writer_array_start(writer);
+    msaf_json_writer_object_start(writer);
+    msaf_json_writer_key(writer, "name");
+    msaf_json_writer_string(writer, "a");
+    msaf_json_writer_key(writer, "values");
+    msaf_json_writer_array_start(writer);
+    msaf_json_writer_object_start(writer);
+    msaf_json_writer_object_end(writer);
+    msaf_json_writer_array_start(writer);
+    msaf_json_writer_array_end(writer);
+    msaf_json_writer_array_end(writer);
+    msaf_json_writer_object_end(writer);
+    msaf_json_writer_object_start(writer);
+    msaf_json_writer_key(writer, "name");
+    msaf_json_writer_string(writer, "b");
+    msaf_json_writer_key(writer, "nested");
+    msaf_json_writer_object_start(writer);
+    msaf_json_writer_key(writer, "deeper");
+    msaf_json_writer_object_start(writer);
+    msaf_json_writer_key(writer, "x");
+    msaf_json_writer_number(writer, 1);
+    msaf_json_writer_object_end(writer);
+    msaf_json_writer_object_end(writer);
+    msaf_json_writer_object_end(writer);
+    msaf_json_writer_array_end(writer);
+    msaf_json_writer_object_end(writer);
+
+    return true;
+}
+
+static cJSON *_build_entries(const char *id)
+{
+    cJSON *json = cJSON_CreateObject();
+    cJSON *array;
+    cJSON *entry;
+    cJSON *nested;
+
+    cJSON_AddStringToObject(json, "id", id);
+    cJSON_AddItemToObject(json, "empty", cJSON_CreateObject());
+    cJSON_AddItemToObject(json, "none", cJSON_CreateArray());
+    array = cJSON_AddArrayToObject(json, "flags");
+    cJSON_AddItemToArray(array, cJSON_CreateTrue());
+    cJSON_AddItemToArray(array, cJSON_CreateFalse());
+    cJSON_AddItemToArray(array, cJSON_CreateNull());
+    array = cJSON_AddArrayToObject(json, "entries");
+    entry = cJSON_CreateObject();
+    cJSON_AddStringToObject(entry, "name", "a");
+    nested = cJSON_AddArrayToObject(entry, "values");
+    cJSON_AddItemToArray(nested, cJSON_CreateObject());
+    cJSON_AddItemToArray(nested, cJSON_CreateArray());
+    cJSON_AddItemToArray(array, entry);
+    entry = cJSON_CreateObject();
+    cJSON_AddStringToObject(entry, "name", "b");
+    nested = cJSON_AddObjectToObject(cJSON_AddObjectToObject(entry, "nested"), "deeper");
+    cJSON_AddNumberToObject(nested, "x", 1);
+    cJSON_AddItemToArray(array, entry);
+
+    return json;
+}
+
+static bool _write_cjson(msaf_json_writer_t *writer, const void *data)
+{
+    msaf_json_writer_cjson(writer, (const cJSON*)data);
+    return true;
+}
+
+static bool _write_consumption_report(msaf_json_writer_t *writer, const void *data)
+{
+    return msaf_api_consumption_report_writeResponseJSON(writer, (const msaf_api_consumption_report_t*)data);
+}
+
+static void _check_writer(abts_case *tc, msaf_json_write_fn write_fn, const void *data, const cJSON *expected)
+{
+    static const msaf_json_format_t formats[] = {MSAF_JSON_FORMAT_PRETTY, MSAF_JSON_FORMAT_COMPACT};
+    msaf_json_format_t saved_format = msaf_json_format_get();
+    int i;
+
+    for (i = 0; i < sizeof(formats)/sizeof(formats[0]); i++) {
+        char *body;
+        char *cjson_body;
+        char *hash = NULL;
+        char *cjson_hash = NULL;
+        size_t length = 0;
+        size_t cjson_length = 0;
+
+        msaf_json_format_set(formats[i]);
+
+        body = msaf_json_write_with_hash(write_fn, data, 0, &length, &hash);
+        cjson_body = msaf_json_print_with_hash(expected, &cjson_length, &cjson_hash);
+
+        ABTS_PTR_NOTNULL(tc, body);
+        ABTS_PTR_NOTNULL(tc, hash);
+        if (body && hash) {
+            ABTS_STR_EQUAL(tc, cjson_body, body);
+            ABTS_SIZE_EQUAL(tc, cjson_length, length);
+            ABTS_STR_EQUAL(tc, cjson_hash, hash);
+        }
+
+        if (body) ogs_free(body);
+        if (hash) ogs_free(hash);
+        cJSON_free(cjson_body);
+        ogs_free(cjson_hash);
+    }
+
+    msaf_json_format_set(saved_format);
+}
+
+static void test_json_writer_format(abts_case *tc, void *data)
+{
+    msaf_json_writer_t writer;
+    char *body;
+    size_t length;
+
+    /* explicit expected output, with the separators and indentation cJSON uses */
+    msaf_json_writer_init(&writer, MSAF_JSON_FORMAT_PRETTY, 0);
+    msaf_json_writer_object_start(&writer);
+    msaf_json_writer_key(&writer, "a");
+    msaf_json_writer_array_start(&writer);
+    msaf_json_writer_number(&writer, 1);
+    msaf_json_writer_object_start(&writer);
+    msaf_json_writer_key(&writer, "b");
+    msaf_json_writer_number(&writer, 0.25);
+    msaf_json_writer_object_end(&writer);
+    msaf_json_writer_array_end(&writer);
+    msaf_json_writer_key(&writer, "c\"");
+    msaf_json_writer_object_start(&writer);
+    msaf_json_writer_object_end(&writer);
+    msaf_json_writer_object_end(&writer);
+    body = msaf_json_writer_finish(&writer, &length);
+    ABTS_STR_EQUAL(tc, "{\n\t\"a\":\t[1, {\n\t\t\t\"b\":\t0.25\n\t\t}],\n\t\"c\\\"\":\t{\n\t}\n}", body);
+    ABTS_SIZE_EQUAL(tc, strlen(body), length);
+    ogs_free(body);
+
+    msaf_json_writer_init(&writer, MSAF_JSON_FORMAT_COMPACT, 4);
+    msaf_json_writer_array_start(&writer);
+    msaf_json_writer_string(&writer, "\x01\r\f\b/");
+    msaf_json_writer_null(&writer);
+    msaf_json_writer_number(&writer, -0.1);
+    msaf_json_writer_array_end(&writer);
+    body = msaf_json_writer_finish(&writer, &length);
+    ABTS_STR_EQUAL(tc, "[\"\\u0001\\r\\f\\b/\",null,-0.1]", body);
+    ABTS_SIZE_EQUAL(tc, strlen(body), length);
+    ogs_free(body);
+
+    /* a discarded document leaves nothing behind */
+    msaf_json_writer_init(&writer, MSAF_JSON_FORMAT_COMPACT, 0);
+    msaf_json_writer_object_start(&writer);
+    msaf_json_writer_clear(&writer);
+    ABTS_PTR_EQUAL(tc, NULL, writer.data);
+}
+
+static void test_json_writer_matches_cjson(abts_case *tc, void *data)
+{
+    cJSON *json;
+
+    json = cJSON_Parse(test_document);
+    ABTS_PTR_NOTNULL(tc, json);
+    if (json) {
+        _check_writer(tc, _write_cjson, json, json);
+        cJSON_Delete(json);
+    }
+
+    json = _build_entries("session-1");
+    _check_writer(tc, _write_entries, "session-1", json);
+    cJSON_Delete(json);
+}
+
+static void test_json_writer_model(abts_case *tc, void *data)
+{
+    cJSON *json = cJSON_Parse(test_report);
+    msaf_api_consumption_report_t *report;
+    const char *reason = NULL;
+
+    ABTS_PTR_NOTNULL(tc, json);
+    if (!json) return;
+
+    report = msaf_api_consumption_report_parseRequestFromJSON(json, &reason);
+    cJSON_Delete(json);
+    ABTS_PTR_NOTNULL(tc, report);
+    if (!report) return;
+
+    json = msaf_api_consumption_report_convertResponseToJSON(report);
+    ABTS_PTR_NOTNULL(tc, json);
+    if (json) {
+        _check_writer(tc, _write_consumption_report, report, json);
+        cJSON_Delete(json);
+    }
+
+    msaf_api_consumption_report_free(report);
+}
+
+#define JSON_WRITER_BENCH_DOCUMENTS 10000
+
+static void test_json_writer_benchmark(abts_case *tc, void *data)
+{
+    struct timespec start, end;
+    long long write_ns, cjson_ns;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < JSON_WRITER_BENCH_DOCUMENTS; i++) {
+        char *body = msaf_json_write(_write_entries, "session-1", 0, NULL);
+        ogs_free(body);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    write_ns = ((end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec)) / JSON_WRITER_BENCH_DOCUMENTS;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < JSON_WRITER_BENCH_DOCUMENTS; i++) {
+        cJSON *json = _build_entries("session-1");
+        char *body = msaf_json_print(json);
+        cJSON_Delete(json);
+        cJSON_free(body);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    cjson_ns = ((end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec)) / JSON_WRITER_BENCH_DOCUMENTS;
+
+    ogs_info("JSON in %s format: writer %lld ns/document, cJSON tree and print %lld ns/document",
+             msaf_json_format_name(msaf_json_format_get()), write_ns, cjson_ns);
+}
+
+static struct {
+    void (*func)(abts_case *tc, void *data);
+} test_cases[] = {
+    {test_json_writer_format},
+    {test_json_writer_matches_cjson},
+    {test_json_writer_model},
+    {test_json_writer_benchmark}
+};
+
+abts_suite *test_json_writer(abts_suite *suite)
+{
+    int i;
+
+    suite = ADD_SUITE(suite)
+
+    for (i=0; i<(sizeof(test_cases)/sizeof(test_cases[0])); i++) {
+        abts_run_test(suite, test_cases[i].func, NULL);
+    }
+
+    return suite;
+}
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
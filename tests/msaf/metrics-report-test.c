@@ -0,0 +1,103 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Author: David Waring
+ * Copyright: (C) 2024 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+/* System includes */
+#include <string.h>
+
+/* Open5GS includes */
+#include "test-common.h"
+
+/* MSAF includes */
+#include "metrics-report.h"
+
+/* Test includes */
+#include "metrics-report-test.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+static bool _identify(const char *body, char **client_id, char **session_id)
+{
+    return msaf_metrics_report_identify(body, strlen(body), client_id, session_id);
+}
+
+static void test_metrics_report_identify(abts_case *tc, void *data)
+{
+    char *client_id, *session_id;
+
+    ABTS_TRUE(tc, _identify("<?xml version=\"1.0\"?>\n"
+                            "<ReportingMessage xmlns=\"urn:3GPP:ns:PSS:AdaptiveHTTPStreaming:2009:qm\">\n"
+                            "  <QoeReport periodID=\"1\" recordingSessionId=\"session-1\" reportTime=\"2024-06-01T12:00:00Z\"\n"
+                            "             clientID=\"client-1\">\n"
+                            "  </QoeReport>\n"
+                            "</ReportingMessage>\n", &client_id, &session_id));
+    ABTS_STR_EQUAL(tc, "client-1", client_id);
+    ABTS_STR_EQUAL(tc, "session-1", session_id);
+    ogs_free(client_id);
+    ogs_free(session_id);
+
+    /* single quotes, spaces around '=' and no session id */
+    ABTS_TRUE(tc, _identify("<QoeReport clientID = 'client-2'/>", &client_id, &session_id));
+    ABTS_STR_EQUAL(tc, "client-2", client_id);
+    ABTS_TRUE(tc, session_id == NULL);
+    ogs_free(client_id);
+}
+
+static void test_metrics_report_identify_invalid(abts_case *tc, void *data)
+{
+    char *client_id, *session_id;
+    char *body;
+    char *long_id;
+
+    /* no clientID attribute, the name must be a whole attribute name and not inside another value */
+    ABTS_TRUE(tc, !_identify("<QoeReport recordingSessionId=\"session-1\"/>", &client_id, &session_id));
+    ABTS_TRUE(tc, !_identify("<QoeReport xclientID=\"client-1\"/>", &client_id, &session_id));
+    ABTS_TRUE(tc, !_identify("<QoeReport note=\" clientID='client-1'\"/>", &client_id, &session_id));
+    ABTS_TRUE(tc, !_identify("clientID=\"client-1\"", &client_id, &session_id));
+
+    /* empty, unterminated and too long values */
+    ABTS_TRUE(tc, !_identify("<QoeReport clientID=\"\"/>", &client_id, &session_id));
+    ABTS_TRUE(tc, !_identify("<QoeReport clientID=\"client-1", &client_id, &session_id));
+
+    long_id = ogs_calloc(1, MSAF_METRICS_REPORT_MAX_ID_LENGTH + 2);
+    memset(long_id, 'a', MSAF_METRICS_REPORT_MAX_ID_LENGTH + 1);
+    body = ogs_msprintf("<QoeReport clientID=\"%s\"/>", long_id);
+    ABTS_TRUE(tc, !_identify(body, &client_id, &session_id));
+    ogs_free(body);
+    ogs_free(long_id);
+}
+
+static struct {
+    void (*func)(abts_case *tc, void *data);
+} test_cases[] = {
+    {test_metrics_report_identify},
+    {test_metrics_report_identify_invalid}
+};
+
+abts_suite *test_metrics_report(abts_suite *suite)
+{
+    int i;
+
+    suite = ADD_SUITE(suite)
+
+    for (i=0; i<(sizeof(test_cases)/sizeof(test_cases[0])); i++) {
+        abts_run_test(suite, test_cases[i].func, NULL);
+    }
+
+    return suite;
+}
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,360 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Author: David Waring
+ * Copyright: (C) 2024 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+/* System includes */
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/* Open5GS includes */
+#include "test-common.h"
+
+/* MSAF includes */
+#include "json-reader.h"
+#include "model-arena.h"
+#include "openapi/model/msaf_api_consumption_report.h"
+
+/* Test includes */
+#include "model-arena-test.h"
+
+#define ABTS_PTR_NULL(a, b) ABTS_PTR_EQUAL(a, b, NULL)
+#define ABTS_FALSE(a, b) ABTS_TRUE(a, !(b))
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+static const char *test_report =
+    "{\"mediaPlayerEntry\": \"https://example.com/m4d/provisioning-session-1/manifest.mpd\","
+    " \"reportingClientId\": \"client-1\","
+    " \"consumptionReportingUnits\": ["
+    "{\"mediaConsumed\": \"video-1\", \"mediaEndpointAddress\": {\"ipv4Addr\": \"192.0.2.1\", \"portNumbers\": [443]},"
+    " \"startTime\": \"2024-06-01T12:00:00Z\", \"duration\": 30},"
+    " {\"mediaConsumed\": \"audio-1\", \"startTime\": \"2024-06-01T12:00:00Z\", \"duration\": 30}]}";
+
+/* fails on the second unit, after the first unit has been parsed */
+static const char *test_bad_report =
+    "{\"mediaPlayerEntry\": \"m\", \"reportingClientId\": \"c\", \"consumptionReportingUnits\": ["
+    "{\"mediaConsumed\": \"v\", \"startTime\": \"2024-06-01T12:00:00Z\", \"duration\": 30},"
+    " {\"mediaConsumed\": \"v\", \"startTime\": 0, \"duration\": 30}]}";
+
+static int cleanups_run = 0;
+
+static void _count_cleanup(void *ptr)
+{
+    cleanups_run++;
+    ogs_free(ptr);
+}
+
+static msaf_api_consumption_report_t *_parse_report(const char *doc, const char **reason)
+{
+    msaf_json_reader_t reader;
+
+    msaf_json_reader_init(&reader, doc, strlen(doc));
+    msaf_json_reader_next(&reader);
+
+    return msaf_api_consumption_report_parseRequestFromJSONReader(&reader, reason);
+}
+
+static char *_report_json(const msaf_api_consumption_report_t *report)
+{
+    cJSON *json;
+    char *str;
+
+    json = msaf_api_consumption_report_convertResponseToJSON(report);
+    if (!json) return NULL;
+    str = cJSON_PrintUnformatted(json);
+    cJSON_Delete(json);
+
+    return str;
+}
+
+static void test_model_arena_alloc(abts_case *tc, void *data)
+{
+    msaf_model_arena_t *arena, *inner;
+    char *heap_str, *arena_str, *big;
+    void *p;
+    int i;
+
+    arena = msaf_model_arena_new(256);
+    ABTS_PTR_NOTNULL(tc, arena);
+    ABTS_PTR_NULL(tc, msaf_model_arena_current());
+
+    /* allocations are aligned and owned by the arena */
+    for (i = 1; i < 40; i++) {
+        p = msaf_model_arena_alloc(arena, i);
+        ABTS_INT_EQUAL(tc, 0, (int)((uintptr_t)p % 16));
+        ABTS_TRUE(tc, msaf_model_arena_owns(p));
+    }
+    ABTS_TRUE(tc, msaf_model_arena_used(arena) >= 39*16);
+
+    /* a large allocation gets its own chunk */
+    big = msaf_model_arena_alloc(arena, 1000);
+    memset(big, 'x', 1000);
+    ABTS_TRUE(tc, msaf_model_arena_owns(big));
+    ABTS_TRUE(tc, msaf_model_arena_owns(big + 999));
+
+    /* outside of an arena model allocations come from the heap */
+    heap_str = msaf_model_strdup("heap");
+    ABTS_STR_EQUAL(tc, "heap", heap_str);
+    ABTS_FALSE(tc, msaf_model_arena_owns(heap_str));
+
+    msaf_model_arena_enter(arena);
+    ABTS_PTR_EQUAL(tc, arena, msaf_model_arena_current());
+
+    arena_str = msaf_model_msprintf("%s-%i", "arena", 42);
+    ABTS_STR_EQUAL(tc, "arena-42", arena_str);
+    ABTS_TRUE(tc, msaf_model_arena_owns(arena_str));
+    /* freeing arena memory does nothing */
+    msaf_model_free(arena_str);
+    ABTS_STR_EQUAL(tc, "arena-42", arena_str);
+
+    arena_str = msaf_model_strndup("truncated", 5);
+    ABTS_STR_EQUAL(tc, "trunc", arena_str);
+
+    /* nested arenas, the innermost is current */
+    inner = msaf_model_arena_new(0);
+    msaf_model_arena_enter(inner);
+    ABTS_PTR_EQUAL(tc, inner, msaf_model_arena_current());
+    p = msaf_model_calloc(4, sizeof(int));
+    ABTS_INT_EQUAL(tc, 0, ((int*)p)[3]);
+    msaf_model_arena_leave(inner);
+    ABTS_PTR_EQUAL(tc, arena, msaf_model_arena_current());
+    msaf_model_arena_free(inner);
+    ABTS_FALSE(tc, msaf_model_arena_owns(p));
+
+    msaf_model_arena_leave(arena);
+    ABTS_PTR_NULL(tc, msaf_model_arena_current());
+
+    msaf_model_arena_free(arena);
+    ABTS_FALSE(tc, msaf_model_arena_owns(big));
+
+    msaf_model_free(heap_str);
+}
+
+static void test_model_arena_lists(abts_case *tc, void *data)
+{
+    static const char *values[] = {"one", "two", "three"};
+    msaf_model_arena_t *arena;
+    OpenAPI_list_t *list;
+    OpenAPI_lnode_t *node;
+    OpenAPI_map_t *map;
+    int i;
+
+    arena = msaf_model_arena_new(0);
+    msaf_model_arena_enter(arena);
+
+    list = msaf_model_list_create();
+    ABTS_PTR_NOTNULL(tc, list);
+    ABTS_TRUE(tc, msaf_model_arena_owns(list));
+    ABTS_INT_EQUAL(tc, 0, (int)list->count);
+    ABTS_PTR_NULL(tc, list->first);
+
+    for (i = 0; i < 3; i++) {
+        msaf_model_list_add(list, msaf_model_strdup(values[i]));
+    }
+    ABTS_INT_EQUAL(tc, 3, (int)list->count);
+    ABTS_TRUE(tc, msaf_model_arena_owns(list->first));
+
+    /* walks in both directions like an OpenAPI_list_add() list */
+    i = 0;
+    OpenAPI_list_for_each(list, node) {
+        ABTS_STR_EQUAL(tc, values[i], (const char*)node->data);
+        i++;
+    }
+    ABTS_INT_EQUAL(tc, 3, i);
+    ABTS_STR_EQUAL(tc, "two", (const char*)list->last->prev->data);
+    ABTS_PTR_NULL(tc, list->first->prev);
+    ABTS_PTR_NULL(tc, list->last->next);
+
+    map = msaf_model_map_create(msaf_model_strdup("key"), msaf_model_strdup("value"));
+    ABTS_TRUE(tc, msaf_model_arena_owns(map));
+    ABTS_STR_EQUAL(tc, "key", map->key);
+    ABTS_STR_EQUAL(tc, "value", (const char*)map->value);
+
+    /* do nothing for arena memory */
+    msaf_model_map_free(map);
+    msaf_model_list_free(list);
+
+    msaf_model_arena_leave(arena);
+    msaf_model_arena_free(arena);
+
+    /* heap lists are the Open5GS lists */
+    list = msaf_model_list_create();
+    ABTS_FALSE(tc, msaf_model_arena_owns(list));
+    msaf_model_list_add(list, (void*)values[0]);
+    ABTS_INT_EQUAL(tc, 1, (int)list->count);
+    msaf_model_list_free(list);
+}
+
+static void test_model_arena_adopt(abts_case *tc, void *data)
+{
+    msaf_model_arena_t *arena;
+    char *ptr;
+
+    cleanups_run = 0;
+
+    /* without an arena the caller keeps ownership */
+    ptr = ogs_strdup("kept");
+    ABTS_PTR_EQUAL(tc, ptr, msaf_model_adopt(ptr, _count_cleanup));
+    ogs_free(ptr);
+
+    arena = msaf_model_arena_new(0);
+    msaf_model_arena_enter(arena);
+    msaf_model_adopt(ogs_strdup("first"), _count_cleanup);
+    msaf_model_adopt(ogs_strdup("second"), _count_cleanup);
+    msaf_model_adopt(ogs_strdup("default"), NULL);
+    ABTS_PTR_NULL(tc, msaf_model_adopt(NULL, _count_cleanup));
+    msaf_model_arena_leave(arena);
+
+    ABTS_INT_EQUAL(tc, 0, cleanups_run);
+    msaf_model_arena_free(arena);
+    ABTS_INT_EQUAL(tc, 2, cleanups_run);
+}
+
+static void test_model_arena_report(abts_case *tc, void *data)
+{
+    msaf_model_alloc_stats_t heap_stats, arena_stats;
+    msaf_model_arena_t *arena;
+    msaf_api_consumption_report_t *heap_report, *arena_report;
+    const char *reason = NULL;
+    char *heap_json, *arena_json;
+
+    /* parse the same report on the heap and in an arena */
+    msaf_model_alloc_stats_reset();
+    heap_report = _parse_report(test_report, &reason);
+    msaf_model_alloc_stats_get(&heap_stats);
+    ABTS_PTR_NOTNULL(tc, heap_report);
+
+    arena = msaf_model_arena_new(0);
+    msaf_model_alloc_stats_reset();
+    msaf_model_arena_enter(arena);
+    arena_report = _parse_report(test_report, &reason);
+    msaf_model_arena_leave(arena);
+    msaf_model_alloc_stats_get(&arena_stats);
+    ABTS_PTR_NOTNULL(tc, arena_report);
+    ABTS_TRUE(tc, msaf_model_arena_owns(arena_report));
+
+    /* same model */
+    heap_json = _report_json(heap_report);
+    arena_json = _report_json(arena_report);
+    ABTS_PTR_NOTNULL(tc, heap_json);
+    ABTS_PTR_NOTNULL(tc, arena_json);
+    if (heap_json && arena_json) ABTS_STR_EQUAL(tc, heap_json, arena_json);
+    if (heap_json) cJSON_free(heap_json);
+    if (arena_json) cJSON_free(arena_json);
+
+    /* every model allocation went to the arena, which needed a single chunk */
+    ABTS_TRUE(tc, heap_stats.heap_allocations > 10);
+    ABTS_INT_EQUAL(tc, 0, (int)heap_stats.arena_allocations);
+    ABTS_INT_EQUAL(tc, 0, (int)arena_stats.heap_allocations);
+    ABTS_INT_EQUAL(tc, (int)heap_stats.heap_allocations, (int)arena_stats.arena_allocations);
+    ABTS_INT_EQUAL(tc, 1, (int)arena_stats.arena_chunks);
+
+    ogs_info("ConsumptionReport parse: %llu heap allocations without an arena, %llu arena allocations in %llu chunks with one",
+             (unsigned long long)heap_stats.heap_allocations, (unsigned long long)arena_stats.arena_allocations,
+             (unsigned long long)arena_stats.arena_chunks);
+
+    /* the generated free does nothing for a model in an arena */
+    msaf_api_consumption_report_free(arena_report);
+    msaf_api_consumption_report_free(heap_report);
+    msaf_model_arena_free(arena);
+
+    /* a failed parse leaves the partly parsed report for the arena to release */
+    arena = msaf_model_arena_new(0);
+    msaf_model_arena_enter(arena);
+    reason = NULL;
+    arena_report = _parse_report(test_bad_report, &reason);
+    msaf_model_arena_leave(arena);
+    ABTS_PTR_NULL(tc, arena_report);
+    ABTS_PTR_NOTNULL(tc, reason);
+    ABTS_TRUE(tc, msaf_model_arena_used(arena) > 0);
+    msaf_model_arena_free(arena);
+
+    reason = NULL;
+    heap_report = _parse_report(test_bad_report, &reason);
+    ABTS_PTR_NULL(tc, heap_report);
+    ABTS_PTR_NOTNULL(tc, reason);
+}
+
+#define MODEL_ARENA_BENCH_REPORTS 10000
+
+static void test_model_arena_benchmark(abts_case *tc, void *data)
+{
+    struct timespec start, end;
+    long long heap_ns, arena_ns;
+    const char *reason;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < MODEL_ARENA_BENCH_REPORTS; i++) {
+        msaf_api_consumption_report_t *report;
+
+        report = _parse_report(test_report, &reason);
+        if (!report) {
+            ABTS_FAIL(tc, "Report not parsed");
+            break;
+        }
+        msaf_api_consumption_report_free(report);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    heap_ns = ((end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec)) / MODEL_ARENA_BENCH_REPORTS;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < MODEL_ARENA_BENCH_REPORTS; i++) {
+        msaf_api_consumption_report_t *report;
+        msaf_model_arena_t *arena;
+
+        arena = msaf_model_arena_new(0);
+        msaf_model_arena_enter(arena);
+        report = _parse_report(test_report, &reason);
+        msaf_model_arena_leave(arena);
+        if (!report) {
+            ABTS_FAIL(tc, "Report not parsed");
+            msaf_model_arena_free(arena);
+            break;
+        }
+        msaf_model_arena_free(arena);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    arena_ns = ((end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec)) / MODEL_ARENA_BENCH_REPORTS;
+
+    ogs_info("ConsumptionReport parse and free: heap %lld ns/report, arena %lld ns/report", heap_ns, arena_ns);
+}
+
+static struct {
+    void (*func)(abts_case *tc, void *data);
+} test_cases[] = {
+    {test_model_arena_alloc},
+    {test_model_arena_lists},
+    {test_model_arena_adopt},
+    {test_model_arena_report},
+    {test_model_arena_benchmark}
+};
+
+abts_suite *test_model_arena(abts_suite *suite)
+{
+    int i;
+
+    suite = ADD_SUITE(suite)
+
+    for (i=0; i<(sizeof(test_cases)/sizeof(test_cases[0])); i++) {
+        abts_run_test(suite, test_cases[i].func, NULL);
+    }
+
+    return suite;
+}
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,351 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Author: David Waring
+ * Copyright: (C) 2024 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+/* System includes */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* Open5GS includes */
+#include "test-common.h"
+
+/* MSAF includes */
+#include "provisioning-session.h"
+#include "provisioning-session-list.h"
+
+/* Test includes */
+#include "provisioning-session-list-test.h"
+
+#define ABTS_FALSE(a, b) ABTS_TRUE(a, !(b))
+#define ABTS_PTR_NULL(a, b) ABTS_PTR_EQUAL((a), (b), NULL)
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+#define TEST_SESSIONS 5
+
+static msaf_provisioning_session_t *_session_new(int i, const char *asp_id, const char *app_id)
+{
+    msaf_provisioning_session_t *session = ogs_calloc(1, sizeof(*session));
+
+    session->provisioningSessionId = ogs_msprintf("00000000-0000-0000-0000-%012i", i);
+    session->aspId = asp_id?ogs_strdup(asp_id):NULL;
+    session->appId = ogs_strdup(app_id);
+    msaf_provisioning_session_list_add(session);
+
+    return session;
+}
+
+static void _session_certificate_add(msaf_provisioning_session_t *session, const char *certificate_id)
+{
+    if (!session->certificate_map) session->certificate_map = ogs_hash_make();
+    ogs_hash_set(session->certificate_map, ogs_strdup(certificate_id), OGS_HASH_KEY_STRING, ogs_strdup(certificate_id));
+    msaf_provisioning_session_list_certificate_add(session, certificate_id);
+}
+
+static void _session_free(msaf_provisioning_session_t *session)
+{
+    msaf_provisioning_session_list_remove(session);
+    if (session->certificate_map) {
+        ogs_hash_index_t *hi;
+        for (hi = ogs_hash_first(session->certificate_map); hi; hi = ogs_hash_next(hi)) {
+            ogs_free((void*)ogs_hash_this_key(hi));
+            ogs_free(ogs_hash_this_val(hi));
+        }
+        ogs_hash_destroy(session->certificate_map);
+    }
+    ogs_free(session->provisioningSessionId);
+    if (session->aspId) ogs_free(session->aspId);
+    ogs_free(session->appId);
+    ogs_free(session);
+}
+
+static void _expect(abts_case *tc, const char *expected, const msaf_provisioning_session_list_filter_t *filter,
+                    uint64_t cursor, size_t limit, uint64_t *next_cursor)
+{
+    size_t length = 0;
+    char *body = msaf_provisioning_session_list_render(filter, cursor, limit, &length, next_cursor);
+
+    ABTS_PTR_NOTNULL(tc, body);
+    ABTS_STR_EQUAL(tc, expected, body);
+    ABTS_INT_EQUAL(tc, strlen(expected), length);
+    ogs_free(body);
+}
+
+static void test_provisioning_session_list_render(abts_case *tc, void *data)
+{
+    msaf_provisioning_session_t *sessions[TEST_SESSIONS];
+    msaf_provisioning_session_list_filter_t filter = {NULL, NULL, NULL};
+    uint64_t next = 0;
+    int i;
+
+    _expect(tc, "[]", NULL, 0, 0, &next);
+    ABTS_TRUE(tc, next == 0);
+
+    for (i = 0; i < TEST_SESSIONS; i++) {
+        sessions[i] = _session_new(i, (i % 2)?"asp-odd":"asp-even", (i < 3)?"app-a":"app-b");
+    }
+    ABTS_INT_EQUAL(tc, TEST_SESSIONS, msaf_provisioning_session_list_count());
+
+    /* creation order, and the cached copy is the same */
+    for (i = 0; i < 2; i++) {
+        _expect(tc, "[\"00000000-0000-0000-0000-000000000000\", \"00000000-0000-0000-0000-000000000001\", "
+                    "\"00000000-0000-0000-0000-000000000002\", \"00000000-0000-0000-0000-000000000003\", "
+                    "\"00000000-0000-0000-0000-000000000004\"]", NULL, 0, 0, &next);
+        ABTS_TRUE(tc, next == 0);
+    }
+
+    /* filters */
+    filter.asp_id = "asp-odd";
+    _expect(tc, "[\"00000000-0000-0000-0000-000000000001\", \"00000000-0000-0000-0000-000000000003\"]", &filter, 0, 0, &next);
+    filter.app_id = "app-b";
+    _expect(tc, "[\"00000000-0000-0000-0000-000000000003\"]", &filter, 0, 0, &next);
+    filter.asp_id = "asp-unknown";
+    _expect(tc, "[]", &filter, 0, 0, &next);
+    ABTS_TRUE(tc, next == 0);
+
+    /* deleting a session updates the listing */
+    _session_free(sessions[2]);
+    sessions[2] = NULL;
+    _expect(tc, "[\"00000000-0000-0000-0000-000000000000\", \"00000000-0000-0000-0000-000000000001\", "
+                "\"00000000-0000-0000-0000-000000000003\", \"00000000-0000-0000-0000-000000000004\"]", NULL, 0, 0, &next);
+    ABTS_INT_EQUAL(tc, TEST_SESSIONS - 1, msaf_provisioning_session_list_count());
+
+    for (i = 0; i < TEST_SESSIONS; i++) {
+        if (sessions[i]) _session_free(sessions[i]);
+    }
+    ABTS_INT_EQUAL(tc, 0, msaf_provisioning_session_list_count());
+    _expect(tc, "[]", NULL, 0, 0, &next);
+
+    msaf_provisioning_session_list_final();
+}
+
+static void test_provisioning_session_list_pages(abts_case *tc, void *data)
+{
+    msaf_provisioning_session_t *sessions[TEST_SESSIONS];
+    msaf_provisioning_session_list_filter_t filter = {"asp-even", NULL, NULL};
+    uint64_t next = 0, cursor;
+    char *link;
+    int i;
+
+    for (i = 0; i < TEST_SESSIONS; i++) {
+        sessions[i] = _session_new(i, (i % 2)?"asp-odd":"asp-even", "app id/1");
+    }
+
+    _expect(tc, "[\"00000000-0000-0000-0000-000000000000\", \"00000000-0000-0000-0000-000000000001\"]", NULL, 0, 2, &next);
+    ABTS_TRUE(tc, next != 0);
+
+    /* a cursor stays valid when the session it points at is deleted */
+    cursor = next;
+    _session_free(sessions[1]);
+    sessions[1] = NULL;
+    _expect(tc, "[\"00000000-0000-0000-0000-000000000002\", \"00000000-0000-0000-0000-000000000003\"]", NULL, cursor, 2, &next);
+    ABTS_TRUE(tc, next != 0);
+    _expect(tc, "[\"00000000-0000-0000-0000-000000000004\"]", NULL, next, 2, &next);
+    ABTS_TRUE(tc, next == 0);
+
+    /* an exact last page does not give a cursor to an empty page */
+    _expect(tc, "[\"00000000-0000-0000-0000-000000000000\", \"00000000-0000-0000-0000-000000000002\", "
+                "\"00000000-0000-0000-0000-000000000003\", \"00000000-0000-0000-0000-000000000004\"]", NULL, 0, 4, &next);
+    ABTS_TRUE(tc, next == 0);
+
+    /* filtered pages */
+    _expect(tc, "[\"00000000-0000-0000-0000-000000000000\"]", &filter, 0, 1, &next);
+    ABTS_TRUE(tc, next != 0);
+    _expect(tc, "[\"00000000-0000-0000-0000-000000000002\", \"00000000-0000-0000-0000-000000000004\"]", &filter, next, 5, &next);
+    ABTS_TRUE(tc, next == 0);
+
+    /* cursors */
+    ABTS_TRUE(tc, msaf_provisioning_session_list_cursor_parse("42", &cursor));
+    ABTS_TRUE(tc, cursor == 42);
+    ABTS_FALSE(tc, msaf_provisioning_session_list_cursor_parse("", &cursor));
+    ABTS_FALSE(tc, msaf_provisioning_session_list_cursor_parse("-1", &cursor));
+    ABTS_FALSE(tc, msaf_provisioning_session_list_cursor_parse("12abc", &cursor));
+    ABTS_FALSE(tc, msaf_provisioning_session_list_cursor_parse("99999999999999999999999", &cursor));
+
+    filter.app_id = "app id/1";
+    link = msaf_provisioning_session_list_next_link(&filter, 10, 7);
+    ABTS_STR_EQUAL(tc, "<?limit=10&cursor=7&aspId=asp-even&appId=app%20id%2F1>; rel=\"next\"", link);
+    ogs_free(link);
+
+    for (i = 0; i < TEST_SESSIONS; i++) {
+        if (sessions[i]) _session_free(sessions[i]);
+    }
+    msaf_provisioning_session_list_final();
+}
+
+static void test_provisioning_session_list_indexes(abts_case *tc, void *data)
+{
+    msaf_provisioning_session_t *sessions[TEST_SESSIONS];
+    msaf_provisioning_session_list_filter_t filter = {NULL, NULL, NULL};
+    uint64_t next = 0;
+    char *link;
+    int i;
+
+    for (i = 0; i < TEST_SESSIONS; i++) {
+        sessions[i] = _session_new(i, (i % 2)?"asp-odd":NULL, (i < 3)?"app-a":"app-b");
+    }
+    _session_certificate_add(sessions[1], "cert-1");
+    _session_certificate_add(sessions[1], "cert-2");
+    _session_certificate_add(sessions[3], "cert-3");
+
+    /* certificate lookups */
+    ABTS_PTR_EQUAL(tc, sessions[1], msaf_provisioning_session_list_find_by_certificate_id("cert-1"));
+    ABTS_PTR_EQUAL(tc, sessions[1], msaf_provisioning_session_list_find_by_certificate_id("cert-2"));
+    ABTS_PTR_EQUAL(tc, sessions[3], msaf_provisioning_session_list_find_by_certificate_id("cert-3"));
+    ABTS_PTR_NULL(tc, msaf_provisioning_session_list_find_by_certificate_id("cert-unknown"));
+
+    /* certificate filter, on its own and with the other filters */
+    filter.certificate_id = "cert-2";
+    _expect(tc, "[\"00000000-0000-0000-0000-000000000001\"]", &filter, 0, 0, &next);
+    ABTS_TRUE(tc, next == 0);
+    filter.app_id = "app-a";
+    _expect(tc, "[\"00000000-0000-0000-0000-000000000001\"]", &filter, 0, 0, &next);
+    filter.app_id = "app-b";
+    _expect(tc, "[]", &filter, 0, 0, &next);
+    filter.certificate_id = "cert-unknown";
+    filter.app_id = NULL;
+    _expect(tc, "[]", &filter, 0, 0, &next);
+
+    /* a cursor past the certificate's session gives an empty page */
+    filter.certificate_id = "cert-3";
+    _expect(tc, "[]", &filter, sessions[3]->list_seq, 0, &next);
+
+    /* sessions without an aspId are not in the aspId index */
+    filter.certificate_id = NULL;
+    filter.asp_id = "asp-odd";
+    filter.app_id = "app-b";
+    _expect(tc, "[\"00000000-0000-0000-0000-000000000003\"]", &filter, 0, 0, &next);
+
+    filter.asp_id = NULL;
+    filter.certificate_id = "cert/1";
+    link = msaf_provisioning_session_list_next_link(&filter, 10, 7);
+    ABTS_STR_EQUAL(tc, "<?limit=10&cursor=7&appId=app-b&certificateId=cert%2F1>; rel=\"next\"", link);
+    ogs_free(link);
+
+    /* removing a certificate, or its session, takes it out of the index */
+    msaf_provisioning_session_list_certificate_remove("cert-2");
+    ABTS_PTR_NULL(tc, msaf_provisioning_session_list_find_by_certificate_id("cert-2"));
+    ABTS_PTR_EQUAL(tc, sessions[1], msaf_provisioning_session_list_find_by_certificate_id("cert-1"));
+    _session_free(sessions[1]);
+    sessions[1] = NULL;
+    ABTS_PTR_NULL(tc, msaf_provisioning_session_list_find_by_certificate_id("cert-1"));
+    filter.app_id = NULL;
+    filter.certificate_id = "cert-1";
+    _expect(tc, "[]", &filter, 0, 0, &next);
+
+    /* removing the last session for an aspId or appId empties the filter */
+    _session_free(sessions[3]);
+    sessions[3] = NULL;
+    filter.certificate_id = NULL;
+    filter.asp_id = "asp-odd";
+    _expect(tc, "[]", &filter, 0, 0, &next);
+    filter.asp_id = NULL;
+    filter.app_id = "app-b";
+    _expect(tc, "[\"00000000-0000-0000-0000-000000000004\"]", &filter, 0, 0, &next);
+
+    for (i = 0; i < TEST_SESSIONS; i++) {
+        if (sessions[i]) _session_free(sessions[i]);
+    }
+    ABTS_INT_EQUAL(tc, 0, msaf_provisioning_session_list_count());
+    msaf_provisioning_session_list_final();
+}
+
+/* Rendering is linear in the number of sessions and the unfiltered listing is only rendered once between changes */
+#define PROVISIONING_SESSION_LIST_BENCH_SESSIONS 20000
+
+/* Length of a rendered listing of n provisioning session ids: brackets, quoted 36 character ids and ", " separators */
+#define LISTING_LENGTH(n) (2 + (n) * 38 + ((n) - 1) * 2)
+
+static long long _bench_render(const msaf_provisioning_session_list_filter_t *filter, uint64_t cursor, size_t limit,
+                               int repeats, size_t *length)
+{
+    struct timespec start, end;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < repeats; i++) {
+        ogs_free(msaf_provisioning_session_list_render(filter, cursor, limit, length, NULL));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return ((end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec)) / repeats;
+}
+
+static void test_provisioning_session_list_bench(abts_case *tc, void *data)
+{
+    /* a filter that matches every session, so that the listing is rendered each time */
+    static const msaf_provisioning_session_list_filter_t all = {"asp", NULL, NULL};
+    msaf_provisioning_session_t **sessions;
+    long long ns_half, ns_full, ns_cached, ns_page;
+    size_t len_half, len_full, len_cached, len_page;
+    int i;
+
+    sessions = ogs_calloc(PROVISIONING_SESSION_LIST_BENCH_SESSIONS, sizeof(*sessions));
+    ABTS_PTR_NOTNULL(tc, sessions);
+
+    for (i = 0; i < PROVISIONING_SESSION_LIST_BENCH_SESSIONS / 2; i++) {
+        sessions[i] = _session_new(i, "asp", "app");
+    }
+    ns_half = _bench_render(&all, 0, 0, 20, &len_half);
+
+    for (; i < PROVISIONING_SESSION_LIST_BENCH_SESSIONS; i++) {
+        sessions[i] = _session_new(i, "asp", "app");
+    }
+    ns_full = _bench_render(&all, 0, 0, 20, &len_full);
+    ns_cached = _bench_render(NULL, 0, 0, 20, &len_cached);
+    ns_page = _bench_render(NULL, PROVISIONING_SESSION_LIST_BENCH_SESSIONS / 2, 100, 20, &len_page);
+
+    ogs_info("Provisioning session listing: %i sessions %lld ns, %i sessions %lld ns, cached %lld ns, page of 100 %lld ns",
+             PROVISIONING_SESSION_LIST_BENCH_SESSIONS / 2, ns_half, PROVISIONING_SESSION_LIST_BENCH_SESSIONS, ns_full,
+             ns_cached, ns_page);
+
+    /* the timings are only reported, a page only renders the ids on that page wherever it starts */
+    ABTS_INT_EQUAL(tc, LISTING_LENGTH(PROVISIONING_SESSION_LIST_BENCH_SESSIONS / 2), len_half);
+    ABTS_INT_EQUAL(tc, LISTING_LENGTH(PROVISIONING_SESSION_LIST_BENCH_SESSIONS), len_full);
+    ABTS_INT_EQUAL(tc, LISTING_LENGTH(PROVISIONING_SESSION_LIST_BENCH_SESSIONS), len_cached);
+    ABTS_INT_EQUAL(tc, LISTING_LENGTH(100), len_page);
+
+    for (i = 0; i < PROVISIONING_SESSION_LIST_BENCH_SESSIONS; i++) {
+        _session_free(sessions[i]);
+    }
+    ogs_free(sessions);
+    msaf_provisioning_session_list_final();
+}
+
+static struct {
+    void (*func)(abts_case *tc, void *data);
+} test_cases[] = {
+    {test_provisioning_session_list_render},
+    {test_provisioning_session_list_pages},
+    {test_provisioning_session_list_indexes},
+    {test_provisioning_session_list_bench}
+};
+
+abts_suite *test_provisioning_session_list(abts_suite *suite)
+{
+    int i;
+
+    suite = ADD_SUITE(suite)
+
+    for (i=0; i<(sizeof(test_cases)/sizeof(test_cases[0])); i++) {
+        abts_run_test(suite, test_cases[i].func, NULL);
+    }
+
+    return suite;
+}
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
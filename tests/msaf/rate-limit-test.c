@@ -0,0 +1,162 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Author: David Waring
+ * Copyright: (C) 2024 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+/* System includes */
+#include <stdio.h>
+#include <string.h>
+
+/* Open5GS includes */
+#include "test-common.h"
+
+/* MSAF includes */
+#include "rate-limit.h"
+
+/* Test includes */
+#include "rate-limit-test.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+#define TEST_START ogs_time_from_sec(1000)
+
+static void test_rate_limit_bucket(abts_case *tc, void *data)
+{
+    msaf_rate_limiter_t *limiter;
+    ogs_time_t retry_in = 0;
+    int i;
+
+    /* 2 requests per second with a burst of 4 */
+    limiter = msaf_rate_limiter_new(2.0, 4, 0);
+
+    for (i = 0; i < 4; i++) {
+        ABTS_TRUE(tc, msaf_rate_limiter_take(limiter, "10.0.0.1", TEST_START, &retry_in));
+    }
+    ABTS_TRUE(tc, !msaf_rate_limiter_take(limiter, "10.0.0.1", TEST_START, &retry_in));
+    ABTS_INT_EQUAL(tc, 500000, retry_in);
+
+    /* other keys have their own bucket */
+    ABTS_TRUE(tc, msaf_rate_limiter_take(limiter, "10.0.0.2", TEST_START, &retry_in));
+
+    /* half a second adds one token */
+    ABTS_TRUE(tc, !msaf_rate_limiter_take(limiter, "10.0.0.1", TEST_START + ogs_time_from_msec(400), &retry_in));
+    ABTS_INT_EQUAL(tc, 100000, retry_in);
+    ABTS_TRUE(tc, msaf_rate_limiter_take(limiter, "10.0.0.1", TEST_START + ogs_time_from_msec(500), &retry_in));
+    ABTS_TRUE(tc, !msaf_rate_limiter_take(limiter, "10.0.0.1", TEST_START + ogs_time_from_msec(500), &retry_in));
+
+    /* the bucket never holds more than the burst */
+    for (i = 0; i < 4; i++) {
+        ABTS_TRUE(tc, msaf_rate_limiter_take(limiter, "10.0.0.1", TEST_START + ogs_time_from_sec(1000), &retry_in));
+    }
+    ABTS_TRUE(tc, !msaf_rate_limiter_take(limiter, "10.0.0.1", TEST_START + ogs_time_from_sec(1000), &retry_in));
+
+    msaf_rate_limiter_free(limiter);
+}
+
+static void test_rate_limit_bounded(abts_case *tc, void *data)
+{
+    msaf_rate_limiter_t *limiter;
+    char key[32];
+    int i;
+
+    limiter = msaf_rate_limiter_new(1.0, 1, 100);
+
+    /* the least recently used buckets are dropped to stay within the limit */
+    for (i = 0; i < 150; i++) {
+        sprintf(key, "client-%i", i);
+        ABTS_TRUE(tc, msaf_rate_limiter_take(limiter, key, TEST_START, NULL));
+    }
+    ABTS_INT_EQUAL(tc, 100, msaf_rate_limiter_count(limiter));
+    ABTS_INT_EQUAL(tc, 50, msaf_rate_limiter_evictions(limiter));
+
+    /* the most recent clients are still limited */
+    ABTS_TRUE(tc, !msaf_rate_limiter_take(limiter, "client-149", TEST_START, NULL));
+
+    /* buckets that have refilled expire as new requests arrive */
+    for (i = 0; i < 60; i++) {
+        ABTS_TRUE(tc, msaf_rate_limiter_take(limiter, "client-149", TEST_START + ogs_time_from_sec(2 + i), NULL));
+    }
+    ABTS_TRUE(tc, msaf_rate_limiter_count(limiter) < 100);
+    ABTS_INT_EQUAL(tc, 50, msaf_rate_limiter_evictions(limiter));
+
+    msaf_rate_limiter_free(limiter);
+}
+
+static void test_rate_limit_forwarded_address(abts_case *tc, void *data)
+{
+    char buf[OGS_ADDRSTRLEN];
+
+    ABTS_STR_EQUAL(tc, "192.0.2.1", msaf_rate_limit_forwarded_address("192.0.2.1", buf, sizeof(buf)));
+    /* the last entry is the one added by the nearest proxy */
+    ABTS_STR_EQUAL(tc, "2001:db8::1", msaf_rate_limit_forwarded_address("203.0.113.9, 2001:db8::1 ", buf, sizeof(buf)));
+    ABTS_TRUE(tc, msaf_rate_limit_forwarded_address(NULL, buf, sizeof(buf)) == NULL);
+    ABTS_TRUE(tc, msaf_rate_limit_forwarded_address("192.0.2.1, ", buf, sizeof(buf)) == NULL);
+    ABTS_TRUE(tc, msaf_rate_limit_forwarded_address("unknown", buf, sizeof(buf)) == NULL);
+}
+
+static void test_rate_limit_client_address(abts_case *tc, void *data)
+{
+    msaf_rate_limit_config_t config;
+    char buf[OGS_ADDRSTRLEN];
+
+    msaf_rate_limit_config_init(&config);
+
+    /* with no trusted proxies X-Forwarded-For is never believed */
+    ABTS_STR_EQUAL(tc, "198.51.100.7", msaf_rate_limit_client_address(&config, "198.51.100.7", "192.0.2.1", buf, sizeof(buf)));
+    ABTS_TRUE(tc, msaf_rate_limit_client_address(&config, NULL, "192.0.2.1", buf, sizeof(buf)) == NULL);
+
+    ABTS_TRUE(tc, msaf_rate_limit_config_add_trusted_proxy(&config, "198.51.100.7"));
+    ABTS_TRUE(tc, msaf_rate_limit_config_add_trusted_proxy(&config, "2001:db8:1::/48"));
+    ABTS_TRUE(tc, !msaf_rate_limit_config_add_trusted_proxy(&config, "198.51.100.0/33"));
+    ABTS_TRUE(tc, !msaf_rate_limit_config_add_trusted_proxy(&config, "proxy.example.com"));
+    ABTS_TRUE(tc, !msaf_rate_limit_config_add_trusted_proxy(&config, "198.51.100.0/"));
+    ABTS_INT_EQUAL(tc, 2, config.num_trusted_proxies);
+
+    ABTS_STR_EQUAL(tc, "192.0.2.1", msaf_rate_limit_client_address(&config, "198.51.100.7", "192.0.2.1", buf, sizeof(buf)));
+    ABTS_STR_EQUAL(tc, "192.0.2.2", msaf_rate_limit_client_address(&config, "::ffff:198.51.100.7", "192.0.2.2", buf, sizeof(buf)));
+    ABTS_STR_EQUAL(tc, "192.0.2.3", msaf_rate_limit_client_address(&config, "2001:db8:1:2::1", "192.0.2.3", buf, sizeof(buf)));
+    /* a trusted proxy that doesn't say who the client is leaves it unknown */
+    ABTS_TRUE(tc, msaf_rate_limit_client_address(&config, "198.51.100.7", NULL, buf, sizeof(buf)) == NULL);
+
+    ABTS_STR_EQUAL(tc, "198.51.100.8", msaf_rate_limit_client_address(&config, "198.51.100.8", "192.0.2.1", buf, sizeof(buf)));
+    ABTS_STR_EQUAL(tc, "2001:db8:2::1", msaf_rate_limit_client_address(&config, "2001:db8:2::1", "192.0.2.1", buf, sizeof(buf)));
+
+    msaf_rate_limit_config_clear(&config);
+    ABTS_INT_EQUAL(tc, 0, config.num_trusted_proxies);
+}
+
+static struct {
+    void (*func)(abts_case *tc, void *data);
+} test_cases[] = {
+    {test_rate_limit_bucket},
+    {test_rate_limit_bounded},
+    {test_rate_limit_forwarded_address},
+    {test_rate_limit_client_address}
+};
+
+abts_suite *test_rate_limit(abts_suite *suite)
+{
+    int i;
+
+    suite = ADD_SUITE(suite)
+
+    for (i=0; i<(sizeof(test_cases)/sizeof(test_cases[0])); i++) {
+        abts_run_test(suite, test_cases[i].func, NULL);
+    }
+
+    return suite;
+}
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,358 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Author: David Waring
+ * Copyright: (C) 2024 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+/* System includes */
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+/* Open5GS includes */
+#include "test-common.h"
+
+/* MSAF includes */
+#include "request-headers.h"
+
+/* Test includes */
+#include "request-headers-test.h"
+
+#define ABTS_PTR_NULL(a, b) ABTS_PTR_EQUAL(a, b, NULL)
+#define ABTS_FALSE(a, b) ABTS_TRUE(a, !(b))
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+typedef struct test_header_s {
+    const char *name;
+    const char *value;
+} test_header_t;
+
+/* Headers as sent by a typical HTTP/1.1 client */
+static const test_header_t http1_headers[] = {
+    {"Host", "af.example.com:7777"},
+    {"User-Agent", "curl/8.5.0"},
+    {"Accept", "*/*"},
+    {"Accept-Encoding", "gzip, deflate"},
+    {"Content-Type", "application/json"},
+    {"Content-Length", "512"},
+    {"If-None-Match", "\"abc123\""},
+    {"X-Forwarded-For", "192.0.2.10, 198.51.100.7"},
+    {NULL, NULL}
+};
+
+/* The same request over HTTP/2, header names are lower case and the authority is a pseudo-header */
+static const test_header_t http2_headers[] = {
+    {":scheme", "https"},
+    {":authority", "af.example.com:7777"},
+    {"user-agent", "Media Session Handler/1.0"},
+    {"accept", "application/json"},
+    {"accept-encoding", "gzip"},
+    {"content-type", "application/json"},
+    {"content-length", "512"},
+    {"if-modified-since", "Tue, 01 Oct 2024 10:00:00 GMT"},
+    {NULL, NULL}
+};
+
+/* A metrics report with a charset parameter on the media type */
+static const test_header_t content_type_params_headers[] = {
+    {"Host", "af.example.com:7777"},
+    {"Content-Type", "Application/XML ; charset=utf-8"},
+    {NULL, NULL}
+};
+
+static ogs_hash_t *_make_headers(const test_header_t *hdrs)
+{
+    ogs_hash_t *headers = ogs_hash_make();
+
+    for (; hdrs->name; hdrs++) {
+        ogs_hash_set(headers, hdrs->name, OGS_HASH_KEY_STRING, hdrs->value);
+    }
+
+    return headers;
+}
+
+static void test_request_headers_lookup(abts_case *tc, void *data)
+{
+    static const char *unknown[] = {
+        "", "content-length", "x-forwarded-by", "hosts", "hos", "if-range", "accept", ":path", "content-typf", "ifmatch"
+    };
+    int i;
+
+    /* each well-known name has its own slot, whatever the letter case */
+    for (i = 0; i < MSAF_REQUEST_HEADER_COUNT; i++) {
+        const char *name = msaf_request_header_name(i);
+        char upper[64];
+        size_t j, len;
+
+        ABTS_PTR_NOTNULL(tc, name);
+        len = strlen(name);
+        ABTS_INT_EQUAL(tc, i, msaf_request_header_lookup(name, len));
+
+        ABTS_TRUE(tc, len < sizeof(upper));
+        for (j = 0; j <= len; j++) upper[j] = (name[j] >= 'a' && name[j] <= 'z') ? name[j] - 'a' + 'A' : name[j];
+        ABTS_INT_EQUAL(tc, i, msaf_request_header_lookup(upper, len));
+    }
+
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_HEADER_CONTENT_TYPE, msaf_request_header_lookup("Content-Type", 12));
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_HEADER_X_FORWARDED_FOR, msaf_request_header_lookup("X-Forwarded-For", 15));
+
+    for (i = 0; i < sizeof(unknown)/sizeof(unknown[0]); i++) {
+        ABTS_INT_EQUAL(tc, MSAF_REQUEST_HEADER_UNKNOWN, msaf_request_header_lookup(unknown[i], strlen(unknown[i])));
+    }
+
+    /* only name_len characters are looked at */
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_HEADER_HOST, msaf_request_header_lookup("host: af.example.com", 4));
+
+    ABTS_PTR_NULL(tc, msaf_request_header_name(MSAF_REQUEST_HEADER_UNKNOWN));
+}
+
+static void test_request_headers_index(abts_case *tc, void *data)
+{
+    msaf_request_headers_t index;
+    ogs_hash_t *headers;
+
+    headers = _make_headers(http1_headers);
+    msaf_request_headers_index(&index, headers);
+
+    ABTS_STR_EQUAL(tc, "af.example.com:7777", msaf_request_headers_host(&index));
+    ABTS_STR_EQUAL(tc, "gzip, deflate", msaf_request_headers_get(&index, MSAF_REQUEST_HEADER_ACCEPT_ENCODING));
+    ABTS_STR_EQUAL(tc, "\"abc123\"", msaf_request_headers_get(&index, MSAF_REQUEST_HEADER_IF_NONE_MATCH));
+    ABTS_STR_EQUAL(tc, "192.0.2.10, 198.51.100.7", msaf_request_headers_get(&index, MSAF_REQUEST_HEADER_X_FORWARDED_FOR));
+    ABTS_PTR_NULL(tc, msaf_request_headers_get(&index, MSAF_REQUEST_HEADER_IF_MODIFIED_SINCE));
+    ABTS_PTR_NULL(tc, msaf_request_headers_get(&index, MSAF_REQUEST_HEADER_AUTHORITY));
+    ABTS_TRUE(tc, msaf_request_headers_content_type_is(&index, "application/json"));
+    ABTS_TRUE(tc, msaf_request_headers_content_type_is(&index, "Application/JSON"));
+    ABTS_FALSE(tc, msaf_request_headers_content_type_is(&index, "application/xml"));
+
+    ogs_hash_destroy(headers);
+
+    /* lower case names and the :authority pseudo-header are found as well */
+    headers = _make_headers(http2_headers);
+    msaf_request_headers_index(&index, headers);
+
+    ABTS_PTR_NULL(tc, msaf_request_headers_get(&index, MSAF_REQUEST_HEADER_HOST));
+    ABTS_STR_EQUAL(tc, "af.example.com:7777", msaf_request_headers_host(&index));
+    ABTS_STR_EQUAL(tc, "gzip", msaf_request_headers_get(&index, MSAF_REQUEST_HEADER_ACCEPT_ENCODING));
+    ABTS_STR_EQUAL(tc, "Tue, 01 Oct 2024 10:00:00 GMT", msaf_request_headers_get(&index, MSAF_REQUEST_HEADER_IF_MODIFIED_SINCE));
+    ABTS_TRUE(tc, msaf_request_headers_content_type_is(&index, "application/json"));
+    ABTS_PTR_NULL(tc, msaf_request_headers_get(&index, MSAF_REQUEST_HEADER_X_FORWARDED_FOR));
+
+    ogs_hash_destroy(headers);
+
+    /* no headers */
+    msaf_request_headers_index(&index, NULL);
+    ABTS_PTR_NULL(tc, msaf_request_headers_host(&index));
+    ABTS_FALSE(tc, msaf_request_headers_content_type_is(&index, "application/json"));
+
+    /* parameters are ignored when matching the media type */
+    headers = _make_headers(content_type_params_headers);
+    msaf_request_headers_index(&index, headers);
+
+    ABTS_TRUE(tc, msaf_request_headers_content_type_is(&index, "application/xml"));
+    ABTS_FALSE(tc, msaf_request_headers_content_type_is(&index, "application/xm"));
+    ABTS_FALSE(tc, msaf_request_headers_content_type_is(&index, "application/json"));
+
+    ogs_hash_destroy(headers);
+}
+
+static void test_request_headers_etag_list(abts_case *tc, void *data)
+{
+    ABTS_TRUE(tc, msaf_request_headers_etag_list_matches("abc123", "abc123", false));
+    ABTS_TRUE(tc, msaf_request_headers_etag_list_matches("\"abc123\"", "abc123", false));
+    ABTS_TRUE(tc, msaf_request_headers_etag_list_matches("\"xyz\", \"abc123\"", "abc123", false));
+    ABTS_TRUE(tc, msaf_request_headers_etag_list_matches("xyz,abc123", "abc123", false));
+    ABTS_TRUE(tc, msaf_request_headers_etag_list_matches("*", "abc123", false));
+    ABTS_FALSE(tc, msaf_request_headers_etag_list_matches("*", NULL, false));
+    ABTS_FALSE(tc, msaf_request_headers_etag_list_matches("\"abc12\"", "abc123", false));
+    ABTS_FALSE(tc, msaf_request_headers_etag_list_matches("\"abc1234\"", "abc123", false));
+    ABTS_FALSE(tc, msaf_request_headers_etag_list_matches("", "abc123", false));
+
+    /* weak entity-tags only match with the weak comparison */
+    ABTS_FALSE(tc, msaf_request_headers_etag_list_matches("W/\"abc123\"", "abc123", false));
+    ABTS_TRUE(tc, msaf_request_headers_etag_list_matches("W/\"abc123\"", "abc123", true));
+
+    /* the gzip variant is the same version of the resource */
+    ABTS_TRUE(tc, msaf_request_headers_etag_list_matches("\"abc123-gzip\"", "abc123", false));
+    ABTS_FALSE(tc, msaf_request_headers_etag_list_matches("\"abc123-gzipped\"", "abc123", false));
+}
+
+static void test_request_headers_conditions(abts_case *tc, void *data)
+{
+    static const test_header_t none[] = {{NULL, NULL}};
+    static const test_header_t if_none_match[] = {{"If-None-Match", "\"abc123\""}, {NULL, NULL}};
+    static const test_header_t if_none_match_star[] = {{"if-none-match", "*"}, {NULL, NULL}};
+    static const test_header_t if_match[] = {{"If-Match", "\"abc123\""}, {NULL, NULL}};
+    static const test_header_t if_modified_since[] = {{"If-Modified-Since", "Tue, 01 Oct 2024 10:00:00 GMT"}, {NULL, NULL}};
+    static const test_header_t if_unmodified_since[] = {{"If-Unmodified-Since", "Tue, 01 Oct 2024 10:00:00 GMT"}, {NULL, NULL}};
+    /* If-None-Match takes precedence over If-Modified-Since */
+    static const test_header_t both[] = {
+        {"If-None-Match", "\"xyz\""},
+        {"If-Modified-Since", "Tue, 01 Oct 2024 10:00:00 GMT"},
+        {NULL, NULL}
+    };
+    static const time_t ims = 1727776800; /* Tue, 01 Oct 2024 10:00:00 GMT */
+    msaf_request_headers_t index;
+    ogs_hash_t *headers;
+
+    headers = _make_headers(none);
+    msaf_request_headers_index(&index, headers);
+    ABTS_FALSE(tc, msaf_request_headers_has_conditions(&index));
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_CONDITION_NONE, msaf_request_headers_conditions(&index, true, "abc123", ims));
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_CONDITION_NONE, msaf_request_headers_conditions(&index, false, NULL, 0));
+    ogs_hash_destroy(headers);
+
+    headers = _make_headers(if_none_match);
+    msaf_request_headers_index(&index, headers);
+    ABTS_TRUE(tc, msaf_request_headers_has_conditions(&index));
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_CONDITION_NOT_MODIFIED, msaf_request_headers_conditions(&index, true, "abc123", ims));
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_CONDITION_FAILED, msaf_request_headers_conditions(&index, false, "abc123", ims));
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_CONDITION_NONE, msaf_request_headers_conditions(&index, true, "def456", ims));
+    ogs_hash_destroy(headers);
+
+    headers = _make_headers(if_none_match_star);
+    msaf_request_headers_index(&index, headers);
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_CONDITION_FAILED, msaf_request_headers_conditions(&index, false, "abc123", ims));
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_CONDITION_NONE, msaf_request_headers_conditions(&index, false, NULL, 0));
+    ogs_hash_destroy(headers);
+
+    headers = _make_headers(if_match);
+    msaf_request_headers_index(&index, headers);
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_CONDITION_NONE, msaf_request_headers_conditions(&index, false, "abc123", ims));
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_CONDITION_FAILED, msaf_request_headers_conditions(&index, false, "def456", ims));
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_CONDITION_FAILED, msaf_request_headers_conditions(&index, false, NULL, 0));
+    ogs_hash_destroy(headers);
+
+    headers = _make_headers(if_modified_since);
+    msaf_request_headers_index(&index, headers);
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_CONDITION_NOT_MODIFIED, msaf_request_headers_conditions(&index, true, "abc123", ims));
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_CONDITION_NOT_MODIFIED, msaf_request_headers_conditions(&index, true, "abc123", ims - 60));
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_CONDITION_NONE, msaf_request_headers_conditions(&index, true, "abc123", ims + 1));
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_CONDITION_NONE, msaf_request_headers_conditions(&index, true, "abc123", 0));
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_CONDITION_NONE, msaf_request_headers_conditions(&index, false, "abc123", ims));
+    ogs_hash_destroy(headers);
+
+    headers = _make_headers(if_unmodified_since);
+    msaf_request_headers_index(&index, headers);
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_CONDITION_NONE, msaf_request_headers_conditions(&index, false, "abc123", ims));
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_CONDITION_FAILED, msaf_request_headers_conditions(&index, false, "abc123", ims + 1));
+    ogs_hash_destroy(headers);
+
+    headers = _make_headers(both);
+    msaf_request_headers_index(&index, headers);
+    ABTS_INT_EQUAL(tc, MSAF_REQUEST_CONDITION_NONE, msaf_request_headers_conditions(&index, true, "abc123", ims - 60));
+    ogs_hash_destroy(headers);
+}
+
+/* Building the index once should cost no more than the handlers' previous per-header scans of the request */
+#define REQUEST_HEADERS_BENCH_REQUESTS 100000
+
+static const char *_scan_header(ogs_hash_t *headers, const char *name, long long *visited)
+{
+    ogs_hash_index_t *hi;
+
+    for (hi = ogs_hash_first(headers); hi; hi = ogs_hash_next(hi)) {
+        (*visited)++;
+        if (!strcasecmp(ogs_hash_this_key(hi), name)) return ogs_hash_this_val(hi);
+    }
+
+    return NULL;
+}
+
+static long long _elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+    return ((end->tv_sec - start->tv_sec) * 1000000000LL + (end->tv_nsec - start->tv_nsec)) / REQUEST_HEADERS_BENCH_REQUESTS;
+}
+
+static void test_request_headers_bench(abts_case *tc, void *data)
+{
+    static const struct {
+        const char *label;
+        const test_header_t *headers;
+    } sets[] = {
+        {"HTTP/1.1", http1_headers},
+        {"HTTP/2", http2_headers}
+    };
+    int i, j;
+
+    for (i = 0; i < sizeof(sets)/sizeof(sets[0]); i++) {
+        ogs_hash_t *headers = _make_headers(sets[i].headers);
+        struct timespec start, end;
+        long long ns_index, ns_scan;
+        long long visited_scan = 0;
+        int found_index = 0, found_scan = 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (j = 0; j < REQUEST_HEADERS_BENCH_REQUESTS; j++) {
+            msaf_request_headers_t index;
+
+            msaf_request_headers_index(&index, headers);
+            if (msaf_request_headers_get(&index, MSAF_REQUEST_HEADER_CONTENT_TYPE)) found_index++;
+            if (msaf_request_headers_host(&index)) found_index++;
+            if (msaf_request_headers_get(&index, MSAF_REQUEST_HEADER_ACCEPT_ENCODING)) found_index++;
+            if (msaf_request_headers_get(&index, MSAF_REQUEST_HEADER_IF_NONE_MATCH)) found_index++;
+            if (msaf_request_headers_get(&index, MSAF_REQUEST_HEADER_IF_MODIFIED_SINCE)) found_index++;
+            if (msaf_request_headers_get(&index, MSAF_REQUEST_HEADER_X_FORWARDED_FOR)) found_index++;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        ns_index = _elapsed_ns(&start, &end);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (j = 0; j < REQUEST_HEADERS_BENCH_REQUESTS; j++) {
+            if (_scan_header(headers, "Content-Type", &visited_scan)) found_scan++;
+            if (_scan_header(headers, "Host", &visited_scan) || _scan_header(headers, ":authority", &visited_scan)) found_scan++;
+            if (_scan_header(headers, "Accept-Encoding", &visited_scan)) found_scan++;
+            if (_scan_header(headers, "If-None-Match", &visited_scan)) found_scan++;
+            if (_scan_header(headers, "If-Modified-Since", &visited_scan)) found_scan++;
+            if (_scan_header(headers, "X-Forwarded-For", &visited_scan)) found_scan++;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        ns_scan = _elapsed_ns(&start, &end);
+
+        ogs_info("%s request headers: index %lld ns/request, per-header scans %lld ns/request", sets[i].label, ns_index,
+                 ns_scan);
+
+        ABTS_INT_EQUAL(tc, found_scan, found_index);
+        /* timings are only reported, the index visits each header once per request where the scans visit them repeatedly */
+        ABTS_TRUE(tc, ogs_hash_count(headers) < visited_scan / REQUEST_HEADERS_BENCH_REQUESTS);
+
+        ogs_hash_destroy(headers);
+    }
+}
+
+static struct {
+    void (*func)(abts_case *tc, void *data);
+} test_cases[] = {
+    {test_request_headers_lookup},
+    {test_request_headers_index},
+    {test_request_headers_etag_list},
+    {test_request_headers_conditions},
+    {test_request_headers_bench}
+};
+
+abts_suite *test_request_headers(abts_suite *suite)
+{
+    int i;
+
+    suite = ADD_SUITE(suite)
+
+    for (i=0; i<(sizeof(test_cases)/sizeof(test_cases[0])); i++) {
+        abts_run_test(suite, test_cases[i].func, NULL);
+    }
+
+    return suite;
+}
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -8,17 +8,24 @@
  * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 */
 
+/* System includes */
+#include <time.h>
+#include <zlib.h>
+
 /* Open5GS includes */
 #include "test-common.h"
 
 /* MSAF includes */
 #include "sai-cache.h"
+#include "content-encoding.h"
+#include "json-format.h"
 #include "openapi/model/msaf_api_service_access_information_resource.h"
 
 /* Test includes */
 #include "sai-cache-test.h"
 
 #define ABTS_PTR_NULL(a, b) ABTS_PTR_EQUAL(a, b, NULL)
+#define ABTS_FALSE(a, b) ABTS_TRUE(a, !(b))
 
 #ifdef __cplusplus
 extern "C" {
@@ -35,7 +42,8 @@ static void test_sai_cache_create(abts_case *tc, void *data)
     *((msaf_sai_cache_t**)data) = cache;
 }
 
-static void test_sai_cache_add(abts_case *tc, void *data)
+/* SAI with network assistance pointing at the AF at http[s]://authority */
+static msaf_api_service_access_information_resource_t *_make_test_sai_for(abts_case *tc, bool tls, const char *authority)
 {
     msaf_api_service_access_information_resource_t *sai;
     msaf_api_service_access_information_resource_streaming_access_t *streams = NULL;
@@ -43,8 +51,6 @@ static void test_sai_cache_add(abts_case *tc, void *data)
     OpenAPI_list_t *entry_points;
     OpenAPI_list_t *dash_profiles;
     OpenAPI_list_t *nac_addresses;
-    msaf_sai_cache_t *cache = *((msaf_sai_cache_t**)data);
-    ABTS_PTR_NOTNULL(tc, cache);
 
     dash_profiles = OpenAPI_list_create();
     ABTS_PTR_NOTNULL(tc, dash_profiles);
@@ -60,7 +66,7 @@ static void test_sai_cache_add(abts_case *tc, void *data)
 
     nac_addresses = OpenAPI_list_create();
     ABTS_PTR_NOTNULL(tc, nac_addresses);
-    OpenAPI_list_add(nac_addresses, ogs_strdup("http://af.example.com:9876/3gpp-m5/v2/"));
+    OpenAPI_list_add(nac_addresses, ogs_msprintf("http%s://%s/3gpp-m5/v2/", tls?"s":"", authority));
 
     nac = msaf_api_service_access_information_resource_network_assistance_configuration_create(nac_addresses);
     ABTS_PTR_NOTNULL(tc, nac);
@@ -68,7 +74,23 @@ static void test_sai_cache_add(abts_case *tc, void *data)
     sai = msaf_api_service_access_information_resource_create(ogs_strdup("Provisioning-Session-Id"), msaf_api_provisioning_session_type_DOWNLINK, streams, NULL, NULL, NULL, nac, NULL);
     ABTS_PTR_NOTNULL(tc, sai);
 
-    ABTS_TRUE(tc, msaf_sai_cache_add(cache, true, "af.example.com:443", sai));
+    return sai;
+}
+
+static msaf_api_service_access_information_resource_t *_make_test_sai(abts_case *tc)
+{
+    return _make_test_sai_for(tc, false, "af.example.com:9876");
+}
+
+static void test_sai_cache_add(abts_case *tc, void *data)
+{
+    msaf_api_service_access_information_resource_t *sai;
+    msaf_sai_cache_t *cache = *((msaf_sai_cache_t**)data);
+    ABTS_PTR_NOTNULL(tc, cache);
+
+    sai = _make_test_sai(tc);
+
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_add(cache, true, "af.example.com:443", sai));
 
     msaf_api_service_access_information_resource_free(sai);
 }
@@ -105,6 +127,233 @@ static void test_sai_cache_find_not_exists2(abts_case *tc, void *data)
     ABTS_PTR_NULL(tc, entry);
 }
 
+static void test_sai_cache_add_replace(abts_case *tc, void *data)
+{
+    /* replacing an entry keeps a single cache entry for the key */
+    msaf_api_service_access_information_resource_t *sai;
+    const msaf_sai_cache_entry_t *entry;
+    msaf_sai_cache_t *cache = *((msaf_sai_cache_t**)data);
+    ABTS_PTR_NOTNULL(tc, cache);
+
+    sai = _make_test_sai(tc);
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_add(cache, true, "af.example.com:443", sai));
+    msaf_api_service_access_information_resource_free(sai);
+
+    ABTS_INT_EQUAL(tc, 1, msaf_sai_cache_count(cache));
+    entry = msaf_sai_cache_find(cache, true, "af.example.com:443");
+    ABTS_PTR_NOTNULL(tc, entry);
+    ABTS_PTR_NOTNULL(tc, entry->sai_body);
+    ABTS_PTR_NOTNULL(tc, entry->hash);
+}
+
+static void test_sai_cache_add_other_tls(abts_case *tc, void *data)
+{
+    /* same authority without TLS is a separate entry */
+    msaf_api_service_access_information_resource_t *sai;
+    msaf_sai_cache_t *cache = *((msaf_sai_cache_t**)data);
+    ABTS_PTR_NOTNULL(tc, cache);
+
+    sai = _make_test_sai(tc);
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_add(cache, false, "af.example.com:443", sai));
+    msaf_api_service_access_information_resource_free(sai);
+
+    ABTS_INT_EQUAL(tc, 2, msaf_sai_cache_count(cache));
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_find(cache, false, "af.example.com:443"));
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_find(cache, true, "af.example.com:443"));
+}
+
+static void test_sai_cache_entry_ref(abts_case *tc, void *data)
+{
+    /* a referenced entry outlives its removal from the cache */
+    msaf_api_service_access_information_resource_t *sai;
+    const msaf_sai_cache_entry_t *found;
+    msaf_sai_cache_entry_t *entry;
+    msaf_sai_cache_t *cache = *((msaf_sai_cache_t**)data);
+    ABTS_PTR_NOTNULL(tc, cache);
+
+    found = msaf_sai_cache_find(cache, false, "af.example.com:443");
+    ABTS_PTR_NOTNULL(tc, found);
+    ABTS_INT_EQUAL(tc, strlen(found->sai_body), found->sai_body_len);
+    ABTS_TRUE(tc, strcmp(found->last_modified + strlen(found->last_modified) - 4, " GMT") == 0);
+
+    entry = msaf_sai_cache_entry_ref(found);
+    ABTS_PTR_EQUAL(tc, found, entry);
+    ABTS_INT_EQUAL(tc, 2, entry->refs);
+
+    ABTS_TRUE(tc, msaf_sai_cache_del(cache, false, "af.example.com:443"));
+    ABTS_INT_EQUAL(tc, 1, entry->refs);
+    ABTS_PTR_NOTNULL(tc, entry->sai_body);
+
+    msaf_sai_cache_entry_free(entry);
+
+    /* put it back for the following tests */
+    sai = _make_test_sai(tc);
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_add(cache, false, "af.example.com:443", sai));
+    msaf_api_service_access_information_resource_free(sai);
+}
+
+static void test_sai_cache_del(abts_case *tc, void *data)
+{
+    msaf_sai_cache_t *cache = *((msaf_sai_cache_t**)data);
+    ABTS_PTR_NOTNULL(tc, cache);
+
+    ABTS_TRUE(tc, msaf_sai_cache_del(cache, false, "af.example.com:443"));
+    ABTS_FALSE(tc, msaf_sai_cache_del(cache, false, "af.example.com:443"));
+    ABTS_PTR_NULL(tc, msaf_sai_cache_find(cache, false, "af.example.com:443"));
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_find(cache, true, "af.example.com:443"));
+    ABTS_INT_EQUAL(tc, 1, msaf_sai_cache_count(cache));
+}
+
+static void test_sai_cache_long_authority(abts_case *tc, void *data)
+{
+    /* authorities longer than the key buffer are not cached */
+    msaf_api_service_access_information_resource_t *sai;
+    char *authority;
+    msaf_sai_cache_t *cache = *((msaf_sai_cache_t**)data);
+    ABTS_PTR_NOTNULL(tc, cache);
+
+    authority = ogs_calloc(1, MSAF_SAI_CACHE_MAX_AUTHORITY_LEN + 2);
+    ABTS_PTR_NOTNULL(tc, authority);
+    memset(authority, 'a', MSAF_SAI_CACHE_MAX_AUTHORITY_LEN + 1);
+
+    sai = _make_test_sai(tc);
+    ABTS_PTR_NULL(tc, msaf_sai_cache_add(cache, true, authority, sai));
+    ABTS_PTR_NULL(tc, msaf_sai_cache_find(cache, true, authority));
+
+    /* ...but an authority of exactly the maximum length is */
+    authority[MSAF_SAI_CACHE_MAX_AUTHORITY_LEN] = '\0';
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_add(cache, true, authority, sai));
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_find(cache, true, authority));
+    ABTS_TRUE(tc, msaf_sai_cache_del(cache, true, authority));
+
+    msaf_api_service_access_information_resource_free(sai);
+    ogs_free(authority);
+}
+
+static void test_sai_cache_null_args(abts_case *tc, void *data)
+{
+    /* a missing Host header gives a NULL authority */
+    msaf_sai_cache_t *cache = *((msaf_sai_cache_t**)data);
+    ABTS_PTR_NOTNULL(tc, cache);
+
+    ABTS_PTR_NULL(tc, msaf_sai_cache_find(cache, true, NULL));
+    ABTS_PTR_NULL(tc, msaf_sai_cache_find(NULL, true, "af.example.com:443"));
+    ABTS_FALSE(tc, msaf_sai_cache_del(NULL, true, "af.example.com:443"));
+}
+
+static void test_sai_cache_canonical_authority(abts_case *tc, void *data)
+{
+    /* equivalent authorities share the same entry */
+    char buf[MSAF_SAI_CACHE_MAX_AUTHORITY_LEN+1];
+    msaf_sai_cache_t *cache = *((msaf_sai_cache_t**)data);
+    ABTS_PTR_NOTNULL(tc, cache);
+
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_find(cache, true, "AF.Example.COM:443"));
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_find(cache, true, "af.example.com."));
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_find(cache, true, "af.example.com.:443"));
+    ABTS_PTR_NULL(tc, msaf_sai_cache_find(cache, true, "af.example.com:8443"));
+
+    ABTS_STR_EQUAL(tc, "af.example.com", msaf_sai_cache_canonical_authority(buf, true, "AF.example.com:443"));
+    ABTS_STR_EQUAL(tc, "af.example.com:443", msaf_sai_cache_canonical_authority(buf, false, "AF.example.com:443"));
+    ABTS_STR_EQUAL(tc, "af.example.com", msaf_sai_cache_canonical_authority(buf, false, "af.example.com:80"));
+    ABTS_STR_EQUAL(tc, "[::1]:8080", msaf_sai_cache_canonical_authority(buf, false, "[::1]:8080"));
+    ABTS_STR_EQUAL(tc, "[fe80::1]", msaf_sai_cache_canonical_authority(buf, true, "[FE80::1]:443"));
+    ABTS_STR_EQUAL(tc, "", msaf_sai_cache_canonical_authority(buf, true, NULL));
+
+    /* malformed authorities */
+    ABTS_PTR_NULL(tc, msaf_sai_cache_canonical_authority(buf, true, "af.example.com:44a"));
+    ABTS_PTR_NULL(tc, msaf_sai_cache_canonical_authority(buf, true, "af.example.com:443:1"));
+    ABTS_PTR_NULL(tc, msaf_sai_cache_canonical_authority(buf, true, "af example.com"));
+    ABTS_PTR_NULL(tc, msaf_sai_cache_canonical_authority(buf, true, "user@af.example.com"));
+    ABTS_PTR_NULL(tc, msaf_sai_cache_canonical_authority(buf, true, "[::1"));
+    ABTS_PTR_NULL(tc, msaf_sai_cache_find(cache, true, "af.example.com/"));
+}
+
+static void test_sai_cache_lru_per_session(abts_case *tc, void *data)
+{
+    /* least recently used entry is evicted when the per-session limit is reached */
+    msaf_api_service_access_information_resource_t *sai;
+    msaf_sai_cache_stats_t before, after;
+    msaf_sai_cache_t *cache;
+
+    msaf_sai_cache_set_limits(2, 0);
+    msaf_sai_cache_get_stats(&before);
+
+    cache = msaf_sai_cache_new();
+    ABTS_PTR_NOTNULL(tc, cache);
+    sai = _make_test_sai(tc);
+
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_add(cache, true, "one.example.com", sai));
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_add(cache, true, "two.example.com", sai));
+    /* make "one" the most recently used */
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_find(cache, true, "one.example.com"));
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_add(cache, true, "three.example.com", sai));
+
+    ABTS_INT_EQUAL(tc, 2, msaf_sai_cache_count(cache));
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_find(cache, true, "one.example.com"));
+    ABTS_PTR_NULL(tc, msaf_sai_cache_find(cache, true, "two.example.com"));
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_find(cache, true, "three.example.com"));
+
+    msaf_sai_cache_get_stats(&after);
+    ABTS_TRUE(tc, after.evictions == before.evictions + 1);
+    ABTS_TRUE(tc, after.insertions == before.insertions + 3);
+    ABTS_TRUE(tc, after.hits == before.hits + 3);
+    ABTS_TRUE(tc, after.misses == before.misses + 1);
+    ABTS_TRUE(tc, after.entries == before.entries + 2);
+
+    msaf_sai_cache_free(cache);
+    msaf_api_service_access_information_resource_free(sai);
+
+    msaf_sai_cache_get_stats(&after);
+    ABTS_TRUE(tc, after.entries == before.entries);
+    ABTS_TRUE(tc, after.bytes == before.bytes);
+
+    msaf_sai_cache_set_limits(MSAF_SAI_CACHE_DEFAULT_MAX_ENTRIES_PER_SESSION, MSAF_SAI_CACHE_DEFAULT_MAX_BYTES);
+}
+
+static void test_sai_cache_lru_global(abts_case *tc, void *data)
+{
+    /* the global memory budget evicts across caches, oldest first */
+    msaf_api_service_access_information_resource_t *sai;
+    msaf_sai_cache_stats_t stats;
+    msaf_sai_cache_t *cache1, *cache2;
+    size_t before_bytes, entry_bytes;
+
+    cache1 = msaf_sai_cache_new();
+    cache2 = msaf_sai_cache_new();
+    ABTS_PTR_NOTNULL(tc, cache1);
+    ABTS_PTR_NOTNULL(tc, cache2);
+    sai = _make_test_sai(tc);
+
+    msaf_sai_cache_set_limits(0, 0);
+    msaf_sai_cache_get_stats(&stats);
+    before_bytes = stats.bytes;
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_add(cache1, true, "one.example.com", sai));
+    msaf_sai_cache_get_stats(&stats);
+    entry_bytes = stats.bytes - before_bytes;
+    ABTS_TRUE(tc, entry_bytes > 0);
+
+    /* room for two entries of this size */
+    msaf_sai_cache_set_limits(0, before_bytes + entry_bytes * 2 + entry_bytes / 2);
+
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_add(cache2, true, "two.example.com", sai));
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_add(cache2, true, "three.example.com", sai));
+
+    ABTS_INT_EQUAL(tc, 0, msaf_sai_cache_count(cache1));
+    ABTS_INT_EQUAL(tc, 2, msaf_sai_cache_count(cache2));
+
+    /* an entry bigger than the whole budget is still cached on its own */
+    msaf_sai_cache_set_limits(0, 1);
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_add(cache1, true, "four.example.com", sai));
+    ABTS_PTR_NOTNULL(tc, msaf_sai_cache_find(cache1, true, "four.example.com"));
+
+    msaf_sai_cache_set_limits(MSAF_SAI_CACHE_DEFAULT_MAX_ENTRIES_PER_SESSION, MSAF_SAI_CACHE_DEFAULT_MAX_BYTES);
+
+    msaf_sai_cache_free(cache1);
+    msaf_sai_cache_free(cache2);
+    msaf_api_service_access_information_resource_free(sai);
+}
+
 static void test_sai_cache_clear(abts_case *tc, void *data)
 {
     msaf_sai_cache_t *cache = *((msaf_sai_cache_t**)data);
@@ -132,6 +381,409 @@ static void test_sai_cache_free(abts_case *tc, void *data)
     msaf_sai_cache_free(cache);
 }
 
+/* Lookup cost must not depend on the number of cached authorities */
+#define SAI_CACHE_BENCH_LOOKUPS 100000
+
+static long long _bench_lookups(abts_case *tc, msaf_sai_cache_t *cache, char **authorities, int num_authorities)
+{
+    struct timespec start, end;
+    int i, found = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < SAI_CACHE_BENCH_LOOKUPS; i++) {
+        if (msaf_sai_cache_find(cache, true, authorities[i % num_authorities])) found++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    ABTS_INT_EQUAL(tc, SAI_CACHE_BENCH_LOOKUPS, found);
+
+    return ((end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec)) / SAI_CACHE_BENCH_LOOKUPS;
+}
+
+/* Longest chain of authorities sharing a bucket in a hash table of at least num_authorities buckets, as used by the cache.
+ * This is what a lookup has to walk, the cache keys only add a scheme flag to the canonical authority. */
+static int _longest_hash_chain(abts_case *tc, char **authorities, int num_authorities)
+{
+    unsigned int mask = 15;
+    int *chains;
+    int longest = 0;
+    int i;
+
+    while (mask < (unsigned int)num_authorities) mask = mask * 2 + 1;
+
+    chains = ogs_calloc(mask + 1, sizeof(*chains));
+    ABTS_PTR_NOTNULL(tc, chains);
+
+    for (i = 0; i < num_authorities; i++) {
+        char canonical[MSAF_SAI_CACHE_MAX_AUTHORITY_LEN+1];
+        int klen = OGS_HASH_KEY_STRING;
+        unsigned int bucket;
+
+        ABTS_PTR_NOTNULL(tc, msaf_sai_cache_canonical_authority(canonical, true, authorities[i]));
+        bucket = ogs_hashfunc_default(canonical, &klen) & mask;
+        if (++chains[bucket] > longest) longest = chains[bucket];
+    }
+
+    ogs_free(chains);
+
+    return longest;
+}
+
+static void test_sai_cache_lookup_scaling(abts_case *tc, void *data)
+{
+    static const int sizes[] = {1, 10, 100, 1000, 10000};
+    msaf_api_service_access_information_resource_t *sai;
+    char **authorities;
+    int i, j;
+
+    msaf_sai_cache_set_limits(0, 0);
+
+    sai = _make_test_sai(tc);
+    authorities = ogs_calloc(sizes[sizeof(sizes)/sizeof(sizes[0])-1], sizeof(*authorities));
+    ABTS_PTR_NOTNULL(tc, authorities);
+
+    for (i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++) {
+        msaf_sai_cache_t *cache = msaf_sai_cache_new();
+        ABTS_PTR_NOTNULL(tc, cache);
+
+        for (j = 0; j < sizes[i]; j++) {
+            if (!authorities[j]) authorities[j] = ogs_msprintf("edge-%05i.cdn.example.com:443", j);
+            ABTS_PTR_NOTNULL(tc, msaf_sai_cache_add(cache, true, authorities[j], sai));
+        }
+
+        /* timings are only reported, they depend on the machine and its load */
+        ogs_info("SAI cache lookup with %5i authorities: %lld ns/lookup", sizes[i],
+                 _bench_lookups(tc, cache, authorities, sizes[i]));
+
+        /* each lookup compares against a handful of entries however many authorities are cached */
+        ABTS_TRUE(tc, _longest_hash_chain(tc, authorities, sizes[i]) <= 8);
+
+        msaf_sai_cache_free(cache);
+    }
+
+    for (j = 0; j < sizes[sizeof(sizes)/sizeof(sizes[0])-1]; j++) {
+        if (authorities[j]) ogs_free(authorities[j]);
+    }
+    ogs_free(authorities);
+    msaf_api_service_access_information_resource_free(sai);
+
+    msaf_sai_cache_set_limits(MSAF_SAI_CACHE_DEFAULT_MAX_ENTRIES_PER_SESSION, MSAF_SAI_CACHE_DEFAULT_MAX_BYTES);
+}
+
+static void test_sai_cache_template(abts_case *tc, void *data)
+{
+    /* splicing into the template gives the same body and ETag as a full render */
+    static const struct {
+        bool tls;
+        const char *authority;
+        const char *canonical;
+    } variants[] = {
+        {true, "AF.Example.COM:443", "af.example.com"},
+        {false, "af.example.com:8080", "af.example.com:8080"},
+        {true, "[2001:db8::1]:8443", "[2001:db8::1]:8443"}
+    };
+    msaf_api_service_access_information_resource_t *sai;
+    msaf_sai_cache_t *cache;
+    int i;
+
+    cache = msaf_sai_cache_new();
+    ABTS_PTR_NOTNULL(tc, cache);
+
+    ABTS_FALSE(tc, msaf_sai_cache_has_template(cache));
+    ABTS_PTR_NULL(tc, msaf_sai_cache_add_from_template(cache, true, "af.example.com"));
+
+    sai = _make_test_sai_for(tc, false, MSAF_SAI_CACHE_TEMPLATE_AUTHORITY);
+    ABTS_TRUE(tc, msaf_sai_cache_set_template(cache, sai));
+    msaf_api_service_access_information_resource_free(sai);
+    ABTS_TRUE(tc, msaf_sai_cache_has_template(cache));
+
+    for (i = 0; i < sizeof(variants)/sizeof(variants[0]); i++) {
+        const msaf_sai_cache_entry_t *spliced;
+        msaf_sai_cache_entry_t *rendered;
+
+        spliced = msaf_sai_cache_add_from_template(cache, variants[i].tls, variants[i].authority);
+        ABTS_PTR_NOTNULL(tc, spliced);
+        ABTS_PTR_EQUAL(tc, spliced, msaf_sai_cache_find(cache, variants[i].tls, variants[i].canonical));
+
+        sai = _make_test_sai_for(tc, variants[i].tls, variants[i].canonical);
+        rendered = msaf_sai_cache_entry_new(sai);
+        msaf_api_service_access_information_resource_free(sai);
+
+        ABTS_INT_EQUAL(tc, rendered->sai_body_len, spliced->sai_body_len);
+        ABTS_STR_EQUAL(tc, rendered->sai_body, spliced->sai_body);
+        ABTS_STR_EQUAL(tc, rendered->hash, spliced->hash);
+        ABTS_PTR_NULL(tc, strstr(spliced->sai_body, MSAF_SAI_CACHE_TEMPLATE_AUTHORITY));
+
+        msaf_sai_cache_entry_free(rendered);
+    }
+
+    ABTS_PTR_NULL(tc, msaf_sai_cache_add_from_template(cache, true, "bad host"));
+
+    /* clearing the cache invalidates the template */
+    msaf_sai_cache_clear(cache);
+    ABTS_FALSE(tc, msaf_sai_cache_has_template(cache));
+
+    msaf_sai_cache_free(cache);
+}
+
+static void test_sai_cache_regenerate(abts_case *tc, void *data)
+{
+    /* after invalidation the old entries are served until refreshed from a new template */
+    static const char *authorities[] = {"edge-1.cdn.example.com", "edge-2.cdn.example.com", "edge-3.cdn.example.com"};
+    msaf_api_service_access_information_resource_t *sai;
+    const msaf_sai_cache_entry_t *old_entries[3];
+    msaf_sai_cache_t *cache;
+    uint64_t generation;
+    int i;
+
+    cache = msaf_sai_cache_new();
+    ABTS_PTR_NOTNULL(tc, cache);
+
+    sai = _make_test_sai_for(tc, false, MSAF_SAI_CACHE_TEMPLATE_AUTHORITY);
+    msaf_sai_cache_set_template(cache, sai);
+    msaf_api_service_access_information_resource_free(sai);
+
+    for (i = 0; i < 3; i++) {
+        old_entries[i] = msaf_sai_cache_add_from_template(cache, true, authorities[i]);
+        ABTS_PTR_NOTNULL(tc, old_entries[i]);
+    }
+
+    generation = msaf_sai_cache_generation(cache);
+    ABTS_TRUE(tc, msaf_sai_cache_invalidate(cache) == generation + 1);
+    ABTS_FALSE(tc, msaf_sai_cache_has_template(cache));
+
+    /* the previous generation is still served */
+    for (i = 0; i < 3; i++) {
+        ABTS_PTR_EQUAL(tc, old_entries[i], msaf_sai_cache_find(cache, true, authorities[i]));
+    }
+
+    /* nothing to regenerate from yet */
+    ABTS_INT_EQUAL(tc, 0, msaf_sai_cache_refresh(cache));
+
+    sai = _make_test_sai_for(tc, false, MSAF_SAI_CACHE_TEMPLATE_AUTHORITY);
+    msaf_sai_cache_set_template(cache, sai);
+    msaf_api_service_access_information_resource_free(sai);
+
+    ABTS_INT_EQUAL(tc, 3, msaf_sai_cache_refresh(cache));
+    ABTS_INT_EQUAL(tc, 3, msaf_sai_cache_count(cache));
+    for (i = 0; i < 3; i++) {
+        const msaf_sai_cache_entry_t *entry = msaf_sai_cache_find(cache, true, authorities[i]);
+        ABTS_PTR_NOTNULL(tc, entry);
+        ABTS_TRUE(tc, entry != old_entries[i]);
+        ABTS_PTR_NOTNULL(tc, strstr(entry->sai_body, authorities[i]));
+    }
+
+    /* already current */
+    ABTS_INT_EQUAL(tc, 0, msaf_sai_cache_refresh(cache));
+
+    msaf_sai_cache_free(cache);
+}
+
+#define SAI_TEMPLATE_BENCH_AUTHORITIES 1000
+
+static void test_sai_cache_template_benchmark(abts_case *tc, void *data)
+{
+    /* compare generating a variant per authority with splicing into the template */
+    msaf_api_service_access_information_resource_t *sai;
+    msaf_sai_cache_t *cache;
+    struct timespec start, end;
+    char **authorities;
+    long long ns_full, ns_splice;
+    int i;
+
+    msaf_sai_cache_set_limits(0, 0);
+
+    authorities = ogs_calloc(SAI_TEMPLATE_BENCH_AUTHORITIES, sizeof(*authorities));
+    ABTS_PTR_NOTNULL(tc, authorities);
+    for (i = 0; i < SAI_TEMPLATE_BENCH_AUTHORITIES; i++) {
+        authorities[i] = ogs_msprintf("edge-%05i.cdn.example.com", i);
+    }
+
+    cache = msaf_sai_cache_new();
+    ABTS_PTR_NOTNULL(tc, cache);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < SAI_TEMPLATE_BENCH_AUTHORITIES; i++) {
+        sai = _make_test_sai_for(tc, true, authorities[i]);
+        ABTS_PTR_NOTNULL(tc, msaf_sai_cache_add(cache, true, authorities[i], sai));
+        msaf_api_service_access_information_resource_free(sai);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    ns_full = ((end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec)) / SAI_TEMPLATE_BENCH_AUTHORITIES;
+    msaf_sai_cache_free(cache);
+
+    cache = msaf_sai_cache_new();
+    ABTS_PTR_NOTNULL(tc, cache);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    sai = _make_test_sai_for(tc, false, MSAF_SAI_CACHE_TEMPLATE_AUTHORITY);
+    msaf_sai_cache_set_template(cache, sai);
+    msaf_api_service_access_information_resource_free(sai);
+    for (i = 0; i < SAI_TEMPLATE_BENCH_AUTHORITIES; i++) {
+        ABTS_PTR_NOTNULL(tc, msaf_sai_cache_add_from_template(cache, true, authorities[i]));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    ns_splice = ((end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec)) / SAI_TEMPLATE_BENCH_AUTHORITIES;
+    msaf_sai_cache_free(cache);
+
+    ogs_info("SAI generation for %i authorities: full render %lld ns/authority, template splice %lld ns/authority",
+             SAI_TEMPLATE_BENCH_AUTHORITIES, ns_full, ns_splice);
+
+    for (i = 0; i < SAI_TEMPLATE_BENCH_AUTHORITIES; i++) {
+        ogs_free(authorities[i]);
+    }
+    ogs_free(authorities);
+
+    msaf_sai_cache_set_limits(MSAF_SAI_CACHE_DEFAULT_MAX_ENTRIES_PER_SESSION, MSAF_SAI_CACHE_DEFAULT_MAX_BYTES);
+}
+
+#define SAI_JSON_FORMAT_BENCH_DOCUMENTS 1000
+
+static void test_sai_cache_json_format(abts_case *tc, void *data)
+{
+    /* ETags are the same in both output formats, compact bodies are smaller */
+    static const msaf_json_format_t formats[] = {MSAF_JSON_FORMAT_PRETTY, MSAF_JSON_FORMAT_COMPACT};
+    msaf_api_service_access_information_resource_t *sai;
+    msaf_sai_cache_entry_t *entries[2];
+    const msaf_sai_cache_entry_t *spliced[2];
+    msaf_json_format_t saved_format = msaf_json_format_get();
+    int i, j;
+
+    sai = _make_test_sai_for(tc, true, "af.example.com");
+
+    for (i = 0; i < 2; i++) {
+        msaf_api_service_access_information_resource_t *template_sai;
+        msaf_sai_cache_t *cache;
+        struct timespec start, end;
+        long long ns;
+
+        msaf_json_format_set(formats[i]);
+
+        entries[i] = msaf_sai_cache_entry_new(sai);
+        ABTS_PTR_NOTNULL(tc, entries[i]);
+
+        cache = msaf_sai_cache_new();
+        template_sai = _make_test_sai_for(tc, false, MSAF_SAI_CACHE_TEMPLATE_AUTHORITY);
+        msaf_sai_cache_set_template(cache, template_sai);
+        msaf_api_service_access_information_resource_free(template_sai);
+        spliced[i] = msaf_sai_cache_add_from_template(cache, true, "af.example.com");
+        ABTS_PTR_NOTNULL(tc, spliced[i]);
+        ABTS_STR_EQUAL(tc, entries[i]->sai_body, spliced[i]->sai_body);
+        ABTS_STR_EQUAL(tc, entries[i]->hash, spliced[i]->hash);
+        msaf_sai_cache_free(cache);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (j = 0; j < SAI_JSON_FORMAT_BENCH_DOCUMENTS; j++) {
+            msaf_sai_cache_entry_free(msaf_sai_cache_entry_new(sai));
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        ns = ((end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec)) / SAI_JSON_FORMAT_BENCH_DOCUMENTS;
+
+        ogs_info("SAI in %s JSON: %zu bytes, %lld ns/document", msaf_json_format_name(formats[i]), entries[i]->sai_body_len, ns);
+    }
+
+    ABTS_STR_EQUAL(tc, entries[0]->hash, entries[1]->hash);
+    ABTS_TRUE(tc, entries[1]->sai_body_len < entries[0]->sai_body_len);
+    ABTS_PTR_NULL(tc, strchr(entries[1]->sai_body, '\n'));
+
+    msaf_sai_cache_entry_free(entries[0]);
+    msaf_sai_cache_entry_free(entries[1]);
+    msaf_api_service_access_information_resource_free(sai);
+
+    msaf_json_format_set(saved_format);
+}
+
+static void test_sai_cache_gzip_variant(abts_case *tc, void *data)
+{
+    /* entries carry a gzip variant which decompresses to the identity body */
+    static const struct {
+        const char *accept_encoding;
+        msaf_content_encoding_t expected;
+    } negotiations[] = {
+        {NULL, MSAF_CONTENT_ENCODING_IDENTITY},
+        {"", MSAF_CONTENT_ENCODING_IDENTITY},
+        {"gzip", MSAF_CONTENT_ENCODING_GZIP},
+        {"br, GZIP, deflate", MSAF_CONTENT_ENCODING_GZIP},
+        {"gzip;q=0", MSAF_CONTENT_ENCODING_IDENTITY},
+        {"gzip;q=0.5, identity", MSAF_CONTENT_ENCODING_IDENTITY},
+        {"identity;q=0.1, gzip ; q=0.8", MSAF_CONTENT_ENCODING_GZIP},
+        {"*", MSAF_CONTENT_ENCODING_GZIP},
+        {"*;q=0, identity", MSAF_CONTENT_ENCODING_IDENTITY},
+        {"x-gzip", MSAF_CONTENT_ENCODING_GZIP},
+        {"deflate", MSAF_CONTENT_ENCODING_IDENTITY}
+    };
+    msaf_api_service_access_information_resource_t *sai;
+    msaf_sai_cache_t *cache;
+    const msaf_sai_cache_entry_t *spliced;
+    msaf_sai_cache_entry_t *entry;
+    msaf_content_variant_t variant = {NULL, 0, NULL, NULL};
+    char *short_body;
+    char *gzip_etag;
+    char *inflated;
+    z_stream strm;
+    int i;
+
+    for (i = 0; i < sizeof(negotiations)/sizeof(negotiations[0]); i++) {
+        ABTS_INT_EQUAL(tc, negotiations[i].expected, msaf_content_encoding_select(negotiations[i].accept_encoding));
+    }
+
+    sai = _make_test_sai_for(tc, true, "af.example.com");
+    entry = msaf_sai_cache_entry_new(sai);
+    msaf_api_service_access_information_resource_free(sai);
+    ABTS_PTR_NOTNULL(tc, entry);
+
+    if (entry->sai_body_len >= MSAF_CONTENT_ENCODING_MIN_LENGTH) {
+        ABTS_PTR_NOTNULL(tc, entry->gzip.body);
+        ABTS_TRUE(tc, entry->gzip.length < entry->sai_body_len);
+
+        gzip_etag = ogs_msprintf("%s-gzip", entry->hash);
+        ABTS_STR_EQUAL(tc, gzip_etag, entry->gzip.etag);
+        ogs_free(gzip_etag);
+
+        inflated = ogs_calloc(1, entry->sai_body_len + 1);
+        memset(&strm, 0, sizeof(strm));
+        ABTS_INT_EQUAL(tc, Z_OK, inflateInit2(&strm, 15 + 16));
+        strm.next_in = (Bytef*)entry->gzip.body;
+        strm.avail_in = entry->gzip.length;
+        strm.next_out = (Bytef*)inflated;
+        strm.avail_out = entry->sai_body_len + 1;
+        ABTS_INT_EQUAL(tc, Z_STREAM_END, inflate(&strm, Z_FINISH));
+        ABTS_INT_EQUAL(tc, entry->sai_body_len, strm.total_out);
+        ABTS_STR_EQUAL(tc, entry->sai_body, inflated);
+        inflateEnd(&strm);
+        ogs_free(inflated);
+
+        /* spliced entries get the same variant */
+        cache = msaf_sai_cache_new();
+        sai = _make_test_sai_for(tc, false, MSAF_SAI_CACHE_TEMPLATE_AUTHORITY);
+        msaf_sai_cache_set_template(cache, sai);
+        msaf_api_service_access_information_resource_free(sai);
+        spliced = msaf_sai_cache_add_from_template(cache, true, "af.example.com");
+        ABTS_PTR_NOTNULL(tc, spliced);
+        ABTS_INT_EQUAL(tc, entry->gzip.length, spliced->gzip.length);
+        ABTS_TRUE(tc, memcmp(entry->gzip.body, spliced->gzip.body, entry->gzip.length) == 0);
+        ABTS_STR_EQUAL(tc, entry->gzip.etag, spliced->gzip.etag);
+        msaf_sai_cache_free(cache);
+
+        /* variants are reused while the source ETag is unchanged */
+        ABTS_TRUE(tc, msaf_content_variant_gzip(&variant, entry->sai_body, entry->sai_body_len, entry->hash));
+        inflated = variant.body;
+        ABTS_TRUE(tc, msaf_content_variant_gzip(&variant, entry->sai_body, entry->sai_body_len, entry->hash));
+        ABTS_PTR_EQUAL(tc, inflated, variant.body);
+        ABTS_TRUE(tc, msaf_content_variant_gzip(&variant, entry->sai_body, entry->sai_body_len, "other-etag"));
+        ABTS_STR_EQUAL(tc, "other-etag-gzip", variant.etag);
+        msaf_content_variant_clear(&variant);
+    }
+
+    /* short bodies are not compressed */
+    short_body = ogs_strdup("{\"streamingAccess\":{}}");
+    ABTS_FALSE(tc, msaf_content_variant_gzip(&variant, short_body, strlen(short_body), "short"));
+    ABTS_PTR_NULL(tc, variant.body);
+    ABTS_PTR_NULL(tc, variant.etag);
+    msaf_content_variant_clear(&variant);
+    ogs_free(short_body);
+
+    msaf_sai_cache_entry_free(entry);
+}
+
 static struct {
     void (*func)(abts_case *tc, void *data);
 } test_cases[] = {
@@ -140,9 +792,24 @@ static struct {
     {test_sai_cache_find_exists},
     {test_sai_cache_find_not_exists1},
     {test_sai_cache_find_not_exists2},
+    {test_sai_cache_add_replace},
+    {test_sai_cache_add_other_tls},
+    {test_sai_cache_entry_ref},
+    {test_sai_cache_del},
+    {test_sai_cache_long_authority},
+    {test_sai_cache_null_args},
+    {test_sai_cache_canonical_authority},
     {test_sai_cache_clear},
     {test_sai_cache_find_removed},
-    {test_sai_cache_free}
+    {test_sai_cache_lru_per_session},
+    {test_sai_cache_lru_global},
+    {test_sai_cache_free},
+    {test_sai_cache_lookup_scaling},
+    {test_sai_cache_template},
+    {test_sai_cache_regenerate},
+    {test_sai_cache_template_benchmark},
+    {test_sai_cache_json_format},
+    {test_sai_cache_gzip_variant}
 };
 
 abts_suite *test_sai_cache(abts_suite *suite)
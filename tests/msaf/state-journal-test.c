@@ -0,0 +1,528 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Author: David Waring
+ * Copyright: (C) 2024 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+/* System includes */
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Open5GS includes */
+#include "test-common.h"
+
+/* MSAF includes */
+#include "state-journal.h"
+
+/* Test includes */
+#include "state-journal-test.h"
+
+#define ABTS_FALSE(a, b) ABTS_TRUE(a, !(b))
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+#define TEST_MAX_RECORDS 16
+
+/* Records seen by _collect(), as "<type>:<payload>" */
+typedef struct test_replay_s {
+    char *records[TEST_MAX_RECORDS];
+    int count;
+    int seen;
+} test_replay_t;
+
+static char *_make_directory(void)
+{
+    char *directory = ogs_strdup("/tmp/msaf-state-journal-XXXXXX");
+    ogs_assert(mkdtemp(directory));
+    return directory;
+}
+
+static void _remove_directory(const char *path)
+{
+    DIR *dir;
+    struct dirent *entry;
+
+    dir = opendir(path);
+    if (!dir) return;
+    while ((entry = readdir(dir)) != NULL) {
+        char *child;
+        if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) continue;
+        child = ogs_msprintf("%s/%s", path, entry->d_name);
+        unlink(child);
+        ogs_free(child);
+    }
+    closedir(dir);
+    rmdir(path);
+}
+
+static void _replay_clear(test_replay_t *replay)
+{
+    int i;
+
+    for (i = 0; i < replay->count; i++) ogs_free(replay->records[i]);
+    memset(replay, 0, sizeof(*replay));
+}
+
+static bool _collect(const char *type, const char *payload, size_t payload_len, void *data)
+{
+    test_replay_t *replay = data;
+
+    replay->seen++;
+    /* the payload must be nul terminated where its length says */
+    if (strlen(payload) != payload_len) return false;
+    if (replay->count < TEST_MAX_RECORDS) {
+        replay->records[replay->count++] = ogs_msprintf("%s:%s", type, payload);
+    }
+
+    return true;
+}
+
+static bool _snapshot_state(msaf_state_journal_t *journal, void *data)
+{
+    const char **state = data;
+
+    for (; *state; state += 2) {
+        if (!msaf_state_journal_snapshot_add(journal, state[0], state[1], strlen(state[1]))) return false;
+    }
+
+    return true;
+}
+
+static msaf_state_journal_t *_open(const char *directory, test_replay_t *replay)
+{
+    msaf_state_journal_config_t config;
+    msaf_state_journal_t *journal;
+
+    msaf_state_journal_config_init(&config);
+    config.directory = ogs_strdup(directory);
+    config.fsync = false;
+    config.snapshot_after = 4;
+    journal = msaf_state_journal_open(&config);
+    msaf_state_journal_config_clear(&config);
+
+    if (!msaf_state_journal_load(journal, _collect, replay)) {
+        msaf_state_journal_close(journal);
+        return NULL;
+    }
+
+    return journal;
+}
+
+static bool _append(msaf_state_journal_t *journal, const char *type, const char *payload)
+{
+    return msaf_state_journal_append(journal, type, payload, strlen(payload));
+}
+
+static char *_file_path(const char *directory, const char *name)
+{
+    return ogs_msprintf("%s/%s", directory, name);
+}
+
+static long _file_size(const char *directory, const char *name)
+{
+    struct stat statbuf;
+    char *path = _file_path(directory, name);
+    int rv = stat(path, &statbuf);
+
+    ogs_free(path);
+
+    return rv < 0 ? -1 : (long)statbuf.st_size;
+}
+
+static char *_file_read(const char *directory, const char *name, size_t *size)
+{
+    char *path = _file_path(directory, name);
+    FILE *file = fopen(path, "rb");
+    char *contents;
+    long length;
+
+    ogs_free(path);
+    ogs_assert(file);
+    fseek(file, 0, SEEK_END);
+    length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    contents = ogs_malloc(length + 1);
+    ogs_assert(fread(contents, 1, length, file) == (size_t)length);
+    contents[length] = '\0';
+    fclose(file);
+    *size = length;
+
+    return contents;
+}
+
+static void _file_write(const char *directory, const char *name, const char *contents, size_t size, const char *mode)
+{
+    char *path = _file_path(directory, name);
+    FILE *file = fopen(path, mode);
+
+    ogs_free(path);
+    ogs_assert(file);
+    ogs_assert(fwrite(contents, 1, size, file) == size);
+    fclose(file);
+}
+
+static void test_state_journal_round_trip(abts_case *tc, void *data)
+{
+    char *directory = _make_directory();
+    test_replay_t replay = {{NULL}, 0, 0};
+    msaf_state_journal_t *journal;
+
+    /* a missing directory is created and starts empty */
+    {
+        char *subdirectory = ogs_msprintf("%s/state", directory);
+        journal = _open(subdirectory, &replay);
+        ABTS_PTR_NOTNULL(tc, journal);
+        ABTS_INT_EQUAL(tc, 0, replay.seen);
+        ABTS_TRUE(tc, msaf_state_journal_seq(journal) == 0);
+        msaf_state_journal_close(journal);
+        _remove_directory(subdirectory);
+        ogs_free(subdirectory);
+    }
+
+    journal = _open(directory, &replay);
+    ABTS_PTR_NOTNULL(tc, journal);
+    ABTS_TRUE(tc, _append(journal, "session", "{\"id\":\"one\"}"));
+    ABTS_TRUE(tc, _append(journal, "session", "{\"id\":\"two\"}"));
+    ABTS_TRUE(tc, _append(journal, "session-deleted", "{\"id\":\"one\"}"));
+    /* payloads are opaque, including newlines and empty payloads */
+    ABTS_TRUE(tc, _append(journal, "note", "line 1\nline 2"));
+    ABTS_TRUE(tc, _append(journal, "empty", ""));
+    ABTS_TRUE(tc, msaf_state_journal_seq(journal) == 5);
+    ABTS_INT_EQUAL(tc, 5, msaf_state_journal_length(journal));
+    ABTS_TRUE(tc, msaf_state_journal_snapshot_due(journal));
+    msaf_state_journal_close(journal);
+
+    journal = _open(directory, &replay);
+    ABTS_PTR_NOTNULL(tc, journal);
+    ABTS_INT_EQUAL(tc, 5, replay.count);
+    ABTS_STR_EQUAL(tc, "session:{\"id\":\"one\"}", replay.records[0]);
+    ABTS_STR_EQUAL(tc, "session:{\"id\":\"two\"}", replay.records[1]);
+    ABTS_STR_EQUAL(tc, "session-deleted:{\"id\":\"one\"}", replay.records[2]);
+    ABTS_STR_EQUAL(tc, "note:line 1\nline 2", replay.records[3]);
+    ABTS_STR_EQUAL(tc, "empty:", replay.records[4]);
+    ABTS_TRUE(tc, msaf_state_journal_seq(journal) == 5);
+    ABTS_INT_EQUAL(tc, 5, msaf_state_journal_length(journal));
+
+    /* appending carries on from the loaded sequence */
+    ABTS_TRUE(tc, _append(journal, "session", "{\"id\":\"three\"}"));
+    ABTS_TRUE(tc, msaf_state_journal_seq(journal) == 6);
+    msaf_state_journal_close(journal);
+
+    _replay_clear(&replay);
+    journal = _open(directory, &replay);
+    ABTS_INT_EQUAL(tc, 6, replay.count);
+    ABTS_STR_EQUAL(tc, "session:{\"id\":\"three\"}", replay.records[5]);
+    msaf_state_journal_close(journal);
+
+    _replay_clear(&replay);
+    _remove_directory(directory);
+    ogs_free(directory);
+}
+
+static void test_state_journal_snapshot(abts_case *tc, void *data)
+{
+    static const char *state[] = {"session", "{\"id\":\"two\"}", "session", "{\"id\":\"three\"}", NULL};
+    char *directory = _make_directory();
+    test_replay_t replay = {{NULL}, 0, 0};
+    msaf_state_journal_t *journal;
+
+    journal = _open(directory, &replay);
+    ABTS_TRUE(tc, _append(journal, "session", "{\"id\":\"one\"}"));
+    ABTS_TRUE(tc, _append(journal, "session", "{\"id\":\"two\"}"));
+    ABTS_TRUE(tc, _append(journal, "session-deleted", "{\"id\":\"one\"}"));
+    ABTS_TRUE(tc, _append(journal, "session", "{\"id\":\"three\"}"));
+    ABTS_TRUE(tc, msaf_state_journal_snapshot_due(journal));
+
+    ABTS_TRUE(tc, msaf_state_journal_snapshot(journal, _snapshot_state, (void*)state));
+    ABTS_FALSE(tc, msaf_state_journal_snapshot_due(journal));
+    ABTS_INT_EQUAL(tc, 0, msaf_state_journal_length(journal));
+    ABTS_TRUE(tc, msaf_state_journal_seq(journal) == 4);
+    ABTS_INT_EQUAL(tc, 0, _file_size(directory, "journal"));
+    ABTS_INT_EQUAL(tc, -1, _file_size(directory, "snapshot.tmp"));
+
+    ABTS_TRUE(tc, _append(journal, "session-deleted", "{\"id\":\"two\"}"));
+    msaf_state_journal_close(journal);
+
+    /* the snapshot, then only the tail of the journal */
+    journal = _open(directory, &replay);
+    ABTS_PTR_NOTNULL(tc, journal);
+    ABTS_INT_EQUAL(tc, 3, replay.count);
+    ABTS_STR_EQUAL(tc, "session:{\"id\":\"two\"}", replay.records[0]);
+    ABTS_STR_EQUAL(tc, "session:{\"id\":\"three\"}", replay.records[1]);
+    ABTS_STR_EQUAL(tc, "session-deleted:{\"id\":\"two\"}", replay.records[2]);
+    ABTS_TRUE(tc, msaf_state_journal_seq(journal) == 5);
+    ABTS_INT_EQUAL(tc, 1, msaf_state_journal_length(journal));
+    msaf_state_journal_close(journal);
+
+    _replay_clear(&replay);
+    _remove_directory(directory);
+    ogs_free(directory);
+}
+
+static void test_state_journal_snapshot_split(abts_case *tc, void *data)
+{
+    static const char *state[] = {"session", "{\"id\":\"one\"}", "session", "{\"id\":\"two\"}", NULL};
+    char *directory = _make_directory();
+    test_replay_t replay = {{NULL}, 0, 0};
+    msaf_state_journal_t *journal;
+    msaf_state_journal_snapshot_job_t *job;
+    char *tmp_path;
+
+    journal = _open(directory, &replay);
+    ABTS_TRUE(tc, _append(journal, "session", "{\"id\":\"one\"}"));
+    ABTS_TRUE(tc, _append(journal, "session", "{\"id\":\"two\"}"));
+    ABTS_TRUE(tc, _append(journal, "session", "{\"id\":\"three\"}"));
+    ABTS_TRUE(tc, _append(journal, "session-deleted", "{\"id\":\"three\"}"));
+
+    job = msaf_state_journal_snapshot_begin(journal, _snapshot_state, (void*)state);
+    ABTS_PTR_NOTNULL(tc, job);
+    ABTS_PTR_EQUAL(tc, NULL, msaf_state_journal_snapshot_begin(journal, _snapshot_state, (void*)state));
+    ABTS_FALSE(tc, msaf_state_journal_snapshot_due(journal));
+
+    /* changes made while the snapshot is being written are kept in the journal */
+    ABTS_TRUE(tc, _append(journal, "session", "{\"id\":\"four\"}"));
+    ABTS_TRUE(tc, msaf_state_journal_snapshot_write(job));
+    ABTS_TRUE(tc, _append(journal, "session", "{\"id\":\"five\"}"));
+    msaf_state_journal_snapshot_end(journal, job, true);
+    ABTS_INT_EQUAL(tc, 2, msaf_state_journal_length(journal));
+    ABTS_INT_EQUAL(tc, -1, _file_size(directory, "journal.tmp"));
+    ABTS_TRUE(tc, _append(journal, "session", "{\"id\":\"six\"}"));
+    msaf_state_journal_close(journal);
+
+    journal = _open(directory, &replay);
+    ABTS_PTR_NOTNULL(tc, journal);
+    ABTS_INT_EQUAL(tc, 5, replay.count);
+    ABTS_STR_EQUAL(tc, "session:{\"id\":\"two\"}", replay.records[1]);
+    ABTS_STR_EQUAL(tc, "session:{\"id\":\"four\"}", replay.records[2]);
+    ABTS_STR_EQUAL(tc, "session:{\"id\":\"six\"}", replay.records[4]);
+    ABTS_TRUE(tc, msaf_state_journal_seq(journal) == 7);
+    ABTS_INT_EQUAL(tc, 3, msaf_state_journal_length(journal));
+
+    /* a snapshot that could not be written leaves the journal as it was */
+    tmp_path = _file_path(directory, "snapshot.tmp");
+    ABTS_INT_EQUAL(tc, 0, mkdir(tmp_path, 0700));
+    job = msaf_state_journal_snapshot_begin(journal, _snapshot_state, (void*)state);
+    ABTS_PTR_NOTNULL(tc, job);
+    ABTS_FALSE(tc, msaf_state_journal_snapshot_write(job));
+    msaf_state_journal_snapshot_end(journal, job, false);
+    ABTS_INT_EQUAL(tc, 3, msaf_state_journal_length(journal));
+    ABTS_FALSE(tc, msaf_state_journal_snapshot_due(journal));
+    rmdir(tmp_path);
+    ogs_free(tmp_path);
+    msaf_state_journal_close(journal);
+
+    _replay_clear(&replay);
+    journal = _open(directory, &replay);
+    ABTS_INT_EQUAL(tc, 5, replay.count);
+    msaf_state_journal_close(journal);
+
+    _replay_clear(&replay);
+    _remove_directory(directory);
+    ogs_free(directory);
+}
+
+static void test_state_journal_crash_recovery(abts_case *tc, void *data)
+{
+    static const char *state[] = {"session", "{\"id\":\"one\"}", "session", "{\"id\":\"two\"}", NULL};
+    char *directory = _make_directory();
+    test_replay_t replay = {{NULL}, 0, 0};
+    msaf_state_journal_t *journal;
+    char *journal_contents, *snapshot_contents;
+    size_t journal_size, snapshot_size;
+
+    journal = _open(directory, &replay);
+    ABTS_TRUE(tc, _append(journal, "session", "{\"id\":\"one\"}"));
+    ABTS_TRUE(tc, _append(journal, "session", "{\"id\":\"two\"}"));
+    msaf_state_journal_close(journal);
+    journal_contents = _file_read(directory, "journal", &journal_size);
+
+    /* a torn final record is dropped and truncated away */
+    _file_write(directory, "journal", "MSAFJRN1 3 session 12 ", 22, "ab");
+    journal = _open(directory, &replay);
+    ABTS_PTR_NOTNULL(tc, journal);
+    ABTS_INT_EQUAL(tc, 2, replay.seen);
+    ABTS_INT_EQUAL(tc, journal_size, _file_size(directory, "journal"));
+    ABTS_TRUE(tc, _append(journal, "session", "{\"id\":\"six\"}"));
+    msaf_state_journal_close(journal);
+    _replay_clear(&replay);
+    journal = _open(directory, &replay);
+    ABTS_INT_EQUAL(tc, 3, replay.count);
+    ABTS_STR_EQUAL(tc, "session:{\"id\":\"six\"}", replay.records[2]);
+    msaf_state_journal_close(journal);
+
+    /* a record with a bad checksum ends the journal */
+    journal_contents[journal_size - 4] ^= 1;
+    _file_write(directory, "journal", journal_contents, journal_size, "wb");
+    _replay_clear(&replay);
+    journal = _open(directory, &replay);
+    ABTS_PTR_NOTNULL(tc, journal);
+    ABTS_INT_EQUAL(tc, 1, replay.seen);
+    ABTS_STR_EQUAL(tc, "session:{\"id\":\"one\"}", replay.records[0]);
+    ABTS_TRUE(tc, msaf_state_journal_seq(journal) == 1);
+    journal_contents[journal_size - 4] ^= 1;
+
+    /* stopping after a snapshot is renamed into place, but before the journal is emptied */
+    ABTS_TRUE(tc, _append(journal, "session", "{\"id\":\"two\"}"));
+    ABTS_TRUE(tc, msaf_state_journal_snapshot(journal, _snapshot_state, (void*)state));
+    msaf_state_journal_close(journal);
+    _file_write(directory, "journal", journal_contents, journal_size, "wb");
+    _file_write(directory, "snapshot.tmp", "partial", 7, "wb");
+    _replay_clear(&replay);
+    journal = _open(directory, &replay);
+    ABTS_PTR_NOTNULL(tc, journal);
+    ABTS_INT_EQUAL(tc, 2, replay.seen);
+    ABTS_TRUE(tc, msaf_state_journal_seq(journal) == 2);
+    ABTS_INT_EQUAL(tc, 0, msaf_state_journal_length(journal));
+    ABTS_INT_EQUAL(tc, -1, _file_size(directory, "snapshot.tmp"));
+    /* new records follow the snapshot */
+    ABTS_TRUE(tc, _append(journal, "session", "{\"id\":\"seven\"}"));
+    ABTS_TRUE(tc, msaf_state_journal_seq(journal) == 3);
+    msaf_state_journal_close(journal);
+    _replay_clear(&replay);
+    journal = _open(directory, &replay);
+    ABTS_INT_EQUAL(tc, 3, replay.count);
+    ABTS_STR_EQUAL(tc, "session:{\"id\":\"seven\"}", replay.records[2]);
+    msaf_state_journal_close(journal);
+
+    /* a damaged snapshot is refused and the files are left alone */
+    snapshot_contents = _file_read(directory, "snapshot", &snapshot_size);
+    snapshot_contents[snapshot_size - 3] ^= 1;
+    _file_write(directory, "snapshot", snapshot_contents, snapshot_size, "wb");
+    _replay_clear(&replay);
+    ABTS_PTR_EQUAL(tc, NULL, _open(directory, &replay));
+    ABTS_INT_EQUAL(tc, 0, replay.seen);
+    ABTS_INT_EQUAL(tc, snapshot_size, _file_size(directory, "snapshot"));
+    ABTS_TRUE(tc, _file_size(directory, "journal") > 0);
+    _file_write(directory, "snapshot", "MSAFSNP1 x\n", 11, "wb");
+    ABTS_PTR_EQUAL(tc, NULL, _open(directory, &replay));
+
+    ogs_free(snapshot_contents);
+    ogs_free(journal_contents);
+    _replay_clear(&replay);
+    _remove_directory(directory);
+    ogs_free(directory);
+}
+
+/* Loading after a snapshot only replays the tail of the journal */
+#define STATE_JOURNAL_BENCH_RECORDS 20000
+
+static bool _bench_count(const char *type, const char *payload, size_t payload_len, void *data)
+{
+    (*(size_t*)data)++;
+    return true;
+}
+
+static bool _bench_snapshot(msaf_state_journal_t *journal, void *data)
+{
+    const char *payload = data;
+    size_t i;
+
+    for (i = 0; i < STATE_JOURNAL_BENCH_RECORDS; i++) {
+        if (!msaf_state_journal_snapshot_add(journal, "session", payload, strlen(payload))) return false;
+    }
+
+    return true;
+}
+
+static long long _bench_load(const char *directory, size_t *records)
+{
+    msaf_state_journal_config_t config;
+    msaf_state_journal_t *journal;
+    struct timespec start, end;
+
+    msaf_state_journal_config_init(&config);
+    config.directory = ogs_strdup(directory);
+    journal = msaf_state_journal_open(&config);
+    msaf_state_journal_config_clear(&config);
+
+    *records = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ogs_assert(msaf_state_journal_load(journal, _bench_count, records));
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    msaf_state_journal_close(journal);
+
+    return (end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec);
+}
+
+static void test_state_journal_bench(abts_case *tc, void *data)
+{
+    static const char *payload = "{\"provisioningSessionId\":\"d54a1fcc-d411-41ee-93c4-83f7cc6ba1f1\","
+                                 "\"provisioningSessionType\":\"DOWNLINK\",\"appId\":\"bench\"}";
+    char *directory = _make_directory();
+    msaf_state_journal_config_t config;
+    msaf_state_journal_t *journal;
+    long long ns_journal, ns_snapshot;
+    size_t records;
+    int i;
+
+    msaf_state_journal_config_init(&config);
+    config.directory = ogs_strdup(directory);
+    config.fsync = false;
+    journal = msaf_state_journal_open(&config);
+    msaf_state_journal_config_clear(&config);
+    ABTS_TRUE(tc, msaf_state_journal_load(journal, _bench_count, &records));
+    for (i = 0; i < STATE_JOURNAL_BENCH_RECORDS; i++) {
+        ABTS_TRUE(tc, msaf_state_journal_append(journal, "session", payload, strlen(payload)));
+    }
+
+    ns_journal = _bench_load(directory, &records);
+    ABTS_INT_EQUAL(tc, STATE_JOURNAL_BENCH_RECORDS, records);
+
+    ABTS_TRUE(tc, msaf_state_journal_snapshot(journal, _bench_snapshot, (void*)payload));
+    for (i = 0; i < 10; i++) {
+        ABTS_TRUE(tc, msaf_state_journal_append(journal, "session", payload, strlen(payload)));
+    }
+    /* a restart only replays the changes made since the snapshot from the journal */
+    ABTS_INT_EQUAL(tc, 10, msaf_state_journal_length(journal));
+    msaf_state_journal_close(journal);
+
+    ns_snapshot = _bench_load(directory, &records);
+    ABTS_INT_EQUAL(tc, STATE_JOURNAL_BENCH_RECORDS + 10, records);
+
+    ogs_info("State journal load of %i records: from the journal %lld ns, from a snapshot %lld ns",
+             STATE_JOURNAL_BENCH_RECORDS, ns_journal, ns_snapshot);
+
+    _remove_directory(directory);
+    ogs_free(directory);
+}
+
+static struct {
+    void (*func)(abts_case *tc, void *data);
+} test_cases[] = {
+    {test_state_journal_round_trip},
+    {test_state_journal_snapshot},
+    {test_state_journal_snapshot_split},
+    {test_state_journal_crash_recovery},
+    {test_state_journal_bench}
+};
+
+abts_suite *test_state_journal(abts_suite *suite)
+{
+    int i;
+
+    suite = ADD_SUITE(suite)
+
+    for (i=0; i<(sizeof(test_cases)/sizeof(test_cases[0])); i++) {
+        abts_run_test(suite, test_cases[i].func, NULL);
+    }
+
+    return suite;
+}
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -13,8 +13,20 @@
 #include "af/sbi-path.h"
 
 /* Unit test includes */
+#include "consumption-report-validator-test.h"
+#include "consumption-statistics-test.h"
+#include "content-hosting-configuration-diff-test.h"
+#include "data-collection-log-test.h"
+#include "json-reader-test.h"
+#include "json-writer-test.h"
+#include "metrics-report-test.h"
+#include "model-arena-test.h"
 #include "pcf-cache-test.h"
+#include "provisioning-session-list-test.h"
+#include "rate-limit-test.h"
+#include "request-headers-test.h"
 #include "sai-cache-test.h"
+#include "state-journal-test.h"
 #include "utilities-test.h"
 
 #include "tests.h"
@@ -22,8 +34,20 @@
 static struct {
     abts_suite *(*func)(abts_suite *suite);
 } alltests[] = {
+    {test_consumption_report_validator},
+    {test_consumption_statistics},
+    {test_content_hosting_configuration_diff},
+    {test_data_collection_log},
+    {test_json_reader},
+    {test_json_writer},
+    {test_metrics_report},
+    {test_model_arena},
     {test_pcf_cache},
+    {test_provisioning_session_list},
+    {test_rate_limit},
+    {test_request_headers},
     {test_sai_cache},
+    {test_state_journal},
     {test_utilities}
 };
 
@@ -36,6 +36,7 @@ should be performed outside of this class.
 import datetime
 import json
 import logging
+import urllib.parse
 from typing import Optional, Union, Tuple, Dict, Any, TypedDict, List
 
 import httpx
@@ -99,14 +100,17 @@ class M1Client:
     '''5G-MAG Reference Tools: M1 Client
     '''
 
-    def __init__(self, host_address: Tuple[str,int]):
+    def __init__(self, host_address: Tuple[str,int], management_address: Optional[Tuple[str,int]] = None):
         '''
         Constructor
 
         :param Tuple[str,int] host_address: 5GMS Application Function to connect to as a tuple of hostname/ip-addr and TCP port
                                             number.
+        :param Optional[Tuple[str,int]] management_address: The 5GMS Application Function management interface as a tuple of
+                                            hostname/ip-addr and TCP port number, needed for `bulkProvisioning`.
         '''
         self.__host_address = host_address
+        self.__management_address = management_address
         self.__connection = None
         self.__log = logging.getLogger(__name__ + '.' + self.__class__.__name__)
 
@@ -149,22 +153,25 @@ class M1Client:
         return None
 
     async def getProvisioningSessionById(self,
-                                         provisioning_session_id: ResourceId
+                                         provisioning_session_id: ResourceId,
+                                         if_none_match: Optional[str] = None
                                          ) -> Optional[ProvisioningSessionResponse]:
         '''
         Get a provisioning session from the 5GMS Application Function
 
         :param ResourceId provisioning_session_id: The provisioning session to find.
+        :param Optional[str] if_none_match: The ETag of a copy of the provisioning session already held, if any.
 
         :return: a ProvisioningSessionResponse structure if the provisioning session was found, or None if the provisioning
-                 session was not found.
+                 session was not found. If *if_none_match* still matches, the ProvisioningSessionResponse only holds the
+                 metadata.
 
         :raises M1ClientError: if there was a problem with the request
         :raises M1ServerError: if there was a server side issue preventing the creation of the provisioning session.
         '''
         result = await self.__do_request('GET',
                                          '/provisioning-sessions/' + provisioning_session_id, '',
-                                         'application/json')
+                                         'application/json', headers=self.__conditional_headers(if_none_match=if_none_match))
         if result['status_code'] == 200:
             ret: ProvisioningSessionResponse = self.__tag_and_date(result)
             ret.update({
@@ -172,16 +179,21 @@ class M1Client:
                     'ProvisioningSession': ProvisioningSession.fromJSON(result['body'])
                     })
             return ret
+        if result['status_code'] == 304:
+            ret = self.__tag_and_date(result)
+            ret['ProvisioningSessionId'] = provisioning_session_id
+            return ret
         if result['status_code'] == 404:
             return None
         self.__default_response(result)
         return None
 
-    async def destroyProvisioningSession(self, provisioning_session_id: ResourceId) -> bool:
+    async def destroyProvisioningSession(self, provisioning_session_id: ResourceId, if_match: Optional[str] = None) -> bool:
         '''
         Destroy a provisioning session on the 5GMS Application Function
 
         :param ResourceId provisioning_session_id: The provisioning session to find.
+        :param Optional[str] if_match: Only destroy the provisioning session if its ETag is still this one.
 
         :return: True if a provisioning session was deleted (or pending deletion) or False if there was no action.
 
@@ -190,7 +202,7 @@ class M1Client:
         '''
         result = await self.__do_request('DELETE',
                                          '/provisioning-sessions/' + provisioning_session_id, '',
-                                         'application/json')
+                                         'application/json', headers=self.__conditional_headers(if_match=if_match))
         if result['status_code'] == 204 or result['status_code'] == 202:
             return True
         self.__default_response(result)
@@ -232,24 +244,27 @@ class M1Client:
         self.__default_response(result)
         return False
 
-    async def retrieveContentHostingConfiguration(self, provisioning_session_id: ResourceId
+    async def retrieveContentHostingConfiguration(self, provisioning_session_id: ResourceId,
+                                                  if_none_match: Optional[str] = None
                                                   ) -> Optional[ContentHostingConfigurationResponse]:
         '''
         Fetch the content hosting configuration for a provisioning session
 
         :param ResourceId provisioning_session_id: The provisioning session to fetch the current content hosting configuration
                                                    for.
+        :param Optional[str] if_none_match: The ETag of a copy of the content hosting configuration already held, if any.
 
         :return: None if the provisioning session does not exist, also returns None if the
                  provisioning session exists but does not have a content hosting configuration,
-                 otherwise returns a ContentHostingConfigurationResponse.
+                 otherwise returns a ContentHostingConfigurationResponse. If *if_none_match* still matches, the
+                 ContentHostingConfigurationResponse only holds the metadata.
 
         :raise M1ClientError: if there was a problem with the request.
         :raise M1ServerError: if there was a server side issue preventing the creation of the provisioning session.
         '''
         result = await self.__do_request('GET',
                     f'/provisioning-sessions/{provisioning_session_id}/content-hosting-configuration',
-                                         '', 'application/json')
+                                         '', 'application/json', headers=self.__conditional_headers(if_none_match=if_none_match))
         if result['status_code'] == 200:
             ret: ContentHostingConfigurationResponse = self.__tag_and_date(result)
             ret.update({
@@ -257,13 +272,18 @@ class M1Client:
                 'ContentHostingConfiguration': ContentHostingConfiguration.fromJSON(result['body'])
                 })
             return ret
+        if result['status_code'] == 304:
+            ret = self.__tag_and_date(result)
+            ret['ProvisioningSessionId'] = provisioning_session_id
+            return ret
         if result['status_code'] == 404:
             return None
         self.__default_response(result)
         return None
 
     async def updateContentHostingConfiguration(self, provisioning_session_id: ResourceId,
-                                                content_hosting_configuration: ContentHostingConfiguration
+                                                content_hosting_configuration: ContentHostingConfiguration,
+                                                if_match: Optional[str] = None
                                                 ) -> bool:
         '''
         Update a content hosting configuration for a provisioning session
@@ -271,6 +291,7 @@ class M1Client:
         :param ResourceId provisioning_session_id: The provisioning session to update the current content hosting configuration
                                                    for.
         :param ContentHostingConfiguration content_hosting_configuration: The new content hosting configuration to apply.
+        :param Optional[str] if_match: Only update the content hosting configuration if its ETag is still this one.
 
         :return: ``True`` if the update succeeded or ``False`` if the update failed.
 
@@ -278,7 +299,8 @@ class M1Client:
         :raise M1ServerError: if there was a server side issue preventing the creation of the provisioning session.
         '''
         result = await self.__do_request('PUT', f'/provisioning-sessions/{provisioning_session_id}/content-hosting-configuration',
-                                         json.dumps(content_hosting_configuration), 'application/json')
+                                         json.dumps(content_hosting_configuration), 'application/json',
+                                         headers=self.__conditional_headers(if_match=if_match))
         if result['status_code'] == 204:
             return True
         if result['status_code'] == 404:
@@ -321,12 +343,14 @@ class M1Client:
         self.__default_response(result)
         return False
 
-    async def destroyContentHostingConfiguration(self, provisioning_session_id: ResourceId
+    async def destroyContentHostingConfiguration(self, provisioning_session_id: ResourceId,
+                                                 if_match: Optional[str] = None
                                                  ) -> bool:
         '''
         Delete a content hosting configuration for a provisioning session
 
         :param ResourceId provisioning_session_id: The provisioning session to remove the content hosting configuration for.
+        :param Optional[str] if_match: Only delete the content hosting configuration if its ETag is still this one.
 
         :return: True if the ContentHostingConfiguration was deleted or False if the ContentHostingConfiguration did not exist.
 
@@ -335,7 +359,7 @@ class M1Client:
         '''
         result = await self.__do_request('DELETE',
                     f'/provisioning-sessions/{provisioning_session_id}/content-hosting-configuration',
-                                         '', 'application/json')
+                                         '', 'application/json', headers=self.__conditional_headers(if_match=if_match))
         if result['status_code'] == 204 or result['status_code'] == 202:
             return True
         if result['status_code'] == 404:
@@ -463,27 +487,35 @@ class M1Client:
         self.__default_response(result)
         return False
 
-    async def retrieveServerCertificate(self, provisioning_session_id: ResourceId, certificate_id: ResourceId) -> Optional[ServerCertificateResponse]:
+    async def retrieveServerCertificate(self, provisioning_session_id: ResourceId, certificate_id: ResourceId,
+                                        if_none_match: Optional[str] = None) -> Optional[ServerCertificateResponse]:
         '''Retrieve the public certificate for a given certificate Id
 
         :param ResourceId provisioning_session_id: The provisioning session for the certificate.
         :param ResourceId certificate_id: The certificate Id of the certificate.
+        :param Optional[str] if_none_match: The ETag of a copy of the certificate already held, if any.
 
         :return: a ServerCertificateResponse containing the PEM data for the public certificate and its metadata or ``None``
-                 if the certificate is reserved and awaiting upload.
+                 if the certificate is reserved and awaiting upload. If *if_none_match* still matches, the
+                 ServerCertificateResponse only holds the metadata.
 
         :raise M1ClientError: if there was a problem with the request or the certificate was not found.
         :raise M1ServerError: if there was a server side issue preventing the creation of the provisioning session.
         '''
         result = await self.__do_request('GET',
               f'/provisioning-sessions/{provisioning_session_id}/certificates/{certificate_id}',
-              '', 'application/octet-stream')
+              '', 'application/octet-stream', headers=self.__conditional_headers(if_none_match=if_none_match))
         if result['status_code'] == 200:
             ret: ServerCertificateResponse = self.__tag_and_date(result)
             ret['ProvisioningSessionId'] = provisioning_session_id
             ret['ServerCertificateId'] = certificate_id
             ret['ServerCertificate'] = result['body']
             return ret
+        if result['status_code'] == 304:
+            ret = self.__tag_and_date(result)
+            ret['ProvisioningSessionId'] = provisioning_session_id
+            ret['ServerCertificateId'] = certificate_id
+            return ret
         if result['status_code'] == 204:
             return None
         if result['status_code'] == 404:
@@ -491,11 +523,13 @@ class M1Client:
         self.__default_response(result)
         return None
 
-    async def destroyServerCertificate(self, provisioning_session_id: ResourceId, certificate_id: ResourceId) -> bool:
+    async def destroyServerCertificate(self, provisioning_session_id: ResourceId, certificate_id: ResourceId,
+                                       if_match: Optional[str] = None) -> bool:
         '''Delete a certificate.
 
         :param ResourceId provisioning_session_id: The provisioning session for the certificate.
         :param ResourceId certificate_id: The certificate Id of the certificate.
+        :param Optional[str] if_match: Only delete the certificate if its ETag is still this one.
 
         :return: ``True`` if the certificate has been deleted.
         :raise M1ClientError: if there was a problem with the request.
@@ -503,30 +537,35 @@ class M1Client:
         '''
         result = await self.__do_request('DELETE',
               f'/provisioning-sessions/{provisioning_session_id}/certificates/{certificate_id}',
-              '', 'application/octet-stream')
+              '', 'application/octet-stream', headers=self.__conditional_headers(if_match=if_match))
         if result['status_code'] == 204 or result['status_code'] == 202:
             return True
         self.__default_response(result)
         return False
 
     # TS26512_M1_ContentProtocolsDiscovery
-    async def retrieveContentProtocols(self, provisioning_session_id: ResourceId) -> Optional[ContentProtocolsResponse]:
+    async def retrieveContentProtocols(self, provisioning_session_id: ResourceId,
+                                       if_none_match: Optional[str] = None) -> Optional[ContentProtocolsResponse]:
         '''Get the ContentProtocols information for the provisioning session
 
         :param ResourceId provisioning_session_id: The provisioning session to get the ContentProtocols for.
+        :param Optional[str] if_none_match: The ETag of a copy of the ContentProtocols already held, if any.
 
         :return: a `ContentProtocolsResponse` containing the ContentProtocols structure and metadata or None if the
-                 provisioning session was not found.
+                 provisioning session was not found. If *if_none_match* still matches, the `ContentProtocolsResponse` only
+                 holds the metadata.
         :raise M1ClientError: if there was a problem with the request.
         :raise M1ServerError: if there was a server side issue preventing the creation of the provisioning session.
         '''
         result = await self.__do_request('GET',
                 f'/provisioning-sessions/{provisioning_session_id}/protocols',
-                '', 'application/octet-stream')
+                '', 'application/octet-stream', headers=self.__conditional_headers(if_none_match=if_none_match))
         if result['status_code'] == 200:
             ret: ContentProtocolsResponse = self.__tag_and_date(result)
             ret['ContentProtocols'] = ContentProtocols.fromJSON(result['body'])
             return ret
+        if result['status_code'] == 304:
+            return self.__tag_and_date(result)
         self.__default_response(result)
         return None
 
@@ -556,33 +595,41 @@ class M1Client:
         self.__default_response(result)
         return None
 
-    async def retrieveConsumptionReportingConfiguration(self, provisioning_session_id: ResourceId) -> Optional[ConsumptionReportingConfigurationResponse]:
+    async def retrieveConsumptionReportingConfiguration(self, provisioning_session_id: ResourceId,
+                                                        if_none_match: Optional[str] = None
+                                                        ) -> Optional[ConsumptionReportingConfigurationResponse]:
         '''Get the ConsumptionReportingConfiguration for the provisioning session
 
         :param ResourceId provisioning_session_id: The provisioning session to get the ConsumptionReportingConfiguration for.
+        :param Optional[str] if_none_match: The ETag of a copy of the ConsumptionReportingConfiguration already held, if any.
 
-        :return: A `ConsumptionReportingConfigurationResponse` for the current configuration in the provisioning session.
+        :return: A `ConsumptionReportingConfigurationResponse` for the current configuration in the provisioning session. If
+                 *if_none_match* still matches, the `ConsumptionReportingConfigurationResponse` only holds the metadata.
 
         :raise M1ClientError: if there was a problem with the request.
         :raise M1ServerError: if there was a server side issue preventing the creation of the provisioning session.
         '''
         result = await self.__do_request('GET',
                 f'/provisioning-sessions/{provisioning_session_id}/consumption-reporting-configuration',
-                '', 'application/octet-stream')
+                '', 'application/octet-stream', headers=self.__conditional_headers(if_none_match=if_none_match))
         if result['status_code'] == 200:
             ret: ConsumptionReportingConfigurationResponse = self.__tag_and_date(result)
             ret['ConsumptionReportingConfiguration'] = ConsumptionReportingConfiguration.fromJSON(result['body'])
             return ret
+        if result['status_code'] == 304:
+            return self.__tag_and_date(result)
         if result['status_code'] == 404:
             return None
         self.__default_response(result)
         return None
 
-    async def updateConsumptionReportingConfiguration(self, provisioning_session_id: ResourceId, consumption_reporting_config: ConsumptionReportingConfiguration) -> bool:
+    async def updateConsumptionReportingConfiguration(self, provisioning_session_id: ResourceId, consumption_reporting_config: ConsumptionReportingConfiguration,
+                                                      if_match: Optional[str] = None) -> bool:
         '''Modify the ConsumptionReportingConfiguration for the provisioning session
 
         :param ResourceId provisioning_session_id: The provisioning session to modify the ConsumptionReportingConfiguration for.
         :param ConsumptionReportingConfiguration consumption_reporting_config: The ConsumptionReportingConfiguration to apply.
+        :param Optional[str] if_match: Only modify the ConsumptionReportingConfiguration if its ETag is still this one.
 
         :return: `True` if the configuration was changed successfully.
 
@@ -591,7 +638,8 @@ class M1Client:
         '''
         result = await self.__do_request('PUT',
                 f'/provisioning-sessions/{provisioning_session_id}/consumption-reporting-configuration',
-                json.dumps(consumption_reporting_config), 'application/json')
+                json.dumps(consumption_reporting_config), 'application/json',
+                headers=self.__conditional_headers(if_match=if_match))
         if result['status_code'] == 204:
             return True
         self.__default_response(result)
@@ -618,10 +666,12 @@ class M1Client:
         self.__default_response(result)
         return None
 
-    async def destroyConsumptionReportingConfiguration(self, provisioning_session_id: ResourceId) -> bool:
+    async def destroyConsumptionReportingConfiguration(self, provisioning_session_id: ResourceId,
+                                                       if_match: Optional[str] = None) -> bool:
         '''Remove the ConsumptionReportingConfiguration from the provisioning session
 
         :param ResourceId provisioning_session_id: The provisioning session to remove the ConsumptionReportingConfiguration from.
+        :param Optional[str] if_match: Only remove the ConsumptionReportingConfiguration if its ETag is still this one.
 
         :return: `True` if the ConsumptionReportingConfiguration was successfully removed.
 
@@ -630,7 +680,7 @@ class M1Client:
         '''
         result = await self.__do_request('DELETE',
                 f'/provisioning-sessions/{provisioning_session_id}/consumption-reporting-configuration',
-                '', 'application/octet-stream')
+                '', 'application/octet-stream', headers=self.__conditional_headers(if_match=if_match))
         if result['status_code'] == 204:
             return True
         self.__default_response(result)
@@ -687,41 +737,48 @@ class M1Client:
         self.__default_response(result)
         return None
 
-    async def retrievePolicyTemplate(self, provisioning_session_id: ResourceId, policy_template_id: ResourceId) -> Optional[PolicyTemplateResponse]:
+    async def retrievePolicyTemplate(self, provisioning_session_id: ResourceId, policy_template_id: ResourceId,
+                                     if_none_match: Optional[str] = None) -> Optional[PolicyTemplateResponse]:
         '''Retrieve a PolicyTemplate for a provisioning session
 
         :param ResourceId provisioning_session_id: The provisioning session to retrieve the PolicyTemplate from.
         :param ResourceId policy_template_id: The PolicyTemplate Id of the PolicyTemplate to retrieve.
+        :param Optional[str] if_none_match: The ETag of a copy of the PolicyTemplate already held, if any.
         :return: A `PolicyTemplateResponse` which holds the `PolicyTemplate` and the caching metadata or `None` if the
-                 `PolicyTemplate` cannot be found.
+                 `PolicyTemplate` cannot be found. If *if_none_match* still matches, the `PolicyTemplateResponse` only holds
+                 the caching metadata.
         :raise M1ClientError: if there was a problem with the request.
         :raise M1ServerError: if there was a server side issue preventing the retrieval of the policy template.
         '''
         result = await self.__do_request('GET',
                 f'/provisioning-sessions/{provisioning_session_id}/policy-templates/{policy_template_id}',
-                '', 'application/json')
+                '', 'application/json', headers=self.__conditional_headers(if_none_match=if_none_match))
         if result['status_code'] == 200:
             ret: PolicyTemplateResponse = self.__tag_and_date(result)
             ret['PolicyTemplate'] = PolicyTemplate.fromJSON(result['body'])
             return ret
+        if result['status_code'] == 304:
+            return self.__tag_and_date(result)
         if result['status_code'] == 404:
             return None
         self.__default_response(result)
         return None
 
-    async def updatePolicyTemplate(self, provisioning_session_id: ResourceId, policy_template_id: ResourceId, policy_template: PolicyTemplate) -> bool:
+    async def updatePolicyTemplate(self, provisioning_session_id: ResourceId, policy_template_id: ResourceId, policy_template: PolicyTemplate,
+                                   if_match: Optional[str] = None) -> bool:
         '''Update an existing PolicyTemplate in a provisioning session
 
         :param ResourceId provisioning_session_id: The provisioning session to replace the PolicyTemplate in.
         :param ResourceId policy_template_id: The PolicyTemplate Id of the PolicyTemplate to replace.
         :param PolicyTemplate policy_template: The PolicyTemplate which will replace the existing one in the provisioning session.
+        :param Optional[str] if_match: Only replace the PolicyTemplate if its ETag is still this one.
         :return: `True` if the update succeeded.
         :raise M1ClientError: if there was a problem with the request.
         :raise M1ServerError: if there was a server side issue preventing the update of the policy template.
         '''
         result = await self.__do_request('PUT',
                 f'/provisioning-sessions/{provisioning_session_id}/policy-templates/{policy_template_id}',
-                json.dumps(policy_template), 'application/json')
+                json.dumps(policy_template), 'application/json', headers=self.__conditional_headers(if_match=if_match))
         if result['status_code'] == 204:
             return True
         if result['status_code'] == 404:
@@ -753,11 +810,13 @@ class M1Client:
         self.__default_response(result)
         return None
 
-    async def destroyPolicyTemplate(self, provisioning_session_id: ResourceId, policy_template_id: ResourceId) -> bool:
+    async def destroyPolicyTemplate(self, provisioning_session_id: ResourceId, policy_template_id: ResourceId,
+                                    if_match: Optional[str] = None) -> bool:
         '''Destroy a PolicyTemplate in a provisioning session
 
         :param ResourceId provisioning_session_id: The provisioning session to modify the PolicyTemplate for.
         :param ResourceId policy_template_id: The PolicyTemplateId for the PolicyTemplate in the provisioning session.
+        :param Optional[str] if_match: Only destroy the PolicyTemplate if its ETag is still this one.
 
         :return: `True` if the PolicyTemplate was deleted or `False` if the PolicyTemplate didn't exist.
 
@@ -766,7 +825,7 @@ class M1Client:
         '''
         result = await self.__do_request('DELETE',
                 f'/provisioning-sessions/{provisioning_session_id}/policy-templates/{policy_template_id}',
-                '', 'application/json')
+                '', 'application/json', headers=self.__conditional_headers(if_match=if_match))
         if result['status_code'] == 204:
             return True
         if result['status_code'] == 404:
@@ -774,10 +833,79 @@ class M1Client:
         self.__default_response(result)
         return False
 
+    # 5GMS AF Management: bulk provisioning
+    async def bulkProvisioning(self, definitions: List[Dict[str,Any]]) -> List[Dict[str,Any]]:
+        '''Create or update many provisioning sessions in one request
+
+        Each definition holds either a ``provisioningSessionId`` to update or the ``provisioningSessionType``, ``appId`` and
+        optional ``aspId`` for a new provisioning session, along with any of ``serverCertificates`` (a list of placeholder names
+        for new certificates that the ``certificateId`` fields in the ``contentHostingConfiguration`` may use),
+        ``contentHostingConfiguration``, ``consumptionReportingConfiguration``, ``policyTemplates`` and
+        ``metricsReportingConfigurations``. Either all the definitions are applied or none are.
+
+        :param List[Dict[str,Any]] definitions: The provisioning session definitions.
+        :return: A result for each definition, in order, with the ``status``, ``provisioningSessionId`` and the ids of the
+                 new resources.
+        :raise M1ClientError: if there was a problem with the request, the exception reason holds the per-definition results.
+        :raise M1ServerError: if there was a server side issue preventing the changes.
+        '''
+        if self.__management_address is None:
+            raise M1ClientError(reason='Bulk provisioning needs the Application Function management interface address',
+                                status_code=400)
+        result = await self.__do_request('POST', '/provisioning-sessions', json.dumps(definitions), 'application/json',
+                                         url_base=f'http://{self.__management_address[0]}:{self.__management_address[1]}/5gmag-rt-management/v1')
+        if result['status_code'] == 200:
+            return json.loads(result['body'])
+        self.__default_response(result)
+        return []
+
+    # 5GMS AF Management: change feed
+    async def watchChanges(self, after: Optional[int] = None, feed_id: Optional[str] = None,
+                           provisioning_session_id: Optional[ResourceId] = None, wait: Optional[int] = None
+                           ) -> Dict[str,Any]:
+        '''Wait for changes to the provisioning sessions
+
+        Returns as soon as there are changes after *after*, or with an empty ``changes`` list once *wait* seconds have passed.
+        Pass the ``lastSequence`` and ``feedId`` of the result as *after* and *feed_id* for the next call.
+
+        :param Optional[int] after: The last change sequence number seen, or ``None`` for only the changes from now on.
+        :param Optional[str] feed_id: The ``feedId`` from the last result.
+        :param Optional[ResourceId] provisioning_session_id: Only return the changes to this provisioning session.
+        :param Optional[int] wait: Seconds to wait for changes, 0 to return at once, ``None`` for the AF default.
+        :return: The change feed response with ``feedId``, ``lastSequence`` and the list of ``changes``.
+        :raise M1ClientError: if there was a problem with the request, a status code of 410 means the changes after *after* are
+                              no longer available and the resources being followed should be fetched again.
+        :raise M1ServerError: if there was a server side issue.
+        '''
+        if self.__management_address is None:
+            raise M1ClientError(reason='The change feed needs the Application Function management interface address',
+                                status_code=400)
+        params = {}
+        if after is not None:
+            params['after'] = str(after)
+        if feed_id is not None:
+            params['feedId'] = feed_id
+        if provisioning_session_id is not None:
+            params['provisioningSessionId'] = provisioning_session_id
+        if wait is not None:
+            params['wait'] = str(wait)
+        url_suffix = '/changes'
+        if len(params) > 0:
+            url_suffix += '?' + urllib.parse.urlencode(params)
+        # allow for the AF holding the request for the whole wait time
+        result = await self.__do_request('GET', url_suffix, '', 'application/json',
+                                         url_base=f'http://{self.__management_address[0]}:{self.__management_address[1]}/5gmag-rt-management/v1',
+                                         timeout=(300 if wait is None else wait) + 10)
+        if result['status_code'] == 200:
+            return json.loads(result['body'])
+        self.__default_response(result)
+        return {}
+
     # Private methods
 
     async def __do_request(self, method: str, url_suffix: str, body: Union[str,bytes],
-                           content_type: str, headers: Optional[dict] = None) -> Dict[str,Any]:
+                           content_type: str, headers: Optional[dict] = None,
+                           url_base: Optional[str] = None, timeout: Optional[float] = None) -> Dict[str,Any]:
         '''Send a request to the 5GMS Application Function
 
         :meta private:
@@ -786,6 +914,8 @@ class M1Client:
         :param Union[str,bytes] body: The body of the request as a `str` or `bytes`.
         :param str content_type: The content type to use in the ``Content-Type`` header of the request.
         :param Optional[dict] headers: Extra headers to go along with the request.
+        :param Optional[str] url_base: The URL to prefix *url_suffix* with, if not the M1 interface.
+        :param Optional[float] timeout: Seconds to wait for the response, if not the connection default.
         :return: a `dict` with 3 entries ``status_code``, ``body`` and ``headers`` representing the HTTP response status code,
                  the response message body and the response headers.
         :raise M1ServerError: if communication with the AF failed.
@@ -796,11 +926,16 @@ class M1Client:
         req_headers = {'Content-Type': content_type}
         if headers is not None:
             req_headers.update(headers)
-        url = f'http://{self.__host_address[0]}:{self.__host_address[1]}/3gpp-m1/v2{url_suffix}'
+        if url_base is None:
+            url_base = f'http://{self.__host_address[0]}:{self.__host_address[1]}/3gpp-m1/v2'
+        url = url_base + url_suffix
         if self.__connection is None:
             self.__connection = httpx.AsyncClient(http1=True, http2=False,
                                                   headers={'User-Agent': '5GMS-AF/testing'})
-        req = self.__connection.build_request(method, url, headers=req_headers, data=body)
+        if timeout is None:
+            req = self.__connection.build_request(method, url, headers=req_headers, data=body)
+        else:
+            req = self.__connection.build_request(method, url, headers=req_headers, data=body, timeout=timeout)
         try:
             resp = await self.__connection.send(req)
         except httpx.RemoteProtocolError as err:
@@ -825,6 +960,27 @@ class M1Client:
             raise M1ServerError(reason='M1 operation failed: '+str(result['body']),
                                 status_code=result['status_code'])
 
+    @staticmethod
+    def __conditional_headers(if_none_match: Optional[str] = None, if_match: Optional[str] = None) -> Optional[Dict[str,str]]:
+        '''Make the conditional request headers
+
+        A precondition that fails makes the Application Function respond with ``412 Precondition Failed``, which is raised as an
+        `M1ClientError`. A matching *if_none_match* on a GET gives ``304 Not Modified`` instead.
+
+        :meta private:
+        :param Optional[str] if_none_match: ETag for an ``If-None-Match`` header.
+        :param Optional[str] if_match: ETag for an ``If-Match`` header.
+        :return: the headers to pass to `__do_request` or ``None`` if there are no conditions.
+        '''
+        headers = {}
+        if if_none_match is not None:
+            headers['If-None-Match'] = if_none_match
+        if if_match is not None:
+            headers['If-Match'] = if_match
+        if len(headers) == 0:
+            return None
+        return headers
+
     @staticmethod
     def __tag_and_date(result: Dict[str,Any]) -> TagAndDateResponse:
         '''Get the response message standard metadata
@@ -61,15 +61,18 @@ class M1Session:
     `CertificateSigner` to perform signing of certificates when ``domainNameAlias`` is used.
     '''
 
-    def __init__(self, host_address: Tuple[str,int], persistent_data_store: Optional[DataStore] = None, certificate_signer: Optional[Union[CertificateSigner,type,str]] = None):
+    def __init__(self, host_address: Tuple[str,int], persistent_data_store: Optional[DataStore] = None, certificate_signer: Optional[Union[CertificateSigner,type,str]] = None, management_address: Optional[Tuple[str,int]] = None):
         '''Constructor
 
         :param host_address: A tuple containing the M1 server (5GMS Application Function) hostname/ip-address and TCP port number
                              to contact it at.
         :param persistent_data_store: A `DataStore` object to use to provide persistent storage.
         :param certificate_signer: A `CertificateSigner` to use when signing certificates with extra domain names. This can be either a `str` containing the full Python class name, a `CertificateSigner` class to instantiate if needed, or an instance of a `CertificateSigner` to use. If not given then ``rt_m1_client.certificates.DefaultCertificateSigner`` is used.
+        :param management_address: A tuple containing the 5GMS Application Function management interface hostname/ip-address
+                                   and TCP port number, used for `provisioningSessionsBulkApply`.
         '''
         self.__m1_host = host_address
+        self.__management_host = management_address
         self.__data_store_dir = persistent_data_store
         self.__cert_signer = certificate_signer
         self.__m1_client = None
@@ -192,6 +195,30 @@ class M1Session:
             await self.__data_store_dir.set('provisioning_sessions', list(self.__provisioning_sessions.keys()))
         return ps_id
 
+    async def provisioningSessionsBulkApply(self, definitions: List[dict]) -> Optional[List[dict]]:
+        '''Create or update many provisioning sessions in one request
+
+        See `M1Client.bulkProvisioning` for the format of the definitions. The provisioning sessions that were created or
+        updated are added to, or refreshed in, the cache.
+
+        :param definitions: The provisioning session definitions.
+        :return: the result for each definition, in order, or ``None`` if none of the definitions were applied.
+        '''
+        await self.__connect()
+        try:
+            results = await self.__m1_client.bulkProvisioning(definitions)
+        except (M1ClientError, M1ServerError) as err:
+            self.__log.error("provisioningSessionsBulkApply: %s", err)
+            return None
+        for result in results:
+            ps_id = result.get('provisioningSessionId')
+            if ps_id is not None and result.get('status') in [200, 201]:
+                # Forget any cached state, it will be fetched again when next needed
+                self.__provisioning_sessions[ps_id] = None
+        if self.__data_store_dir:
+            await self.__data_store_dir.set('provisioning_sessions', list(self.__provisioning_sessions.keys()))
+        return results
+
     async def provisioningSessionIdByIngestUrl(self, ingesturl: str, entrypoint: Optional[str] = None) -> Optional[ResourceId]:
         ret = None
         for ps_id in self.__provisioning_sessions.keys():
@@ -773,12 +800,15 @@ class M1Session:
         now = datetime.datetime.now(datetime.timezone.utc)
         if ps is None or ps['cache-until'] is None or ps['cache-until'] < now:
             await self.__connect()
-            result = await self.__m1_client.getProvisioningSessionById(prov_sess)
+            result = await self.__m1_client.getProvisioningSessionById(prov_sess, if_none_match=self.__cachedETag(ps))
             if result is not None:
                 if ps is None:
                     ps = {}
                     self.__provisioning_sessions[prov_sess] = ps
                 ps.update({k.lower(): v for k,v in result.items()})
+                if 'ProvisioningSession' not in result:
+                    # Not modified, keep the resource caches
+                    return
                 ps.update({
                     'protocols': None,
                     'content-hosting-configuration': None,
@@ -806,7 +836,8 @@ class M1Session:
         now = datetime.datetime.now(datetime.timezone.utc)
         if ps['protocols'] is None or ps['protocols']['cache-until'] is None or ps['protocols']['cache-until'] < now:
             await self.__connect()
-            result = await self.__m1_client.retrieveContentProtocols(provisioning_session_id)
+            result = await self.__m1_client.retrieveContentProtocols(provisioning_session_id,
+                                                                        if_none_match=self.__cachedETag(ps['protocols']))
             if result is not None:
                 if ps['protocols'] is None:
                     ps['protocols'] = {}
@@ -834,7 +865,8 @@ class M1Session:
             if cert['cache-until'] is None or cert['cache-until'] < now:
                 await self.__connect()
                 try:
-                    result = await self.__m1_client.retrieveServerCertificate(provisioning_session_id, cert_id)
+                    result = await self.__m1_client.retrieveServerCertificate(provisioning_session_id, cert_id,
+                                                                            if_none_match=self.__cachedETag(cert))
                     if result is not None:
                         cert.update({k.lower(): v for k,v in result.items()})
                 except M1Error as err:
@@ -857,7 +889,8 @@ class M1Session:
         chc = ps['content-hosting-configuration']
         if chc is None or chc['cache-until'] is None or chc['cache-until'] < now:
             await self.__connect()
-            result = await self.__m1_client.retrieveContentHostingConfiguration(provisioning_session_id)
+            result = await self.__m1_client.retrieveContentHostingConfiguration(provisioning_session_id,
+                                                                                   if_none_match=self.__cachedETag(chc))
             if result is not None:
                 if chc is None:
                     chc = {}
@@ -881,7 +914,8 @@ class M1Session:
         if crc is None or crc['cache-until'] is None or crc['cache-until'] < now:
             await self.__connect()
             result: Optional[ConsumptionReportingConfigurationResponse] = \
-                    await self.__m1_client.retrieveConsumptionReportingConfiguration(provisioning_session_id)
+                    await self.__m1_client.retrieveConsumptionReportingConfiguration(provisioning_session_id,
+                                                                                   if_none_match=self.__cachedETag(crc))
             if result is not None:
                 if crc is None:
                     crc = {}
@@ -911,7 +945,8 @@ class M1Session:
             if pol['cache-until'] is None or pol['cache-until'] < now:
                 await self.__connect()
                 try:
-                    result = await self.__m1_client.retrievePolicyTemplate(provisioning_session_id, pol_id)
+                    result = await self.__m1_client.retrievePolicyTemplate(provisioning_session_id, pol_id,
+                                                                         if_none_match=self.__cachedETag(pol))
                     if result is not None:
                         pol.update({k.lower(): v for k,v in result.items()})
                 except M1Error as err:
@@ -920,6 +955,18 @@ class M1Session:
         if ret_err is not None:
             raise ret_err
 
+    @staticmethod
+    def __cachedETag(cache: Optional[Dict[str,Any]]) -> Optional[str]:
+        '''Get the ETag to revalidate a cache entry with
+
+        :meta private:
+        :param cache: The cache entry, may be ``None``.
+        :return: the ETag of the cached resource or ``None`` if there is no cached resource to revalidate.
+        '''
+        if cache is None:
+            return None
+        return cache.get('etag')
+
     async def __getCertificateSigner(self) -> CertificateSigner:
         '''Get the `CertificateSigner`
 
@@ -957,7 +1004,7 @@ class M1Session:
         :meta private:
         '''
         if self.__m1_client is None:
-            self.__m1_client = M1Client(self.__m1_host)
+            self.__m1_client = M1Client(self.__m1_host, self.__management_host)
 
     def _dump_state(self) -> None:
         '''Dump the current provisioning session cache to the log
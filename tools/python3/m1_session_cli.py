@@ -36,6 +36,8 @@ Syntax:
     m1-session-cli configure get <key>
     m1-session-cli list -h
     m1-session-cli list [-v]
+    m1-session-cli bulk -h
+    m1-session-cli bulk <provisioning-sessions-JSON>
     m1-session-cli new-provisioning-session -h
     m1-session-cli new-provisioning-session [-e <application-id>] [-a <asp-id>]
     m1-session-cli new-stream [-e <application-id>] [-a <asp-id>] [-n <name>] [--with-ssl|--ssl-only]
@@ -122,6 +124,7 @@ Arguments:
     entry-point-suffix-URL            Optional media entry URL path.
     ingest-URL                        The base URL to fetch content from.
     key                               The configuration field name.
+    provisioning-sessions-JSON        The file path of a JSON file holding an array of provisioning session definitions.
     value                             The configuration field value.
 '''
 
@@ -299,6 +302,25 @@ async def cmd_list(args: argparse.Namespace, config: Configuration) -> int:
     print('\n'.join(await session.provisioningSessionIds()))
     return 0
 
+async def cmd_bulk(args: argparse.Namespace, config: Configuration) -> int:
+    '''Perform ``bulk`` operation
+
+    This will create or update all the provisioning sessions defined in a JSON file in one request to the management interface.
+
+    Will output to stdout the result for each definition.
+    '''
+    session = await get_session(config)
+
+    async with aiofiles.open(args.file, 'r') as json_in:
+        definitions = json.loads(await json_in.read())
+    results = await session.provisioningSessionsBulkApply(definitions)
+    if results is None:
+        print('Failed to apply the provisioning session definitions')
+        return 1
+    for result in results:
+        print(f'{result.get("status")} {result.get("provisioningSessionId")}: {json.dumps(result)}')
+    return 0
+
 async def cmd_new_provisioning_session(args: argparse.Namespace, config: Configuration) -> int:
     '''Perform ``new-provisioning-session`` operation
 
@@ -871,6 +893,12 @@ async def parse_args() -> Tuple[argparse.Namespace,Configuration]:
     # The entry-point-path should go with ingest-URL, but argparser lacks the ability to do subgroups
     parser_delstream.add_argument('entrypoint', metavar='entry-point-path', nargs='?', help='The media player entry point suffix to identify the provisioning session.')
 
+    # m1-session-cli bulk <provisioning-sessions-JSON>
+    parser_bulk = subparsers.add_parser('bulk', help='Create or update provisioning sessions from a JSON file in one request')
+    parser_bulk.set_defaults(command=cmd_bulk)
+    parser_bulk.add_argument('file', metavar='provisioning-sessions-JSON',
+                             help='A filepath to a JSON encoded array of provisioning session definitions')
+
     # m1-session-cli set-stream -p <provisioning-session-id> <CHC-JSON-FILE>
     parser_set_stream = subparsers.add_parser('set-stream', help='Set the hosting for a provisioning session from a JSON file')
     parser_set_stream.set_defaults(command=cmd_set_stream)
@@ -1098,7 +1126,8 @@ async def get_session(config: Configuration) -> M1Session:
             data_store = await JSONFileDataStore(config.get('data_store'))
         else:
             data_store = None
-        _m1_session = await M1Session((config.get('m1_address', 'localhost'), config.get('m1_port',7777)), data_store, config.get('certificate_signing_class'))
+        _m1_session = await M1Session((config.get('m1_address', 'localhost'), config.get('m1_port',7777)), data_store, config.get('certificate_signing_class'),
+                                      (config.get('maf_address', 'localhost'), config.get('maf_port', 7777)))
     return _m1_session
 
 async def main():
@@ -414,6 +414,36 @@ async def policies_match(p1: Optional[PolicyTemplate], p2: Optional[PolicyTempla
         return False
     return True
 
+def stream_content_hosting_configuration(cfg: dict) -> ContentHostingConfiguration:
+    return { 'name': cfg['name'],
+             'ingestConfiguration': {
+                 'baseURL': cfg['ingestURL'],
+                 'pull': True,
+                 'protocol': 'urn:3gpp:5gms:content-protocol:http-pull-ingest',
+             },
+             'distributionConfigurations': cfg['distributionConfigurations'],
+           }
+
+def stream_policy_templates(cfg_id: str, cfg: dict) -> List[PolicyTemplate]:
+    policies = cfg.get('policies', None)
+    if policies is None:
+        return []
+    if isinstance(policies,dict):
+        pol_list = policies.items()
+    elif isinstance(policies,list):
+        pol_list = [(p.get('externalReference', None), p) for p in policies]
+    else:
+        log_error(f'Configured policies for provisioning session "{cfg_id}" should be an object or array')
+        return []
+    pts = []
+    for ext_id, pol in pol_list:
+        pt = dict()
+        if ext_id is not None:
+            pt.update({'externalReference': ext_id})
+        pt.update(pol)
+        pts += [pt]
+    return pts
+
 async def sync_configuration(m1: M1Session, streams: dict) -> dict:
     have = {}
     to_check = streams['streams']
@@ -440,17 +470,38 @@ async def sync_configuration(m1: M1Session, streams: dict) -> dict:
     # have = already configured, to_check = need to configure, del_ps_id = configuration not found in the configured streams
     for ps_id in del_ps_id:
         await m1.provisioningSessionDestroy(ps_id)
+    # Create the new streams in one bulk request, except those needing certificates signed for a domainNameAlias
+    bulk_cfg_ids = []
+    bulk_definitions = []
     for cfg_id, cfg in to_check.items():
-        chc = { 'name': cfg['name'],
-                'ingestConfiguration': {
-                    'baseURL': cfg['ingestURL'],
-                    'pull': True,
-                    'protocol': 'urn:3gpp:5gms:content-protocol:http-pull-ingest',
-                },
-                'distributionConfigurations': cfg['distributionConfigurations'],
-                }
+        if any('certificateId' in dc and 'domainNameAlias' in dc for dc in cfg['distributionConfigurations']):
+            continue
+        definition = {'provisioningSessionType': 'DOWNLINK', 'appId': streams.get('appId'),
+                      'contentHostingConfiguration': stream_content_hosting_configuration(cfg)}
+        if streams.get('aspId', None) is not None:
+            definition['aspId'] = streams['aspId']
+        cert_placeholders = list(dict.fromkeys(dc['certificateId'] for dc in cfg['distributionConfigurations']
+                                               if 'certificateId' in dc))
+        if len(cert_placeholders) > 0:
+            definition['serverCertificates'] = cert_placeholders
+        if cfg.get('consumptionReporting', None) is not None:
+            definition['consumptionReportingConfiguration'] = cfg['consumptionReporting']
+        pol_list = stream_policy_templates(cfg_id, cfg)
+        if pol_list:
+            definition['policyTemplates'] = pol_list
+        bulk_cfg_ids += [cfg_id]
+        bulk_definitions += [definition]
+    if len(bulk_definitions) > 0:
+        results = await m1.provisioningSessionsBulkApply(bulk_definitions)
+        if results is None:
+            log_warn("Bulk provisioning failed, creating the Provisioning Sessions one at a time")
+        else:
+            for cfg_id, result in zip(bulk_cfg_ids, results):
+                stream_map[cfg_id] = result['provisioningSessionId']
+                del to_check[cfg_id]
+    for cfg_id, cfg in to_check.items():
+        chc = stream_content_hosting_configuration(cfg)
         crc = cfg.get('consumptionReporting', None)
-        policies = cfg.get('policies', None)
         ps_id = await m1.createDownlinkPullProvisioningSession(streams.get('appId'), streams.get('aspId', None))
         if ps_id is None:
             log_error("Failed to create Provisioning Session for %r", cfg)
@@ -475,23 +526,10 @@ async def sync_configuration(m1: M1Session, streams: dict) -> dict:
             if crc is not None:
                 if not await m1.consumptionReportingConfigurationCreate(ps_id, crc):
                     log_error("Failed to activate ConsumptionReportingConfiguration for Provisioning Session %s")
-            if policies is not None:
-                if isinstance(policies,dict):
-                    pol_list = policies.items()
-                elif isinstance(policies,list):
-                    pol_list = [(p.get('externalReference', None), p) for p in policies]
-                else:
-                    log_error(f'Configured policies for provisioning session "{cfg_id}" should be an object or array')
-                    pol_list = None
-                if pol_list is not None:
-                    for ext_id, pol in pol_list:
-                        pt = dict()
-                        if ext_id is not None:
-                            pt.update({'externalReference': ext_id})
-                        pt.update(pol)
-                        result = await m1.policyTemplateCreate(ps_id, pt)
-                        if result is None:
-                            log_error(f'Failed to create policy template {ext_id!r} in provisioning session {ps_id}')
+            for pt in stream_policy_templates(cfg_id, cfg):
+                result = await m1.policyTemplateCreate(ps_id, pt)
+                if result is None:
+                    log_error(f'Failed to create policy template {pt.get("externalReference")!r} in provisioning session {ps_id}')
     # Check for other changes in the configured sessions
     for cfg_id, cfg in have.items():
         # Check for ConsumptionReportingConfiguration changes in already configured sessions
@@ -590,7 +628,8 @@ async def get_m1_session(cfg: Configuration) -> M1Session:
     data_store_dir = cfg.get('data_store')
     if data_store_dir is not None:
         data_store = await JSONFileDataStore(data_store_dir)
-    session = await M1Session((cfg.get('m1_address', 'localhost'), cfg.get('m1_port',7777)), data_store, cfg.get('certificate_signing_class'))
+    session = await M1Session((cfg.get('m1_address', 'localhost'), cfg.get('m1_port',7777)), data_store, cfg.get('certificate_signing_class'),
+                              (cfg.get('maf_address', 'localhost'), cfg.get('maf_port', 7777)))
     return session
 
 async def dump_m8_files(m1: M1Session, stream_map: dict, vod_streams: List[dict], cfg: Configuration, config: configparser.ConfigParser):
@@ -0,0 +1,193 @@
+#!/usr/bin/python3
+#==============================================================================
+# 5G-MAG Reference Tools: AF report log reader
+#==============================================================================
+#
+# File: msaf_report_log.py
+# License: 5G-MAG Public License (v1.0)
+# Author: David Waring
+# Copyright: (C) 2024 British Broadcasting Corporation
+#
+# For full license terms please see the LICENSE file distributed with this
+# program. If this file is missing then the license can be retrieved from
+# https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+#
+#==============================================================================
+#
+# AF report log reader
+# ====================
+#
+# This is a command line tool which reads the segment files written by the AF
+# when msaf.dataCollectionStorage.type is "segmented".
+#
+'''
+=============================================
+5G-MAG Reference Tools: AF report log reader
+=============================================
+
+This command line app iterates over the report log segments written by the 5GMS
+AF when the data collection storage type is "segmented".
+
+Syntax:
+    msaf-report-log -h
+    msaf-report-log list [-d <data-collection-dir>] [<path>...]
+    msaf-report-log cat [-d <data-collection-dir>] [<path>...]
+    msaf-report-log extract [-d <data-collection-dir>] <destination> [<path>...]
+
+Each *path* may be a segment file or a directory, directories are searched for
+segment files. If no paths are given then the data collection directory is
+used. Segments are read in the order they were written.
+
+The *list* command prints one line for each report giving the provisioning
+session, report class, client id, session id, report time and body size.
+
+The *cat* command writes each report body to stdout, followed by a newline.
+
+The *extract* command recreates the one file per report layout, as used by the
+"files" storage type, under the *destination* directory.
+'''
+
+import argparse
+import os
+import os.path
+import sys
+from typing import Iterator, List, NamedTuple, Optional
+
+RECORD_MAGIC = b'MSAFREC1'
+SEGMENT_SUFFIX = '.log'
+DEFAULT_DATA_COLLECTION_DIR = '@data_collection_dir@'
+
+
+class ReportRecord(NamedTuple):
+    '''A report read from a segment'''
+    provisioning_session_id: str
+    report_class: str
+    client_id: str
+    session_id: Optional[str]
+    report_time: str
+    format: str
+    body: bytes
+
+
+class SegmentError(Exception):
+    '''Raised when a segment is truncated or corrupt'''
+
+
+def read_segment(path: str) -> Iterator[ReportRecord]:
+    '''Iterate over the records in the segment file at *path*
+
+    The provisioning session id and report class are taken from the names of
+    the two directories containing the segment.
+    '''
+    report_class_dir = os.path.dirname(os.path.abspath(path))
+    report_class = os.path.basename(report_class_dir)
+    provisioning_session_id = os.path.basename(os.path.dirname(report_class_dir))
+    with open(path, 'rb') as segment:
+        while True:
+            header = segment.readline()
+            if not header:
+                return
+            fields = header.split()
+            if len(fields) != 6 or fields[0] != RECORD_MAGIC or not header.endswith(b'\n'):
+                raise SegmentError(f'{path}: bad record header at offset {segment.tell() - len(header)}')
+            lengths = [int(f) for f in fields[1:]]
+            values = []
+            for length in lengths:
+                value = segment.read(length + 1)
+                if len(value) != length + 1:
+                    raise SegmentError(f'{path}: truncated record')
+                if value[-1:] != b'\n':
+                    raise SegmentError(f'{path}: corrupt record')
+                values += [value[:-1]]
+            yield ReportRecord(provisioning_session_id, report_class, values[0].decode('utf-8'),
+                               values[1].decode('utf-8') or None, values[2].decode('utf-8'),
+                               values[3].decode('utf-8'), values[4])
+
+
+def find_segments(paths: List[str]) -> List[str]:
+    '''Expand directories in *paths* to the segment files they contain, in the order they were written'''
+    segments = []
+    for path in paths:
+        if os.path.isdir(path):
+            for dirpath, dirnames, filenames in os.walk(path):
+                dirnames.sort()
+                segments += [os.path.join(dirpath, f) for f in sorted(filenames, key=_segment_sort_key)
+                             if f.endswith(SEGMENT_SUFFIX)]
+        else:
+            segments += [path]
+    return segments
+
+
+def _segment_sort_key(filename: str):
+    # <open time>_<sequence>.log, the sequence number is compared numerically
+    name = filename[:-len(SEGMENT_SUFFIX)] if filename.endswith(SEGMENT_SUFFIX) else filename
+    opened, _, seq = name.rpartition('_')
+    return (opened, int(seq) if seq.isdigit() else 0)
+
+
+def _records(args: argparse.Namespace) -> Iterator[ReportRecord]:
+    paths = args.paths or [args.data_collection_dir]
+    for segment in find_segments(paths):
+        try:
+            yield from read_segment(segment)
+        except SegmentError as err:
+            print(f'Warning: {err}', file=sys.stderr)
+
+
+def cmd_list(args: argparse.Namespace) -> int:
+    '''Perform ``list`` operation'''
+    for record in _records(args):
+        print(f'{record.provisioning_session_id}\t{record.report_class}\t{record.client_id}\t{record.session_id or "-"}\t'
+              f'{record.report_time}\t{record.format}\t{len(record.body)}')
+    return 0
+
+
+def cmd_cat(args: argparse.Namespace) -> int:
+    '''Perform ``cat`` operation'''
+    out = sys.stdout.buffer
+    for record in _records(args):
+        out.write(record.body)
+        out.write(b'\n')
+    return 0
+
+
+def cmd_extract(args: argparse.Namespace) -> int:
+    '''Perform ``extract`` operation'''
+    for record in _records(args):
+        report_dir = os.path.join(args.destination, record.provisioning_session_id, record.report_class)
+        os.makedirs(report_dir, exist_ok=True)
+        session = f'_{record.session_id}' if record.session_id else ''
+        filename = os.path.join(report_dir, f'{record.client_id}{session}_{record.report_time}.{record.format}')
+        with open(filename, 'wb') as outfile:
+            outfile.write(record.body)
+    return 0
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(prog='msaf-report-log', description='Read 5GMS AF report log segments')
+    parser.add_argument('-d', '--data-collection-dir', default=DEFAULT_DATA_COLLECTION_DIR,
+                        help='The data collection directory to use when no paths are given')
+    subparsers = parser.add_subparsers(dest='subcommand', required=True)
+
+    parser_list = subparsers.add_parser('list', help='List the reports in the segments')
+    parser_list.set_defaults(func=cmd_list)
+    parser_list.add_argument('paths', nargs='*', help='Segment files or directories')
+
+    parser_cat = subparsers.add_parser('cat', help='Write the report bodies to stdout')
+    parser_cat.set_defaults(func=cmd_cat)
+    parser_cat.add_argument('paths', nargs='*', help='Segment files or directories')
+
+    parser_extract = subparsers.add_parser('extract', help='Write each report to its own file')
+    parser_extract.set_defaults(func=cmd_extract)
+    parser_extract.add_argument('destination', help='Directory to extract the reports into')
+    parser_extract.add_argument('paths', nargs='*', help='Segment files or directories')
+
+    args = parser.parse_args()
+
+    return args.func(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
+
+# vim:ts=8:sts=4:sw=4:expandtab: